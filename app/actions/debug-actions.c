@@ -31,6 +31,8 @@
 #include "debug-actions.h"
 #include "debug-commands.h"
 
+#include "gimp-trace.h"
+
 
 #ifdef ENABLE_DEBUG_MENU
 
@@ -78,6 +80,18 @@ static const GimpActionEntry debug_actions[] =
     NULL }
 };
 
+static const GimpToggleActionEntry debug_toggle_actions[] =
+{
+  { "debug-record-trace", NULL,
+    "Record _Trace", NULL,
+    "Records a timeline of what GIMP is doing. When stopped, writes it "
+    "in the Chrome trace event format to a temporary file and prints "
+    "its name to stdout.",
+    G_CALLBACK (debug_record_trace_cmd_callback),
+    FALSE,
+    NULL }
+};
+
 #endif
 
 void
@@ -87,6 +101,10 @@ debug_actions_setup (GimpActionGroup *group)
   gimp_action_group_add_actions (group, NULL,
                                  debug_actions,
                                  G_N_ELEMENTS (debug_actions));
+
+  gimp_action_group_add_toggle_actions (group, NULL,
+                                        debug_toggle_actions,
+                                        G_N_ELEMENTS (debug_toggle_actions));
 #endif
 }
 
@@ -94,4 +112,8 @@ void
 debug_actions_update (GimpActionGroup *group,
                       gpointer         data)
 {
+#ifdef ENABLE_DEBUG_MENU
+  gimp_action_group_set_action_active (group, "debug-record-trace",
+                                       gimp_trace_active);
+#endif
 }
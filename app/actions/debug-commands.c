@@ -48,6 +48,8 @@
 #include "actions.h"
 #include "debug-commands.h"
 
+#include "gimp-trace.h"
+
 
 #ifdef ENABLE_DEBUG_MENU
 
@@ -97,6 +99,51 @@ debug_benchmark_projection_cmd_callback (GtkAction *action,
   g_idle_add ((GSourceFunc) debug_benchmark_projection, g_object_ref (display));
 }
 
+void
+debug_record_trace_cmd_callback (GtkAction *action,
+                                 gpointer   data)
+{
+  gboolean active;
+
+  active = gtk_toggle_action_get_active (GTK_TOGGLE_ACTION (action));
+
+  if (active == gimp_trace_active)
+    return;
+
+  if (active)
+    {
+      gimp_trace_start ();
+    }
+  else
+    {
+      gchar  *basename;
+      gchar  *filename;
+      GFile  *file;
+      GError *error = NULL;
+
+      gimp_trace_stop ();
+
+      basename = g_strdup_printf ("gimp-trace-%" G_GINT64_FORMAT ".json",
+                                  g_get_real_time () / G_TIME_SPAN_SECOND);
+      filename = g_build_filename (g_get_tmp_dir (), basename, NULL);
+      file     = g_file_new_for_path (filename);
+
+      if (gimp_trace_save (file, &error))
+        {
+          g_print ("Trace written to '%s'\n", filename);
+        }
+      else
+        {
+          g_printerr ("Could not write trace: %s\n", error->message);
+          g_clear_error (&error);
+        }
+
+      g_object_unref (file);
+      g_free (filename);
+      g_free (basename);
+    }
+}
+
 void
 debug_show_image_graph_cmd_callback (GtkAction *action,
                                      gpointer   data)
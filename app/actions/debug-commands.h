@@ -30,6 +30,8 @@ void   debug_mem_profile_cmd_callback             (GtkAction *action,
                                                    gpointer   data);
 void   debug_benchmark_projection_cmd_callback    (GtkAction *action,
                                                    gpointer   data);
+void   debug_record_trace_cmd_callback            (GtkAction *action,
+                                                   gpointer   data);
 void   debug_show_image_graph_cmd_callback        (GtkAction *action,
                                                    gpointer   data);
 void   debug_dump_menus_cmd_callback              (GtkAction *action,
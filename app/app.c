@@ -52,6 +52,7 @@
 
 #include "core/gimp.h"
 #include "core/gimp-batch.h"
+#include "core/gimp-latency.h"
 #include "core/gimp-user-install.h"
 
 #include "file/file-open.h"
@@ -67,6 +68,7 @@
 #include "language.h"
 #include "sanity.h"
 #include "gimp-debug.h"
+#include "gimp-trace.h"
 
 #include "gimp-intl.h"
 
@@ -91,6 +93,8 @@ GType gimp_layer_mode_effects_get_type         (void); /* compat cruft */
 static GObject *initial_screen  = NULL;
 static gint     initial_monitor = 0;
 
+static GFile   *app_trace_file  = NULL;
+
 
 /*  public functions  */
 
@@ -161,6 +165,7 @@ app_run (const gchar         *full_prog_name,
          const gchar         *session_name,
          const gchar         *batch_interpreter,
          const gchar        **batch_commands,
+         gint                 batch_jobs,
          gboolean             as_new,
          gboolean             no_interface,
          gboolean             no_data,
@@ -174,7 +179,8 @@ app_run (const gchar         *full_prog_name,
          gboolean             show_playground,
          GimpStackTraceMode   stack_trace_mode,
          GimpPDBCompatMode    pdb_compat_mode,
-         const gchar         *backtrace_file)
+         const gchar         *backtrace_file,
+         const gchar         *trace_file)
 {
   GimpInitStatusFunc  update_status_func = NULL;
   Gimp               *gimp;
@@ -186,6 +192,13 @@ app_run (const gchar         *full_prog_name,
   GimpLangRc         *temprc;
   gchar              *language = NULL;
 
+  if (trace_file)
+    {
+      app_trace_file = g_file_new_for_commandline_arg (trace_file);
+
+      gimp_trace_start ();
+    }
+
   if (filenames && filenames[0] && ! filenames[1] &&
       g_file_test (filenames[0], G_FILE_TEST_IS_DIR))
     {
@@ -345,7 +358,7 @@ app_run (const gchar         *full_prog_name,
     }
 
   if (run_loop)
-    gimp_batch_run (gimp, batch_interpreter, batch_commands);
+    gimp_batch_run (gimp, batch_interpreter, batch_commands, batch_jobs);
 
   if (run_loop)
     {
@@ -395,9 +408,48 @@ app_exit_after_callback (Gimp       *gimp,
                          gboolean    kill_it,
                          GMainLoop **loop)
 {
+  const gchar *latency_log;
+
   if (gimp->be_verbose)
     g_print ("EXIT: %s\n", G_STRFUNC);
 
+  /*  dump the painting latencies collected during this session, for
+   *  comparing them between runs
+   */
+  latency_log = g_getenv ("GIMP_LATENCY_LOG");
+
+  if (latency_log && *latency_log)
+    {
+      GFile  *file  = g_file_new_for_path (latency_log);
+      GError *error = NULL;
+
+      if (! gimp_latency_save (file, &error))
+        {
+          g_printerr ("Could not write latency log '%s': %s\n",
+                      latency_log, error->message);
+          g_clear_error (&error);
+        }
+
+      g_object_unref (file);
+    }
+
+  if (app_trace_file)
+    {
+      GError *error = NULL;
+
+      gimp_trace_stop ();
+
+      if (! gimp_trace_save (app_trace_file, &error))
+        {
+          g_printerr ("Could not write trace '%s': %s\n",
+                      gimp_file_get_utf8_name (app_trace_file),
+                      error->message);
+          g_clear_error (&error);
+        }
+
+      g_clear_object (&app_trace_file);
+    }
+
   /*
    *  In stable releases, we simply call exit() here. This speeds up
    *  the process of quitting GIMP and also works around the problem
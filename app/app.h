@@ -37,6 +37,7 @@ void  app_run       (const gchar         *full_prog_name,
                      const gchar         *session_name,
                      const gchar         *batch_interpreter,
                      const gchar        **batch_commands,
+                     gint                 batch_jobs,
                      gboolean             as_new,
                      gboolean             no_interface,
                      gboolean             no_data,
@@ -50,7 +51,8 @@ void  app_run       (const gchar         *full_prog_name,
                      gboolean             show_playground,
                      GimpStackTraceMode   stack_trace_mode,
                      GimpPDBCompatMode    pdb_compat_mode,
-                     const gchar         *backtrace_file);
+                     const gchar         *backtrace_file,
+                     const gchar         *trace_file);
 
 
 #endif /* __APP_H__ */
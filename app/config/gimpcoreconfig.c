@@ -113,6 +113,8 @@ enum
   PROP_EXPORT_METADATA_EXIF,
   PROP_EXPORT_METADATA_XMP,
   PROP_EXPORT_METADATA_IPTC,
+  PROP_XCF_SAVE_PREVIEWS,
+  PROP_XCF_SAVE_IN_BACKGROUND,
   PROP_GENERATE_BACKTRACE,
 
   /* ignored, only for backward compatibility: */
@@ -655,6 +657,20 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                             FALSE,
                             GIMP_PARAM_STATIC_STRINGS);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_SAVE_PREVIEWS,
+                            "xcf-save-previews",
+                            "Save XCF previews",
+                            XCF_SAVE_PREVIEWS_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_SAVE_IN_BACKGROUND,
+                            "xcf-save-in-background",
+                            "Save XCF files in the background",
+                            XCF_SAVE_IN_BACKGROUND_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_GENERATE_BACKTRACE,
                             "generate-backtrace",
                             "Try generating backtrace upon errors",
@@ -968,6 +984,12 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_EXPORT_METADATA_IPTC:
       core_config->export_metadata_iptc = g_value_get_boolean (value);
       break;
+    case PROP_XCF_SAVE_PREVIEWS:
+      core_config->xcf_save_previews = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_SAVE_IN_BACKGROUND:
+      core_config->xcf_save_in_background = g_value_get_boolean (value);
+      break;
     case PROP_GENERATE_BACKTRACE:
       core_config->generate_backtrace = g_value_get_boolean (value);
       break;
@@ -1167,6 +1189,12 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_EXPORT_METADATA_IPTC:
       g_value_set_boolean (value, core_config->export_metadata_iptc);
       break;
+    case PROP_XCF_SAVE_PREVIEWS:
+      g_value_set_boolean (value, core_config->xcf_save_previews);
+      break;
+    case PROP_XCF_SAVE_IN_BACKGROUND:
+      g_value_set_boolean (value, core_config->xcf_save_in_background);
+      break;
     case PROP_GENERATE_BACKTRACE:
       g_value_set_boolean (value, core_config->generate_backtrace);
       break;
@@ -98,6 +98,8 @@ struct _GimpCoreConfig
   gboolean                export_metadata_exif;
   gboolean                export_metadata_xmp;
   gboolean                export_metadata_iptc;
+  gboolean                xcf_save_previews;
+  gboolean                xcf_save_in_background;
   gboolean                generate_backtrace;
 };
 
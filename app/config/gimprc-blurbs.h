@@ -210,6 +210,14 @@ _("Export XMP metadata by default.")
 #define EXPORT_METADATA_IPTC_BLURB \
 _("Export IPTC metadata by default.")
 
+#define XCF_SAVE_PREVIEWS_BLURB \
+_("Store reduced-size versions of the image and its layers in XCF files, " \
+  "so previews and thumbnails can be shown without loading all pixels.")
+
+#define XCF_SAVE_IN_BACKGROUND_BLURB \
+_("Write XCF files from a snapshot of the image in a separate thread, " \
+  "so the image can be edited further while it is being saved.")
+
 #define GENERATE_BACKTRACE_BLURB \
 _("Try generating debug data for bug reporting when appropriate.")
 
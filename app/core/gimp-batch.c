@@ -29,30 +29,67 @@
 
 #include "gimp.h"
 #include "gimp-batch.h"
+#include "gimp-gui.h"
 #include "gimpparamspecs.h"
 
 #include "pdb/gimppdb.h"
 #include "pdb/gimpprocedure.h"
 
+#include "plug-in/gimppluginprocedure.h"
+
 #include "gimp-intl.h"
 
 
 #define BATCH_DEFAULT_EVAL_PROC   "plug-in-script-fu-eval"
 
 
-static void  gimp_batch_exit_after_callback (Gimp          *gimp) G_GNUC_NORETURN;
+typedef struct
+{
+  Gimp           *gimp;
+  GimpProcedure  *procedure;
+  const gchar   **commands;
+  gint            n_commands;
+  gint            n_started;
+  gint            n_running;
+  gint            n_failed;
+  gint            max_running;
+  GMainLoop      *main_loop;
+} GimpBatchPool;
+
+typedef struct
+{
+  GimpBatchPool  *pool;
+  gint            index;
+  gint64          start_time;
+} GimpBatchJob;
+
+
+static void  gimp_batch_exit_after_callback (Gimp            *gimp) G_GNUC_NORETURN;
+
+static void  gimp_batch_run_cmd             (Gimp            *gimp,
+                                             const gchar     *proc_name,
+                                             GimpProcedure   *procedure,
+                                             GimpRunMode      run_mode,
+                                             const gchar     *cmd);
+static GimpValueArray *
+             gimp_batch_get_args            (GimpProcedure   *procedure,
+                                             GimpRunMode      run_mode,
+                                             const gchar     *cmd);
 
-static void  gimp_batch_run_cmd             (Gimp          *gimp,
-                                             const gchar   *proc_name,
-                                             GimpProcedure *procedure,
-                                             GimpRunMode    run_mode,
-                                             const gchar   *cmd);
+static void  gimp_batch_run_pool            (Gimp            *gimp,
+                                             GimpProcedure   *procedure,
+                                             const gchar    **batch_commands,
+                                             gint             batch_jobs);
+static void  gimp_batch_pool_dispatch       (GimpBatchPool   *pool);
+static void  gimp_batch_job_return          (GimpValueArray  *return_vals,
+                                             GimpBatchJob    *job);
 
 
 void
 gimp_batch_run (Gimp         *gimp,
                 const gchar  *batch_interpreter,
-                const gchar **batch_commands)
+                const gchar **batch_commands,
+                gint          batch_jobs)
 {
   gulong  exit_id;
 
@@ -98,7 +135,12 @@ gimp_batch_run (Gimp         *gimp,
       GimpProcedure *eval_proc = gimp_pdb_lookup_procedure (gimp->pdb,
                                                             batch_interpreter);
 
-      if (eval_proc)
+      if (eval_proc && batch_jobs > 1 &&
+          GIMP_IS_PLUG_IN_PROCEDURE (eval_proc))
+        {
+          gimp_batch_run_pool (gimp, eval_proc, batch_commands, batch_jobs);
+        }
+      else if (eval_proc)
         {
           gint i;
 
@@ -144,17 +186,8 @@ gimp_batch_run_cmd (Gimp          *gimp,
   GimpValueArray *args;
   GimpValueArray *return_vals;
   GError         *error = NULL;
-  gint            i     = 0;
 
-  args = gimp_procedure_get_arguments (procedure);
-
-  if (procedure->num_args > i &&
-      GIMP_IS_PARAM_SPEC_INT32 (procedure->args[i]))
-    g_value_set_int (gimp_value_array_index (args, i++), run_mode);
-
-  if (procedure->num_args > i &&
-      GIMP_IS_PARAM_SPEC_STRING (procedure->args[i]))
-    g_value_set_static_string (gimp_value_array_index (args, i++), cmd);
+  args = gimp_batch_get_args (procedure, run_mode, cmd);
 
   return_vals =
     gimp_pdb_execute_procedure_by_name_args (gimp->pdb,
@@ -201,3 +234,162 @@ gimp_batch_run_cmd (Gimp          *gimp,
 
   return;
 }
+
+static GimpValueArray *
+gimp_batch_get_args (GimpProcedure *procedure,
+                     GimpRunMode    run_mode,
+                     const gchar   *cmd)
+{
+  GimpValueArray *args;
+  gint            i = 0;
+
+  args = gimp_procedure_get_arguments (procedure);
+
+  if (procedure->num_args > i &&
+      GIMP_IS_PARAM_SPEC_INT32 (procedure->args[i]))
+    g_value_set_int (gimp_value_array_index (args, i++), run_mode);
+
+  if (procedure->num_args > i &&
+      GIMP_IS_PARAM_SPEC_STRING (procedure->args[i]))
+    g_value_set_static_string (gimp_value_array_index (args, i++), cmd);
+
+  return args;
+}
+
+/*  runs the batch commands as independent jobs, each in its own
+ *  interpreter process, with up to 'batch_jobs' of them at the same
+ *  time.  the last command only starts once all others finished, so
+ *  a trailing (gimp-quit 0) still quits after all the work is done.
+ */
+static void
+gimp_batch_run_pool (Gimp           *gimp,
+                     GimpProcedure  *procedure,
+                     const gchar   **batch_commands,
+                     gint            batch_jobs)
+{
+  GimpBatchPool pool = { 0, };
+  gint64        start_time;
+
+  pool.gimp        = gimp;
+  pool.procedure   = procedure;
+  pool.commands    = batch_commands;
+  pool.n_commands  = g_strv_length ((gchar **) batch_commands);
+  pool.max_running = batch_jobs;
+  pool.main_loop   = g_main_loop_new (NULL, FALSE);
+
+  start_time = g_get_monotonic_time ();
+
+  gimp_batch_pool_dispatch (&pool);
+
+  if (pool.n_running > 0)
+    {
+      gimp_threads_leave (gimp);
+      g_main_loop_run (pool.main_loop);
+      gimp_threads_enter (gimp);
+    }
+
+  g_main_loop_unref (pool.main_loop);
+
+  g_printerr ("%d batch commands executed in %.3f seconds, %d failed\n",
+              pool.n_commands,
+              (gdouble) (g_get_monotonic_time () - start_time) /
+              G_TIME_SPAN_SECOND,
+              pool.n_failed);
+}
+
+static void
+gimp_batch_pool_dispatch (GimpBatchPool *pool)
+{
+  while (pool->n_started < pool->n_commands &&
+         pool->n_running < pool->max_running)
+    {
+      GimpBatchJob   *job;
+      GimpValueArray *args;
+
+      /*  the last command runs alone  */
+      if (pool->n_started == pool->n_commands - 1 && pool->n_running > 0)
+        break;
+
+      job = g_slice_new (GimpBatchJob);
+
+      job->pool       = pool;
+      job->index      = pool->n_started++;
+      job->start_time = g_get_monotonic_time ();
+
+      pool->n_running++;
+
+      args = gimp_batch_get_args (pool->procedure, GIMP_RUN_NONINTERACTIVE,
+                                  pool->commands[job->index]);
+
+      /*  may call gimp_batch_job_return() right away, if the
+       *  interpreter fails to start
+       */
+      gimp_plug_in_procedure_run_async (GIMP_PLUG_IN_PROCEDURE (pool->procedure),
+                                        pool->gimp,
+                                        gimp_get_user_context (pool->gimp),
+                                        NULL, args,
+                                        (GimpPlugInReturnFunc) gimp_batch_job_return,
+                                        job);
+
+      gimp_value_array_unref (args);
+    }
+
+  if (pool->n_running == 0 &&
+      pool->n_started == pool->n_commands &&
+      g_main_loop_is_running (pool->main_loop))
+    {
+      g_main_loop_quit (pool->main_loop);
+    }
+}
+
+static void
+gimp_batch_job_return (GimpValueArray *return_vals,
+                       GimpBatchJob   *job)
+{
+  GimpBatchPool     *pool = job->pool;
+  GimpPDBStatusType  status;
+  const gchar       *message = NULL;
+  gdouble            seconds;
+
+  seconds = (gdouble) (g_get_monotonic_time () - job->start_time) /
+            G_TIME_SPAN_SECOND;
+
+  status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
+
+  if (gimp_value_array_length (return_vals) > 1 &&
+      G_VALUE_HOLDS_STRING (gimp_value_array_index (return_vals, 1)))
+    {
+      message = g_value_get_string (gimp_value_array_index (return_vals, 1));
+    }
+
+  switch (status)
+    {
+    case GIMP_PDB_SUCCESS:
+      g_printerr ("batch command %d executed successfully "
+                  "in %.3f seconds\n",
+                  job->index + 1, seconds);
+      break;
+
+    case GIMP_PDB_CALLING_ERROR:
+      pool->n_failed++;
+      g_printerr ("batch command %d experienced a calling error "
+                  "after %.3f seconds%s%s\n",
+                  job->index + 1, seconds,
+                  message ? ":\n" : "", message ? message : "");
+      break;
+
+    default:
+      pool->n_failed++;
+      g_printerr ("batch command %d experienced an execution error "
+                  "after %.3f seconds%s%s\n",
+                  job->index + 1, seconds,
+                  message ? ":\n" : "", message ? message : "");
+      break;
+    }
+
+  pool->n_running--;
+
+  g_slice_free (GimpBatchJob, job);
+
+  gimp_batch_pool_dispatch (pool);
+}
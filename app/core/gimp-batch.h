@@ -21,7 +21,8 @@
 
 void   gimp_batch_run (Gimp         *gimp,
                        const gchar  *batch_interpreter,
-                       const gchar **batch_commands);
+                       const gchar **batch_commands,
+                       gint          batch_jobs);
 
 
 #endif /* __GIMP_BATCH_H__ */
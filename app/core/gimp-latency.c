@@ -0,0 +1,470 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-latency.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <cairo.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpcolor/gimpcolor.h"
+
+#include "core-types.h"
+
+#include "gimp-latency.h"
+
+
+/*  latencies are collected in logarithmic buckets, LATENCY_BUCKETS_PER_OCTAVE
+ *  per doubling, starting at LATENCY_MIN.  the first bucket holds everything
+ *  below LATENCY_MIN, the last one everything above the covered range.
+ */
+#define LATENCY_MIN                 100 /* usec */
+#define LATENCY_BUCKETS_PER_OCTAVE  8
+#define LATENCY_N_OCTAVES           17  /* up to about 13 seconds */
+#define LATENCY_N_BUCKETS           (LATENCY_N_OCTAVES *            \
+                                     LATENCY_BUCKETS_PER_OCTAVE + 1)
+
+/*  a painted input whose pixels did not reach the screen in this time
+ *  is dropped, it was most likely painted onto something invisible
+ */
+#define LATENCY_MAX_AGE             (10 * G_TIME_SPAN_SECOND)
+
+
+typedef struct
+{
+  guint64 counts[LATENCY_N_BUCKETS];
+  guint64 n_samples;
+  gint64  total;
+  gint64  max;
+} LatencyHistogram;
+
+
+static const gchar * const stage_names[GIMP_LATENCY_N_STAGES] =
+{
+  [GIMP_LATENCY_STAGE_PAINT]  = "paint",
+  [GIMP_LATENCY_STAGE_UPDATE] = "update",
+  [GIMP_LATENCY_STAGE_DRAW]   = "draw"
+};
+
+/*  the painted input events whose pixels are not on screen yet, one
+ *  per image projection, so that painting on one image is not timed
+ *  by the redraws of another
+ */
+typedef struct
+{
+  gint64           pending;    /*  receive time of the oldest input  */
+  GimpLatencyStage reached;    /*  the stage it has reached so far   */
+  gint64           paint_time; /*  the time of the last paint for it */
+} LatencySample;
+
+
+static GMutex           latency_mutex;
+static LatencyHistogram latency_histograms[GIMP_LATENCY_N_STAGES];
+
+/*  the receive time of the input event currently being dispatched  */
+static gint64           latency_input   = 0;
+
+/*  GimpProjection -> LatencySample  */
+static GHashTable      *latency_samples = NULL;
+
+
+/*  local function prototypes  */
+
+static void      gimp_latency_add_sample    (GimpLatencyStage        stage,
+                                             gint64                  latency);
+
+static gint      gimp_latency_bucket_index  (gint64                  latency);
+static gdouble   gimp_latency_bucket_lower  (gint                    bucket);
+static gdouble   gimp_latency_bucket_upper  (gint                    bucket);
+
+static gdouble   gimp_latency_histogram_get_percentile
+                                            (const LatencyHistogram *histogram,
+                                             gdouble                 percentile);
+
+static void      gimp_latency_append_ms     (GString                *str,
+                                             gdouble                 usec);
+
+
+/*  public functions  */
+
+/*  called around the dispatch of a painting input event, with the
+ *  monotonic time the event was received at
+ */
+void
+gimp_latency_begin_input (gint64 time)
+{
+  g_mutex_lock (&latency_mutex);
+
+  latency_input = time;
+
+  g_mutex_unlock (&latency_mutex);
+}
+
+void
+gimp_latency_end_input (void)
+{
+  g_mutex_lock (&latency_mutex);
+
+  latency_input = 0;
+
+  g_mutex_unlock (&latency_mutex);
+}
+
+/*  inputs which arrive before the previous ones reached the screen are
+ *  coalesced into the pending sample of 'projection', so each sample
+ *  measures the oldest input contained in a frame, which is what the
+ *  user sees
+ */
+void
+gimp_latency_mark (GimpProjection   *projection,
+                   GimpLatencyStage  stage)
+{
+  LatencySample *sample;
+  gint64         now;
+
+  g_return_if_fail (projection != NULL);
+  g_return_if_fail (stage < GIMP_LATENCY_N_STAGES);
+
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&latency_mutex);
+
+  if (! latency_samples)
+    latency_samples = g_hash_table_new_full (NULL, NULL,
+                                             NULL, g_free);
+
+  sample = g_hash_table_lookup (latency_samples, projection);
+
+  if (sample && now - sample->pending > LATENCY_MAX_AGE)
+    {
+      g_hash_table_remove (latency_samples, projection);
+
+      sample = NULL;
+    }
+
+  switch (stage)
+    {
+    case GIMP_LATENCY_STAGE_PAINT:
+      if (latency_input)
+        {
+          if (! sample)
+            {
+              sample = g_new0 (LatencySample, 1);
+
+              sample->pending = latency_input;
+              sample->reached = GIMP_LATENCY_STAGE_PAINT;
+
+              g_hash_table_insert (latency_samples, projection, sample);
+            }
+
+          if (sample->reached == GIMP_LATENCY_STAGE_PAINT)
+            sample->paint_time = now;
+        }
+      break;
+
+    case GIMP_LATENCY_STAGE_UPDATE:
+      if (sample && sample->reached == GIMP_LATENCY_STAGE_PAINT)
+        {
+          gimp_latency_add_sample (GIMP_LATENCY_STAGE_PAINT,
+                                   sample->paint_time - sample->pending);
+          gimp_latency_add_sample (GIMP_LATENCY_STAGE_UPDATE,
+                                   now - sample->pending);
+
+          sample->reached = GIMP_LATENCY_STAGE_UPDATE;
+        }
+      break;
+
+    case GIMP_LATENCY_STAGE_DRAW:
+      if (sample && sample->reached == GIMP_LATENCY_STAGE_UPDATE)
+        {
+          gimp_latency_add_sample (GIMP_LATENCY_STAGE_DRAW,
+                                   now - sample->pending);
+
+          g_hash_table_remove (latency_samples, projection);
+        }
+      break;
+
+    case GIMP_LATENCY_N_STAGES:
+      break;
+    }
+
+  g_mutex_unlock (&latency_mutex);
+}
+
+/*  drops the pending sample of a projection which is going away  */
+void
+gimp_latency_forget (GimpProjection *projection)
+{
+  g_return_if_fail (projection != NULL);
+
+  g_mutex_lock (&latency_mutex);
+
+  if (latency_samples)
+    g_hash_table_remove (latency_samples, projection);
+
+  g_mutex_unlock (&latency_mutex);
+}
+
+guint64
+gimp_latency_get_n_samples (GimpLatencyStage stage)
+{
+  guint64 n_samples;
+
+  g_return_val_if_fail (stage < GIMP_LATENCY_N_STAGES, 0);
+
+  g_mutex_lock (&latency_mutex);
+
+  n_samples = latency_histograms[stage].n_samples;
+
+  g_mutex_unlock (&latency_mutex);
+
+  return n_samples;
+}
+
+/*  returns the latency, in seconds, which 'percentile' (from 0 to 1)
+ *  of the samples of 'stage' did not exceed, or FALSE if there are no
+ *  samples yet
+ */
+gboolean
+gimp_latency_get_percentile (GimpLatencyStage  stage,
+                             gdouble           percentile,
+                             gdouble          *latency)
+{
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (stage < GIMP_LATENCY_N_STAGES, FALSE);
+  g_return_val_if_fail (latency != NULL, FALSE);
+
+  g_mutex_lock (&latency_mutex);
+
+  if (latency_histograms[stage].n_samples)
+    {
+      *latency = gimp_latency_histogram_get_percentile (
+        &latency_histograms[stage], percentile) / G_TIME_SPAN_SECOND;
+
+      success = TRUE;
+    }
+
+  g_mutex_unlock (&latency_mutex);
+
+  return success;
+}
+
+void
+gimp_latency_reset (void)
+{
+  g_mutex_lock (&latency_mutex);
+
+  memset (latency_histograms, 0, sizeof (latency_histograms));
+
+  if (latency_samples)
+    g_hash_table_remove_all (latency_samples);
+
+  g_mutex_unlock (&latency_mutex);
+}
+
+/*  writes the collected latencies to 'file' as JSON, in milliseconds,
+ *  so that runs can be compared by scripts
+ */
+gboolean
+gimp_latency_save (GFile   *file,
+                   GError **error)
+{
+  LatencyHistogram  histograms[GIMP_LATENCY_N_STAGES];
+  GString          *str;
+  gboolean          success;
+  gint              stage;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_mutex_lock (&latency_mutex);
+
+  memcpy (histograms, latency_histograms, sizeof (histograms));
+
+  g_mutex_unlock (&latency_mutex);
+
+  str = g_string_new ("{\n  \"unit\": \"ms\",\n  \"stages\": [\n");
+
+  for (stage = 0; stage < GIMP_LATENCY_N_STAGES; stage++)
+    {
+      const LatencyHistogram *histogram = &histograms[stage];
+      gboolean                first     = TRUE;
+      gint                    i;
+
+      g_string_append_printf (str,
+                              "    {\n"
+                              "      \"name\": \"%s\",\n"
+                              "      \"samples\": %" G_GUINT64_FORMAT,
+                              stage_names[stage], histogram->n_samples);
+
+      if (histogram->n_samples)
+        {
+          g_string_append (str, ",\n      \"mean\": ");
+          gimp_latency_append_ms (str, (gdouble) histogram->total /
+                                       histogram->n_samples);
+          g_string_append (str, ",\n      \"max\": ");
+          gimp_latency_append_ms (str, histogram->max);
+          g_string_append (str, ",\n      \"p50\": ");
+          gimp_latency_append_ms (
+            str, gimp_latency_histogram_get_percentile (histogram, 0.50));
+          g_string_append (str, ",\n      \"p95\": ");
+          gimp_latency_append_ms (
+            str, gimp_latency_histogram_get_percentile (histogram, 0.95));
+          g_string_append (str, ",\n      \"p99\": ");
+          gimp_latency_append_ms (
+            str, gimp_latency_histogram_get_percentile (histogram, 0.99));
+        }
+
+      g_string_append (str, ",\n      \"histogram\": [");
+
+      for (i = 0; i < LATENCY_N_BUCKETS; i++)
+        {
+          if (! histogram->counts[i])
+            continue;
+
+          g_string_append (str, first ? "\n        [ " : ",\n        [ ");
+          gimp_latency_append_ms (str, gimp_latency_bucket_lower (i));
+          g_string_append (str, ", ");
+          gimp_latency_append_ms (str, gimp_latency_bucket_upper (i));
+          g_string_append_printf (str, ", %" G_GUINT64_FORMAT " ]",
+                                  histogram->counts[i]);
+
+          first = FALSE;
+        }
+
+      g_string_append (str, first ? "]\n" : "\n      ]\n");
+
+      g_string_append (str, stage < GIMP_LATENCY_N_STAGES - 1 ?
+                            "    },\n" : "    }\n");
+    }
+
+  g_string_append (str, "  ]\n}\n");
+
+  success = g_file_replace_contents (file, str->str, str->len,
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, error);
+
+  g_string_free (str, TRUE);
+
+  return success;
+}
+
+const gchar *
+gimp_latency_stage_get_name (GimpLatencyStage stage)
+{
+  g_return_val_if_fail (stage < GIMP_LATENCY_N_STAGES, NULL);
+
+  return stage_names[stage];
+}
+
+
+/*  private functions  */
+
+static void
+gimp_latency_add_sample (GimpLatencyStage stage,
+                         gint64           latency)
+{
+  LatencyHistogram *histogram = &latency_histograms[stage];
+
+  latency = MAX (latency, 0);
+
+  histogram->counts[gimp_latency_bucket_index (latency)]++;
+  histogram->n_samples++;
+  histogram->total += latency;
+  histogram->max    = MAX (histogram->max, latency);
+}
+
+static gint
+gimp_latency_bucket_index (gint64 latency)
+{
+  gint bucket;
+
+  if (latency < LATENCY_MIN)
+    return 0;
+
+  bucket = 1 + (gint) (log2 ((gdouble) latency / LATENCY_MIN) *
+                       LATENCY_BUCKETS_PER_OCTAVE);
+
+  return MIN (bucket, LATENCY_N_BUCKETS - 1);
+}
+
+static gdouble
+gimp_latency_bucket_lower (gint bucket)
+{
+  if (bucket == 0)
+    return 0.0;
+
+  return LATENCY_MIN * exp2 ((gdouble) (bucket - 1) /
+                             LATENCY_BUCKETS_PER_OCTAVE);
+}
+
+static gdouble
+gimp_latency_bucket_upper (gint bucket)
+{
+  return LATENCY_MIN * exp2 ((gdouble) bucket /
+                             LATENCY_BUCKETS_PER_OCTAVE);
+}
+
+static gdouble
+gimp_latency_histogram_get_percentile (const LatencyHistogram *histogram,
+                                       gdouble                 percentile)
+{
+  guint64 target;
+  guint64 count = 0;
+  gint    i;
+
+  percentile = CLAMP (percentile, 0.0, 1.0);
+
+  target = MAX (ceil (percentile * histogram->n_samples), 1);
+
+  for (i = 0; i < LATENCY_N_BUCKETS; i++)
+    {
+      count += histogram->counts[i];
+
+      if (count >= target)
+        break;
+    }
+
+  i = MIN (i, LATENCY_N_BUCKETS - 1);
+
+  /*  report the bucket's geometric center, but never more than the
+   *  largest latency actually seen
+   */
+  if (i == 0)
+    return MIN (LATENCY_MIN / 2.0, histogram->max);
+
+  return MIN (sqrt (gimp_latency_bucket_lower (i) *
+                    gimp_latency_bucket_upper (i)),
+              histogram->max);
+}
+
+static void
+gimp_latency_append_ms (GString *str,
+                        gdouble  usec)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append (str, g_ascii_formatd (buf, sizeof (buf), "%.3f",
+                                         usec / 1000.0));
+}
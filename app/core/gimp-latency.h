@@ -0,0 +1,57 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-latency.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __APP_GIMP_LATENCY_H__
+#define __APP_GIMP_LATENCY_H__
+
+
+/*  the stages a painting input event goes through until its pixels
+ *  are on screen, each measured from the time the event was received
+ */
+typedef enum
+{
+  GIMP_LATENCY_STAGE_PAINT,   /*  painted onto the drawable      */
+  GIMP_LATENCY_STAGE_UPDATE,  /*  rendered into the projection   */
+  GIMP_LATENCY_STAGE_DRAW,    /*  drawn on the canvas            */
+
+  GIMP_LATENCY_N_STAGES
+} GimpLatencyStage;
+
+
+void          gimp_latency_begin_input     (gint64             time);
+void          gimp_latency_end_input       (void);
+
+void          gimp_latency_mark            (GimpProjection    *projection,
+                                            GimpLatencyStage   stage);
+void          gimp_latency_forget          (GimpProjection    *projection);
+
+guint64       gimp_latency_get_n_samples   (GimpLatencyStage   stage);
+gboolean      gimp_latency_get_percentile  (GimpLatencyStage   stage,
+                                            gdouble            percentile,
+                                            gdouble           *latency);
+
+void          gimp_latency_reset           (void);
+
+gboolean      gimp_latency_save            (GFile             *file,
+                                            GError           **error);
+
+const gchar * gimp_latency_stage_get_name  (GimpLatencyStage   stage);
+
+
+#endif  /*  __APP_GIMP_LATENCY_H__  */
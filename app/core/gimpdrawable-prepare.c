@@ -0,0 +1,677 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cairo.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpcolor/gimpcolor.h"
+
+#include "core-types.h"
+
+#include "gegl/gimp-gegl-apply-operation.h"
+
+#include "gimpchannel.h"
+#include "gimpcontext.h"
+#include "gimpdrawable.h"
+#include "gimpdrawable-fill.h"
+#include "gimpdrawable-prepare.h"
+#include "gimpdrawable-private.h"
+#include "gimpdrawable-transform.h"
+#include "gimpprogress.h"
+
+#include "gimp-intl.h"
+
+
+typedef enum
+{
+  PREPARE_SCALE,
+  PREPARE_RESIZE,
+  PREPARE_FLIP,
+  PREPARE_ROTATE
+} PrepareType;
+
+struct _GimpDrawablePrepareJob
+{
+  PrepareType            type;
+  GimpDrawable          *drawable;
+  GimpContext           *context;
+
+  /*  the drawable's state when the job was added, a prepared buffer
+   *  is only used if it is still the same
+   */
+  GeglBuffer            *src_buffer;
+  gint                   src_offset_x;
+  gint                   src_offset_y;
+
+  gint                   width;
+  gint                   height;
+  GimpInterpolationType  interpolation_type;
+  GimpFillType           fill_type;
+  gint                   offset_x;
+  gint                   offset_y;
+  GimpOrientationType    flip_type;
+  gdouble                axis;
+  GimpRotationType       rotate_type;
+  gdouble                center_x;
+  gdouble                center_y;
+  gboolean               clip_result;
+
+  GeglBuffer            *buffer;
+  GimpColorProfile      *buffer_profile;
+  gint                   new_offset_x;
+  gint                   new_offset_y;
+};
+
+typedef struct _GimpDrawablePrepareJob GimpDrawablePrepareJob;
+
+struct _GimpDrawablePrepare
+{
+  GPtrArray *jobs;
+
+  GMutex     mutex;
+  GCond      cond;
+  gint       n_jobs_done;
+};
+
+
+/*  local function prototypes  */
+
+static GimpDrawablePrepareJob * gimp_drawable_prepare_add      (GimpDrawablePrepare    *prepare,
+                                                                PrepareType             type,
+                                                                GimpDrawable           *drawable,
+                                                                GimpContext            *context);
+static void                     gimp_drawable_prepare_job_fill (GimpDrawablePrepareJob *job);
+static void                     gimp_drawable_prepare_job_run  (GimpDrawablePrepareJob *job,
+                                                                GimpDrawablePrepare    *prepare);
+static void                     gimp_drawable_prepare_job_free (GimpDrawablePrepareJob *job);
+static gint                     gimp_drawable_prepare_job_cmp  (gconstpointer           a,
+                                                                gconstpointer           b);
+static GimpDrawablePrepareJob * gimp_drawable_take_prepared    (GimpDrawable           *drawable,
+                                                                PrepareType             type);
+
+
+/*  public functions  */
+
+GimpDrawablePrepare *
+gimp_drawable_prepare_new (void)
+{
+  GimpDrawablePrepare *prepare = g_slice_new0 (GimpDrawablePrepare);
+
+  prepare->jobs =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) gimp_drawable_prepare_job_free);
+
+  g_mutex_init (&prepare->mutex);
+  g_cond_init (&prepare->cond);
+
+  return prepare;
+}
+
+/*  drops the results which weren't picked up
+ */
+void
+gimp_drawable_prepare_free (GimpDrawablePrepare *prepare)
+{
+  g_return_if_fail (prepare != NULL);
+
+  g_ptr_array_free (prepare->jobs, TRUE);
+
+  g_mutex_clear (&prepare->mutex);
+  g_cond_clear (&prepare->cond);
+
+  g_slice_free (GimpDrawablePrepare, prepare);
+}
+
+gint
+gimp_drawable_prepare_get_n_jobs (GimpDrawablePrepare *prepare)
+{
+  g_return_val_if_fail (prepare != NULL, 0);
+
+  return prepare->jobs->len;
+}
+
+void
+gimp_drawable_prepare_add_scale (GimpDrawablePrepare   *prepare,
+                                 GimpDrawable          *drawable,
+                                 gint                   new_width,
+                                 gint                   new_height,
+                                 GimpInterpolationType  interpolation_type)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_if_fail (prepare != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (new_width > 0 && new_height > 0);
+
+  job = gimp_drawable_prepare_add (prepare, PREPARE_SCALE, drawable, NULL);
+
+  job->width              = new_width;
+  job->height             = new_height;
+  job->interpolation_type = interpolation_type;
+}
+
+void
+gimp_drawable_prepare_add_resize (GimpDrawablePrepare *prepare,
+                                  GimpDrawable        *drawable,
+                                  GimpContext         *context,
+                                  GimpFillType         fill_type,
+                                  gint                 new_width,
+                                  gint                 new_height,
+                                  gint                 offset_x,
+                                  gint                 offset_y)
+{
+  GimpDrawablePrepareJob *job;
+  GimpItem               *item;
+
+  g_return_if_fail (prepare != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (new_width > 0 && new_height > 0);
+
+  item = GIMP_ITEM (drawable);
+
+  /*  gimp_drawable_resize() doesn't do anything then  */
+  if (new_width  == gimp_item_get_width  (item) &&
+      new_height == gimp_item_get_height (item) &&
+      offset_x   == 0                           &&
+      offset_y   == 0)
+    return;
+
+  job = gimp_drawable_prepare_add (prepare, PREPARE_RESIZE, drawable, context);
+
+  job->width     = new_width;
+  job->height    = new_height;
+  job->fill_type = fill_type;
+  job->offset_x  = offset_x;
+  job->offset_y  = offset_y;
+
+  job->new_offset_x = job->src_offset_x - offset_x;
+  job->new_offset_y = job->src_offset_y - offset_y;
+}
+
+void
+gimp_drawable_prepare_add_flip (GimpDrawablePrepare *prepare,
+                                GimpDrawable        *drawable,
+                                GimpContext         *context,
+                                GimpOrientationType  flip_type,
+                                gdouble              axis,
+                                gboolean             clip_result)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_if_fail (prepare != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+
+  /*  clipping might fill with the context's background color, which
+   *  isn't something to do on a thread
+   */
+  if (clip_result                  &&
+      ! GIMP_IS_CHANNEL (drawable) &&
+      ! gimp_drawable_has_alpha (drawable))
+    return;
+
+  job = gimp_drawable_prepare_add (prepare, PREPARE_FLIP, drawable, context);
+
+  job->flip_type   = flip_type;
+  job->axis        = axis;
+  job->clip_result = clip_result;
+}
+
+void
+gimp_drawable_prepare_add_rotate (GimpDrawablePrepare *prepare,
+                                  GimpDrawable        *drawable,
+                                  GimpContext         *context,
+                                  GimpRotationType     rotate_type,
+                                  gdouble              center_x,
+                                  gdouble              center_y,
+                                  gboolean             clip_result)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_if_fail (prepare != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+
+  if (clip_result                  &&
+      ! GIMP_IS_CHANNEL (drawable) &&
+      ! gimp_drawable_has_alpha (drawable))
+    return;
+
+  job = gimp_drawable_prepare_add (prepare, PREPARE_ROTATE, drawable, context);
+
+  job->rotate_type = rotate_type;
+  job->center_x    = center_x;
+  job->center_y    = center_y;
+  job->clip_result = clip_result;
+}
+
+/*  computes all new buffers on up to 'n_threads' threads while this
+ *  thread reports the progress, and hands them to their drawables.
+ *  With fewer than two threads or jobs, nothing is computed and the
+ *  drawables do the work themselves, as usual.
+ */
+void
+gimp_drawable_prepare_run (GimpDrawablePrepare *prepare,
+                           gint                 n_threads,
+                           GimpProgress        *progress,
+                           gdouble              progress_start,
+                           gdouble              progress_end)
+{
+  GThreadPool *pool;
+  gint         n_jobs;
+  gint         i;
+
+  g_return_if_fail (prepare != NULL);
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+
+  n_jobs    = prepare->jobs->len;
+  n_threads = MIN (n_threads, n_jobs);
+
+  if (n_threads < 2)
+    return;
+
+  /*  start with the biggest drawables, so that the small ones fill
+   *  the gaps at the end
+   */
+  g_ptr_array_sort (prepare->jobs, gimp_drawable_prepare_job_cmp);
+
+  prepare->n_jobs_done = 0;
+
+  pool = g_thread_pool_new ((GFunc) gimp_drawable_prepare_job_run, prepare,
+                            n_threads, FALSE, NULL);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      GimpDrawablePrepareJob *job = g_ptr_array_index (prepare->jobs, i);
+
+      if (job->type == PREPARE_RESIZE)
+        gimp_drawable_prepare_job_fill (job);
+
+      g_thread_pool_push (pool, job, NULL);
+    }
+
+  g_mutex_lock (&prepare->mutex);
+
+  while (prepare->n_jobs_done < n_jobs)
+    {
+      gint n_jobs_done;
+
+      g_cond_wait (&prepare->cond, &prepare->mutex);
+
+      n_jobs_done = prepare->n_jobs_done;
+
+      g_mutex_unlock (&prepare->mutex);
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 progress_start +
+                                 (progress_end - progress_start) *
+                                 n_jobs_done / n_jobs);
+
+      g_mutex_lock (&prepare->mutex);
+    }
+
+  g_mutex_unlock (&prepare->mutex);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      GimpDrawablePrepareJob *job = g_ptr_array_index (prepare->jobs, i);
+
+      if (job->buffer)
+        job->drawable->private->prepared = job;
+    }
+}
+
+GeglBuffer *
+gimp_drawable_take_prepared_scale (GimpDrawable          *drawable,
+                                   gint                   new_width,
+                                   gint                   new_height,
+                                   GimpInterpolationType  interpolation_type)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  job = gimp_drawable_take_prepared (drawable, PREPARE_SCALE);
+
+  if (job                                          &&
+      job->width              == new_width         &&
+      job->height             == new_height        &&
+      job->interpolation_type == interpolation_type)
+    {
+      return g_steal_pointer (&job->buffer);
+    }
+
+  return NULL;
+}
+
+GeglBuffer *
+gimp_drawable_take_prepared_resize (GimpDrawable *drawable,
+                                    GimpFillType  fill_type,
+                                    gint          new_width,
+                                    gint          new_height,
+                                    gint          offset_x,
+                                    gint          offset_y)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  job = gimp_drawable_take_prepared (drawable, PREPARE_RESIZE);
+
+  if (job                            &&
+      job->fill_type == fill_type    &&
+      job->width     == new_width    &&
+      job->height    == new_height   &&
+      job->offset_x  == offset_x     &&
+      job->offset_y  == offset_y)
+    {
+      return g_steal_pointer (&job->buffer);
+    }
+
+  return NULL;
+}
+
+GeglBuffer *
+gimp_drawable_take_prepared_flip (GimpDrawable         *drawable,
+                                  GimpOrientationType   flip_type,
+                                  gdouble               axis,
+                                  gboolean              clip_result,
+                                  GimpColorProfile    **buffer_profile,
+                                  gint                 *new_offset_x,
+                                  gint                 *new_offset_y)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (buffer_profile != NULL, NULL);
+  g_return_val_if_fail (new_offset_x != NULL, NULL);
+  g_return_val_if_fail (new_offset_y != NULL, NULL);
+
+  job = gimp_drawable_take_prepared (drawable, PREPARE_FLIP);
+
+  if (job                                  &&
+      job->flip_type   == flip_type        &&
+      job->axis        == axis             &&
+      ! job->clip_result == ! clip_result)
+    {
+      *buffer_profile = job->buffer_profile;
+      *new_offset_x   = job->new_offset_x;
+      *new_offset_y   = job->new_offset_y;
+
+      return g_steal_pointer (&job->buffer);
+    }
+
+  return NULL;
+}
+
+GeglBuffer *
+gimp_drawable_take_prepared_rotate (GimpDrawable         *drawable,
+                                    GimpRotationType      rotate_type,
+                                    gdouble               center_x,
+                                    gdouble               center_y,
+                                    gboolean              clip_result,
+                                    GimpColorProfile    **buffer_profile,
+                                    gint                 *new_offset_x,
+                                    gint                 *new_offset_y)
+{
+  GimpDrawablePrepareJob *job;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (buffer_profile != NULL, NULL);
+  g_return_val_if_fail (new_offset_x != NULL, NULL);
+  g_return_val_if_fail (new_offset_y != NULL, NULL);
+
+  job = gimp_drawable_take_prepared (drawable, PREPARE_ROTATE);
+
+  if (job                                  &&
+      job->rotate_type == rotate_type      &&
+      job->center_x    == center_x         &&
+      job->center_y    == center_y         &&
+      ! job->clip_result == ! clip_result)
+    {
+      *buffer_profile = job->buffer_profile;
+      *new_offset_x   = job->new_offset_x;
+      *new_offset_y   = job->new_offset_y;
+
+      return g_steal_pointer (&job->buffer);
+    }
+
+  return NULL;
+}
+
+
+/*  private functions  */
+
+static GimpDrawablePrepareJob *
+gimp_drawable_prepare_add (GimpDrawablePrepare *prepare,
+                           PrepareType          type,
+                           GimpDrawable        *drawable,
+                           GimpContext         *context)
+{
+  GimpDrawablePrepareJob *job = g_slice_new0 (GimpDrawablePrepareJob);
+
+  job->type       = type;
+  job->drawable   = g_object_ref (drawable);
+  job->context    = context ? g_object_ref (context) : NULL;
+  job->src_buffer = g_object_ref (gimp_drawable_get_buffer (drawable));
+
+  gimp_item_get_offset (GIMP_ITEM (drawable),
+                        &job->src_offset_x, &job->src_offset_y);
+
+  /*  the color profiles are created on demand, make sure that
+   *  doesn't happen on the threads
+   */
+  job->buffer_profile =
+    gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (drawable));
+
+  g_ptr_array_add (prepare->jobs, job);
+
+  return job;
+}
+
+/*  filling uses the context and the image's color transforms, so the
+ *  new buffer of a resize is filled here and only the copying is left
+ *  to the threads
+ */
+static void
+gimp_drawable_prepare_job_fill (GimpDrawablePrepareJob *job)
+{
+  GimpItem *item = GIMP_ITEM (job->drawable);
+  gint      copy_width;
+  gint      copy_height;
+
+  job->buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                 job->width, job->height),
+                                 gegl_buffer_get_format (job->src_buffer));
+
+  if (! gimp_rectangle_intersect (job->src_offset_x, job->src_offset_y,
+                                  gimp_item_get_width  (item),
+                                  gimp_item_get_height (item),
+                                  job->new_offset_x, job->new_offset_y,
+                                  job->width, job->height,
+                                  NULL, NULL, &copy_width, &copy_height) ||
+      copy_width  != job->width                                         ||
+      copy_height != job->height)
+    {
+      GimpRGB      color;
+      GimpPattern *pattern;
+
+      gimp_get_fill_params (job->context, job->fill_type,
+                            &color, &pattern, NULL);
+      gimp_drawable_fill_buffer (job->drawable, job->buffer,
+                                 &color, pattern, 0, 0);
+    }
+}
+
+static void
+gimp_drawable_prepare_job_run (GimpDrawablePrepareJob *job,
+                               GimpDrawablePrepare    *prepare)
+{
+  GimpItem *item = GIMP_ITEM (job->drawable);
+
+  switch (job->type)
+    {
+    case PREPARE_SCALE:
+      job->buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                     job->width, job->height),
+                                     gegl_buffer_get_format (job->src_buffer));
+
+      gimp_gegl_apply_scale (job->src_buffer,
+                             NULL, NULL,
+                             job->buffer,
+                             job->interpolation_type,
+                             ((gdouble) job->width /
+                              gimp_item_get_width  (item)),
+                             ((gdouble) job->height /
+                              gimp_item_get_height (item)));
+      break;
+
+    case PREPARE_RESIZE:
+      {
+        gint copy_x, copy_y;
+        gint copy_width, copy_height;
+
+        if (gimp_rectangle_intersect (job->src_offset_x,
+                                      job->src_offset_y,
+                                      gimp_item_get_width  (item),
+                                      gimp_item_get_height (item),
+                                      job->new_offset_x,
+                                      job->new_offset_y,
+                                      job->width,
+                                      job->height,
+                                      &copy_x,
+                                      &copy_y,
+                                      &copy_width,
+                                      &copy_height) &&
+            copy_width && copy_height)
+          {
+            gegl_buffer_copy (job->src_buffer,
+                              GEGL_RECTANGLE (copy_x - job->src_offset_x,
+                                              copy_y - job->src_offset_y,
+                                              copy_width,
+                                              copy_height), GEGL_ABYSS_NONE,
+                              job->buffer,
+                              GEGL_RECTANGLE (copy_x - job->new_offset_x,
+                                              copy_y - job->new_offset_y,
+                                              0, 0));
+          }
+      }
+      break;
+
+    case PREPARE_FLIP:
+      job->buffer =
+        gimp_drawable_transform_buffer_flip (job->drawable, job->context,
+                                             job->src_buffer,
+                                             job->src_offset_x,
+                                             job->src_offset_y,
+                                             job->flip_type, job->axis,
+                                             job->clip_result,
+                                             &job->buffer_profile,
+                                             &job->new_offset_x,
+                                             &job->new_offset_y);
+      break;
+
+    case PREPARE_ROTATE:
+      job->buffer =
+        gimp_drawable_transform_buffer_rotate (job->drawable, job->context,
+                                               job->src_buffer,
+                                               job->src_offset_x,
+                                               job->src_offset_y,
+                                               job->rotate_type,
+                                               job->center_x, job->center_y,
+                                               job->clip_result,
+                                               &job->buffer_profile,
+                                               &job->new_offset_x,
+                                               &job->new_offset_y);
+      break;
+    }
+
+  g_mutex_lock (&prepare->mutex);
+
+  prepare->n_jobs_done++;
+
+  g_cond_signal (&prepare->cond);
+
+  g_mutex_unlock (&prepare->mutex);
+}
+
+static void
+gimp_drawable_prepare_job_free (GimpDrawablePrepareJob *job)
+{
+  if (job->drawable->private->prepared == job)
+    job->drawable->private->prepared = NULL;
+
+  g_clear_object (&job->buffer);
+  g_clear_object (&job->src_buffer);
+  g_clear_object (&job->context);
+  g_object_unref (job->drawable);
+
+  g_slice_free (GimpDrawablePrepareJob, job);
+}
+
+static gint
+gimp_drawable_prepare_job_cmp (gconstpointer a,
+                               gconstpointer b)
+{
+  GimpDrawablePrepareJob *job1 = *(GimpDrawablePrepareJob **) a;
+  GimpDrawablePrepareJob *job2 = *(GimpDrawablePrepareJob **) b;
+  gint64                  size1;
+  gint64                  size2;
+
+  size1 = ((gint64) gegl_buffer_get_width  (job1->src_buffer) *
+           (gint64) gegl_buffer_get_height (job1->src_buffer));
+  size2 = ((gint64) gegl_buffer_get_width  (job2->src_buffer) *
+           (gint64) gegl_buffer_get_height (job2->src_buffer));
+
+  return (size1 < size2) - (size1 > size2);
+}
+
+/*  detaches the drawable's prepared result if it is of 'type' and was
+ *  computed from the drawable's current buffer and position
+ */
+static GimpDrawablePrepareJob *
+gimp_drawable_take_prepared (GimpDrawable *drawable,
+                             PrepareType   type)
+{
+  GimpDrawablePrepareJob *job = drawable->private->prepared;
+  gint                    off_x, off_y;
+
+  if (! job)
+    return NULL;
+
+  drawable->private->prepared = NULL;
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+  if (job->type       == type                                &&
+      job->buffer                                            &&
+      job->src_buffer == gimp_drawable_get_buffer (drawable) &&
+      job->src_offset_x == off_x                             &&
+      job->src_offset_y == off_y)
+    {
+      return job;
+    }
+
+  return NULL;
+}
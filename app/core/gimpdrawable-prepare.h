@@ -0,0 +1,99 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_DRAWABLE_PREPARE_H__
+#define __GIMP_DRAWABLE_PREPARE_H__
+
+
+/*  A batch of drawables whose new buffers for a whole-image scale,
+ *  resize, flip or rotate are computed on several threads up front.
+ *  The results are picked up by the drawables' own implementations
+ *  when they are called with the same parameters, which still push
+ *  the undo steps and set the buffers on the main thread, in order.
+ */
+typedef struct _GimpDrawablePrepare GimpDrawablePrepare;
+
+
+GimpDrawablePrepare * gimp_drawable_prepare_new        (void);
+void                  gimp_drawable_prepare_free       (GimpDrawablePrepare   *prepare);
+
+gint                  gimp_drawable_prepare_get_n_jobs (GimpDrawablePrepare   *prepare);
+
+void                  gimp_drawable_prepare_add_scale  (GimpDrawablePrepare   *prepare,
+                                                        GimpDrawable          *drawable,
+                                                        gint                   new_width,
+                                                        gint                   new_height,
+                                                        GimpInterpolationType  interpolation_type);
+void                  gimp_drawable_prepare_add_resize (GimpDrawablePrepare   *prepare,
+                                                        GimpDrawable          *drawable,
+                                                        GimpContext           *context,
+                                                        GimpFillType           fill_type,
+                                                        gint                   new_width,
+                                                        gint                   new_height,
+                                                        gint                   offset_x,
+                                                        gint                   offset_y);
+void                  gimp_drawable_prepare_add_flip   (GimpDrawablePrepare   *prepare,
+                                                        GimpDrawable          *drawable,
+                                                        GimpContext           *context,
+                                                        GimpOrientationType    flip_type,
+                                                        gdouble                axis,
+                                                        gboolean               clip_result);
+void                  gimp_drawable_prepare_add_rotate (GimpDrawablePrepare   *prepare,
+                                                        GimpDrawable          *drawable,
+                                                        GimpContext           *context,
+                                                        GimpRotationType       rotate_type,
+                                                        gdouble                center_x,
+                                                        gdouble                center_y,
+                                                        gboolean               clip_result);
+
+void                  gimp_drawable_prepare_run        (GimpDrawablePrepare   *prepare,
+                                                        gint                   n_threads,
+                                                        GimpProgress          *progress,
+                                                        gdouble                progress_start,
+                                                        gdouble                progress_end);
+
+
+/*  used by GimpDrawable, return NULL if nothing matching was prepared  */
+
+GeglBuffer * gimp_drawable_take_prepared_scale  (GimpDrawable          *drawable,
+                                                 gint                   new_width,
+                                                 gint                   new_height,
+                                                 GimpInterpolationType  interpolation_type);
+GeglBuffer * gimp_drawable_take_prepared_resize (GimpDrawable          *drawable,
+                                                 GimpFillType           fill_type,
+                                                 gint                   new_width,
+                                                 gint                   new_height,
+                                                 gint                   offset_x,
+                                                 gint                   offset_y);
+GeglBuffer * gimp_drawable_take_prepared_flip   (GimpDrawable          *drawable,
+                                                 GimpOrientationType    flip_type,
+                                                 gdouble                axis,
+                                                 gboolean               clip_result,
+                                                 GimpColorProfile     **buffer_profile,
+                                                 gint                  *new_offset_x,
+                                                 gint                  *new_offset_y);
+GeglBuffer * gimp_drawable_take_prepared_rotate (GimpDrawable          *drawable,
+                                                 GimpRotationType       rotate_type,
+                                                 gdouble                center_x,
+                                                 gdouble                center_y,
+                                                 gboolean               clip_result,
+                                                 GimpColorProfile     **buffer_profile,
+                                                 gint                  *new_offset_x,
+                                                 gint                  *new_offset_y);
+
+
+#endif  /*  __GIMP_DRAWABLE_PREPARE_H__  */
@@ -33,6 +33,8 @@ struct _GimpDrawablePrivate
   GimpApplicator *fs_applicator;
 
   GeglNode       *mode_node;
+
+  struct _GimpDrawablePrepareJob *prepared; /* see gimpdrawable-prepare.c */
 };
 
 #endif /* __GIMP_DRAWABLE_PRIVATE_H__ */
@@ -37,6 +37,7 @@
 #include "gimpdrawable-combine.h"
 #include "gimpdrawable-fill.h"
 #include "gimpdrawable-floating-selection.h"
+#include "gimpdrawable-prepare.h"
 #include "gimpdrawable-preview.h"
 #include "gimpdrawable-private.h"
 #include "gimpdrawable-shadow.h"
@@ -461,18 +462,25 @@ gimp_drawable_scale (GimpItem              *item,
   GimpDrawable *drawable = GIMP_DRAWABLE (item);
   GeglBuffer   *new_buffer;
 
-  new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                new_width, new_height),
-                                gimp_drawable_get_format (drawable));
+  new_buffer = gimp_drawable_take_prepared_scale (drawable,
+                                                  new_width, new_height,
+                                                  interpolation_type);
 
-  gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
-                         progress, C_("undo-type", "Scale"),
-                         new_buffer,
-                         interpolation_type,
-                         ((gdouble) new_width /
-                          gimp_item_get_width  (item)),
-                         ((gdouble) new_height /
-                          gimp_item_get_height (item)));
+  if (! new_buffer)
+    {
+      new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                    new_width, new_height),
+                                    gimp_drawable_get_format (drawable));
+
+      gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
+                             progress, C_("undo-type", "Scale"),
+                             new_buffer,
+                             interpolation_type,
+                             ((gdouble) new_width /
+                              gimp_item_get_width  (item)),
+                             ((gdouble) new_height /
+                              gimp_item_get_height (item)));
+    }
 
   gimp_drawable_set_buffer_full (drawable, gimp_item_is_attached (item), NULL,
                                  new_buffer,
@@ -507,48 +515,55 @@ gimp_drawable_resize (GimpItem     *item,
   new_offset_x = gimp_item_get_offset_x (item) - offset_x;
   new_offset_y = gimp_item_get_offset_y (item) - offset_y;
 
-  intersect = gimp_rectangle_intersect (gimp_item_get_offset_x (item),
-                                        gimp_item_get_offset_y (item),
-                                        gimp_item_get_width (item),
-                                        gimp_item_get_height (item),
-                                        new_offset_x,
-                                        new_offset_y,
-                                        new_width,
-                                        new_height,
-                                        &copy_x,
-                                        &copy_y,
-                                        &copy_width,
-                                        &copy_height);
-
-  new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                new_width, new_height),
-                                gimp_drawable_get_format (drawable));
+  new_buffer = gimp_drawable_take_prepared_resize (drawable, fill_type,
+                                                   new_width, new_height,
+                                                   offset_x, offset_y);
 
-  if (! intersect              ||
-      copy_width  != new_width ||
-      copy_height != new_height)
+  if (! new_buffer)
     {
-      /*  Clear the new buffer if needed  */
+      intersect = gimp_rectangle_intersect (gimp_item_get_offset_x (item),
+                                            gimp_item_get_offset_y (item),
+                                            gimp_item_get_width (item),
+                                            gimp_item_get_height (item),
+                                            new_offset_x,
+                                            new_offset_y,
+                                            new_width,
+                                            new_height,
+                                            &copy_x,
+                                            &copy_y,
+                                            &copy_width,
+                                            &copy_height);
+
+      new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                    new_width, new_height),
+                                    gimp_drawable_get_format (drawable));
+
+      if (! intersect              ||
+          copy_width  != new_width ||
+          copy_height != new_height)
+        {
+          /*  Clear the new buffer if needed  */
 
-      GimpRGB      color;
-      GimpPattern *pattern;
+          GimpRGB      color;
+          GimpPattern *pattern;
 
-      gimp_get_fill_params (context, fill_type, &color, &pattern, NULL);
-      gimp_drawable_fill_buffer (drawable, new_buffer,
-                                 &color, pattern, 0, 0);
-    }
+          gimp_get_fill_params (context, fill_type, &color, &pattern, NULL);
+          gimp_drawable_fill_buffer (drawable, new_buffer,
+                                     &color, pattern, 0, 0);
+        }
 
-  if (intersect && copy_width && copy_height)
-    {
-      /*  Copy the pixels in the intersection  */
-      gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                        GEGL_RECTANGLE (copy_x - gimp_item_get_offset_x (item),
-                                        copy_y - gimp_item_get_offset_y (item),
-                                        copy_width,
-                                        copy_height), GEGL_ABYSS_NONE,
-                        new_buffer,
-                        GEGL_RECTANGLE (copy_x - new_offset_x,
-                                        copy_y - new_offset_y, 0, 0));
+      if (intersect && copy_width && copy_height)
+        {
+          /*  Copy the pixels in the intersection  */
+          gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
+                            GEGL_RECTANGLE (copy_x - gimp_item_get_offset_x (item),
+                                            copy_y - gimp_item_get_offset_y (item),
+                                            copy_width,
+                                            copy_height), GEGL_ABYSS_NONE,
+                            new_buffer,
+                            GEGL_RECTANGLE (copy_x - new_offset_x,
+                                            copy_y - new_offset_y, 0, 0));
+        }
     }
 
   gimp_drawable_set_buffer_full (drawable, gimp_item_is_attached (item), NULL,
@@ -572,13 +587,20 @@ gimp_drawable_flip (GimpItem            *item,
 
   gimp_item_get_offset (item, &off_x, &off_y);
 
-  buffer = gimp_drawable_transform_buffer_flip (drawable, context,
-                                                gimp_drawable_get_buffer (drawable),
-                                                off_x, off_y,
-                                                flip_type, axis,
-                                                clip_result,
-                                                &buffer_profile,
-                                                &new_off_x, &new_off_y);
+  buffer = gimp_drawable_take_prepared_flip (drawable,
+                                             flip_type, axis,
+                                             clip_result,
+                                             &buffer_profile,
+                                             &new_off_x, &new_off_y);
+
+  if (! buffer)
+    buffer = gimp_drawable_transform_buffer_flip (drawable, context,
+                                                  gimp_drawable_get_buffer (drawable),
+                                                  off_x, off_y,
+                                                  flip_type, axis,
+                                                  clip_result,
+                                                  &buffer_profile,
+                                                  &new_off_x, &new_off_y);
 
   if (buffer)
     {
@@ -604,13 +626,20 @@ gimp_drawable_rotate (GimpItem         *item,
 
   gimp_item_get_offset (item, &off_x, &off_y);
 
-  buffer = gimp_drawable_transform_buffer_rotate (drawable, context,
-                                                  gimp_drawable_get_buffer (drawable),
-                                                  off_x, off_y,
-                                                  rotate_type, center_x, center_y,
-                                                  clip_result,
-                                                  &buffer_profile,
-                                                  &new_off_x, &new_off_y);
+  buffer = gimp_drawable_take_prepared_rotate (drawable,
+                                               rotate_type, center_x, center_y,
+                                               clip_result,
+                                               &buffer_profile,
+                                               &new_off_x, &new_off_y);
+
+  if (! buffer)
+    buffer = gimp_drawable_transform_buffer_rotate (drawable, context,
+                                                    gimp_drawable_get_buffer (drawable),
+                                                    off_x, off_y,
+                                                    rotate_type, center_x, center_y,
+                                                    clip_result,
+                                                    &buffer_profile,
+                                                    &new_off_x, &new_off_y);
 
   if (buffer)
     {
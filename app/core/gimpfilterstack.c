@@ -184,9 +184,7 @@ gimp_filter_stack_new (GType filter_type)
 GeglNode *
 gimp_filter_stack_get_graph (GimpFilterStack *stack)
 {
-  GList    *list;
-  GeglNode *previous;
-  GeglNode *output;
+  GList *list;
 
   g_return_val_if_fail (GIMP_IS_FILTER_STACK (stack), NULL);
 
@@ -195,6 +193,35 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
 
   stack->graph = gegl_node_new ();
 
+  for (list = GIMP_LIST (stack)->queue->tail;
+       list;
+       list = g_list_previous (list))
+    {
+      GimpFilter *filter = list->data;
+
+      if (gimp_filter_get_active (filter))
+        gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
+    }
+
+  gimp_filter_stack_relink (stack);
+
+  return stack->graph;
+}
+
+/*  connects the nodes of all active filters from the bottom to the
+ *  top of the stack, undoing any rewiring of the graph done by
+ *  subclasses
+ */
+void
+gimp_filter_stack_relink (GimpFilterStack *stack)
+{
+  GList    *list;
+  GeglNode *previous;
+  GeglNode *output;
+
+  g_return_if_fail (GIMP_IS_FILTER_STACK (stack));
+  g_return_if_fail (stack->graph != NULL);
+
   previous = gegl_node_get_input_proxy (stack->graph, "input");
 
   for (list = GIMP_LIST (stack)->queue->tail;
@@ -209,8 +236,6 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
 
       node = gimp_filter_get_node (filter);
 
-      gegl_node_add_child (stack->graph, node);
-
       gegl_node_connect_to (previous, "output",
                             node,     "input");
 
@@ -221,8 +246,6 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
 
   gegl_node_connect_to (previous, "output",
                         output,   "input");
-
-  return stack->graph;
 }
 
 
@@ -50,6 +50,7 @@ GType           gimp_filter_stack_get_type  (void) G_GNUC_CONST;
 GimpContainer * gimp_filter_stack_new       (GType            filter_type);
 
 GeglNode *      gimp_filter_stack_get_graph (GimpFilterStack *stack);
+void            gimp_filter_stack_relink    (GimpFilterStack *stack);
 
 
 #endif  /*  __GIMP_FILTER_STACK_H__  */
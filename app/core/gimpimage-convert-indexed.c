@@ -143,6 +143,8 @@
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
@@ -190,6 +192,12 @@
 #define G_SCALE 24              /*  scale G (a*) distances by this much  */
 #define B_SCALE 26              /*  and B (b*) by this much              */
 
+/* rows of a layer histogrammed or mapped by one thread at a time */
+#define BAND_HEIGHT 128
+
+/* smaller layers aren't worth histogramming on several threads */
+#define MIN_THREADED_PIXELS (256 * 256)
+
 
 typedef struct _Color Color;
 typedef struct _QuantizeObj QuantizeObj;
@@ -488,8 +496,65 @@ struct _QuantizeObj
   GimpProgress *progress;
   gint          nth_layer;
   gint          n_layers;
+
+  const GeglRectangle *area;              /* part of the layer to map, or NULL */
 };
 
+typedef struct
+{
+  QuantizeObj *quantobj;
+  gint         next_slab;
+} InverseCmapJob;
+
+typedef struct
+{
+  GimpLayer   *layer;
+  gint         width;
+  gint         height;
+  gint         col_limit;
+  gboolean     dither_alpha;
+  gint         nth_layer;
+  gint         n_layers;
+
+  gint         n_bands;
+  gint         next_band;
+  gint         n_bands_done;
+
+  CFHistogram *histograms;                /* one per thread */
+  gint         next_histogram;
+
+  /*  while the colors are still being counted, the ones found in
+   *  each band, in the order they were found
+   */
+  guchar     (*band_cols)[MAXNUMCOLORS][3];
+  gint        *band_n_cols;
+  gboolean    *band_quantize;
+} HistogramJob;
+
+typedef struct
+{
+  GimpLayer  *layer;
+  gint        nth_layer;
+  GeglBuffer *new_buffer;                 /* NULL if not quantized */
+  gint        n_jobs;
+  gint        n_jobs_left;
+} RemapLayer;
+
+typedef struct
+{
+  RemapLayer    *remap_layer;
+  GeglRectangle  area;
+} RemapJob;
+
+typedef struct
+{
+  QuantizeObj *quantobj;
+  GMutex       mutex;
+  GCond        cond;
+  gint         n_jobs_done;
+  gulong       index_used_count[256];
+} RemapState;
+
 typedef struct
 {
   /*  The bounds of the box (inclusive); expressed as histogram indexes  */
@@ -521,13 +586,26 @@ static void          zero_histogram_rgb      (CFHistogram   histogram);
 static void          generate_histogram_gray (CFHistogram   hostogram,
                                               GimpLayer    *layer,
                                               gboolean      dither_alpha);
-static void          generate_histogram_rgb  (CFHistogram   histogram,
-                                              GimpLayer    *layer,
-                                              gint          col_limit,
-                                              gboolean      dither_alpha,
-                                              GimpProgress *progress,
-                                              gint          nth_layer,
-                                              gint          n_layers);
+static void          generate_histogram_rgb  (CFHistogram          histogram,
+                                              GimpLayer           *layer,
+                                              const GeglRectangle *area,
+                                              gint                 col_limit,
+                                              gboolean             dither_alpha,
+                                              guchar               cols[][3],
+                                              gint                *n_cols,
+                                              gboolean            *quantize,
+                                              GimpProgress        *progress,
+                                              gint                 nth_layer,
+                                              gint                 n_layers);
+static void          generate_histogram_rgb_threaded
+                                             (CFHistogram          histogram,
+                                              GimpLayer           *layer,
+                                              gint                 col_limit,
+                                              gboolean             dither_alpha,
+                                              GimpProgress        *progress,
+                                              gint                 nth_layer,
+                                              gint                 n_layers,
+                                              gint                 n_threads);
 
 static QuantizeObj * initialize_median_cut   (GimpImageBaseType      old_type,
                                               gint                   max_colors,
@@ -537,6 +615,14 @@ static QuantizeObj * initialize_median_cut   (GimpImageBaseType      old_type,
                                               gboolean               dither_alpha,
                                               GimpProgress          *progress);
 
+static void          remap_layers            (QuantizeObj           *quantobj,
+                                              GimpImage             *image,
+                                              GList                 *layers,
+                                              gboolean               dither_text_layers,
+                                              GimpColorProfile      *dest_profile,
+                                              GimpProgress          *progress,
+                                              gint                   n_threads);
+
 static void          compute_color_lin8      (QuantizeObj           *quantobj,
                                               CFHistogram            histogram,
                                               boxptr                 boxp,
@@ -767,6 +853,7 @@ gimp_image_convert_indexed (GimpImage               *image,
   GimpColorProfile  *dest_profile = NULL;
   gint               nth_layer;
   gint               n_layers;
+  gint               n_threads;
 
   g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
   g_return_val_if_fail (gimp_image_get_base_type (image) != GIMP_INDEXED, FALSE);
@@ -797,6 +884,8 @@ gimp_image_convert_indexed (GimpImage               *image,
 
   n_layers = g_list_length (all_layers);
 
+  n_threads = GIMP_GEGL_CONFIG (image->gimp->config)->num_processors;
+
   g_object_freeze_notify (G_OBJECT (image));
 
   gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_IMAGE_CONVERT,
@@ -866,6 +955,17 @@ gimp_image_convert_indexed (GimpImage               *image,
               generate_histogram_gray (quantobj->histogram,
                                        layer, dither_alpha);
             }
+          else if (n_threads > 1 &&
+                   gimp_item_get_width  (GIMP_ITEM (layer)) *
+                   gimp_item_get_height (GIMP_ITEM (layer)) >=
+                   MIN_THREADED_PIXELS)
+            {
+              generate_histogram_rgb_threaded (quantobj->histogram,
+                                               layer, max_colors,
+                                               dither_alpha,
+                                               progress, nth_layer, n_layers,
+                                               n_threads);
+            }
           else
             {
               /* Note: generate_histogram_rgb may set needs_quantize
@@ -873,7 +973,9 @@ gimp_image_convert_indexed (GimpImage               *image,
                * specified by the user.
                */
               generate_histogram_rgb (quantobj->histogram,
-                                      layer, max_colors, dither_alpha,
+                                      layer, NULL, max_colors, dither_alpha,
+                                      found_cols, &num_found_cols,
+                                      &needs_quantize,
                                       progress, nth_layer, n_layers);
             }
         }
@@ -955,53 +1057,10 @@ gimp_image_convert_indexed (GimpImage               *image,
   }
 
   /*  Convert all layers  */
-  if (quantobj)
-    quantobj->n_layers = n_layers;
-
-  for (list = all_layers, nth_layer = 0;
-       list;
-       list = g_list_next (list), nth_layer++)
-    {
-      GimpLayer *layer = list->data;
-      gboolean   quantize;
-
-      if (gimp_item_is_text_layer (GIMP_ITEM (layer)))
-        quantize = dither_text_layers;
-      else
-        quantize = TRUE;
-
-      if (quantize)
-        {
-          GeglBuffer *new_buffer;
-          gboolean    has_alpha;
-
-          has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+  quantobj->n_layers = n_layers;
 
-          new_buffer =
-            gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                             gimp_item_get_width  (GIMP_ITEM (layer)),
-                                             gimp_item_get_height (GIMP_ITEM (layer))),
-                             gimp_image_get_layer_format (image,
-                                                          has_alpha));
-
-          quantobj->nth_layer = nth_layer;
-          quantobj->second_pass (quantobj, layer, new_buffer);
-
-          gimp_drawable_set_buffer (GIMP_DRAWABLE (layer), TRUE, NULL,
-                                    new_buffer);
-          g_object_unref (new_buffer);
-        }
-      else
-        {
-          gimp_drawable_convert_type (GIMP_DRAWABLE (layer), image,
-                                      GIMP_INDEXED,
-                                      gimp_drawable_get_precision (GIMP_DRAWABLE (layer)),
-                                      gimp_drawable_has_alpha (GIMP_DRAWABLE (layer)),
-                                      dest_profile,
-                                      GEGL_DITHER_NONE, GEGL_DITHER_NONE,
-                                      TRUE, NULL);
-        }
-    }
+  remap_layers (quantobj, image, all_layers,
+                dither_text_layers, dest_profile, progress, n_threads);
 
   /*  Set the final palette on the image  */
   if (remove_duplicates && (palette_type != GIMP_CONVERT_PALETTE_GENERATE))
@@ -1142,13 +1201,17 @@ generate_histogram_gray (CFHistogram  histogram,
 
 
 static void
-generate_histogram_rgb (CFHistogram   histogram,
-                        GimpLayer    *layer,
-                        gint          col_limit,
-                        gboolean      dither_alpha,
-                        GimpProgress *progress,
-                        gint          nth_layer,
-                        gint          n_layers)
+generate_histogram_rgb (CFHistogram          histogram,
+                        GimpLayer           *layer,
+                        const GeglRectangle *area,
+                        gint                 col_limit,
+                        gboolean             dither_alpha,
+                        guchar               cols[][3],
+                        gint                *n_cols,
+                        gboolean            *quantize,
+                        GimpProgress        *progress,
+                        gint                 nth_layer,
+                        gint                 n_layers)
 {
   GeglBufferIterator *iter;
   const Babl         *format;
@@ -1176,10 +1239,10 @@ generate_histogram_rgb (CFHistogram   histogram,
   layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
                 gimp_item_get_height (GIMP_ITEM (layer)));
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, *n_cols); */
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+                                   area, 0, format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   roi = &iter->roi[0];
 
@@ -1195,7 +1258,7 @@ generate_histogram_rgb (CFHistogram   histogram,
 
       /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
 
-      if (needs_quantize)
+      if (*quantize)
         {
           if (dither_alpha)
             {
@@ -1286,15 +1349,15 @@ generate_histogram_rgb (CFHistogram   histogram,
                                       data[BLUE]);
                   (*colfreq)++;
 
-                  if (!needs_quantize)
+                  if (! *quantize)
                     {
                       for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
+                           nfc_iter < *n_cols;
                            nfc_iter++)
                         {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
+                          if ((data[RED]   == cols[nfc_iter][0]) &&
+                              (data[GREEN] == cols[nfc_iter][1]) &&
+                              (data[BLUE]  == cols[nfc_iter][2]))
                             goto already_found;
                         }
 
@@ -1302,16 +1365,16 @@ generate_histogram_rgb (CFHistogram   histogram,
                        * existing colors
                        */
 
-                      num_found_cols++;
+                      (*n_cols)++;
 
-                      if (num_found_cols > col_limit)
+                      if (*n_cols > col_limit)
                         {
                           /* There are more colors in the image than
                            *  were allowed.  We switch to plain
                            *  histogram calculation with a view to
                            *  quantizing at a later stage.
                            */
-                          needs_quantize = TRUE;
+                          *quantize = TRUE;
                           /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
                           goto already_found;
                         }
@@ -1319,9 +1382,9 @@ generate_histogram_rgb (CFHistogram   histogram,
                         {
                           /* Remember the new color we just found.
                            */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
+                          cols[*n_cols - 1][0] = data[RED];
+                          cols[*n_cols - 1][1] = data[GREEN];
+                          cols[*n_cols - 1][2] = data[BLUE];
                         }
                     }
                 }
@@ -1344,7 +1407,192 @@ generate_histogram_rgb (CFHistogram   histogram,
                                   layer_size) / (gdouble) n_layers);
     }
 
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, *n_cols);*/
+}
+
+static void
+generate_histogram_rgb_bands (HistogramJob *job,
+                              GimpProgress *progress)
+{
+  CFHistogram histogram = NULL;
+  gint        band;
+
+  while ((band = g_atomic_int_add (&job->next_band, 1)) < job->n_bands)
+    {
+      GeglRectangle area;
+      gint          n_done;
+
+      if (! histogram)
+        {
+          gint slot = g_atomic_int_add (&job->next_histogram, 1);
+
+          if (! job->histograms[slot])
+            job->histograms[slot] = g_new0 (ColorFreq,
+                                            HIST_R_ELEMS *
+                                            HIST_G_ELEMS *
+                                            HIST_B_ELEMS);
+
+          histogram = job->histograms[slot];
+        }
+
+      area.x      = 0;
+      area.y      = band * BAND_HEIGHT;
+      area.width  = job->width;
+      area.height = MIN (BAND_HEIGHT, job->height - area.y);
+
+      if (job->band_cols)
+        {
+          generate_histogram_rgb (histogram, job->layer, &area,
+                                  job->col_limit, job->dither_alpha,
+                                  job->band_cols[band],
+                                  &job->band_n_cols[band],
+                                  &job->band_quantize[band],
+                                  NULL, 0, 1);
+        }
+      else
+        {
+          gint     n_cols   = 0;
+          gboolean quantize = TRUE;
+
+          generate_histogram_rgb (histogram, job->layer, &area,
+                                  job->col_limit, job->dither_alpha,
+                                  NULL, &n_cols, &quantize,
+                                  NULL, 0, 1);
+        }
+
+      n_done = g_atomic_int_add (&job->n_bands_done, 1) + 1;
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 (job->nth_layer +
+                                  (gdouble) n_done / job->n_bands) /
+                                 (gdouble) job->n_layers);
+    }
+}
+
+/*  Histograms bands of the layer on several threads, each into its
+ *  own histogram, and sums them up afterwards.  While needs_quantize
+ *  isn't set yet, each band also collects its own colors, which are
+ *  merged into found_cols in band order, so the colors end up in the
+ *  same order as when histogramming the layer in one go.
+ */
+static void
+generate_histogram_rgb_threaded (CFHistogram   histogram,
+                                 GimpLayer    *layer,
+                                 gint          col_limit,
+                                 gboolean      dither_alpha,
+                                 GimpProgress *progress,
+                                 gint          nth_layer,
+                                 gint          n_layers,
+                                 gint          n_threads)
+{
+  HistogramJob  job = { 0, };
+  GThreadPool  *pool;
+  gint          i;
+
+  job.layer        = layer;
+  job.width        = gimp_item_get_width  (GIMP_ITEM (layer));
+  job.height       = gimp_item_get_height (GIMP_ITEM (layer));
+  job.col_limit    = col_limit;
+  job.dither_alpha = dither_alpha;
+  job.nth_layer    = nth_layer;
+  job.n_layers     = n_layers;
+  job.n_bands      = (job.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+  n_threads = MIN (n_threads, job.n_bands);
+
+  if (n_threads < 2)
+    {
+      generate_histogram_rgb (histogram, layer, NULL, col_limit, dither_alpha,
+                              found_cols, &num_found_cols, &needs_quantize,
+                              progress, nth_layer, n_layers);
+      return;
+    }
+
+  if (! needs_quantize)
+    {
+      job.band_cols     = g_malloc (job.n_bands * sizeof (*job.band_cols));
+      job.band_n_cols   = g_new0 (gint,     job.n_bands);
+      job.band_quantize = g_new0 (gboolean, job.n_bands);
+    }
+
+  /*  the first thread to start histograms right into the result  */
+  job.histograms    = g_new0 (CFHistogram, n_threads);
+  job.histograms[0] = histogram;
+
+  pool = g_thread_pool_new ((GFunc) generate_histogram_rgb_bands, NULL,
+                            n_threads - 1, TRUE, NULL);
+
+  for (i = 0; i < n_threads - 1; i++)
+    g_thread_pool_push (pool, &job, NULL);
+
+  /*  the calling thread takes part, and reports progress  */
+  generate_histogram_rgb_bands (&job, progress);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 1; i < n_threads; i++)
+    {
+      if (job.histograms[i])
+        {
+          gint n_cells = HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS;
+          gint j;
+
+          for (j = 0; j < n_cells; j++)
+            histogram[j] += job.histograms[i][j];
+
+          g_free (job.histograms[i]);
+        }
+    }
+
+  g_free (job.histograms);
+
+  if (job.band_cols)
+    {
+      gint band;
+
+      for (band = 0; band < job.n_bands && ! needs_quantize; band++)
+        {
+          gint c;
+
+          if (job.band_quantize[band])
+            needs_quantize = TRUE;
+
+          for (c = 0; c < job.band_n_cols[band] && ! needs_quantize; c++)
+            {
+              const guchar *col = job.band_cols[band][c];
+              gint          nfc_iter;
+
+              for (nfc_iter = 0; nfc_iter < num_found_cols; nfc_iter++)
+                {
+                  if (found_cols[nfc_iter][0] == col[0] &&
+                      found_cols[nfc_iter][1] == col[1] &&
+                      found_cols[nfc_iter][2] == col[2])
+                    break;
+                }
+
+              if (nfc_iter < num_found_cols)
+                continue;
+
+              num_found_cols++;
+
+              if (num_found_cols > col_limit)
+                {
+                  needs_quantize = TRUE;
+                }
+              else
+                {
+                  found_cols[num_found_cols - 1][0] = col[0];
+                  found_cols[num_found_cols - 1][1] = col[1];
+                  found_cols[num_found_cols - 1][2] = col[2];
+                }
+            }
+        }
+
+      g_free (job.band_cols);
+      g_free (job.band_n_cols);
+      g_free (job.band_quantize);
+    }
 }
 
 
@@ -2367,6 +2615,15 @@ select_colors_rgb (QuantizeObj *quantobj,
 #define BOX_G_SHIFT  (G_SHIFT + BOX_G_LOG)
 #define BOX_B_SHIFT  (B_SHIFT + BOX_B_LOG)
 
+/* when the whole inverse colormap is filled up front, bigger update
+ * boxes amortize find_nearby_colors() over more cells
+ */
+#define FULL_BOX_R_LOG 3
+#define FULL_BOX_G_LOG 2
+#define FULL_BOX_B_LOG 2
+
+#define MAX_BOX_ELEMS  (1 << (FULL_BOX_R_LOG + FULL_BOX_G_LOG + FULL_BOX_B_LOG))
+
 
 /*
  * The next three routines implement inverse colormap filling.  They
@@ -2390,6 +2647,9 @@ find_nearby_colors (QuantizeObj *quantobj,
                     int          minR,
                     int          minG,
                     int          minB,
+                    int          box_r_log,
+                    int          box_g_log,
+                    int          box_b_log,
                     int          colorlist[])
 {
   int numcolors = quantobj->actual_number_of_colors;
@@ -2405,11 +2665,11 @@ find_nearby_colors (QuantizeObj *quantobj,
    * Note that since ">>" rounds down, the "center" values may be closer to
    * min than to max; hence comparisons to them must be "<=", not "<".
    */
-  maxR = minR + ((1 << BOX_R_SHIFT) - (1 << R_SHIFT));
+  maxR = minR + ((1 << (R_SHIFT + box_r_log)) - (1 << R_SHIFT));
   centerR = (minR + maxR + 1) >> 1;
-  maxG = minG + ((1 << BOX_G_SHIFT) - (1 << G_SHIFT));
+  maxG = minG + ((1 << (G_SHIFT + box_g_log)) - (1 << G_SHIFT));
   centerG = (minG + maxG + 1) >> 1;
-  maxB = minB + ((1 << BOX_B_SHIFT) - (1 << B_SHIFT));
+  maxB = minB + ((1 << (B_SHIFT + box_b_log)) - (1 << B_SHIFT));
   centerB = (minB + maxB + 1) >> 1;
 
   /* For each color in colormap, find:
@@ -2548,6 +2808,9 @@ find_best_colors (QuantizeObj *quantobj,
                   gint         minR,
                   gint         minG,
                   gint         minB,
+                  gint         box_r_log,
+                  gint         box_g_log,
+                  gint         box_b_log,
                   gint         numcolors,
                   gint         colorlist[],
                   gint         bestcolor[])
@@ -2563,11 +2826,11 @@ find_best_colors (QuantizeObj *quantobj,
   gint  inR, inG, inB;    /* initial values for increments */
 
   /* This array holds the distance to the nearest-so-far color for each cell */
-  gint  bestdist[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+  gint  bestdist[MAX_BOX_ELEMS] = { 0, };
 
   /* Initialize best-distance for each cell of the update box */
   bptr = bestdist;
-  for (i = BOX_R_ELEMS*BOX_G_ELEMS*BOX_B_ELEMS-1; i >= 0; i--)
+  for (i = (1 << (box_r_log + box_g_log + box_b_log)) - 1; i >= 0; i--)
     *bptr++ = 0x7FFFFFFFL;
 
   /* For each color selected by find_nearby_colors,
@@ -2607,15 +2870,15 @@ find_best_colors (QuantizeObj *quantobj,
       bptr = bestdist;
       cptr = bestcolor;
       xx0 = inR;
-      for (iR = BOX_R_ELEMS-1; iR >= 0; iR--)
+      for (iR = (1 << box_r_log) - 1; iR >= 0; iR--)
         {
           dist1 = dist0;
           xx1 = inG;
-          for (iG = BOX_G_ELEMS-1; iG >= 0; iG--)
+          for (iG = (1 << box_g_log) - 1; iG >= 0; iG--)
             {
               dist2 = dist1;
               xx2 = inB;
-              for (iB = BOX_B_ELEMS-1; iB >= 0; iB--)
+              for (iB = (1 << box_b_log) - 1; iB >= 0; iB--)
                 {
                   if (dist2 < *bptr)
                     {
@@ -2670,16 +2933,18 @@ fill_inverse_cmap_gray (QuantizeObj *quantobj,
 }
 
 
-/* Fill the inverse-colormap entries in the update box that contains
- * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
- * can fill as many others as we wish.)
+/* Fill the inverse-colormap entries in the update box of the given
+ * size that contains histogram cell R/G/B.
  */
 static void
-fill_inverse_cmap_rgb (QuantizeObj *quantobj,
-                       CFHistogram  histogram,
-                       gint         R,
-                       gint         G,
-                       gint         B)
+fill_inverse_cmap_rgb_box (QuantizeObj *quantobj,
+                           CFHistogram  histogram,
+                           gint         R,
+                           gint         G,
+                           gint         B,
+                           gint         box_r_log,
+                           gint         box_g_log,
+                           gint         box_b_log)
 {
   gint  minR, minG, minB; /* lower left corner of update box */
   gint  iR, iG, iB;
@@ -2688,40 +2953,43 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
   gint  colorlist[MAXNUMCOLORS];
   gint  numcolors;                /* number of candidate colors */
   /* This array holds the actually closest colormap index for each cell. */
-  gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+  gint  bestcolor[MAX_BOX_ELEMS] = { 0, };
 
   /* Convert cell coordinates to update box id */
-  R >>= BOX_R_LOG;
-  G >>= BOX_G_LOG;
-  B >>= BOX_B_LOG;
+  R >>= box_r_log;
+  G >>= box_g_log;
+  B >>= box_b_log;
 
   /* Compute true coordinates of update box's origin corner.
    * Actually we compute the coordinates of the center of the corner
    * histogram cell, which are the lower bounds of the volume we care about.
    */
-  minR = (R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
-  minG = (G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
-  minB = (B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
+  minR = (R << (R_SHIFT + box_r_log)) + ((1 << R_SHIFT) >> 1);
+  minG = (G << (G_SHIFT + box_g_log)) + ((1 << G_SHIFT) >> 1);
+  minB = (B << (B_SHIFT + box_b_log)) + ((1 << B_SHIFT) >> 1);
 
   /* Determine which colormap entries are close enough to be candidates
    * for the nearest entry to some cell in the update box.
    */
-  numcolors = find_nearby_colors (quantobj, minR, minG, minB, colorlist);
+  numcolors = find_nearby_colors (quantobj, minR, minG, minB,
+                                  box_r_log, box_g_log, box_b_log,
+                                  colorlist);
 
   /* Determine the actually nearest colors. */
-  find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
-                    bestcolor);
+  find_best_colors (quantobj, minR, minG, minB,
+                    box_r_log, box_g_log, box_b_log,
+                    numcolors, colorlist, bestcolor);
 
   /* Save the best color numbers (plus 1) in the main cache array */
-  R <<= BOX_R_LOG;              /* convert id back to base cell indexes */
-  G <<= BOX_G_LOG;
-  B <<= BOX_B_LOG;
+  R <<= box_r_log;              /* convert id back to base cell indexes */
+  G <<= box_g_log;
+  B <<= box_b_log;
   cptr = bestcolor;
-  for (iR = 0; iR < BOX_R_ELEMS; iR++)
+  for (iR = 0; iR < (1 << box_r_log); iR++)
     {
-      for (iG = 0; iG < BOX_G_ELEMS; iG++)
+      for (iG = 0; iG < (1 << box_g_log); iG++)
         {
-          for (iB = 0; iB < BOX_B_ELEMS; iB++)
+          for (iB = 0; iB < (1 << box_b_log); iB++)
             {
               *HIST_LIN (histogram, R + iR, G + iG, B + iB) = (*cptr++) + 1;
             }
@@ -2730,6 +2998,87 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
 }
 
 
+/* Fill the inverse-colormap entries in the update box that contains
+ * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
+ * can fill as many others as we wish.)
+ */
+static void
+fill_inverse_cmap_rgb (QuantizeObj *quantobj,
+                       CFHistogram  histogram,
+                       gint         R,
+                       gint         G,
+                       gint         B)
+{
+  fill_inverse_cmap_rgb_box (quantobj, histogram, R, G, B,
+                             BOX_R_LOG, BOX_G_LOG, BOX_B_LOG);
+}
+
+
+/* Fill the complete inverse colormap, so that the second pass only
+ * ever reads the histogram and can map pixels on several threads at
+ * once.  Each thread fills slabs of update boxes along the R axis.
+ */
+static void
+fill_inverse_cmap_rgb_slabs (InverseCmapJob *job,
+                             gpointer        unused)
+{
+  QuantizeObj *quantobj = job->quantobj;
+  gint         slab;
+
+  while ((slab = g_atomic_int_add (&job->next_slab, 1)) <
+         (HIST_R_ELEMS >> FULL_BOX_R_LOG))
+    {
+      gint R = slab << FULL_BOX_R_LOG;
+      gint G, B;
+
+      for (G = 0; G < HIST_G_ELEMS; G += 1 << FULL_BOX_G_LOG)
+        for (B = 0; B < HIST_B_ELEMS; B += 1 << FULL_BOX_B_LOG)
+          {
+            fill_inverse_cmap_rgb_box (quantobj, quantobj->histogram,
+                                       R, G, B,
+                                       FULL_BOX_R_LOG,
+                                       FULL_BOX_G_LOG,
+                                       FULL_BOX_B_LOG);
+          }
+    }
+}
+
+static void
+fill_inverse_cmap_rgb_all (QuantizeObj *quantobj,
+                           gint         n_threads)
+{
+  InverseCmapJob  job  = { 0, };
+  GThreadPool    *pool = NULL;
+  gint            i;
+
+  job.quantobj  = quantobj;
+  job.next_slab = 0;
+
+  if (n_threads > 1)
+    {
+      pool = g_thread_pool_new ((GFunc) fill_inverse_cmap_rgb_slabs, NULL,
+                                n_threads - 1, TRUE, NULL);
+
+      for (i = 0; i < n_threads - 1; i++)
+        g_thread_pool_push (pool, &job, NULL);
+    }
+
+  fill_inverse_cmap_rgb_slabs (&job, NULL);
+
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+static void
+fill_inverse_cmap_gray_all (QuantizeObj *quantobj)
+{
+  gint pixel;
+
+  for (pixel = 0; pixel < 256; pixel++)
+    fill_inverse_cmap_gray (quantobj, quantobj->histogram, pixel);
+}
+
+
 /*  This is pass 1  */
 
 static void
@@ -2834,12 +3183,12 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   quantobj->area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   src_roi = &iter->roi[0];
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            quantobj->area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -2940,12 +3289,12 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   quantobj->area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   src_roi = &iter->roi[0];
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            quantobj->area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -3121,12 +3470,12 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   quantobj->area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   src_roi = &iter->roi[0];
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            quantobj->area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
@@ -3257,12 +3606,12 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   quantobj->area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   src_roi = &iter->roi[0];
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            quantobj->area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
@@ -3472,12 +3821,12 @@ median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   quantobj->area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   src_roi = &iter->roi[0];
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            quantobj->area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -4343,6 +4692,7 @@ initialize_median_cut (GimpImageBaseType       type,
   quantobj->desired_number_of_colors = num_colors;
   quantobj->want_dither_alpha        = want_dither_alpha;
   quantobj->progress                 = progress;
+  quantobj->area                     = NULL;
 
   switch (type)
     {
@@ -4475,3 +4825,216 @@ initialize_median_cut (GimpImageBaseType       type,
 
   return quantobj;
 }
+
+
+/*  Maps one area of a layer using a private copy of the quantizer,
+ *  so that the index counts aren't shared between threads.  Only the
+ *  main thread passes a progress.
+ */
+static void
+remap_area (RemapState          *state,
+            RemapLayer          *remap_layer,
+            const GeglRectangle *area,
+            GimpProgress        *progress)
+{
+  QuantizeObj quantobj = *state->quantobj;
+  gint        i;
+
+  quantobj.area      = area;
+  quantobj.progress  = progress;
+  quantobj.nth_layer = remap_layer->nth_layer;
+
+  memset (quantobj.index_used_count, 0, sizeof (quantobj.index_used_count));
+
+  quantobj.second_pass (&quantobj, remap_layer->layer, remap_layer->new_buffer);
+
+  g_mutex_lock (&state->mutex);
+
+  for (i = 0; i < quantobj.actual_number_of_colors; i++)
+    state->index_used_count[i] += quantobj.index_used_count[i];
+
+  g_mutex_unlock (&state->mutex);
+}
+
+static void
+remap_job_run (RemapJob   *job,
+               RemapState *state)
+{
+  remap_area (state, job->remap_layer, &job->area, NULL);
+
+  g_mutex_lock (&state->mutex);
+
+  job->remap_layer->n_jobs_left--;
+  state->n_jobs_done++;
+
+  g_cond_signal (&state->cond);
+
+  g_mutex_unlock (&state->mutex);
+
+  g_slice_free (RemapJob, job);
+}
+
+/*  Maps all layers to the colormap.  Layers are split into bands of
+ *  rows which are mapped on worker threads, except with error
+ *  diffusion, where the error travels down the whole layer and each
+ *  layer is one job, so that different layers are dithered at the same
+ *  time.  The new buffers are set on the layers here, in layer order,
+ *  as soon as all of a layer's jobs are done.
+ */
+static void
+remap_layers (QuantizeObj      *quantobj,
+              GimpImage        *image,
+              GList            *layers,
+              gboolean          dither_text_layers,
+              GimpColorProfile *dest_profile,
+              GimpProgress     *progress,
+              gint              n_threads)
+{
+  RemapState   state;
+  RemapLayer  *remaps;
+  GThreadPool *pool = NULL;
+  GList       *list;
+  gboolean     fs_dither;
+  gint         n_layers;
+  gint         n_jobs = 0;
+  gint         i;
+
+  fs_dither = (quantobj->second_pass == median_cut_pass2_fs_dither_rgb ||
+               quantobj->second_pass == median_cut_pass2_fs_dither_gray);
+
+  n_threads = MAX (n_threads, 1);
+
+  /*  with more than one thread, the inverse colormap can't be filled
+   *  lazily, fill it completely before mapping anything
+   */
+  if (n_threads > 1)
+    {
+      if (quantobj->second_pass_init == median_cut_pass2_rgb_init)
+        fill_inverse_cmap_rgb_all (quantobj, n_threads);
+      else if (quantobj->second_pass_init == median_cut_pass2_gray_init)
+        fill_inverse_cmap_gray_all (quantobj);
+
+      pool = g_thread_pool_new ((GFunc) remap_job_run, &state,
+                                n_threads, FALSE, NULL);
+    }
+
+  state.quantobj    = quantobj;
+  state.n_jobs_done = 0;
+  g_mutex_init (&state.mutex);
+  g_cond_init (&state.cond);
+  memset (state.index_used_count, 0, sizeof (state.index_used_count));
+
+  n_layers     = g_list_length (layers);
+  remaps       = g_new0 (RemapLayer, n_layers);
+
+  /*  queue the jobs in layer order, so that layers are finished in
+   *  about the order we commit them below
+   */
+  for (list = layers, i = 0; list; list = g_list_next (list), i++)
+    {
+      GimpLayer  *layer       = list->data;
+      RemapLayer *remap_layer = &remaps[i];
+      gint        width       = gimp_item_get_width  (GIMP_ITEM (layer));
+      gint        height      = gimp_item_get_height (GIMP_ITEM (layer));
+      gint        band_height;
+      gint        y;
+
+      remap_layer->layer     = layer;
+      remap_layer->nth_layer = i;
+
+      if (gimp_item_is_text_layer (GIMP_ITEM (layer)) && ! dither_text_layers)
+        continue;
+
+      remap_layer->new_buffer =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                         gimp_image_get_layer_format (image,
+                                                      gimp_drawable_has_alpha (GIMP_DRAWABLE (layer))));
+
+      /*  a group's buffer is its projection, which may only be
+       *  rendered on this thread; it is mapped when it is committed
+       */
+      if (! pool || gimp_viewable_get_children (GIMP_VIEWABLE (layer)))
+        continue;
+
+      band_height = fs_dither ? height : BAND_HEIGHT;
+
+      remap_layer->n_jobs      = (height + band_height - 1) / band_height;
+      remap_layer->n_jobs_left = remap_layer->n_jobs;
+
+      n_jobs += remap_layer->n_jobs;
+
+      for (y = 0; y < height; y += band_height)
+        {
+          RemapJob *job = g_slice_new (RemapJob);
+
+          job->remap_layer = remap_layer;
+          job->area.x      = 0;
+          job->area.y      = y;
+          job->area.width  = width;
+          job->area.height = MIN (band_height, height - y);
+
+          g_thread_pool_push (pool, job, NULL);
+        }
+    }
+
+  for (i = 0; i < n_layers; i++)
+    {
+      RemapLayer *remap_layer = &remaps[i];
+      GimpLayer  *layer       = remap_layer->layer;
+
+      if (! remap_layer->new_buffer)
+        {
+          gimp_drawable_convert_type (GIMP_DRAWABLE (layer), image,
+                                      GIMP_INDEXED,
+                                      gimp_drawable_get_precision (GIMP_DRAWABLE (layer)),
+                                      gimp_drawable_has_alpha (GIMP_DRAWABLE (layer)),
+                                      dest_profile,
+                                      GEGL_DITHER_NONE, GEGL_DITHER_NONE,
+                                      TRUE, NULL);
+          continue;
+        }
+
+      if (! remap_layer->n_jobs)
+        {
+          remap_area (&state, remap_layer, NULL, pool ? NULL : progress);
+        }
+      else
+        {
+          g_mutex_lock (&state.mutex);
+
+          while (remap_layer->n_jobs_left > 0)
+            {
+              gint n_jobs_done;
+
+              g_cond_wait (&state.cond, &state.mutex);
+
+              n_jobs_done = state.n_jobs_done;
+
+              g_mutex_unlock (&state.mutex);
+
+              if (progress)
+                gimp_progress_set_value (progress,
+                                         (gdouble) n_jobs_done / n_jobs);
+
+              g_mutex_lock (&state.mutex);
+            }
+
+          g_mutex_unlock (&state.mutex);
+        }
+
+      gimp_drawable_set_buffer (GIMP_DRAWABLE (layer), TRUE, NULL,
+                                remap_layer->new_buffer);
+      g_object_unref (remap_layer->new_buffer);
+    }
+
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < 256; i++)
+    quantobj->index_used_count[i] += state.index_used_count[i];
+
+  g_mutex_clear (&state.mutex);
+  g_cond_clear (&state.cond);
+
+  g_free (remaps);
+}
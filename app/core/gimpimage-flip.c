@@ -22,9 +22,13 @@
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-prepare.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
 #include "gimpimage-flip.h"
@@ -33,9 +37,13 @@
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
 #include "gimpitem.h"
+#include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpprogress.h"
 #include "gimpsamplepoint.h"
 
+#include "text/gimptextlayer.h"
+
 
 void
 gimp_image_flip (GimpImage           *image,
@@ -43,10 +51,11 @@ gimp_image_flip (GimpImage           *image,
                  GimpOrientationType  flip_type,
                  GimpProgress        *progress)
 {
-  GList   *list;
-  gdouble  axis;
-  gdouble  progress_max;
-  gdouble  progress_current = 1.0;
+  GimpDrawablePrepare *prepare;
+  GList               *list;
+  gdouble              axis;
+  gdouble              progress_max;
+  gdouble              progress_current = 1.0;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -76,6 +85,54 @@ gimp_image_flip (GimpImage           *image,
 
   gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_IMAGE_FLIP, NULL);
 
+  /*  Flip the pixels of all drawables at once, the loops below then
+   *  just pick them up
+   */
+  prepare = gimp_drawable_prepare_new ();
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      gimp_drawable_prepare_add_flip (prepare, list->data, context,
+                                      flip_type, axis, TRUE);
+    }
+
+  gimp_drawable_prepare_add_flip (prepare,
+                                  GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                                  context, flip_type, axis, TRUE);
+
+  list = gimp_image_get_layer_list (image);
+
+  while (list)
+    {
+      GimpItem *item = list->data;
+
+      /*  group layers flip their children, text layers may rerender  */
+      if (! gimp_viewable_get_children (GIMP_VIEWABLE (item)) &&
+          ! gimp_item_is_text_layer (item))
+        {
+          GimpLayerMask *mask = gimp_layer_get_mask (GIMP_LAYER (item));
+
+          gimp_drawable_prepare_add_flip (prepare, GIMP_DRAWABLE (item),
+                                          context, flip_type, axis, FALSE);
+
+          if (mask)
+            gimp_drawable_prepare_add_flip (prepare, GIMP_DRAWABLE (mask),
+                                            context, flip_type, axis, FALSE);
+        }
+
+      list = g_list_delete_link (list, list);
+    }
+
+  progress_max     += gimp_drawable_prepare_get_n_jobs (prepare);
+  progress_current += gimp_drawable_prepare_get_n_jobs (prepare);
+
+  gimp_drawable_prepare_run (prepare,
+                             GIMP_GEGL_CONFIG (image->gimp->config)->num_processors,
+                             progress,
+                             0.0, (progress_current - 1.0) / progress_max);
+
   /*  Flip all channels  */
   for (list = gimp_image_get_channel_iter (image);
        list;
@@ -177,5 +234,7 @@ gimp_image_flip (GimpImage           *image,
 
   gimp_image_undo_group_end (image);
 
+  gimp_drawable_prepare_free (prepare);
+
   gimp_unset_busy (image->gimp);
 }
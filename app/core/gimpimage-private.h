@@ -76,6 +76,7 @@ struct _GimpImagePrivate
   GFile             *untitled_file;         /*  a file saying "Untitled"     */
 
   gboolean           xcf_compression;       /*  XCF compression enabled?     */
+  gint64             xcf_save_memsize;      /*  kept for incremental saves   */
 
   gint               dirty;                 /*  dirty flag -- # of ops       */
   gint64             dirty_time;            /*  time when image became dirty */
@@ -24,9 +24,13 @@
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-prepare.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
 #include "gimpimage-guides.h"
@@ -36,6 +40,7 @@
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
 #include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpprogress.h"
 #include "gimpsamplepoint.h"
 
@@ -71,11 +76,13 @@ gimp_image_resize_with_layers (GimpImage    *image,
                                gboolean      resize_text_layers,
                                GimpProgress *progress)
 {
-  GList   *list;
-  GList   *resize_layers;
-  gdouble  progress_max;
-  gdouble  progress_current = 1.0;
-  gint     old_width, old_height;
+  GimpDrawablePrepare *prepare;
+  GList               *list;
+  GList               *resize_layers;
+  gdouble              progress_max;
+  gdouble              progress_current = 1.0;
+  gint                 old_width, old_height;
+  gint                 n_threads;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -102,6 +109,8 @@ gimp_image_resize_with_layers (GimpImage    *image,
   old_width  = gimp_image_get_width  (image);
   old_height = gimp_image_get_height (image);
 
+  n_threads = GIMP_GEGL_CONFIG (image->gimp->config)->num_processors;
+
   /*  Push the image size to the stack  */
   gimp_image_undo_push_image_size (image, NULL,
                                    -offset_x, -offset_y,
@@ -113,6 +122,33 @@ gimp_image_resize_with_layers (GimpImage    *image,
                 "height", new_height,
                 NULL);
 
+  /*  Copy the pixels of all channels at once, the loop below then
+   *  just picks them up
+   */
+  prepare = gimp_drawable_prepare_new ();
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      gimp_drawable_prepare_add_resize (prepare, list->data,
+                                        context, GIMP_FILL_TRANSPARENT,
+                                        new_width, new_height,
+                                        offset_x, offset_y);
+    }
+
+  gimp_drawable_prepare_add_resize (prepare,
+                                    GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                                    context, GIMP_FILL_TRANSPARENT,
+                                    new_width, new_height,
+                                    offset_x, offset_y);
+
+  progress_max     += gimp_drawable_prepare_get_n_jobs (prepare);
+  progress_current += gimp_drawable_prepare_get_n_jobs (prepare);
+
+  gimp_drawable_prepare_run (prepare, n_threads, progress,
+                             0.0, (progress_current - 1.0) / progress_max);
+
   /*  Resize all channels  */
   for (list = gimp_image_get_channel_iter (image);
        list;
@@ -162,6 +198,51 @@ gimp_image_resize_with_layers (GimpImage    *image,
         gimp_progress_set_value (progress, progress_current++ / progress_max);
     }
 
+  gimp_drawable_prepare_free (prepare);
+
+  /*  Same for the layers, now that they are in place  */
+  prepare = gimp_drawable_prepare_new ();
+
+  for (list = resize_layers; list; list = g_list_next (list))
+    {
+      GimpItem      *item = list->data;
+      GimpLayerMask *mask;
+      gint           old_offset_x;
+      gint           old_offset_y;
+
+      if (gimp_viewable_get_children (GIMP_VIEWABLE (item)))
+        continue;
+
+      if (! resize_text_layers && gimp_item_is_text_layer (item))
+        continue;
+
+      gimp_item_get_offset (item, &old_offset_x, &old_offset_y);
+
+      gimp_drawable_prepare_add_resize (prepare, GIMP_DRAWABLE (item),
+                                        context, fill_type,
+                                        new_width, new_height,
+                                        old_offset_x, old_offset_y);
+
+      mask = gimp_layer_get_mask (GIMP_LAYER (item));
+
+      if (mask)
+        gimp_drawable_prepare_add_resize (prepare, GIMP_DRAWABLE (mask),
+                                          context, GIMP_FILL_TRANSPARENT,
+                                          new_width, new_height,
+                                          old_offset_x, old_offset_y);
+    }
+
+  {
+    gdouble progress_start = (progress_current - 1.0) / progress_max;
+
+    progress_max     += gimp_drawable_prepare_get_n_jobs (prepare);
+    progress_current += gimp_drawable_prepare_get_n_jobs (prepare);
+
+    gimp_drawable_prepare_run (prepare, n_threads, progress,
+                               progress_start,
+                               (progress_current - 1.0) / progress_max);
+  }
+
   /*  Resize all resize_layers to image size  */
   for (list = resize_layers; list; list = g_list_next (list))
     {
@@ -188,6 +269,8 @@ gimp_image_resize_with_layers (GimpImage    *image,
 
   g_list_free (resize_layers);
 
+  gimp_drawable_prepare_free (prepare);
+
   /*  Reposition or remove all guides  */
   list = gimp_image_get_guides (image);
 
@@ -22,9 +22,13 @@
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
+#include "gimpdrawable-prepare.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
 #include "gimpimage-rotate.h"
@@ -33,9 +37,13 @@
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
 #include "gimpitem.h"
+#include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpprogress.h"
 #include "gimpsamplepoint.h"
 
+#include "text/gimptextlayer.h"
+
 
 static void  gimp_image_rotate_item_offset   (GimpImage        *image,
                                               GimpRotationType  rotate_type,
@@ -54,18 +62,19 @@ gimp_image_rotate (GimpImage        *image,
                    GimpRotationType  rotate_type,
                    GimpProgress     *progress)
 {
-  GList    *list;
-  gdouble   center_x;
-  gdouble   center_y;
-  gdouble   progress_max;
-  gdouble   progress_current = 1.0;
-  gint      new_image_width;
-  gint      new_image_height;
-  gint      previous_image_width;
-  gint      previous_image_height;
-  gint      offset_x;
-  gint      offset_y;
-  gboolean  size_changed;
+  GimpDrawablePrepare *prepare;
+  GList               *list;
+  gdouble              center_x;
+  gdouble              center_y;
+  gdouble              progress_max;
+  gdouble              progress_current = 1.0;
+  gint                 new_image_width;
+  gint                 new_image_height;
+  gint                 previous_image_width;
+  gint                 previous_image_height;
+  gint                 offset_x;
+  gint                 offset_y;
+  gboolean             size_changed;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -113,6 +122,58 @@ gimp_image_rotate (GimpImage        *image,
 
   gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_IMAGE_ROTATE, NULL);
 
+  /*  Rotate the pixels of all drawables at once, the loops below then
+   *  just pick them up
+   */
+  prepare = gimp_drawable_prepare_new ();
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      gimp_drawable_prepare_add_rotate (prepare, list->data, context,
+                                        rotate_type, center_x, center_y,
+                                        FALSE);
+    }
+
+  gimp_drawable_prepare_add_rotate (prepare,
+                                    GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                                    context, rotate_type, center_x, center_y,
+                                    FALSE);
+
+  list = gimp_image_get_layer_list (image);
+
+  while (list)
+    {
+      GimpItem *item = list->data;
+
+      /*  group layers rotate their children, text layers may rerender  */
+      if (! gimp_viewable_get_children (GIMP_VIEWABLE (item)) &&
+          ! gimp_item_is_text_layer (item))
+        {
+          GimpLayerMask *mask = gimp_layer_get_mask (GIMP_LAYER (item));
+
+          gimp_drawable_prepare_add_rotate (prepare, GIMP_DRAWABLE (item),
+                                            context, rotate_type,
+                                            center_x, center_y, FALSE);
+
+          if (mask)
+            gimp_drawable_prepare_add_rotate (prepare, GIMP_DRAWABLE (mask),
+                                              context, rotate_type,
+                                              center_x, center_y, FALSE);
+        }
+
+      list = g_list_delete_link (list, list);
+    }
+
+  progress_max     += gimp_drawable_prepare_get_n_jobs (prepare);
+  progress_current += gimp_drawable_prepare_get_n_jobs (prepare);
+
+  gimp_drawable_prepare_run (prepare,
+                             GIMP_GEGL_CONFIG (image->gimp->config)->num_processors,
+                             progress,
+                             0.0, (progress_current - 1.0) / progress_max);
+
   /*  Rotate all channels  */
   for (list = gimp_image_get_channel_iter (image);
        list;
@@ -229,6 +290,8 @@ gimp_image_rotate (GimpImage        *image,
 
   gimp_image_undo_group_end (image);
 
+  gimp_drawable_prepare_free (prepare);
+
   if (size_changed)
     gimp_image_size_changed_detailed (image,
                                       -offset_x,
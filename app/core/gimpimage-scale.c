@@ -20,10 +20,16 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
+#include "gimpdrawable-prepare.h"
 #include "gimpguide.h"
 #include "gimpgrouplayer.h"
 #include "gimpimage.h"
@@ -38,10 +44,23 @@
 #include "gimpsamplepoint.h"
 #include "gimpsubprogress.h"
 
+#include "text/gimptextlayer.h"
+
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
 
+/*  local function prototypes  */
+
+static void   gimp_image_scale_prepare_channel (GimpDrawablePrepare   *prepare,
+                                                GimpChannel           *channel,
+                                                gint                   new_width,
+                                                gint                   new_height,
+                                                GimpInterpolationType  interpolation_type);
+
+
+/*  public functions  */
+
 void
 gimp_image_scale (GimpImage             *image,
                   gint                   new_width,
@@ -49,19 +68,20 @@ gimp_image_scale (GimpImage             *image,
                   GimpInterpolationType  interpolation_type,
                   GimpProgress          *progress)
 {
-  GimpProgress *sub_progress;
-  GList        *all_layers;
-  GList        *all_channels;
-  GList        *all_vectors;
-  GList        *list;
-  gint          old_width;
-  gint          old_height;
-  gint          offset_x;
-  gint          offset_y;
-  gdouble       img_scale_w      = 1.0;
-  gdouble       img_scale_h      = 1.0;
-  gint          progress_steps;
-  gint          progress_current = 0;
+  GimpProgress        *sub_progress;
+  GimpDrawablePrepare *prepare;
+  GList               *all_layers;
+  GList               *all_channels;
+  GList               *all_vectors;
+  GList               *list;
+  gint                 old_width;
+  gint                 old_height;
+  gint                 offset_x;
+  gint                 offset_y;
+  gdouble              img_scale_w      = 1.0;
+  gdouble              img_scale_h      = 1.0;
+  gint                 progress_steps;
+  gint                 progress_current = 0;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (new_width > 0 && new_height > 0);
@@ -110,6 +130,56 @@ gimp_image_scale (GimpImage             *image,
                 "height", new_height,
                 NULL);
 
+  /*  Compute the new pixels of all drawables at once, the loops below
+   *  then just pick them up
+   */
+  prepare = gimp_drawable_prepare_new ();
+
+  for (list = all_channels; list; list = g_list_next (list))
+    gimp_image_scale_prepare_channel (prepare, list->data,
+                                      new_width, new_height,
+                                      interpolation_type);
+
+  gimp_image_scale_prepare_channel (prepare, gimp_image_get_mask (image),
+                                    new_width, new_height,
+                                    interpolation_type);
+
+  for (list = all_layers; list; list = g_list_next (list))
+    {
+      GimpItem *item = list->data;
+      gint      layer_width;
+      gint      layer_height;
+
+      if (gimp_viewable_get_children (GIMP_VIEWABLE (item)) ||
+          gimp_item_is_text_layer (item))
+        continue;
+
+      layer_width  = ROUND (img_scale_w * (gdouble) gimp_item_get_width  (item));
+      layer_height = ROUND (img_scale_h * (gdouble) gimp_item_get_height (item));
+
+      if (layer_width == 0 || layer_height == 0)
+        continue;
+
+      gimp_drawable_prepare_add_scale (prepare, GIMP_DRAWABLE (item),
+                                       layer_width, layer_height,
+                                       interpolation_type);
+
+      if (gimp_layer_get_mask (GIMP_LAYER (item)))
+        gimp_image_scale_prepare_channel (prepare,
+                                          GIMP_CHANNEL (gimp_layer_get_mask (GIMP_LAYER (item))),
+                                          layer_width, layer_height,
+                                          interpolation_type);
+    }
+
+  /*  count the prepared drawables as the steps they take  */
+  progress_current = gimp_drawable_prepare_get_n_jobs (prepare);
+  progress_steps  += progress_current;
+
+  gimp_drawable_prepare_run (prepare,
+                             GIMP_GEGL_CONFIG (image->gimp->config)->num_processors,
+                             progress,
+                             0.0, (gdouble) progress_current / progress_steps);
+
   /*  Scale all channels  */
   for (list = all_channels; list; list = g_list_next (list))
     {
@@ -223,6 +293,8 @@ gimp_image_scale (GimpImage             *image,
 
   gimp_image_undo_group_end (image);
 
+  gimp_drawable_prepare_free (prepare);
+
   g_list_free (all_layers);
   g_list_free (all_channels);
   g_list_free (all_vectors);
@@ -319,3 +391,22 @@ gimp_image_scale_check (GimpImage *image,
 
   return GIMP_IMAGE_SCALE_OK;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_image_scale_prepare_channel (GimpDrawablePrepare   *prepare,
+                                  GimpChannel           *channel,
+                                  gint                   new_width,
+                                  gint                   new_height,
+                                  GimpInterpolationType  interpolation_type)
+{
+  /*  gimp_channel_scale() doesn't scale empty channels  */
+  if (channel->bounds_known && channel->empty)
+    return;
+
+  gimp_drawable_prepare_add_scale (prepare, GIMP_DRAWABLE (channel),
+                                   new_width, new_height,
+                                   interpolation_type);
+}
@@ -34,6 +34,8 @@
 #include "gimplist.h"
 #include "gimpundostack.h"
 
+#include "gimp-trace.h"
+
 
 /*  local function prototypes  */
 
@@ -399,11 +401,15 @@ gimp_image_undo_push (GimpImage     *image,
                                          args);
   va_end (args);
 
+  GIMP_TRACE_BEGIN ();
+
   undo = (GimpUndo *) g_object_new_with_properties (object_type,
                                                     n_properties,
                                                     (const gchar **) names,
                                                     (const GValue *) values);
 
+  GIMP_TRACE_END ("undo", g_type_name (object_type));
+
   gimp_properties_free (n_properties, names, values);
 
   /*  nuke the redo stack  */
@@ -1170,6 +1170,8 @@ gimp_image_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (private->redo_stack),
                                       gui_size);
 
+  memsize += private->xcf_save_memsize;
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -2505,6 +2507,16 @@ gimp_image_get_xcf_version (GimpImage    *image,
       if (gimp_version)   *gimp_version   = 210;
       if (version_string) *version_string = "GIMP 2.10";
       break;
+
+      /*  incremental saves and planar zlib tiles are newer than the
+       *  first 2.10 release, only this version and later read them
+       */
+    case 13:
+    case 14:
+      if (gimp_version)   *gimp_version   = (GIMP_MAJOR_VERSION * 100 +
+                                             GIMP_MINOR_VERSION);
+      if (version_string) *version_string = "GIMP " GIMP_VERSION;
+      break;
     }
 
   return version;
@@ -2527,6 +2539,18 @@ gimp_image_get_xcf_compression (GimpImage *image)
   return GIMP_IMAGE_GET_PRIVATE (image)->xcf_compression;
 }
 
+/*  the XCF code keeps the tile tables of the last save around, this
+ *  accounts them in the image's memory size
+ */
+void
+gimp_image_set_xcf_save_memsize (GimpImage *image,
+                                 gint64     memsize)
+{
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  GIMP_IMAGE_GET_PRIVATE (image)->xcf_save_memsize = memsize;
+}
+
 void
 gimp_image_set_resolution (GimpImage *image,
                            gdouble    xresolution,
@@ -3268,6 +3292,30 @@ gimp_image_clean_all (GimpImage *image)
   gimp_object_name_changed (GIMP_OBJECT (image));
 }
 
+/*  makes the state the image was in when gimp_image_is_dirty()
+ *  returned 'dirty' the clean one, changes made after that, e.g. while
+ *  the image was being saved, keep it dirty
+ */
+void
+gimp_image_clean_since (GimpImage *image,
+                        gint       dirty)
+{
+  GimpImagePrivate *private;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  private->dirty -= dirty;
+
+  if (private->dirty == 0)
+    private->dirty_time = 0;
+
+  g_signal_emit (image, gimp_image_signals[CLEAN], 0, GIMP_DIRTY_ALL);
+
+  gimp_object_name_changed (GIMP_OBJECT (image));
+}
+
 void
 gimp_image_export_clean_all (GimpImage *image)
 {
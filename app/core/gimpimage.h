@@ -180,6 +180,9 @@ void            gimp_image_set_xcf_compression   (GimpImage          *image,
                                                   gboolean            compression);
 gboolean        gimp_image_get_xcf_compression   (GimpImage          *image);
 
+void            gimp_image_set_xcf_save_memsize  (GimpImage          *image,
+                                                  gint64              memsize);
+
 void            gimp_image_set_resolution        (GimpImage          *image,
                                                   gdouble             xres,
                                                   gdouble             yres);
@@ -278,6 +281,8 @@ gint            gimp_image_dirty                 (GimpImage          *image,
 gint            gimp_image_clean                 (GimpImage          *image,
                                                   GimpDirtyMask       dirty_mask);
 void            gimp_image_clean_all             (GimpImage          *image);
+void            gimp_image_clean_since           (GimpImage          *image,
+                                                  gint                dirty);
 void            gimp_image_export_clean_all      (GimpImage          *image);
 gint            gimp_image_is_dirty              (GimpImage          *image);
 gboolean        gimp_image_is_export_dirty       (GimpImage          *image);
@@ -25,13 +25,37 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-nodes.h"
+#include "gegl/gimptilehandlervalidate.h"
+
+#include "gimpimage.h"
 #include "gimplayer.h"
 #include "gimplayerstack.h"
 
 
+/*  while painting on one layer, the composite of the layers below it
+ *  and, if it can be split off, the composite of the layers above it
+ *  are rendered into buffers once and reused for each dab
+ */
+struct _GimpLayerStackPaint
+{
+  GimpLayer       *layer;
+
+  GeglBuffer      *backdrop_buffer;
+  GeglTileHandler *backdrop_handler;
+  GeglNode        *backdrop_node;
+
+  GeglBuffer      *overlay_buffer;
+  GeglTileHandler *overlay_handler;
+  GeglNode        *overlay_node;
+  GeglNode        *over_node;
+};
+
+
 /*  local function prototypes  */
 
 static void   gimp_layer_stack_constructed             (GObject       *object);
+static void   gimp_layer_stack_finalize                (GObject       *object);
 
 static void   gimp_layer_stack_add                     (GimpContainer *container,
                                                         GimpObject    *object);
@@ -54,6 +78,28 @@ static void   gimp_layer_stack_update_range            (GimpLayerStack *stack,
                                                         gint            first,
                                                         gint            last);
 
+static void   gimp_layer_stack_layer_update            (GimpLayer      *layer,
+                                                        gint            x,
+                                                        gint            y,
+                                                        gint            width,
+                                                        gint            height,
+                                                        GimpLayerStack *stack);
+
+static gboolean
+              gimp_layer_stack_get_cache_rect          (GimpLayerStack *stack,
+                                                        GimpLayer      *layer,
+                                                        GeglRectangle  *rect);
+static gboolean
+              gimp_layer_stack_is_over                 (GimpLayer      *layer,
+                                                        GimpLayer      *reference);
+static GeglBuffer *
+              gimp_layer_stack_new_cache               (GeglNode             *node,
+                                                        const GeglRectangle  *rect,
+                                                        GeglTileHandler     **handler);
+static void   gimp_layer_stack_free_cache              (GeglBuffer           *buffer,
+                                                        GeglTileHandler      *handler);
+static void   gimp_layer_stack_paint_free              (GimpLayerStackPaint  *paint);
+
 
 G_DEFINE_TYPE (GimpLayerStack, gimp_layer_stack, GIMP_TYPE_DRAWABLE_STACK)
 
@@ -67,6 +113,7 @@ gimp_layer_stack_class_init (GimpLayerStackClass *klass)
   GimpContainerClass *container_class = GIMP_CONTAINER_CLASS (klass);
 
   object_class->constructed = gimp_layer_stack_constructed;
+  object_class->finalize    = gimp_layer_stack_finalize;
 
   container_class->add      = gimp_layer_stack_add;
   container_class->remove   = gimp_layer_stack_remove;
@@ -94,6 +141,20 @@ gimp_layer_stack_constructed (GObject *object)
   gimp_container_add_handler (container, "excludes-backdrop-changed",
                               G_CALLBACK (gimp_layer_stack_layer_excludes_backdrop),
                               container);
+  gimp_container_add_handler (container, "update",
+                              G_CALLBACK (gimp_layer_stack_layer_update),
+                              container);
+}
+
+static void
+gimp_layer_stack_finalize (GObject *object)
+{
+  GimpLayerStack *stack = GIMP_LAYER_STACK (object);
+
+  /*  the cache's nodes go away with the graph  */
+  g_clear_pointer (&stack->paint, gimp_layer_stack_paint_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -102,6 +163,8 @@ gimp_layer_stack_add (GimpContainer *container,
 {
   GimpLayerStack *stack = GIMP_LAYER_STACK (container);
 
+  gimp_layer_stack_end_paint (stack);
+
   GIMP_CONTAINER_CLASS (parent_class)->add (container, object);
 
   gimp_layer_stack_update_backdrop (stack, GIMP_LAYER (object), FALSE, FALSE);
@@ -115,6 +178,8 @@ gimp_layer_stack_remove (GimpContainer *container,
   gboolean        update_backdrop;
   gint            index;
 
+  gimp_layer_stack_end_paint (stack);
+
   update_backdrop = gimp_filter_get_active (GIMP_FILTER (object)) &&
                     gimp_layer_get_excludes_backdrop (GIMP_LAYER (object));
 
@@ -136,6 +201,8 @@ gimp_layer_stack_reorder (GimpContainer *container,
   gboolean        update_backdrop;
   gint            index;
 
+  gimp_layer_stack_end_paint (stack);
+
   update_backdrop = gimp_filter_get_active (GIMP_FILTER (object)) &&
                     gimp_layer_get_excludes_backdrop (GIMP_LAYER (object));
 
@@ -164,12 +231,161 @@ gimp_layer_stack_new (GType layer_type)
 }
 
 
+/*  caches the composites below and above 'layer' for the duration of
+ *  a paint stroke on it, so updates of the layer only re-blend it
+ *  against them instead of evaluating the whole stack.  the layers
+ *  above are only cached if they are all composited like normal mode,
+ *  otherwise they keep being evaluated as usual.
+ */
+void
+gimp_layer_stack_start_paint (GimpLayerStack *stack,
+                              GimpLayer      *layer)
+{
+  GimpLayerStackPaint *paint;
+  GeglNode            *graph;
+  GeglNode            *node;
+  GeglNode            *below;
+  GeglNode            *output;
+  GimpLayer           *above     = NULL;
+  gboolean             can_split = TRUE;
+  GeglRectangle        rect;
+  GList               *iter;
+
+  g_return_if_fail (GIMP_IS_LAYER_STACK (stack));
+  g_return_if_fail (GIMP_IS_LAYER (layer));
+  g_return_if_fail (gimp_container_have (GIMP_CONTAINER (stack),
+                                         GIMP_OBJECT (layer)));
+
+  gimp_layer_stack_end_paint (stack);
+
+  graph = GIMP_FILTER_STACK (stack)->graph;
+
+  if (! graph || ! gimp_filter_get_active (GIMP_FILTER (layer)))
+    return;
+
+  if (! gimp_layer_stack_get_cache_rect (stack, layer, &rect))
+    return;
+
+  node   = gimp_filter_get_node (GIMP_FILTER (layer));
+  output = gegl_node_get_output_proxy (graph, "output");
+  below  = gegl_node_get_producer (node, "input", NULL);
+
+  /*  nothing to cache below the bottom layer  */
+  if (below == gegl_node_get_input_proxy (graph, "input"))
+    below = NULL;
+
+  iter = g_list_find (GIMP_LIST (stack)->queue->head, layer);
+
+  for (iter = g_list_previous (iter); iter; iter = g_list_previous (iter))
+    {
+      GimpLayer *layer_above = iter->data;
+
+      if (! gimp_filter_get_active (GIMP_FILTER (layer_above)))
+        continue;
+
+      if (! above)
+        above = layer_above;
+
+      if (! gimp_layer_stack_is_over (layer_above, above))
+        can_split = FALSE;
+    }
+
+  if (! below && ! (above && can_split))
+    return;
+
+  paint = g_slice_new0 (GimpLayerStackPaint);
+
+  paint->layer = layer;
+
+  if (below)
+    {
+      paint->backdrop_buffer = gimp_layer_stack_new_cache (below, &rect,
+                                                           &paint->backdrop_handler);
+      paint->backdrop_node   = gimp_gegl_add_buffer_source (graph,
+                                                            paint->backdrop_buffer,
+                                                            0, 0);
+
+      gegl_node_connect_to (paint->backdrop_node, "output",
+                            node,                 "input");
+    }
+
+  if (above && can_split)
+    {
+      GeglNode *top = gegl_node_get_producer (output, "input", NULL);
+
+      /*  composite the layers above on transparency, and that on the
+       *  layer.  'over' is associative, so the result is the same.
+       */
+      gegl_node_disconnect (gimp_filter_get_node (GIMP_FILTER (above)),
+                            "input");
+
+      paint->overlay_buffer = gimp_layer_stack_new_cache (top, &rect,
+                                                          &paint->overlay_handler);
+      paint->overlay_node   = gimp_gegl_add_buffer_source (graph,
+                                                           paint->overlay_buffer,
+                                                           0, 0);
+
+      paint->over_node = gegl_node_new_child (graph,
+                                              "operation", "gimp:normal",
+                                              NULL);
+
+      gimp_gegl_mode_node_set_mode (paint->over_node,
+                                    above->effective_mode,
+                                    above->effective_blend_space,
+                                    above->effective_composite_space,
+                                    GIMP_LAYER_COMPOSITE_SRC_OVER);
+      gimp_gegl_mode_node_set_opacity (paint->over_node, 1.0);
+
+      gegl_node_connect_to (node,                "output",
+                            paint->over_node,    "input");
+      gegl_node_connect_to (paint->overlay_node, "output",
+                            paint->over_node,    "aux");
+      gegl_node_connect_to (paint->over_node,    "output",
+                            output,              "input");
+    }
+
+  stack->paint = paint;
+}
+
+void
+gimp_layer_stack_end_paint (GimpLayerStack *stack)
+{
+  GimpLayerStackPaint *paint;
+  GeglNode            *graph;
+
+  g_return_if_fail (GIMP_IS_LAYER_STACK (stack));
+
+  if (! stack->paint)
+    return;
+
+  paint = stack->paint;
+  graph = GIMP_FILTER_STACK (stack)->graph;
+
+  stack->paint = NULL;
+
+  gimp_filter_stack_relink (GIMP_FILTER_STACK (stack));
+
+  if (paint->backdrop_node)
+    gegl_node_remove_child (graph, paint->backdrop_node);
+
+  if (paint->overlay_node)
+    {
+      gegl_node_remove_child (graph, paint->overlay_node);
+      gegl_node_remove_child (graph, paint->over_node);
+    }
+
+  gimp_layer_stack_paint_free (paint);
+}
+
+
 /*  private functions  */
 
 static void
 gimp_layer_stack_layer_active (GimpLayer      *layer,
                                GimpLayerStack *stack)
 {
+  gimp_layer_stack_end_paint (stack);
+
   gimp_layer_stack_update_backdrop (stack, layer, TRUE, FALSE);
 }
 
@@ -240,3 +456,125 @@ gimp_layer_stack_update_range (GimpLayerStack *stack,
         }
     }
 }
+
+/*  any change to another layer invalidates the caches, simply go back
+ *  to evaluating the whole stack
+ */
+static void
+gimp_layer_stack_layer_update (GimpLayer      *layer,
+                               gint            x,
+                               gint            y,
+                               gint            width,
+                               gint            height,
+                               GimpLayerStack *stack)
+{
+  if (stack->paint && stack->paint->layer != layer)
+    gimp_layer_stack_end_paint (stack);
+}
+
+/*  the image's layers are only visible inside the canvas, a group's
+ *  children on their whole extent
+ */
+static gboolean
+gimp_layer_stack_get_cache_rect (GimpLayerStack *stack,
+                                 GimpLayer      *layer,
+                                 GeglRectangle  *rect)
+{
+  GimpImage *image = gimp_item_get_image (GIMP_ITEM (layer));
+
+  if (GIMP_CONTAINER (stack) == gimp_image_get_layers (image))
+    {
+      *rect = *GEGL_RECTANGLE (0, 0,
+                               gimp_image_get_width  (image),
+                               gimp_image_get_height (image));
+    }
+  else
+    {
+      GList *list;
+
+      *rect = *GEGL_RECTANGLE (0, 0, 0, 0);
+
+      for (list = GIMP_LIST (stack)->queue->head;
+           list;
+           list = g_list_next (list))
+        {
+          GimpItem      *item = list->data;
+          GeglRectangle  extent;
+
+          gimp_item_get_offset (item, &extent.x, &extent.y);
+          extent.width  = gimp_item_get_width  (item);
+          extent.height = gimp_item_get_height (item);
+
+          if (list == GIMP_LIST (stack)->queue->head)
+            *rect = extent;
+          else
+            gegl_rectangle_bounding_box (rect, rect, &extent);
+        }
+    }
+
+  /*  the validate handler works with non-negative tile coordinates  */
+  return (rect->x >= 0 && rect->y >= 0 &&
+          rect->width > 0 && rect->height > 0);
+}
+
+/*  returns TRUE if 'layer' is composited over its backdrop the same
+ *  way as 'reference', with a normal mode which allows compositing the
+ *  layers above the painted one separately
+ */
+static gboolean
+gimp_layer_stack_is_over (GimpLayer *layer,
+                          GimpLayer *reference)
+{
+  return ((layer->effective_mode == GIMP_LAYER_MODE_NORMAL ||
+           layer->effective_mode == GIMP_LAYER_MODE_NORMAL_LEGACY) &&
+          layer->effective_mode            == reference->effective_mode            &&
+          layer->effective_composite_space == reference->effective_composite_space &&
+          layer->effective_composite_mode  == GIMP_LAYER_COMPOSITE_SRC_OVER        &&
+          ! gimp_layer_get_excludes_backdrop (layer)                               &&
+          ! (layer->mask && layer->show_mask));
+}
+
+/*  returns a buffer whose tiles are rendered from 'node' on demand,
+ *  like the projection's
+ */
+static GeglBuffer *
+gimp_layer_stack_new_cache (GeglNode             *node,
+                            const GeglRectangle  *rect,
+                            GeglTileHandler     **handler)
+{
+  GeglBuffer *buffer;
+
+  buffer = gegl_buffer_new (rect, babl_format ("RaGaBaA float"));
+
+  *handler = gimp_tile_handler_validate_new (node);
+
+  gimp_tile_handler_validate_assign (GIMP_TILE_HANDLER_VALIDATE (*handler),
+                                     buffer);
+  gimp_tile_handler_validate_invalidate (GIMP_TILE_HANDLER_VALIDATE (*handler),
+                                         rect);
+
+  return buffer;
+}
+
+static void
+gimp_layer_stack_free_cache (GeglBuffer      *buffer,
+                             GeglTileHandler *handler)
+{
+  if (buffer)
+    {
+      gegl_buffer_remove_handler (buffer, handler);
+      g_object_unref (buffer);
+      g_object_unref (handler);
+    }
+}
+
+static void
+gimp_layer_stack_paint_free (GimpLayerStackPaint *paint)
+{
+  gimp_layer_stack_free_cache (paint->backdrop_buffer,
+                               paint->backdrop_handler);
+  gimp_layer_stack_free_cache (paint->overlay_buffer,
+                               paint->overlay_handler);
+
+  g_slice_free (GimpLayerStackPaint, paint);
+}
@@ -32,10 +32,13 @@
 
 
 typedef struct _GimpLayerStackClass GimpLayerStackClass;
+typedef struct _GimpLayerStackPaint GimpLayerStackPaint;
 
 struct _GimpLayerStack
 {
-  GimpDrawableStack  parent_instance;
+  GimpDrawableStack    parent_instance;
+
+  GimpLayerStackPaint *paint;
 };
 
 struct _GimpLayerStackClass
@@ -44,8 +47,12 @@ struct _GimpLayerStackClass
 };
 
 
-GType           gimp_layer_stack_get_type  (void) G_GNUC_CONST;
-GimpContainer * gimp_layer_stack_new       (GType layer_type);
+GType           gimp_layer_stack_get_type    (void) G_GNUC_CONST;
+GimpContainer * gimp_layer_stack_new         (GType           layer_type);
+
+void            gimp_layer_stack_start_paint (GimpLayerStack *stack,
+                                              GimpLayer      *layer);
+void            gimp_layer_stack_end_paint   (GimpLayerStack *stack);
 
 
 #endif  /*  __GIMP_LAYER_STACK_H__  */
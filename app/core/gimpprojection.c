@@ -32,6 +32,7 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-latency.h"
 #include "gimp-memsize.h"
 #include "gimpimage.h"
 #include "gimpmarshal.h"
@@ -42,6 +43,7 @@
 
 #include "gimp-log.h"
 #include "gimp-priorities.h"
+#include "gimp-trace.h"
 
 
 /*  chunk size for one iteration of the chunk renderer  */
@@ -261,6 +263,8 @@ gimp_projection_finalize (GObject *object)
 
   gimp_projection_free_buffer (proj);
 
+  gimp_latency_forget (proj);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -763,6 +767,8 @@ gimp_projection_chunk_render_callback (gpointer data)
   gint            chunks = 0;
   gboolean        retval = TRUE;
 
+  GIMP_TRACE_BEGIN ();
+
   gimp_projectable_begin_render (proj->priv->projectable);
 
   do
@@ -786,6 +792,8 @@ gimp_projection_chunk_render_callback (gpointer data)
             chunks, g_timer_elapsed (timer, NULL));
   g_timer_destroy (timer);
 
+  GIMP_TRACE_END ("idle", "projection-chunk-render");
+
   return retval;
 }
 
@@ -978,8 +986,12 @@ gimp_projection_paint_area (GimpProjection *proj,
             gimp_tile_handler_validate_undo_invalidate (proj->priv->validate_handler,
                                                         GEGL_RECTANGLE (x, y, w, h));
 
+          GIMP_TRACE_BEGIN ();
+
           gegl_node_blit_buffer (graph, proj->priv->buffer,
                                  GEGL_RECTANGLE (x, y, w, h), 0, GEGL_ABYSS_NONE);
+
+          GIMP_TRACE_END ("projection", "render");
         }
 
       /*  add the projectable's offsets because the list of update areas
@@ -992,6 +1004,8 @@ gimp_projection_paint_area (GimpProjection *proj,
                      y + off_y,
                      w,
                      h);
+
+      gimp_latency_mark (proj, GIMP_LATENCY_STAGE_UPDATE);
     }
 }
 
@@ -38,6 +38,7 @@
 #include "gimpundostack.h"
 
 #include "gimp-priorities.h"
+#include "gimp-trace.h"
 
 #include "gimp-intl.h"
 
@@ -436,7 +437,11 @@ gimp_undo_create_preview_idle (gpointer data)
 
   if (idle->undo == gimp_undo_stack_peek (stack))
     {
+      GIMP_TRACE_BEGIN ();
+
       gimp_undo_create_preview_private (idle->undo, idle->context);
+
+      GIMP_TRACE_END ("idle", "undo-preview");
     }
 
   idle->undo->preview_idle_id = 0;
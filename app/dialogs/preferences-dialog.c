@@ -1215,9 +1215,20 @@ prefs_dialog_new (Gimp       *gimp,
                            _("Maximum _filesize for thumbnailing:"),
                            GTK_TABLE (table), 1, size_group);
 
+  prefs_check_button_add (object, "xcf-save-previews",
+                          _("Store reduced-size _previews in XCF files"),
+                          GTK_BOX (vbox2));
+
   g_object_unref (size_group);
   size_group = NULL;
 
+  /*  Saving Images  */
+  vbox2 = prefs_frame_new (_("Saving Images"), GTK_CONTAINER (vbox), FALSE);
+
+  prefs_check_button_add (object, "xcf-save-in-background",
+                          _("Save XCF files in the _background"),
+                          GTK_BOX (vbox2));
+
   /*  Document History  */
   vbox2 = prefs_frame_new (_("Document History"), GTK_CONTAINER (vbox), FALSE);
 
@@ -44,6 +44,7 @@
 #include "gimpdisplayshell-expose.h"
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-icon.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-transform.h"
 #include "gimpimagewindow.h"
 
@@ -778,6 +779,12 @@ gimp_display_update_area (GimpDisplay *display,
 
   private = GIMP_DISPLAY_GET_PRIVATE (display);
 
+  /*  forget the rendered pixels right away, even if the area is only
+   *  exposed later
+   */
+  gimp_display_shell_render_invalidate_area (gimp_display_get_shell (display),
+                                             x, y, w, h);
+
   if (now)
     {
       gimp_display_paint_area (display, x, y, w, h);
@@ -26,6 +26,7 @@
 #include "display-types.h"
 
 #include "core/gimp.h"
+#include "core/gimp-latency.h"
 #include "core/gimpimage.h"
 #include "core/gimpimage-quick-mask.h"
 
@@ -238,15 +239,19 @@ gimp_display_shell_canvas_expose (GtkWidget        *widget,
   /*  ignore events on overlays  */
   if (eevent->window == gtk_widget_get_window (widget))
     {
-      cairo_t *cr;
+      GimpImage *image = gimp_display_get_image (shell->display);
+      cairo_t   *cr;
 
       cr = gdk_cairo_create (gtk_widget_get_window (shell->canvas));
       gdk_cairo_region (cr, eevent->region);
       cairo_clip (cr);
 
-      if (gimp_display_get_image (shell->display))
+      if (image)
         {
           gimp_display_shell_canvas_draw_image (shell, cr);
+
+          gimp_latency_mark (gimp_image_get_projection (image),
+                             GIMP_LATENCY_STAGE_DRAW);
         }
       else
         {
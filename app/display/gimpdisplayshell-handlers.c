@@ -61,6 +61,7 @@
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-icon.h"
 #include "gimpdisplayshell-profile.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-rulers.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-scroll.h"
@@ -409,6 +410,8 @@ gimp_display_shell_disconnect (GimpDisplayShell *shell)
 
   gimp_display_shell_icon_update_stop (shell);
 
+  gimp_display_shell_render_invalidate_full (shell);
+
   gimp_canvas_layer_boundary_set_layer (GIMP_CANVAS_LAYER_BOUNDARY (shell->layer_boundary),
                                         NULL);
 
@@ -784,6 +787,9 @@ gimp_display_shell_size_changed_detailed_handler (GimpImage        *image,
   GimpDisplayConfig *config = shell->display->config;
   gboolean           resize_window;
 
+  /*  the image's pixels may have moved  */
+  gimp_display_shell_render_invalidate_full (shell);
+
   /* Resize windows only in multi-window mode */
   resize_window = (config->resize_windows_on_resize &&
                    ! GIMP_GUI_CONFIG (config)->single_window_mode);
@@ -40,6 +40,7 @@
 #include "gimpdisplayshell-actions.h"
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-profile.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayxfer.h"
 
 #include "gimp-intl.h"
@@ -93,6 +94,8 @@ gimp_display_shell_profile_update (GimpDisplayShell *shell)
 
   gimp_display_shell_profile_free (shell);
 
+  gimp_display_shell_render_invalidate_full (shell);
+
   image = gimp_display_get_image (shell->display);
 
   if (! image)
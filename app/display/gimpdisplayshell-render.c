@@ -17,6 +17,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -44,6 +46,78 @@
 #include "gimpdisplayshell-scroll.h"
 #include "gimpdisplayxfer.h"
 
+#include "gimp-trace.h"
+
+
+/*  the most memory the rendered tiles of one display may take  */
+#define RENDER_CACHE_MAX_SIZE  (64 * 1024 * 1024)
+
+/*  how long the display has to be left alone before tiles for the
+ *  neighboring zoom levels are rendered
+ */
+#define RENDER_PREFETCH_DELAY  250
+
+/*  scales are compared in these units  */
+#define RENDER_SCALE_KEY(scale) ((gint64) RINT ((scale) * 1048576.0))
+
+
+typedef struct _RenderTile RenderTile;
+
+/*  a display-ready area of the image at one scale, at the position
+ *  (x, y) of the scaled image
+ */
+struct _RenderTile
+{
+  gint64           scale_key;
+  gint             x;
+  gint             y;
+
+  cairo_surface_t *surface;
+  GList           *link;
+};
+
+
+/*  local function prototypes  */
+
+static void         gimp_display_shell_render_pixels           (GimpDisplayShell *shell,
+                                                                gint              x,
+                                                                gint              y,
+                                                                gint              w,
+                                                                gint              h,
+                                                                gdouble           scale,
+                                                                guchar           *cairo_data,
+                                                                gint              cairo_stride);
+static void         gimp_display_shell_render_from_cache       (GimpDisplayShell *shell,
+                                                                gint              x,
+                                                                gint              y,
+                                                                gint              w,
+                                                                gint              h,
+                                                                gdouble           scale,
+                                                                guchar           *cairo_data,
+                                                                gint              cairo_stride);
+static RenderTile * gimp_display_shell_render_get_tile         (GimpDisplayShell *shell,
+                                                                gint              x,
+                                                                gint              y,
+                                                                gdouble           scale,
+                                                                gboolean          render);
+static void         gimp_display_shell_render_remove_tile      (GimpDisplayShell *shell,
+                                                                RenderTile       *tile);
+static gint         gimp_display_shell_render_get_max_tiles    (void);
+
+static void         gimp_display_shell_render_queue_prefetch   (GimpDisplayShell *shell);
+static gboolean     gimp_display_shell_render_prefetch_timeout (GimpDisplayShell *shell);
+static gboolean     gimp_display_shell_render_prefetch_idle    (GimpDisplayShell *shell);
+static gboolean     gimp_display_shell_render_prefetch_scale   (GimpDisplayShell *shell,
+                                                                gdouble           scale,
+                                                                gdouble           zoom_ratio);
+
+static guint        render_tile_hash                           (gconstpointer     key);
+static gboolean     render_tile_equal                          (gconstpointer     a,
+                                                                gconstpointer     b);
+static void         render_tile_free                           (RenderTile       *tile);
+
+
+/*  public functions  */
 
 void
 gimp_display_shell_render (GimpDisplayShell *shell,
@@ -54,11 +128,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                            gint              h,
                            gdouble           scale)
 {
-  GimpImage       *image;
-  GeglBuffer      *buffer;
-#ifdef USE_NODE_BLIT
-  GeglNode        *node;
-#endif
   cairo_surface_t *xfer;
   gint             xfer_src_x;
   gint             xfer_src_y;
@@ -66,7 +135,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gint             mask_src_y = 0;
   gint             cairo_stride;
   guchar          *cairo_data;
-  GeglBuffer      *cairo_buffer;
 
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
   g_return_if_fail (cr != NULL);
@@ -74,6 +142,176 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   g_return_if_fail (h > 0 && h <= GIMP_DISPLAY_RENDER_BUF_HEIGHT);
   g_return_if_fail (scale > 0.0);
 
+  xfer = gimp_display_xfer_get_surface (shell->xfer, w, h,
+                                        &xfer_src_x, &xfer_src_y);
+
+  cairo_stride = cairo_image_surface_get_stride (xfer);
+  cairo_data   = cairo_image_surface_get_data (xfer) +
+                 xfer_src_y * cairo_stride + xfer_src_x * 4;
+
+  gimp_display_shell_render_from_cache (shell, x, y, w, h, scale,
+                                        cairo_data, cairo_stride);
+
+  gimp_display_shell_render_queue_prefetch (shell);
+
+  if (shell->mask)
+    {
+      if (! shell->mask_surface)
+        {
+          shell->mask_surface =
+            cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                        GIMP_DISPLAY_RENDER_BUF_WIDTH,
+                                        GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+        }
+
+      cairo_surface_mark_dirty (shell->mask_surface);
+
+      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
+      cairo_data   = cairo_image_surface_get_data (shell->mask_surface) +
+                     mask_src_y * cairo_stride + mask_src_x;
+
+      gegl_buffer_get (shell->mask,
+                       GEGL_RECTANGLE (x - floor (shell->mask_offset_x * scale),
+                                       y - floor (shell->mask_offset_y * scale),
+                                       w, h),
+                       scale,
+                       babl_format ("Y u8"),
+                       cairo_data, cairo_stride,
+                       GEGL_ABYSS_NONE);
+
+      if (shell->mask_inverted)
+        {
+          gint mask_height = h;
+
+          while (mask_height--)
+            {
+              gint    mask_width = w;
+              guchar *d          = cairo_data;
+
+              while (mask_width--)
+                {
+                  guchar inv = 255 - *d;
+
+                  *d++ = inv;
+                }
+
+              cairo_data += cairo_stride;
+            }
+        }
+    }
+
+  /*  put it to the screen  */
+  cairo_set_source_surface (cr, xfer,
+                            x - xfer_src_x,
+                            y - xfer_src_y);
+  cairo_paint (cr);
+
+  if (shell->mask)
+    {
+      gimp_cairo_set_source_rgba (cr, &shell->mask_color);
+      cairo_mask_surface (cr, shell->mask_surface,
+                          x - mask_src_x,
+                          y - mask_src_y);
+    }
+}
+
+/*  drops all rendered tiles, needed whenever the way the image is
+ *  displayed changes
+ */
+void
+gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_prefetch_id)
+    {
+      g_source_remove (shell->render_prefetch_id);
+      shell->render_prefetch_id = 0;
+    }
+
+  g_clear_pointer (&shell->render_cache, g_hash_table_unref);
+  g_clear_pointer (&shell->render_cache_lru, g_queue_free);
+}
+
+/*  drops the rendered tiles which show any of the image area
+ *  (x, y, width, height), in image coordinates
+ */
+void
+gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
+                                           gint              x,
+                                           gint              y,
+                                           gint              width,
+                                           gint              height)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_prefetch_id)
+    {
+      g_source_remove (shell->render_prefetch_id);
+      shell->render_prefetch_id = 0;
+    }
+
+  if (! shell->render_cache || width <= 0 || height <= 0)
+    return;
+
+  list = shell->render_cache_lru->head;
+
+  while (list)
+    {
+      RenderTile *tile  = list->data;
+      gdouble     scale = (gdouble) tile->scale_key / 1048576.0;
+      gdouble     pad;
+      gint        x1, y1, x2, y2;
+
+      list = g_list_next (list);
+
+      /*  downscaling samples a few pixels around each one, and so do
+       *  the display filters
+       */
+      pad = 2.0 / MIN (scale, 1.0);
+
+      x1 = floor ((x - pad)          * scale);
+      y1 = floor ((y - pad)          * scale);
+      x2 = ceil  ((x + width  + pad) * scale);
+      y2 = ceil  ((y + height + pad) * scale);
+
+      if (x1 < tile->x + cairo_image_surface_get_width  (tile->surface) &&
+          y1 < tile->y + cairo_image_surface_get_height (tile->surface) &&
+          x2 > tile->x                                                 &&
+          y2 > tile->y)
+        {
+          gimp_display_shell_render_remove_tile (shell, tile);
+        }
+    }
+}
+
+
+/*  private functions  */
+
+/*  renders the projection's pixels of the scaled image area, color
+ *  managed and filtered, to cairo-ARGB32 'cairo_data'
+ */
+static void
+gimp_display_shell_render_pixels (GimpDisplayShell *shell,
+                                  gint              x,
+                                  gint              y,
+                                  gint              w,
+                                  gint              h,
+                                  gdouble           scale,
+                                  guchar           *cairo_data,
+                                  gint              cairo_stride)
+{
+  GimpImage  *image;
+  GeglBuffer *buffer;
+#ifdef USE_NODE_BLIT
+  GeglNode   *node;
+#endif
+  GeglBuffer *cairo_buffer;
+
+  GIMP_TRACE_BEGIN ();
+
   image  = gimp_display_get_image (shell->display);
   buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (image));
 #ifdef USE_NODE_BLIT
@@ -82,13 +320,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gimp_projectable_begin_render (GIMP_PROJECTABLE (image));
 #endif
 
-  xfer = gimp_display_xfer_get_surface (shell->xfer, w, h,
-                                        &xfer_src_x, &xfer_src_y);
-
-  cairo_stride = cairo_image_surface_get_stride (xfer);
-  cairo_data   = cairo_image_surface_get_data (xfer) +
-                 xfer_src_y * cairo_stride + xfer_src_x * 4;
-
   cairo_buffer = gegl_buffer_linear_new_from_data (cairo_data,
                                                    babl_format ("cairo-ARGB32"),
                                                    GEGL_RECTANGLE (0, 0, w, h),
@@ -283,63 +514,304 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gimp_projectable_end_render (GIMP_PROJECTABLE (image));
 #endif
 
-  if (shell->mask)
+  GIMP_TRACE_END ("display", "render");
+}
+
+/*  fills the scaled image area from the cached tiles, rendering the
+ *  missing ones
+ */
+static void
+gimp_display_shell_render_from_cache (GimpDisplayShell *shell,
+                                      gint              x,
+                                      gint              y,
+                                      gint              w,
+                                      gint              h,
+                                      gdouble           scale,
+                                      guchar           *cairo_data,
+                                      gint              cairo_stride)
+{
+  gint tile_width  = GIMP_DISPLAY_RENDER_BUF_WIDTH;
+  gint tile_height = GIMP_DISPLAY_RENDER_BUF_HEIGHT;
+  gint tile_x1, tile_y1;
+  gint tile_x2, tile_y2;
+  gint tile_x, tile_y;
+
+  tile_x1 = floor ((gdouble) x / tile_width)  * tile_width;
+  tile_y1 = floor ((gdouble) y / tile_height) * tile_height;
+  tile_x2 = x + w;
+  tile_y2 = y + h;
+
+  for (tile_y = tile_y1; tile_y < tile_y2; tile_y += tile_height)
+    for (tile_x = tile_x1; tile_x < tile_x2; tile_x += tile_width)
+      {
+        RenderTile *tile;
+        guchar     *src;
+        guchar     *dest;
+        gint        src_stride;
+        gint        x1, y1, x2, y2;
+        gint        row;
+
+        tile = gimp_display_shell_render_get_tile (shell, tile_x, tile_y,
+                                                   scale, TRUE);
+
+        x1 = MAX (x,     tile_x);
+        y1 = MAX (y,     tile_y);
+        x2 = MIN (x + w, tile_x + tile_width);
+        y2 = MIN (y + h, tile_y + tile_height);
+
+        src_stride = cairo_image_surface_get_stride (tile->surface);
+        src        = (cairo_image_surface_get_data (tile->surface) +
+                      (y1 - tile_y) * src_stride + (x1 - tile_x) * 4);
+        dest       = cairo_data + (y1 - y) * cairo_stride + (x1 - x) * 4;
+
+        for (row = y1; row < y2; row++)
+          {
+            memcpy (dest, src, (x2 - x1) * 4);
+
+            src  += src_stride;
+            dest += cairo_stride;
+          }
+      }
+}
+
+/*  looks up the tile at (x, y) of the image scaled by 'scale', and
+ *  renders it if it's missing and 'render' is TRUE
+ */
+static RenderTile *
+gimp_display_shell_render_get_tile (GimpDisplayShell *shell,
+                                    gint              x,
+                                    gint              y,
+                                    gdouble           scale,
+                                    gboolean          render)
+{
+  RenderTile  key;
+  RenderTile *tile;
+
+  if (! shell->render_cache)
     {
-      if (! shell->mask_surface)
+      shell->render_cache     = g_hash_table_new_full (render_tile_hash,
+                                                       render_tile_equal,
+                                                       NULL,
+                                                       (GDestroyNotify) render_tile_free);
+      shell->render_cache_lru = g_queue_new ();
+    }
+
+  key.scale_key = RENDER_SCALE_KEY (scale);
+  key.x         = x;
+  key.y         = y;
+
+  tile = g_hash_table_lookup (shell->render_cache, &key);
+
+  if (tile || ! render)
+    {
+      /*  move it to the front, the tail is dropped first  */
+      if (tile)
         {
-          shell->mask_surface =
-            cairo_image_surface_create (CAIRO_FORMAT_A8,
-                                        GIMP_DISPLAY_RENDER_BUF_WIDTH,
-                                        GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+          g_queue_unlink (shell->render_cache_lru, tile->link);
+          g_queue_push_head_link (shell->render_cache_lru, tile->link);
         }
 
-      cairo_surface_mark_dirty (shell->mask_surface);
+      return tile;
+    }
 
-      cairo_stride = cairo_image_surface_get_stride (shell->mask_surface);
-      cairo_data   = cairo_image_surface_get_data (shell->mask_surface) +
-                     mask_src_y * cairo_stride + mask_src_x;
+  while (g_queue_get_length (shell->render_cache_lru) >=
+         gimp_display_shell_render_get_max_tiles ())
+    {
+      gimp_display_shell_render_remove_tile (shell,
+                                             g_queue_peek_tail (shell->render_cache_lru));
+    }
 
-      gegl_buffer_get (shell->mask,
-                       GEGL_RECTANGLE (x - floor (shell->mask_offset_x * scale),
-                                       y - floor (shell->mask_offset_y * scale),
-                                       w, h),
-                       scale,
-                       babl_format ("Y u8"),
-                       cairo_data, cairo_stride,
-                       GEGL_ABYSS_NONE);
+  tile = g_slice_new (RenderTile);
 
-      if (shell->mask_inverted)
-        {
-          gint mask_height = h;
+  tile->scale_key = key.scale_key;
+  tile->x         = x;
+  tile->y         = y;
+  tile->surface   = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                GIMP_DISPLAY_RENDER_BUF_WIDTH,
+                                                GIMP_DISPLAY_RENDER_BUF_HEIGHT);
 
-          while (mask_height--)
-            {
-              gint    mask_width = w;
-              guchar *d          = cairo_data;
+  gimp_display_shell_render_pixels (shell,
+                                    x, y,
+                                    cairo_image_surface_get_width  (tile->surface),
+                                    cairo_image_surface_get_height (tile->surface),
+                                    scale,
+                                    cairo_image_surface_get_data (tile->surface),
+                                    cairo_image_surface_get_stride (tile->surface));
 
-              while (mask_width--)
-                {
-                  guchar inv = 255 - *d;
+  cairo_surface_mark_dirty (tile->surface);
 
-                  *d++ = inv;
-                }
+  g_queue_push_head (shell->render_cache_lru, tile);
+  tile->link = shell->render_cache_lru->head;
 
-              cairo_data += cairo_stride;
-            }
+  g_hash_table_add (shell->render_cache, tile);
+
+  return tile;
+}
+
+static void
+gimp_display_shell_render_remove_tile (GimpDisplayShell *shell,
+                                       RenderTile       *tile)
+{
+  g_queue_delete_link (shell->render_cache_lru, tile->link);
+  g_hash_table_remove (shell->render_cache, tile);
+}
+
+static gint
+gimp_display_shell_render_get_max_tiles (void)
+{
+  return MAX (RENDER_CACHE_MAX_SIZE /
+              (GIMP_DISPLAY_RENDER_BUF_WIDTH  *
+               GIMP_DISPLAY_RENDER_BUF_HEIGHT * 4),
+              1);
+}
+
+/*  once the display is left alone for a moment, the tiles needed
+ *  for zooming in or out by one step are rendered in the background
+ */
+static void
+gimp_display_shell_render_queue_prefetch (GimpDisplayShell *shell)
+{
+  if (shell->render_prefetch_id)
+    g_source_remove (shell->render_prefetch_id);
+
+  shell->render_prefetch_id =
+    g_timeout_add_full (G_PRIORITY_LOW, RENDER_PREFETCH_DELAY,
+                        (GSourceFunc) gimp_display_shell_render_prefetch_timeout,
+                        shell, NULL);
+}
+
+static gboolean
+gimp_display_shell_render_prefetch_timeout (GimpDisplayShell *shell)
+{
+  shell->render_prefetch_id =
+    g_idle_add_full (G_PRIORITY_LOW,
+                     (GSourceFunc) gimp_display_shell_render_prefetch_idle,
+                     shell, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+gimp_display_shell_render_prefetch_idle (GimpDisplayShell *shell)
+{
+  gdouble zoom;
+  gdouble scale;
+
+  zoom  = gimp_zoom_model_get_factor (shell->zoom);
+  scale = MIN (1.0, GIMP_DISPLAY_RENDER_MAX_SCALE) *
+          MAX (shell->scale_x, shell->scale_y);
+
+  /*  don't push out tiles which are actually shown  */
+  if (gimp_display_get_image (shell->display) &&
+      shell->render_cache                     &&
+      g_queue_get_length (shell->render_cache_lru) <
+      gimp_display_shell_render_get_max_tiles ())
+    {
+      gdouble zoom_in  = gimp_zoom_model_zoom_step (GIMP_ZOOM_IN,  zoom);
+      gdouble zoom_out = gimp_zoom_model_zoom_step (GIMP_ZOOM_OUT, zoom);
+
+      if (gimp_display_shell_render_prefetch_scale (shell,
+                                                    scale * zoom_in / zoom,
+                                                    zoom_in / zoom) ||
+          gimp_display_shell_render_prefetch_scale (shell,
+                                                    scale * zoom_out / zoom,
+                                                    zoom_out / zoom))
+        {
+          return G_SOURCE_CONTINUE;
         }
     }
 
-  /*  put it to the screen  */
-  cairo_set_source_surface (cr, xfer,
-                            x - xfer_src_x,
-                            y - xfer_src_y);
-  cairo_paint (cr);
+  shell->render_prefetch_id = 0;
 
-  if (shell->mask)
+  return G_SOURCE_REMOVE;
+}
+
+/*  renders one missing tile of what would be visible after zooming
+ *  around the center by 'zoom_ratio', returns FALSE if none is missing
+ */
+static gboolean
+gimp_display_shell_render_prefetch_scale (GimpDisplayShell *shell,
+                                          gdouble           scale,
+                                          gdouble           zoom_ratio)
+{
+  GimpImage *image = gimp_display_get_image (shell->display);
+  gint       tile_width  = GIMP_DISPLAY_RENDER_BUF_WIDTH;
+  gint       tile_height = GIMP_DISPLAY_RENDER_BUF_HEIGHT;
+  gint       vx, vy, vw, vh;
+  gdouble    cx, cy;
+  gint       x1, y1, x2, y2;
+  gint       tile_x, tile_y;
+
+  if (scale <= 0.0 || RENDER_SCALE_KEY (scale) <= 0)
+    return FALSE;
+
+  gimp_display_shell_untransform_viewport (shell, &vx, &vy, &vw, &vh);
+
+  if (vw <= 0 || vh <= 0)
+    return FALSE;
+
+  cx = vx + vw / 2.0;
+  cy = vy + vh / 2.0;
+
+  /*  zooming in shows less of the image, zooming out more  */
+  if (zoom_ratio < 1.0)
     {
-      gimp_cairo_set_source_rgba (cr, &shell->mask_color);
-      cairo_mask_surface (cr, shell->mask_surface,
-                          x - mask_src_x,
-                          y - mask_src_y);
+      vw = ceil (vw / zoom_ratio);
+      vh = ceil (vh / zoom_ratio);
     }
+
+  x1 = MAX (floor (cx - vw / 2.0), 0);
+  y1 = MAX (floor (cy - vh / 2.0), 0);
+  x2 = MIN (ceil  (cx + vw / 2.0), gimp_image_get_width  (image));
+  y2 = MIN (ceil  (cy + vh / 2.0), gimp_image_get_height (image));
+
+  x1 = floor (x1 * scale / tile_width)  * tile_width;
+  y1 = floor (y1 * scale / tile_height) * tile_height;
+  x2 = ceil  (x2 * scale);
+  y2 = ceil  (y2 * scale);
+
+  for (tile_y = y1; tile_y < y2; tile_y += tile_height)
+    for (tile_x = x1; tile_x < x2; tile_x += tile_width)
+      {
+        if (! gimp_display_shell_render_get_tile (shell, tile_x, tile_y,
+                                                  scale, FALSE))
+          {
+            gimp_display_shell_render_get_tile (shell, tile_x, tile_y,
+                                                scale, TRUE);
+
+            return TRUE;
+          }
+      }
+
+  return FALSE;
+}
+
+static guint
+render_tile_hash (gconstpointer key)
+{
+  const RenderTile *tile = key;
+
+  return ((guint) tile->scale_key * 2654435761u ^
+          (guint) tile->x         * 73856093u   ^
+          (guint) tile->y         * 19349663u);
+}
+
+static gboolean
+render_tile_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const RenderTile *tile1 = a;
+  const RenderTile *tile2 = b;
+
+  return (tile1->scale_key == tile2->scale_key &&
+          tile1->x         == tile2->x         &&
+          tile1->y         == tile2->y);
+}
+
+static void
+render_tile_free (RenderTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+
+  g_slice_free (RenderTile, tile);
 }
@@ -168,6 +168,9 @@ struct _GimpDisplayShell
 
   GimpDisplayXfer   *xfer;             /*  manages image buffer transfers     */
   cairo_surface_t   *mask_surface;     /*  buffer for rendering the mask      */
+  GHashTable        *render_cache;     /*  display-ready tiles of the image   */
+  GQueue            *render_cache_lru; /*  render_cache's tiles, newest first */
+  guint              render_prefetch_id;
   cairo_pattern_t   *checkerboard;     /*  checkerboard pattern               */
 
   gint               paused_count;
@@ -26,6 +26,7 @@
 
 #include "display-types.h"
 
+#include "core/gimp-latency.h"
 #include "core/gimpcoords.h"
 #include "core/gimpcoords-interpolate.h"
 #include "core/gimpmarshal.h"
@@ -426,6 +427,11 @@ gimp_motion_buffer_motion_event (GimpMotionBuffer *buffer,
 
   g_array_append_val (buffer->event_queue, *coords);
 
+  buffer->last_event_time = g_get_monotonic_time ();
+
+  if (! buffer->event_queue_time)
+    buffer->event_queue_time = buffer->last_event_time;
+
   buffer->last_coords            = *coords;
   buffer->last_motion_time       = time;
   buffer->last_motion_delta_time = delta_time;
@@ -475,14 +481,24 @@ gimp_motion_buffer_request_stroke (GimpMotionBuffer *buffer,
 
   buffer->last_active_state = state;
 
-  while (buffer->event_queue->len > keep)
+  if (buffer->event_queue->len > keep)
     {
-      GimpCoords buf_coords;
+      gimp_latency_begin_input (buffer->event_queue_time);
+
+      while (buffer->event_queue->len > keep)
+        {
+          GimpCoords buf_coords;
 
-      gimp_motion_buffer_pop_event_queue (buffer, &buf_coords);
+          gimp_motion_buffer_pop_event_queue (buffer, &buf_coords);
 
-      g_signal_emit (buffer, motion_buffer_signals[STROKE], 0,
-                     &buf_coords, time, event_state);
+          g_signal_emit (buffer, motion_buffer_signals[STROKE], 0,
+                         &buf_coords, time, event_state);
+        }
+
+      gimp_latency_end_input ();
+
+      /*  a held back event was received last  */
+      buffer->event_queue_time = keep ? buffer->last_event_time : 0;
     }
 
   if (buffer->event_delay)
@@ -511,6 +527,8 @@ gimp_motion_buffer_request_hover (GimpMotionBuffer *buffer,
                      &buf_coords, state, proximity);
 
       g_array_set_size (buffer->event_queue, 0);
+
+      buffer->event_queue_time = 0;
     }
 }
 
@@ -53,6 +53,12 @@ struct _GimpMotionBuffer
   gboolean    event_delay;      /* TRUE if theres an unsent event in
                                  *  the history buffer
                                  */
+  gint64      event_queue_time; /* monotonic receive time of the oldest
+                                 *  queued event, for latency tracking
+                                 */
+  gint64      last_event_time;  /* monotonic receive time of the last
+                                 *  queued event
+                                 */
 
   gint               event_delay_timeout;
   GdkModifierType    last_active_state;
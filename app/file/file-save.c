@@ -71,6 +71,7 @@ file_save (Gimp                *gimp,
   gchar             *uri        = NULL;
   gint32             image_ID;
   gint32             drawable_ID;
+  gint               dirty;
   GError            *my_error   = NULL;
 
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), GIMP_PDB_CALLING_ERROR);
@@ -170,6 +171,9 @@ file_save (Gimp                *gimp,
   image_ID    = gimp_image_get_ID (image);
   drawable_ID = gimp_item_get_ID (GIMP_ITEM (drawable));
 
+  /* the image can be edited while it is saved, see below */
+  dirty = gimp_image_is_dirty (image);
+
   return_vals =
     gimp_pdb_execute_procedure_by_name (image->gimp->pdb,
                                         gimp_get_user_context (gimp),
@@ -224,7 +228,8 @@ file_save (Gimp                *gimp,
            */
           gimp_image_set_imported_file (image, NULL);
 
-          gimp_image_clean_all (image);
+          /* only what was saved is clean, not what changed meanwhile */
+          gimp_image_clean_since (image, dirty);
         }
       else if (export_backward)
         {
@@ -36,6 +36,8 @@
 #include "gimp-gegl-nodes.h"
 #include "gegl/gimp-gegl-utils.h"
 
+#include "gimp-trace.h"
+
 
 void
 gimp_gegl_apply_operation (GeglBuffer          *src_buffer,
@@ -163,6 +165,8 @@ gimp_gegl_apply_cached_operation (GeglBuffer          *src_buffer,
         }
     }
 
+  GIMP_TRACE_BEGIN ();
+
   if (cache)
     {
       cairo_region_t *region;
@@ -256,6 +260,9 @@ gimp_gegl_apply_cached_operation (GeglBuffer          *src_buffer,
         }
     }
 
+  GIMP_TRACE_END ("gegl",
+                  g_intern_string (gegl_node_get_operation (operation)));
+
   if (processor)
     g_object_unref (processor);
 
@@ -0,0 +1,291 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "gimp-trace.h"
+
+
+/*  the number of spans kept, older ones are overwritten  */
+#define TRACE_N_EVENTS (1 << 16)
+
+
+typedef struct
+{
+  gint         serial;     /* 0 while the event is being written */
+  const gchar *category;
+  const gchar *name;
+  gint64       start_time;
+  gint64       duration;
+  gint         thread;
+} TraceEvent;
+
+
+static gint   gimp_trace_get_thread     (void);
+static gint   gimp_trace_event_compare  (const TraceEvent *event1,
+                                         const TraceEvent *event2);
+static void   gimp_trace_append_string  (GString          *str,
+                                         const gchar      *string);
+
+
+gboolean gimp_trace_active = FALSE;
+
+static GMutex      trace_mutex;
+static TraceEvent *trace_events      = NULL;
+static gint        trace_next_event  = 0;
+static gint        trace_n_writers   = 0;
+static gint        trace_next_thread = 0;
+static gint        trace_main_thread = 0;
+static gint64      trace_start_time  = 0;
+static GPrivate    trace_thread_key;
+
+
+/*  starts recording spans, dropping the ones of a previous recording.
+ *  the calling thread is labeled as the main thread.
+ */
+void
+gimp_trace_start (void)
+{
+  TraceEvent *old_events;
+
+  g_mutex_lock (&trace_mutex);
+
+  /*  other threads may still be recording into the old buffer, so
+   *  swap in a fresh one and only free the old one once they are done
+   */
+  old_events = g_atomic_pointer_get (&trace_events);
+
+  g_atomic_int_set (&trace_next_event, 0);
+  g_atomic_pointer_set (&trace_events, g_new0 (TraceEvent, TRACE_N_EVENTS));
+
+  if (old_events)
+    {
+      while (g_atomic_int_get (&trace_n_writers) > 0)
+        g_thread_yield ();
+
+      g_free (old_events);
+    }
+
+  trace_main_thread = gimp_trace_get_thread ();
+  trace_start_time  = g_get_monotonic_time ();
+
+  gimp_trace_active = TRUE;
+
+  g_mutex_unlock (&trace_mutex);
+}
+
+/*  stops recording, the recorded spans are kept until the next start  */
+void
+gimp_trace_stop (void)
+{
+  g_mutex_lock (&trace_mutex);
+
+  gimp_trace_active = FALSE;
+
+  g_mutex_unlock (&trace_mutex);
+}
+
+gint64
+gimp_trace_begin (void)
+{
+  if (! gimp_trace_active)
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+/*  records a span which started at 'start_time', as returned by
+ *  gimp_trace_begin(), and ends now.  can be called from any thread.
+ */
+void
+gimp_trace_end (const gchar *category,
+                const gchar *name,
+                gint64       start_time)
+{
+  TraceEvent *events;
+  TraceEvent *event;
+  gint64      end_time;
+  guint       index;
+
+  /*  spans which end after the recording was stopped are dropped  */
+  if (! start_time || ! gimp_trace_active)
+    return;
+
+  end_time = g_get_monotonic_time ();
+
+  g_atomic_int_inc (&trace_n_writers);
+
+  events = g_atomic_pointer_get (&trace_events);
+
+  if (! events)
+    {
+      g_atomic_int_dec_and_test (&trace_n_writers);
+      return;
+    }
+
+  index = (guint) g_atomic_int_add (&trace_next_event, 1);
+  event = &events[index % TRACE_N_EVENTS];
+
+  g_atomic_int_set (&event->serial, 0);
+
+  event->category   = category;
+  event->name       = name;
+  event->start_time = start_time;
+  event->duration   = end_time - start_time;
+  event->thread     = gimp_trace_get_thread ();
+
+  g_atomic_int_set (&event->serial, index + 1);
+
+  g_atomic_int_dec_and_test (&trace_n_writers);
+}
+
+/*  writes the recorded spans to 'file' in the Chrome trace event
+ *  format, as understood by chrome://tracing and Perfetto
+ */
+gboolean
+gimp_trace_save (GFile   *file,
+                 GError **error)
+{
+  GArray   *events;
+  GString  *str;
+  gboolean  success;
+  gint      i;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  events = g_array_new (FALSE, FALSE, sizeof (TraceEvent));
+
+  g_mutex_lock (&trace_mutex);
+
+  for (i = 0; trace_events && i < TRACE_N_EVENTS; i++)
+    {
+      TraceEvent event;
+      gint       serial;
+
+      serial = g_atomic_int_get (&trace_events[i].serial);
+
+      event = trace_events[i];
+
+      /*  skip events which are being written concurrently  */
+      if (serial && serial == g_atomic_int_get (&trace_events[i].serial) &&
+          event.start_time >= trace_start_time)
+        {
+          g_array_append_val (events, event);
+        }
+    }
+
+  str = g_string_new ("{\n  \"displayTimeUnit\": \"ms\",\n"
+                      "  \"traceEvents\": [\n");
+
+  g_string_append_printf (str,
+                          "    { \"name\": \"thread_name\", \"ph\": \"M\", "
+                          "\"pid\": 1, \"tid\": %d, "
+                          "\"args\": { \"name\": \"main\" } }",
+                          trace_main_thread);
+
+  g_array_sort (events, (GCompareFunc) gimp_trace_event_compare);
+
+  for (i = 0; i < events->len; i++)
+    {
+      const TraceEvent *event = &g_array_index (events, TraceEvent, i);
+
+      g_string_append (str, ",\n    { \"name\": ");
+      gimp_trace_append_string (str, event->name);
+      g_string_append (str, ", \"cat\": ");
+      gimp_trace_append_string (str, event->category);
+      g_string_append_printf (str,
+                              ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                              "\"ts\": %" G_GINT64_FORMAT ", "
+                              "\"dur\": %" G_GINT64_FORMAT " }",
+                              event->thread,
+                              event->start_time - trace_start_time,
+                              event->duration);
+    }
+
+  g_mutex_unlock (&trace_mutex);
+
+  g_string_append (str, "\n  ]\n}\n");
+
+  success = g_file_replace_contents (file, str->str, str->len,
+                                     NULL, FALSE, G_FILE_CREATE_NONE,
+                                     NULL, NULL, error);
+
+  g_string_free (str, TRUE);
+  g_array_free (events, TRUE);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gint
+gimp_trace_get_thread (void)
+{
+  gint thread = GPOINTER_TO_INT (g_private_get (&trace_thread_key));
+
+  if (! thread)
+    {
+      thread = g_atomic_int_add (&trace_next_thread, 1) + 1;
+
+      g_private_set (&trace_thread_key, GINT_TO_POINTER (thread));
+    }
+
+  return thread;
+}
+
+static gint
+gimp_trace_event_compare (const TraceEvent *event1,
+                          const TraceEvent *event2)
+{
+  if (event1->start_time < event2->start_time)
+    return -1;
+  else if (event1->start_time > event2->start_time)
+    return 1;
+
+  /*  put enclosing spans first  */
+  if (event1->duration > event2->duration)
+    return -1;
+  else if (event1->duration < event2->duration)
+    return 1;
+
+  return 0;
+}
+
+static void
+gimp_trace_append_string (GString     *str,
+                          const gchar *string)
+{
+  const gchar *s;
+
+  g_string_append_c (str, '"');
+
+  for (s = string ? string : ""; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (str, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (str, "\\u%04x", (guchar) *s);
+      else
+        g_string_append_c (str, *s);
+    }
+
+  g_string_append_c (str, '"');
+}
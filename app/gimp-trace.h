@@ -0,0 +1,48 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TRACE_H__
+#define __GIMP_TRACE_H__
+
+
+extern gboolean gimp_trace_active;
+
+
+void       gimp_trace_start     (void);
+void       gimp_trace_stop      (void);
+
+gint64     gimp_trace_begin     (void);
+void       gimp_trace_end       (const gchar  *category,
+                                 const gchar  *name,
+                                 gint64        start_time);
+
+gboolean   gimp_trace_save      (GFile        *file,
+                                 GError      **error);
+
+
+/*  records the enclosed code as a span, 'category' and 'name' must be
+ *  static or interned strings.  they are only evaluated while tracing.
+ */
+#define GIMP_TRACE_BEGIN() \
+  { gint64 _gimp_trace_time = gimp_trace_active ? gimp_trace_begin () : 0;
+
+#define GIMP_TRACE_END(category, name) \
+  if (_gimp_trace_time) \
+    gimp_trace_end ((category), (name), _gimp_trace_time); }
+
+
+#endif /* __GIMP_TRACE_H__ */
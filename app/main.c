@@ -120,7 +120,9 @@ static const gchar        *user_gimprc       = NULL;
 static const gchar        *session_name      = NULL;
 static const gchar        *batch_interpreter = NULL;
 static const gchar       **batch_commands    = NULL;
+static gint                batch_jobs        = 1;
 static const gchar       **filenames         = NULL;
+static const gchar        *trace_file        = NULL;
 static gboolean            as_new            = FALSE;
 static gboolean            no_interface      = FALSE;
 static gboolean            no_data           = FALSE;
@@ -229,6 +231,11 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_STRING, &batch_interpreter,
     N_("The procedure to process batch commands with"), "<proc>"
   },
+  {
+    "batch-jobs", 0, 0,
+    G_OPTION_ARG_INT, &batch_jobs,
+    N_("Run up to <n> batch commands at the same time"), "<n>"
+  },
   {
     "console-messages", 'c', 0,
     G_OPTION_ARG_NONE, &console_messages,
@@ -277,6 +284,12 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_CALLBACK, gimp_option_dump_pdb_procedures_deprecated,
     N_("Output a sorted list of deprecated procedures in the PDB"), NULL
   },
+  {
+    "trace", 0, 0,
+    G_OPTION_ARG_FILENAME, &trace_file,
+    N_("Record a timeline trace and write it to <filename> on exit"),
+    "<filename>"
+  },
   {
     "show-playground", 0, G_OPTION_FLAG_HIDDEN,
     G_OPTION_ARG_NONE, &show_playground,
@@ -521,6 +534,7 @@ main (int    argc,
            session_name,
            batch_interpreter,
            batch_commands,
+           batch_jobs,
            as_new,
            no_interface,
            no_data,
@@ -534,7 +548,8 @@ main (int    argc,
            show_playground,
            stack_trace_mode,
            pdb_compat_mode,
-           backtrace_file);
+           backtrace_file,
+           trace_file);
 
   if (backtrace_file)
     g_free (backtrace_file);
@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -672,6 +674,220 @@ gimp_cage_config_point_inside (GimpCageConfig *gcc,
   return inside;
 }
 
+/**
+ * gimp_cage_config_get_coef_grid:
+ * @gcc: the cage config
+ * @area: return location for the area covered by the grid
+ * @n_cols: return location for the number of grid columns
+ * @n_rows: return location for the number of grid rows
+ *
+ * The cage coefficients are only computed on a grid of
+ * GIMP_CAGE_COEF_GRID_SIZE pixels spacing covering the source cage.
+ * Grid node (i, j) sits at (@area->x + i * GIMP_CAGE_COEF_GRID_SIZE,
+ * @area->y + j * GIMP_CAGE_COEF_GRID_SIZE).
+ *
+ * This function does not take into account an eventual displacement.
+ */
+void
+gimp_cage_config_get_coef_grid (GimpCageConfig *gcc,
+                                GeglRectangle  *area,
+                                gint           *n_cols,
+                                gint           *n_rows)
+{
+  gdouble x1, y1, x2, y2;
+  gint    i;
+
+  g_return_if_fail (GIMP_IS_CAGE_CONFIG (gcc));
+  g_return_if_fail (gcc->cage_points->len > 0);
+  g_return_if_fail (area != NULL);
+
+  x1 = x2 = (g_array_index (gcc->cage_points, GimpCagePoint, 0)).src_point.x;
+  y1 = y2 = (g_array_index (gcc->cage_points, GimpCagePoint, 0)).src_point.y;
+
+  for (i = 1; i < gcc->cage_points->len; i++)
+    {
+      GimpVector2 *point;
+
+      point = &((g_array_index (gcc->cage_points, GimpCagePoint, i)).src_point);
+
+      x1 = MIN (x1, point->x);
+      y1 = MIN (y1, point->y);
+      x2 = MAX (x2, point->x);
+      y2 = MAX (y2, point->y);
+    }
+
+  area->x      = floor (x1);
+  area->y      = floor (y1);
+  area->width  = ceil (x2) - area->x + 1;
+  area->height = ceil (y2) - area->y + 1;
+
+  if (n_cols)
+    *n_cols = (area->width  + GIMP_CAGE_COEF_GRID_SIZE - 2) /
+              GIMP_CAGE_COEF_GRID_SIZE + 1;
+  if (n_rows)
+    *n_rows = (area->height + GIMP_CAGE_COEF_GRID_SIZE - 2) /
+              GIMP_CAGE_COEF_GRID_SIZE + 1;
+}
+
+static gboolean
+gimp_cage_config_is_on_straight (const GimpVector2 *d1,
+                                 const GimpVector2 *d2,
+                                 const GimpVector2 *p)
+{
+  GimpVector2 v1, v2;
+  gfloat      deter;
+
+  v1.x = p->x - d1->x;
+  v1.y = p->y - d1->y;
+  v2.x = d2->x - d1->x;
+  v2.y = d2->y - d1->y;
+
+  gimp_vector2_normalize (&v1);
+  gimp_vector2_normalize (&v2);
+
+  deter = v1.x * v2.y - v2.x * v1.y;
+
+  return (deter < 0.000000001) && (deter > -0.000000001);
+}
+
+/**
+ * gimp_cage_config_compute_coef:
+ * @gcc: the cage config
+ * @x: x coordinate of the point
+ * @y: y coordinate of the point
+ * @coef: 2 * n_points floats to store the coefficients in
+ *
+ * Compute the green coordinates of a point of the source cage: the
+ * first n_points coefficients weight the cage vertices, the last
+ * n_points weight the scaled edge normals.  Points outside the cage
+ * get zero coefficients.
+ *
+ * This function does not take into account an eventual displacement.
+ */
+void
+gimp_cage_config_compute_coef (GimpCageConfig *gcc,
+                               gdouble         x,
+                               gdouble         y,
+                               gfloat         *coef)
+{
+  GimpCagePoint *current, *last;
+  gint           n_cage_vertices;
+  gint           j;
+
+  g_return_if_fail (GIMP_IS_CAGE_CONFIG (gcc));
+  g_return_if_fail (coef != NULL);
+
+  n_cage_vertices = gcc->cage_points->len;
+
+  memset (coef, 0, 2 * n_cage_vertices * sizeof (gfloat));
+
+  if (! gimp_cage_config_point_inside (gcc, x, y))
+    return;
+
+  last = &(g_array_index (gcc->cage_points, GimpCagePoint, 0));
+
+  for (j = 0; j < n_cage_vertices; j++)
+    {
+      GimpVector2 v1,v2,a,b,p;
+      gdouble BA,SRT,L0,L1,A0,A1,A10,L10, Q,S,R, absa;
+
+      current = &(g_array_index (gcc->cage_points, GimpCagePoint, (j+1) % n_cage_vertices));
+      v1 = last->src_point;
+      v2 = current->src_point;
+      p.x = x;
+      p.y = y;
+      a.x = v2.x - v1.x;
+      a.y = v2.y - v1.y;
+      absa = gimp_vector2_length (&a);
+
+      b.x = v1.x - x;
+      b.y = v1.y - y;
+      Q = a.x * a.x + a.y * a.y;
+      S = b.x * b.x + b.y * b.y;
+      R = 2.0 * (a.x * b.x + a.y * b.y);
+      BA = b.x * a.y - b.y * a.x;
+      SRT = sqrt(4.0 * S * Q - R * R);
+
+      L0 = log(S);
+      L1 = log(S + Q + R);
+      A0 = atan2(R, SRT) / SRT;
+      A1 = atan2(2.0 * Q + R, SRT) / SRT;
+      A10 = A1 - A0;
+      L10 = L1 - L0;
+
+      /* edge coef */
+      coef[j + n_cage_vertices] = (-absa / (4.0 * G_PI)) * ((4.0*S-(R*R)/Q) * A10 + (R / (2.0 * Q)) * L10 + L1 - 2.0);
+
+      if (isnan(coef[j + n_cage_vertices]))
+        {
+          coef[j + n_cage_vertices] = 0.0;
+        }
+
+      /* vertice coef */
+      if (!gimp_cage_config_is_on_straight (&v1, &v2, &p))
+        {
+          coef[j] += (BA / (2.0 * G_PI)) * (L10 /(2.0*Q) - A10 * (2.0 + R / Q));
+          coef[(j+1)%n_cage_vertices] -= (BA / (2.0 * G_PI)) * (L10 / (2.0 * Q) - A10 * (R / Q));
+        }
+
+      last = current;
+    }
+}
+
+/**
+ * gimp_cage_config_get_edge_distance:
+ * @gcc: the cage config
+ * @x: x coordinate of the point
+ * @y: y coordinate of the point
+ *
+ * Compute the distance between a point and the closest edge of the
+ * source cage.
+ *
+ * This function does not take into account an eventual displacement.
+ *
+ * Returns: the distance to the cage outline
+ */
+gdouble
+gimp_cage_config_get_edge_distance (GimpCageConfig *gcc,
+                                    gdouble         x,
+                                    gdouble         y)
+{
+  GimpVector2 *last, *current;
+  gdouble      distance = G_MAXDOUBLE;
+  gint         i;
+
+  g_return_val_if_fail (GIMP_IS_CAGE_CONFIG (gcc), 0.0);
+
+  last = &((g_array_index (gcc->cage_points, GimpCagePoint, gcc->cage_points->len - 1)).src_point);
+
+  for (i = 0; i < gcc->cage_points->len; i++)
+    {
+      gdouble ax, ay;
+      gdouble px, py;
+      gdouble len2;
+      gdouble t;
+
+      current = &((g_array_index (gcc->cage_points, GimpCagePoint, i)).src_point);
+
+      ax = current->x - last->x;
+      ay = current->y - last->y;
+      px = x - last->x;
+      py = y - last->y;
+
+      len2 = ax * ax + ay * ay;
+      t    = len2 > 0.0 ? CLAMP ((px * ax + py * ay) / len2, 0.0, 1.0) : 0.0;
+
+      px -= t * ax;
+      py -= t * ay;
+
+      distance = MIN (distance, px * px + py * py);
+
+      last = current;
+    }
+
+  return sqrt (distance);
+}
+
 /**
  * gimp_cage_config_select_point:
  * @gcc: the cage config
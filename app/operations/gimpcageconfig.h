@@ -24,6 +24,12 @@
 #include "core/gimpsettings.h"
 
 
+/* the cage coefficients are only computed every GIMP_CAGE_COEF_GRID_SIZE
+ * pixels, see gimp_cage_config_get_coef_grid()
+ */
+#define GIMP_CAGE_COEF_GRID_SIZE 8
+
+
 struct _GimpCagePoint
 {
   GimpVector2 src_point;
@@ -90,6 +96,17 @@ void            gimp_cage_config_reverse_cage           (GimpCageConfig  *gcc);
 gboolean        gimp_cage_config_point_inside           (GimpCageConfig  *gcc,
                                                          gfloat           x,
                                                          gfloat           y);
+void            gimp_cage_config_get_coef_grid          (GimpCageConfig  *gcc,
+                                                         GeglRectangle   *area,
+                                                         gint            *n_cols,
+                                                         gint            *n_rows);
+void            gimp_cage_config_compute_coef           (GimpCageConfig  *gcc,
+                                                         gdouble          x,
+                                                         gdouble          y,
+                                                         gfloat          *coef);
+gdouble         gimp_cage_config_get_edge_distance      (GimpCageConfig  *gcc,
+                                                         gdouble          x,
+                                                         gdouble          y);
 void            gimp_cage_config_select_point           (GimpCageConfig  *gcc,
                                                          gint             point_number);
 void            gimp_cage_config_select_area            (GimpCageConfig  *gcc,
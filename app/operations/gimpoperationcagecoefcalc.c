@@ -73,6 +73,7 @@ gimp_operation_cage_coef_calc_class_init (GimpOperationCageCoefCalcClass *klass)
   operation_class->get_bounding_box   = gimp_operation_cage_coef_calc_get_bounding_box;
   operation_class->no_cache           = FALSE;
   operation_class->get_cached_region  = NULL;
+  operation_class->threaded           = TRUE;
 
   source_class->process               = gimp_operation_cage_coef_calc_process;
 
@@ -147,27 +148,6 @@ gimp_operation_cage_coef_calc_set_property (GObject      *object,
     }
 }
 
-static gboolean
-gimp_operation_cage_coef_calc_is_on_straight (GimpVector2 *d1,
-                                              GimpVector2 *d2,
-                                              GimpVector2 *p)
-{
-  GimpVector2 v1, v2;
-  gfloat      deter;
-
-  v1.x = p->x - d1->x;
-  v1.y = p->y - d1->y;
-  v2.x = d2->x - d1->x;
-  v2.y = d2->y - d1->y;
-
-  gimp_vector2_normalize (&v1);
-  gimp_vector2_normalize (&v2);
-
-  deter = v1.x * v2.y - v2.x * v1.y;
-
-  return (deter < 0.000000001) && (deter > -0.000000001);
-}
-
 static void
 gimp_operation_cage_coef_calc_prepare (GeglOperation *operation)
 {
@@ -185,8 +165,17 @@ gimp_operation_cage_coef_calc_get_bounding_box (GeglOperation *operation)
 {
   GimpOperationCageCoefCalc *occc   = GIMP_OPERATION_CAGE_COEF_CALC (operation);
   GimpCageConfig            *config = GIMP_CAGE_CONFIG (occc->config);
+  GeglRectangle              area;
+  gint                       n_cols;
+  gint                       n_rows;
+
+  if (! config || gimp_cage_config_get_n_points (config) == 0)
+    return *GEGL_RECTANGLE (0, 0, 0, 0);
+
+  gimp_cage_config_get_coef_grid (config, &area, &n_cols, &n_rows);
 
-  return gimp_cage_config_get_bounding_box (config);
+  /* one pixel per grid node */
+  return *GEGL_RECTANGLE (0, 0, n_cols, n_rows);
 }
 
 static gboolean
@@ -202,17 +191,19 @@ gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
 
   GeglBufferIterator *it;
   guint               n_cage_vertices;
-  GimpCagePoint      *current, *last;
+  GeglRectangle       area;
 
   if (! config)
     return FALSE;
 
-  format = babl_format_n (babl_type ("float"), 2 * gimp_cage_config_get_n_points (config));
+  n_cage_vertices = gimp_cage_config_get_n_points (config);
 
-  n_cage_vertices   = gimp_cage_config_get_n_points (config);
+  format = babl_format_n (babl_type ("float"), 2 * n_cage_vertices);
+
+  gimp_cage_config_get_coef_grid (config, &area, NULL, NULL);
 
   it = gegl_buffer_iterator_new (output, roi, 0, format,
-                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
+                                 GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (it))
     {
@@ -220,63 +211,15 @@ gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
       gint  n_pixels = it->length;
       gint  x = it->roi->x; /* initial x                   */
       gint  y = it->roi->y; /*           and y coordinates */
-      gint  j;
 
       gfloat      *coef = it->data[0];
 
       while(n_pixels--)
         {
-          if (gimp_cage_config_point_inside(config, x, y))
-            {
-              last = &(g_array_index (config->cage_points, GimpCagePoint, 0));
-
-              for( j = 0; j < n_cage_vertices; j++)
-                {
-                  GimpVector2 v1,v2,a,b,p;
-                  gdouble BA,SRT,L0,L1,A0,A1,A10,L10, Q,S,R, absa;
-
-                  current = &(g_array_index (config->cage_points, GimpCagePoint, (j+1) % n_cage_vertices));
-                  v1 = last->src_point;
-                  v2 = current->src_point;
-                  p.x = x;
-                  p.y = y;
-                  a.x = v2.x - v1.x;
-                  a.y = v2.y - v1.y;
-                  absa = gimp_vector2_length (&a);
-
-                  b.x = v1.x - x;
-                  b.y = v1.y - y;
-                  Q = a.x * a.x + a.y * a.y;
-                  S = b.x * b.x + b.y * b.y;
-                  R = 2.0 * (a.x * b.x + a.y * b.y);
-                  BA = b.x * a.y - b.y * a.x;
-                  SRT = sqrt(4.0 * S * Q - R * R);
-
-                  L0 = log(S);
-                  L1 = log(S + Q + R);
-                  A0 = atan2(R, SRT) / SRT;
-                  A1 = atan2(2.0 * Q + R, SRT) / SRT;
-                  A10 = A1 - A0;
-                  L10 = L1 - L0;
-
-                  /* edge coef */
-                  coef[j + n_cage_vertices] = (-absa / (4.0 * G_PI)) * ((4.0*S-(R*R)/Q) * A10 + (R / (2.0 * Q)) * L10 + L1 - 2.0);
-
-                  if (isnan(coef[j + n_cage_vertices]))
-                    {
-                      coef[j + n_cage_vertices] = 0.0;
-                    }
-
-                  /* vertice coef */
-                  if (!gimp_operation_cage_coef_calc_is_on_straight (&v1, &v2, &p))
-                    {
-                      coef[j] += (BA / (2.0 * G_PI)) * (L10 /(2.0*Q) - A10 * (2.0 + R / Q));
-                      coef[(j+1)%n_cage_vertices] -= (BA / (2.0 * G_PI)) * (L10 / (2.0 * Q) - A10 * (R / Q));
-                    }
-
-                  last = current;
-                }
-            }
+          gimp_cage_config_compute_coef (config,
+                                         area.x + x * GIMP_CAGE_COEF_GRID_SIZE,
+                                         area.y + y * GIMP_CAGE_COEF_GRID_SIZE,
+                                         coef);
 
           coef += 2 * n_cage_vertices;
 
@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -33,6 +35,20 @@
 
 #include "gimp-intl.h"
 
+/* grid cells whose center lies closer than this many cells to the
+ * cage outline are computed exactly.  the green coordinates are
+ * harmonic inside the cage, so their second derivatives, and with
+ * them the bilinear interpolation error, fall off with the square of
+ * the distance to the outline.
+ */
+#define EXACT_MARGIN 2.0
+
+/* the output is written in bands of this many rows, each by a single
+ * thread, so every pixel has exactly one writer
+ */
+#define BAND_HEIGHT  64
+
+
 enum
 {
   PROP_0,
@@ -41,6 +57,51 @@ enum
 };
 
 
+typedef struct
+{
+  gboolean     skip;         /* outside of the cage                   */
+  gboolean     interpolate;  /* interpolated from the grid nodes      */
+  gdouble      y1, y2;       /* vertical extent of the destination    */
+  GimpVector2 *corners;      /* exact destinations, or NULL if
+                              * interpolated
+                              */
+} CageTransformCell;
+
+typedef struct
+{
+  GeglRectangle  rect;
+  gfloat        *coords;     /* 2 floats per pixel of rect            */
+} CageTransformBand;
+
+typedef struct _CageTransformJob CageTransformJob;
+
+typedef void (* CageTransformTaskFunc) (CageTransformJob *job,
+                                        gint              task);
+
+struct _CageTransformJob
+{
+  GimpOperationCageTransform *oct;
+  GeglBuffer                 *out_buf;
+  const GeglRectangle        *roi;
+
+  GeglRectangle               area;       /* source area of the grid     */
+  gint                        n_cols;
+  gint                        n_rows;
+  GimpVector2                *grid_dest;  /* destination of grid nodes   */
+  CageTransformCell          *cells;      /* (n_cols - 1) x (n_rows - 1) */
+
+  gint                        n_coefs;
+  gfloat                     *weights_x;  /* destination of coefficients */
+  gfloat                     *weights_y;
+
+  CageTransformTaskFunc       func;       /* processes one task          */
+  gint                        n_tasks;
+  gint                        next_task;
+  gint                        n_tasks_done;
+  gdouble                     progress_start;
+};
+
+
 static void         gimp_operation_cage_transform_finalize                (GObject             *object);
 static void         gimp_operation_cage_transform_get_property            (GObject             *object,
                                                                            guint                property_id,
@@ -58,22 +119,35 @@ static gboolean     gimp_operation_cage_transform_process                 (GeglO
                                                                            const GeglRectangle *roi,
                                                                            gint                 level);
 static void         gimp_operation_cage_transform_interpolate_source_coords_recurs
-                                                                          (GimpOperationCageTransform  *oct,
-                                                                           GeglBuffer          *out_buf,
-                                                                           const GeglRectangle *roi,
+                                                                          (CageTransformBand   *band,
                                                                            GimpVector2          p1_s,
                                                                            GimpVector2          p1_d,
                                                                            GimpVector2          p2_s,
                                                                            GimpVector2          p2_d,
                                                                            GimpVector2          p3_s,
                                                                            GimpVector2          p3_d,
-                                                                           gint                 recursion_depth,
-                                                                           gfloat              *coords);
-static GimpVector2  gimp_cage_transform_compute_destination               (GimpCageConfig      *config,
-                                                                           gfloat              *coef,
-                                                                           const Babl          *format_coef,
-                                                                           GeglBuffer          *coef_buf,
-                                                                           GimpVector2          coords);
+                                                                           gint                 recursion_depth);
+static void         gimp_operation_cage_transform_distribute              (CageTransformJob    *job,
+                                                                           CageTransformTaskFunc func,
+                                                                           gint                 n_tasks,
+                                                                           gdouble              progress_start,
+                                                                           GeglOperation       *operation);
+static void         gimp_operation_cage_transform_process_tasks           (CageTransformJob    *job,
+                                                                           GeglOperation       *operation);
+static void         gimp_operation_cage_transform_prepare_cells           (CageTransformJob    *job,
+                                                                           gint                 row);
+static void         gimp_operation_cage_transform_process_band            (CageTransformJob    *job,
+                                                                           gint                 index);
+static void         gimp_operation_cage_transform_get_corners             (CageTransformJob    *job,
+                                                                           gint                 col,
+                                                                           gint                 row,
+                                                                           GimpVector2         *corners,
+                                                                           gfloat              *coef);
+static inline GimpVector2
+                    gimp_cage_transform_compute_destination               (const gfloat        *coef,
+                                                                           const gfloat        *weights_x,
+                                                                           const gfloat        *weights_y,
+                                                                           gint                 n_coefs);
 GeglRectangle       gimp_operation_cage_transform_get_cached_region       (GeglOperation       *operation,
                                                                            const GeglRectangle *roi);
 GeglRectangle       gimp_operation_cage_transform_get_required_for_output (GeglOperation       *operation,
@@ -111,8 +185,8 @@ gimp_operation_cage_transform_class_init (GimpOperationCageTransformClass *klass
   operation_class->get_cached_region       = gimp_operation_cage_transform_get_cached_region;
   operation_class->no_cache                = FALSE;
   operation_class->get_bounding_box        = gimp_operation_cage_transform_get_bounding_box;
-  /* XXX Temporarily disable multi-threading on this operation because
-   * it is much faster when single-threaded. See bug 787663.
+  /* the whole cage is processed at once, process() spreads the grid
+   * cells over its own threads instead.  See bug 787663.
    */
   operation_class->threaded                = FALSE;
 
@@ -205,6 +279,8 @@ gimp_operation_cage_transform_prepare (GeglOperation *operation)
   GimpCageConfig             *config = GIMP_CAGE_CONFIG (oct->config);
 
   gegl_operation_set_format (operation, "input",
+                             babl_format_n (babl_type ("float"), 2));
+  gegl_operation_set_format (operation, "aux",
                              babl_format_n (babl_type ("float"),
                                             2 * gimp_cage_config_get_n_points (config)));
   gegl_operation_set_format (operation, "output",
@@ -221,167 +297,452 @@ gimp_operation_cage_transform_process (GeglOperation       *operation,
 {
   GimpOperationCageTransform *oct    = GIMP_OPERATION_CAGE_TRANSFORM (operation);
   GimpCageConfig             *config = GIMP_CAGE_CONFIG (oct->config);
-  GeglRectangle               cage_bb;
-  gfloat                     *coords;
+  CageTransformJob            job;
   gfloat                     *coef;
   const Babl                 *format_coef;
-  GimpVector2                 plain_color;
-  GeglBufferIterator         *it;
+  gint                        n_cells;
   gint                        x, y;
-  gboolean                    output_set;
+  gint                        i;
   GimpCagePoint              *point;
   guint                       n_cage_vertices;
 
-  /* pre-fill the out buffer with no-displacement coordinate */
-  it      = gegl_buffer_iterator_new (out_buf, roi, 0, NULL,
-                                      GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-  cage_bb = gimp_cage_config_get_bounding_box (config);
-
-  point = &(g_array_index (config->cage_points, GimpCagePoint, 0));
-  plain_color.x = (gint) point->src_point.x;
-  plain_color.y = (gint) point->src_point.y;
+  gegl_operation_progress (operation, 0.0, "");
 
   n_cage_vertices = gimp_cage_config_get_n_points (config);
 
-  while (gegl_buffer_iterator_next (it))
+  gimp_cage_config_get_coef_grid (config, &job.area, &job.n_cols, &job.n_rows);
+
+  n_cells = MAX (job.n_cols - 1, 0) * MAX (job.n_rows - 1, 0);
+
+  job.oct         = oct;
+  job.out_buf     = out_buf;
+  job.roi         = roi;
+  job.n_coefs     = 2 * n_cage_vertices;
+  job.weights_x   = g_new (gfloat, job.n_coefs);
+  job.weights_y   = g_new (gfloat, job.n_coefs);
+  job.grid_dest   = g_new (GimpVector2, job.n_cols * job.n_rows);
+  job.cells       = g_new0 (CageTransformCell, n_cells);
+
+  /* the destination is linear in the coefficients, gather the weights
+   * of the vertex and the edge coefficients in two flat arrays
+   */
+  for (i = 0; i < n_cage_vertices; i++)
     {
-      /* iterate inside the roi */
-      gint    n_pixels = it->length;
-      gfloat *output   = it->data[0];
+      point = &g_array_index (config->cage_points, GimpCagePoint, i);
+
+      job.weights_x[i] = point->dest_point.x;
+      job.weights_y[i] = point->dest_point.y;
+
+      job.weights_x[i + n_cage_vertices] = point->edge_scaling_factor * point->edge_normal.x;
+      job.weights_y[i + n_cage_vertices] = point->edge_scaling_factor * point->edge_normal.y;
+    }
 
-      x = it->roi->x; /* initial x         */
-      y = it->roi->y; /* and y coordinates */
+  /* compute the destination of the grid nodes, one row at a time */
+  format_coef = babl_format_n (babl_type ("float"), job.n_coefs);
+  coef        = g_new (gfloat, job.n_cols * job.n_coefs);
 
-      while (n_pixels--)
+  for (y = 0; y < job.n_rows; y++)
+    {
+      gegl_buffer_get (aux_buf, GEGL_RECTANGLE (0, y, job.n_cols, 1), 1.0,
+                       format_coef, coef,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (x = 0; x < job.n_cols; x++)
         {
-          output_set = FALSE;
-          if (oct->fill_plain_color)
-            {
-              if (x > cage_bb.x &&
-                  y > cage_bb.y &&
-                  x < cage_bb.x + cage_bb.width &&
-                  y < cage_bb.y + cage_bb.height)
-                {
-                  if (gimp_cage_config_point_inside (config, x, y))
-                    {
-                      output[0] = plain_color.x;
-                      output[1] = plain_color.y;
-                      output_set = TRUE;
-                    }
-                }
-            }
-          if (!output_set)
-            {
-              output[0] = x;
-              output[1] = y;
-            }
+          job.grid_dest[y * job.n_cols + x] =
+            gimp_cage_transform_compute_destination (coef + x * job.n_coefs,
+                                                     job.weights_x,
+                                                     job.weights_y,
+                                                     job.n_coefs);
+        }
+    }
+
+  g_free (coef);
+
+  /* classify the grid cells, and compute the exact corners of the ones
+   * near the cage outline, one row of cells per task
+   */
+  gimp_operation_cage_transform_distribute (&job,
+                                            gimp_operation_cage_transform_prepare_cells,
+                                            job.n_rows - 1, 0.0, operation);
+
+  /* then reverse the transformation into bands of the output.  each
+   * band walks the cells in the same order, so pixels covered by more
+   * than one triangle get the same, last, source coordinate no matter
+   * how the bands are spread over the threads
+   */
+  gimp_operation_cage_transform_distribute (&job,
+                                            gimp_operation_cage_transform_process_band,
+                                            (roi->height + BAND_HEIGHT - 1) /
+                                            BAND_HEIGHT,
+                                            0.5, operation);
+
+  for (i = 0; i < n_cells; i++)
+    g_free (job.cells[i].corners);
+
+  g_free (job.cells);
+  g_free (job.grid_dest);
+  g_free (job.weights_y);
+  g_free (job.weights_x);
+
+  gegl_operation_progress (operation, 1.0, "");
+
+  return TRUE;
+}
+
+/* runs func for tasks 0 to n_tasks - 1 on GEGL's number of
+ * threads, the calling thread takes part and reports the progress from
+ * progress_start on
+ */
+static void
+gimp_operation_cage_transform_distribute (CageTransformJob      *job,
+                                          CageTransformTaskFunc  func,
+                                          gint                   n_tasks,
+                                          gdouble                progress_start,
+                                          GeglOperation         *operation)
+{
+  GThreadPool *pool = NULL;
+  gint         n_threads;
+  gint         i;
+
+  if (n_tasks <= 0)
+    return;
+
+  job->func           = func;
+  job->n_tasks        = n_tasks;
+  job->next_task      = 0;
+  job->n_tasks_done   = 0;
+  job->progress_start = progress_start;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  n_threads = CLAMP (n_threads, 1, n_tasks);
+
+  if (n_threads > 1)
+    {
+      pool = g_thread_pool_new ((GFunc) gimp_operation_cage_transform_process_tasks,
+                                NULL, n_threads - 1, TRUE, NULL);
+
+      for (i = 0; i < n_threads - 1; i++)
+        g_thread_pool_push (pool, job, NULL);
+    }
+
+  gimp_operation_cage_transform_process_tasks (job, operation);
+
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+static void
+gimp_operation_cage_transform_process_tasks (CageTransformJob *job,
+                                             GeglOperation    *operation)
+{
+  gint task;
+  gint n_done;
+
+  while ((task = g_atomic_int_add (&job->next_task, 1)) < job->n_tasks)
+    {
+      job->func (job, task);
+
+      n_done = g_atomic_int_add (&job->n_tasks_done, 1) + 1;
 
-          output += 2;
+      if (operation)
+        {
+          gdouble fraction = (job->progress_start +
+                              0.5 * (gdouble) n_done / (gdouble) job->n_tasks);
 
-          /* update x and y coordinates */
-          x++;
-          if (x >= (it->roi->x + it->roi->width))
+          /*  0.0 and 1.0 indicate progress start/end, so avoid them  */
+          if (fraction > 0.0 && fraction < 1.0)
             {
-              x = it->roi->x;
-              y++;
+              gegl_operation_progress (operation, fraction, "");
             }
         }
     }
+}
 
-  gegl_operation_progress (operation, 0.0, "");
+static void
+gimp_operation_cage_transform_prepare_cells (CageTransformJob *job,
+                                             gint              row)
+{
+  GimpCageConfig *config = GIMP_CAGE_CONFIG (job->oct->config);
+  gint            size   = GIMP_CAGE_COEF_GRID_SIZE + 1;
+  gfloat         *coef;
+  gint            col;
 
-  /* pre-allocate memory outside of the loop */
-  coords      = g_slice_alloc (2 * sizeof (gfloat));
-  coef        = g_malloc (n_cage_vertices * 2 * sizeof (gfloat));
-  format_coef = babl_format_n (babl_type ("float"), 2 * n_cage_vertices);
+  coef = g_new (gfloat, job->n_coefs);
 
-  /* compute, reverse and interpolate the transformation */
-  for (y = cage_bb.y; y < cage_bb.y + cage_bb.height - 1; y++)
+  for (col = 0; col < job->n_cols - 1; col++)
     {
-      GimpVector2 p1_d, p2_d, p3_d, p4_d;
-      GimpVector2 p1_s, p2_s, p3_s, p4_s;
+      CageTransformCell *cell = &job->cells[row * (job->n_cols - 1) + col];
+      gint               x0, y0;
+      gdouble            center_x, center_y;
+      gdouble            distance;
+      gboolean           inside;
 
-      p1_s.y = y;
-      p2_s.y = y+1;
-      p3_s.y = y+1;
-      p3_s.x = cage_bb.x;
-      p4_s.y = y;
-      p4_s.x = cage_bb.x;
+      x0 = job->area.x + col * GIMP_CAGE_COEF_GRID_SIZE;
+      y0 = job->area.y + row * GIMP_CAGE_COEF_GRID_SIZE;
 
-      p3_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p3_s);
-      p4_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p4_s);
+      center_x = x0 + GIMP_CAGE_COEF_GRID_SIZE / 2.0;
+      center_y = y0 + GIMP_CAGE_COEF_GRID_SIZE / 2.0;
 
-      for (x = cage_bb.x; x < cage_bb.x + cage_bb.width - 1; x++)
+      inside   = gimp_cage_config_point_inside (config, center_x, center_y);
+      distance = gimp_cage_config_get_edge_distance (config, center_x, center_y);
+
+      /* the cell lies entirely outside of the cage */
+      if (! inside && distance > GIMP_CAGE_COEF_GRID_SIZE)
         {
-          p1_s = p4_s;
-          p2_s = p3_s;
-          p3_s.x = x+1;
-          p4_s.x = x+1;
+          cell->skip = TRUE;
+          continue;
+        }
 
-          p1_d = p4_d;
-          p2_d = p3_d;
-          p3_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p3_s);
-          p4_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p4_s);
+      cell->interpolate = (inside &&
+                           distance >= EXACT_MARGIN * GIMP_CAGE_COEF_GRID_SIZE);
 
-          if (gimp_cage_config_point_inside (config, x, y))
-            {
-              gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                              out_buf,
-                                                                              roi,
-                                                                              p1_s, p1_d,
-                                                                              p2_s, p2_d,
-                                                                              p3_s, p3_d,
-                                                                              0,
-                                                                              coords);
-
-              gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                              out_buf,
-                                                                              roi,
-                                                                              p1_s, p1_d,
-                                                                              p3_s, p3_d,
-                                                                              p4_s, p4_d,
-                                                                              0,
-                                                                              coords);
-            }
-        }
+      if (cell->interpolate)
+        {
+          /* the bilinear interpolation stays within the grid nodes */
+          const GimpVector2 *d00 = &job->grid_dest[row * job->n_cols + col];
+          const GimpVector2 *d01 = d00 + job->n_cols;
 
-      if ((y - cage_bb.y) % 20 == 0)
+          cell->y1 = MIN (MIN (d00[0].y, d00[1].y), MIN (d01[0].y, d01[1].y));
+          cell->y2 = MAX (MAX (d00[0].y, d00[1].y), MAX (d01[0].y, d01[1].y));
+        }
+      else
         {
-          gdouble fraction = ((gdouble) (y - cage_bb.y) /
-                              (gdouble) (cage_bb.height));
+          gint i;
 
-          /*  0.0 and 1.0 indicate progress start/end, so avoid them  */
-          if (fraction > 0.0 && fraction < 1.0)
+          cell->corners = g_new (GimpVector2, size * size);
+
+          gimp_operation_cage_transform_get_corners (job, col, row,
+                                                     cell->corners, coef);
+
+          cell->y1 = cell->y2 = cell->corners[0].y;
+
+          for (i = 1; i < size * size; i++)
             {
-              gegl_operation_progress (operation, fraction, "");
+              cell->y1 = MIN (cell->y1, cell->corners[i].y);
+              cell->y2 = MAX (cell->y2, cell->corners[i].y);
             }
         }
     }
 
   g_free (coef);
-  g_slice_free1 (2 * sizeof (gfloat), coords);
+}
 
-  gegl_operation_progress (operation, 1.0, "");
+static void
+gimp_operation_cage_transform_process_band (CageTransformJob *job,
+                                            gint              index)
+{
+  GimpOperationCageTransform *oct    = job->oct;
+  GimpCageConfig             *config = GIMP_CAGE_CONFIG (oct->config);
+  gint                        size   = GIMP_CAGE_COEF_GRID_SIZE + 1;
+  CageTransformBand           band;
+  GeglRectangle               cage_bb;
+  GimpCagePoint              *point;
+  GimpVector2                 plain_color;
+  GimpVector2                *corners;
+  gfloat                     *output;
+  gint                        x, y;
+  gint                        col, row;
 
-  return TRUE;
+  band.rect.x      = job->roi->x;
+  band.rect.y      = job->roi->y + index * BAND_HEIGHT;
+  band.rect.width  = job->roi->width;
+  band.rect.height = MIN (BAND_HEIGHT,
+                          job->roi->y + job->roi->height - band.rect.y);
+  band.coords      = g_new (gfloat, 2 * band.rect.width * band.rect.height);
+
+  cage_bb = gimp_cage_config_get_bounding_box (config);
+
+  point = &(g_array_index (config->cage_points, GimpCagePoint, 0));
+  plain_color.x = (gint) point->src_point.x;
+  plain_color.y = (gint) point->src_point.y;
+
+  /* pre-fill the band with no-displacement coordinate */
+  output = band.coords;
+
+  for (y = band.rect.y; y < band.rect.y + band.rect.height; y++)
+    for (x = band.rect.x; x < band.rect.x + band.rect.width; x++)
+      {
+        gboolean output_set = FALSE;
+
+        if (oct->fill_plain_color)
+          {
+            if (x > cage_bb.x &&
+                y > cage_bb.y &&
+                x < cage_bb.x + cage_bb.width &&
+                y < cage_bb.y + cage_bb.height)
+              {
+                if (gimp_cage_config_point_inside (config, x, y))
+                  {
+                    output[0] = plain_color.x;
+                    output[1] = plain_color.y;
+                    output_set = TRUE;
+                  }
+              }
+          }
+        if (!output_set)
+          {
+            output[0] = x;
+            output[1] = y;
+          }
+
+        output += 2;
+      }
+
+  corners = g_new (GimpVector2, size * size);
+
+  for (row = 0; row < job->n_rows - 1; row++)
+    for (col = 0; col < job->n_cols - 1; col++)
+      {
+        CageTransformCell *cell = &job->cells[row * (job->n_cols - 1) + col];
+        const GimpVector2 *cell_corners;
+        gint               x0, y0;
+        gint               width, height;
+        gint               i, j;
+
+        if (cell->skip                                     ||
+            cell->y2 <  band.rect.y                        ||
+            cell->y1 >= band.rect.y + band.rect.height)
+          continue;
+
+        x0 = job->area.x + col * GIMP_CAGE_COEF_GRID_SIZE;
+        y0 = job->area.y + row * GIMP_CAGE_COEF_GRID_SIZE;
+
+        /* the unit squares of this cell, the last pixel of the area
+         * only ever is a corner
+         */
+        width  = MIN (GIMP_CAGE_COEF_GRID_SIZE, job->area.x + job->area.width  - 1 - x0);
+        height = MIN (GIMP_CAGE_COEF_GRID_SIZE, job->area.y + job->area.height - 1 - y0);
+
+        if (width <= 0 || height <= 0)
+          continue;
+
+        if (cell->interpolate)
+          {
+            gimp_operation_cage_transform_get_corners (job, col, row,
+                                                       corners, NULL);
+            cell_corners = corners;
+          }
+        else
+          {
+            cell_corners = cell->corners;
+          }
+
+        for (j = 0; j < height; j++)
+          for (i = 0; i < width; i++)
+            {
+              gint        x = x0 + i;
+              gint        y = y0 + j;
+              GimpVector2 p1_s, p2_s, p3_s, p4_s;
+
+              if (! cell->interpolate &&
+                  ! gimp_cage_config_point_inside (config, x, y))
+                continue;
+
+              p1_s.x = x;     p1_s.y = y;
+              p2_s.x = x;     p2_s.y = y + 1;
+              p3_s.x = x + 1; p3_s.y = y + 1;
+              p4_s.x = x + 1; p4_s.y = y;
+
+              gimp_operation_cage_transform_interpolate_source_coords_recurs (&band,
+                                                                              p1_s, cell_corners[j * size + i],
+                                                                              p2_s, cell_corners[(j + 1) * size + i],
+                                                                              p3_s, cell_corners[(j + 1) * size + i + 1],
+                                                                              0);
+
+              gimp_operation_cage_transform_interpolate_source_coords_recurs (&band,
+                                                                              p1_s, cell_corners[j * size + i],
+                                                                              p3_s, cell_corners[(j + 1) * size + i + 1],
+                                                                              p4_s, cell_corners[j * size + i + 1],
+                                                                              0);
+            }
+      }
+
+  g_free (corners);
+
+  /* the bands don't overlap, so the threads never write the same tile
+   * area
+   */
+  gegl_buffer_set (job->out_buf, &band.rect, 0, oct->format_coords,
+                   band.coords, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (band.coords);
 }
 
+/* computes the destination of the corners of the unit squares of a
+ * grid cell, either interpolating the grid nodes bilinearly, or, if
+ * coef is not NULL, exactly
+ */
+static void
+gimp_operation_cage_transform_get_corners (CageTransformJob *job,
+                                           gint              col,
+                                           gint              row,
+                                           GimpVector2      *corners,
+                                           gfloat           *coef)
+{
+  GimpCageConfig *config = GIMP_CAGE_CONFIG (job->oct->config);
+  gint            size   = GIMP_CAGE_COEF_GRID_SIZE + 1;
+  gint            x0, y0;
+  gint            i, j;
+
+  x0 = job->area.x + col * GIMP_CAGE_COEF_GRID_SIZE;
+  y0 = job->area.y + row * GIMP_CAGE_COEF_GRID_SIZE;
+
+  if (! coef)
+    {
+      const GimpVector2 *d00 = &job->grid_dest[row * job->n_cols + col];
+      const GimpVector2 *d10 = d00 + 1;
+      const GimpVector2 *d01 = d00 + job->n_cols;
+      const GimpVector2 *d11 = d01 + 1;
+
+      for (j = 0; j < size; j++)
+        {
+          gdouble v = (gdouble) j / GIMP_CAGE_COEF_GRID_SIZE;
+
+          for (i = 0; i < size; i++)
+            {
+              gdouble u = (gdouble) i / GIMP_CAGE_COEF_GRID_SIZE;
+
+              corners[j * size + i].x =
+                (1.0 - v) * ((1.0 - u) * d00->x + u * d10->x) +
+                v         * ((1.0 - u) * d01->x + u * d11->x);
+              corners[j * size + i].y =
+                (1.0 - v) * ((1.0 - u) * d00->y + u * d10->y) +
+                v         * ((1.0 - u) * d01->y + u * d11->y);
+            }
+        }
+    }
+  else
+    {
+      for (j = 0; j < size; j++)
+        for (i = 0; i < size; i++)
+          {
+            gimp_cage_config_compute_coef (config, x0 + i, y0 + j, coef);
+
+            corners[j * size + i] =
+              gimp_cage_transform_compute_destination (coef,
+                                                       job->weights_x,
+                                                       job->weights_y,
+                                                       job->n_coefs);
+          }
+    }
+}
 
 static void
-gimp_operation_cage_transform_interpolate_source_coords_recurs (GimpOperationCageTransform *oct,
-                                                                GeglBuffer                 *out_buf,
-                                                                const GeglRectangle        *roi,
-                                                                GimpVector2                 p1_s,
-                                                                GimpVector2                 p1_d,
-                                                                GimpVector2                 p2_s,
-                                                                GimpVector2                 p2_d,
-                                                                GimpVector2                 p3_s,
-                                                                GimpVector2                 p3_d,
-                                                                gint                        recursion_depth,
-                                                                gfloat                     *coords)
+gimp_operation_cage_transform_interpolate_source_coords_recurs (CageTransformBand *band,
+                                                                GimpVector2        p1_s,
+                                                                GimpVector2        p1_d,
+                                                                GimpVector2        p2_s,
+                                                                GimpVector2        p2_d,
+                                                                GimpVector2        p3_s,
+                                                                GimpVector2        p3_d,
+                                                                gint               recursion_depth)
 {
-  GeglRectangle rect = { 0, 0, 1, 1 };
-  gint          xmin, xmax, ymin, ymax;
+  const GeglRectangle *roi = &band->rect;
+  gint                 xmin, xmax, ymin, ymax;
 
   /* Stop recursion if all 3 vertices of the triangle are outside the
    * ROI (left/right or above/below).
@@ -433,8 +794,10 @@ gimp_operation_cage_transform_interpolate_source_coords_recurs (GimpOperationCag
     {
       gdouble a, b, c, denom, x, y;
 
-      rect.x = xmax;
-      rect.y = ymax;
+      /* only this band's thread writes the pixel */
+      if (xmax <  roi->x || xmax >= roi->x + roi->width ||
+          ymax <  roi->y || ymax >= roi->y + roi->height)
+        return;
 
       x = (gdouble) xmax;
       y = (gdouble) ymax;
@@ -449,15 +812,11 @@ gimp_operation_cage_transform_interpolate_source_coords_recurs (GimpOperationCag
        */
       if ((a > 0 && b > 0 && c > 0) || (a < 0 && b < 0 && c < 0))
         {
+          gfloat *coords = band->coords +
+                           2 * ((ymax - roi->y) * roi->width + (xmax - roi->x));
+
           coords[0] = (a * p1_s.x + b * p2_s.x + c * p3_s.x);
           coords[1] = (a * p1_s.y + b * p2_s.y + c * p3_s.y);
-
-          gegl_buffer_set (out_buf,
-                           &rect,
-                           0,
-                           oct->format_coords,
-                           coords,
-                           GEGL_AUTO_ROWSTRIDE);
         }
 
       return;
@@ -495,82 +854,68 @@ gimp_operation_cage_transform_interpolate_source_coords_recurs (GimpOperationCag
       pm3_s.x = (p3_s.x + p1_s.x) / 2.0;
       pm3_s.y = (p3_s.y + p1_s.y) / 2.0;
 
-      gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                      out_buf,
-                                                                      roi,
+      gimp_operation_cage_transform_interpolate_source_coords_recurs (band,
                                                                       p1_s, p1_d,
                                                                       pm1_s, pm1_d,
                                                                       pm3_s, pm3_d,
-                                                                      next_depth,
-                                                                      coords);
+                                                                      next_depth);
 
-      gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                      out_buf,
-                                                                      roi,
+      gimp_operation_cage_transform_interpolate_source_coords_recurs (band,
                                                                       pm1_s, pm1_d,
                                                                       p2_s, p2_d,
                                                                       pm2_s, pm2_d,
-                                                                      next_depth,
-                                                                      coords);
+                                                                      next_depth);
 
-      gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                      out_buf,
-                                                                      roi,
+      gimp_operation_cage_transform_interpolate_source_coords_recurs (band,
                                                                       pm1_s, pm1_d,
                                                                       pm2_s, pm2_d,
                                                                       pm3_s, pm3_d,
-                                                                      next_depth,
-                                                                      coords);
+                                                                      next_depth);
 
-      gimp_operation_cage_transform_interpolate_source_coords_recurs (oct,
-                                                                      out_buf,
-                                                                      roi,
+      gimp_operation_cage_transform_interpolate_source_coords_recurs (band,
                                                                       pm3_s, pm3_d,
                                                                       pm2_s, pm2_d,
                                                                       p3_s, p3_d,
-                                                                      next_depth,
-                                                                      coords);
+                                                                      next_depth);
     }
 }
 
-static GimpVector2
-gimp_cage_transform_compute_destination (GimpCageConfig *config,
-                                         gfloat         *coef,
-                                         const Babl     *format_coef,
-                                         GeglBuffer     *coef_buf,
-                                         GimpVector2     coords)
+/* a plain dot product over float arrays, kept in four partial sums
+ * so the compiler can vectorize it
+ */
+static inline GimpVector2
+gimp_cage_transform_compute_destination (const gfloat *coef,
+                                         const gfloat *weights_x,
+                                         const gfloat *weights_y,
+                                         gint          n_coefs)
 {
-  GimpVector2    result = {0, 0};
-  gint           n_cage_vertices = gimp_cage_config_get_n_points (config);
-  gint           i;
-  GimpCagePoint *point;
-
-  /* When Gegl bug #645810 will be solved, this should be a good optimisation */
-  #ifdef GEGL_BUG_645810_SOLVED
-    gegl_buffer_sample (coef_buf, coords.x, coords.y, 1.0, coef, format_coef, GEGL_INTERPOLATION_NEAREST);
-  #else
-    GeglRectangle  rect;
-
-    rect.height = 1;
-    rect.width  = 1;
-    rect.x      = coords.x;
-    rect.y      = coords.y;
-
-    gegl_buffer_get (coef_buf, &rect, 1.0, format_coef, coef,
-                     GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-  #endif
+  GimpVector2 result;
+  gfloat      sum_x[4] = { 0.0, 0.0, 0.0, 0.0 };
+  gfloat      sum_y[4] = { 0.0, 0.0, 0.0, 0.0 };
+  gint        i;
 
-  for (i = 0; i < n_cage_vertices; i++)
+  for (i = 0; i + 4 <= n_coefs; i += 4)
     {
-      point = &g_array_index (config->cage_points, GimpCagePoint, i);
-
-      result.x += coef[i] * point->dest_point.x;
-      result.y += coef[i] * point->dest_point.y;
+      sum_x[0] += coef[i + 0] * weights_x[i + 0];
+      sum_x[1] += coef[i + 1] * weights_x[i + 1];
+      sum_x[2] += coef[i + 2] * weights_x[i + 2];
+      sum_x[3] += coef[i + 3] * weights_x[i + 3];
+
+      sum_y[0] += coef[i + 0] * weights_y[i + 0];
+      sum_y[1] += coef[i + 1] * weights_y[i + 1];
+      sum_y[2] += coef[i + 2] * weights_y[i + 2];
+      sum_y[3] += coef[i + 3] * weights_y[i + 3];
+    }
 
-      result.x += coef[i + n_cage_vertices] * point->edge_scaling_factor * point->edge_normal.x;
-      result.y += coef[i + n_cage_vertices] * point->edge_scaling_factor * point->edge_normal.y;
+  for (; i < n_coefs; i++)
+    {
+      sum_x[0] += coef[i] * weights_x[i];
+      sum_y[0] += coef[i] * weights_y[i];
     }
 
+  result.x = (sum_x[0] + sum_x[1]) + (sum_x[2] + sum_x[3]);
+  result.y = (sum_y[0] + sum_y[1]) + (sum_y[2] + sum_y[3]);
+
   return result;
 }
 
@@ -589,8 +934,18 @@ gimp_operation_cage_transform_get_required_for_output (GeglOperation       *oper
                                                        const gchar         *input_pad,
                                                        const GeglRectangle *roi)
 {
-  GeglRectangle result = *gegl_operation_source_get_bounding_box (operation,
-                                                                  "input");
+  GeglRectangle result = { 0, 0, 0, 0 };
+
+  /* the input only provides the extent, its pixels are never used */
+  if (! strcmp (input_pad, "aux"))
+    {
+      const GeglRectangle *aux_bbox;
+
+      aux_bbox = gegl_operation_source_get_bounding_box (operation, "aux");
+
+      if (aux_bbox)
+        result = *aux_bbox;
+    }
 
   return result;
 }
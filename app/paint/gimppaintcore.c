@@ -36,12 +36,15 @@
 #include "gegl/gimpapplicator.h"
 
 #include "core/gimp.h"
+#include "core/gimp-latency.h"
 #include "core/gimp-utils.h"
 #include "core/gimpchannel.h"
 #include "core/gimpimage.h"
 #include "core/gimpimage-guides.h"
 #include "core/gimpimage-symmetry.h"
 #include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimplayerstack.h"
 #include "core/gimppickable.h"
 #include "core/gimpprojection.h"
 #include "core/gimpsymmetry.h"
@@ -54,6 +57,7 @@
 
 #include "gimpairbrush.h"
 
+#include "gimp-trace.h"
 #include "gimp-intl.h"
 
 
@@ -117,6 +121,9 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static GimpLayerStack *
+                 gimp_paint_core_get_layer_stack     (GimpDrawable     *drawable);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -331,15 +338,22 @@ gimp_paint_core_paint (GimpPaintCore    *core,
       sym = g_object_ref (gimp_image_get_active_symmetry (image));
       gimp_symmetry_set_origin (sym, drawable, &core->cur_coords);
 
+      GIMP_TRACE_BEGIN ();
+
       core_class->paint (core, drawable,
                          paint_options,
                          sym, paint_state, time);
 
+      GIMP_TRACE_END ("paint", "dab");
+
       g_object_unref (sym);
 
       core_class->post_paint (core, drawable,
                               paint_options,
                               paint_state, time);
+
+      gimp_latency_mark (gimp_image_get_projection (image),
+                         GIMP_LATENCY_STAGE_PAINT);
     }
 }
 
@@ -350,9 +364,10 @@ gimp_paint_core_start (GimpPaintCore     *core,
                        const GimpCoords  *coords,
                        GError           **error)
 {
-  GimpImage   *image;
-  GimpItem    *item;
-  GimpChannel *mask;
+  GimpImage      *image;
+  GimpItem       *item;
+  GimpChannel    *mask;
+  GimpLayerStack *layer_stack;
 
   g_return_val_if_fail (GIMP_IS_PAINT_CORE (core), FALSE);
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), FALSE);
@@ -481,6 +496,12 @@ gimp_paint_core_start (GimpPaintCore     *core,
         }
     }
 
+  /*  Only re-blend the drawable with the layers around it while painting  */
+  layer_stack = gimp_paint_core_get_layer_stack (drawable);
+
+  if (layer_stack)
+    gimp_layer_stack_start_paint (layer_stack, GIMP_LAYER (drawable));
+
   /*  Freeze the drawable preview so that it isn't constantly updated.  */
   gimp_viewable_preview_freeze (GIMP_VIEWABLE (drawable));
 
@@ -492,12 +513,18 @@ gimp_paint_core_finish (GimpPaintCore *core,
                         GimpDrawable  *drawable,
                         gboolean       push_undo)
 {
-  GimpImage *image;
+  GimpImage      *image;
+  GimpLayerStack *layer_stack;
 
   g_return_if_fail (GIMP_IS_PAINT_CORE (core));
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  layer_stack = gimp_paint_core_get_layer_stack (drawable);
+
+  if (layer_stack)
+    gimp_layer_stack_end_paint (layer_stack);
+
   g_clear_object (&core->applicator);
 
   if (core->stroke_buffer)
@@ -564,13 +591,19 @@ void
 gimp_paint_core_cancel (GimpPaintCore *core,
                         GimpDrawable  *drawable)
 {
-  gint x, y;
-  gint width, height;
+  GimpLayerStack *layer_stack;
+  gint            x, y;
+  gint            width, height;
 
   g_return_if_fail (GIMP_IS_PAINT_CORE (core));
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  layer_stack = gimp_paint_core_get_layer_stack (drawable);
+
+  if (layer_stack)
+    gimp_layer_stack_end_paint (layer_stack);
+
   /*  Determine if any part of the image has been altered--
    *  if nothing has, then just return...
    */
@@ -1143,3 +1176,22 @@ gimp_paint_core_smooth_coords (GimpPaintCore    *core,
         }
     }
 }
+
+
+/*  private functions  */
+
+static GimpLayerStack *
+gimp_paint_core_get_layer_stack (GimpDrawable *drawable)
+{
+  GimpContainer *container;
+
+  if (! GIMP_IS_LAYER (drawable))
+    return NULL;
+
+  container = gimp_item_get_container (GIMP_ITEM (drawable));
+
+  if (GIMP_IS_LAYER_STACK (container))
+    return GIMP_LAYER_STACK (container);
+
+  return NULL;
+}
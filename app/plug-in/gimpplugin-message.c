@@ -51,6 +51,7 @@
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
+#include "gimp-trace.h"
 #include "gimp-intl.h"
 
 
@@ -63,8 +64,13 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static GimpValueArray *
+            gimp_plug_in_execute_proc_run        (GimpPlugIn      *plug_in,
+                                                  GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
+static void gimp_plug_in_handle_proc_run_batch   (GimpPlugIn      *plug_in,
+                                                  GPProcRunBatch  *proc_run_batch);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
                                                   GPProcReturn    *proc_return);
 static void gimp_plug_in_handle_temp_proc_return (GimpPlugIn      *plug_in,
@@ -77,6 +83,27 @@ static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
 
 
+/*  wire message names, for tracing  */
+static const gchar * const message_names[] =
+{
+  [GP_QUIT]              = "quit",
+  [GP_CONFIG]            = "config",
+  [GP_TILE_REQ]          = "tile-req",
+  [GP_TILE_ACK]          = "tile-ack",
+  [GP_TILE_DATA]         = "tile-data",
+  [GP_PROC_RUN]          = "proc-run",
+  [GP_PROC_RETURN]       = "proc-return",
+  [GP_TEMP_PROC_RUN]     = "temp-proc-run",
+  [GP_TEMP_PROC_RETURN]  = "temp-proc-return",
+  [GP_PROC_INSTALL]      = "proc-install",
+  [GP_PROC_UNINSTALL]    = "proc-uninstall",
+  [GP_EXTENSION_ACK]     = "extension-ack",
+  [GP_HAS_INIT]          = "has-init",
+  [GP_PROC_RUN_BATCH]    = "proc-run-batch",
+  [GP_PROC_RETURN_BATCH] = "proc-return-batch"
+};
+
+
 /*  public functions  */
 
 void
@@ -87,6 +114,8 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
   g_return_if_fail (plug_in->open == TRUE);
   g_return_if_fail (msg != NULL);
 
+  GIMP_TRACE_BEGIN ();
+
   switch (msg->type)
     {
     case GP_QUIT:
@@ -160,7 +189,24 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_PROC_RUN_BATCH:
+      gimp_plug_in_handle_proc_run_batch (plug_in, msg->data);
+      break;
+
+    case GP_PROC_RETURN_BATCH:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a PROC_RETURN_BATCH message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
+
+  GIMP_TRACE_END ("plug-in",
+                  msg->type < G_N_ELEMENTS (message_names) ?
+                  message_names[msg->type] : "unknown");
 }
 
 
@@ -504,9 +550,12 @@ gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
     }
 }
 
-static void
-gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
-                              GPProcRun  *proc_run)
+/*  Runs the procedure called by @proc_run on behalf of @plug_in and
+ *  returns its return values.  Shared by single and batched calls.
+ */
+static GimpValueArray *
+gimp_plug_in_execute_proc_run (GimpPlugIn *plug_in,
+                               GPProcRun  *proc_run)
 {
   GimpPlugInProcFrame *proc_frame;
   gchar               *canonical;
@@ -516,9 +565,6 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   GimpValueArray      *return_vals = NULL;
   GError              *error       = NULL;
 
-  g_return_if_fail (proc_run != NULL);
-  g_return_if_fail (proc_run->name != NULL);
-
   canonical = gimp_canonicalize_identifier (proc_run->name);
 
   proc_frame = gimp_plug_in_get_proc_frame (plug_in);
@@ -608,6 +654,20 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
 
   g_free (canonical);
 
+  return return_vals;
+}
+
+static void
+gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
+                              GPProcRun  *proc_run)
+{
+  GimpValueArray *return_vals;
+
+  g_return_if_fail (proc_run != NULL);
+  g_return_if_fail (proc_run->name != NULL);
+
+  return_vals = gimp_plug_in_execute_proc_run (plug_in, proc_run);
+
   /*  Don't bother to send the return value if executing the procedure
    *  closed the plug-in (e.g. if the procedure is gimp-quit)
    */
@@ -636,6 +696,68 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   gimp_value_array_unref (return_vals);
 }
 
+static void
+gimp_plug_in_handle_proc_run_batch (GimpPlugIn     *plug_in,
+                                    GPProcRunBatch *proc_run_batch)
+{
+  GPProcReturnBatch   proc_return_batch;
+  GimpValueArray    **return_vals;
+  gint                i;
+
+  g_return_if_fail (proc_run_batch != NULL);
+
+  return_vals = g_new0 (GimpValueArray *, proc_run_batch->nruns);
+
+  /*  Run the calls in the order they were queued, exactly as if they
+   *  had been sent one by one, and stop as soon as one of them closes
+   *  the plug-in.
+   */
+  for (i = 0; i < proc_run_batch->nruns && plug_in->open; i++)
+    {
+      return_vals[i] = gimp_plug_in_execute_proc_run (plug_in,
+                                                      &proc_run_batch->runs[i]);
+    }
+
+  if (plug_in->open)
+    {
+      proc_return_batch.serial   = proc_run_batch->serial;
+      proc_return_batch.nreturns = proc_run_batch->nruns;
+      proc_return_batch.returns  = g_new0 (GPProcReturn,
+                                           proc_run_batch->nruns);
+
+      for (i = 0; i < proc_run_batch->nruns; i++)
+        {
+          GPProcReturn *proc_return = &proc_return_batch.returns[i];
+
+          proc_return->name    = proc_run_batch->runs[i].name;
+          proc_return->nparams = gimp_value_array_length (return_vals[i]);
+          proc_return->params  = plug_in_args_to_params (return_vals[i],
+                                                         FALSE);
+        }
+
+      if (! gp_proc_return_batch_write (plug_in->my_write,
+                                        &proc_return_batch, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "%s: ERROR", G_STRFUNC);
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+
+      for (i = 0; i < proc_run_batch->nruns; i++)
+        g_free (proc_return_batch.returns[i].params);
+
+      g_free (proc_return_batch.returns);
+    }
+
+  for (i = 0; i < proc_run_batch->nruns; i++)
+    {
+      if (return_vals[i])
+        gimp_value_array_unref (return_vals[i]);
+    }
+
+  g_free (return_vals);
+}
+
 static void
 gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                  GPProcReturn *proc_return)
@@ -655,6 +777,10 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
     {
       g_main_loop_quit (proc_frame->main_loop);
     }
+  else if (proc_frame->return_func)
+    {
+      gimp_plug_in_proc_frame_return (proc_frame);
+    }
   else
     {
       /*  the plug-in is run asynchronously, so display its error
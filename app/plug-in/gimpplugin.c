@@ -552,6 +552,17 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
       g_main_loop_quit (plug_in->main_proc_frame.main_loop);
     }
 
+  if (plug_in->main_proc_frame.return_func)
+    {
+#ifdef GIMP_UNSTABLE
+      g_printerr ("plug-in '%s' aborted before sending its "
+                  "procedure return values\n",
+                  gimp_object_get_name (plug_in));
+#endif
+
+      gimp_plug_in_proc_frame_return (&plug_in->main_proc_frame);
+    }
+
   if (plug_in->ext_main_loop &&
       g_main_loop_is_running (plug_in->ext_main_loop))
     {
@@ -144,13 +144,15 @@ gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
 }
 
 GimpValueArray *
-gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
-                               GimpContext         *context,
-                               GimpProgress        *progress,
-                               GimpPlugInProcedure *procedure,
-                               GimpValueArray      *args,
-                               gboolean             synchronous,
-                               GimpObject          *display)
+gimp_plug_in_manager_call_run (GimpPlugInManager    *manager,
+                               GimpContext          *context,
+                               GimpProgress         *progress,
+                               GimpPlugInProcedure  *procedure,
+                               GimpValueArray       *args,
+                               gboolean              synchronous,
+                               GimpObject           *display,
+                               GimpPlugInReturnFunc  return_func,
+                               gpointer              return_data)
 {
   GimpValueArray *return_vals = NULL;
   GimpPlugIn     *plug_in;
@@ -161,6 +163,7 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
+  g_return_val_if_fail (return_func == NULL || ! synchronous, NULL);
 
   plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
 
@@ -250,6 +253,12 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       g_free (config.display_name);
       g_free (proc_run.params);
 
+      /*  only set now, so 'return_func' isn't called on the failures
+       *  above, whose return values are returned instead
+       */
+      plug_in->main_proc_frame.return_func = return_func;
+      plug_in->main_proc_frame.return_data = return_data;
+
       /* If this is an extension,
        * wait for an installation-confirmation message
        */
@@ -37,7 +37,9 @@ void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *man
                                                      GimpContext            *context,
                                                      GimpPlugInDef          *plug_in_def);
 
-/*  Run a plug-in as if it were a procedure database procedure
+/*  Run a plug-in as if it were a procedure database procedure.
+ *  Asynchronous runs pass their return values to 'return_func', if
+ *  they are started successfully
  */
 GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *manager,
                                                      GimpContext            *context,
@@ -45,7 +47,9 @@ GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *man
                                                      GimpPlugInProcedure    *procedure,
                                                      GimpValueArray         *args,
                                                      gboolean                synchronous,
-                                                     GimpObject             *display);
+                                                     GimpObject             *display,
+                                                     GimpPlugInReturnFunc    return_func,
+                                                     gpointer                return_data);
 
 /*  Run a temp plug-in proc as if it were a procedure database procedure
  */
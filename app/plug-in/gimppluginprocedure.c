@@ -38,6 +38,8 @@
 
 #include "file/file-utils.h"
 
+#include "pdb/gimppdbcontext.h"
+
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
 
@@ -415,7 +417,7 @@ gimp_plug_in_procedure_execute (GimpProcedure  *procedure,
   return gimp_plug_in_manager_call_run (gimp->plug_in_manager,
                                         context, progress,
                                         GIMP_PLUG_IN_PROCEDURE (procedure),
-                                        args, TRUE, NULL);
+                                        args, TRUE, NULL, NULL, NULL);
 }
 
 static void
@@ -437,7 +439,8 @@ gimp_plug_in_procedure_execute_async (GimpProcedure  *procedure,
       return_vals = gimp_plug_in_manager_call_run (gimp->plug_in_manager,
                                                    context, progress,
                                                    plug_in_procedure,
-                                                   args, FALSE, display);
+                                                   args, FALSE, display,
+                                                   NULL, NULL);
 
       if (return_vals)
         {
@@ -1189,3 +1192,56 @@ gimp_plug_in_procedure_handle_return_values (GimpPlugInProcedure *proc,
       break;
     }
 }
+
+/*  runs the procedure's plug-in without waiting for it, and calls
+ *  'return_func' with its return values once it finished, or failed
+ *  to start.  'return_func' is called exactly once.
+ */
+void
+gimp_plug_in_procedure_run_async (GimpPlugInProcedure  *proc,
+                                  Gimp                 *gimp,
+                                  GimpContext          *context,
+                                  GimpProgress         *progress,
+                                  GimpValueArray       *args,
+                                  GimpPlugInReturnFunc  return_func,
+                                  gpointer              return_data)
+{
+  GimpValueArray *return_vals = NULL;
+  GError         *error       = NULL;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (proc));
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+  g_return_if_fail (args != NULL);
+  g_return_if_fail (return_func != NULL);
+
+  if (gimp_plug_in_procedure_validate_args (proc, gimp, args, &error))
+    {
+      if (GIMP_IS_PDB_CONTEXT (context))
+        context = g_object_ref (context);
+      else
+        context = gimp_pdb_context_new (gimp, context, TRUE);
+
+      return_vals = gimp_plug_in_manager_call_run (gimp->plug_in_manager,
+                                                   context, progress,
+                                                   proc, args, FALSE, NULL,
+                                                   return_func, return_data);
+
+      g_object_unref (context);
+    }
+  else
+    {
+      return_vals = gimp_procedure_get_return_values (GIMP_PROCEDURE (proc),
+                                                      FALSE, error);
+      g_error_free (error);
+    }
+
+  /*  the plug-in didn't start  */
+  if (return_vals)
+    {
+      return_func (return_vals, return_data);
+
+      gimp_value_array_unref (return_vals);
+    }
+}
@@ -132,5 +132,13 @@ void       gimp_plug_in_procedure_handle_return_values (GimpPlugInProcedure *pro
 
                                                         GimpValueArray      *return_vals);
 
+void          gimp_plug_in_procedure_run_async         (GimpPlugInProcedure  *proc,
+                                                        Gimp                 *gimp,
+                                                        GimpContext          *context,
+                                                        GimpProgress         *progress,
+                                                        GimpValueArray       *args,
+                                                        GimpPlugInReturnFunc  return_func,
+                                                        gpointer              return_data);
+
 
 #endif /* __GIMP_PLUG_IN_PROCEDURE_H__ */
@@ -80,6 +80,8 @@ gimp_plug_in_proc_frame_init (GimpPlugInProcFrame *proc_frame,
   proc_frame->procedure          = procedure ? g_object_ref (procedure) : NULL;
   proc_frame->main_loop          = NULL;
   proc_frame->return_vals        = NULL;
+  proc_frame->return_func        = NULL;
+  proc_frame->return_data        = NULL;
   proc_frame->progress           = progress ? g_object_ref (progress) : NULL;
   proc_frame->progress_created   = FALSE;
   proc_frame->progress_cancel_id = 0;
@@ -198,3 +200,28 @@ gimp_plug_in_proc_frame_get_return_values (GimpPlugInProcFrame *proc_frame)
 
   return return_vals;
 }
+
+/*  passes the return values of an asynchronous run to its return_func,
+ *  if any.  the function is called at most once.
+ */
+void
+gimp_plug_in_proc_frame_return (GimpPlugInProcFrame *proc_frame)
+{
+  GimpPlugInReturnFunc  return_func;
+  GimpValueArray       *return_vals;
+
+  g_return_if_fail (proc_frame != NULL);
+
+  return_func = proc_frame->return_func;
+
+  if (! return_func)
+    return;
+
+  proc_frame->return_func = NULL;
+
+  return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+  return_func (return_vals, proc_frame->return_data);
+
+  gimp_value_array_unref (return_vals);
+}
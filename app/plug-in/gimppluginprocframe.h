@@ -33,6 +33,10 @@ struct _GimpPlugInProcFrame
 
   GimpValueArray      *return_vals;
 
+  /*  called with the return values of asynchronous runs  */
+  GimpPlugInReturnFunc return_func;
+  gpointer             return_data;
+
   GimpProgress        *progress;
   gboolean             progress_created;
   gulong               progress_cancel_id;
@@ -62,6 +66,7 @@ void                  gimp_plug_in_proc_frame_unref   (GimpPlugInProcFrame *proc
 
 GimpValueArray      * gimp_plug_in_proc_frame_get_return_values
                                                       (GimpPlugInProcFrame *proc_frame);
+void                  gimp_plug_in_proc_frame_return  (GimpPlugInProcFrame *proc_frame);
 
 
 #endif /* __GIMP_PLUG_IN_PROC_FRAME_H__ */
@@ -0,0 +1,1019 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Headless benchmarks of the core: projection rebuilds, layer modes,
+ * paint strokes, fuzzy select, XCF saving and loading and image
+ * conversions.  Each benchmark runs a number of iterations, and the
+ * results are written as JSON, so they can be compared between builds:
+ *
+ *   {
+ *     "version": "2.10.x",
+ *     "size": 1024,
+ *     "iterations": 5,
+ *     "threads": 4,
+ *     "benchmarks": [
+ *       { "name": "projection/stack-16", "min": 0.1, "median": 0.1,
+ *         "mean": 0.1, "samples": [ 0.1, ... ] },
+ *       { "name": "xcf/save-zlib-u8", "min": 0.1, "median": 0.1,
+ *         "mean": 0.1, "file-size": 1048576, "samples": [ 0.1, ... ] },
+ *       ...
+ *     ]
+ *   }
+ *
+ * All times are in seconds, file sizes in bytes.  The stroke replayed
+ * for the paint benchmarks is synthesized, unless --stroke names a file
+ * holding a recorded one, one "x y pressure" event in image coordinates
+ * per line.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "paint/paint-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "operations/layer-modes/gimp-layer-modes.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpdynamics.h"
+#include "core/gimpdynamicsoutput.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-convert-precision.h"
+#include "core/gimpimage-convert-type.h"
+#include "core/gimpimage-duplicate.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimppaintinfo.h"
+#include "core/gimppickable.h"
+#include "core/gimppickable-contiguous-region.h"
+#include "core/gimpprojection.h"
+
+#include "paint/gimppaintcore.h"
+#include "paint/gimppaintcore-stroke.h"
+#include "paint/gimppaintoptions.h"
+#include "paint/gimpperspectiveclone.h"
+#include "paint/gimpsourcecore.h"
+
+#include "plug-in/gimppluginmanager-file.h"
+
+#include "file/file-open.h"
+#include "file/file-save.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define BENCHMARK_STROKE_LENGTH 1000
+
+
+typedef struct
+{
+  Gimp        *gimp;
+  gint         size;
+  gint         n_layers;
+  gint         iterations;
+  const gchar *filter;
+  GArray      *stroke;
+  GString     *json;
+  gint         n_results;
+} Benchmark;
+
+
+static gboolean    benchmark_skip          (Benchmark     *bench,
+                                            const gchar   *name);
+static void        benchmark_record        (Benchmark     *bench,
+                                            const gchar   *name,
+                                            gdouble       *samples);
+static void        benchmark_record_file   (Benchmark     *bench,
+                                            const gchar   *name,
+                                            gdouble       *samples,
+                                            goffset        file_size);
+
+static GimpImage * benchmark_create_image  (Benchmark     *bench,
+                                            GimpPrecision  precision,
+                                            gint           n_layers);
+static void        benchmark_render        (GimpImage     *image);
+static gboolean    benchmark_load_stroke   (Benchmark     *bench,
+                                            const gchar   *filename,
+                                            GError       **error);
+static void        benchmark_create_stroke (Benchmark     *bench);
+
+static void        benchmark_projection    (Benchmark     *bench);
+static void        benchmark_layer_modes   (Benchmark     *bench);
+static void        benchmark_paint         (Benchmark     *bench);
+static void        benchmark_fuzzy_select  (Benchmark     *bench);
+static void        benchmark_xcf           (Benchmark     *bench);
+static void        benchmark_convert       (Benchmark     *bench);
+
+
+static gint         bench_size       = 1024;
+static gint         bench_layers     = 16;
+static gint         bench_iterations = 5;
+static const gchar *bench_filter     = NULL;
+static const gchar *bench_stroke     = NULL;
+static const gchar *bench_output     = NULL;
+
+static const GOptionEntry bench_options[] =
+{
+  {
+    "size", 0, 0,
+    G_OPTION_ARG_INT, &bench_size,
+    "Width and height of the benchmark images (default: 1024)", "<pixels>"
+  },
+  {
+    "layers", 0, 0,
+    G_OPTION_ARG_INT, &bench_layers,
+    "Number of layers of the projection benchmark (default: 16)", "<n>"
+  },
+  {
+    "iterations", 'n', 0,
+    G_OPTION_ARG_INT, &bench_iterations,
+    "Number of times each benchmark is run (default: 5)", "<n>"
+  },
+  {
+    "filter", 'f', 0,
+    G_OPTION_ARG_STRING, &bench_filter,
+    "Only run the benchmarks whose name contains <string>", "<string>"
+  },
+  {
+    "stroke", 0, 0,
+    G_OPTION_ARG_FILENAME, &bench_stroke,
+    "Replay the stroke recorded in <filename> in the paint benchmarks",
+    "<filename>"
+  },
+  {
+    "output", 'o', 0,
+    G_OPTION_ARG_FILENAME, &bench_output,
+    "Write the results to <filename> instead of the standard output",
+    "<filename>"
+  },
+  { NULL }
+};
+
+
+/*  projection rebuilds of a stack of semi-transparent layers  */
+static void
+benchmark_projection (Benchmark *bench)
+{
+  static const struct
+  {
+    const gchar   *name;
+    GimpPrecision  precision;
+  }
+  precisions[] =
+  {
+    { "u8",    GIMP_PRECISION_U8_GAMMA     },
+    { "u16",   GIMP_PRECISION_U16_LINEAR   },
+    { "float", GIMP_PRECISION_FLOAT_LINEAR }
+  };
+
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (precisions); i++)
+    {
+      GimpImage *image;
+      gchar     *name;
+      gdouble   *samples;
+      gint       j;
+
+      name = g_strdup_printf ("projection/stack-%d-%s",
+                              bench->n_layers, precisions[i].name);
+
+      if (benchmark_skip (bench, name))
+        {
+          g_free (name);
+          continue;
+        }
+
+      image   = benchmark_create_image (bench, precisions[i].precision,
+                                        bench->n_layers);
+      samples = g_new (gdouble, bench->iterations);
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          gint64 start = g_get_monotonic_time ();
+
+          benchmark_render (image);
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+        }
+
+      benchmark_record (bench, name, samples);
+
+      g_free (samples);
+      g_object_unref (image);
+      g_free (name);
+    }
+}
+
+/*  projection rebuilds of two layers, the top one using each layer mode  */
+static void
+benchmark_layer_modes (Benchmark *bench)
+{
+  GimpImage  *image = NULL;
+  GimpLayer  *layer = NULL;
+  GEnumClass *enum_class;
+  gdouble    *samples;
+  gint        i;
+
+  enum_class = g_type_class_ref (GIMP_TYPE_LAYER_MODE);
+  samples    = g_new (gdouble, bench->iterations);
+
+  for (i = 0; i < enum_class->n_values; i++)
+    {
+      GimpLayerMode  mode = enum_class->values[i].value;
+      gchar         *name;
+      gint           j;
+
+      if (! (gimp_layer_mode_get_context (mode) &
+             GIMP_LAYER_MODE_CONTEXT_LAYER))
+        continue;
+
+      name = g_strdup_printf ("layer-mode/%s",
+                              enum_class->values[i].value_nick);
+
+      if (benchmark_skip (bench, name))
+        {
+          g_free (name);
+          continue;
+        }
+
+      if (! image)
+        {
+          image = benchmark_create_image (bench, GIMP_PRECISION_U8_GAMMA, 2);
+          layer = gimp_image_get_layer_iter (image)->data;
+        }
+
+      gimp_layer_set_mode (layer, mode, FALSE);
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          gint64 start = g_get_monotonic_time ();
+
+          benchmark_render (image);
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+        }
+
+      benchmark_record (bench, name, samples);
+
+      g_free (name);
+    }
+
+  if (image)
+    g_object_unref (image);
+
+  g_free (samples);
+  g_type_class_unref (enum_class);
+}
+
+/*  the replayed stroke, painted with each paint core, using a
+ *  dynamics which maps pressure to size and opacity
+ */
+static void
+benchmark_paint (Benchmark *bench)
+{
+  GimpContext  *context  = gimp_get_user_context (bench->gimp);
+  GimpImage    *image    = NULL;
+  GimpDrawable *drawable = NULL;
+  GimpDynamics *dynamics;
+  GList        *list;
+  gdouble      *samples;
+
+  dynamics = GIMP_DYNAMICS (gimp_dynamics_new (context, "Benchmark"));
+
+  g_object_set (gimp_dynamics_get_output (dynamics,
+                                          GIMP_DYNAMICS_OUTPUT_SIZE),
+                "use-pressure", TRUE,
+                NULL);
+  g_object_set (gimp_dynamics_get_output (dynamics,
+                                          GIMP_DYNAMICS_OUTPUT_OPACITY),
+                "use-pressure", TRUE,
+                NULL);
+
+  samples = g_new (gdouble, bench->iterations);
+
+  for (list = gimp_get_paint_info_iter (bench->gimp);
+       list;
+       list = g_list_next (list))
+    {
+      GimpPaintInfo    *info = list->data;
+      GimpPaintOptions *options;
+      gchar            *name;
+      gint              j;
+
+      /*  perspective clone needs a transform set up on canvas  */
+      if (g_type_is_a (info->paint_type, GIMP_TYPE_PERSPECTIVE_CLONE))
+        continue;
+
+      name = g_strdup_printf ("paint/%s",
+                              gimp_object_get_name (GIMP_OBJECT (info)));
+
+      if (benchmark_skip (bench, name))
+        {
+          g_free (name);
+          continue;
+        }
+
+      if (! image)
+        {
+          image = benchmark_create_image (bench, GIMP_PRECISION_U8_GAMMA, 1);
+          drawable = GIMP_DRAWABLE (gimp_image_get_layer_iter (image)->data);
+        }
+
+      options = gimp_config_duplicate (GIMP_CONFIG (info->paint_options));
+
+      gimp_context_define_properties (GIMP_CONTEXT (options),
+                                      GIMP_CONTEXT_PROP_MASK_PAINT,
+                                      FALSE);
+      gimp_context_set_parent (GIMP_CONTEXT (options), context);
+
+      gimp_context_set_dynamics (GIMP_CONTEXT (options), dynamics);
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          GimpPaintCore *core;
+          GError        *error = NULL;
+          gint64         start;
+
+          if (g_type_is_a (info->paint_type, GIMP_TYPE_SOURCE_CORE))
+            core = g_object_new (info->paint_type,
+                                 "src-drawable", drawable,
+                                 "src-x",        bench->size / 2,
+                                 "src-y",        bench->size / 2,
+                                 NULL);
+          else
+            core = g_object_new (info->paint_type, NULL);
+
+          start = g_get_monotonic_time ();
+
+          if (! gimp_paint_core_stroke (core, drawable, options,
+                                        (GimpCoords *) bench->stroke->data,
+                                        bench->stroke->len,
+                                        FALSE, &error))
+            {
+              g_printerr ("%s: %s\n", name, error->message);
+              g_clear_error (&error);
+            }
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+
+          g_object_unref (core);
+        }
+
+      benchmark_record (bench, name, samples);
+
+      g_object_unref (options);
+      g_free (name);
+    }
+
+  if (image)
+    g_object_unref (image);
+
+  g_free (samples);
+  g_object_unref (dynamics);
+}
+
+/*  fuzzy select from the center, on a layer and on the projection  */
+static void
+benchmark_fuzzy_select (Benchmark *bench)
+{
+  static const gchar *names[] = { "fuzzy-select/layer",
+                                  "fuzzy-select/sample-merged" };
+
+  GimpImage *image = NULL;
+  gdouble   *samples;
+  gint       i;
+
+  samples = g_new (gdouble, bench->iterations);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      GimpPickable *pickable;
+      gint          j;
+
+      if (benchmark_skip (bench, names[i]))
+        continue;
+
+      if (! image)
+        {
+          image = benchmark_create_image (bench, GIMP_PRECISION_U8_GAMMA, 4);
+
+          benchmark_render (image);
+        }
+
+      if (i == 0)
+        pickable = GIMP_PICKABLE (gimp_image_get_layer_iter (image)->data);
+      else
+        pickable = GIMP_PICKABLE (gimp_image_get_projection (image));
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          GeglBuffer *mask;
+          gint64      start = g_get_monotonic_time ();
+
+          mask = gimp_pickable_contiguous_region_by_seed (pickable,
+                                                          TRUE, 0.3,
+                                                          FALSE,
+                                                          GIMP_SELECT_CRITERION_COMPOSITE,
+                                                          FALSE,
+                                                          bench->size / 2,
+                                                          bench->size / 2);
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+
+          g_object_unref (mask);
+        }
+
+      benchmark_record (bench, names[i], samples);
+    }
+
+  if (image)
+    g_object_unref (image);
+
+  g_free (samples);
+}
+
+/*  XCF saving and loading with each tile compression.  the 16-bit
+ *  formats are saved from the same image, so plain zlib and planar zlib
+ *  can be compared directly
+ */
+static void
+benchmark_xcf (Benchmark *bench)
+{
+  static const struct
+  {
+    const gchar   *name;
+    GimpPrecision  precision;
+    gboolean       compression;
+    gboolean       planar;
+  }
+  formats[] =
+  {
+    { "rle-u8",          GIMP_PRECISION_U8_GAMMA,   FALSE, FALSE },
+    { "zlib-u8",         GIMP_PRECISION_U8_GAMMA,   TRUE,  FALSE },
+    { "rle-u16",         GIMP_PRECISION_U16_LINEAR, FALSE, FALSE },
+    { "zlib-u16",        GIMP_PRECISION_U16_LINEAR, TRUE,  FALSE },
+    { "zlib-planar-u16", GIMP_PRECISION_U16_LINEAR, TRUE,  TRUE  }
+  };
+
+  GimpPlugInProcedure *proc;
+  gchar               *filename;
+  GFile               *file;
+  gdouble             *samples;
+  gint                 i;
+
+  filename = g_build_filename (g_get_tmp_dir (), "gimp-benchmark.xcf", NULL);
+  file     = g_file_new_for_path (filename);
+  g_free (filename);
+
+  proc = gimp_plug_in_manager_file_procedure_find (bench->gimp->plug_in_manager,
+                                                   GIMP_FILE_PROCEDURE_GROUP_SAVE,
+                                                   file,
+                                                   NULL /*error*/);
+
+  samples = g_new (gdouble, bench->iterations);
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      GimpImage *image;
+      GFileInfo *info;
+      goffset    file_size = -1;
+      gchar     *save_name;
+      gchar     *load_name;
+      gboolean   save;
+      gboolean   load;
+      gint       j;
+
+      save_name = g_strdup_printf ("xcf/save-%s", formats[i].name);
+      load_name = g_strdup_printf ("xcf/load-%s", formats[i].name);
+
+      save = ! benchmark_skip (bench, save_name);
+      load = ! benchmark_skip (bench, load_name);
+
+      if (! save && ! load)
+        {
+          g_free (save_name);
+          g_free (load_name);
+          continue;
+        }
+
+      image = benchmark_create_image (bench, formats[i].precision, 4);
+
+      gimp_image_set_xcf_compression (image, formats[i].compression);
+
+      /*  see xcf_save_image_compression()  */
+      if (formats[i].planar)
+        g_setenv ("GIMP_XCF_ENABLE_PLANAR", "1", TRUE);
+      else
+        g_unsetenv ("GIMP_XCF_ENABLE_PLANAR");
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          gint64 start;
+
+          /*  make sure every save writes the whole file  */
+          g_file_delete (file, NULL, NULL);
+
+          start = g_get_monotonic_time ();
+
+          file_save (bench->gimp, image, NULL, file, proc,
+                     GIMP_RUN_NONINTERACTIVE,
+                     FALSE /*change_saved_state*/,
+                     FALSE /*export_backward*/,
+                     FALSE /*export_forward*/,
+                     NULL /*error*/);
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+        }
+
+      info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+      if (info)
+        {
+          file_size = g_file_info_get_size (info);
+
+          g_object_unref (info);
+        }
+
+      if (save)
+        benchmark_record_file (bench, save_name, samples, file_size);
+
+      if (load)
+        {
+          for (j = 0; j < bench->iterations; j++)
+            {
+              GimpImage         *loaded_image;
+              GimpPDBStatusType  status;
+              gint64             start = g_get_monotonic_time ();
+
+              loaded_image = file_open_image (bench->gimp,
+                                              gimp_get_user_context (bench->gimp),
+                                              NULL /*progress*/,
+                                              file,
+                                              file,
+                                              FALSE /*as_new*/,
+                                              NULL /*file_proc*/,
+                                              GIMP_RUN_NONINTERACTIVE,
+                                              &status,
+                                              NULL /*mime_type*/,
+                                              NULL /*error*/);
+
+              samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                           G_TIME_SPAN_SECOND;
+
+              if (loaded_image)
+                g_object_unref (loaded_image);
+            }
+
+          benchmark_record_file (bench, load_name, samples, file_size);
+        }
+
+      g_object_unref (image);
+      g_free (save_name);
+      g_free (load_name);
+    }
+
+  g_unsetenv ("GIMP_XCF_ENABLE_PLANAR");
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+
+  g_free (samples);
+}
+
+/*  precision and base type conversions of an 8-bit RGB image  */
+static void
+benchmark_convert (Benchmark *bench)
+{
+  static const struct
+  {
+    const gchar       *name;
+    GimpImageBaseType  base_type;
+    GimpPrecision      precision;
+  }
+  conversions[] =
+  {
+    { "u16-linear",   GIMP_RGB,  GIMP_PRECISION_U16_LINEAR   },
+    { "half-gamma",   GIMP_RGB,  GIMP_PRECISION_HALF_GAMMA   },
+    { "float-linear", GIMP_RGB,  GIMP_PRECISION_FLOAT_LINEAR },
+    { "gray",         GIMP_GRAY, GIMP_PRECISION_U8_GAMMA     }
+  };
+
+  GimpImage *image = NULL;
+  gdouble   *samples;
+  gint       i;
+
+  samples = g_new (gdouble, bench->iterations);
+
+  for (i = 0; i < G_N_ELEMENTS (conversions); i++)
+    {
+      gchar *name;
+      gint   j;
+
+      name = g_strdup_printf ("convert/%s", conversions[i].name);
+
+      if (benchmark_skip (bench, name))
+        {
+          g_free (name);
+          continue;
+        }
+
+      if (! image)
+        image = benchmark_create_image (bench, GIMP_PRECISION_U8_GAMMA, 4);
+
+      for (j = 0; j < bench->iterations; j++)
+        {
+          GimpImage *copy = gimp_image_duplicate (image);
+          gint64     start;
+
+          gimp_image_undo_disable (copy);
+
+          start = g_get_monotonic_time ();
+
+          if (conversions[i].base_type != GIMP_RGB)
+            gimp_image_convert_type (copy, conversions[i].base_type,
+                                     NULL, NULL, NULL);
+
+          if (conversions[i].precision != GIMP_PRECISION_U8_GAMMA)
+            gimp_image_convert_precision (copy, conversions[i].precision,
+                                          GEGL_DITHER_NONE,
+                                          GEGL_DITHER_NONE,
+                                          GEGL_DITHER_NONE,
+                                          NULL);
+
+          samples[j] = (gdouble) (g_get_monotonic_time () - start) /
+                       G_TIME_SPAN_SECOND;
+
+          g_object_unref (copy);
+        }
+
+      benchmark_record (bench, name, samples);
+
+      g_free (name);
+    }
+
+  if (image)
+    g_object_unref (image);
+
+  g_free (samples);
+}
+
+
+/*  utility functions  */
+
+static gboolean
+benchmark_skip (Benchmark   *bench,
+                const gchar *name)
+{
+  return bench->filter && ! strstr (name, bench->filter);
+}
+
+static gint
+benchmark_compare_samples (const gdouble *sample1,
+                           const gdouble *sample2)
+{
+  return (*sample1 > *sample2) - (*sample1 < *sample2);
+}
+
+static void
+benchmark_record (Benchmark   *bench,
+                  const gchar *name,
+                  gdouble     *samples)
+{
+  benchmark_record_file (bench, name, samples, -1);
+}
+
+/*  like benchmark_record(), also recording the size of the file the
+ *  benchmark wrote or read, unless 'file_size' is negative
+ */
+static void
+benchmark_record_file (Benchmark   *bench,
+                       const gchar *name,
+                       gdouble     *samples,
+                       goffset      file_size)
+{
+  gdouble *sorted;
+  gdouble  median;
+  gdouble  mean = 0.0;
+  gint     n    = bench->iterations;
+  gint     i;
+
+  sorted = g_memdup (samples, n * sizeof (gdouble));
+
+  qsort (sorted, n, sizeof (gdouble),
+         (GCompareFunc) benchmark_compare_samples);
+
+  if (n % 2)
+    median = sorted[n / 2];
+  else
+    median = (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+
+  for (i = 0; i < n; i++)
+    mean += samples[i];
+
+  mean /= n;
+
+  if (bench->n_results++)
+    g_string_append (bench->json, ",\n");
+
+  g_string_append_printf (bench->json,
+                          "    { \"name\": \"%s\", "
+                          "\"min\": %.6f, \"median\": %.6f, \"mean\": %.6f, ",
+                          name, sorted[0], median, mean);
+
+  if (file_size >= 0)
+    g_string_append_printf (bench->json,
+                            "\"file-size\": %" G_GOFFSET_FORMAT ", ",
+                            file_size);
+
+  g_string_append (bench->json, "\"samples\": [ ");
+
+  for (i = 0; i < n; i++)
+    g_string_append_printf (bench->json, "%s%.6f", i ? ", " : "", samples[i]);
+
+  g_string_append (bench->json, " ] }");
+
+  if (file_size >= 0)
+    g_printerr ("%-40s %10.3f ms %12" G_GOFFSET_FORMAT " bytes\n",
+                name, median * 1000.0, file_size);
+  else
+    g_printerr ("%-40s %10.3f ms\n", name, median * 1000.0);
+
+  g_free (sorted);
+}
+
+/*  creates an image of 'n_layers' layers filled with noise, all but
+ *  the bottom one half transparent.  undo is disabled.
+ */
+static GimpImage *
+benchmark_create_image (Benchmark     *bench,
+                        GimpPrecision  precision,
+                        gint           n_layers)
+{
+  GimpImage *image;
+  GeglNode  *node;
+  gint       i;
+
+  image = gimp_image_new (bench->gimp, bench->size, bench->size,
+                          GIMP_RGB, precision);
+
+  gimp_image_undo_disable (image);
+
+  node = gegl_node_new_child (NULL,
+                              "operation", "gegl:perlin-noise",
+                              NULL);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      GimpLayer *layer;
+      gchar     *name;
+
+      name  = g_strdup_printf ("layer%d", i + 1);
+      layer = gimp_layer_new (image, bench->size, bench->size,
+                              gimp_image_get_layer_format (image, TRUE),
+                              name,
+                              i ? 0.5 : GIMP_OPACITY_OPAQUE,
+                              GIMP_LAYER_MODE_NORMAL);
+      g_free (name);
+
+      gegl_node_set (node,
+                     "zoff", (gdouble) i,
+                     NULL);
+
+      gegl_node_blit_buffer (node,
+                             gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             NULL, 0, GEGL_ABYSS_NONE);
+
+      gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+    }
+
+  g_object_unref (node);
+
+  return image;
+}
+
+/*  invalidates the whole projection and renders it again  */
+static void
+benchmark_render (GimpImage *image)
+{
+  GimpProjection *projection = gimp_image_get_projection (image);
+
+  /*  make sure the projection buffer exists  */
+  gimp_pickable_get_buffer (GIMP_PICKABLE (projection));
+
+  gimp_image_invalidate (image,
+                         0, 0,
+                         gimp_image_get_width  (image),
+                         gimp_image_get_height (image));
+  gimp_projection_flush_now (projection);
+  gimp_projection_finish_draw (projection);
+}
+
+static gboolean
+benchmark_load_stroke (Benchmark    *bench,
+                       const gchar  *filename,
+                       GError      **error)
+{
+  static const GimpCoords default_coords = GIMP_COORDS_DEFAULT_VALUES;
+
+  gchar  *contents;
+  gchar **lines;
+  gint    i;
+
+  if (! g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  for (i = 0; lines[i]; i++)
+    {
+      GimpCoords coords = default_coords;
+
+      if (lines[i][0] == '#')
+        continue;
+
+      if (sscanf (lines[i], "%lf %lf %lf",
+                  &coords.x, &coords.y, &coords.pressure) >= 2)
+        {
+          g_array_append_val (bench->stroke, coords);
+        }
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  if (! bench->stroke->len)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "'%s' contains no stroke events", filename);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  a spiral around the image center, with the pressure rising and
+ *  falling the way it does in a quick hand-drawn stroke
+ */
+static void
+benchmark_create_stroke (Benchmark *bench)
+{
+  static const GimpCoords default_coords = GIMP_COORDS_DEFAULT_VALUES;
+
+  gdouble center = bench->size / 2.0;
+  gint    i;
+
+  for (i = 0; i < BENCHMARK_STROKE_LENGTH; i++)
+    {
+      GimpCoords coords = default_coords;
+      gdouble    t      = (gdouble) i / (BENCHMARK_STROKE_LENGTH - 1);
+      gdouble    radius = center * (0.1 + 0.8 * t);
+      gdouble    angle  = 6.0 * G_PI * t;
+
+      coords.x        = center + radius * cos (angle);
+      coords.y        = center + radius * sin (angle);
+      coords.pressure = 0.2 + 0.8 * sin (G_PI * t);
+
+      g_array_append_val (bench->stroke, coords);
+    }
+}
+
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *option_context;
+  Benchmark       bench  = { 0, };
+  GError         *error  = NULL;
+  gint            result = EXIT_SUCCESS;
+
+  option_context = g_option_context_new (NULL);
+  g_option_context_set_summary (option_context,
+                                "Runs the GIMP core benchmarks and writes "
+                                "their timings as JSON.");
+  g_option_context_add_main_entries (option_context, bench_options, NULL);
+
+  if (! g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+
+      return EXIT_FAILURE;
+    }
+
+  g_option_context_free (option_context);
+
+  bench.size       = MAX (bench_size, 64);
+  bench.n_layers   = MAX (bench_layers, 1);
+  bench.iterations = MAX (bench_iterations, 1);
+  bench.filter     = bench_filter;
+  bench.stroke     = g_array_new (FALSE, FALSE, sizeof (GimpCoords));
+  bench.json       = g_string_new (NULL);
+
+  if (bench_stroke)
+    {
+      if (! benchmark_load_stroke (&bench, bench_stroke, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+
+          return EXIT_FAILURE;
+        }
+    }
+  else
+    {
+      benchmark_create_stroke (&bench);
+    }
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  bench.gimp = gimp_init_for_testing ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  g_string_append_printf (bench.json,
+                          "{\n"
+                          "  \"version\": \"%s\",\n"
+                          "  \"size\": %d,\n"
+                          "  \"iterations\": %d,\n"
+                          "  \"threads\": %d,\n"
+                          "  \"benchmarks\": [\n",
+                          GIMP_VERSION,
+                          bench.size,
+                          bench.iterations,
+                          GIMP_GEGL_CONFIG (bench.gimp->config)->num_processors);
+
+  benchmark_projection   (&bench);
+  benchmark_layer_modes  (&bench);
+  benchmark_paint        (&bench);
+  benchmark_fuzzy_select (&bench);
+  benchmark_xcf          (&bench);
+  benchmark_convert      (&bench);
+
+  g_string_append (bench.json, "\n  ]\n}\n");
+
+  if (bench_output)
+    {
+      if (! g_file_set_contents (bench_output,
+                                 bench.json->str, bench.json->len,
+                                 &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+
+          result = EXIT_FAILURE;
+        }
+    }
+  else
+    {
+      g_print ("%s", bench.json->str);
+    }
+
+  g_string_free (bench.json, TRUE);
+  g_array_free (bench.stroke, TRUE);
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (bench.gimp, TRUE);
+
+  return result;
+}
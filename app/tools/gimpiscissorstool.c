@@ -45,6 +45,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <gegl.h>
 #include <gtk/gtk.h>
@@ -97,6 +98,16 @@
 #define  PIXEL_COST(x)     ((x) >> 8)
 #define  PIXEL_DIR(x)      ((x) & 0x000000ff)
 
+/*  live-wire search  */
+#define  LIVEWIRE_TILE_SIZE        64
+#define  LIVEWIRE_N_BUCKETS        512  /* more than the highest link cost  */
+#define  LIVEWIRE_STEPS            4096 /* pixels settled between target checks */
+#define  LIVEWIRE_SPECULATIVE_COST 8192 /* how far to search ahead of a target  */
+#define  LIVEWIRE_MAX              2    /* searches kept around by the tool   */
+
+#define  LINK_SETTLED      0x10
+#define  LINK_NONE         0xff
+
 
 struct _ISegment
 {
@@ -112,6 +123,47 @@ struct _ICurve
   gboolean  closed;
 };
 
+typedef struct _ILivewire ILivewire;
+
+struct _ILivewire
+{
+  GimpIscissorsTool  *iscissors;
+  ISegment           *segment;      /*  the segment to update, main thread  */
+
+  gint                anchor_x;
+  gint                anchor_y;
+  gboolean            reverse;      /*  anchor is the segment's end point   */
+
+  gint                width;
+  gint                height;
+  gint                n_tile_cols;
+  gint                n_tile_rows;
+  guint8            **grad_tiles;   /*  loaded by the main thread           */
+
+  /*  owned by the search thread  */
+  guint32           **cost_tiles;
+  guint8            **link_tiles;
+  GArray             *buckets[LIVEWIRE_N_BUCKETS];
+  gint                n_queued;
+  guint32             current_cost;
+
+  GThread            *thread;
+  GMutex              mutex;
+  GCond               cond;
+
+  /*  protected by the mutex  */
+  gboolean            quit;
+  gint                wanted_tile;
+  guint               idle_id;
+  gint                target_x;
+  gint                target_y;
+  gint                target_serial;
+  GPtrArray          *result;
+  gint                result_x;
+  gint                result_y;
+  gint                result_serial;
+};
+
 
 /*  local function prototypes  */
 
@@ -187,6 +239,12 @@ static void          find_max_gradient         (GimpIscissorsTool *iscissors,
                                                 gint              *y);
 static void          calculate_segment         (GimpIscissorsTool *iscissors,
                                                 ISegment          *segment);
+static void          calculate_segment_interactive
+                                               (GimpIscissorsTool *iscissors,
+                                                ISegment          *segment,
+                                                gboolean           reverse);
+static void          finish_segments_interactive
+                                               (GimpIscissorsTool *iscissors);
 static GimpCanvasItem * iscissors_draw_segment (GimpDrawTool      *draw_tool,
                                                 ISegment          *segment);
 
@@ -242,6 +300,27 @@ static void          icurve_close              (ICurve            *curve);
 static GimpScanConvert *
                     icurve_create_scan_convert (ICurve            *curve);
 
+static ILivewire   * livewire_new              (GimpIscissorsTool *iscissors,
+                                                gint               anchor_x,
+                                                gint               anchor_y,
+                                                gboolean           reverse);
+static void          livewire_free             (ILivewire         *livewire);
+static void          livewire_load_tiles       (ILivewire         *livewire,
+                                                gint               col,
+                                                gint               row);
+static gpointer      livewire_thread           (ILivewire         *livewire);
+static void          livewire_queue_idle       (ILivewire         *livewire);
+static gboolean      livewire_idle             (ILivewire         *livewire);
+static void          livewire_set_target       (ILivewire         *livewire,
+                                                ISegment          *segment,
+                                                gint               x,
+                                                gint               y);
+static void          livewire_finish           (ILivewire         *livewire);
+static void          livewire_apply            (ILivewire         *livewire,
+                                                GPtrArray         *points,
+                                                gint               target_x,
+                                                gint               target_y);
+
 
 /*  static variables  */
 
@@ -467,7 +546,8 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               iscissors->segment1->y1 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, iscissors->segment1);
+                calculate_segment_interactive (iscissors,
+                                               iscissors->segment1, TRUE);
             }
 
           if (iscissors->segment2)
@@ -476,7 +556,8 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               iscissors->segment2->y2 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, iscissors->segment2);
+                calculate_segment_interactive (iscissors,
+                                               iscissors->segment2, FALSE);
             }
         }
       /*  If the iscissors is closed, check if the click was inside  */
@@ -504,7 +585,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
               last->y2 = iscissors->y;
 
               if (options->interactive)
-                calculate_segment (iscissors, last);
+                calculate_segment_interactive (iscissors, last, FALSE);
             }
           else
             {
@@ -515,7 +596,7 @@ gimp_iscissors_tool_button_press (GimpTool            *tool,
                                                iscissors->y);
 
               if (options->interactive)
-                calculate_segment (iscissors, segment);
+                calculate_segment_interactive (iscissors, segment, FALSE);
             }
         }
       break;
@@ -568,6 +649,9 @@ gimp_iscissors_tool_button_release (GimpTool              *tool,
 
   gimp_draw_tool_pause (GIMP_DRAW_TOOL (tool));
 
+  /*  let the live-wire searches catch up with the final position  */
+  finish_segments_interactive (iscissors);
+
   if (release_type != GIMP_BUTTON_RELEASE_CANCEL)
     {
       /*  Progress to the next stage of intelligent selection  */
@@ -733,7 +817,7 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
       else
         {
           if (options->interactive)
-            calculate_segment (iscissors, segment);
+            calculate_segment_interactive (iscissors, segment, FALSE);
         }
       break;
 
@@ -744,7 +828,8 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
           iscissors->segment1->y1 = iscissors->y;
 
           if (options->interactive)
-            calculate_segment (iscissors, iscissors->segment1);
+            calculate_segment_interactive (iscissors,
+                                           iscissors->segment1, TRUE);
         }
 
       if (iscissors->segment2)
@@ -753,7 +838,8 @@ gimp_iscissors_tool_motion (GimpTool         *tool,
           iscissors->segment2->y2 = iscissors->y;
 
           if (options->interactive)
-            calculate_segment (iscissors, iscissors->segment2);
+            calculate_segment_interactive (iscissors,
+                                           iscissors->segment2, FALSE);
         }
       break;
 
@@ -1242,6 +1328,9 @@ gimp_iscissors_tool_halt (GimpIscissorsTool *iscissors,
       iscissors->redo_stack = NULL;
     }
 
+  g_list_free_full (iscissors->livewires, (GDestroyNotify) livewire_free);
+  iscissors->livewires = NULL;
+
   g_clear_object (&iscissors->gradient_map);
   g_clear_object (&iscissors->mask);
 }
@@ -1577,6 +1666,85 @@ calculate_segment (GimpIscissorsTool *iscissors,
 }
 
 
+/*  updates the segment's path from a live-wire search anchored at its
+ *  start, or at its end if 'reverse' is set, the path is replaced
+ *  asynchronously
+ */
+static void
+calculate_segment_interactive (GimpIscissorsTool *iscissors,
+                               ISegment          *segment,
+                               gboolean           reverse)
+{
+  GimpDisplay  *display  = GIMP_TOOL (iscissors)->display;
+  GimpPickable *pickable = GIMP_PICKABLE (gimp_display_get_image (display));
+  ILivewire    *livewire = NULL;
+  GList        *list;
+  gint          anchor_x, anchor_y;
+  gint          target_x, target_y;
+
+  if (! iscissors->gradient_map)
+    iscissors->gradient_map = gradient_map_new (pickable);
+
+  if (reverse)
+    {
+      anchor_x = segment->x2;
+      anchor_y = segment->y2;
+      target_x = segment->x1;
+      target_y = segment->y1;
+    }
+  else
+    {
+      anchor_x = segment->x1;
+      anchor_y = segment->y1;
+      target_x = segment->x2;
+      target_y = segment->y2;
+    }
+
+  for (list = iscissors->livewires; list; list = g_list_next (list))
+    {
+      ILivewire *lw = list->data;
+
+      if (lw->anchor_x == anchor_x &&
+          lw->anchor_y == anchor_y &&
+          lw->reverse  == reverse)
+        {
+          livewire = lw;
+
+          iscissors->livewires = g_list_delete_link (iscissors->livewires,
+                                                     list);
+          break;
+        }
+    }
+
+  if (! livewire)
+    {
+      livewire = livewire_new (iscissors, anchor_x, anchor_y, reverse);
+
+      if (g_list_length (iscissors->livewires) >= LIVEWIRE_MAX)
+        {
+          list = g_list_last (iscissors->livewires);
+
+          livewire_free (list->data);
+          iscissors->livewires = g_list_delete_link (iscissors->livewires,
+                                                     list);
+        }
+    }
+
+  iscissors->livewires = g_list_prepend (iscissors->livewires, livewire);
+
+  livewire_set_target (livewire, segment, target_x, target_y);
+}
+
+/*  makes sure the segments show the paths to their final end points  */
+static void
+finish_segments_interactive (GimpIscissorsTool *iscissors)
+{
+  GList *list;
+
+  for (list = iscissors->livewires; list; list = g_list_next (list))
+    livewire_finish (list->data);
+}
+
 /* badly need to get a replacement - this is _way_ too expensive */
 static gboolean
 gradient_map_value (GeglBuffer *map,
@@ -1941,6 +2109,670 @@ find_max_gradient (GimpIscissorsTool *iscissors,
     }
 }
 
+/*  live-wire search
+ *
+ *  While a vertex is being dragged, the optimal path is found by a
+ *  Dijkstra search which starts at the segment's fixed end point (the
+ *  anchor) and runs on a worker thread, settling pixels in order of
+ *  their path cost.  Once the pointer's pixel is settled, its path is
+ *  simply traced back to the anchor, so pointer moves within the
+ *  already searched area are answered immediately and moves beyond it
+ *  just continue the search.
+ *
+ *  The gradient map is derived from the image projection and can only
+ *  be validated on the main thread: the search asks for the gradient
+ *  tiles it reaches, and an idle handler copies them (and their
+ *  neighbours) into the search's own tile array.
+ */
+
+static ILivewire *
+livewire_new (GimpIscissorsTool *iscissors,
+              gint               anchor_x,
+              gint               anchor_y,
+              gboolean           reverse)
+{
+  ILivewire *livewire = g_slice_new0 (ILivewire);
+  gint       n_tiles;
+
+  livewire->iscissors   = iscissors;
+  livewire->anchor_x    = anchor_x;
+  livewire->anchor_y    = anchor_y;
+  livewire->reverse     = reverse;
+  livewire->width       = gegl_buffer_get_width  (iscissors->gradient_map);
+  livewire->height      = gegl_buffer_get_height (iscissors->gradient_map);
+  livewire->n_tile_cols = (livewire->width  + LIVEWIRE_TILE_SIZE - 1) /
+                          LIVEWIRE_TILE_SIZE;
+  livewire->n_tile_rows = (livewire->height + LIVEWIRE_TILE_SIZE - 1) /
+                          LIVEWIRE_TILE_SIZE;
+
+  n_tiles = livewire->n_tile_cols * livewire->n_tile_rows;
+
+  livewire->grad_tiles  = g_new0 (guint8 *,  n_tiles);
+  livewire->cost_tiles  = g_new0 (guint32 *, n_tiles);
+  livewire->link_tiles  = g_new0 (guint8 *,  n_tiles);
+  livewire->wanted_tile = -1;
+
+  g_mutex_init (&livewire->mutex);
+  g_cond_init (&livewire->cond);
+
+  /*  the anchor's surroundings are needed first in any case  */
+  livewire_load_tiles (livewire,
+                       anchor_x / LIVEWIRE_TILE_SIZE,
+                       anchor_y / LIVEWIRE_TILE_SIZE);
+
+  livewire->thread = g_thread_new ("iscissors-livewire",
+                                   (GThreadFunc) livewire_thread,
+                                   livewire);
+
+  return livewire;
+}
+
+static void
+livewire_free (ILivewire *livewire)
+{
+  gint n_tiles = livewire->n_tile_cols * livewire->n_tile_rows;
+  gint i;
+
+  g_mutex_lock (&livewire->mutex);
+  livewire->quit = TRUE;
+  g_cond_broadcast (&livewire->cond);
+  g_mutex_unlock (&livewire->mutex);
+
+  g_thread_join (livewire->thread);
+
+  if (livewire->idle_id)
+    g_source_remove (livewire->idle_id);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      g_free (livewire->grad_tiles[i]);
+      g_free (livewire->cost_tiles[i]);
+      g_free (livewire->link_tiles[i]);
+    }
+
+  g_free (livewire->grad_tiles);
+  g_free (livewire->cost_tiles);
+  g_free (livewire->link_tiles);
+
+  for (i = 0; i < LIVEWIRE_N_BUCKETS; i++)
+    if (livewire->buckets[i])
+      g_array_free (livewire->buckets[i], TRUE);
+
+  if (livewire->result)
+    g_ptr_array_free (livewire->result, TRUE);
+
+  g_mutex_clear (&livewire->mutex);
+  g_cond_clear (&livewire->cond);
+
+  g_slice_free (ILivewire, livewire);
+}
+
+/*  copies a tile of the gradient map, and the ones around it, into the
+ *  search's tile array.  called on the main thread only.
+ */
+static void
+livewire_load_tiles (ILivewire *livewire,
+                     gint       col,
+                     gint       row)
+{
+  GimpIscissorsTool *iscissors = livewire->iscissors;
+  gint               c, r;
+
+  for (r = row - 1; r <= row + 1; r++)
+    for (c = col - 1; c <= col + 1; c++)
+      {
+        GeglRectangle  rect;
+        guint8        *tile;
+        gint           index;
+
+        if (c < 0 || c >= livewire->n_tile_cols ||
+            r < 0 || r >= livewire->n_tile_rows)
+          continue;
+
+        index = r * livewire->n_tile_cols + c;
+
+        if (g_atomic_pointer_get (&livewire->grad_tiles[index]))
+          continue;
+
+        gegl_rectangle_intersect (&rect,
+                                  GEGL_RECTANGLE (c * LIVEWIRE_TILE_SIZE,
+                                                  r * LIVEWIRE_TILE_SIZE,
+                                                  LIVEWIRE_TILE_SIZE,
+                                                  LIVEWIRE_TILE_SIZE),
+                                  GEGL_RECTANGLE (0, 0,
+                                                  livewire->width,
+                                                  livewire->height));
+
+        tile = g_new0 (guint8, LIVEWIRE_TILE_SIZE * LIVEWIRE_TILE_SIZE *
+                               COST_WIDTH);
+
+        gegl_buffer_get (iscissors->gradient_map, &rect, 1.0, NULL, tile,
+                         LIVEWIRE_TILE_SIZE * COST_WIDTH, GEGL_ABYSS_NONE);
+
+        g_atomic_pointer_set (&livewire->grad_tiles[index], tile);
+      }
+}
+
+/*  returns the gradient of a pixel, waiting for its tile to be loaded
+ *  if necessary.  returns NULL if the search is quit meanwhile.
+ *  called on the search thread only.
+ */
+static inline const guint8 *
+livewire_get_gradient (ILivewire *livewire,
+                       gint       x,
+                       gint       y)
+{
+  gint    index = ((y / LIVEWIRE_TILE_SIZE) * livewire->n_tile_cols +
+                   (x / LIVEWIRE_TILE_SIZE));
+  guint8 *tile  = g_atomic_pointer_get (&livewire->grad_tiles[index]);
+
+  if (! tile)
+    {
+      g_mutex_lock (&livewire->mutex);
+
+      livewire->wanted_tile = index;
+      livewire_queue_idle (livewire);
+      g_cond_broadcast (&livewire->cond);
+
+      while (! (tile = g_atomic_pointer_get (&livewire->grad_tiles[index])) &&
+             ! livewire->quit)
+        {
+          g_cond_wait (&livewire->cond, &livewire->mutex);
+        }
+
+      livewire->wanted_tile = -1;
+
+      g_mutex_unlock (&livewire->mutex);
+
+      if (! tile)
+        return NULL;
+    }
+
+  return tile + ((y % LIVEWIRE_TILE_SIZE) * LIVEWIRE_TILE_SIZE +
+                 (x % LIVEWIRE_TILE_SIZE)) * COST_WIDTH;
+}
+
+/*  returns the position of a pixel in the search's cost and link
+ *  tiles, allocating the tiles if necessary.  called on the search
+ *  thread only.
+ */
+static inline gint
+livewire_get_node (ILivewire  *livewire,
+                   gint        x,
+                   gint        y,
+                   guint32   **cost,
+                   guint8    **link)
+{
+  gint index = ((y / LIVEWIRE_TILE_SIZE) * livewire->n_tile_cols +
+                (x / LIVEWIRE_TILE_SIZE));
+
+  if (! livewire->cost_tiles[index])
+    {
+      gint n_pixels = LIVEWIRE_TILE_SIZE * LIVEWIRE_TILE_SIZE;
+
+      livewire->cost_tiles[index] = g_new (guint32, n_pixels);
+      livewire->link_tiles[index] = g_new (guint8,  n_pixels);
+
+      memset (livewire->cost_tiles[index], 0xff, n_pixels * sizeof (guint32));
+      memset (livewire->link_tiles[index], LINK_NONE, n_pixels);
+    }
+
+  *cost = livewire->cost_tiles[index];
+  *link = livewire->link_tiles[index];
+
+  return ((y % LIVEWIRE_TILE_SIZE) * LIVEWIRE_TILE_SIZE +
+          (x % LIVEWIRE_TILE_SIZE));
+}
+
+static void
+livewire_push (ILivewire *livewire,
+               gint       x,
+               gint       y,
+               guint32    cost)
+{
+  GArray  **bucket = &livewire->buckets[cost % LIVEWIRE_N_BUCKETS];
+  guint32   pixel  = (guint32) y * livewire->width + x;
+
+  if (! *bucket)
+    *bucket = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  g_array_append_val (*bucket, pixel);
+
+  livewire->n_queued++;
+}
+
+/*  the cost of stepping from pixel (x, y) to its neighbour in
+ *  direction 'k', same as calculate_link()
+ */
+static inline gint
+livewire_link_cost (const guint8 *grad,
+                    const guint8 *neighbor_grad,
+                    gint          k)
+{
+  gint link  = (k > 3) ? k - 4 : k;
+  gint value = 0;
+
+  if (link > 1)
+    value += diagonal_weight[255 - grad[0]] * OMEGA_G;
+  else
+    value += (255 - grad[0]) * OMEGA_G;
+
+  value +=
+    (direction_value[grad[1]][link] + direction_value[neighbor_grad[1]][link]) *
+    OMEGA_D;
+
+  return value;
+}
+
+/*  settles the cheapest queued pixel and relaxes its neighbours.
+ *  returns FALSE if nothing is left to settle or the search is quit.
+ */
+static gboolean
+livewire_step (ILivewire *livewire)
+{
+  guint32 *cost;
+  guint8  *link;
+  guint32  pixel;
+  gint     node;
+  gint     x, y;
+  gint     k;
+  const guint8 *grad;
+
+  while (livewire->n_queued > 0)
+    {
+      GArray *bucket;
+
+      bucket = livewire->buckets[livewire->current_cost % LIVEWIRE_N_BUCKETS];
+
+      if (! bucket || bucket->len == 0)
+        {
+          livewire->current_cost++;
+          continue;
+        }
+
+      pixel = g_array_index (bucket, guint32, bucket->len - 1);
+      g_array_set_size (bucket, bucket->len - 1);
+      livewire->n_queued--;
+
+      x = pixel % livewire->width;
+      y = pixel / livewire->width;
+
+      node = livewire_get_node (livewire, x, y, &cost, &link);
+
+      /*  skip stale entries  */
+      if ((link[node] & LINK_SETTLED) || cost[node] != livewire->current_cost)
+        continue;
+
+      link[node] |= LINK_SETTLED;
+
+      grad = livewire_get_gradient (livewire, x, y);
+      if (! grad)
+        return FALSE;
+
+      for (k = 0; k < 8; k++)
+        {
+          const guint8 *neighbor_grad;
+          guint32      *neighbor_cost;
+          guint8       *neighbor_link;
+          guint32       new_cost;
+          gint          neighbor;
+          gint          nx = x + move[k][0];
+          gint          ny = y + move[k][1];
+
+          if (nx < 0 || nx >= livewire->width ||
+              ny < 0 || ny >= livewire->height)
+            continue;
+
+          neighbor = livewire_get_node (livewire, nx, ny,
+                                        &neighbor_cost, &neighbor_link);
+
+          if (neighbor_link[neighbor] != LINK_NONE &&
+              (neighbor_link[neighbor] & LINK_SETTLED))
+            continue;
+
+          neighbor_grad = livewire_get_gradient (livewire, nx, ny);
+          if (! neighbor_grad)
+            return FALSE;
+
+          /*  the neighbour links back to this pixel  */
+          new_cost = cost[node] + livewire_link_cost (neighbor_grad, grad, k);
+
+          if (new_cost < neighbor_cost[neighbor])
+            {
+              neighbor_cost[neighbor] = new_cost;
+              neighbor_link[neighbor] = (k + 4) % 8;
+
+              livewire_push (livewire, nx, ny, new_cost);
+            }
+        }
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*  returns the path from the target back to the anchor, in the order
+ *  calculate_segment() would store it in the segment, or NULL if the
+ *  target hasn't been reached yet.  called on the search thread only.
+ */
+static GPtrArray *
+livewire_trace (ILivewire *livewire,
+                gint       x,
+                gint       y)
+{
+  GPtrArray *points;
+  guint32   *cost;
+  guint8    *link;
+  gint       node;
+
+  node = livewire_get_node (livewire, x, y, &cost, &link);
+
+  if (link[node] == LINK_NONE || ! (link[node] & LINK_SETTLED))
+    return NULL;
+
+  points = g_ptr_array_new ();
+
+  while (TRUE)
+    {
+      gint dir;
+
+      g_ptr_array_add (points, GINT_TO_POINTER ((y << 16) + x));
+
+      node = livewire_get_node (livewire, x, y, &cost, &link);
+      dir  = link[node] & ~LINK_SETTLED;
+
+      if (dir == SEED_POINT)
+        break;
+
+      x += move[dir][0];
+      y += move[dir][1];
+    }
+
+  if (livewire->reverse)
+    {
+      gint i, j;
+
+      for (i = 0, j = points->len - 1; i < j; i++, j--)
+        {
+          gpointer tmp = points->pdata[i];
+
+          points->pdata[i] = points->pdata[j];
+          points->pdata[j] = tmp;
+        }
+    }
+
+  return points;
+}
+
+static gpointer
+livewire_thread (ILivewire *livewire)
+{
+  guint32 *cost;
+  guint8  *link;
+  gint     node;
+  gint     serial     = 0;
+  gint     target_x   = 0;
+  gint     target_y   = 0;
+  guint32  max_cost   = LIVEWIRE_SPECULATIVE_COST;
+  gboolean has_target = FALSE;
+  gboolean traced     = TRUE;
+
+  node = livewire_get_node (livewire, livewire->anchor_x, livewire->anchor_y,
+                            &cost, &link);
+
+  cost[node] = 0;
+  link[node] = SEED_POINT;
+
+  livewire_push (livewire, livewire->anchor_x, livewire->anchor_y, 0);
+
+  while (TRUE)
+    {
+      gint i;
+
+      /*  pick up a new target  */
+      g_mutex_lock (&livewire->mutex);
+
+      if (livewire->quit)
+        {
+          g_mutex_unlock (&livewire->mutex);
+          break;
+        }
+
+      if (livewire->target_serial != serial)
+        {
+          serial     = livewire->target_serial;
+          target_x   = livewire->target_x;
+          target_y   = livewire->target_y;
+          has_target = TRUE;
+          traced     = FALSE;
+        }
+
+      g_mutex_unlock (&livewire->mutex);
+
+      /*  answer it as soon as it is settled  */
+      if (! traced)
+        {
+          GPtrArray *points = livewire_trace (livewire, target_x, target_y);
+
+          if (points)
+            {
+              node = livewire_get_node (livewire, target_x, target_y,
+                                        &cost, &link);
+
+              /*  keep searching a bit beyond the target, the pointer
+               *  is likely to move on in its neighbourhood
+               */
+              max_cost = MAX (LIVEWIRE_SPECULATIVE_COST, 2 * cost[node]);
+
+              g_mutex_lock (&livewire->mutex);
+
+              if (livewire->target_serial == serial)
+                {
+                  if (livewire->result)
+                    g_ptr_array_free (livewire->result, TRUE);
+
+                  livewire->result        = points;
+                  livewire->result_serial = serial;
+                  livewire->result_x      = target_x;
+                  livewire->result_y      = target_y;
+
+                  livewire_queue_idle (livewire);
+                  g_cond_broadcast (&livewire->cond);
+                }
+              else
+                {
+                  g_ptr_array_free (points, TRUE);
+                }
+
+              g_mutex_unlock (&livewire->mutex);
+
+              traced = TRUE;
+            }
+        }
+
+      /*  expand the search  */
+      if ((has_target && ! traced) || livewire->current_cost <= max_cost)
+        {
+          for (i = 0; i < LIVEWIRE_STEPS; i++)
+            if (! livewire_step (livewire))
+              break;
+
+          if (i == LIVEWIRE_STEPS)
+            continue;
+        }
+
+      /*  nothing to do until the target changes  */
+      g_mutex_lock (&livewire->mutex);
+
+      while (livewire->target_serial == serial && ! livewire->quit)
+        g_cond_wait (&livewire->cond, &livewire->mutex);
+
+      g_mutex_unlock (&livewire->mutex);
+    }
+
+  return NULL;
+}
+
+/*  called with the mutex locked  */
+static void
+livewire_queue_idle (ILivewire *livewire)
+{
+  if (! livewire->idle_id)
+    livewire->idle_id = g_idle_add ((GSourceFunc) livewire_idle, livewire);
+}
+
+static gboolean
+livewire_idle (ILivewire *livewire)
+{
+  GPtrArray *points = NULL;
+  gint       x      = 0;
+  gint       y      = 0;
+
+  g_mutex_lock (&livewire->mutex);
+
+  livewire->idle_id = 0;
+
+  if (livewire->wanted_tile >= 0)
+    {
+      livewire_load_tiles (livewire,
+                           livewire->wanted_tile % livewire->n_tile_cols,
+                           livewire->wanted_tile / livewire->n_tile_cols);
+
+      g_cond_broadcast (&livewire->cond);
+    }
+
+  if (livewire->result)
+    {
+      points           = livewire->result;
+      x                = livewire->result_x;
+      y                = livewire->result_y;
+      livewire->result = NULL;
+    }
+
+  g_mutex_unlock (&livewire->mutex);
+
+  if (points)
+    livewire_apply (livewire, points, x, y);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*  points the search at a new target, the segment's path is replaced
+ *  as soon as the target is reached
+ */
+static void
+livewire_set_target (ILivewire *livewire,
+                     ISegment  *segment,
+                     gint       x,
+                     gint       y)
+{
+  livewire->segment = segment;
+
+  g_mutex_lock (&livewire->mutex);
+
+  livewire->target_x = x;
+  livewire->target_y = y;
+  livewire->target_serial++;
+
+  g_cond_broadcast (&livewire->cond);
+
+  g_mutex_unlock (&livewire->mutex);
+}
+
+/*  waits for the path to the current target, serving the search's
+ *  tile requests meanwhile
+ */
+static void
+livewire_finish (ILivewire *livewire)
+{
+  GPtrArray *points = NULL;
+  gint       x      = 0;
+  gint       y      = 0;
+
+  g_mutex_lock (&livewire->mutex);
+
+  if (livewire->target_serial == 0)
+    {
+      g_mutex_unlock (&livewire->mutex);
+      return;
+    }
+
+  while (livewire->result_serial != livewire->target_serial)
+    {
+      if (livewire->wanted_tile >= 0)
+        {
+          livewire_load_tiles (livewire,
+                               livewire->wanted_tile % livewire->n_tile_cols,
+                               livewire->wanted_tile / livewire->n_tile_cols);
+
+          g_cond_broadcast (&livewire->cond);
+        }
+
+      g_cond_wait (&livewire->cond, &livewire->mutex);
+    }
+
+  if (livewire->result)
+    {
+      points           = livewire->result;
+      x                = livewire->result_x;
+      y                = livewire->result_y;
+      livewire->result = NULL;
+    }
+
+  g_mutex_unlock (&livewire->mutex);
+
+  if (points)
+    livewire_apply (livewire, points, x, y);
+}
+
+/*  hands a traced path to the segment it was searched for, if that is
+ *  still part of the curve and still spans from the anchor to the
+ *  traced target
+ */
+static void
+livewire_apply (ILivewire *livewire,
+                GPtrArray *points,
+                gint       target_x,
+                gint       target_y)
+{
+  GimpIscissorsTool *iscissors = livewire->iscissors;
+  ISegment          *segment   = livewire->segment;
+  gboolean           valid     = FALSE;
+
+  if (segment && g_queue_find (iscissors->curve->segments, segment))
+    {
+      if (livewire->reverse)
+        valid = (segment->x1 == target_x           &&
+                 segment->y1 == target_y           &&
+                 segment->x2 == livewire->anchor_x &&
+                 segment->y2 == livewire->anchor_y);
+      else
+        valid = (segment->x1 == livewire->anchor_x &&
+                 segment->y1 == livewire->anchor_y &&
+                 segment->x2 == target_x           &&
+                 segment->y2 == target_y);
+    }
+
+  if (valid)
+    {
+      GimpDrawTool *draw_tool = GIMP_DRAW_TOOL (iscissors);
+
+      gimp_draw_tool_pause (draw_tool);
+
+      if (segment->points)
+        g_ptr_array_free (segment->points, TRUE);
+
+      segment->points = points;
+
+      gimp_draw_tool_resume (draw_tool);
+    }
+  else
+    {
+      g_ptr_array_free (points, TRUE);
+    }
+}
+
 static ISegment *
 isegment_new (gint x1,
               gint y1,
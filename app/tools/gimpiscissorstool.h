@@ -79,6 +79,7 @@ struct _GimpIscissorsTool
   IscissorsState  state;        /*  state of iscissors                      */
 
   GeglBuffer     *gradient_map; /*  lazily filled gradient map              */
+  GList          *livewires;    /*  live-wire searches for dragged points   */
   GimpChannel    *mask;         /*  selection mask                          */
 };
 
@@ -41,6 +41,7 @@
 #include "widgets-types.h"
 
 #include "core/gimp.h"
+#include "core/gimp-latency.h"
 
 #include "gimpdocked.h"
 #include "gimpdashboard.h"
@@ -93,6 +94,14 @@ typedef enum
   VARIABLE_CPU_ACTIVE_TIME,
 #endif
 
+  /* latency */
+  VARIABLE_LATENCY_MEDIAN,
+  VARIABLE_LATENCY_95TH,
+  VARIABLE_LATENCY_99TH,
+
+  VARIABLE_LATENCY_PAINT,
+  VARIABLE_LATENCY_UPDATE,
+
 
   N_VARIABLES,
 
@@ -118,6 +127,7 @@ typedef enum
 #ifdef HAVE_CPU_GROUP
   GROUP_CPU,
 #endif
+  GROUP_LATENCY,
 
   N_GROUPS
 } Group;
@@ -282,6 +292,8 @@ static void       gimp_dashboard_sample_cpu_active_time      (GimpDashboard
 static void       gimp_dashboard_reset_cpu_active_time       (GimpDashboard       *dashboard,
                                                               Variable             variable);
 #endif /* HAVE_CPU_GROUP */
+static void       gimp_dashboard_sample_latency              (GimpDashboard       *dashboard,
+                                                              Variable             variable);
 
 static void       gimp_dashboard_sample_object               (GimpDashboard       *dashboard,
                                                               GObject             *object,
@@ -448,8 +460,56 @@ static const VariableInfo variables[] =
     .color            = {0.8, 0.7, 0.2, 0.4},
     .sample_func      = gimp_dashboard_sample_cpu_active_time,
     .reset_func       = gimp_dashboard_reset_cpu_active_time
-  }
+  },
 #endif /* HAVE_CPU_GROUP */
+
+
+  /* latency variables */
+
+  [VARIABLE_LATENCY_MEDIAN] =
+  { .name             = "latency-median",
+    .title            = NC_("dashboard-variable", "Median"),
+    .description      = N_("Median time from a painting input event "
+                           "until its result is drawn on the canvas"),
+    .type             = VARIABLE_TYPE_DURATION,
+    .sample_func      = gimp_dashboard_sample_latency
+  },
+
+  [VARIABLE_LATENCY_95TH] =
+  { .name             = "latency-95th",
+    .title            = NC_("dashboard-variable", "95th %"),
+    .description      = N_("Time within which 95% of the painting input "
+                           "events are drawn on the canvas"),
+    .type             = VARIABLE_TYPE_DURATION,
+    .sample_func      = gimp_dashboard_sample_latency
+  },
+
+  [VARIABLE_LATENCY_99TH] =
+  { .name             = "latency-99th",
+    .title            = NC_("dashboard-variable", "99th %"),
+    .description      = N_("Time within which 99% of the painting input "
+                           "events are drawn on the canvas"),
+    .type             = VARIABLE_TYPE_DURATION,
+    .sample_func      = gimp_dashboard_sample_latency
+  },
+
+  [VARIABLE_LATENCY_PAINT] =
+  { .name             = "latency-paint",
+    .title            = NC_("dashboard-variable", "Paint"),
+    .description      = N_("Median time from a painting input event "
+                           "until it is painted onto the drawable"),
+    .type             = VARIABLE_TYPE_DURATION,
+    .sample_func      = gimp_dashboard_sample_latency
+  },
+
+  [VARIABLE_LATENCY_UPDATE] =
+  { .name             = "latency-update",
+    .title            = NC_("dashboard-variable", "Render"),
+    .description      = N_("Median time from a painting input event "
+                           "until it is rendered into the image projection"),
+    .type             = VARIABLE_TYPE_DURATION,
+    .sample_func      = gimp_dashboard_sample_latency
+  }
 };
 
 static const GroupInfo groups[] =
@@ -545,8 +605,41 @@ static const GroupInfo groups[] =
 
                           {}
                         }
-  }
+  },
 #endif /* HAVE_CPU_GROUP */
+
+  /* latency group */
+  [GROUP_LATENCY] =
+  { .name             = "latency",
+    .title            = NC_("dashboard-group", "Latency"),
+    .description      = N_("Painting input-to-screen latency"),
+    .default_expanded = FALSE,
+    .has_meter        = FALSE,
+    .fields           = (const FieldInfo[])
+                        {
+                          { .variable       = VARIABLE_LATENCY_MEDIAN,
+                            .default_active = TRUE,
+                            .show_in_header = TRUE
+                          },
+                          { .variable       = VARIABLE_LATENCY_95TH,
+                            .default_active = TRUE
+                          },
+                          { .variable       = VARIABLE_LATENCY_99TH,
+                            .default_active = FALSE
+                          },
+
+                          { VARIABLE_SEPARATOR },
+
+                          { .variable       = VARIABLE_LATENCY_PAINT,
+                            .default_active = FALSE
+                          },
+                          { .variable       = VARIABLE_LATENCY_UPDATE,
+                            .default_active = FALSE
+                          },
+
+                          {}
+                        }
+  }
 };
 
 
@@ -1673,6 +1766,42 @@ gimp_dashboard_reset_cpu_active_time (GimpDashboard *dashboard,
 
 #endif /* HAVE_CPU_GROUP */
 
+static void
+gimp_dashboard_sample_latency (GimpDashboard *dashboard,
+                               Variable       variable)
+{
+  GimpDashboardPrivate *priv          = dashboard->priv;
+  VariableData         *variable_data = &priv->variables[variable];
+  GimpLatencyStage      stage         = GIMP_LATENCY_STAGE_DRAW;
+  gdouble               percentile    = 0.50;
+
+  switch (variable)
+    {
+    case VARIABLE_LATENCY_95TH:
+      percentile = 0.95;
+      break;
+
+    case VARIABLE_LATENCY_99TH:
+      percentile = 0.99;
+      break;
+
+    case VARIABLE_LATENCY_PAINT:
+      stage = GIMP_LATENCY_STAGE_PAINT;
+      break;
+
+    case VARIABLE_LATENCY_UPDATE:
+      stage = GIMP_LATENCY_STAGE_UPDATE;
+      break;
+
+    default:
+      break;
+    }
+
+  variable_data->available =
+    gimp_latency_get_percentile (stage, percentile,
+                                 &variable_data->value.duration);
+}
+
 static void
 gimp_dashboard_sample_object (GimpDashboard *dashboard,
                               GObject       *object,
@@ -2235,10 +2364,21 @@ gimp_dashboard_field_to_string (GimpDashboard *dashboard,
           break;
 
         case VARIABLE_TYPE_DURATION:
-          str        = g_strdup_printf ("%02d:%02d:%04.1f",
-                                        (gint) floor (variable_data->value.duration / 3600.0),
-                                        (gint) floor (fmod (variable_data->value.duration / 60.0, 60.0)),
-                                        floor (fmod (variable_data->value.duration, 60.0) * 10.0) / 10.0);
+          if (variable_data->value.duration < 1.0)
+            {
+              /* Translators: a duration shorter than a second, in
+               * milliseconds
+               */
+              str = g_strdup_printf (C_("dashboard-value", "%.1f ms"),
+                                     1000.0 * variable_data->value.duration);
+            }
+          else
+            {
+              str = g_strdup_printf ("%02d:%02d:%04.1f",
+                                     (gint) floor (variable_data->value.duration / 3600.0),
+                                     (gint) floor (fmod (variable_data->value.duration / 60.0, 60.0)),
+                                     floor (fmod (variable_data->value.duration, 60.0) * 10.0) / 10.0);
+            }
           static_str = FALSE;
           show_limit = FALSE;
           break;
@@ -2329,6 +2469,7 @@ gimp_dashboard_reset (GimpDashboard *dashboard)
   g_mutex_lock (&priv->mutex);
 
   gegl_reset_stats ();
+  gimp_latency_reset ();
 
   for (variable = FIRST_VARIABLE; variable < N_VARIABLES; variable++)
     {
@@ -81,6 +81,19 @@
 /* #define GIMP_XCF_PATH_DEBUG */
 
 
+/* a zlib compressed tile waiting to be inflated in a thread */
+typedef struct
+{
+  GeglBuffer         *buffer;
+  GeglRectangle       rect;
+  const Babl         *format;
+  XcfCompressionType  compression;
+  gint                file_version;
+  guchar             *data;
+  gsize               data_length;
+} XcfTileJob;
+
+
 static void            xcf_load_add_masks     (GimpImage     *image);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
                                                GimpImage     *image);
@@ -124,6 +137,24 @@ static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format,
                                                gint           data_length);
+static gsize           xcf_load_tile_data     (XcfInfo       *info,
+                                               guchar        *data,
+                                               gint           data_length);
+static gboolean        xcf_load_tile_inflate  (GeglBuffer          *buffer,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               XcfCompressionType   compression,
+                                               gint                 file_version,
+                                               const guchar        *data,
+                                               gsize                data_length);
+static XcfTileJob    * xcf_load_tile_job_new  (XcfInfo             *info,
+                                               GeglBuffer          *buffer,
+                                               const GeglRectangle *tile_rect,
+                                               const Babl          *format,
+                                               gint                 data_length);
+static void            xcf_load_tile_job_free (XcfTileJob          *job);
+static void            xcf_load_tile_job_run  (XcfTileJob          *job,
+                                               gint                *failed);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -566,6 +597,173 @@ xcf_load_image (Gimp     *gimp,
   return NULL;
 }
 
+/* loads the smallest level of the projection pyramid which is at
+ * least 'size' pixels large, returns NULL without setting 'error' if
+ * the file doesn't contain reduced-size previews.
+ */
+GimpImage *
+xcf_load_thumbnail (Gimp     *gimp,
+                    XcfInfo  *info,
+                    gint      size,
+                    gint     *image_width,
+                    gint     *image_height,
+                    gint     *image_type,
+                    gint     *n_layers,
+                    GError  **error)
+{
+  GimpImage         *image;
+  GimpLayer         *layer;
+  GimpImageBaseType  base_type;
+  PropType           prop_type;
+  guint32            prop_size;
+  goffset            projection_offset = 0;
+  goffset            offset;
+  goffset            level_offset = 0;
+  gint               width;
+  gint               height;
+  gint               type;
+  gint               bpp;
+  gint               level_width  = 0;
+  gint               level_height = 0;
+  gint               i;
+
+  xcf_read_int32 (info, (guint32 *) &width,  1);
+  xcf_read_int32 (info, (guint32 *) &height, 1);
+  xcf_read_int32 (info, (guint32 *) &type,   1);
+  if (type < GIMP_RGB || type > GIMP_INDEXED ||
+      width <= 0 || height <= 0)
+    goto corrupt;
+
+  if (info->file_version >= 4)
+    {
+      gint p;
+
+      xcf_read_int32 (info, (guint32 *) &p, 1);
+    }
+
+  while (TRUE)
+    {
+      if (! xcf_load_prop (info, &prop_type, &prop_size))
+        goto corrupt;
+
+      if (prop_type == PROP_END)
+        break;
+
+      switch (prop_type)
+        {
+        case PROP_COMPRESSION:
+          {
+            guint8 compression;
+
+            xcf_read_int8 (info, (guint8 *) &compression, 1);
+
+            info->compression = compression;
+          }
+          break;
+
+        case PROP_PROJECTION:
+          xcf_read_offset (info, &projection_offset, 1);
+          break;
+
+        default:
+          if (! xcf_skip_unknown_prop (info, prop_size))
+            goto corrupt;
+          break;
+        }
+    }
+
+  *image_width  = width;
+  *image_height = height;
+  *image_type   = type * 2;
+  *n_layers     = 0;
+
+  while (TRUE)
+    {
+      xcf_read_offset (info, &offset, 1);
+
+      if (offset == 0)
+        break;
+
+      (*n_layers)++;
+    }
+
+  if (projection_offset == 0)
+    return NULL;
+
+  if (! xcf_seek_pos (info, projection_offset, NULL))
+    goto corrupt;
+
+  xcf_read_int32 (info, (guint32 *) &width,  1);
+  xcf_read_int32 (info, (guint32 *) &height, 1);
+  xcf_read_int32 (info, (guint32 *) &bpp,    1);
+
+  switch (bpp)
+    {
+    case 2: base_type = GIMP_GRAY; break;
+    case 4: base_type = GIMP_RGB;  break;
+    default:
+      goto corrupt;
+    }
+
+  /* skip the empty top level, then pick the smallest reduced level
+   * which still covers the requested size
+   */
+  xcf_read_offset (info, &offset, 1);
+
+  for (i = 1; TRUE; i++)
+    {
+      xcf_read_offset (info, &offset, 1);
+
+      if (offset == 0 || (width >> i) == 0 || (height >> i) == 0)
+        break;
+
+      if (MAX (width >> i, height >> i) < size && level_offset != 0)
+        break;
+
+      level_offset = offset;
+      level_width  = width  >> i;
+      level_height = height >> i;
+    }
+
+  if (level_offset == 0)
+    return NULL;
+
+  if (! xcf_seek_pos (info, level_offset, NULL))
+    goto corrupt;
+
+  GIMP_LOG (XCF, "thumbnail level %dx%d", level_width, level_height);
+
+  image = gimp_create_image (gimp, level_width, level_height, base_type,
+                             GIMP_PRECISION_U8_GAMMA, FALSE);
+
+  gimp_image_undo_disable (image);
+
+  layer = gimp_layer_new (image, level_width, level_height,
+                          gimp_image_get_layer_format (image, TRUE),
+                          "Preview",
+                          GIMP_OPACITY_OPAQUE,
+                          gimp_image_get_default_new_layer_mode (image));
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  if (! xcf_load_level (info, gimp_drawable_get_buffer (GIMP_DRAWABLE (layer))))
+    {
+      g_object_unref (image);
+      goto corrupt;
+    }
+
+  gimp_image_undo_enable (image);
+
+  return image;
+
+ corrupt:
+  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("This XCF file is corrupt!  I could not even "
+                         "salvage any partial image data from it."));
+
+  return NULL;
+}
+
 static void
 xcf_load_add_masks (GimpImage *image)
 {
@@ -688,7 +886,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_ZLIB_PLANAR))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -938,6 +1137,14 @@ xcf_load_image_props (XcfInfo   *info,
           }
           break;
 
+        case PROP_PROJECTION:
+          /* only the thumbnail loader looks at the projection pyramid,
+           * it is recreated on each save
+           */
+          if (! xcf_skip_unknown_prop (info, prop_size))
+            return FALSE;
+          break;
+
         default:
 #ifdef GIMP_UNSTABLE
           g_printerr ("unexpected/unknown image property: %d (skipping)\n",
@@ -1898,19 +2105,21 @@ static gboolean
 xcf_load_level (XcfInfo    *info,
                 GeglBuffer *buffer)
 {
-  const Babl *format;
-  gint        bpp;
-  goffset     saved_pos;
-  goffset     offset;
-  goffset     offset2;
-  goffset     max_data_length;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        width;
-  gint        height;
-  gint        i;
-  gint        fail;
+  const Babl   *format;
+  gint          bpp;
+  goffset       saved_pos;
+  goffset       offset;
+  goffset       offset2;
+  goffset       max_data_length;
+  gint          n_tile_rows;
+  gint          n_tile_cols;
+  guint         ntiles;
+  gint          width;
+  gint          height;
+  gint          i;
+  gint          fail;
+  GThreadPool  *pool   = NULL;
+  gint          failed = FALSE;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -1941,6 +2150,21 @@ xcf_load_level (XcfInfo    *info,
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
+
+  /* reading the file is sequential, but inflating zlib tiles can be
+   * spread across threads while we read ahead
+   */
+  if ((info->compression == COMPRESS_ZLIB ||
+       info->compression == COMPRESS_ZLIB_PLANAR) &&
+      ntiles > 1)
+    {
+      gint n_threads = GIMP_GEGL_CONFIG (info->gimp->config)->num_processors;
+
+      if (n_threads > 1)
+        pool = g_thread_pool_new ((GFunc) xcf_load_tile_job_run, &failed,
+                                  MIN (n_threads, ntiles), FALSE, NULL);
+    }
+
   for (i = 0; i < ntiles; i++)
     {
       GeglRectangle rect;
@@ -1952,7 +2176,7 @@ xcf_load_level (XcfInfo    *info,
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
                                 GIMP_MESSAGE_ERROR,
                                 "not enough tiles found in level");
-          return FALSE;
+          goto error;
         }
 
       /* save the current position as it is where the
@@ -1971,9 +2195,17 @@ xcf_load_level (XcfInfo    *info,
       if (offset2 == 0)
         offset2 = offset + max_data_length;
 
+      /* incremental saves append rewritten tiles to the end of the
+       * file, so the next tile's offset doesn't necessarily bound this
+       * tile's data any longer
+       */
+      if (info->file_version >= XCF_INCREMENTAL_VERSION &&
+          (offset2 < offset || offset2 - offset > max_data_length))
+        offset2 = offset + max_data_length;
+
       /* seek to the tile offset */
       if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+        goto error;
 
       if (offset2 < offset || offset2 - offset > max_data_length)
         {
@@ -1981,7 +2213,7 @@ xcf_load_level (XcfInfo    *info,
                         GIMP_MESSAGE_ERROR,
                         "invalid tile data length: %" G_GOFFSET_FORMAT,
                         offset2 - offset);
-          return FALSE;
+          goto error;
         }
 
       /* get the tile from the tile manager */
@@ -2004,9 +2236,21 @@ xcf_load_level (XcfInfo    *info,
             fail = TRUE;
           break;
         case COMPRESS_ZLIB:
-          if (!xcf_load_tile_zlib (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
+        case COMPRESS_ZLIB_PLANAR:
+          if (pool)
+            {
+              XcfTileJob *job = xcf_load_tile_job_new (info, buffer, &rect,
+                                                       format,
+                                                       offset2 - offset);
+
+              if (job)
+                g_thread_pool_push (pool, job, NULL);
+            }
+          else if (!xcf_load_tile_zlib (info, buffer, &rect, format,
+                                        offset2 - offset))
+            {
+              fail = TRUE;
+            }
           break;
         case COMPRESS_FRACTAL:
           g_printerr ("xcf: fractal compression unimplemented. "
@@ -2020,8 +2264,8 @@ xcf_load_level (XcfInfo    *info,
           break;
         }
 
-      if (fail)
-        return FALSE;
+      if (fail || g_atomic_int_get (&failed))
+        goto error;
 
       GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
 
@@ -2029,12 +2273,22 @@ xcf_load_level (XcfInfo    *info,
        *  read the next offset.
        */
       if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+        goto error;
 
       /* read in the offset of the next tile */
       xcf_read_offset (info, &offset, 1);
     }
 
+  if (pool)
+    {
+      /* wait for the remaining tiles */
+      g_thread_pool_free (pool, FALSE, TRUE);
+      pool = NULL;
+
+      if (failed)
+        return FALSE;
+    }
+
   if (offset != 0)
     {
       gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
@@ -2044,6 +2298,16 @@ xcf_load_level (XcfInfo    *info,
     }
 
   return TRUE;
+
+ error:
+  if (pool)
+    {
+      /* let the queued jobs just free their data */
+      g_atomic_int_set (&failed, TRUE);
+      g_thread_pool_free (pool, FALSE, TRUE);
+    }
+
+  return FALSE;
 }
 
 static gboolean
@@ -2236,14 +2500,8 @@ xcf_load_tile_zlib (XcfInfo       *info,
                     const Babl    *format,
                     gint           data_length)
 {
-  z_stream  strm;
-  int       action;
-  int       status;
-  gint      bpp       = babl_format_get_bytes_per_pixel (format);
-  gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  gsize     bytes_read;
-  guchar   *xcfdata;
+  gsize   bytes_read;
+  guchar *xcfdata;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -2256,24 +2514,65 @@ xcf_load_tile_zlib (XcfInfo       *info,
 
   xcfdata = g_alloca (data_length);
 
+  bytes_read = xcf_load_tile_data (info, xcfdata, data_length);
+
+  if (bytes_read == 0)
+    return TRUE;
+
+  return xcf_load_tile_inflate (buffer, tile_rect, format,
+                                info->compression, info->file_version,
+                                xcfdata, bytes_read);
+}
+
+static gsize
+xcf_load_tile_data (XcfInfo *info,
+                    guchar  *data,
+                    gint     data_length)
+{
+  gsize bytes_read;
+
   /* we have to read directly instead of xcf_read_* because we may be
    * reading past the end of the file here
    */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
+  g_input_stream_read_all (info->input, data, data_length,
                            &bytes_read, NULL, NULL);
   info->cp += bytes_read;
 
-  if (bytes_read == 0)
-    return TRUE;
+  return bytes_read;
+}
+
+/* decompresses one tile, this doesn't touch the XcfInfo and may run
+ * in any thread
+ */
+static gboolean
+xcf_load_tile_inflate (GeglBuffer          *buffer,
+                       const GeglRectangle *tile_rect,
+                       const Babl          *format,
+                       XcfCompressionType   compression,
+                       gint                 file_version,
+                       const guchar        *data,
+                       gsize                data_length)
+{
+  z_stream  strm;
+  int       action;
+  int       status;
+  gint      bpp          = babl_format_get_bytes_per_pixel (format);
+  gint      n_components = babl_format_get_n_components (format);
+  gint      tile_size    = bpp * tile_rect->width * tile_rect->height;
+  guchar   *tile_data    = g_alloca (tile_size);
+  guchar   *planes       = NULL;
 
-  strm.next_out  = tile_data;
+  if (compression == COMPRESS_ZLIB_PLANAR)
+    planes = g_alloca (tile_size);
+
+  strm.next_out  = planes ? planes : tile_data;
   strm.avail_out = tile_size;
 
   strm.zalloc    = Z_NULL;
   strm.zfree     = Z_NULL;
   strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
+  strm.next_in   = (guchar *) data;
+  strm.avail_in  = data_length;
 
   /* Initialize the stream decompression. */
   status = inflateInit (&strm);
@@ -2310,12 +2609,23 @@ xcf_load_tile_zlib (XcfInfo       *info,
         }
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
+  if (planes)
     {
-      if (info->file_version >= 12)
+      /* an all-zero tile is encoded as all-zero planes */
+      if (! xcf_data_is_zero (planes, tile_size))
         {
-          gint n_components = babl_format_get_n_components (format);
+          xcf_planar_decode (tile_data, planes,
+                             tile_rect->width * tile_rect->height,
+                             tile_rect->width, bpp, n_components);
 
+          gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
+    }
+  else if (! xcf_data_is_zero (tile_data, tile_size))
+    {
+      if (file_version >= 12)
+        {
           xcf_read_from_be (bpp / n_components, tile_data,
                             tile_size / bpp * n_components);
         }
@@ -2329,6 +2639,65 @@ xcf_load_tile_zlib (XcfInfo       *info,
   return TRUE;
 }
 
+/* reads a tile's compressed data for decompression in a thread,
+ * returns NULL for tiles without data
+ */
+static XcfTileJob *
+xcf_load_tile_job_new (XcfInfo             *info,
+                       GeglBuffer          *buffer,
+                       const GeglRectangle *tile_rect,
+                       const Babl          *format,
+                       gint                 data_length)
+{
+  XcfTileJob *job;
+
+  /* see xcf_load_tile_zlib() */
+  if (data_length <= 0)
+    return NULL;
+
+  job = g_slice_new (XcfTileJob);
+
+  job->buffer       = buffer;
+  job->rect         = *tile_rect;
+  job->format       = format;
+  job->compression  = info->compression;
+  job->file_version = info->file_version;
+  job->data         = g_malloc (data_length);
+  job->data_length  = xcf_load_tile_data (info, job->data, data_length);
+
+  if (job->data_length == 0)
+    {
+      xcf_load_tile_job_free (job);
+
+      return NULL;
+    }
+
+  return job;
+}
+
+static void
+xcf_load_tile_job_free (XcfTileJob *job)
+{
+  g_free (job->data);
+
+  g_slice_free (XcfTileJob, job);
+}
+
+static void
+xcf_load_tile_job_run (XcfTileJob *job,
+                       gint       *failed)
+{
+  if (! g_atomic_int_get (failed) &&
+      ! xcf_load_tile_inflate (job->buffer, &job->rect, job->format,
+                               job->compression, job->file_version,
+                               job->data, job->data_length))
+    {
+      g_atomic_int_set (failed, TRUE);
+    }
+
+  xcf_load_tile_job_free (job);
+}
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
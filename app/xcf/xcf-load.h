@@ -19,9 +19,17 @@
 #define __XCF_LOAD_H__
 
 
-GimpImage * xcf_load_image (Gimp     *gimp,
-                            XcfInfo  *info,
-                            GError  **error);
+GimpImage * xcf_load_image     (Gimp     *gimp,
+                                XcfInfo  *info,
+                                GError  **error);
+GimpImage * xcf_load_thumbnail (Gimp     *gimp,
+                                XcfInfo  *info,
+                                gint      size,
+                                gint     *image_width,
+                                gint     *image_height,
+                                gint     *image_type,
+                                gint     *n_layers,
+                                GError  **error);
 
 
 #endif  /* __XCF_LOAD_H__ */
@@ -23,6 +23,16 @@
 #define XCF_TILE_HEIGHT                 64
 #define XCF_TILE_MAX_DATA_LENGTH_FACTOR 1.5
 
+/* files written by incremental saves, the tile offsets of a level are
+ * no longer ascending because rewritten tiles are appended to the file
+ */
+#define XCF_INCREMENTAL_VERSION         13
+
+/* files using COMPRESS_ZLIB_PLANAR, which compressed high bit depth
+ * images get
+ */
+#define XCF_ZLIB_PLANAR_VERSION         14
+
 typedef enum
 {
   PROP_END                =  0,
@@ -63,7 +73,8 @@ typedef enum
   PROP_COMPOSITE_MODE     = 35,
   PROP_COMPOSITE_SPACE    = 36,
   PROP_BLEND_SPACE        = 37,
-  PROP_FLOAT_COLOR        = 38
+  PROP_FLOAT_COLOR        = 38,
+  PROP_PROJECTION         = 39
 } PropType;
 
 typedef enum
@@ -71,7 +82,8 @@ typedef enum
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
   COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_ZLIB_PLANAR       =  4   /* zlib on delta-coded byte planes */
 } XcfCompressionType;
 
 typedef enum
@@ -91,7 +103,8 @@ typedef enum
   XCF_GROUP_ITEM_EXPANDED      = 1
 } XcfGroupItemFlagsType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo       XcfInfo;
+typedef struct _XcfSaveState  XcfSaveState;
 
 struct _XcfInfo
 {
@@ -111,6 +124,14 @@ struct _XcfInfo
   goffset             floating_sel_offset;
   XcfCompressionType  compression;
   gint                file_version;
+  XcfSaveState       *save_state;
+  gboolean            append;
+  gboolean            save_previews;
+  goffset             projection_offset;
+  gboolean            defer_tiles;
+  GList              *deferred_levels;
+  GByteArray         *header;
+  GArray             *patches;
 };
 
 
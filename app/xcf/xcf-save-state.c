@@ -0,0 +1,511 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "gegl/gimp-gegl-tile-compat.h"
+
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+
+#include "xcf-private.h"
+#include "xcf-save-state.h"
+
+
+#define XCF_SAVE_STATE_KEY "gimp-xcf-save-state"
+
+#define XCF_SAVE_STATE_FILE_ATTRIBUTES   \
+  G_FILE_ATTRIBUTE_STANDARD_SIZE ","     \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED ","     \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+
+static void   xcf_save_state_free            (XcfSaveState        *state);
+static void   xcf_drawable_state_free        (XcfDrawableState    *dstate);
+static gint64 xcf_drawable_state_get_memsize (XcfDrawableState    *dstate);
+static void   xcf_save_state_add_memsize     (XcfSaveState        *state,
+                                              gint64               memsize);
+static void   xcf_drawable_state_weak_notify (XcfDrawableState    *dstate,
+                                              GObject             *where_the_object_was);
+static void   xcf_drawable_state_set_buffer  (XcfDrawableState    *dstate,
+                                              GeglBuffer          *buffer);
+static void   xcf_drawable_state_mark        (XcfDrawableState    *dstate,
+                                              const GeglRectangle *rect);
+static void   xcf_drawable_state_changed     (GeglBuffer          *buffer,
+                                              const GeglRectangle *rect,
+                                              XcfDrawableState    *dstate);
+static void   xcf_drawable_state_update      (GimpDrawable        *drawable,
+                                              gint                 x,
+                                              gint                 y,
+                                              gint                 width,
+                                              gint                 height,
+                                              XcfDrawableState    *dstate);
+static void   xcf_drawable_state_buffer      (GimpDrawable        *drawable,
+                                              const GParamSpec    *pspec,
+                                              XcfDrawableState    *dstate);
+
+
+/*  public functions  */
+
+XcfSaveState *
+xcf_save_state_new (GimpImage *image,
+                    GFile     *file)
+{
+  XcfSaveState *state;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  state = g_slice_new0 (XcfSaveState);
+
+  state->image     = image;
+  state->file      = g_object_ref (file);
+  state->drawables = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) xcf_drawable_state_free);
+
+  g_object_set_data_full (G_OBJECT (image), XCF_SAVE_STATE_KEY, state,
+                          (GDestroyNotify) xcf_save_state_free);
+
+  xcf_save_state_add_memsize (state, sizeof (XcfSaveState));
+
+  return state;
+}
+
+XcfSaveState *
+xcf_save_state_get (GimpImage *image,
+                    GFile     *file)
+{
+  XcfSaveState *state;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  state = g_object_get_data (G_OBJECT (image), XCF_SAVE_STATE_KEY);
+
+  if (state && g_file_equal (state->file, file))
+    return state;
+
+  return NULL;
+}
+
+void
+xcf_save_state_clear (GimpImage *image)
+{
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  g_object_set_data (G_OBJECT (image), XCF_SAVE_STATE_KEY, NULL);
+
+  gimp_image_set_xcf_save_memsize (image, 0);
+}
+
+/*  returns TRUE if the file on disk is still the one the last save
+ *  left behind
+ */
+gboolean
+xcf_save_state_is_current (XcfSaveState *state)
+{
+  GFileInfo *info;
+  gboolean   current;
+
+  g_return_val_if_fail (state != NULL, FALSE);
+
+  info = g_file_query_info (state->file, XCF_SAVE_STATE_FILE_ATTRIBUTES,
+                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  current =
+    (g_file_info_get_attribute_uint64 (info,
+                                       G_FILE_ATTRIBUTE_STANDARD_SIZE) ==
+     state->file_size &&
+     g_file_info_get_attribute_uint64 (info,
+                                       G_FILE_ATTRIBUTE_TIME_MODIFIED) ==
+     state->file_mtime &&
+     g_file_info_get_attribute_uint32 (info,
+                                       G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC) ==
+     state->file_mtime_usec);
+
+  g_object_unref (info);
+
+  return current;
+}
+
+/*  called when a save starts: takes the tiles changed since the last
+ *  save for the save to write, and starts tracking changes afresh, so
+ *  edits made while the main loop runs during the save are kept for
+ *  the next one
+ */
+void
+xcf_save_state_begin (XcfSaveState *state)
+{
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_return_if_fail (state != NULL);
+
+  g_mutex_lock (&state->mutex);
+
+  g_hash_table_iter_init (&iter, state->drawables);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      XcfDrawableState *dstate = value;
+
+      memcpy (dstate->pending_tiles, dstate->dirty_tiles, dstate->n_tiles);
+      memset (dstate->dirty_tiles, 0, dstate->n_tiles);
+    }
+
+  g_mutex_unlock (&state->mutex);
+}
+
+/*  called after a successful save: forgets drawables which are no
+ *  longer part of the file and remembers the file's identity
+ */
+gboolean
+xcf_save_state_finish (XcfSaveState *state)
+{
+  GFileInfo      *info;
+  GHashTableIter  iter;
+  gpointer        value;
+
+  g_return_val_if_fail (state != NULL, FALSE);
+
+  state->tile_bytes = 0;
+
+  g_hash_table_iter_init (&iter, state->drawables);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      XcfDrawableState *dstate = value;
+      gint              i;
+
+      if (! dstate->saved)
+        {
+          g_hash_table_iter_remove (&iter);
+          continue;
+        }
+
+      for (i = 0; i < dstate->n_tiles; i++)
+        state->tile_bytes += dstate->tile_sizes[i];
+
+      memset (dstate->pending_tiles, 0, dstate->n_tiles);
+      dstate->saved = FALSE;
+    }
+
+  info = g_file_query_info (state->file, XCF_SAVE_STATE_FILE_ATTRIBUTES,
+                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  state->file_size =
+    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  state->file_mtime =
+    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  state->file_mtime_usec =
+    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+/*  called after a failed save: gives the tiles the save was to write
+ *  back to the changes since the last save, and forgets the file's
+ *  identity, its tile tables may be half-updated and only a full save
+ *  can be trusted now
+ */
+void
+xcf_save_state_abort (XcfSaveState *state)
+{
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_return_if_fail (state != NULL);
+
+  g_mutex_lock (&state->mutex);
+
+  g_hash_table_iter_init (&iter, state->drawables);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      XcfDrawableState *dstate = value;
+      gint              i;
+
+      for (i = 0; i < dstate->n_tiles; i++)
+        dstate->dirty_tiles[i] |= dstate->pending_tiles[i];
+
+      memset (dstate->pending_tiles, 0, dstate->n_tiles);
+      dstate->saved = FALSE;
+    }
+
+  g_mutex_unlock (&state->mutex);
+
+  state->file_size       = 0;
+  state->file_mtime      = 0;
+  state->file_mtime_usec = 0;
+}
+
+XcfDrawableState *
+xcf_save_state_lookup (XcfSaveState *state,
+                       GimpDrawable *drawable)
+{
+  g_return_val_if_fail (state != NULL, NULL);
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  return g_hash_table_lookup (state->drawables, drawable);
+}
+
+/*  starts tracking 'drawable' whose tile hierarchy is about to be
+ *  written at 'hierarchy_offset', the caller fills in the tile
+ *  offsets and sizes
+ */
+XcfDrawableState *
+xcf_save_state_add_drawable (XcfSaveState *state,
+                             GimpDrawable *drawable,
+                             goffset       hierarchy_offset)
+{
+  XcfDrawableState *dstate;
+  GeglBuffer       *buffer;
+
+  g_return_val_if_fail (state != NULL, NULL);
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  g_hash_table_remove (state->drawables, drawable);
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  dstate = g_slice_new0 (XcfDrawableState);
+
+  dstate->state            = state;
+  dstate->drawable         = drawable;
+  dstate->format           = gegl_buffer_get_format (buffer);
+  dstate->width            = gegl_buffer_get_width (buffer);
+  dstate->height           = gegl_buffer_get_height (buffer);
+  dstate->hierarchy_offset = hierarchy_offset;
+  dstate->n_tiles          = (gimp_gegl_buffer_get_n_tile_rows (buffer,
+                                                                XCF_TILE_HEIGHT) *
+                              gimp_gegl_buffer_get_n_tile_cols (buffer,
+                                                                XCF_TILE_WIDTH));
+  dstate->tile_offsets     = g_new0 (goffset, dstate->n_tiles);
+  dstate->tile_sizes       = g_new0 (guint32, dstate->n_tiles);
+  dstate->dirty_tiles      = g_new0 (guint8,  dstate->n_tiles);
+  dstate->pending_tiles    = g_new0 (guint8,  dstate->n_tiles);
+  dstate->saved            = TRUE;
+
+  /*  not all writes to the buffer go through the drawable and emit
+   *  "update", e.g. gimp-drawable-set-pixel and plug-in tiles do
+   *  gegl_buffer_set() directly.  group layers render their buffer
+   *  from their children when it's read, so listen to both.
+   */
+  xcf_drawable_state_set_buffer (dstate, buffer);
+
+  dstate->update_id =
+    g_signal_connect (drawable, "update",
+                      G_CALLBACK (xcf_drawable_state_update),
+                      dstate);
+  dstate->buffer_id =
+    g_signal_connect (drawable, "notify::buffer",
+                      G_CALLBACK (xcf_drawable_state_buffer),
+                      dstate);
+
+  g_object_weak_ref (G_OBJECT (drawable),
+                     (GWeakNotify) xcf_drawable_state_weak_notify,
+                     dstate);
+
+  g_hash_table_insert (state->drawables, drawable, dstate);
+
+  xcf_save_state_add_memsize (state, xcf_drawable_state_get_memsize (dstate));
+
+  return dstate;
+}
+
+
+/*  private functions  */
+
+static void
+xcf_save_state_free (XcfSaveState *state)
+{
+  /*  the image may already be half-way through finalization here,
+   *  don't report the tables going away
+   */
+  state->image = NULL;
+
+  g_hash_table_unref (state->drawables);
+  g_object_unref (state->file);
+
+  g_mutex_clear (&state->mutex);
+
+  g_slice_free (XcfSaveState, state);
+}
+
+static void
+xcf_drawable_state_free (XcfDrawableState *dstate)
+{
+  if (dstate->drawable)
+    {
+      g_signal_handler_disconnect (dstate->drawable, dstate->update_id);
+      g_signal_handler_disconnect (dstate->drawable, dstate->buffer_id);
+
+      g_object_weak_unref (G_OBJECT (dstate->drawable),
+                           (GWeakNotify) xcf_drawable_state_weak_notify,
+                           dstate);
+    }
+
+  xcf_drawable_state_set_buffer (dstate, NULL);
+
+  xcf_save_state_add_memsize (dstate->state,
+                              - xcf_drawable_state_get_memsize (dstate));
+
+  g_free (dstate->tile_offsets);
+  g_free (dstate->tile_sizes);
+  g_free (dstate->dirty_tiles);
+  g_free (dstate->pending_tiles);
+
+  g_slice_free (XcfDrawableState, dstate);
+}
+
+static gint64
+xcf_drawable_state_get_memsize (XcfDrawableState *dstate)
+{
+  return (sizeof (XcfDrawableState) +
+          (gint64) dstate->n_tiles * (sizeof (goffset) +
+                                      sizeof (guint32) +
+                                      sizeof (guint8) * 2));
+}
+
+static void
+xcf_save_state_add_memsize (XcfSaveState *state,
+                            gint64        memsize)
+{
+  state->memsize += memsize;
+
+  if (state->image)
+    gimp_image_set_xcf_save_memsize (state->image, state->memsize);
+}
+
+static void
+xcf_drawable_state_weak_notify (XcfDrawableState *dstate,
+                                GObject          *where_the_object_was)
+{
+  dstate->drawable = NULL;
+
+  g_hash_table_remove (dstate->state->drawables, where_the_object_was);
+}
+
+static void
+xcf_drawable_state_set_buffer (XcfDrawableState *dstate,
+                               GeglBuffer       *buffer)
+{
+  if (buffer == dstate->buffer)
+    return;
+
+  if (dstate->buffer)
+    {
+      g_signal_handler_disconnect (dstate->buffer, dstate->changed_id);
+      g_clear_object (&dstate->buffer);
+    }
+
+  if (buffer)
+    {
+      dstate->buffer = g_object_ref (buffer);
+
+      dstate->changed_id =
+        gegl_buffer_signal_connect (buffer, "changed",
+                                    G_CALLBACK (xcf_drawable_state_changed),
+                                    dstate);
+    }
+}
+
+static void
+xcf_drawable_state_mark (XcfDrawableState    *dstate,
+                         const GeglRectangle *rect)
+{
+  GeglRectangle area;
+  gint          n_cols;
+  gint          col1, col2;
+  gint          row1, row2;
+  gint          row;
+
+  if (! gegl_rectangle_intersect (&area,
+                                  rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  dstate->width,
+                                                  dstate->height)))
+    return;
+
+  n_cols = (dstate->width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  col1 = area.x / XCF_TILE_WIDTH;
+  col2 = (area.x + area.width - 1) / XCF_TILE_WIDTH;
+  row1 = area.y / XCF_TILE_HEIGHT;
+  row2 = (area.y + area.height - 1) / XCF_TILE_HEIGHT;
+
+  g_mutex_lock (&dstate->state->mutex);
+
+  for (row = row1; row <= row2; row++)
+    memset (dstate->dirty_tiles + row * n_cols + col1, 1, col2 - col1 + 1);
+
+  g_mutex_unlock (&dstate->state->mutex);
+}
+
+/*  may be called from any thread writing to the buffer  */
+static void
+xcf_drawable_state_changed (GeglBuffer          *buffer,
+                            const GeglRectangle *rect,
+                            XcfDrawableState    *dstate)
+{
+  if (! rect)
+    rect = gegl_buffer_get_extent (buffer);
+
+  xcf_drawable_state_mark (dstate, rect);
+}
+
+static void
+xcf_drawable_state_update (GimpDrawable     *drawable,
+                           gint              x,
+                           gint              y,
+                           gint              width,
+                           gint              height,
+                           XcfDrawableState *dstate)
+{
+  xcf_drawable_state_mark (dstate, GEGL_RECTANGLE (x, y, width, height));
+}
+
+static void
+xcf_drawable_state_buffer (GimpDrawable     *drawable,
+                           const GParamSpec *pspec,
+                           XcfDrawableState *dstate)
+{
+  xcf_drawable_state_set_buffer (dstate, gimp_drawable_get_buffer (drawable));
+
+  g_mutex_lock (&dstate->state->mutex);
+
+  memset (dstate->dirty_tiles, 1, dstate->n_tiles);
+
+  g_mutex_unlock (&dstate->state->mutex);
+}
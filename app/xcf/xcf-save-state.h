@@ -0,0 +1,93 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __XCF_SAVE_STATE_H__
+#define __XCF_SAVE_STATE_H__
+
+
+typedef struct _XcfDrawableState XcfDrawableState;
+
+/*  what the last save left in the file for one drawable, which of its
+ *  tiles have been touched since, and which of those the save in
+ *  progress is writing
+ */
+struct _XcfDrawableState
+{
+  XcfSaveState *state;
+  GimpDrawable *drawable;
+  GeglBuffer   *buffer;
+  gulong        update_id;
+  gulong        buffer_id;
+  gulong        changed_id;
+
+  const Babl   *format;
+  gint          width;
+  gint          height;
+
+  goffset       hierarchy_offset;
+  goffset       tile_table_offset;
+  gint          n_tiles;
+  goffset      *tile_offsets;
+  guint32      *tile_sizes;
+  guint8       *dirty_tiles;
+  guint8       *pending_tiles;
+
+  gboolean      saved;
+};
+
+/*  what the last save left in the file for a whole image
+ */
+struct _XcfSaveState
+{
+  GimpImage          *image;
+  GFile              *file;
+  guint64             file_size;
+  guint64             file_mtime;
+  guint32             file_mtime_usec;
+
+  gint                bytes_per_offset;
+  XcfCompressionType  compression;
+  goffset             header_size;
+  guint64             tile_bytes;
+
+  GHashTable         *drawables;
+  gint64              memsize;
+
+  /*  buffers report changes from any thread  */
+  GMutex              mutex;
+};
+
+
+XcfSaveState     * xcf_save_state_new          (GimpImage     *image,
+                                                GFile         *file);
+XcfSaveState     * xcf_save_state_get          (GimpImage     *image,
+                                                GFile         *file);
+void               xcf_save_state_clear        (GimpImage     *image);
+
+gboolean           xcf_save_state_is_current   (XcfSaveState  *state);
+void               xcf_save_state_begin        (XcfSaveState  *state);
+gboolean           xcf_save_state_finish       (XcfSaveState  *state);
+void               xcf_save_state_abort        (XcfSaveState  *state);
+
+XcfDrawableState * xcf_save_state_lookup       (XcfSaveState  *state,
+                                                GimpDrawable  *drawable);
+XcfDrawableState * xcf_save_state_add_drawable (XcfSaveState  *state,
+                                                GimpDrawable  *drawable,
+                                                goffset        hierarchy_offset);
+
+
+#endif  /* __XCF_SAVE_STATE_H__ */
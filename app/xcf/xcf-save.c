@@ -17,18 +17,30 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
 #include <zlib.h>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#ifndef G_OS_WIN32
+#include <gio/gfiledescriptorbased.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "gegl/gimp-babl.h"
 #include "gegl/gimp-babl-compat.h"
 #include "gegl/gimp-gegl-tile-compat.h"
 
@@ -48,7 +60,9 @@
 #include "core/gimplayer.h"
 #include "core/gimplayermask.h"
 #include "core/gimpparasitelist.h"
+#include "core/gimppickable.h"
 #include "core/gimpprogress.h"
+#include "core/gimpprojection.h"
 #include "core/gimpsamplepoint.h"
 
 #include "operations/layer-modes/gimp-layer-modes.h"
@@ -65,12 +79,52 @@
 #include "xcf-private.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
+#include "xcf-save-state.h"
 #include "xcf-seek.h"
+#include "xcf-utils.h"
 #include "xcf-write.h"
 
 #include "gimp-intl.h"
 
 
+/* a level whose tile offset table has been written but whose tiles
+ * are left for xcf_save_image_tiles()
+ */
+typedef struct
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  gint        level;
+  goffset     tile_table_offset;
+} XcfDeferredLevel;
+
+/* an offset which an incremental save writes into the existing data
+ * of the file, once everything it appended is on disk
+ */
+typedef struct
+{
+  goffset position;
+  goffset offset;
+} XcfOffsetPatch;
+
+
+static gboolean xcf_save_image_header  (XcfInfo           *info,
+                                        GimpImage         *image,
+                                        GError           **error);
+static gboolean xcf_save_image_header_to_memory
+                                       (XcfInfo           *info,
+                                        GimpImage         *image,
+                                        guint              n_offsets,
+                                        GError           **error);
+static gboolean xcf_save_image_commit  (XcfInfo           *info,
+                                        GError           **error);
+static gboolean xcf_save_offsets       (XcfInfo           *info,
+                                        goffset            position,
+                                        const goffset     *offsets,
+                                        gint               count,
+                                        GError           **error);
+static gboolean xcf_save_sync          (XcfInfo           *info,
+                                        GError           **error);
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -95,11 +149,59 @@ static gboolean xcf_save_channel       (XcfInfo           *info,
                                         GimpImage         *image,
                                         GimpChannel       *channel,
                                         GError           **error);
+static goffset  xcf_save_hierarchy_offset
+                                       (XcfInfo           *info,
+                                        GimpDrawable      *drawable,
+                                        gint               n_offsets);
+static XcfDrawableState * xcf_save_get_reusable_state
+                                       (XcfInfo           *info,
+                                        GimpDrawable      *drawable);
 static gboolean xcf_save_buffer        (XcfInfo           *info,
+                                        GimpDrawable      *drawable,
+                                        GError           **error);
+static gboolean xcf_save_projection    (XcfInfo           *info,
+                                        GimpImage         *image,
+                                        GError           **error);
+static gboolean xcf_save_hierarchy     (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        const Babl        *format,
+                                        gboolean           base_level,
+                                        XcfDrawableState  *dstate,
+                                        GError           **error);
+static gboolean xcf_save_reduced_levels
+                                       (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        XcfDrawableState  *dstate,
+                                        GError           **error);
+static gboolean xcf_save_level_reduced (XcfInfo           *info,
                                         GeglBuffer        *buffer,
+                                        const Babl        *format,
+                                        gint               level,
+                                        GError           **error);
+static GeglBuffer * xcf_save_reduce_buffer
+                                       (GeglBuffer        *buffer,
+                                        const Babl        *format,
+                                        gint               level);
+static gboolean xcf_save_level_deferred
+                                       (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        const Babl        *format,
+                                        gint               level,
                                         GError           **error);
+static void     xcf_deferred_level_free (XcfDeferredLevel *deferred);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         GeglBuffer        *buffer,
+                                        XcfDrawableState  *dstate,
+                                        GError           **error);
+static gboolean xcf_save_level_dirty   (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        XcfDrawableState  *dstate,
+                                        GError           **error);
+static gboolean xcf_save_level_tile    (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        GeglRectangle     *tile_rect,
+                                        const Babl        *format,
+                                        guchar            *rlebuf,
                                         GError           **error);
 static gboolean xcf_save_tile          (XcfInfo           *info,
                                         GeglBuffer        *buffer,
@@ -214,6 +316,12 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
   } G_STMT_END
 
 
+/* the minimal room left for the image header to grow into when
+ * incremental saves are possible
+ */
+#define XCF_SAVE_HEADER_RESERVE (16 * 1024)
+
+
 gboolean
 xcf_save_image (XcfInfo    *info,
                 GimpImage  *image,
@@ -224,11 +332,359 @@ xcf_save_image (XcfInfo    *info,
   GList   *list;
   goffset  saved_pos;
   goffset  offset;
-  guint32  value;
   guint    n_layers;
   guint    n_channels;
   guint    progress = 0;
   guint    max_progress;
+  GError  *tmp_error = NULL;
+
+  /* determine the number of layers and channels in the image */
+  all_layers   = gimp_image_get_layer_list (image);
+  all_channels = gimp_image_get_channel_list (image);
+
+  /* check and see if we have to save out the selection */
+  if (! gimp_channel_is_empty (gimp_image_get_mask (image)))
+    {
+      all_channels = g_list_append (all_channels, gimp_image_get_mask (image));
+    }
+
+  n_layers   = (guint) g_list_length (all_layers);
+  n_channels = (guint) g_list_length (all_channels);
+
+  max_progress = 1 + n_layers + n_channels;
+
+  if (info->append)
+    {
+      /* an incremental save must not touch the existing data of the
+       * file before everything new is on disk, so the image header and
+       * offset table go to memory for now, and are written by
+       * xcf_save_image_commit() at the very end
+       */
+      xcf_check_error (xcf_save_image_header_to_memory (info, image,
+                                                        n_layers +
+                                                        n_channels + 2,
+                                                        error));
+
+      info->patches = g_array_new (FALSE, FALSE, sizeof (XcfOffsetPatch));
+    }
+  else
+    {
+      /* write the image header and the property information for the
+       * image
+       */
+      xcf_check_error (xcf_save_image_header (info, image, error));
+    }
+
+  xcf_progress_update (info);
+
+  /* 'saved_pos' is the next slot in the offset table */
+  if (info->append)
+    {
+      /* the empty offset table ends the header in memory */
+      saved_pos = info->header->len -
+                  (n_layers + n_channels + 2) * info->bytes_per_offset;
+    }
+  else
+    {
+      saved_pos = info->cp;
+
+      /* write an empty offset table */
+      xcf_write_zero_offset_check_error (info, n_layers + n_channels + 2);
+    }
+
+  if (info->save_state && ! info->append)
+    {
+      /* leave room for the header to grow, so incremental saves can
+       * rewrite it in place
+       */
+      goffset reserve = MAX (info->cp, XCF_SAVE_HEADER_RESERVE);
+
+      xcf_write_zero_offset_check_error (info,
+                                         reserve / info->bytes_per_offset);
+
+      info->save_state->header_size = info->cp;
+    }
+
+  /* 'offset' is where we will write the next layer or channel, when
+   * saving incrementally that's the end of the existing file
+   */
+  if (info->append)
+    offset = info->save_state->file_size;
+  else
+    offset = info->cp;
+
+  for (list = all_layers; list; list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      /* fill in the next slot in the offset table with the offset of
+       * the layer
+       */
+      xcf_check_error (xcf_save_offsets (info, saved_pos, &offset, 1, error));
+
+      /* remember the next slot in the offset table */
+      saved_pos += info->bytes_per_offset;
+
+      /* seek to the layer offset and save the layer */
+      xcf_check_error (xcf_seek_pos (info, offset, error));
+      xcf_check_error (xcf_save_layer (info, image, layer, error));
+
+      /* the next layer's offset is after the layer we just wrote */
+      offset = info->cp;
+
+      xcf_progress_update (info);
+    }
+
+  /* skip a '0' in the offset table to indicate the end of the layer
+   * offsets
+   */
+  saved_pos += info->bytes_per_offset;
+
+  for (list = all_channels; list; list = g_list_next (list))
+    {
+      GimpChannel *channel = list->data;
+
+      /* fill in the next slot in the offset table with the offset of
+       * the channel
+       */
+      xcf_check_error (xcf_save_offsets (info, saved_pos, &offset, 1, error));
+
+      /* remember the next slot in the offset table */
+      saved_pos += info->bytes_per_offset;
+
+      /* seek to the channel offset and save the channel */
+      xcf_check_error (xcf_seek_pos (info, offset, error));
+      xcf_check_error (xcf_save_channel (info, image, channel, error));
+
+      /* the next channels's offset is after the channel we just wrote */
+      offset = info->cp;
+
+      xcf_progress_update (info);
+    }
+
+  /* there is already a '0' at the end of the offset table to indicate
+   * the end of the channel offsets
+   */
+
+  if (info->save_previews)
+    {
+      /* write the reduced levels of the projection after everything
+       * else and fill in the offset reserved in the image properties
+       */
+      xcf_check_error (xcf_save_offsets (info, info->projection_offset,
+                                         &offset, 1, error));
+
+      xcf_check_error (xcf_seek_pos (info, offset, error));
+      xcf_check_error (xcf_save_projection (info, image, error));
+    }
+
+  if (info->append)
+    xcf_check_error (xcf_save_image_commit (info, error));
+
+  g_list_free (all_layers);
+  g_list_free (all_channels);
+
+  return ! g_output_stream_is_closed (info->output);
+}
+
+/*  returns the tile compression to use for 'image'.  high bit depth
+ *  images may compress better, and faster, after splitting them into
+ *  delta-coded byte planes, but no released 2.10 reads those files, so
+ *  they are only written when GIMP_XCF_ENABLE_PLANAR is set, until
+ *  the "xcf" benchmark group shows they are worth it.
+ */
+XcfCompressionType
+xcf_save_image_compression (GimpImage *image)
+{
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), COMPRESS_RLE);
+
+  if (! gimp_image_get_xcf_compression (image))
+    return COMPRESS_RLE;
+
+  if (gimp_image_get_precision (image) > GIMP_PRECISION_U8_GAMMA &&
+      g_getenv ("GIMP_XCF_ENABLE_PLANAR"))
+    return COMPRESS_ZLIB_PLANAR;
+
+  return COMPRESS_ZLIB;
+}
+
+/*  returns TRUE if 'image' can be saved incrementally into the file
+ *  described by 'state', appending only the tiles changed since the
+ *  last save.  this is not the case if the file changed on disk, if
+ *  it was saved with different compression or 32 bit offsets, if
+ *  more than half of it is unused, or if the image header outgrew
+ *  the room reserved for it.
+ */
+gboolean
+xcf_save_image_can_append (Gimp         *gimp,
+                           GimpImage    *image,
+                           XcfSaveState *state)
+{
+  XcfInfo        info = { 0, };
+  GOutputStream *output;
+  GList         *all_layers;
+  GList         *all_channels;
+  guint          n_items;
+  gboolean       success;
+
+  if (state->bytes_per_offset != 8)
+    return FALSE;
+
+  info.compression = xcf_save_image_compression (image);
+
+  if (info.compression != state->compression)
+    return FALSE;
+
+  if (state->file_size - state->tile_bytes > state->tile_bytes)
+    return FALSE;
+
+  if (! xcf_save_state_is_current (state))
+    return FALSE;
+
+  all_layers   = gimp_image_get_layer_list (image);
+  all_channels = gimp_image_get_channel_list (image);
+
+  n_items = g_list_length (all_layers) + g_list_length (all_channels);
+
+  if (! gimp_channel_is_empty (gimp_image_get_mask (image)))
+    n_items++;
+
+  g_list_free (all_layers);
+  g_list_free (all_channels);
+
+  /* write the header to memory to see if it still fits */
+  output = g_memory_output_stream_new_resizable ();
+
+  info.gimp             = gimp;
+  info.output           = output;
+  info.seekable         = G_SEEKABLE (output);
+  info.bytes_per_offset = state->bytes_per_offset;
+  info.file_version     = XCF_INCREMENTAL_VERSION;
+  info.save_previews    = gimp->config->xcf_save_previews;
+
+  success = xcf_save_image_header (&info, image, NULL);
+
+  g_object_unref (output);
+
+  return (success &&
+          info.cp + (n_items + 2) * info.bytes_per_offset <= state->header_size);
+}
+
+/*  writes the tiles of all levels which xcf_save_image() deferred, and
+ *  fills in their tile offset tables.  the levels were recorded as
+ *  copy-on-write duplicates, so this can run in a thread while the
+ *  image is being edited.  'n_saved' is atomically incremented after
+ *  each level.
+ */
+gboolean
+xcf_save_image_tiles (XcfInfo  *info,
+                      gint     *n_saved,
+                      GError  **error)
+{
+  GList    *list;
+  gboolean  success = TRUE;
+
+  info->deferred_levels = g_list_reverse (info->deferred_levels);
+
+  for (list = info->deferred_levels; list && success; list = g_list_next (list))
+    {
+      XcfDeferredLevel *deferred = list->data;
+      GeglBuffer       *buffer;
+      goffset          *offset_table;
+      goffset           max_data_length;
+      guchar           *rlebuf = NULL;
+      gint              ntiles;
+      gint              i;
+
+      if (deferred->level > 0)
+        buffer = xcf_save_reduce_buffer (deferred->buffer, deferred->format,
+                                         deferred->level);
+      else
+        buffer = g_object_ref (deferred->buffer);
+
+      max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT *
+                        babl_format_get_bytes_per_pixel (deferred->format) *
+                        XCF_TILE_MAX_DATA_LENGTH_FACTOR;
+
+      if (info->compression == COMPRESS_RLE)
+        rlebuf = g_malloc (max_data_length);
+
+      ntiles = (gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT) *
+                gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH));
+
+      offset_table = g_new0 (goffset, ntiles);
+
+      /* the tiles are appended at the end of the file */
+      for (i = 0; i < ntiles && success; i++)
+        {
+          GeglRectangle rect;
+
+          offset_table[i] = info->cp;
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i, &rect);
+
+          success = xcf_save_level_tile (info, buffer, &rect,
+                                         deferred->format, rlebuf, error);
+        }
+
+      if (success)
+        {
+          goffset  offset    = info->cp;
+          GError  *tmp_error = NULL;
+
+          /* the table already has its terminating zero */
+          success = xcf_seek_pos (info, deferred->tile_table_offset, error);
+
+          if (success)
+            {
+              xcf_write_offset (info, offset_table, ntiles, &tmp_error);
+
+              if (tmp_error)
+                {
+                  g_propagate_error (error, tmp_error);
+                  success = FALSE;
+                }
+            }
+
+          if (success)
+            success = xcf_seek_pos (info, offset, error);
+        }
+
+      g_free (offset_table);
+      g_free (rlebuf);
+      g_object_unref (buffer);
+
+      g_atomic_int_inc (n_saved);
+    }
+
+  xcf_save_image_clear_tiles (info);
+
+  return success;
+}
+
+/*  drops the levels deferred by xcf_save_image(), and the header and
+ *  offsets of an incremental save, without writing them, for when
+ *  saving the rest of the image failed
+ */
+void
+xcf_save_image_clear_tiles (XcfInfo *info)
+{
+  g_list_free_full (info->deferred_levels,
+                    (GDestroyNotify) xcf_deferred_level_free);
+  info->deferred_levels = NULL;
+
+  g_clear_pointer (&info->header, g_byte_array_unref);
+  g_clear_pointer (&info->patches, g_array_unref);
+}
+
+static gboolean
+xcf_save_image_header (XcfInfo    *info,
+                       GimpImage  *image,
+                       GError    **error)
+{
+  guint32  value;
   gchar    version_tag[16];
   GError  *tmp_error = NULL;
 
@@ -260,94 +716,178 @@ xcf_save_image (XcfInfo    *info,
       xcf_write_int32_check_error (info, &value, 1);
     }
 
-  /* determine the number of layers and channels in the image */
-  all_layers   = gimp_image_get_layer_list (image);
-  all_channels = gimp_image_get_channel_list (image);
+  /* write the property information for the image */
+  xcf_check_error (xcf_save_image_props (info, image, error));
 
-  /* check and see if we have to save out the selection */
-  if (! gimp_channel_is_empty (gimp_image_get_mask (image)))
+  return TRUE;
+}
+
+/* writes the image header followed by an empty offset table of
+ * 'n_offsets' offsets to info->header instead of the file
+ */
+static gboolean
+xcf_save_image_header_to_memory (XcfInfo    *info,
+                                 GimpImage  *image,
+                                 guint       n_offsets,
+                                 GError    **error)
+{
+  XcfInfo        header_info = *info;
+  GOutputStream *output;
+  gboolean       success;
+  GError        *tmp_error   = NULL;
+
+  output = g_memory_output_stream_new_resizable ();
+
+  header_info.output   = output;
+  header_info.seekable = G_SEEKABLE (output);
+  header_info.cp       = 0;
+
+  success = xcf_save_image_header (&header_info, image, error);
+
+  if (success)
     {
-      all_channels = g_list_append (all_channels, gimp_image_get_mask (image));
+      xcf_write_zero_offset (&header_info, n_offsets, &tmp_error);
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          success = FALSE;
+        }
     }
 
-  n_layers   = (guint) g_list_length (all_layers);
-  n_channels = (guint) g_list_length (all_channels);
+  if (success)
+    success = g_output_stream_close (output, NULL, error);
 
-  max_progress = 1 + n_layers + n_channels;
+  if (success)
+    {
+      GMemoryOutputStream *memory = G_MEMORY_OUTPUT_STREAM (output);
+      gsize                size;
+      guint8              *data;
 
-  /* write the property information for the image */
-  xcf_check_error (xcf_save_image_props (info, image, error));
+      size = g_memory_output_stream_get_data_size (memory);
+      data = g_memory_output_stream_steal_data (memory);
 
-  xcf_progress_update (info);
+      info->header = g_byte_array_new_take (data, size);
 
-  /* 'saved_pos' is the next slot in the offset table */
-  saved_pos = info->cp;
+      info->projection_offset = header_info.projection_offset;
+    }
 
-  /* write an empty offset table */
-  xcf_write_zero_offset_check_error (info, n_layers + n_channels + 2);
+  g_object_unref (output);
 
-  /* 'offset' is where we will write the next layer or channel */
-  offset = info->cp;
+  return success;
+}
 
-  for (list = all_layers; list; list = g_list_next (list))
+/* finishes an incremental save: once everything appended is on disk,
+ * rewrites the tile offset tables of the reused hierarchies, and then
+ * the image header and offset table.  until the header is written the
+ * file still describes the last saved image, so a crash or an error
+ * before leaves it intact.
+ */
+static gboolean
+xcf_save_image_commit (XcfInfo  *info,
+                       GError  **error)
+{
+  goffset  end = info->cp;
+  guint    i;
+  GError  *tmp_error = NULL;
+
+  xcf_check_error (xcf_save_sync (info, error));
+
+  for (i = 0; i < info->patches->len; i++)
     {
-      GimpLayer *layer = list->data;
+      XcfOffsetPatch *patch = &g_array_index (info->patches,
+                                              XcfOffsetPatch, i);
 
-      /* seek back to the next slot in the offset table and write the
-       * offset of the layer
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_offset_check_error (info, &offset, 1);
+      xcf_check_error (xcf_seek_pos (info, patch->position, error));
+      xcf_write_offset_check_error (info, &patch->offset, 1);
+    }
 
-      /* remember the next slot in the offset table */
-      saved_pos = info->cp;
+  xcf_check_error (xcf_save_sync (info, error));
 
-      /* seek to the layer offset and save the layer */
-      xcf_check_error (xcf_seek_pos (info, offset, error));
-      xcf_check_error (xcf_save_layer (info, image, layer, error));
+  xcf_check_error (xcf_seek_pos (info, 0, error));
+  xcf_write_int8_check_error (info, info->header->data, info->header->len);
 
-      /* the next layer's offset is after the layer we just wrote */
-      offset = info->cp;
+  xcf_check_error (xcf_seek_pos (info, end, error));
 
-      xcf_progress_update (info);
-    }
+  g_clear_pointer (&info->header, g_byte_array_unref);
+  g_clear_pointer (&info->patches, g_array_unref);
 
-  /* skip a '0' in the offset table to indicate the end of the layer
-   * offsets
-   */
-  saved_pos += info->bytes_per_offset;
+  return TRUE;
+}
+
+/* writes 'count' offsets at 'position'.  an incremental save writes
+ * them to the header in memory, or remembers them for
+ * xcf_save_image_commit() if they go to the existing data of the file.
+ */
+static gboolean
+xcf_save_offsets (XcfInfo        *info,
+                  goffset         position,
+                  const goffset  *offsets,
+                  gint            count,
+                  GError        **error)
+{
+  GError *tmp_error = NULL;
+  gint    i;
+
+  if (info->header &&
+      position + count * info->bytes_per_offset <= info->header->len)
+    {
+      /* incremental saves always use 64 bit offsets */
+      for (i = 0; i < count; i++)
+        {
+          guint64 offset = GUINT64_TO_BE (offsets[i]);
 
-  for (list = all_channels; list; list = g_list_next (list))
+          memcpy (info->header->data + position + i * sizeof (guint64),
+                  &offset, sizeof (guint64));
+        }
+    }
+  else if (info->append)
     {
-      GimpChannel *channel = list->data;
+      for (i = 0; i < count; i++)
+        {
+          XcfOffsetPatch patch;
 
-      /* seek back to the next slot in the offset table and write the
-       * offset of the channel
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_offset_check_error (info, &offset, 1);
+          patch.position = position + i * info->bytes_per_offset;
+          patch.offset   = offsets[i];
 
-      /* remember the next slot in the offset table */
-      saved_pos = info->cp;
+          g_array_append_val (info->patches, patch);
+        }
+    }
+  else
+    {
+      xcf_check_error (xcf_seek_pos (info, position, error));
+      xcf_write_offset_check_error (info, offsets, count);
+    }
 
-      /* seek to the channel offset and save the channel */
-      xcf_check_error (xcf_seek_pos (info, offset, error));
-      xcf_check_error (xcf_save_channel (info, image, channel, error));
+  return TRUE;
+}
 
-      /* the next channels's offset is after the channel we just wrote */
-      offset = info->cp;
+/* makes sure everything written so far is on disk */
+static gboolean
+xcf_save_sync (XcfInfo  *info,
+               GError  **error)
+{
+  if (! g_output_stream_flush (info->output, NULL, error))
+    return FALSE;
 
-      xcf_progress_update (info);
-    }
+#ifndef G_OS_WIN32
+  if (G_IS_FILE_DESCRIPTOR_BASED (info->output))
+    {
+      GFileDescriptorBased *based = G_FILE_DESCRIPTOR_BASED (info->output);
 
-  /* there is already a '0' at the end of the offset table to indicate
-   * the end of the channel offsets
-   */
+      if (fsync (g_file_descriptor_based_get_fd (based)) != 0)
+        {
+          gint errsv = errno;
 
-  g_list_free (all_layers);
-  g_list_free (all_channels);
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                       _("Could not sync XCF file: %s"),
+                       g_strerror (errsv));
+          return FALSE;
+        }
+    }
+#endif
 
-  return ! g_output_stream_is_closed (info->output);
+  return TRUE;
 }
 
 static gboolean
@@ -448,6 +988,9 @@ xcf_save_image_props (XcfInfo    *info,
       gimp_parasite_free (meta_parasite);
     }
 
+  if (info->save_previews)
+    xcf_check_error (xcf_save_prop (info, image, PROP_PROJECTION, error));
+
   xcf_check_error (xcf_save_prop (info, image, PROP_END, error));
 
   return TRUE;
@@ -1277,6 +1820,16 @@ xcf_save_prop (XcfInfo    *info,
         xcf_write_int32_check_error (info, &flags, 1);
       }
       break;
+
+    case PROP_PROJECTION:
+      size = info->bytes_per_offset;
+
+      xcf_write_prop_type_check_error (info, prop_type);
+      xcf_write_int32_check_error (info, &size, 1);
+
+      info->projection_offset = info->cp;
+      xcf_write_zero_offset_check_error (info, 1);
+      break;
     }
 
   va_end (args);
@@ -1325,7 +1878,7 @@ xcf_save_layer (XcfInfo    *info,
   xcf_save_layer_props (info, image, layer, error);
 
   /* write out the layer tile hierarchy */
-  offset = info->cp + 2 * info->bytes_per_offset;
+  offset = xcf_save_hierarchy_offset (info, GIMP_DRAWABLE (layer), 2);
   xcf_write_offset_check_error (info, &offset, 1);
 
   saved_pos = info->cp;
@@ -1333,9 +1886,7 @@ xcf_save_layer (XcfInfo    *info,
   /* write a zero layer mask offset */
   xcf_write_zero_offset_check_error (info, 1);
 
-  xcf_check_error (xcf_save_buffer (info,
-                                    gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                    error));
+  xcf_check_error (xcf_save_buffer (info, GIMP_DRAWABLE (layer), error));
 
   offset = info->cp;
 
@@ -1393,12 +1944,10 @@ xcf_save_channel (XcfInfo      *info,
   xcf_save_channel_props (info, image, channel, error);
 
   /* write out the channel tile hierarchy */
-  offset = info->cp + info->bytes_per_offset;
+  offset = xcf_save_hierarchy_offset (info, GIMP_DRAWABLE (channel), 1);
   xcf_write_offset_check_error (info, &offset, 1);
 
-  xcf_check_error (xcf_save_buffer (info,
-                                    gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
-                                    error));
+  xcf_check_error (xcf_save_buffer (info, GIMP_DRAWABLE (channel), error));
 
   return TRUE;
 }
@@ -1419,25 +1968,136 @@ xcf_calc_levels (gint size,
   return levels;
 }
 
+/* returns the offset of the drawable's tile hierarchy: the one already
+ * in the file if it can be reused, or the position right after the
+ * 'n_offsets' offsets which are about to be written
+ */
+static goffset
+xcf_save_hierarchy_offset (XcfInfo      *info,
+                           GimpDrawable *drawable,
+                           gint          n_offsets)
+{
+  XcfDrawableState *dstate = xcf_save_get_reusable_state (info, drawable);
+
+  if (dstate)
+    return dstate->hierarchy_offset;
+
+  return info->cp + n_offsets * info->bytes_per_offset;
+}
+
+/* the tile hierarchy of the last save can be reused by an incremental
+ * save as long as the drawable's size and format did not change
+ */
+static XcfDrawableState *
+xcf_save_get_reusable_state (XcfInfo      *info,
+                             GimpDrawable *drawable)
+{
+  XcfDrawableState *dstate;
+  GeglBuffer       *buffer;
+
+  if (! info->append)
+    return NULL;
+
+  dstate = xcf_save_state_lookup (info->save_state, drawable);
+
+  if (! dstate)
+    return NULL;
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  if (gegl_buffer_get_width (buffer)  != dstate->width  ||
+      gegl_buffer_get_height (buffer) != dstate->height ||
+      gegl_buffer_get_format (buffer) != dstate->format)
+    return NULL;
+
+  return dstate;
+}
+
+static gboolean
+xcf_save_buffer (XcfInfo       *info,
+                 GimpDrawable  *drawable,
+                 GError       **error)
+{
+  GeglBuffer       *buffer = gimp_drawable_get_buffer (drawable);
+  XcfDrawableState *dstate = NULL;
+
+  if (info->save_state)
+    {
+      dstate = xcf_save_get_reusable_state (info, drawable);
+
+      if (dstate)
+        {
+          /* only write the tiles which changed since the last save */
+          gboolean dirty = (memchr (dstate->pending_tiles, 1,
+                                    dstate->n_tiles) != NULL);
+
+          dstate->saved = TRUE;
+
+          xcf_check_error (xcf_save_level_dirty (info, buffer, dstate, error));
+
+          /* the reduced levels are outdated as soon as any tile changed */
+          if (dirty)
+            xcf_check_error (xcf_save_reduced_levels (info, buffer, dstate,
+                                                      error));
+
+          return TRUE;
+        }
+
+      dstate = xcf_save_state_add_drawable (info->save_state, drawable,
+                                            info->cp);
+    }
+
+  return xcf_save_hierarchy (info, buffer, gegl_buffer_get_format (buffer),
+                             TRUE, dstate, error);
+}
+
+/* the projection is saved as a hierarchy in 8 bit gamma RGBA or GRAYA
+ * whose first level is empty, only the reduced levels are used for
+ * previews
+ */
+static gboolean
+xcf_save_projection (XcfInfo    *info,
+                     GimpImage  *image,
+                     GError    **error)
+{
+  GimpPickable *pickable = GIMP_PICKABLE (gimp_image_get_projection (image));
+  const Babl   *format;
+
+  if (gimp_image_get_base_type (image) == GIMP_GRAY)
+    format = gimp_babl_format (GIMP_GRAY, GIMP_PRECISION_U8_GAMMA, TRUE);
+  else
+    format = gimp_babl_format (GIMP_RGB, GIMP_PRECISION_U8_GAMMA, TRUE);
+
+  gimp_pickable_flush (pickable);
 
+  return xcf_save_hierarchy (info, gimp_pickable_get_buffer (pickable),
+                             format, FALSE, NULL, error);
+}
+
+/* writes the tile hierarchy of 'buffer' in 'format', the first level
+ * is left empty unless 'base_level' is TRUE, in which case 'format'
+ * must be the buffer's format.  with 'dstate' given, the first level's
+ * tiles are recorded for incremental saves.
+ */
 static gboolean
-xcf_save_buffer (XcfInfo     *info,
-                 GeglBuffer  *buffer,
-                 GError     **error)
+xcf_save_hierarchy (XcfInfo           *info,
+                    GeglBuffer        *buffer,
+                    const Babl        *format,
+                    gboolean           base_level,
+                    XcfDrawableState  *dstate,
+                    GError           **error)
 {
-  const Babl *format;
   goffset     saved_pos;
   goffset     offset;
   guint32     width;
   guint32     height;
   guint32     bpp;
+  gboolean    reduced;
   gint        i;
   gint        nlevels;
   gint        tmp1, tmp2;
   GError     *tmp_error = NULL;
 
-  format = gegl_buffer_get_format (buffer);
-
   width  = gegl_buffer_get_width (buffer);
   height = gegl_buffer_get_height (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -1450,6 +2110,9 @@ xcf_save_buffer (XcfInfo     *info,
   tmp2 = xcf_calc_levels (height, XCF_TILE_HEIGHT);
   nlevels = MAX (tmp1, tmp2);
 
+  /* downscaling indices of indexed images doesn't make sense */
+  reduced = info->save_previews && ! babl_format_is_palette (format);
+
   /* 'saved_pos' is the next slot in the offset table */
   saved_pos = info->cp;
 
@@ -1473,20 +2136,32 @@ xcf_save_buffer (XcfInfo     *info,
       /* seek to the level offset and save the level */
       xcf_check_error (xcf_seek_pos (info, offset, error));
 
-      if (i == 0)
+      if (info->defer_tiles && ((i == 0 && base_level) || (i > 0 && reduced)))
+        {
+          /* only write the level's tile offset table for now */
+          xcf_check_error (xcf_save_level_deferred (info, buffer, format, i,
+                                                    error));
+        }
+      else if (i == 0 && base_level)
         {
           /* write out the level. */
-          xcf_check_error (xcf_save_level (info, buffer, error));
+          xcf_check_error (xcf_save_level (info, buffer, dstate, error));
+        }
+      else if (i > 0 && reduced)
+        {
+          /* write out a downscaled level */
+          xcf_check_error (xcf_save_level_reduced (info, buffer, format, i,
+                                                   error));
         }
       else
         {
           /* fake an empty level */
           tmp1 = 0;
-          width  /= 2;
-          height /= 2;
-          xcf_write_int32_check_error (info, (guint32 *) &width,  1);
-          xcf_write_int32_check_error (info, (guint32 *) &height, 1);
-          xcf_write_int32_check_error (info, (guint32 *) &tmp1,   1);
+          tmp2 = width  >> i;
+          xcf_write_int32_check_error (info, (guint32 *) &tmp2, 1);
+          tmp2 = height >> i;
+          xcf_write_int32_check_error (info, (guint32 *) &tmp2, 1);
+          xcf_write_int32_check_error (info, (guint32 *) &tmp1, 1);
         }
 
       /* the next level's offset if after the level we just wrote */
@@ -1500,10 +2175,197 @@ xcf_save_buffer (XcfInfo     *info,
   return TRUE;
 }
 
+/* appends new reduced levels for a reused tile hierarchy and points
+ * the hierarchy's level offsets to them
+ */
+static gboolean
+xcf_save_reduced_levels (XcfInfo           *info,
+                         GeglBuffer        *buffer,
+                         XcfDrawableState  *dstate,
+                         GError           **error)
+{
+  const Babl *format = dstate->format;
+  goffset    *offsets;
+  gint        nlevels;
+  gint        tmp1, tmp2;
+  gint        i;
+  GError     *tmp_error = NULL;
+
+  tmp1 = xcf_calc_levels (dstate->width,  XCF_TILE_WIDTH);
+  tmp2 = xcf_calc_levels (dstate->height, XCF_TILE_HEIGHT);
+  nlevels = MAX (tmp1, tmp2);
+
+  if (nlevels < 2)
+    return TRUE;
+
+  offsets = g_alloca ((nlevels - 1) * sizeof (goffset));
+
+  for (i = 1; i < nlevels; i++)
+    {
+      offsets[i - 1] = info->cp;
+
+      if (info->save_previews && ! babl_format_is_palette (format))
+        {
+          xcf_check_error (xcf_save_level_reduced (info, buffer, format, i,
+                                                   error));
+        }
+      else
+        {
+          tmp1 = 0;
+          tmp2 = dstate->width  >> i;
+          xcf_write_int32_check_error (info, (guint32 *) &tmp2, 1);
+          tmp2 = dstate->height >> i;
+          xcf_write_int32_check_error (info, (guint32 *) &tmp2, 1);
+          xcf_write_int32_check_error (info, (guint32 *) &tmp1, 1);
+        }
+    }
+
+  /* the level offsets follow width, height and bpp of the hierarchy,
+   * skip the first level's which stays where it is
+   */
+  xcf_check_error (xcf_save_offsets (info,
+                                     dstate->hierarchy_offset + 3 * 4 +
+                                     info->bytes_per_offset,
+                                     offsets, nlevels - 1, error));
+
+  return TRUE;
+}
+
+/* returns 'buffer' downscaled by 2^level in 'format' */
+static GeglBuffer *
+xcf_save_reduce_buffer (GeglBuffer *buffer,
+                        const Babl *format,
+                        gint        level)
+{
+  GeglBuffer *reduced;
+  guchar     *data;
+  gint        width;
+  gint        height;
+  gint        y;
+
+  width  = gegl_buffer_get_width  (buffer) >> level;
+  height = gegl_buffer_get_height (buffer) >> level;
+
+  reduced = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), format);
+
+  /* let GEGL do the downscaling, one row of tiles at a time */
+  data = g_malloc (width * XCF_TILE_HEIGHT *
+                   babl_format_get_bytes_per_pixel (format));
+
+  for (y = 0; y < height; y += XCF_TILE_HEIGHT)
+    {
+      GeglRectangle rect = { 0, y, width, MIN (XCF_TILE_HEIGHT, height - y) };
+
+      gegl_buffer_get (buffer, &rect, 1.0 / (1 << level), format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+      gegl_buffer_set (reduced, &rect, 0, format, data,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (data);
+
+  return reduced;
+}
+
+/* writes 'buffer' downscaled by 2^level as a level in 'format' */
+static gboolean
+xcf_save_level_reduced (XcfInfo     *info,
+                        GeglBuffer  *buffer,
+                        const Babl  *format,
+                        gint         level,
+                        GError     **error)
+{
+  GeglBuffer *reduced;
+  gint        width;
+  gint        height;
+  gboolean    success;
+  GError     *tmp_error = NULL;
+
+  width  = gegl_buffer_get_width  (buffer) >> level;
+  height = gegl_buffer_get_height (buffer) >> level;
+
+  if (width == 0 || height == 0)
+    {
+      guint32 value = 0;
+
+      xcf_write_int32_check_error (info, (guint32 *) &width,  1);
+      xcf_write_int32_check_error (info, (guint32 *) &height, 1);
+      xcf_write_int32_check_error (info, &value, 1);
+
+      return TRUE;
+    }
+
+  reduced = xcf_save_reduce_buffer (buffer, format, level);
+
+  success = xcf_save_level (info, reduced, NULL, error);
+
+  g_object_unref (reduced);
+
+  return success;
+}
+
+/* writes the header and an empty tile offset table of 'buffer' at
+ * 'level', and records a copy-on-write duplicate of 'buffer' so
+ * xcf_save_image_tiles() can write the tiles later
+ */
+static gboolean
+xcf_save_level_deferred (XcfInfo     *info,
+                         GeglBuffer  *buffer,
+                         const Babl  *format,
+                         gint         level,
+                         GError     **error)
+{
+  XcfDeferredLevel *deferred;
+  guint32           width;
+  guint32           height;
+  gint              ntiles;
+  GError           *tmp_error = NULL;
+
+  width  = gegl_buffer_get_width  (buffer) >> level;
+  height = gegl_buffer_get_height (buffer) >> level;
+
+  xcf_write_int32_check_error (info, &width,  1);
+  xcf_write_int32_check_error (info, &height, 1);
+
+  if (width == 0 || height == 0)
+    {
+      guint32 value = 0;
+
+      xcf_write_int32_check_error (info, &value, 1);
+
+      return TRUE;
+    }
+
+  ntiles = (((width  + XCF_TILE_WIDTH  - 1) / XCF_TILE_WIDTH) *
+            ((height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT));
+
+  deferred = g_slice_new0 (XcfDeferredLevel);
+
+  deferred->buffer            = gegl_buffer_dup (buffer);
+  deferred->format            = format;
+  deferred->level             = level;
+  deferred->tile_table_offset = info->cp;
+
+  info->deferred_levels = g_list_prepend (info->deferred_levels, deferred);
+
+  xcf_write_zero_offset_check_error (info, ntiles + 1);
+
+  return TRUE;
+}
+
+static void
+xcf_deferred_level_free (XcfDeferredLevel *deferred)
+{
+  g_object_unref (deferred->buffer);
+
+  g_slice_free (XcfDeferredLevel, deferred);
+}
+
 static gboolean
-xcf_save_level (XcfInfo     *info,
-                GeglBuffer  *buffer,
-                GError     **error)
+xcf_save_level (XcfInfo           *info,
+                GeglBuffer        *buffer,
+                XcfDrawableState  *dstate,
+                GError           **error)
 {
   const Babl *format;
   goffset    *offset_table;
@@ -1561,6 +2423,9 @@ xcf_save_level (XcfInfo     *info,
   /* 'saved_pos' is the offset of the tile offset table  */
   saved_pos = info->cp;
 
+  if (dstate)
+    dstate->tile_table_offset = saved_pos;
+
   /* write an empty offset table */
   xcf_write_zero_offset_check_error (info, ntiles + 1);
 
@@ -1579,33 +2444,13 @@ xcf_save_level (XcfInfo     *info,
                                       i, &rect);
 
       /* write out the tile. */
-      switch (info->compression)
-        {
-        case COMPRESS_NONE:
-          xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                          error));
-          break;
-        case COMPRESS_RLE:
-          xcf_check_error (xcf_save_tile_rle (info, buffer, &rect, format,
-                                              rlebuf, error));
-          break;
-        case COMPRESS_ZLIB:
-          xcf_check_error (xcf_save_tile_zlib (info, buffer, &rect, format,
-                                               error));
-          break;
-        case COMPRESS_FRACTAL:
-          g_warning ("xcf: fractal compression unimplemented");
-          return FALSE;
-        }
+      xcf_check_error (xcf_save_level_tile (info, buffer, &rect, format,
+                                            rlebuf, error));
 
-      /* make sure the on-disk tile data didn't end up being too big.
-       * xcf_load_level() would refuse to load the file if it did.
-       */
-      if (info->cp < offset || info->cp - offset > max_data_length)
+      if (dstate)
         {
-          g_message ("xcf: invalid tile data length: %" G_GOFFSET_FORMAT,
-                     info->cp - offset);
-          return FALSE;
+          dstate->tile_offsets[i] = offset;
+          dstate->tile_sizes[i]   = info->cp - offset;
         }
 
       /* the next tile's offset is after the tile we just wrote */
@@ -1622,6 +2467,123 @@ xcf_save_level (XcfInfo     *info,
   return TRUE;
 }
 
+/* appends the tiles which changed since the last save and updates the
+ * level's tile offset table in place once they are on disk, the rest
+ * of the tile hierarchy stays as it is
+ */
+static gboolean
+xcf_save_level_dirty (XcfInfo           *info,
+                      GeglBuffer        *buffer,
+                      XcfDrawableState  *dstate,
+                      GError           **error)
+{
+  const Babl *format;
+  goffset     offset;
+  goffset     max_data_length;
+  gint        bpp;
+  gint        n_dirty = 0;
+  gint        i;
+  guchar     *rlebuf = NULL;
+
+  format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+
+  max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
+                    XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
+
+  if (info->compression == COMPRESS_RLE)
+    rlebuf = g_alloca (max_data_length);
+
+  /* 'offset' is where we will write the next tile */
+  offset = info->cp;
+
+  for (i = 0; i < dstate->n_tiles; i++)
+    {
+      GeglRectangle rect;
+
+      if (! dstate->pending_tiles[i])
+        continue;
+
+      gimp_gegl_buffer_get_tile_rect (buffer,
+                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                      i, &rect);
+
+      xcf_check_error (xcf_save_level_tile (info, buffer, &rect, format,
+                                            rlebuf, error));
+
+      dstate->tile_offsets[i] = offset;
+      dstate->tile_sizes[i]   = info->cp - offset;
+
+      offset = info->cp;
+      n_dirty++;
+    }
+
+  if (n_dirty > 0)
+    {
+      /* the table keeps its terminating zero, only rewrite the offsets */
+      xcf_check_error (xcf_save_offsets (info, dstate->tile_table_offset,
+                                         dstate->tile_offsets,
+                                         dstate->n_tiles, error));
+    }
+
+  return TRUE;
+}
+
+static gboolean
+xcf_save_level_tile (XcfInfo        *info,
+                     GeglBuffer     *buffer,
+                     GeglRectangle  *tile_rect,
+                     const Babl     *format,
+                     guchar         *rlebuf,
+                     GError        **error)
+{
+  goffset offset = info->cp;
+  goffset max_data_length;
+
+  max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT *
+                    babl_format_get_bytes_per_pixel (format) *
+                    XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
+
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+      xcf_check_error (xcf_save_tile (info, buffer, tile_rect, format,
+                                      error));
+      break;
+    case COMPRESS_RLE:
+      xcf_check_error (xcf_save_tile_rle (info, buffer, tile_rect, format,
+                                          rlebuf, error));
+      break;
+    case COMPRESS_ZLIB:
+    case COMPRESS_ZLIB_PLANAR:
+      xcf_check_error (xcf_save_tile_zlib (info, buffer, tile_rect, format,
+                                           error));
+      break;
+    case COMPRESS_FRACTAL:
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Error writing XCF: fractal compression is "
+                             "not supported"));
+      return FALSE;
+    }
+
+  /* make sure the on-disk tile data didn't end up being too big.
+   * xcf_load_level() would refuse to load the file if it did.
+   *
+   * this can run in the thread of a background save, so report
+   * errors through 'error' only, never with g_message()
+   */
+  if (info->cp < offset || info->cp - offset > max_data_length)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Error writing XCF: invalid tile data length: %"
+                     G_GOFFSET_FORMAT),
+                   info->cp - offset);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 xcf_save_tile (XcfInfo        *info,
                GeglBuffer     *buffer,
@@ -1778,7 +2740,12 @@ xcf_save_tile_rle (XcfInfo        *info,
         }
 
       if (count != (tile_rect->width * tile_rect->height))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error writing XCF: RLE tile saving error: %d"),
+                       count);
+          return FALSE;
+        }
     }
 
   xcf_write_int8_check_error (info, rlebuf, len);
@@ -1798,6 +2765,8 @@ xcf_save_tile_zlib (XcfInfo        *info,
   guchar   *tile_data = g_alloca (tile_size);
   /* The buffer for compressed data. */
   guchar   *buf       = g_alloca (tile_size);
+  guchar   *planes    = NULL;
+  gint      level     = Z_DEFAULT_COMPRESSION;
   GError   *tmp_error = NULL;
   z_stream  strm;
   int       action;
@@ -1806,7 +2775,20 @@ xcf_save_tile_zlib (XcfInfo        *info,
   gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  if (info->file_version >= 12)
+  if (info->compression == COMPRESS_ZLIB_PLANAR)
+    {
+      /* the planes are so regular that the fastest level loses
+       * next to nothing against the default one
+       */
+      planes = g_alloca (tile_size);
+      level  = Z_BEST_SPEED;
+
+      xcf_planar_encode (planes, tile_data,
+                         tile_rect->width * tile_rect->height,
+                         tile_rect->width, bpp,
+                         babl_format_get_n_components (format));
+    }
+  else if (info->file_version >= 12)
     {
       gint n_components = babl_format_get_n_components (format);
 
@@ -1819,11 +2801,11 @@ xcf_save_tile_zlib (XcfInfo        *info,
   strm.zfree  = Z_NULL;
   strm.opaque = Z_NULL;
 
-  status = deflateInit (&strm, Z_DEFAULT_COMPRESSION);
+  status = deflateInit (&strm, level);
   if (status != Z_OK)
     return FALSE;
 
-  strm.next_in   = tile_data;
+  strm.next_in   = planes ? planes : tile_data;
   strm.avail_in  = tile_size;
   strm.next_out  = buf;
   strm.avail_out = tile_size;
@@ -19,9 +19,17 @@
 #define __XCF_SAVE_H__
 
 
-gboolean   xcf_save_image (XcfInfo    *info,
-                           GimpImage  *image,
-                           GError    **error);
+gboolean             xcf_save_image             (XcfInfo       *info,
+                                                 GimpImage     *image,
+                                                 GError       **error);
+XcfCompressionType   xcf_save_image_compression (GimpImage     *image);
+gboolean             xcf_save_image_can_append  (Gimp          *gimp,
+                                                 GimpImage     *image,
+                                                 XcfSaveState  *state);
+gboolean             xcf_save_image_tiles       (XcfInfo       *info,
+                                                 gint          *n_saved,
+                                                 GError       **error);
+void                 xcf_save_image_clear_tiles (XcfInfo       *info);
 
 
 #endif  /* __XCF_SAVE_H__ */
@@ -24,6 +24,60 @@
 #include "xcf-utils.h"
 
 
+/*  the value at 'i' is predicted by its left neighbor, or the value
+ *  above at the start of a row
+ */
+#define XCF_PREDICTOR(data, i, n_components, stride)               \
+  ((i) % (stride) >= (n_components) ? (data)[(i) - (n_components)] : \
+   (i) >= (stride)                  ? (data)[(i) - (stride)]       : \
+                                      0)
+
+#define XCF_DELTA_ENCODE(type, to_be)                                  \
+  G_STMT_START                                                         \
+    {                                                                  \
+      type *values = (type *) data;                                    \
+      gint  i;                                                         \
+                                                                       \
+      for (i = n_values - 1; i >= 0; i--)                              \
+        {                                                              \
+          type pred = XCF_PREDICTOR (values, i, n_components, stride); \
+                                                                       \
+          values[i] = to_be ((type) (values[i] - pred));               \
+        }                                                              \
+    }                                                                  \
+  G_STMT_END
+
+#define XCF_DELTA_DECODE(type, from_be)                                \
+  G_STMT_START                                                         \
+    {                                                                  \
+      type *values = (type *) data;                                    \
+      gint  i;                                                         \
+                                                                       \
+      for (i = 0; i < n_values; i++)                                   \
+        {                                                              \
+          type pred = XCF_PREDICTOR (values, i, n_components, stride); \
+                                                                       \
+          values[i] = (type) (from_be (values[i]) + pred);             \
+        }                                                              \
+    }                                                                  \
+  G_STMT_END
+
+#define XCF_IDENTITY(value) (value)
+
+
+static void   xcf_delta_encode (guchar *data,
+                                gint    n_values,
+                                gint    component_size,
+                                gint    n_components,
+                                gint    stride);
+static void   xcf_delta_decode (guchar *data,
+                                gint    n_values,
+                                gint    component_size,
+                                gint    n_components,
+                                gint    stride);
+
+
+
 gboolean
 xcf_data_is_zero (const void *data,
                   gint        size)
@@ -51,3 +105,101 @@ xcf_data_is_zero (const void *data,
 
   return TRUE;
 }
+
+/*  prepares 'n_pixels' pixels of native-endian 'src' for compression:
+ *  replaces each component by its difference to the same component of
+ *  the previous pixel (integer arithmetic on the raw bits, also for
+ *  floating point data) and stores the big-endian result in 'dest'
+ *  split into one plane per byte of a pixel, so the slowly changing
+ *  high bytes end up next to each other.  'src' is clobbered.
+ */
+void
+xcf_planar_encode (guchar *dest,
+                   guchar *src,
+                   gint    n_pixels,
+                   gint    row_length,
+                   gint    bpp,
+                   gint    n_components)
+{
+  gint b;
+
+  xcf_delta_encode (src, n_pixels * n_components, bpp / n_components,
+                    n_components, row_length * n_components);
+
+  for (b = 0; b < bpp; b++)
+    {
+      const guchar *s = src + b;
+      guchar       *d = dest + b * n_pixels;
+      gint          i;
+
+      for (i = 0; i < n_pixels; i++, s += bpp)
+        d[i] = *s;
+    }
+}
+
+/*  reverses xcf_planar_encode()
+ */
+void
+xcf_planar_decode (guchar       *dest,
+                   const guchar *src,
+                   gint          n_pixels,
+                   gint          row_length,
+                   gint          bpp,
+                   gint          n_components)
+{
+  gint b;
+
+  for (b = 0; b < bpp; b++)
+    {
+      const guchar *s = src + b * n_pixels;
+      guchar       *d = dest + b;
+      gint          i;
+
+      for (i = 0; i < n_pixels; i++, d += bpp)
+        *d = s[i];
+    }
+
+  xcf_delta_decode (dest, n_pixels * n_components, bpp / n_components,
+                    n_components, row_length * n_components);
+}
+
+
+/*  private functions  */
+
+static void
+xcf_delta_encode (guchar *data,
+                  gint    n_values,
+                  gint    component_size,
+                  gint    n_components,
+                  gint    stride)
+{
+  switch (component_size)
+    {
+    case 1: XCF_DELTA_ENCODE (guint8,  XCF_IDENTITY);    break;
+    case 2: XCF_DELTA_ENCODE (guint16, GUINT16_TO_BE);   break;
+    case 4: XCF_DELTA_ENCODE (guint32, GUINT32_TO_BE);   break;
+    case 8: XCF_DELTA_ENCODE (guint64, GUINT64_TO_BE);   break;
+
+    default:
+      g_return_if_reached ();
+    }
+}
+
+static void
+xcf_delta_decode (guchar *data,
+                  gint    n_values,
+                  gint    component_size,
+                  gint    n_components,
+                  gint    stride)
+{
+  switch (component_size)
+    {
+    case 1: XCF_DELTA_DECODE (guint8,  XCF_IDENTITY);    break;
+    case 2: XCF_DELTA_DECODE (guint16, GUINT16_FROM_BE); break;
+    case 4: XCF_DELTA_DECODE (guint32, GUINT32_FROM_BE); break;
+    case 8: XCF_DELTA_DECODE (guint64, GUINT64_FROM_BE); break;
+
+    default:
+      g_return_if_reached ();
+    }
+}
@@ -19,8 +19,21 @@
 #define __XCF_UTILS_H__
 
 
-gboolean   xcf_data_is_zero (const void *data,
-                             gint        size);
+gboolean   xcf_data_is_zero     (const void   *data,
+                                 gint          size);
+
+void       xcf_planar_encode    (guchar       *dest,
+                                 guchar       *src,
+                                 gint          n_pixels,
+                                 gint          row_length,
+                                 gint          bpp,
+                                 gint          n_components);
+void       xcf_planar_decode    (guchar       *dest,
+                                 const guchar *src,
+                                 gint          n_pixels,
+                                 gint          row_length,
+                                 gint          bpp,
+                                 gint          n_components);
 
 
 #endif  /* __XCF_UTILS_H__ */
@@ -29,7 +29,10 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
+#include "core/gimp-gui.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
 #include "core/gimpprogress.h"
@@ -42,14 +45,34 @@
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
+#include "xcf-save-state.h"
 
+#include "gimp-trace.h"
 #include "gimp-intl.h"
 
 
+#define XCF_SAVE_IN_PROGRESS_KEY "gimp-xcf-save-in-progress"
+
+
 typedef GimpImage * GimpXcfLoaderFunc (Gimp     *gimp,
                                        XcfInfo  *info,
                                        GError  **error);
 
+typedef struct _XcfSaveJob XcfSaveJob;
+
+/*  writes the tiles of a background save in a thread while the main
+ *  loop keeps running
+ */
+struct _XcfSaveJob
+{
+  XcfInfo      *info;
+  GMainLoop    *main_loop;
+  gint          n_levels;
+  gint          n_saved;
+  gboolean      success;
+  GError       *error;
+};
+
 
 static GimpValueArray * xcf_load_invoker (GimpProcedure         *procedure,
                                           Gimp                  *gimp,
@@ -57,6 +80,13 @@ static GimpValueArray * xcf_load_invoker (GimpProcedure         *procedure,
                                           GimpProgress          *progress,
                                           const GimpValueArray  *args,
                                           GError               **error);
+static GimpValueArray * xcf_load_thumb_invoker
+                                         (GimpProcedure         *procedure,
+                                          Gimp                  *gimp,
+                                          GimpContext           *context,
+                                          GimpProgress          *progress,
+                                          const GimpValueArray  *args,
+                                          GError               **error);
 static GimpValueArray * xcf_save_invoker (GimpProcedure         *procedure,
                                           Gimp                  *gimp,
                                           GimpContext           *context,
@@ -64,6 +94,30 @@ static GimpValueArray * xcf_save_invoker (GimpProcedure         *procedure,
                                           const GimpValueArray  *args,
                                           GError               **error);
 
+static gboolean         xcf_read_header  (XcfInfo               *info);
+static gboolean         xcf_save_check_in_progress
+                                         (GimpImage             *image,
+                                          GError               **error);
+static gboolean         xcf_save_output  (Gimp                  *gimp,
+                                          GimpImage             *image,
+                                          GOutputStream         *output,
+                                          GFile                 *output_file,
+                                          XcfSaveState          *save_state,
+                                          gboolean               append,
+                                          gboolean               background,
+                                          GimpProgress          *progress,
+                                          GError               **error);
+static gboolean         xcf_save_tiles_in_background
+                                         (Gimp                  *gimp,
+                                          XcfInfo               *info,
+                                          GError               **error);
+static gpointer         xcf_save_job_thread
+                                         (XcfSaveJob            *job);
+static gboolean         xcf_save_job_done
+                                         (XcfSaveJob            *job);
+static gboolean         xcf_save_job_progress
+                                         (XcfSaveJob            *job);
+
 
 static GimpXcfLoaderFunc * const xcf_loaders[] =
 {
@@ -79,7 +133,9 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version  9 */
   xcf_load_image,   /* version 10 */
   xcf_load_image,   /* version 11 */
-  xcf_load_image    /* version 12 */
+  xcf_load_image,   /* version 12 */
+  xcf_load_image,   /* version 13 */
+  xcf_load_image    /* version 14 */
 };
 
 
@@ -236,6 +292,82 @@ xcf_init (Gimp *gimp)
                                                              "Output image",
                                                              gimp, FALSE,
                                                              GIMP_PARAM_READWRITE));
+  gimp_plug_in_procedure_set_thumb_loader (proc, "gimp-xcf-load-thumb");
+  gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
+  g_object_unref (procedure);
+
+  /*  gimp-xcf-load-thumb  */
+  file = g_file_new_for_path ("gimp-xcf-load-thumb");
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, file);
+  g_object_unref (file);
+
+  procedure->proc_type    = GIMP_INTERNAL;
+  procedure->marshal_func = xcf_load_thumb_invoker;
+
+  proc = GIMP_PLUG_IN_PROCEDURE (procedure);
+  gimp_plug_in_procedure_set_handles_uri (proc);
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure), "gimp-xcf-load-thumb");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-xcf-load-thumb",
+                                     "Loads a preview from an XCF file",
+                                     "Loads the reduced-size projection "
+                                     "stored in XCF files saved with "
+                                     "previews enabled, without reading "
+                                     "any layer data.  Fails for files "
+                                     "which don't contain previews.",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "1995-1996",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to load, in URI "
+                                                       "format and UTF-8 "
+                                                       "encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("thumb-size",
+                                                      "Thumb Size",
+                                                      "Preferred thumbnail size",
+                                                      1, G_MAXINT32, 128,
+                                                      GIMP_PARAM_READWRITE));
+
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_image_id ("image",
+                                                             "Image",
+                                                             "Thumbnail image",
+                                                             gimp, FALSE,
+                                                             GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-width",
+                                                          "Image width",
+                                                          "Width of the full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-height",
+                                                          "Image height",
+                                                          "Height of the full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-type",
+                                                          "Image type",
+                                                          "Type of the image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-layers",
+                                                          "Num layers",
+                                                          "Number of layers in the image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
   gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
   g_object_unref (procedure);
 }
@@ -256,7 +388,6 @@ xcf_load_stream (Gimp          *gimp,
   XcfInfo      info  = { 0, };
   const gchar *filename;
   GimpImage   *image = NULL;
-  gchar        id[14];
   gboolean     success;
 
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
@@ -281,38 +412,19 @@ xcf_load_stream (Gimp          *gimp,
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
 
-  success = TRUE;
-
-  xcf_read_int8 (&info, (guint8 *) id, 14);
-
-  if (! g_str_has_prefix (id, "gimp xcf "))
-    {
-      success = FALSE;
-    }
-  else if (strcmp (id + 9, "file") == 0)
-    {
-      info.file_version = 0;
-    }
-  else if (id[9]  == 'v' &&
-           id[13] == '\0')
-    {
-      info.file_version = atoi (id + 10);
-    }
-  else
-    {
-      success = FALSE;
-    }
-
-  if (info.file_version >= 11)
-    info.bytes_per_offset = 8;
+  success = xcf_read_header (&info);
 
   if (success)
     {
       if (info.file_version >= 0 &&
           info.file_version < G_N_ELEMENTS (xcf_loaders))
         {
+          GIMP_TRACE_BEGIN ();
+
           image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
 
+          GIMP_TRACE_END ("xcf", "load");
+
           if (! image)
             success = FALSE;
 
@@ -341,11 +453,6 @@ xcf_save_stream (Gimp           *gimp,
                  GimpProgress   *progress,
                  GError        **error)
 {
-  XcfInfo      info     = { 0, };
-  const gchar *filename;
-  gboolean     success  = FALSE;
-  GError      *my_error = NULL;
-
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
   g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
   g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), FALSE);
@@ -353,52 +460,11 @@ xcf_save_stream (Gimp           *gimp,
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  if (output_file)
-    filename = gimp_file_get_utf8_name (output_file);
-  else
-    filename = _("Memory Stream");
-
-  info.gimp             = gimp;
-  info.output           = output;
-  info.seekable         = G_SEEKABLE (output);
-  info.bytes_per_offset = 4;
-  info.progress         = progress;
-  info.file             = output_file;
-
-  if (gimp_image_get_xcf_compression (image))
-    info.compression = COMPRESS_ZLIB;
-  else
-    info.compression = COMPRESS_RLE;
-
-  info.file_version = gimp_image_get_xcf_version (image,
-                                                  info.compression ==
-                                                  COMPRESS_ZLIB,
-                                                  NULL, NULL);
-
-  if (info.file_version >= 11)
-    info.bytes_per_offset = 8;
-
-  if (progress)
-    gimp_progress_start (progress, FALSE, _("Saving '%s'"), filename);
+  if (! xcf_save_check_in_progress (image, error))
+    return FALSE;
 
-  success = xcf_save_image (&info, image, &my_error);
-
-  if (success)
-    {
-      if (progress)
-        gimp_progress_set_text (progress, _("Closing '%s'"), filename);
-
-      success = g_output_stream_close (info.output, NULL, &my_error);
-    }
-
-  if (! success && my_error)
-    g_propagate_prefixed_error (error, my_error,
-                                _("Error writing '%s': "), filename);
-
-  if (progress)
-    gimp_progress_end (progress);
-
-  return success;
+  return xcf_save_output (gimp, image, output, output_file, NULL, FALSE,
+                          FALSE, progress, error);
 }
 
 
@@ -452,6 +518,70 @@ xcf_load_invoker (GimpProcedure         *procedure,
   return return_vals;
 }
 
+static GimpValueArray *
+xcf_load_thumb_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
+{
+  GimpValueArray *return_vals;
+  GimpImage      *image    = NULL;
+  XcfInfo         info     = { 0, };
+  gint            width    = 0;
+  gint            height   = 0;
+  gint            type     = 0;
+  gint            n_layers = 0;
+  const gchar    *uri;
+  gint            size;
+  GFile          *file;
+  GInputStream   *input;
+
+  uri  = g_value_get_string (gimp_value_array_index (args, 0));
+  size = g_value_get_int (gimp_value_array_index (args, 1));
+  file = g_file_new_for_uri (uri);
+
+  input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+
+  if (input)
+    {
+      info.gimp             = gimp;
+      info.input            = input;
+      info.seekable         = G_SEEKABLE (input);
+      info.bytes_per_offset = 4;
+      info.file             = file;
+      info.compression      = COMPRESS_NONE;
+
+      if (xcf_read_header (&info) &&
+          info.file_version < G_N_ELEMENTS (xcf_loaders))
+        {
+          image = xcf_load_thumbnail (gimp, &info, size,
+                                      &width, &height, &type, &n_layers,
+                                      error);
+        }
+
+      g_input_stream_close (input, NULL, NULL);
+      g_object_unref (input);
+    }
+
+  g_object_unref (file);
+
+  return_vals = gimp_procedure_get_return_values (procedure, image != NULL,
+                                                  error ? *error : NULL);
+
+  if (image)
+    {
+      gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+      g_value_set_int (gimp_value_array_index (return_vals, 2), width);
+      g_value_set_int (gimp_value_array_index (return_vals, 3), height);
+      g_value_set_int (gimp_value_array_index (return_vals, 4), type);
+      g_value_set_int (gimp_value_array_index (return_vals, 5), n_layers);
+    }
+
+  return return_vals;
+}
+
 static GimpValueArray *
 xcf_save_invoker (GimpProcedure         *procedure,
                   Gimp                  *gimp,
@@ -465,6 +595,9 @@ xcf_save_invoker (GimpProcedure         *procedure,
   const gchar    *uri;
   GFile          *file;
   GOutputStream  *output;
+  XcfSaveState   *save_state;
+  gboolean        background;
+  gboolean        appended = FALSE;
   gboolean        success  = FALSE;
   GError         *my_error = NULL;
 
@@ -474,24 +607,112 @@ xcf_save_invoker (GimpProcedure         *procedure,
   uri   = g_value_get_string (gimp_value_array_index (args, 3));
   file  = g_file_new_for_uri (uri);
 
-  output = G_OUTPUT_STREAM (g_file_replace (file,
-                                            NULL, FALSE, G_FILE_CREATE_NONE,
-                                            NULL, &my_error));
+  /*  the main loop runs while saving, don't let the image go away
+   *  from under us
+   */
+  g_object_ref (image);
+
+  background = gimp->config->xcf_save_in_background;
 
-  if (output)
+  if (! xcf_save_check_in_progress (image, error))
     {
-      success = xcf_save_stream (gimp, image, output, file, progress, error);
+      g_object_unref (file);
+      g_object_unref (image);
+
+      return_vals = gimp_procedure_get_return_values (procedure, FALSE,
+                                                      error ? *error : NULL);
+
+      gimp_unset_busy (gimp);
+
+      return return_vals;
+    }
 
-      g_object_unref (output);
+  /*  if the image was last saved to this very file, try to only
+   *  append what changed since.  background saves write all tiles
+   *  from a snapshot and can't keep track of them.
+   */
+  if (background)
+    {
+      xcf_save_state_clear (image);
+      save_state = NULL;
     }
   else
     {
-      g_propagate_prefixed_error (error, my_error,
-                                  _("Error creating '%s': "),
-                                  gimp_file_get_utf8_name (file));
+      save_state = xcf_save_state_get (image, file);
+    }
+
+  g_object_set_data (G_OBJECT (image), XCF_SAVE_IN_PROGRESS_KEY, file);
+
+  if (save_state && xcf_save_image_can_append (gimp, image, save_state))
+    {
+      GFileIOStream *iostream = g_file_open_readwrite (file, NULL, NULL);
+
+      if (iostream)
+        {
+          output = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
+
+          /*  the existing data is only touched once everything new
+           *  is on disk, so whatever goes wrong the file still holds
+           *  the last save, and is replaced by a full save below
+           */
+          if (G_IS_SEEKABLE (output))
+            {
+              xcf_save_state_begin (save_state);
+
+              appended = xcf_save_output (gimp, image, output, file,
+                                          save_state, TRUE, FALSE,
+                                          progress, NULL);
+            }
+
+          g_object_unref (iostream);
+        }
+
+      if (! appended)
+        {
+          xcf_save_state_clear (image);
+          save_state = NULL;
+        }
     }
 
+  success = appended;
+
+  if (! appended)
+    {
+      output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                NULL, FALSE, G_FILE_CREATE_NONE,
+                                                NULL, &my_error));
+
+      if (output)
+        {
+          if (! background)
+            save_state = xcf_save_state_new (image, file);
+
+          success = xcf_save_output (gimp, image, output, file,
+                                     save_state, FALSE, background,
+                                     progress, error);
+
+          g_object_unref (output);
+        }
+      else
+        {
+          save_state = NULL;
+
+          g_propagate_prefixed_error (error, my_error,
+                                      _("Error creating '%s': "),
+                                      gimp_file_get_utf8_name (file));
+        }
+    }
+
+  g_object_set_data (G_OBJECT (image), XCF_SAVE_IN_PROGRESS_KEY, NULL);
+
+  /*  a failed save leaves the file in an unknown state, the next save
+   *  has to write it from scratch
+   */
+  if (save_state && ! (success && xcf_save_state_finish (save_state)))
+    xcf_save_state_abort (save_state);
+
   g_object_unref (file);
+  g_object_unref (image);
 
   return_vals = gimp_procedure_get_return_values (procedure, success,
                                                   error ? *error : NULL);
@@ -500,3 +721,252 @@ xcf_save_invoker (GimpProcedure         *procedure,
 
   return return_vals;
 }
+
+/*  the main loop keeps running during a background save, and the
+ *  progress of any save can run it too, don't let a second save of the
+ *  same image interfere, whether it runs in the background or not
+ */
+static gboolean
+xcf_save_check_in_progress (GimpImage  *image,
+                            GError    **error)
+{
+  GFile *file = g_object_get_data (G_OBJECT (image),
+                                   XCF_SAVE_IN_PROGRESS_KEY);
+
+  if (file)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                   _("The image is still being saved to '%s'"),
+                   gimp_file_get_utf8_name (file));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  reads the file's tag and sets up 'info' for its version
+ */
+static gboolean
+xcf_read_header (XcfInfo *info)
+{
+  gchar id[14];
+
+  if (xcf_read_int8 (info, (guint8 *) id, 14) != 14)
+    return FALSE;
+
+  if (! g_str_has_prefix (id, "gimp xcf "))
+    {
+      return FALSE;
+    }
+  else if (strcmp (id + 9, "file") == 0)
+    {
+      info->file_version = 0;
+    }
+  else if (id[9]  == 'v' &&
+           id[13] == '\0')
+    {
+      info->file_version = atoi (id + 10);
+    }
+  else
+    {
+      return FALSE;
+    }
+
+  if (info->file_version >= 11)
+    info->bytes_per_offset = 8;
+
+  return TRUE;
+}
+
+static gboolean
+xcf_save_output (Gimp           *gimp,
+                 GimpImage      *image,
+                 GOutputStream  *output,
+                 GFile          *output_file,
+                 XcfSaveState   *save_state,
+                 gboolean        append,
+                 gboolean        background,
+                 GimpProgress   *progress,
+                 GError        **error)
+{
+  XcfInfo      info     = { 0, };
+  const gchar *filename;
+  gboolean     success  = FALSE;
+  GError      *my_error = NULL;
+
+  if (output_file)
+    filename = gimp_file_get_utf8_name (output_file);
+  else
+    filename = _("Memory Stream");
+
+  info.gimp             = gimp;
+  info.output           = output;
+  info.seekable         = G_SEEKABLE (output);
+  info.bytes_per_offset = 4;
+  info.progress         = progress;
+  info.file             = output_file;
+
+  info.compression  = xcf_save_image_compression (image);
+  info.file_version = gimp_image_get_xcf_version (image,
+                                                  info.compression !=
+                                                  COMPRESS_RLE,
+                                                  NULL, NULL);
+
+  /* incremental saves leave tiles out of order, which older versions
+   * can't load
+   */
+  if (append)
+    info.file_version = MAX (info.file_version, XCF_INCREMENTAL_VERSION);
+
+  /* planar tiles are only opted into, see xcf_save_image_compression() */
+  if (info.compression == COMPRESS_ZLIB_PLANAR)
+    info.file_version = MAX (info.file_version, XCF_ZLIB_PLANAR_VERSION);
+
+  if (info.file_version >= 11)
+    info.bytes_per_offset = 8;
+
+  /* reduced levels are only useful in actual files */
+  if (output_file)
+    info.save_previews = gimp->config->xcf_save_previews;
+
+  /* only files with 64 bit offsets can later be saved incrementally */
+  if (save_state && info.bytes_per_offset == 8)
+    {
+      info.save_state = save_state;
+      info.append     = append;
+    }
+
+  if (save_state)
+    {
+      save_state->bytes_per_offset = info.bytes_per_offset;
+      save_state->compression      = info.compression;
+    }
+
+  /*  a background save only writes the image structure here, and
+   *  leaves the tiles to a thread
+   */
+  info.defer_tiles = background;
+
+  if (progress)
+    gimp_progress_start (progress, FALSE, _("Saving '%s'"), filename);
+
+  GIMP_TRACE_BEGIN ();
+
+  success = xcf_save_image (&info, image, &my_error);
+
+  GIMP_TRACE_END ("xcf", "save");
+
+  if (success && info.defer_tiles)
+    {
+      /*  this closes the stream too  */
+      success = xcf_save_tiles_in_background (gimp, &info, &my_error);
+    }
+  else if (success)
+    {
+      if (progress)
+        gimp_progress_set_text (progress, _("Closing '%s'"), filename);
+
+      success = g_output_stream_close (info.output, NULL, &my_error);
+    }
+  else
+    {
+      xcf_save_image_clear_tiles (&info);
+    }
+
+  if (! success && my_error)
+    g_propagate_prefixed_error (error, my_error,
+                                _("Error writing '%s': "), filename);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return success;
+}
+
+/*  writes the tiles deferred by xcf_save_image() in a thread, and
+ *  runs a main loop until it's done, so the image can be edited
+ *  meanwhile.  the tiles come from copy-on-write duplicates of the
+ *  buffers as they were when the save started.
+ */
+static gboolean
+xcf_save_tiles_in_background (Gimp     *gimp,
+                              XcfInfo  *info,
+                              GError  **error)
+{
+  XcfSaveJob  job = { 0, };
+  GThread    *thread;
+  guint       progress_id;
+
+  job.info      = info;
+  job.main_loop = g_main_loop_new (NULL, FALSE);
+  job.n_levels  = g_list_length (info->deferred_levels);
+
+  progress_id = g_timeout_add (100, (GSourceFunc) xcf_save_job_progress, &job);
+
+  thread = g_thread_new ("xcf-save", (GThreadFunc) xcf_save_job_thread, &job);
+
+  /*  the image is only busy while its structure and the snapshot of
+   *  its tiles are taken, not while the thread writes them
+   */
+  gimp_unset_busy (gimp);
+
+  gimp_threads_leave (gimp);
+  g_main_loop_run (job.main_loop);
+  gimp_threads_enter (gimp);
+
+  gimp_set_busy (gimp);
+
+  /*  main_loop is quit in xcf_save_job_done()  */
+
+  g_thread_join (thread);
+  g_source_remove (progress_id);
+  g_main_loop_unref (job.main_loop);
+
+  if (job.error)
+    g_propagate_error (error, job.error);
+
+  return job.success;
+}
+
+static gpointer
+xcf_save_job_thread (XcfSaveJob *job)
+{
+  GIMP_TRACE_BEGIN ();
+
+  job->success = xcf_save_image_tiles (job->info, &job->n_saved,
+                                       &job->error);
+
+  GIMP_TRACE_END ("xcf", "save-tiles");
+
+  if (job->success)
+    {
+      job->success = g_output_stream_close (job->info->output, NULL,
+                                            &job->error);
+    }
+
+  /*  errors are only collected in the job, and reported by the main
+   *  thread after xcf_save_job_done() quit the main loop
+   */
+  g_idle_add ((GSourceFunc) xcf_save_job_done, job);
+
+  return NULL;
+}
+
+static gboolean
+xcf_save_job_done (XcfSaveJob *job)
+{
+  g_main_loop_quit (job->main_loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+xcf_save_job_progress (XcfSaveJob *job)
+{
+  if (job->info->progress && job->n_levels > 0)
+    gimp_progress_set_value (job->info->progress,
+                             (gdouble) g_atomic_int_get (&job->n_saved) /
+                             (gdouble) job->n_levels);
+
+  return G_SOURCE_CONTINUE;
+}
@@ -144,8 +144,10 @@ typedef enum
 
 #define WRITE_BUFFER_SIZE  1024
 
-void gimp_read_expect_msg   (GimpWireMessage *msg,
-                             gint             type);
+void gimp_read_expect_msg   (GimpWireMessage   *msg,
+                             gint               type);
+void _gimp_pdb_batch_sync   (void);
+void _gimp_pdb_batch_return (GPProcReturnBatch *proc_return_batch);
 
 
 static void       gimp_close                   (void);
@@ -1073,6 +1075,10 @@ gimp_read_expect_msg (GimpWireMessage *msg,
         {
           gimp_process_message (msg);
         }
+      else if (msg->type == GP_PROC_RETURN_BATCH)
+        {
+          _gimp_pdb_batch_return (msg->data);
+        }
       else
         {
           g_error ("unexpected message: %d", msg->type);
@@ -1121,6 +1127,8 @@ gimp_run_procedure2 (const gchar     *name,
   proc_run.params  = (GPParam *) params;
 
   gp_lock ();
+  _gimp_pdb_batch_sync ();
+
   if (! gp_proc_run_write (_writechannel, &proc_run, NULL))
     gimp_quit ();
 
@@ -2087,6 +2095,14 @@ gimp_loop (void)
         case GP_HAS_INIT:
           g_warning ("unexpected has init message received (should not happen)");
           break;
+
+        case GP_PROC_RUN_BATCH:
+          g_warning ("unexpected proc run batch message received (should not happen)");
+          break;
+
+        case GP_PROC_RETURN_BATCH:
+          g_warning ("unexpected proc return batch message received (should not happen)");
+          break;
         }
 
       gimp_wire_destroy (&msg);
@@ -2242,6 +2258,11 @@ gimp_proc_run (GPProcRun *proc_run)
                                  (GimpParam *) proc_run->params,
                                  &n_return_vals, &return_vals);
 
+      /*  collect the replies of batched calls the plug-in didn't wait for  */
+      gp_lock ();
+      _gimp_pdb_batch_sync ();
+      gp_unlock ();
+
       proc_return.name    = proc_run->name;
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
@@ -2275,6 +2296,13 @@ gimp_temp_proc_run (GPProcRun *proc_run)
                     (GimpParam *) proc_run->params,
                     &n_return_vals, &return_vals);
 
+      /*  collect the replies of batched calls the procedure didn't wait
+       *  for, it may run while a chunk of the caller is in flight
+       */
+      gp_lock ();
+      _gimp_pdb_batch_sync ();
+      gp_unlock ();
+
       proc_return.name    = proc_run->name;
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
@@ -2318,6 +2346,12 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_HAS_INIT:
       g_warning ("unexpected has init message received (should not happen)");
       break;
+    case GP_PROC_RUN_BATCH:
+      g_warning ("unexpected proc run batch message received (should not happen)");
+      break;
+    case GP_PROC_RETURN_BATCH:
+      _gimp_pdb_batch_return (msg->data);
+      break;
     }
 }
 
@@ -50,8 +50,10 @@
 #include <libgimp/gimppalette.h>
 #include <libgimp/gimppalettes.h>
 #include <libgimp/gimppaletteselect.h>
+#include <libgimp/gimpparallel.h>
 #include <libgimp/gimppatterns.h>
 #include <libgimp/gimppatternselect.h>
+#include <libgimp/gimppdbbatch.h>
 #include <libgimp/gimppixbuf.h>
 #include <libgimp/gimppixelfetcher.h>
 #include <libgimp/gimppixelrgn.h>
@@ -31,6 +31,10 @@
 #define TILE_HEIGHT gimp_tile_height()
 
 
+static GimpTile * gimp_drawable_create_tiles (GimpDrawable *drawable,
+                                              gboolean      shadow);
+
+
 /**
  * gimp_drawable_get:
  * @drawable_ID: the ID of the drawable
@@ -153,58 +157,36 @@ gimp_drawable_get_tile (GimpDrawable *drawable,
                         gint          row,
                         gint          col)
 {
-  GimpTile *tiles;
-  guint     right_tile;
-  guint     bottom_tile;
-  gint      n_tiles;
-  gint      tile_num;
-  gint      i, j, k;
+  GimpTile **tiles_ptr;
+  GimpTile  *tiles;
+  gint       tile_num;
 
   g_return_val_if_fail (drawable != NULL, NULL);
 
   if (shadow)
-    tiles = drawable->shadow_tiles;
+    tiles_ptr = &drawable->shadow_tiles;
   else
-    tiles = drawable->tiles;
+    tiles_ptr = &drawable->tiles;
+
+  tiles = g_atomic_pointer_get (tiles_ptr);
 
   if (! tiles)
     {
-      n_tiles = drawable->ntile_rows * drawable->ntile_cols;
-      tiles = g_new (GimpTile, n_tiles);
+      static GMutex tiles_mutex;
 
-      right_tile  = (drawable->width  -
-                     ((drawable->ntile_cols - 1) * TILE_WIDTH));
-      bottom_tile = (drawable->height -
-                     ((drawable->ntile_rows - 1) * TILE_HEIGHT));
+      /*  tiles may be requested from several threads at once  */
+      g_mutex_lock (&tiles_mutex);
 
-      for (i = 0, k = 0; i < drawable->ntile_rows; i++)
+      tiles = *tiles_ptr;
+
+      if (! tiles)
         {
-          for (j = 0; j < drawable->ntile_cols; j++, k++)
-            {
-              tiles[k].bpp       = drawable->bpp;
-              tiles[k].tile_num  = k;
-              tiles[k].ref_count = 0;
-              tiles[k].dirty     = FALSE;
-              tiles[k].shadow    = shadow;
-              tiles[k].data      = NULL;
-              tiles[k].drawable  = drawable;
-
-              if (j == (drawable->ntile_cols - 1))
-                tiles[k].ewidth  = right_tile;
-              else
-                tiles[k].ewidth  = TILE_WIDTH;
+          tiles = gimp_drawable_create_tiles (drawable, shadow);
 
-              if (i == (drawable->ntile_rows - 1))
-                tiles[k].eheight = bottom_tile;
-              else
-                tiles[k].eheight = TILE_HEIGHT;
-            }
+          g_atomic_pointer_set (tiles_ptr, tiles);
         }
 
-      if (shadow)
-        drawable->shadow_tiles = tiles;
-      else
-        drawable->tiles = tiles;
+      g_mutex_unlock (&tiles_mutex);
     }
 
   tile_num = row * drawable->ntile_cols + col;
@@ -799,3 +781,51 @@ gimp_drawable_get_format (gint32 drawable_ID)
 
   return format;
 }
+
+
+/*  private functions  */
+
+static GimpTile *
+gimp_drawable_create_tiles (GimpDrawable *drawable,
+                            gboolean      shadow)
+{
+  GimpTile *tiles;
+  guint     right_tile;
+  guint     bottom_tile;
+  gint      n_tiles;
+  gint      i, j, k;
+
+  n_tiles = drawable->ntile_rows * drawable->ntile_cols;
+  tiles = g_new (GimpTile, n_tiles);
+
+  right_tile  = (drawable->width  -
+                 ((drawable->ntile_cols - 1) * TILE_WIDTH));
+  bottom_tile = (drawable->height -
+                 ((drawable->ntile_rows - 1) * TILE_HEIGHT));
+
+  for (i = 0, k = 0; i < drawable->ntile_rows; i++)
+    {
+      for (j = 0; j < drawable->ntile_cols; j++, k++)
+        {
+          tiles[k].bpp       = drawable->bpp;
+          tiles[k].tile_num  = k;
+          tiles[k].ref_count = 0;
+          tiles[k].dirty     = FALSE;
+          tiles[k].shadow    = shadow;
+          tiles[k].data      = NULL;
+          tiles[k].drawable  = drawable;
+
+          if (j == (drawable->ntile_cols - 1))
+            tiles[k].ewidth  = right_tile;
+          else
+            tiles[k].ewidth  = TILE_WIDTH;
+
+          if (i == (drawable->ntile_rows - 1))
+            tiles[k].eheight = bottom_tile;
+          else
+            tiles[k].eheight = TILE_HEIGHT;
+        }
+    }
+
+  return tiles;
+}
@@ -0,0 +1,537 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimpparallel.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#define GIMP_DISABLE_DEPRECATION_WARNINGS
+
+#include "gimp.h"
+#include "gimpparallel.h"
+
+
+/**
+ * SECTION: gimpparallel
+ * @title: gimpparallel
+ * @short_description: Functions to process pixels on several threads.
+ *
+ * The gimpparallel functions run a plug-in's processing function on a
+ * pool of worker threads.  Areas are split into chunks, usually
+ * horizontal bands or tiles, which are processed concurrently and, in
+ * the case of gimp_parallel_process_rgn(), written back to the
+ * drawable in order on the calling thread, which also reports
+ * progress.
+ *
+ * The tile cache is thread-safe, so the processing function may read
+ * pixels using its own #GimpPixelRgn or #GimpPixelFetcher.  Such
+ * objects must not be shared between threads, and the processing
+ * function must not call other procedures of the PDB.  Tiles missing
+ * from the cache are transferred from the core one at a time, while
+ * the other threads keep using the cached ones.
+ **/
+
+
+/*  the number of chunks gimp_parallel_process_rgn() keeps in flight
+ *  per thread, which bounds the memory held by unwritten chunks
+ */
+#define CHUNKS_PER_THREAD 2
+
+
+typedef struct _GimpParallelJob GimpParallelJob;
+
+typedef void (* GimpParallelJobFunc) (GimpParallelJob *job);
+
+struct _GimpParallelJob
+{
+  GimpParallelJobFunc run;
+};
+
+typedef struct
+{
+  GimpParallelDistributeFunc  func;
+  gpointer                    data;
+
+  GMutex                      mutex;
+  GCond                       cond;
+  gint                        n_remaining;
+} GimpParallelDistribute;
+
+typedef struct
+{
+  GimpParallelJob             job;
+  GimpParallelDistribute     *distribute;
+  gint                        i;
+  gint                        n;
+} GimpParallelDistributeJob;
+
+typedef struct
+{
+  guchar                     *buffer;
+  gint                        rowstride;
+  gint                        bpp;
+  gint                        x;
+  gint                        y;
+  gint                        width;
+  gint                        height;
+  gint                        chunk_width;
+  gint                        chunk_height;
+  gint                        n_cols;
+  gint                        n_chunks;
+  gint                        next_chunk;
+  GimpParallelAreaFunc        func;
+  gpointer                    data;
+} GimpParallelBuffer;
+
+typedef struct
+{
+  GimpParallelJob             job;
+  GimpParallelAreaFunc        func;
+  gpointer                    data;
+  GAsyncQueue                *done_queue;
+  gint                        index;
+  gint                        x;
+  gint                        y;
+  gint                        width;
+  gint                        height;
+  gint                        rowstride;
+  guchar                     *dest;
+} GimpParallelChunk;
+
+
+static GThreadPool * gimp_parallel_get_pool       (void);
+static void          gimp_parallel_worker         (GimpParallelJob           *job,
+                                                   gpointer                   unused);
+static void          gimp_parallel_distribute_run (GimpParallelDistributeJob *job);
+static void          gimp_parallel_buffer_func    (gint                       i,
+                                                   gint                       n,
+                                                   GimpParallelBuffer        *buffer);
+static void          gimp_parallel_chunk_run      (GimpParallelChunk         *chunk);
+
+
+static GPrivate parallel_worker_key;
+
+
+/**
+ * gimp_parallel_get_n_threads:
+ *
+ * Returns the number of threads the gimpparallel functions use, which
+ * follows the "num-processors" preference of the GIMP core.  It is
+ * determined once per plug-in process.
+ *
+ * Return value: the number of threads, at least 1.
+ *
+ * Since: 2.10
+ **/
+gint
+gimp_parallel_get_n_threads (void)
+{
+  static gsize n_threads = 0;
+
+  if (g_once_init_enter (&n_threads))
+    {
+      gchar *value;
+      gint   n = 0;
+
+      value = gimp_gimprc_query ("num-processors");
+
+      if (value)
+        n = atoi (value);
+
+      g_free (value);
+
+      if (n <= 0)
+        n = g_get_num_processors ();
+
+      g_once_init_leave (&n_threads, CLAMP (n, 1, 64));
+    }
+
+  return n_threads;
+}
+
+/**
+ * gimp_parallel_distribute:
+ * @max_n: the maximal number of threads to use
+ * @func:  the function to call
+ * @data:  user data to pass to @func
+ *
+ * Calls @func concurrently on n threads, where n is at most @max_n
+ * and gimp_parallel_get_n_threads(), passing each call its index i,
+ * in the range [0, n), and n.  The calling thread takes part in the
+ * work, and the function returns once all calls have returned.
+ *
+ * When called from within another gimpparallel function, @func is
+ * called once on the calling thread, with n being 1.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_parallel_distribute (gint                       max_n,
+                          GimpParallelDistributeFunc func,
+                          gpointer                   data)
+{
+  GimpParallelDistribute     distribute;
+  GimpParallelDistributeJob *jobs;
+  gint                       n;
+  gint                       i;
+
+  g_return_if_fail (func != NULL);
+
+  n = MIN (max_n, gimp_parallel_get_n_threads ());
+
+  if (n <= 1 || g_private_get (&parallel_worker_key))
+    {
+      func (0, 1, data);
+
+      return;
+    }
+
+  distribute.func        = func;
+  distribute.data        = data;
+  distribute.n_remaining = n - 1;
+
+  g_mutex_init (&distribute.mutex);
+  g_cond_init (&distribute.cond);
+
+  jobs = g_new (GimpParallelDistributeJob, n - 1);
+
+  for (i = 1; i < n; i++)
+    {
+      GimpParallelDistributeJob *job = &jobs[i - 1];
+
+      job->job.run    = (GimpParallelJobFunc) gimp_parallel_distribute_run;
+      job->distribute = &distribute;
+      job->i          = i;
+      job->n          = n;
+
+      g_thread_pool_push (gimp_parallel_get_pool (), job, NULL);
+    }
+
+  /*  nested calls from the calling thread would wait for the pool,
+   *  which is busy with this call
+   */
+  g_private_set (&parallel_worker_key, GINT_TO_POINTER (TRUE));
+  func (0, n, data);
+  g_private_set (&parallel_worker_key, NULL);
+
+  g_mutex_lock (&distribute.mutex);
+
+  while (distribute.n_remaining > 0)
+    g_cond_wait (&distribute.cond, &distribute.mutex);
+
+  g_mutex_unlock (&distribute.mutex);
+
+  g_free (jobs);
+
+  g_cond_clear (&distribute.cond);
+  g_mutex_clear (&distribute.mutex);
+}
+
+/**
+ * gimp_parallel_process_buffer:
+ * @buffer:       the pixels of the area
+ * @rowstride:    the rowstride of @buffer
+ * @bpp:          the number of bytes per pixel of @buffer
+ * @x:            the x coordinate of the area's upper left corner
+ * @y:            the y coordinate of the area's upper left corner
+ * @width:        the width of the area
+ * @height:       the height of the area
+ * @chunk_width:  the width of the chunks, or 0 for the width of the area
+ * @chunk_height: the height of the chunks, or 0 for the tile height
+ * @func:         the function to call for each chunk
+ * @data:         user data to pass to @func
+ *
+ * Splits the area into chunks and calls @func concurrently for each
+ * chunk, with the chunk's position and size, and a pointer to the
+ * chunk's first pixel in @buffer, which @func fills.  This is useful
+ * for rendering previews, @x and @y are only passed on to @func.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_parallel_process_buffer (guchar               *buffer,
+                              gint                  rowstride,
+                              gint                  bpp,
+                              gint                  x,
+                              gint                  y,
+                              gint                  width,
+                              gint                  height,
+                              gint                  chunk_width,
+                              gint                  chunk_height,
+                              GimpParallelAreaFunc  func,
+                              gpointer              data)
+{
+  GimpParallelBuffer info;
+
+  g_return_if_fail (buffer != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  if (chunk_width <= 0)
+    chunk_width = width;
+
+  if (chunk_height <= 0)
+    chunk_height = gimp_tile_height ();
+
+  info.buffer       = buffer;
+  info.rowstride    = rowstride;
+  info.bpp          = bpp;
+  info.x            = x;
+  info.y            = y;
+  info.width        = width;
+  info.height       = height;
+  info.chunk_width  = chunk_width;
+  info.chunk_height = chunk_height;
+  info.n_cols       = (width  + chunk_width  - 1) / chunk_width;
+  info.n_chunks     = (height + chunk_height - 1) / chunk_height *
+                      info.n_cols;
+  info.next_chunk   = 0;
+  info.func         = func;
+  info.data         = data;
+
+  gimp_parallel_distribute (info.n_chunks,
+                            (GimpParallelDistributeFunc)
+                            gimp_parallel_buffer_func,
+                            &info);
+}
+
+/**
+ * gimp_parallel_process_rgn:
+ * @dest_rgn:     the #GimpPixelRgn to write to
+ * @chunk_width:  the width of the chunks, or 0 for the width of the region
+ * @chunk_height: the height of the chunks, or 0 for the tile height
+ * @func:         the function to call for each chunk
+ * @data:         user data to pass to @func
+ *
+ * Splits the area of @dest_rgn into chunks and calls @func for each
+ * chunk on the worker threads, with the chunk's position and size,
+ * and a buffer of @dest_rgn's bytes per pixel, which @func fills.
+ *
+ * The chunks are written to @dest_rgn on the calling thread, in
+ * order from top to bottom, which also updates the progress.  Only a
+ * few chunks per thread are processed ahead of the one written next,
+ * so a large region is never held in memory completely.
+ *
+ * As with the other ways of writing to a drawable, the caller still
+ * has to flush the drawable, and merge its shadow and update it if
+ * @dest_rgn writes to the shadow tiles.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_parallel_process_rgn (GimpPixelRgn         *dest_rgn,
+                           gint                  chunk_width,
+                           gint                  chunk_height,
+                           GimpParallelAreaFunc  func,
+                           gpointer              data)
+{
+  GimpParallelChunk **chunks;
+  GAsyncQueue        *done_queue;
+  gint                n_cols;
+  gint                n_chunks;
+  gint                max_running;
+  gint                n_started = 0;
+  gint                n_written = 0;
+  gint                total_area;
+  gint                area_so_far = 0;
+  gdouble             last_progress = 0.0;
+
+  g_return_if_fail (dest_rgn != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (dest_rgn->w <= 0 || dest_rgn->h <= 0)
+    return;
+
+  if (chunk_width <= 0)
+    chunk_width = dest_rgn->w;
+
+  if (chunk_height <= 0)
+    chunk_height = gimp_tile_height ();
+
+  n_cols     = (dest_rgn->w + chunk_width  - 1) / chunk_width;
+  n_chunks   = (dest_rgn->h + chunk_height - 1) / chunk_height * n_cols;
+  total_area = dest_rgn->w * dest_rgn->h;
+
+  if (g_private_get (&parallel_worker_key))
+    max_running = 1;
+  else
+    max_running = gimp_parallel_get_n_threads () * CHUNKS_PER_THREAD;
+
+  chunks     = g_new0 (GimpParallelChunk *, n_chunks);
+  done_queue = g_async_queue_new ();
+
+  while (n_written < n_chunks)
+    {
+      GimpParallelChunk *chunk;
+
+      /*  keep the workers busy, but don't run too far ahead of the
+       *  chunk which is written next
+       */
+      while (n_started < n_chunks &&
+             n_started - n_written < max_running)
+        {
+          gint col = n_started % n_cols;
+          gint row = n_started / n_cols;
+
+          chunk = g_slice_new (GimpParallelChunk);
+
+          chunk->job.run    = (GimpParallelJobFunc) gimp_parallel_chunk_run;
+          chunk->func       = func;
+          chunk->data       = data;
+          chunk->done_queue = done_queue;
+          chunk->index      = n_started;
+          chunk->x          = dest_rgn->x + col * chunk_width;
+          chunk->y          = dest_rgn->y + row * chunk_height;
+          chunk->width      = MIN (chunk_width,
+                                   dest_rgn->x + dest_rgn->w - chunk->x);
+          chunk->height     = MIN (chunk_height,
+                                   dest_rgn->y + dest_rgn->h - chunk->y);
+          chunk->rowstride  = chunk->width * dest_rgn->bpp;
+          chunk->dest       = g_malloc (chunk->rowstride * chunk->height);
+
+          if (max_running > 1)
+            g_thread_pool_push (gimp_parallel_get_pool (), chunk, NULL);
+          else
+            gimp_parallel_chunk_run (chunk);
+
+          n_started++;
+        }
+
+      chunk = g_async_queue_pop (done_queue);
+
+      chunks[chunk->index] = chunk;
+
+      /*  write back all chunks which are next in order  */
+      while (n_written < n_chunks && chunks[n_written])
+        {
+          gdouble progress;
+
+          chunk = chunks[n_written];
+
+          gimp_pixel_rgn_set_rect (dest_rgn, chunk->dest,
+                                   chunk->x, chunk->y,
+                                   chunk->width, chunk->height);
+
+          area_so_far += chunk->width * chunk->height;
+
+          g_free (chunk->dest);
+          g_slice_free (GimpParallelChunk, chunk);
+
+          chunks[n_written++] = NULL;
+
+          progress = (gdouble) area_so_far / (gdouble) total_area;
+
+          if (progress - last_progress >= 0.01 || n_written == n_chunks)
+            {
+              gimp_progress_update (progress);
+              last_progress = progress;
+            }
+        }
+    }
+
+  g_async_queue_unref (done_queue);
+  g_free (chunks);
+}
+
+
+/*  private functions  */
+
+static GThreadPool *
+gimp_parallel_get_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool;
+
+      new_pool = g_thread_pool_new ((GFunc) gimp_parallel_worker, NULL,
+                                    gimp_parallel_get_n_threads (),
+                                    FALSE, NULL);
+
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
+static void
+gimp_parallel_worker (GimpParallelJob *job,
+                      gpointer         unused)
+{
+  g_private_set (&parallel_worker_key, GINT_TO_POINTER (TRUE));
+
+  job->run (job);
+}
+
+static void
+gimp_parallel_distribute_run (GimpParallelDistributeJob *job)
+{
+  GimpParallelDistribute *distribute = job->distribute;
+
+  distribute->func (job->i, job->n, distribute->data);
+
+  g_mutex_lock (&distribute->mutex);
+
+  if (--distribute->n_remaining == 0)
+    g_cond_signal (&distribute->cond);
+
+  g_mutex_unlock (&distribute->mutex);
+}
+
+static void
+gimp_parallel_buffer_func (gint                i,
+                           gint                n,
+                           GimpParallelBuffer *info)
+{
+  gint index;
+
+  /*  the threads take the chunks one by one, so that they finish at
+   *  about the same time even if some chunks are slower than others
+   */
+  while ((index = g_atomic_int_add (&info->next_chunk, 1)) < info->n_chunks)
+    {
+      gint col    = index % info->n_cols;
+      gint row    = index / info->n_cols;
+      gint x      = col * info->chunk_width;
+      gint y      = row * info->chunk_height;
+      gint width  = MIN (info->chunk_width,  info->width - x);
+      gint height = MIN (info->chunk_height, info->height - y);
+
+      info->func (info->x + x, info->y + y, width, height,
+                  info->buffer + y * info->rowstride + x * info->bpp,
+                  info->rowstride,
+                  info->data);
+    }
+}
+
+static void
+gimp_parallel_chunk_run (GimpParallelChunk *chunk)
+{
+  chunk->func (chunk->x, chunk->y, chunk->width, chunk->height,
+               chunk->dest, chunk->rowstride,
+               chunk->data);
+
+  g_async_queue_push (chunk->done_queue, chunk);
+}
@@ -0,0 +1,71 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimpparallel.h
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined (__GIMP_H_INSIDE__) && !defined (GIMP_COMPILATION)
+#error "Only <libgimp/gimp.h> can be included directly."
+#endif
+
+#ifndef __GIMP_PARALLEL_H__
+#define __GIMP_PARALLEL_H__
+
+G_BEGIN_DECLS
+
+/* For information look into the C source or the html documentation */
+
+
+typedef void (* GimpParallelDistributeFunc) (gint      i,
+                                             gint      n,
+                                             gpointer  data);
+typedef void (* GimpParallelAreaFunc)       (gint      x,
+                                             gint      y,
+                                             gint      width,
+                                             gint      height,
+                                             guchar   *dest,
+                                             gint      rowstride,
+                                             gpointer  data);
+
+
+gint   gimp_parallel_get_n_threads  (void);
+
+void   gimp_parallel_distribute     (gint                        max_n,
+                                     GimpParallelDistributeFunc  func,
+                                     gpointer                    data);
+
+void   gimp_parallel_process_buffer (guchar                     *buffer,
+                                     gint                        rowstride,
+                                     gint                        bpp,
+                                     gint                        x,
+                                     gint                        y,
+                                     gint                        width,
+                                     gint                        height,
+                                     gint                        chunk_width,
+                                     gint                        chunk_height,
+                                     GimpParallelAreaFunc        func,
+                                     gpointer                    data);
+void   gimp_parallel_process_rgn    (GimpPixelRgn               *dest_rgn,
+                                     gint                        chunk_width,
+                                     gint                        chunk_height,
+                                     GimpParallelAreaFunc        func,
+                                     gpointer                    data);
+
+
+G_END_DECLS
+
+#endif /* __GIMP_PARALLEL_H__ */
@@ -0,0 +1,509 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimppdbbatch.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#define GIMP_DISABLE_DEPRECATION_WARNINGS
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
+#include "gimp.h"
+#include "gimppdbbatch.h"
+
+
+/**
+ * SECTION: gimppdbbatch
+ * @title: gimppdbbatch
+ * @short_description: Functions to run many procedures of the PDB in
+ *                     one round trip.
+ *
+ * Every call of gimp_run_procedure2() waits for GIMP to answer before
+ * the plug-in can go on, so plug-ins and scripts that make thousands
+ * of small calls spend most of their time waiting on the pipe.
+ *
+ * A #GimpPDBBatch collects procedure calls and sends them to GIMP in
+ * chunks, as one message each.  GIMP runs the calls of a chunk in the
+ * order they were added and answers with all their return values in
+ * one message.  Sending a chunk doesn't wait for the answer, so GIMP
+ * runs one chunk while the plug-in prepares the next; the answer is
+ * only waited for when a return value is asked for, or before the
+ * plug-in talks to GIMP in any other way.
+ *
+ * Calls added to a batch must not depend on each other's return
+ * values, and the return values of a failed call don't stop the
+ * following calls from running.
+ *
+ * A call may run a temporary procedure of the plug-in itself.  The
+ * calls that procedure makes don't wait for the batch, but it must
+ * not send the batch that called it.
+ **/
+
+
+/*  the number of calls gimp_pdb_batch_add() collects before it sends
+ *  them on its own
+ */
+#define CHUNK_SIZE 256
+
+
+struct _GimpPDBBatch
+{
+  GArray *queue;       /* GPProcRun, the calls not sent yet             */
+  GArray *returns;     /* GPProcReturn, one for each call sent          */
+  gint    n_sent;      /* the number of calls sent                      */
+  gint    n_returned;  /* the number of calls whose return values came  */
+};
+
+
+void         gimp_read_expect_msg       (GimpWireMessage   *msg,
+                                         gint               type);
+void         _gimp_pdb_batch_sync       (void);
+void         _gimp_pdb_batch_return     (GPProcReturnBatch *proc_return_batch);
+
+static void  gimp_pdb_batch_copy_params (GPParam           *dest,
+                                         const GimpParam   *src,
+                                         gint               n_params);
+
+
+/*  only one chunk is in flight at a time, which keeps the answers in
+ *  order and GIMP from blocking on a pipe the plug-in doesn't read
+ */
+static GimpPDBBatch *pending_batch  = NULL;
+static guint32       pending_serial = 0;
+static guint32       next_serial    = 1;
+
+
+/*  public functions  */
+
+/**
+ * gimp_pdb_batch_new:
+ *
+ * Creates a new, empty batch of procedure calls.
+ *
+ * Return value: the new #GimpPDBBatch. Free it with
+ * gimp_pdb_batch_free().
+ *
+ * Since: 2.10
+ **/
+GimpPDBBatch *
+gimp_pdb_batch_new (void)
+{
+  GimpPDBBatch *batch = g_slice_new0 (GimpPDBBatch);
+
+  batch->queue   = g_array_new (FALSE, TRUE, sizeof (GPProcRun));
+  batch->returns = g_array_new (FALSE, TRUE, sizeof (GPProcReturn));
+
+  return batch;
+}
+
+/**
+ * gimp_pdb_batch_free:
+ * @batch: a #GimpPDBBatch
+ *
+ * Frees @batch and the return values of its calls.  Calls that were
+ * added but not sent yet are discarded; use gimp_pdb_batch_run() or
+ * gimp_pdb_batch_send() first to make sure they run.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_pdb_batch_free (GimpPDBBatch *batch)
+{
+  gint i;
+
+  g_return_if_fail (batch != NULL);
+
+  gp_lock ();
+  if (pending_batch == batch)
+    _gimp_pdb_batch_sync ();
+  gp_unlock ();
+
+  for (i = 0; i < batch->queue->len; i++)
+    {
+      GPProcRun *proc_run = &g_array_index (batch->queue, GPProcRun, i);
+
+      gp_params_destroy (proc_run->params, proc_run->nparams);
+      g_free (proc_run->name);
+    }
+
+  for (i = 0; i < batch->returns->len; i++)
+    {
+      GPProcReturn *proc_return = &g_array_index (batch->returns,
+                                                  GPProcReturn, i);
+
+      gp_params_destroy (proc_return->params, proc_return->nparams);
+      g_free (proc_return->name);
+    }
+
+  g_array_free (batch->queue, TRUE);
+  g_array_free (batch->returns, TRUE);
+
+  g_slice_free (GimpPDBBatch, batch);
+}
+
+/**
+ * gimp_pdb_batch_add:
+ * @batch:    a #GimpPDBBatch
+ * @name:     the name of the procedure to run
+ * @n_params: the number of parameters the procedure takes
+ * @params:   the procedure's parameters array
+ *
+ * Adds a call of the procedure @name to @batch.  The parameters are
+ * copied, like gimp_run_procedure2() the length of an array parameter
+ * is taken from the %GIMP_PDB_INT32 parameter right before it.
+ *
+ * Once enough calls have been added, they are sent to GIMP without
+ * waiting for gimp_pdb_batch_send().
+ *
+ * Return value: the index of the call in @batch, to be passed to
+ * gimp_pdb_batch_get_return_vals().
+ *
+ * Since: 2.10
+ **/
+gint
+gimp_pdb_batch_add (GimpPDBBatch    *batch,
+                    const gchar     *name,
+                    gint             n_params,
+                    const GimpParam *params)
+{
+  GPProcRun proc_run;
+  gint      index;
+
+  g_return_val_if_fail (batch != NULL, -1);
+  g_return_val_if_fail (name != NULL, -1);
+  g_return_val_if_fail (n_params == 0 || params != NULL, -1);
+
+  proc_run.name    = g_strdup (name);
+  proc_run.nparams = n_params;
+  proc_run.params  = g_new0 (GPParam, n_params);
+
+  gimp_pdb_batch_copy_params (proc_run.params, params, n_params);
+
+  g_array_append_val (batch->queue, proc_run);
+
+  index = batch->n_sent + batch->queue->len - 1;
+
+  if (batch->queue->len >= CHUNK_SIZE)
+    gimp_pdb_batch_send (batch);
+
+  return index;
+}
+
+/**
+ * gimp_pdb_batch_send:
+ * @batch: a #GimpPDBBatch
+ *
+ * Sends the calls added to @batch since it was last sent to GIMP,
+ * without waiting for them to run.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_pdb_batch_send (GimpPDBBatch *batch)
+{
+  extern GIOChannel *_writechannel;
+
+  GPProcRunBatch proc_run_batch;
+  gint           i;
+
+  g_return_if_fail (batch != NULL);
+
+  if (batch->queue->len == 0)
+    return;
+
+  proc_run_batch.nruns = batch->queue->len;
+  proc_run_batch.runs  = (GPProcRun *) batch->queue->data;
+
+  gp_lock ();
+  _gimp_pdb_batch_sync ();
+
+  /*  a chunk of the batch is still in flight if it called the
+   *  procedure we are running in, which has to return first
+   */
+  if (batch->n_returned < batch->n_sent)
+    {
+      gp_unlock ();
+
+      g_warning ("%s: the batch called the running procedure and can't "
+                 "be sent from it", G_STRFUNC);
+      return;
+    }
+
+  proc_run_batch.serial = next_serial++;
+
+  if (! gp_proc_run_batch_write (_writechannel, &proc_run_batch, NULL))
+    gimp_quit ();
+
+  pending_batch  = batch;
+  pending_serial = proc_run_batch.serial;
+
+  batch->n_sent += proc_run_batch.nruns;
+  g_array_set_size (batch->returns, batch->n_sent);
+  gp_unlock ();
+
+  for (i = 0; i < proc_run_batch.nruns; i++)
+    {
+      gp_params_destroy (proc_run_batch.runs[i].params,
+                         proc_run_batch.runs[i].nparams);
+      g_free (proc_run_batch.runs[i].name);
+    }
+
+  g_array_set_size (batch->queue, 0);
+}
+
+/**
+ * gimp_pdb_batch_run:
+ * @batch: a #GimpPDBBatch
+ *
+ * Sends the calls added to @batch since it was last sent to GIMP and
+ * waits until all calls of @batch have run.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_pdb_batch_run (GimpPDBBatch *batch)
+{
+  g_return_if_fail (batch != NULL);
+
+  gimp_pdb_batch_send (batch);
+
+  gp_lock ();
+  if (pending_batch == batch)
+    _gimp_pdb_batch_sync ();
+  gp_unlock ();
+}
+
+/**
+ * gimp_pdb_batch_get_n_calls:
+ * @batch: a #GimpPDBBatch
+ *
+ * Return value: the number of calls added to @batch.
+ *
+ * Since: 2.10
+ **/
+gint
+gimp_pdb_batch_get_n_calls (GimpPDBBatch *batch)
+{
+  g_return_val_if_fail (batch != NULL, 0);
+
+  return batch->n_sent + batch->queue->len;
+}
+
+/**
+ * gimp_pdb_batch_get_return_vals:
+ * @batch:         a #GimpPDBBatch
+ * @index:         the index of a call, as returned by gimp_pdb_batch_add()
+ * @n_return_vals: return location for the number of return values
+ *
+ * Returns the return values of a call in @batch, running the batch
+ * first if the call has not run yet.  Like for gimp_run_procedure2(),
+ * the zero-th return value is the call's status.
+ *
+ * Return value: the call's return values. They belong to @batch and
+ * must not be freed.
+ *
+ * Since: 2.10
+ **/
+const GimpParam *
+gimp_pdb_batch_get_return_vals (GimpPDBBatch *batch,
+                                gint          index,
+                                gint         *n_return_vals)
+{
+  GPProcReturn *proc_return;
+
+  g_return_val_if_fail (batch != NULL, NULL);
+  g_return_val_if_fail (index >= 0 &&
+                        index < gimp_pdb_batch_get_n_calls (batch), NULL);
+  g_return_val_if_fail (n_return_vals != NULL, NULL);
+
+  if (index >= batch->n_returned)
+    gimp_pdb_batch_run (batch);
+
+  proc_return = &g_array_index (batch->returns, GPProcReturn, index);
+
+  *n_return_vals = proc_return->nparams;
+
+  return (const GimpParam *) proc_return->params;
+}
+
+
+/*  internal functions  */
+
+/*  Waits for the answer to the chunk in flight, if any.  Must be called
+ *  with the wire locked, before writing anything GIMP answers to.
+ *
+ *  The chunk may call a temporary procedure of this plug-in, which is
+ *  run from gimp_read_expect_msg() while we wait.  GIMP answers the
+ *  calls it makes before the chunk, which can't finish before the
+ *  procedure returns, so the chunk is hidden from them meanwhile
+ *  instead of letting them wait for it.  gimp_temp_proc_run() collects
+ *  the answers to their own chunks before the procedure returns.
+ */
+void
+_gimp_pdb_batch_sync (void)
+{
+  while (pending_batch)
+    {
+      GimpPDBBatch    *batch  = pending_batch;
+      guint32          serial = pending_serial;
+      GimpWireMessage  msg;
+
+      pending_batch = NULL;
+
+      gimp_read_expect_msg (&msg, GP_PROC_RETURN_BATCH);
+
+      pending_batch  = batch;
+      pending_serial = serial;
+
+      _gimp_pdb_batch_return (msg.data);
+
+      gimp_wire_destroy (&msg);
+
+      /*  the answer didn't match the chunk, don't wait forever  */
+      if (pending_batch)
+        gimp_quit ();
+    }
+}
+
+void
+_gimp_pdb_batch_return (GPProcReturnBatch *proc_return_batch)
+{
+  GimpPDBBatch *batch = pending_batch;
+  gint          start;
+  gint          i;
+
+  if (! batch             ||
+      ! proc_return_batch ||
+      proc_return_batch->serial   != pending_serial ||
+      proc_return_batch->nreturns != batch->n_sent - batch->n_returned)
+    {
+      g_warning ("unexpected proc return batch message received "
+                 "(should not happen)");
+      return;
+    }
+
+  start = batch->n_sent - proc_return_batch->nreturns;
+
+  for (i = 0; i < proc_return_batch->nreturns; i++)
+    {
+      GPProcReturn *src  = &proc_return_batch->returns[i];
+      GPProcReturn *dest = &g_array_index (batch->returns,
+                                           GPProcReturn, start + i);
+
+      /*  steal the return values from the message  */
+      *dest = *src;
+
+      src->name    = NULL;
+      src->nparams = 0;
+      src->params  = NULL;
+    }
+
+  batch->n_returned = batch->n_sent;
+
+  pending_batch = NULL;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_pdb_batch_copy_params (GPParam         *dest,
+                            const GimpParam *src,
+                            gint             n_params)
+{
+  gint i;
+
+  for (i = 0; i < n_params; i++)
+    {
+      gint count = 0;
+
+      if (i > 0 && src[i - 1].type == GIMP_PDB_INT32)
+        count = MAX (src[i - 1].data.d_int32, 0);
+
+      dest[i].type = src[i].type;
+      memcpy (&dest[i].data, &src[i].data, sizeof (dest[i].data));
+
+      switch (src[i].type)
+        {
+        case GIMP_PDB_STRING:
+          dest[i].data.d_string = g_strdup (src[i].data.d_string);
+          break;
+
+        case GIMP_PDB_INT32ARRAY:
+          dest[i].data.d_int32array =
+            g_memdup (src[i].data.d_int32array, count * sizeof (gint32));
+          break;
+
+        case GIMP_PDB_INT16ARRAY:
+          dest[i].data.d_int16array =
+            g_memdup (src[i].data.d_int16array, count * sizeof (gint16));
+          break;
+
+        case GIMP_PDB_INT8ARRAY:
+          dest[i].data.d_int8array =
+            g_memdup (src[i].data.d_int8array, count);
+          break;
+
+        case GIMP_PDB_FLOATARRAY:
+          dest[i].data.d_floatarray =
+            g_memdup (src[i].data.d_floatarray, count * sizeof (gdouble));
+          break;
+
+        case GIMP_PDB_STRINGARRAY:
+          /*  gp_params_destroy() only frees string arrays with a count  */
+          if (i > 0 && src[i - 1].type == GIMP_PDB_INT32)
+            {
+              gint j;
+
+              dest[i].data.d_stringarray = g_new0 (gchar *, count + 1);
+
+              for (j = 0; j < count; j++)
+                dest[i].data.d_stringarray[j] =
+                  g_strdup (src[i].data.d_stringarray[j]);
+            }
+          else
+            {
+              dest[i].data.d_stringarray = NULL;
+            }
+          break;
+
+        case GIMP_PDB_COLORARRAY:
+          dest[i].data.d_colorarray =
+            g_memdup (src[i].data.d_colorarray, count * sizeof (GimpRGB));
+          break;
+
+        case GIMP_PDB_PARASITE:
+          dest[i].data.d_parasite.name =
+            g_strdup (src[i].data.d_parasite.name);
+          dest[i].data.d_parasite.data =
+            g_memdup (src[i].data.d_parasite.data,
+                      src[i].data.d_parasite.size);
+          break;
+
+        default:
+          break;
+        }
+    }
+}
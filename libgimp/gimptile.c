@@ -51,18 +51,35 @@
 
 void         gimp_read_expect_msg   (GimpWireMessage *msg,
                                      gint             type);
+void         _gimp_pdb_batch_sync   (void);
 
 static void  gimp_tile_get          (GimpTile        *tile);
 static void  gimp_tile_put          (GimpTile        *tile);
-static void  gimp_tile_cache_insert (GimpTile        *tile);
-static void  gimp_tile_cache_flush  (GimpTile        *tile);
+static void  gimp_tile_wait         (GimpTile        *tile);
+static void  gimp_tile_transfer     (GimpTile        *tile,
+                                     void           (*func) (GimpTile *tile));
+static void  gimp_tile_unref_list   (GSList          *tiles);
+static void  gimp_tile_cache_insert (GimpTile        *tile,
+                                     GSList         **evicted);
+static void  gimp_tile_cache_flush  (GimpTile        *tile,
+                                     GSList         **evicted);
 
 
 /*  private variables  */
 
-static GHashTable * tile_hash_table = NULL;
-static GList      * tile_list_head  = NULL;
-static GList      * tile_list_tail  = NULL;
+/*  guards the tile cache and the reference counts and data of all
+ *  tiles, so that tiles can be used from several threads.  it is not
+ *  held while a tile is transferred to or from the core, so that the
+ *  other threads can keep using the cached tiles meanwhile; a tile in
+ *  transfer is in tile_transfers, and tile_cond is signalled when a
+ *  transfer ends.
+ */
+static GMutex       tile_mutex;
+static GCond        tile_cond;
+static GHashTable * tile_transfers  = NULL;
+
+static GHashTable * tile_hash_table = NULL;  /* tile -> link in tile_queue */
+static GQueue       tile_queue      = G_QUEUE_INIT;
 static gulong       max_tile_size   = 0;
 static gulong       cur_cache_size  = 0;
 static gulong       max_cache_size  = 0;
@@ -73,30 +90,50 @@ static gulong       max_cache_size  = 0;
 void
 gimp_tile_ref (GimpTile *tile)
 {
+  GSList *evicted = NULL;
+
   g_return_if_fail (tile != NULL);
 
+  g_mutex_lock (&tile_mutex);
+
+  gimp_tile_wait (tile);
+
   tile->ref_count++;
 
   if (tile->ref_count == 1)
     {
-      gimp_tile_get (tile);
+      gimp_tile_transfer (tile, gimp_tile_get);
       tile->dirty = FALSE;
     }
 
-  gimp_tile_cache_insert (tile);
+  gimp_tile_cache_insert (tile, &evicted);
+
+  g_mutex_unlock (&tile_mutex);
+
+  gimp_tile_unref_list (evicted);
 }
 
 void
 gimp_tile_ref_zero (GimpTile *tile)
 {
+  GSList *evicted = NULL;
+
   g_return_if_fail (tile != NULL);
 
+  g_mutex_lock (&tile_mutex);
+
+  gimp_tile_wait (tile);
+
   tile->ref_count++;
 
   if (tile->ref_count == 1)
     tile->data = g_new0 (guchar, tile->ewidth * tile->eheight * tile->bpp);
 
-  gimp_tile_cache_insert (tile);
+  gimp_tile_cache_insert (tile, &evicted);
+
+  g_mutex_unlock (&tile_mutex);
+
+  gimp_tile_unref_list (evicted);
 }
 
 void
@@ -106,15 +143,26 @@ gimp_tile_unref (GimpTile *tile,
   g_return_if_fail (tile != NULL);
   g_return_if_fail (tile->ref_count > 0);
 
+  g_mutex_lock (&tile_mutex);
+
+  gimp_tile_wait (tile);
+
   tile->ref_count--;
   tile->dirty |= dirty;
 
   if (tile->ref_count == 0)
     {
-      gimp_tile_flush (tile);
+      if (tile->data && tile->dirty)
+        {
+          gimp_tile_transfer (tile, gimp_tile_put);
+          tile->dirty = FALSE;
+        }
+
       g_free (tile->data);
       tile->data = NULL;
     }
+
+  g_mutex_unlock (&tile_mutex);
 }
 
 void
@@ -122,11 +170,17 @@ gimp_tile_flush (GimpTile *tile)
 {
   g_return_if_fail (tile != NULL);
 
+  g_mutex_lock (&tile_mutex);
+
+  gimp_tile_wait (tile);
+
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
+      gimp_tile_transfer (tile, gimp_tile_put);
       tile->dirty = FALSE;
     }
+
+  g_mutex_unlock (&tile_mutex);
 }
 
 /**
@@ -140,7 +194,11 @@ gimp_tile_flush (GimpTile *tile)
 void
 gimp_tile_cache_size (gulong kilobytes)
 {
+  g_mutex_lock (&tile_mutex);
+
   max_cache_size = kilobytes * 1024;
+
+  g_mutex_unlock (&tile_mutex);
 }
 
 /**
@@ -168,11 +226,14 @@ gimp_tile_cache_ntiles (gulong ntiles)
 void
 _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 {
-  GList *list;
+  GSList *evicted = NULL;
+  GList  *list;
 
   g_return_if_fail (drawable != NULL);
 
-  list = tile_list_head;
+  g_mutex_lock (&tile_mutex);
+
+  list = tile_queue.head;
   while (list)
     {
       GimpTile *tile = list->data;
@@ -180,8 +241,12 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
       list = list->next;
 
       if (tile->drawable == drawable)
-        gimp_tile_cache_flush (tile);
+        gimp_tile_cache_flush (tile, &evicted);
     }
+
+  g_mutex_unlock (&tile_mutex);
+
+  gimp_tile_unref_list (evicted);
 }
 
 
@@ -201,6 +266,8 @@ gimp_tile_get (GimpTile *tile)
   tile_req.shadow      = tile->shadow;
 
   gp_lock ();
+  _gimp_pdb_batch_sync ();
+
   if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
     gimp_quit ();
 
@@ -251,6 +318,8 @@ gimp_tile_put (GimpTile *tile)
   tile_req.shadow      = 0;
 
   gp_lock ();
+  _gimp_pdb_batch_sync ();
+
   if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
     gimp_quit ();
 
@@ -287,13 +356,70 @@ gimp_tile_put (GimpTile *tile)
   gimp_wire_destroy (&msg);
 }
 
+/*  waits until 'tile' is not transferred by another thread.  must be
+ *  called with tile_mutex held.
+ */
+static void
+gimp_tile_wait (GimpTile *tile)
+{
+  while (tile_transfers && g_hash_table_contains (tile_transfers, tile))
+    g_cond_wait (&tile_cond, &tile_mutex);
+}
+
+/*  calls 'func' to transfer 'tile' without holding tile_mutex, which
+ *  must be held when calling this.  other threads using 'tile' wait
+ *  until the transfer is done.
+ */
+static void
+gimp_tile_transfer (GimpTile  *tile,
+                    void     (*func) (GimpTile *tile))
+{
+  if (! tile_transfers)
+    tile_transfers = g_hash_table_new (g_direct_hash, NULL);
+
+  g_hash_table_add (tile_transfers, tile);
+
+  g_mutex_unlock (&tile_mutex);
+
+  func (tile);
+
+  g_mutex_lock (&tile_mutex);
+
+  g_hash_table_remove (tile_transfers, tile);
+
+  g_cond_broadcast (&tile_cond);
+}
+
+/*  drops the cache's references of the tiles evicted from it, which
+ *  may write them back to the core, so it must be called without
+ *  holding tile_mutex.
+ */
+static void
+gimp_tile_unref_list (GSList *tiles)
+{
+  GSList *list;
+
+  for (list = tiles; list; list = g_slist_next (list))
+    gimp_tile_unref (list->data, FALSE);
+
+  g_slist_free (tiles);
+}
+
 /* This function is nearly identical to the function 'tile_cache_insert'
  *  in the file 'tile_cache.c' which is part of the main gimp application.
+ *
+ *  The cache is a queue ordered from the least to the most recently
+ *  used tile, the hash table maps each cached tile to its link in the
+ *  queue, so that all operations are O(1).  Must be called with
+ *  tile_mutex held, the tiles evicted to make room are added to
+ *  'evicted' and must be passed to gimp_tile_unref_list() after
+ *  releasing it.
  */
 static void
-gimp_tile_cache_insert (GimpTile *tile)
+gimp_tile_cache_insert (GimpTile  *tile,
+                        GSList   **evicted)
 {
-  GList *list;
+  GList *link;
 
   if (!tile_hash_table)
     {
@@ -303,27 +429,21 @@ gimp_tile_cache_insert (GimpTile *tile)
 
   /* First check and see if the tile is already
    *  in the cache. In that case we will simply place
-   *  it at the end of the tile list to indicate that
+   *  it at the end of the tile queue to indicate that
    *  it was the most recently accessed tile.
    */
-  list = g_hash_table_lookup (tile_hash_table, tile);
+  link = g_hash_table_lookup (tile_hash_table, tile);
 
-  if (list)
+  if (link)
     {
-      /* The tile was already in the cache. Place it at
-       *  the end of the tile list.
+      /* The tile was already in the cache. Move it to
+       *  the end of the tile queue.
        */
-
-      /* If the tile is already at the end of the list, we are done */
-      if (list == tile_list_tail)
-        return;
-
-      /* At this point we have at least two elements in our list */
-      g_assert (tile_list_head != tile_list_tail);
-
-      tile_list_head = g_list_remove_link (tile_list_head, list);
-
-      tile_list_tail = g_list_last (g_list_concat (tile_list_tail, list));
+      if (link != tile_queue.tail)
+        {
+          g_queue_unlink (&tile_queue, link);
+          g_queue_push_tail_link (&tile_queue, link);
+        }
     }
   else
     {
@@ -336,29 +456,24 @@ gimp_tile_cache_insert (GimpTile *tile)
 
       if ((cur_cache_size + max_tile_size) > max_cache_size)
         {
-          while (tile_list_head &&
+          while (tile_queue.head &&
                  (cur_cache_size +
                   max_cache_size * FREE_QUANTUM) > max_cache_size)
             {
-              gimp_tile_cache_flush ((GimpTile *) tile_list_head->data);
+              gimp_tile_cache_flush ((GimpTile *) tile_queue.head->data,
+                                     evicted);
             }
 
           if ((cur_cache_size + max_tile_size) > max_cache_size)
             return;
         }
 
-      /* Place the tile at the end of the tile list.
+      /* Place the tile at the end of the tile queue, and add
+       *  its link to the tile hash table.
        */
-      tile_list_tail = g_list_append (tile_list_tail, tile);
-
-      if (! tile_list_head)
-        tile_list_head = tile_list_tail;
+      g_queue_push_tail (&tile_queue, tile);
 
-      tile_list_tail = g_list_last (tile_list_tail);
-
-      /* Add the tiles list node to the tile hash table.
-       */
-      g_hash_table_insert (tile_hash_table, tile, tile_list_tail);
+      g_hash_table_insert (tile_hash_table, tile, tile_queue.tail);
 
       /* Note the increase in the number of bytes the cache
        *  is referencing.
@@ -372,43 +487,35 @@ gimp_tile_cache_insert (GimpTile *tile)
     }
 }
 
+/*  Must be called with tile_mutex held, see gimp_tile_cache_insert().  */
 static void
-gimp_tile_cache_flush (GimpTile *tile)
+gimp_tile_cache_flush (GimpTile  *tile,
+                       GSList   **evicted)
 {
-  GList *list;
+  GList *link;
 
   if (! tile_hash_table)
     return;
 
   /* Find where the tile is in the cache.
    */
-  list = g_hash_table_lookup (tile_hash_table, tile);
+  link = g_hash_table_lookup (tile_hash_table, tile);
 
-  if (list)
+  if (link)
     {
       /* If the tile is in the cache, then remove it from the
-       *  tile list.
-       */
-      if (list == tile_list_tail)
-        tile_list_tail = tile_list_tail->prev;
-
-      tile_list_head = g_list_remove_link (tile_list_head, list);
-
-      if (! tile_list_head)
-        tile_list_tail = NULL;
-
-      /* Remove the tile from the tile hash table.
+       *  tile queue and the tile hash table.
        */
+      g_queue_delete_link (&tile_queue, link);
       g_hash_table_remove (tile_hash_table, tile);
-      g_list_free (list);
 
       /* Note the decrease in the number of bytes the cache
        *  is referencing.
        */
       cur_cache_size -= max_tile_size;
 
-      /* Unreference the tile.
+      /* Unreference the tile, once tile_mutex is released.
        */
-      gimp_tile_unref (tile, FALSE);
+      *evicted = g_slist_prepend (*evicted, tile);
     }
 }
@@ -26,7 +26,11 @@
 #include "gimpprotocol.h"
 #include "gimpwire.h"
 
-static GMutex readwrite_mutex;
+/*  recursive, because a temporary procedure dispatched while waiting
+ *  for an answer with the wire locked talks to GIMP from the same
+ *  thread
+ */
+static GRecMutex readwrite_mutex;
 
 static void _gp_quit_read                (GIOChannel       *channel,
                                           GimpWireMessage  *msg,
@@ -100,6 +104,22 @@ static void _gp_temp_proc_return_write   (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_temp_proc_return_destroy (GimpWireMessage  *msg);
 
+static void _gp_proc_run_batch_read      (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_run_batch_write     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_run_batch_destroy   (GimpWireMessage  *msg);
+
+static void _gp_proc_return_batch_read   (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_return_batch_write  (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_return_batch_destroy (GimpWireMessage *msg);
+
 static void _gp_proc_install_read        (GIOChannel       *channel,
                                           GimpWireMessage  *msg,
                                           gpointer          user_data);
@@ -198,6 +218,14 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_PROC_RUN_BATCH,
+                      _gp_proc_run_batch_read,
+                      _gp_proc_run_batch_write,
+                      _gp_proc_run_batch_destroy);
+  gimp_wire_register (GP_PROC_RETURN_BATCH,
+                      _gp_proc_return_batch_read,
+                      _gp_proc_return_batch_write,
+                      _gp_proc_return_batch_destroy);
 }
 
 gboolean
@@ -443,6 +471,44 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_proc_run_batch_write (GIOChannel     *channel,
+                         GPProcRunBatch *proc_run_batch,
+                         gpointer        user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_RUN_BATCH;
+  msg.data = proc_run_batch;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_proc_return_batch_write (GIOChannel        *channel,
+                            GPProcReturnBatch *proc_return_batch,
+                            gpointer           user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_RETURN_BATCH;
+  msg.data = proc_return_batch;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -995,6 +1061,197 @@ _gp_temp_proc_return_destroy (GimpWireMessage *msg)
   _gp_proc_return_destroy (msg);
 }
 
+/*  proc_run_batch  */
+
+static void
+_gp_proc_run_batch_read (GIOChannel      *channel,
+                         GimpWireMessage *msg,
+                         gpointer         user_data)
+{
+  GPProcRunBatch *proc_run_batch = g_slice_new0 (GPProcRunBatch);
+  gint            i;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_run_batch->serial, 1, user_data))
+    goto cleanup;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_run_batch->nruns, 1, user_data))
+    goto cleanup;
+
+  proc_run_batch->runs = g_new0 (GPProcRun, proc_run_batch->nruns);
+
+  for (i = 0; i < proc_run_batch->nruns; i++)
+    {
+      GPProcRun *proc_run = &proc_run_batch->runs[i];
+
+      if (! _gimp_wire_read_string (channel, &proc_run->name, 1, user_data))
+        goto cleanup;
+
+      _gp_params_read (channel,
+                       &proc_run->params, (guint *) &proc_run->nparams,
+                       user_data);
+    }
+
+  msg->data = proc_run_batch;
+  return;
+
+ cleanup:
+  msg->data = proc_run_batch;
+  _gp_proc_run_batch_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_run_batch_write (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPProcRunBatch *proc_run_batch = msg->data;
+  gint            i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_run_batch->serial, 1, user_data))
+    return;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_run_batch->nruns, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_run_batch->nruns; i++)
+    {
+      GPProcRun *proc_run = &proc_run_batch->runs[i];
+
+      if (! _gimp_wire_write_string (channel, &proc_run->name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        proc_run->params, proc_run->nparams, user_data);
+    }
+}
+
+static void
+_gp_proc_run_batch_destroy (GimpWireMessage *msg)
+{
+  GPProcRunBatch *proc_run_batch = msg->data;
+
+  if (proc_run_batch)
+    {
+      if (proc_run_batch->runs)
+        {
+          gint i;
+
+          for (i = 0; i < proc_run_batch->nruns; i++)
+            {
+              gp_params_destroy (proc_run_batch->runs[i].params,
+                                 proc_run_batch->runs[i].nparams);
+              g_free (proc_run_batch->runs[i].name);
+            }
+
+          g_free (proc_run_batch->runs);
+        }
+
+      g_slice_free (GPProcRunBatch, proc_run_batch);
+    }
+}
+
+/*  proc_return_batch  */
+
+static void
+_gp_proc_return_batch_read (GIOChannel      *channel,
+                            GimpWireMessage *msg,
+                            gpointer         user_data)
+{
+  GPProcReturnBatch *proc_return_batch = g_slice_new0 (GPProcReturnBatch);
+  gint               i;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_return_batch->serial, 1, user_data))
+    goto cleanup;
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &proc_return_batch->nreturns, 1, user_data))
+    goto cleanup;
+
+  proc_return_batch->returns = g_new0 (GPProcReturn,
+                                       proc_return_batch->nreturns);
+
+  for (i = 0; i < proc_return_batch->nreturns; i++)
+    {
+      GPProcReturn *proc_return = &proc_return_batch->returns[i];
+
+      if (! _gimp_wire_read_string (channel,
+                                    &proc_return->name, 1, user_data))
+        goto cleanup;
+
+      _gp_params_read (channel,
+                       &proc_return->params, (guint *) &proc_return->nparams,
+                       user_data);
+    }
+
+  msg->data = proc_return_batch;
+  return;
+
+ cleanup:
+  msg->data = proc_return_batch;
+  _gp_proc_return_batch_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_return_batch_write (GIOChannel      *channel,
+                             GimpWireMessage *msg,
+                             gpointer         user_data)
+{
+  GPProcReturnBatch *proc_return_batch = msg->data;
+  gint               i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_return_batch->serial, 1, user_data))
+    return;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_return_batch->nreturns, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_return_batch->nreturns; i++)
+    {
+      GPProcReturn *proc_return = &proc_return_batch->returns[i];
+
+      if (! _gimp_wire_write_string (channel,
+                                     &proc_return->name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        proc_return->params, proc_return->nparams, user_data);
+    }
+}
+
+static void
+_gp_proc_return_batch_destroy (GimpWireMessage *msg)
+{
+  GPProcReturnBatch *proc_return_batch = msg->data;
+
+  if (proc_return_batch)
+    {
+      if (proc_return_batch->returns)
+        {
+          gint i;
+
+          for (i = 0; i < proc_return_batch->nreturns; i++)
+            {
+              gp_params_destroy (proc_return_batch->returns[i].params,
+                                 proc_return_batch->returns[i].nparams);
+              g_free (proc_return_batch->returns[i].name);
+            }
+
+          g_free (proc_return_batch->returns);
+        }
+
+      g_slice_free (GPProcReturnBatch, proc_return_batch);
+    }
+}
+
 /*  proc_install  */
 
 static void
@@ -1852,13 +2109,13 @@ gp_params_destroy (GPParam *params,
 void
 gp_lock (void)
 {
-  g_mutex_lock (&readwrite_mutex);
+  g_rec_mutex_lock (&readwrite_mutex);
 }
 
 void
 gp_unlock (void)
 {
-  g_mutex_unlock (&readwrite_mutex);
+  g_rec_mutex_unlock (&readwrite_mutex);
 }
 
 /* has_init */
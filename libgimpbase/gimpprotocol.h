@@ -26,7 +26,7 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0016
+#define GIMP_PROTOCOL_VERSION  0x0017
 
 
 enum
@@ -43,20 +43,24 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_PROC_RUN_BATCH,
+  GP_PROC_RETURN_BATCH
 };
 
 
-typedef struct _GPConfig        GPConfig;
-typedef struct _GPTileReq       GPTileReq;
-typedef struct _GPTileAck       GPTileAck;
-typedef struct _GPTileData      GPTileData;
-typedef struct _GPParam         GPParam;
-typedef struct _GPParamDef      GPParamDef;
-typedef struct _GPProcRun       GPProcRun;
-typedef struct _GPProcReturn    GPProcReturn;
-typedef struct _GPProcInstall   GPProcInstall;
-typedef struct _GPProcUninstall GPProcUninstall;
+typedef struct _GPConfig          GPConfig;
+typedef struct _GPTileReq         GPTileReq;
+typedef struct _GPTileAck         GPTileAck;
+typedef struct _GPTileData        GPTileData;
+typedef struct _GPParam           GPParam;
+typedef struct _GPParamDef        GPParamDef;
+typedef struct _GPProcRun         GPProcRun;
+typedef struct _GPProcReturn      GPProcReturn;
+typedef struct _GPProcRunBatch    GPProcRunBatch;
+typedef struct _GPProcReturnBatch GPProcReturnBatch;
+typedef struct _GPProcInstall     GPProcInstall;
+typedef struct _GPProcUninstall   GPProcUninstall;
 
 
 struct _GPConfig
@@ -164,6 +168,20 @@ struct _GPProcReturn
   GPParam *params;
 };
 
+struct _GPProcRunBatch
+{
+  guint32    serial;
+  guint32    nruns;
+  GPProcRun *runs;
+};
+
+struct _GPProcReturnBatch
+{
+  guint32       serial;
+  guint32       nreturns;
+  GPProcReturn *returns;
+};
+
 struct _GPProcInstall
 {
   gchar      *name;
@@ -187,49 +205,55 @@ struct _GPProcUninstall
 };
 
 
-void      gp_init                   (void);
-
-gboolean  gp_quit_write             (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_config_write           (GIOChannel      *channel,
-                                     GPConfig        *config,
-                                     gpointer         user_data);
-gboolean  gp_tile_req_write         (GIOChannel      *channel,
-                                     GPTileReq       *tile_req,
-                                     gpointer         user_data);
-gboolean  gp_tile_ack_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_tile_data_write        (GIOChannel      *channel,
-                                     GPTileData      *tile_data,
-                                     gpointer         user_data);
-gboolean  gp_proc_run_write         (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_proc_return_write      (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_run_write    (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_return_write (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_proc_install_write     (GIOChannel      *channel,
-                                     GPProcInstall   *proc_install,
-                                     gpointer         user_data);
-gboolean  gp_proc_uninstall_write   (GIOChannel      *channel,
-                                     GPProcUninstall *proc_uninstall,
-                                     gpointer         user_data);
-gboolean  gp_extension_ack_write    (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_has_init_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
-
-void      gp_params_destroy         (GPParam         *params,
-                                     gint             nparams);
-
-void      gp_lock                   (void);
-void      gp_unlock                 (void);
+void      gp_init                    (void);
+
+gboolean  gp_quit_write              (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_config_write            (GIOChannel        *channel,
+                                      GPConfig          *config,
+                                      gpointer           user_data);
+gboolean  gp_tile_req_write          (GIOChannel        *channel,
+                                      GPTileReq         *tile_req,
+                                      gpointer           user_data);
+gboolean  gp_tile_ack_write          (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_tile_data_write         (GIOChannel        *channel,
+                                      GPTileData        *tile_data,
+                                      gpointer           user_data);
+gboolean  gp_proc_run_write          (GIOChannel        *channel,
+                                      GPProcRun         *proc_run,
+                                      gpointer           user_data);
+gboolean  gp_proc_return_write       (GIOChannel        *channel,
+                                      GPProcReturn      *proc_return,
+                                      gpointer           user_data);
+gboolean  gp_temp_proc_run_write     (GIOChannel        *channel,
+                                      GPProcRun         *proc_run,
+                                      gpointer           user_data);
+gboolean  gp_temp_proc_return_write  (GIOChannel        *channel,
+                                      GPProcReturn      *proc_return,
+                                      gpointer           user_data);
+gboolean  gp_proc_install_write      (GIOChannel        *channel,
+                                      GPProcInstall     *proc_install,
+                                      gpointer           user_data);
+gboolean  gp_proc_uninstall_write    (GIOChannel        *channel,
+                                      GPProcUninstall   *proc_uninstall,
+                                      gpointer           user_data);
+gboolean  gp_extension_ack_write     (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_has_init_write          (GIOChannel        *channel,
+                                      gpointer           user_data);
+gboolean  gp_proc_run_batch_write    (GIOChannel        *channel,
+                                      GPProcRunBatch    *proc_run_batch,
+                                      gpointer           user_data);
+gboolean  gp_proc_return_batch_write (GIOChannel        *channel,
+                                      GPProcReturnBatch *proc_return_batch,
+                                      gpointer           user_data);
+
+void      gp_params_destroy          (GPParam           *params,
+                                      gint               nparams);
+
+void      gp_lock                    (void);
+void      gp_unlock                  (void);
 
 
 G_END_DECLS
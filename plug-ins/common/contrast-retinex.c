@@ -33,6 +33,7 @@
 #define MAX_GAUSSIAN_SCALE  250
 #define SCALE_WIDTH         150
 #define ENTRY_WIDTH           4
+#define STRIP_WIDTH          64 /* columns filtered at once */
 
 
 typedef struct
@@ -69,6 +70,23 @@ typedef struct
   gdouble b[4];
 } gauss3_coefs;
 
+typedef struct
+{
+  guchar       *src;
+  gfloat       *dst;      /* three floats per pixel */
+  gfloat       *in;       /* the channel being filtered */
+  gint          width;
+  gint          height;
+  gint          bytes;
+  gint          channel;
+  gfloat        weight;
+  gauss3_coefs  coef;
+  gdouble      *sums;     /* one per part */
+  gdouble      *sums_sq;
+  gfloat        mini;
+  gfloat        range;
+} MSRCRInfo;
+
 
 /*
  * Declare local functions.
@@ -90,11 +108,6 @@ static void     retinex_scales_distribution (gfloat       *scales,
                                              gint          mode,
                                              gint          s);
 
-static void     compute_mean_var            (gfloat       *src,
-                                             gfloat       *mean,
-                                             gfloat       *var,
-                                             gint          size,
-                                             gint          bytes);
 /*
  * Gauss
  */
@@ -105,7 +118,16 @@ static void     gausssmooth                 (gfloat       *in,
                                              gfloat       *out,
                                              gint          size,
                                              gint          rowtride,
-                                             gauss3_coefs *c);
+                                             gauss3_coefs *c,
+                                             gfloat       *w1,
+                                             gfloat       *w2);
+static void     gausssmooth_columns         (gfloat       *in,
+                                             gint          rowstride,
+                                             gint          height,
+                                             gint          ncols,
+                                             gauss3_coefs *c,
+                                             gfloat       *w1,
+                                             gfloat       *w2);
 
 /*
  * MSRCR = MultiScale Retinex with Color Restoration
@@ -557,7 +579,8 @@ compute_coefs3 (gauss3_coefs *c, gfloat sigma)
 }
 
 static void
-gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c)
+gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c,
+             gfloat *w1, gfloat *w2)
 {
   /*
    * Papers:  "Recursive Implementation of the gaussian filter.",
@@ -565,15 +588,14 @@ gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c
    * formula: 9a        forward filter
    *          9b        backward filter
    *          fig7      algorithm
+   *
+   * w1 and w2 hold size + 3 values each.  in and out may be the same,
+   * in is read completely before out is written.
    */
-  gint i,n, bufsize;
-  gfloat *w1,*w2;
+  gint i,n;
 
   /* forward pass */
-  bufsize = size+3;
   size -= 1;
-  w1 = (gfloat *) g_try_malloc (bufsize * sizeof (gfloat));
-  w2 = (gfloat *) g_try_malloc (bufsize * sizeof (gfloat));
   w1[0] = in[0];
   w1[1] = in[0];
   w1[2] = in[0];
@@ -596,36 +618,220 @@ gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c
                                              c->b[2]*w2[n+2] +
                                              c->b[3]*w2[n+3] ) / c->b[0]));
     }
+}
+
+/*
+ * The same filter as gausssmooth(), run down ncols neighboring
+ * columns at once, so that the inner loops run along the rows and
+ * can be vectorized.  w1 and w2 hold (height + 3) * ncols values
+ * each, the result is left in the first height rows of w2.
+ */
+static void
+gausssmooth_columns (gfloat *in, gint rowstride, gint height, gint ncols,
+                     gauss3_coefs *c, gfloat *w1, gfloat *w2)
+{
+  gdouble B  = c->B;
+  gdouble b0 = c->b[0];
+  gdouble b1 = c->b[1];
+  gdouble b2 = c->b[2];
+  gdouble b3 = c->b[3];
+  gint    i, n, col;
+
+  /* forward pass */
+  for (col = 0; col < ncols; col++)
+    w1[col] = w1[ncols + col] = w1[2 * ncols + col] = in[col];
+
+  for (i = 0, n = 3; i < height; i++, n++)
+    {
+      const gfloat *src = in + i * rowstride;
+      gfloat       *d   = w1 + n * ncols;
+
+      for (col = 0; col < ncols; col++)
+        d[col] = (gfloat) (B * src[col] +
+                           ((b1 * d[col - ncols] +
+                             b2 * d[col - 2 * ncols] +
+                             b3 * d[col - 3 * ncols]) / b0));
+    }
+
+  /* backward pass */
+  for (col = 0; col < ncols; col++)
+    w2[height * ncols + col] =
+    w2[(height + 1) * ncols + col] =
+    w2[(height + 2) * ncols + col] = w1[(height + 2) * ncols + col];
+
+  for (n = height - 1; n >= 0; n--)
+    {
+      const gfloat *s = w1 + (n + 3) * ncols;
+      gfloat       *d = w2 + n * ncols;
+
+      for (col = 0; col < ncols; col++)
+        d[col] = (gfloat) (B * s[col] +
+                           ((b1 * d[col + ncols] +
+                             b2 * d[col + 2 * ncols] +
+                             b3 * d[col + 3 * ncols]) / b0));
+    }
+}
+
+/*
+ * Filters the rows of info->in in place.
+ */
+static void
+msrcr_filter_rows (gint     i,
+                   gint     n,
+                   gpointer data)
+{
+  MSRCRInfo *info = data;
+  gfloat    *w1   = g_new (gfloat, info->width + 3);
+  gfloat    *w2   = g_new (gfloat, info->width + 3);
+  gint       row;
+
+  for (row = info->height * i / n; row < info->height * (i + 1) / n; row++)
+    {
+      gfloat *line = info->in + row * info->width;
+
+      gausssmooth (line, line, info->width, 1, &info->coef, w1, w2);
+    }
 
   g_free (w1);
   g_free (w2);
 }
 
+/*
+ * Filters strips of columns of info->in, and adds the ratio between
+ * the original and the filtered values to info->dst.
+ */
+static void
+msrcr_filter_columns (gint     i,
+                      gint     n,
+                      gpointer data)
+{
+  MSRCRInfo *info     = data;
+  gint       n_strips = (info->width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+  gfloat    *w1       = g_new (gfloat, (info->height + 3) * STRIP_WIDTH);
+  gfloat    *w2       = g_new (gfloat, (info->height + 3) * STRIP_WIDTH);
+  gint       strip;
+
+  for (strip = n_strips * i / n; strip < n_strips * (i + 1) / n; strip++)
+    {
+      gint x     = strip * STRIP_WIDTH;
+      gint ncols = MIN (STRIP_WIDTH, info->width - x);
+      gint row, col;
+
+      gausssmooth_columns (info->in + x, info->width, info->height, ncols,
+                           &info->coef, w1, w2);
+
+      /*
+         Summarize the filtered values.
+         In fact one calculates a ratio between the original values and the filtered values.
+       */
+      for (row = 0; row < info->height; row++)
+        {
+          gint          pos = row * info->width + x;
+          const guchar *s   = info->src + pos * info->bytes + info->channel;
+          gfloat       *d   = info->dst + pos * 3 + info->channel;
+          const gfloat *out = w2 + row * ncols;
+
+          for (col = 0; col < ncols; col++)
+            {
+              d[col * 3] += info->weight * (log (s[col * info->bytes] + 1.) -
+                                            log (out[col]));
+            }
+        }
+    }
+
+  g_free (w1);
+  g_free (w2);
+}
+
+/*
+ * Final calculation with original value and cumulated filter values,
+ * also sums the results up for their mean and variance.
+ * The parameters gain, alpha and offset are constants.
+ */
+static void
+msrcr_restore (gint     i,
+               gint     n,
+               gpointer data)
+{
+  MSRCRInfo *info    = data;
+  gint       n_pixels = info->width * info->height;
+  gfloat     alpha   = 128.;
+  gfloat     gain    = 1.;
+  gfloat     offset  = 0.;
+  gdouble    sum     = 0.0;
+  gdouble    sum_sq  = 0.0;
+  gint       k, j;
+
+  /* Ci(x,y)=log[a Ii(x,y)]-log[ Ei=1-s Ii(x,y)] */
+
+  for (k = n_pixels * i / n; k < n_pixels * (i + 1) / n; k++)
+    {
+      guchar *psrc = info->src + k * info->bytes;
+      gfloat *pdst = info->dst + k * 3;
+      gfloat  logl;
+
+      logl = log((gfloat)psrc[0] + (gfloat)psrc[1] + (gfloat)psrc[2] + 3.);
+
+      pdst[0] = gain * ((log(alpha * (psrc[0]+1.)) - logl) * pdst[0]) + offset;
+      pdst[1] = gain * ((log(alpha * (psrc[1]+1.)) - logl) * pdst[1]) + offset;
+      pdst[2] = gain * ((log(alpha * (psrc[2]+1.)) - logl) * pdst[2]) + offset;
+
+      for (j = 0 ; j < 3 ; j++)
+        {
+          sum    += pdst[j];
+          sum_sq += pdst[j] * pdst[j];
+        }
+    }
+
+  info->sums[i]    = sum;
+  info->sums_sq[i] = sum_sq;
+}
+
+static void
+msrcr_stretch (gint     i,
+               gint     n,
+               gpointer data)
+{
+  MSRCRInfo *info     = data;
+  gint       n_pixels = info->width * info->height;
+  gint       k, j;
+
+  for (k = n_pixels * i / n; k < n_pixels * (i + 1) / n; k++)
+    {
+      guchar *psrc = info->src + k * info->bytes;
+      gfloat *pdst = info->dst + k * 3;
+
+      for (j = 0 ; j < 3 ; j++)
+        {
+          gfloat c = 255 * ( pdst[j] - info->mini ) / info->range;
+
+          psrc[j] = (guchar) CLAMP (c, 0, 255);
+        }
+    }
+}
+
 /*
  * This function is the heart of the algo.
  * (a)  Filterings at several scales and sumarize the results.
  * (b)  Calculation of the final values.
+ *
+ * Besides the image, only the cumulated filter values and one
+ * channel are kept as floats.  Every filter pass is split in rows
+ * or strips of columns, which are processed concurrently.
  */
 static void
 MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
 {
 
-  gint          scale,row,col;
-  gint          i,j;
-  gint          size;
+  gint          scale;
+  gint          i;
   gint          channel;
-  guchar       *psrc = NULL;            /* backup pointer for src buffer */
-  gfloat       *dst  = NULL;            /* float buffer for algorithm */
-  gfloat       *pdst = NULL;            /* backup pointer for float buffer */
-  gfloat       *in, *out;
   gint          channelsize;            /* Float memory cache for one channel */
-  gfloat        weight;
-  gauss3_coefs  coef;
+  gint          n_parts;
+  MSRCRInfo     info;
+  gdouble       sum, sum_sq;
   gfloat        mean, var;
-  gfloat        mini, range, maxi;
-  gfloat        alpha;
-  gfloat        gain;
-  gfloat        offset;
+  gfloat        maxi;
   gdouble       max_preview = 0.0;
 
   if (!preview_mode)
@@ -635,33 +841,27 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
     }
 
   /* Allocate all the memory needed for algorithm*/
-  size = width * height * bytes;
-  dst = g_try_malloc (size * sizeof (gfloat));
-  if (dst == NULL)
-    {
-      g_warning ("Failed to allocate memory");
-      return;
-    }
-  memset (dst, 0, size * sizeof (gfloat));
-
   channelsize  = (width * height);
-  in  = (gfloat *) g_try_malloc (channelsize * sizeof (gfloat));
-  if (in == NULL)
+  info.dst = g_try_malloc (channelsize * 3 * sizeof (gfloat));
+  if (info.dst == NULL)
     {
-      g_free (dst);
       g_warning ("Failed to allocate memory");
-      return; /* do some clever stuff */
+      return;
     }
+  memset (info.dst, 0, channelsize * 3 * sizeof (gfloat));
 
-  out  = (gfloat *) g_try_malloc (channelsize * sizeof (gfloat));
-  if (out == NULL)
+  info.in  = (gfloat *) g_try_malloc (channelsize * sizeof (gfloat));
+  if (info.in == NULL)
     {
-      g_free (in);
-      g_free (dst);
+      g_free (info.dst);
       g_warning ("Failed to allocate memory");
       return; /* do some clever stuff */
     }
 
+  info.src    = src;
+  info.width  = width;
+  info.height = height;
+  info.bytes  = bytes;
 
   /*
      Calculate the scales of filtering according to the
@@ -676,7 +876,7 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
       Summerize the results of the various filters according to a
       specific weight(here equivalent for all).
   */
-  weight = 1./ (gfloat) rvals.nscales;
+  info.weight = 1./ (gfloat) rvals.nscales;
 
   /*
     The recursive filtering algorithm needs different coefficients according
@@ -686,138 +886,73 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
     {
       gint pos;
 
+      info.channel = channel;
+
       for (i = 0, pos = channel; i < channelsize ; i++, pos += bytes)
          {
             /* 0-255 => 1-256 */
-            in[i] = (gfloat)(src[pos] + 1.0);
+            info.in[i] = (gfloat)(src[pos] + 1.0);
          }
       for (scale = 0; scale < rvals.nscales; scale++)
         {
-          compute_coefs3 (&coef, RetinexScales[scale]);
+          compute_coefs3 (&info.coef, RetinexScales[scale]);
           /*
            *  Filtering (smoothing) Gaussian recursive.
            *
-           *  Filter rows first
+           *  Filter rows first, the filtered rows are
+           *  also the input of the next scale
            */
-          for (row=0 ;row < height; row++)
-            {
-              pos =  row * width;
-              gausssmooth (in + pos, out + pos, width, 1, &coef);
-            }
-
-          memcpy(in,  out, channelsize * sizeof(gfloat));
-          memset(out, 0  , channelsize * sizeof(gfloat));
+          gimp_parallel_distribute (height, msrcr_filter_rows, &info);
 
           /*
            *  Filtering (smoothing) Gaussian recursive.
            *
            *  Second columns
            */
-          for (col=0; col < width; col++)
-            {
-              pos = col;
-              gausssmooth(in + pos, out + pos, height, width, &coef);
-            }
-
-          /*
-             Summarize the filtered values.
-             In fact one calculates a ratio between the original values and the filtered values.
-           */
-          for (i = 0, pos = channel; i < channelsize; i++, pos += bytes)
-            {
-              dst[pos] += weight * (log (src[pos] + 1.) - log (out[i]));
-            }
+          gimp_parallel_distribute ((width + STRIP_WIDTH - 1) / STRIP_WIDTH,
+                                    msrcr_filter_columns, &info);
 
            if (!preview_mode)
              gimp_progress_update ((channel * rvals.nscales + scale) /
                                    max_preview);
         }
     }
-  g_free(in);
-  g_free(out);
+  g_free (info.in);
 
   /*
       Final calculation with original value and cumulated filter values.
-      The parameters gain, alpha and offset are constants.
   */
-  /* Ci(x,y)=log[a Ii(x,y)]-log[ Ei=1-s Ii(x,y)] */
+  n_parts = gimp_parallel_get_n_threads ();
+  info.sums    = g_new0 (gdouble, n_parts);
+  info.sums_sq = g_new0 (gdouble, n_parts);
 
-  alpha  = 128.;
-  gain   = 1.;
-  offset = 0.;
+  gimp_parallel_distribute (n_parts, msrcr_restore, &info);
 
-  for (i = 0; i < size; i += bytes)
+  sum = sum_sq = 0.0;
+  for (i = 0; i < n_parts; i++)
     {
-      gfloat logl;
-
-      psrc = src+i;
-      pdst = dst+i;
-
-      logl = log((gfloat)psrc[0] + (gfloat)psrc[1] + (gfloat)psrc[2] + 3.);
-
-      pdst[0] = gain * ((log(alpha * (psrc[0]+1.)) - logl) * pdst[0]) + offset;
-      pdst[1] = gain * ((log(alpha * (psrc[1]+1.)) - logl) * pdst[1]) + offset;
-      pdst[2] = gain * ((log(alpha * (psrc[2]+1.)) - logl) * pdst[2]) + offset;
+      sum    += info.sums[i];
+      sum_sq += info.sums_sq[i];
     }
 
-/*  if (!preview_mode)
-    gimp_progress_update ((2.0 + (rvals.nscales * 3)) /
-                          ((rvals.nscales * 3) + 3));*/
+  g_free (info.sums);
+  g_free (info.sums_sq);
 
   /*
       Adapt the dynamics of the colors according to the statistics of the first and second order.
       The use of the variance makes it possible to control the degree of saturation of the colors.
   */
-  pdst = dst;
+  mean = sum / (gdouble) (channelsize * bytes);
+  var  = sqrt (sum_sq / (gdouble) (channelsize * bytes) - mean * mean);
 
-  compute_mean_var (pdst, &mean, &var, size, bytes);
-  mini = mean - rvals.cvar*var;
-  maxi = mean + rvals.cvar*var;
-  range = maxi - mini;
+  info.mini  = mean - rvals.cvar*var;
+  maxi       = mean + rvals.cvar*var;
+  info.range = maxi - info.mini;
 
-  if (!range)
-    range = 1.0;
+  if (!info.range)
+    info.range = 1.0;
 
-  for (i = 0; i < size; i+= bytes)
-    {
-      psrc = src + i;
-      pdst = dst + i;
-
-      for (j = 0 ; j < 3 ; j++)
-        {
-          gfloat c = 255 * ( pdst[j] - mini ) / range;
-
-          psrc[j] = (guchar) CLAMP (c, 0, 255);
-        }
-    }
-
-  g_free (dst);
-}
-
-/*
- * Calculate the average and variance in one go.
- */
-static void
-compute_mean_var (gfloat *src, gfloat *mean, gfloat *var, gint size, gint bytes)
-{
-  gfloat vsquared;
-  gint i,j;
-  gfloat *psrc;
-
-  vsquared = 0;
-  *mean = 0;
-  for (i = 0; i < size; i+= bytes)
-    {
-       psrc = src+i;
-       for (j = 0 ; j < 3 ; j++)
-         {
-            *mean += psrc[j];
-            vsquared += psrc[j] * psrc[j];
-         }
-    }
+  gimp_parallel_distribute (n_parts, msrcr_stretch, &info);
 
-  *mean /= (gfloat) size; /* mean */
-  vsquared /= (gfloat) size; /* mean (x^2) */
-  *var = ( vsquared - (*mean * *mean) );
-  *var = sqrt(*var); /* var */
+  g_free (info.dst);
 }
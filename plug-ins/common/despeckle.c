@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
@@ -53,6 +54,9 @@
 /* List that stores pixels falling in to the same luma bucket */
 #define MAX_LIST_ELEMS SQR(2 * MAX_RADIUS + 1)
 
+/* Number of rows despeckled at once, the image is read band by band */
+#define BAND_HEIGHT    128
+
 typedef struct
 {
   const guchar *elems[MAX_LIST_ELEMS];
@@ -63,19 +67,44 @@ typedef struct
 typedef struct
 {
   gint       elems[256]; /* Number of pixels that fall into each luma bucket */
+  gint       coarse[16]; /* Number of pixels in each run of 16 buckets */
   PixelsList origs[256]; /* Original pixels */
   gint       xmin;
   gint       ymin;
   gint       xmax;
   gint       ymax; /* Source rect */
-} DespeckleHistogram;
 
-/* Number of pixels in actual histogram falling into each category */
-static gint                hist0;    /* Less than min treshold */
-static gint                hist255;  /* More than max treshold */
-static gint                histrest; /* From min to max        */
+  /* Number of pixels in actual histogram falling into each category */
+  gint       hist0;    /* Less than min treshold */
+  gint       hist255;  /* More than max treshold */
+  gint       histrest; /* From min to max        */
+} DespeckleHistogram;
 
-static DespeckleHistogram  histogram;
+/* Rows y0 to y0 + n_rows - 1 of the area being despeckled */
+typedef struct
+{
+  guchar *src;
+  guchar *luma;   /* Luminance of each pixel of src */
+  gint    y0;
+  gint    n_rows;
+  gint    width;
+  gint    height; /* Height of the whole area */
+  gint    bpp;
+} DespeckleRows;
+
+/* Rows whose medians are computed concurrently */
+typedef struct
+{
+  DespeckleRows *rows;
+  guchar        *dst;
+  gint           y;
+  gint           height;
+  gint           radius;
+  gint          *start_radius; /* Adaptive radius at the start of each row */
+  gint          *rands;        /* Random values used by the rows, in order */
+  gint          *row_rands;    /* Index of the first value of each row */
+  gint           next_row;
+} DespeckleBand;
 
 
 /*
@@ -90,13 +119,18 @@ static void      run   (const gchar      *name,
                         GimpParam       **return_vals);
 
 static void      despeckle                 (void);
-static void      despeckle_median          (guchar        *src,
+static void      despeckle_median          (DespeckleRows *rows,
                                             guchar        *dst,
-                                            gint           width,
+                                            gint           y,
                                             gint           height,
-                                            gint           bpp,
                                             gint           radius,
-                                            gboolean       preview);
+                                            gint          *adapt_radius);
+static void      despeckle_rows_load       (DespeckleRows *rows,
+                                            GimpPixelRgn  *src_rgn,
+                                            gint           x,
+                                            gint           y,
+                                            gint           y0,
+                                            gint           n_rows);
 
 static gboolean  despeckle_dialog          (void);
 
@@ -373,12 +407,16 @@ pixel_copy (guchar       *dest,
  * 'despeckle()' - Despeckle an image using a median filter.
  *
  * A median filter basically collects pixel values in a region around the
- * target pixel, sorts them, and uses the median value. This code uses a
- * circular row buffer to improve performance.
+ * target pixel, sorts them, and uses the median value. This code keeps a
+ * histogram of the region which is updated as the region moves along a
+ * row.
  *
  * The adaptive filter is based on the median filter but analizes the histogram
  * of the region around the target pixel and adjusts the despeckle diameter
  * accordingly.
+ *
+ * The image is read and despeckled in bands of rows, the rows of a band
+ * are despeckled concurrently unless the filter is recursive.
  */
 
 static void
@@ -386,11 +424,14 @@ despeckle (void)
 {
   GimpPixelRgn  src_rgn;        /* Source image region */
   GimpPixelRgn  dst_rgn;
-  guchar       *src;
+  DespeckleRows rows;
   guchar       *dst;
   gint          img_bpp;
   gint          x, y;
   gint          width, height;
+  gint          radius;
+  gint          adapt_radius;
+  gint          band_y;
 
   img_bpp = gimp_drawable_bpp (drawable->drawable_id);
 
@@ -398,28 +439,55 @@ despeckle (void)
                                       &x, &y, &width, &height))
     return;
 
+  gimp_progress_init (_("Despeckle"));
+
   gimp_pixel_rgn_init (&src_rgn, drawable, x, y, width, height, FALSE, FALSE);
   gimp_pixel_rgn_init (&dst_rgn, drawable, x, y, width, height, TRUE, TRUE);
 
-  src = g_new (guchar, width * height * img_bpp);
-  dst = g_new (guchar, width * height * img_bpp);
+  radius       = despeckle_radius;
+  adapt_radius = radius;
+
+  rows.width  = width;
+  rows.height = height;
+  rows.bpp    = img_bpp;
+  rows.y0     = 0;
+  rows.n_rows = 0;
+  rows.src    = g_new (guchar, (BAND_HEIGHT + 2 * radius) * width * img_bpp);
+  rows.luma   = g_new (guchar, (BAND_HEIGHT + 2 * radius) * width);
+
+  dst = g_new (guchar, BAND_HEIGHT * width * img_bpp);
+
+  for (band_y = 0; band_y < height; band_y += BAND_HEIGHT)
+    {
+      gint band_height = MIN (BAND_HEIGHT, height - band_y);
+      gint y0          = MAX (0, band_y - radius);
+      gint y1          = MIN (height, band_y + band_height + radius);
 
-  gimp_pixel_rgn_get_rect (&src_rgn, src, x, y, width, height);
+      /* Read the rows the band's regions cover */
+      despeckle_rows_load (&rows, &src_rgn, x, y, y0, y1 - y0);
 
-  despeckle_median (src, dst, width, height, img_bpp, despeckle_radius, FALSE);
+      despeckle_median (&rows, dst, band_y, band_height,
+                        radius, &adapt_radius);
 
-  gimp_pixel_rgn_set_rect (&dst_rgn, dst, x, y, width, height);
+      gimp_pixel_rgn_set_rect (&dst_rgn, dst,
+                               x, y + band_y, width, band_height);
+
+      gimp_progress_update ((gdouble) (band_y + band_height) /
+                            (gdouble) height);
+    }
+
+  gimp_progress_update (1.0);
 
   gimp_drawable_flush (drawable);
   gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
   gimp_drawable_update (drawable->drawable_id, x, y, width, height);
 
   g_free (dst);
-  g_free (src);
+  g_free (rows.luma);
+  g_free (rows.src);
 }
 
 
-
 /*
  * 'despeckle_dialog()' - Popup a dialog window for the filter box size...
  */
@@ -577,10 +645,11 @@ preview_update (GtkWidget *widget)
   GimpPixelRgn  src_rgn;        /* Source image region */
   guchar       *dst;            /* Output image */
   GimpPreview  *preview;        /* The preview widget */
-  guchar       *src;            /* Source pixel rows */
+  DespeckleRows rows;           /* Source pixel rows */
   gint          img_bpp;
   gint          x1,y1;
   gint          width, height;
+  gint          adapt_radius;
 
   preview = GIMP_PREVIEW (widget);
 
@@ -593,16 +662,26 @@ preview_update (GtkWidget *widget)
 
   gimp_pixel_rgn_init (&src_rgn, drawable, x1, y1, width, height, FALSE, FALSE);
 
+  rows.width  = width;
+  rows.height = height;
+  rows.bpp    = img_bpp;
+  rows.y0     = 0;
+  rows.n_rows = 0;
+  rows.src    = g_new (guchar, width * height * img_bpp);
+  rows.luma   = g_new (guchar, width * height);
+
   dst = g_new (guchar, width * height * img_bpp);
-  src = g_new (guchar, width * height * img_bpp);
 
-  gimp_pixel_rgn_get_rect (&src_rgn, src, x1, y1, width, height);
+  despeckle_rows_load (&rows, &src_rgn, x1, y1, 0, height);
+
+  adapt_radius = despeckle_radius;
 
-  despeckle_median (src, dst, width, height, img_bpp, despeckle_radius, TRUE);
+  despeckle_median (&rows, dst, 0, height, despeckle_radius, &adapt_radius);
 
   gimp_preview_draw_buffer (preview, dst, width * img_bpp);
 
-  g_free (src);
+  g_free (rows.luma);
+  g_free (rows.src);
   g_free (dst);
 }
 
@@ -653,9 +732,12 @@ list_del_elem (PixelsList* list)
 }
 
 static inline const guchar *
-list_get_random_elem (PixelsList *list)
+list_get_random_elem (PixelsList  *list,
+                      const gint **rands)
 {
-  const gint pos = list->start + rand () % list->count;
+  /* Rows which are despeckled concurrently use values drawn in advance */
+  const gint rnd = *rands ? *(*rands)++ : rand ();
+  const gint pos = list->start + rnd % list->count;
 
   if (pos >= MAX_LIST_ELEMS)
     return list->elems[pos - MAX_LIST_ELEMS];
@@ -669,6 +751,7 @@ histogram_add (DespeckleHistogram *hist,
                const guchar       *orig)
 {
   hist->elems[val]++;
+  hist->coarse[val >> 4]++;
   list_add_elem (&hist->origs[val], orig);
 }
 
@@ -677,6 +760,7 @@ histogram_remove (DespeckleHistogram *hist,
                   guchar              val)
 {
   hist->elems[val]--;
+  hist->coarse[val >> 4]--;
   list_del_elem (&hist->origs[val]);
 }
 
@@ -690,13 +774,21 @@ histogram_clean (DespeckleHistogram *hist)
       hist->elems[i] = 0;
       hist->origs[i].count = 0;
     }
+
+  for (i = 0; i < 16; i++)
+    hist->coarse[i] = 0;
+
+  hist->hist0    = 0;
+  hist->hist255  = 0;
+  hist->histrest = 0;
 }
 
 static inline const guchar *
-histogram_get_median (DespeckleHistogram *hist,
-                      const guchar       *_default)
+histogram_get_median (DespeckleHistogram  *hist,
+                      const guchar        *_default,
+                      const gint         **rands)
 {
-  gint count = histrest;
+  gint count = hist->histrest;
   gint i;
   gint sum = 0;
 
@@ -705,74 +797,73 @@ histogram_get_median (DespeckleHistogram *hist,
 
   count = (count + 1) / 2;
 
+  /* Find the run of 16 buckets the median is in first */
   i = 0;
+  while (sum + hist->coarse[i] < count)
+    sum += hist->coarse[i++];
+
+  i *= 16;
   while ((sum += hist->elems[i]) < count)
     i++;
 
-  return list_get_random_elem (&hist->origs[i]);
+  return list_get_random_elem (&hist->origs[i], rands);
 }
 
 static inline void
-add_val (DespeckleHistogram *hist,
-         const guchar       *src,
-         gint                width,
-         gint                bpp,
-         gint                x,
-         gint                y)
+add_val (DespeckleHistogram  *hist,
+         const DespeckleRows *rows,
+         gint                 x,
+         gint                 y)
 {
-  const gint pos   = (x + (y * width)) * bpp;
-  const gint value = pixel_luminance (src + pos, bpp);
+  const gint index = x + (y - rows->y0) * rows->width;
+  const gint value = rows->luma[index];
 
   if (value > black_level && value < white_level)
   {
-    histogram_add (hist, value, src + pos);
-    histrest++;
+    histogram_add (hist, value, rows->src + index * rows->bpp);
+    hist->histrest++;
   }
   else
   {
     if (value <= black_level)
-      hist0++;
+      hist->hist0++;
 
     if (value >= white_level)
-      hist255++;
+      hist->hist255++;
   }
 }
 
 static inline void
-del_val (DespeckleHistogram *hist,
-         const guchar       *src,
-         gint                width,
-         gint                bpp,
-         gint                x,
-         gint                y)
+del_val (DespeckleHistogram  *hist,
+         const DespeckleRows *rows,
+         gint                 x,
+         gint                 y)
 {
-  const gint pos   = (x + (y * width)) * bpp;
-  const gint value = pixel_luminance (src + pos, bpp);
+  const gint index = x + (y - rows->y0) * rows->width;
+  const gint value = rows->luma[index];
 
   if (value > black_level && value < white_level)
   {
     histogram_remove (hist, value);
-    histrest--;
+    hist->histrest--;
   }
   else
   {
     if (value <= black_level)
-      hist0--;
+      hist->hist0--;
 
     if (value >= white_level)
-      hist255--;
+      hist->hist255--;
   }
 }
 
 static inline void
-add_vals (DespeckleHistogram *hist,
-          const guchar       *src,
-          gint                width,
-          gint                bpp,
-          gint                xmin,
-          gint                ymin,
-          gint                xmax,
-          gint                ymax)
+add_vals (DespeckleHistogram  *hist,
+          const DespeckleRows *rows,
+          gint                 xmin,
+          gint                 ymin,
+          gint                 xmax,
+          gint                 ymax)
 {
   gint x;
   gint y;
@@ -784,20 +875,18 @@ add_vals (DespeckleHistogram *hist,
     {
       for (x = xmin; x <= xmax; x++)
         {
-          add_val (hist, src, width, bpp, x, y);
+          add_val (hist, rows, x, y);
         }
     }
 }
 
 static inline void
-del_vals (DespeckleHistogram *hist,
-          const guchar       *src,
-          gint                width,
-          gint                bpp,
-          gint                xmin,
-          gint                ymin,
-          gint                xmax,
-          gint                ymax)
+del_vals (DespeckleHistogram  *hist,
+          const DespeckleRows *rows,
+          gint                 xmin,
+          gint                 ymin,
+          gint                 xmax,
+          gint                 ymax)
 {
   gint x;
   gint y;
@@ -809,34 +898,30 @@ del_vals (DespeckleHistogram *hist,
     {
       for (x = xmin; x <= xmax; x++)
         {
-          del_val (hist, src, width, bpp, x, y);
+          del_val (hist, rows, x, y);
         }
     }
 }
 
 static inline void
-update_histogram (DespeckleHistogram *hist,
-                  const guchar       *src,
-                  gint                width,
-                  gint                bpp,
-                  gint                xmin,
-                  gint                ymin,
-                  gint                xmax,
-                  gint                ymax)
+update_histogram (DespeckleHistogram  *hist,
+                  const DespeckleRows *rows,
+                  gint                 xmin,
+                  gint                 ymin,
+                  gint                 xmax,
+                  gint                 ymax)
 {
   /* assuming that radious of the box can change no more than one
      pixel in each call */
   /* assuming that box is moving either right or down */
 
-  del_vals (hist,
-            src, width, bpp, hist->xmin, hist->ymin, xmin - 1, hist->ymax);
-  del_vals (hist, src, width, bpp, xmin, hist->ymin, xmax, ymin - 1);
-  del_vals (hist, src, width, bpp, xmin, ymax + 1, xmax, hist->ymax);
+  del_vals (hist, rows, hist->xmin, hist->ymin, xmin - 1, hist->ymax);
+  del_vals (hist, rows, xmin, hist->ymin, xmax, ymin - 1);
+  del_vals (hist, rows, xmin, ymax + 1, xmax, hist->ymax);
 
-  add_vals (hist, src, width, bpp, hist->xmax + 1, ymin, xmax, ymax);
-  add_vals (hist, src, width, bpp, xmin, ymin, hist->xmax, hist->ymin - 1);
-  add_vals (hist,
-            src, width, bpp, hist->xmin, hist->ymax + 1, hist->xmax, ymax);
+  add_vals (hist, rows, hist->xmax + 1, ymin, xmax, ymax);
+  add_vals (hist, rows, xmin, ymin, hist->xmax, hist->ymin - 1);
+  add_vals (hist, rows, hist->xmin, hist->ymax + 1, hist->xmax, ymax);
 
   hist->xmin = xmin;
   hist->ymin = ymin;
@@ -844,100 +929,305 @@ update_histogram (DespeckleHistogram *hist,
   hist->ymax = ymax;
 }
 
+static inline void
+adapt_radius_update (gint *adapt_radius,
+                     gint  radius,
+                     gint  hist0,
+                     gint  hist255)
+{
+  if (hist0 >= *adapt_radius || hist255 >= *adapt_radius)
+    {
+      if (*adapt_radius < radius)
+        (*adapt_radius)++;
+    }
+  else if (*adapt_radius > 1)
+    {
+      (*adapt_radius)--;
+    }
+}
+
+/*
+ * 'despeckle_median_row()' - Despeckle row y into dst.
+ *
+ * adapt_radius is the radius at the start of the row and is updated to
+ * the radius at its end. rands are the random values to use, or NULL
+ * to draw them from rand ().
+ */
 
 static void
-despeckle_median (guchar   *src,
-                  guchar   *dst,
-                  gint      width,
-                  gint      height,
-                  gint      bpp,
-                  gint      radius,
-                  gboolean  preview)
-{
-  guint  progress;
-  guint  max_progress;
-  gint   x, y;
-  gint   adapt_radius;
-  gint   pos;
-  gint   ymin;
-  gint   ymax;
-  gint   xmin;
-  gint   xmax;
-
-  memset (&histogram, 0, sizeof(histogram));
-  progress     = 0;
-  max_progress = width * height;
-
-  if (! preview)
-    gimp_progress_init(_("Despeckle"));
+despeckle_median_row (DespeckleHistogram *hist,
+                      DespeckleRows      *rows,
+                      guchar             *dst,
+                      gint                y,
+                      gint                radius,
+                      gint               *adapt_radius,
+                      const gint         *rands)
+{
+  const gint width  = rows->width;
+  const gint height = rows->height;
+  const gint bpp    = rows->bpp;
+  gint       x;
+  gint       ymin;
+  gint       ymax;
+  gint       xmin;
+  gint       xmax;
 
-  adapt_radius = radius;
-  for (y = 0; y < height; y++)
+  x = 0;
+  ymin = MAX (0, y - *adapt_radius);
+  ymax = MIN (height - 1, y + *adapt_radius);
+  xmin = MAX (0, x - *adapt_radius);
+  xmax = MIN (width - 1, x + *adapt_radius);
+
+  histogram_clean (hist);
+  hist->xmin = xmin;
+  hist->ymin = ymin;
+  hist->xmax = xmax;
+  hist->ymax = ymax;
+
+  add_vals (hist, rows, hist->xmin, hist->ymin, hist->xmax, hist->ymax);
+
+  for (x = 0; x < width; x++)
     {
-      x = 0;
-      ymin = MAX (0, y - adapt_radius);
-      ymax = MIN (height - 1, y + adapt_radius);
-      xmin = MAX (0, x - adapt_radius);
-      xmax = MIN (width - 1, x + adapt_radius);
-      hist0   = 0;
-      histrest = 0;
-      hist255 = 0;
-      histogram_clean (&histogram);
-      histogram.xmin = xmin;
-      histogram.ymin = ymin;
-      histogram.xmax = xmax;
-      histogram.ymax = ymax;
-      add_vals (&histogram,
-                src, width, bpp,
-                histogram.xmin, histogram.ymin, histogram.xmax, histogram.ymax);
+      const gint    index = x + (y - rows->y0) * width;
+      guchar       *src   = rows->src + index * bpp;
+      const guchar *pixel;
 
-      for (x = 0; x < width; x++)
+      ymin = MAX (0, y - *adapt_radius); /* update ymin, ymax when adapt_radius changed (FILTER_ADAPTIVE) */
+      ymax = MIN (height - 1, y + *adapt_radius);
+      xmin = MAX (0, x - *adapt_radius);
+      xmax = MIN (width - 1, x + *adapt_radius);
+
+      update_histogram (hist, rows, xmin, ymin, xmax, ymax);
+
+      pixel = histogram_get_median (hist, src, &rands);
+
+      if (filter_type & FILTER_RECURSIVE)
         {
-          const guchar *pixel;
+          del_val (hist, rows, x, y);
+          pixel_copy (src, pixel, bpp);
+          rows->luma[index] = pixel_luminance (src, bpp);
+          add_val (hist, rows, x, y);
+        }
 
-          ymin = MAX (0, y - adapt_radius); /* update ymin, ymax when adapt_radius changed (FILTER_ADAPTIVE) */
-          ymax = MIN (height - 1, y + adapt_radius);
-          xmin = MAX (0, x - adapt_radius);
-          xmax = MIN (width - 1, x + adapt_radius);
+      pixel_copy (dst + x * bpp, pixel, bpp);
 
-          update_histogram (&histogram,
-                            src, width, bpp, xmin, ymin, xmax, ymax);
+      /*
+       * Check the histogram and adjust the diameter accordingly...
+       */
+      if (filter_type & FILTER_ADAPTIVE)
+        adapt_radius_update (adapt_radius, radius, hist->hist0, hist->hist255);
+    }
+}
 
-          pos = (x + (y * width)) * bpp;
-          pixel = histogram_get_median (&histogram, src + pos);
+/*
+ * 'despeckle_band_prepare()' - Make the rows of a band independent.
+ *
+ * Row by row, the adaptive radius and the random values depend on the
+ * rows before. Both only depend on the number of pixels of each
+ * category in the regions though, which are looked up in summed-area
+ * tables here, so that the rows can then be despeckled in any order.
+ */
 
-          if (filter_type & FILTER_RECURSIVE)
-            {
-              del_val (&histogram, src, width, bpp, x, y);
-              pixel_copy (src + pos, pixel, bpp);
-              add_val (&histogram, src, width, bpp, x, y);
-            }
+static void
+despeckle_band_prepare (DespeckleBand *band,
+                        gint          *adapt_radius)
+{
+  const DespeckleRows *rows   = band->rows;
+  const gint           width  = rows->width;
+  const gint           height = rows->height;
+  const gint           stride = width + 1;
+  gint                *sum0;
+  gint                *sum255;
+  gint                 n_rands = 0;
+  gint                 x, y;
+
+#define SUM_RECT(sum, x1, y1, x2, y2)                          \
+  ((sum)[((y2) + 1 - rows->y0) * stride + (x2) + 1] -          \
+   (sum)[((y1)     - rows->y0) * stride + (x2) + 1] -          \
+   (sum)[((y2) + 1 - rows->y0) * stride + (x1)]     +          \
+   (sum)[((y1)     - rows->y0) * stride + (x1)])
+
+  sum0   = g_new0 (gint, (rows->n_rows + 1) * stride);
+  sum255 = g_new0 (gint, (rows->n_rows + 1) * stride);
+
+  for (y = 0; y < rows->n_rows; y++)
+    {
+      const guchar *luma  = rows->luma + y * width;
+      gint          row0   = 0;
+      gint          row255 = 0;
 
-          pixel_copy (dst + pos, pixel, bpp);
+      for (x = 0; x < width; x++)
+        {
+          row0   += (luma[x] <= black_level);
+          row255 += (luma[x] >= white_level);
+
+          sum0[(y + 1) * stride + x + 1]   = sum0[y * stride + x + 1]   + row0;
+          sum255[(y + 1) * stride + x + 1] = sum255[y * stride + x + 1] + row255;
+        }
+    }
+
+  band->start_radius = g_new (gint, band->height);
+  band->row_rands    = g_new (gint, band->height);
+  band->rands        = g_new (gint, band->height * width);
+
+  for (y = band->y; y < band->y + band->height; y++)
+    {
+      band->start_radius[y - band->y] = *adapt_radius;
+      band->row_rands[y - band->y]    = n_rands;
+
+      for (x = 0; x < width; x++)
+        {
+          const gint ymin = MAX (0, y - *adapt_radius);
+          const gint ymax = MIN (height - 1, y + *adapt_radius);
+          const gint xmin = MAX (0, x - *adapt_radius);
+          const gint xmax = MIN (width - 1, x + *adapt_radius);
+          const gint area = (xmax - xmin + 1) * (ymax - ymin + 1);
+          gint       hist0;
+          gint       hist255;
+          gint       histrest = 0;
+
+          hist0   = SUM_RECT (sum0,   xmin, ymin, xmax, ymax);
+          hist255 = SUM_RECT (sum255, xmin, ymin, xmax, ymax);
+
+          /* The categories only overlap when there is no rest */
+          if (black_level < white_level)
+            histrest = area - hist0 - hist255;
+
+          /* histogram_get_median() draws a value if there is a median */
+          if (histrest)
+            band->rands[n_rands++] = rand ();
 
-          /*
-           * Check the histogram and adjust the diameter accordingly...
-           */
           if (filter_type & FILTER_ADAPTIVE)
-            {
-              if (hist0 >= adapt_radius || hist255 >= adapt_radius)
-                {
-                  if (adapt_radius < radius)
-                    adapt_radius++;
-                }
-              else if (adapt_radius > 1)
-                {
-                  adapt_radius--;
-                }
-            }
+            adapt_radius_update (adapt_radius, band->radius, hist0, hist255);
         }
+    }
+
+#undef SUM_RECT
+
+  g_free (sum255);
+  g_free (sum0);
+}
+
+static void
+despeckle_band_func (gint           i,
+                     gint           n,
+                     DespeckleBand *band)
+{
+  DespeckleHistogram *hist;
+  const gint          rowstride = band->rows->width * band->rows->bpp;
+  gint                row;
+
+  hist = g_new0 (DespeckleHistogram, 1);
 
-      progress += width;
+  while ((row = g_atomic_int_add (&band->next_row, 1)) < band->height)
+    {
+      gint adapt_radius = band->start_radius[row];
+
+      despeckle_median_row (hist, band->rows,
+                            band->dst + row * rowstride,
+                            band->y + row,
+                            band->radius, &adapt_radius,
+                            band->rands + band->row_rands[row]);
+    }
+
+  g_free (hist);
+}
+
+/*
+ * 'despeckle_median()' - Despeckle the rows y to y + height - 1 of the
+ *                        area into dst. rows must hold these rows and
+ *                        the rows radius above and below them.
+ */
+
+static void
+despeckle_median (DespeckleRows *rows,
+                  guchar        *dst,
+                  gint           y,
+                  gint           height,
+                  gint           radius,
+                  gint          *adapt_radius)
+{
+  const gint rowstride = rows->width * rows->bpp;
+
+  if (filter_type & FILTER_RECURSIVE)
+    {
+      /* Each row reads the pixels despeckled in the rows before */
+      DespeckleHistogram *hist = g_new0 (DespeckleHistogram, 1);
+      gint                row;
+
+      for (row = 0; row < height; row++)
+        despeckle_median_row (hist, rows, dst + row * rowstride, y + row,
+                              radius, adapt_radius, NULL);
+
+      g_free (hist);
+    }
+  else
+    {
+      DespeckleBand band;
+
+      band.rows     = rows;
+      band.dst      = dst;
+      band.y        = y;
+      band.height   = height;
+      band.radius   = radius;
+      band.next_row = 0;
+
+      despeckle_band_prepare (&band, adapt_radius);
+
+      gimp_parallel_distribute (height,
+                                (GimpParallelDistributeFunc)
+                                despeckle_band_func,
+                                &band);
+
+      g_free (band.rands);
+      g_free (band.row_rands);
+      g_free (band.start_radius);
+    }
+}
+
+/*
+ * 'despeckle_rows_load()' - Make rows hold the rows y0 to y0 + n_rows - 1
+ *                           of the area at x, y.
+ *
+ * Rows which are already loaded are kept, in recursive mode they hold
+ * the pixels despeckled so far.
+ */
+
+static void
+despeckle_rows_load (DespeckleRows *rows,
+                     GimpPixelRgn  *src_rgn,
+                     gint           x,
+                     gint           y,
+                     gint           y0,
+                     gint           n_rows)
+{
+  const gint rowstride = rows->width * rows->bpp;
+  gint       n_kept    = 0;
+  gint       i;
+
+  if (y0 >= rows->y0 && y0 < rows->y0 + rows->n_rows)
+    {
+      n_kept = MIN (rows->y0 + rows->n_rows - y0, n_rows);
+
+      memmove (rows->src,
+               rows->src + (y0 - rows->y0) * rowstride,
+               n_kept * rowstride);
+      memmove (rows->luma,
+               rows->luma + (y0 - rows->y0) * rows->width,
+               n_kept * rows->width);
+    }
+
+  if (n_rows > n_kept)
+    {
+      gimp_pixel_rgn_get_rect (src_rgn, rows->src + n_kept * rowstride,
+                               x, y + y0 + n_kept,
+                               rows->width, n_rows - n_kept);
 
-      if (! preview && y % 32 == 0)
-        gimp_progress_update ((gdouble) progress / (gdouble) max_progress);
+      for (i = n_kept * rows->width; i < n_rows * rows->width; i++)
+        rows->luma[i] = pixel_luminance (rows->src + i * rows->bpp,
+                                         rows->bpp);
     }
 
-  if (! preview)
-    gimp_progress_update (1.0);
+  rows->y0     = y0;
+  rows->n_rows = n_rows;
 }
@@ -53,6 +53,37 @@ typedef struct
   gint     mode;
 } OilifyVals;
 
+typedef struct
+{
+  gint     hist[HISTSIZE];
+  gint     hist_rgb[4][HISTSIZE];
+} OilifyHist;
+
+typedef struct
+{
+  gint     hist_max;
+  gfloat   exponent;
+  gint     exponent_int;
+  guint    stamp;
+  gfloat  *values;   /* the weight of each count           */
+  guint   *stamps;   /* valid iff equal to stamp           */
+} OilifyWeights;
+
+typedef struct
+{
+  const guchar  *src_buf;
+  const guchar  *src_inten_buf;
+  gint           x1, y1, x2, y2;
+  gint           width;
+  gint           bpp;
+  gboolean       use_inten;
+  GimpDrawable  *msmap_drawable;
+  GimpDrawable  *emap_drawable;
+  gint           max_radius;
+  gint         **spans;      /* spans[radius][dy], half width of row dy  */
+  gint           max_count;  /* pixels in the largest circle             */
+} OilifyContext;
+
 
 /* Declare local functions.
  */
@@ -326,6 +357,57 @@ fast_powf (gfloat x, gint y)
   return value;
 }
 
+/*
+ * The weights of the histogram values only depend on their number of
+ * occurrences, the maximum number of occurrences and the exponent. The
+ * weights of the counts seen so far are kept, until the maximum or the
+ * exponent change, since these are the same for many neighboring pixels.
+ */
+static inline void
+weights_prepare (OilifyWeights *weights,
+                 gint           hist[HISTSIZE],
+                 gfloat         exponent)
+{
+  gint i;
+  gint hist_max     = 1;
+  gint exponent_int = 0;
+
+  for (i = 0; i < HISTSIZE; i++)
+    hist_max = MAX (hist_max, hist[i]);
+
+  if ((exponent - floor (exponent)) < 0.001 && exponent <= 255.0)
+    exponent_int = (gint) exponent;
+
+  if (hist_max     != weights->hist_max ||
+      exponent     != weights->exponent ||
+      exponent_int != weights->exponent_int)
+    {
+      weights->hist_max     = hist_max;
+      weights->exponent     = exponent;
+      weights->exponent_int = exponent_int;
+      weights->stamp++;
+    }
+}
+
+static inline gfloat
+weights_get (OilifyWeights *weights,
+             gint           count)
+{
+  if (weights->stamps[count] != weights->stamp)
+    {
+      gfloat ratio = (gfloat) count / (gfloat) weights->hist_max;
+
+      if (weights->exponent_int)
+        weights->values[count] = fast_powf (ratio, weights->exponent_int);
+      else
+        weights->values[count] = pow (ratio, weights->exponent);
+
+      weights->stamps[count] = weights->stamp;
+    }
+
+  return weights->values[count];
+}
+
 /*
  * For each i in [0, HISTSIZE), hist[i] is the number of occurrences of the
  * value i. Return a value in [0, HISTSIZE) weighted heavily toward the
@@ -339,30 +421,20 @@ fast_powf (gfloat x, gint y)
  * (i.e. the normalized histogram frequency raised to some power)
  */
 static inline guchar
-weighted_average_value (gint hist[HISTSIZE], gfloat exponent)
+weighted_average_value (gint           hist[HISTSIZE],
+                        gfloat         exponent,
+                        OilifyWeights *weights)
 {
   gint   i;
-  gint   hist_max = 1;
-  gint   exponent_int = 0;
   gfloat sum = 0.0;
   gfloat div = 1.0e-6;
   gint   value;
 
-  for (i = 0; i < HISTSIZE; i++)
-    hist_max = MAX (hist_max, hist[i]);
-
-  if ((exponent - floor (exponent)) < 0.001 && exponent <= 255.0)
-    exponent_int = (gint) exponent;
+  weights_prepare (weights, hist, exponent);
 
   for (i = 0; i < HISTSIZE; i++)
     {
-      gfloat ratio = (gfloat) hist[i] / (gfloat) hist_max;
-      gfloat weight;
-
-      if (exponent_int)
-        weight = fast_powf (ratio, exponent_int);
-      else
-        weight = pow (ratio, exponent);
+      gfloat weight = weights_get (weights, hist[i]);
 
       sum += weight * (gfloat) i;
       div += weight;
@@ -384,33 +456,22 @@ weighted_average_value (gint hist[HISTSIZE], gfloat exponent)
  * The weight formula is the same as in weighted_average_value().
  */
 static inline void
-weighted_average_color (gint    hist[HISTSIZE],
-                        gint    hist_rgb[4][HISTSIZE],
-                        gfloat  exponent,
-                        guchar *dest,
-                        gint    bpp)
+weighted_average_color (gint           hist[HISTSIZE],
+                        gint           hist_rgb[4][HISTSIZE],
+                        gfloat         exponent,
+                        OilifyWeights *weights,
+                        guchar        *dest,
+                        gint           bpp)
 {
   gint   i, b;
-  gint   hist_max = 1;
-  gint   exponent_int = 0;
   gfloat div = 1.0e-6;
   gfloat color[4] = { 0.0, 0.0, 0.0, 0.0 };
 
-  for (i = 0; i < HISTSIZE; i++)
-    hist_max = MAX (hist_max, hist[i]);
-
-  if ((exponent - floor (exponent)) < 0.001 && exponent <= 255.0)
-    exponent_int = (gint) exponent;
+  weights_prepare (weights, hist, exponent);
 
   for (i = 0; i < HISTSIZE; i++)
     {
-      gfloat ratio = (gfloat) hist[i] / (gfloat) hist_max;
-      gfloat weight;
-
-      if (exponent_int)
-        weight = fast_powf (ratio, exponent_int);
-      else
-        weight = pow (ratio, exponent);
+      gfloat weight = weights_get (weights, hist[i]);
 
       if (hist[i] > 0)
         for (b = 0; b < bpp; b++)
@@ -427,6 +488,214 @@ weighted_average_color (gint    hist[HISTSIZE],
     }
 }
 
+/*
+ * Add (delta == 1) or remove (delta == -1) the source pixel at (x,y)
+ * to or from the histograms.
+ */
+static inline void
+oilify_hist_update (OilifyHist          *hist,
+                    const OilifyContext *ctx,
+                    gint                 x,
+                    gint                 y,
+                    gint                 delta)
+{
+  gint          offset = (y - ctx->y1) * ctx->width + (x - ctx->x1);
+  const guchar *src    = ctx->src_buf + offset * ctx->bpp;
+  gint          b;
+
+  if (ctx->use_inten)
+    {
+      gint inten = ctx->src_inten_buf[offset];
+
+      hist->hist[inten] += delta;
+      for (b = 0; b < ctx->bpp; b++)
+        hist->hist_rgb[b][inten] += delta * src[b];
+    }
+  else
+    {
+      for (b = 0; b < ctx->bpp; b++)
+        hist->hist_rgb[b][src[b]] += delta;
+    }
+}
+
+/*
+ * Fill the histograms with the circle of the given radius centered
+ * at (x,y).
+ */
+static void
+oilify_hist_init (OilifyHist          *hist,
+                  const OilifyContext *ctx,
+                  gint                 x,
+                  gint                 y,
+                  gint                 radius)
+{
+  const gint *spans = ctx->spans[radius];
+  gint        dy;
+
+  memset (hist, 0, sizeof (OilifyHist));
+
+  for (dy = MAX (-radius, ctx->y1 - y);
+       dy <= MIN (radius, ctx->y2 - 1 - y);
+       dy++)
+    {
+      gint span   = spans[ABS (dy)];
+      gint mask_x = MAX (x - span, ctx->x1);
+      gint end_x  = MIN (x + span, ctx->x2 - 1);
+
+      for (; mask_x <= end_x; mask_x++)
+        oilify_hist_update (hist, ctx, mask_x, y + dy, 1);
+    }
+}
+
+/*
+ * Move the circle of the given radius from (x-1,y) to (x,y), removing
+ * the left ends of its rows and adding the new right ends.
+ */
+static void
+oilify_hist_move (OilifyHist          *hist,
+                  const OilifyContext *ctx,
+                  gint                 x,
+                  gint                 y,
+                  gint                 radius)
+{
+  const gint *spans = ctx->spans[radius];
+  gint        dy;
+
+  for (dy = MAX (-radius, ctx->y1 - y);
+       dy <= MIN (radius, ctx->y2 - 1 - y);
+       dy++)
+    {
+      gint span = spans[ABS (dy)];
+
+      if (x - 1 - span >= ctx->x1)
+        oilify_hist_update (hist, ctx, x - 1 - span, y + dy, -1);
+
+      if (x + span < ctx->x2)
+        oilify_hist_update (hist, ctx, x + span, y + dy, 1);
+    }
+}
+
+/*
+ * Read the area of a mask-size/exponent map the chunk covers.
+ */
+static guchar *
+oilify_read_map (GimpDrawable *map,
+                 gint          x,
+                 gint          y,
+                 gint          width,
+                 gint          height)
+{
+  GimpPixelRgn  map_rgn;
+  guchar       *buf;
+
+  buf = g_new (guchar, width * height * map->bpp);
+
+  gimp_pixel_rgn_init (&map_rgn, map, x, y, width, height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&map_rgn, buf, x, y, width, height);
+
+  return buf;
+}
+
+/*
+ * Oilify one chunk of the area. Along each row, the histograms are
+ * updated as the circle moves, and only rebuilt when a mask-size map
+ * changes its radius. Chunks are processed concurrently.
+ */
+static void
+oilify_area (gint                 x,
+             gint                 y,
+             gint                 width,
+             gint                 height,
+             guchar              *dest,
+             gint                 rowstride,
+             const OilifyContext *ctx)
+{
+  OilifyHist     hist;
+  OilifyWeights  weights;
+  guchar        *msmap_buf = NULL;
+  guchar        *emap_buf  = NULL;
+  gint           msmap_bpp = 0;
+  gint           emap_bpp  = 0;
+  gint           row;
+
+  weights.hist_max     = 0;
+  weights.exponent     = 0.0;
+  weights.exponent_int = 0;
+  weights.stamp        = 0;
+  weights.values       = g_new (gfloat, ctx->max_count + 1);
+  weights.stamps       = g_new0 (guint, ctx->max_count + 1);
+
+  if (ctx->msmap_drawable)
+    {
+      msmap_buf = oilify_read_map (ctx->msmap_drawable, x, y, width, height);
+      msmap_bpp = ctx->msmap_drawable->bpp;
+    }
+
+  if (ctx->emap_drawable)
+    {
+      emap_buf = oilify_read_map (ctx->emap_drawable, x, y, width, height);
+      emap_bpp = ctx->emap_drawable->bpp;
+    }
+
+  for (row = 0; row < height; row++)
+    {
+      gint    prev_radius = -1;
+      gint    col;
+      guchar *d           = dest + row * rowstride;
+
+      for (col = 0; col < width; col++, d += ctx->bpp)
+        {
+          gint   radius;
+          gfloat exponent;
+
+          if (msmap_buf)
+            {
+              gfloat factor = get_map_value (msmap_buf +
+                                             (row * width + col) * msmap_bpp,
+                                             msmap_bpp);
+
+              radius = ROUND (factor * (0.5 * ovals.mask_size));
+            }
+          else
+            {
+              radius = (gint) ovals.mask_size / 2;
+            }
+
+          exponent = ovals.exponent;
+          if (emap_buf)
+            exponent *= get_map_value (emap_buf +
+                                       (row * width + col) * emap_bpp,
+                                       emap_bpp);
+
+          if (radius == prev_radius)
+            oilify_hist_move (&hist, ctx, x + col, y + row, radius);
+          else
+            oilify_hist_init (&hist, ctx, x + col, y + row, radius);
+
+          prev_radius = radius;
+
+          if (ctx->use_inten)
+            {
+              weighted_average_color (hist.hist, hist.hist_rgb,
+                                      exponent, &weights, d, ctx->bpp);
+            }
+          else
+            {
+              gint b;
+
+              for (b = 0; b < ctx->bpp; b++)
+                d[b] = weighted_average_value (hist.hist_rgb[b],
+                                               exponent, &weights);
+            }
+        }
+    }
+
+  g_free (emap_buf);
+  g_free (msmap_buf);
+  g_free (weights.stamps);
+  g_free (weights.values);
+}
+
 /*
  * For all x and y as requested, replace the pixel at (x,y)
  * with a weighted average of the most frequently occurring
@@ -436,111 +705,88 @@ static void
 oilify (GimpDrawable *drawable,
         GimpPreview  *preview)
 {
-  gboolean      use_inten;
-  gboolean      use_msmap = FALSE;
-  gboolean      use_emap = FALSE;
-  GimpDrawable *mask_size_map_drawable = NULL;
-  GimpDrawable *exponent_map_drawable = NULL;
-  GimpPixelRgn  mask_size_map_rgn;
-  GimpPixelRgn  exponent_map_rgn;
-  gint          msmap_bpp = 0;
-  gint          emap_bpp = 0;
-  GimpPixelRgn  dest_rgn;
-  GimpPixelRgn *regions[3];
-  gint          n_regions;
-  gint          bpp;
-  gint         *sqr_lut;
-  gint          x1, y1, x2, y2;
+  OilifyContext ctx = { 0, };
+  GimpPixelRgn  src_rgn;
+  gint          x1, y1;
   gint          width, height;
-  gint          Hist[HISTSIZE];
-  gint          Hist_rgb[4][HISTSIZE];
-  gpointer      pr;
-  gint          progress, max_progress;
   guchar       *src_buf;
   guchar       *src_inten_buf = NULL;
+  gint          r;
   gint          i;
 
-  use_inten = (ovals.mode == MODE_INTEN);
+  ctx.use_inten = (ovals.mode == MODE_INTEN);
 
   /*  Get the selection bounds  */
   if (preview)
     {
       gimp_preview_get_position (preview, &x1, &y1);
       gimp_preview_get_size (preview, &width, &height);
-
-      x2 = x1 + width;
-      y2 = y1 + height;
     }
   else
     {
       if (! gimp_drawable_mask_intersect (drawable->drawable_id,
                                           &x1, &y1, &width, &height))
 	return;
-
-      x2 = x1 + width;
-      y2 = y1 + height;
     }
 
-  progress = 0;
-  max_progress = width * height;
-
-  bpp = drawable->bpp;
-
-  /*
-   * Look-up-table implementation of the square function, for use in the
-   * VERY TIGHT inner loops
-   */
-  {
-    gint lut_size = (gint) ovals.mask_size / 2 + 1;
-
-    sqr_lut = g_new (gint, lut_size);
-
-    for (i = 0; i < lut_size; i++)
-      sqr_lut[i] = SQR (i);
-  }
+  ctx.x1    = x1;
+  ctx.y1    = y1;
+  ctx.x2    = x1 + width;
+  ctx.y2    = y1 + height;
+  ctx.width = width;
+  ctx.bpp   = drawable->bpp;
 
   /*  Get the map drawables, if applicable  */
 
   if (ovals.use_mask_size_map && ovals.mask_size_map >= 0)
-    {
-      use_msmap = TRUE;
+    ctx.msmap_drawable = gimp_drawable_get (ovals.mask_size_map);
 
-      mask_size_map_drawable = gimp_drawable_get (ovals.mask_size_map);
-      gimp_pixel_rgn_init (&mask_size_map_rgn, mask_size_map_drawable,
-                           x1, y1, width, height, FALSE, FALSE);
+  if (ovals.use_exponent_map && ovals.exponent_map >= 0)
+    ctx.emap_drawable = gimp_drawable_get (ovals.exponent_map);
 
-      msmap_bpp = mask_size_map_drawable->bpp;
-    }
+  /*
+   * The half widths of the rows of the circles of all possible radii,
+   * and the number of pixels in the largest circle
+   */
+  if (ctx.msmap_drawable)
+    ctx.max_radius = ROUND (0.5 * ovals.mask_size);
+  else
+    ctx.max_radius = (gint) ovals.mask_size / 2;
 
-  if (ovals.use_exponent_map && ovals.exponent_map >= 0)
+  ctx.spans = g_new (gint *, ctx.max_radius + 1);
+
+  for (r = 0; r <= ctx.max_radius; r++)
     {
-      use_emap = TRUE;
+      gint span = r;
+      gint dy;
 
-      exponent_map_drawable = gimp_drawable_get (ovals.exponent_map);
-      gimp_pixel_rgn_init (&exponent_map_rgn, exponent_map_drawable,
-                           x1, y1, width, height, FALSE, FALSE);
+      ctx.spans[r] = g_new (gint, r + 1);
+
+      for (dy = 0; dy <= r; dy++)
+        {
+          /*  Stay inside a circular mask area  */
+          while (SQR (span) + SQR (dy) > SQR (r))
+            span--;
 
-      emap_bpp = exponent_map_drawable->bpp;
+          ctx.spans[r][dy] = span;
+        }
     }
 
-  gimp_pixel_rgn_init (&dest_rgn, drawable,
-                       x1, y1, width, height, (preview == NULL), TRUE);
+  ctx.max_count = SQR (2 * ctx.max_radius + 1);
 
-  {
-    GimpPixelRgn src_rgn;
+  gimp_pixel_rgn_init (&src_rgn, drawable,
+                       x1, y1, width, height, FALSE, FALSE);
+  src_buf = g_new (guchar, width * height * ctx.bpp);
+  gimp_pixel_rgn_get_rect (&src_rgn, src_buf, x1, y1, width, height);
 
-    gimp_pixel_rgn_init (&src_rgn, drawable,
-                         x1, y1, width, height, FALSE, FALSE);
-    src_buf = g_new (guchar, width * height * bpp);
-    gimp_pixel_rgn_get_rect (&src_rgn, src_buf, x1, y1, width, height);
-  }
+  ctx.src_buf = src_buf;
 
   /*
    * If we're working in intensity mode, then generate a separate intensity
    * map of the source image. This way, we can avoid calculating the
    * intensity of any given source pixel more than once.
    */
-  if (use_inten)
+  if (ctx.use_inten)
     {
       guchar *src;
       guchar *dest;
@@ -554,183 +800,56 @@ oilify (GimpDrawable *drawable,
            i < (width * height)
            ;
            i++,
-           src += bpp,
+           src += ctx.bpp,
            dest++)
         {
           *dest = (guchar) GIMP_RGB_LUMINANCE (src[0], src[1], src[2]);
         }
-    }
 
-  n_regions = 0;
-  regions[n_regions++] = &dest_rgn;
-  if (use_msmap)
-    regions[n_regions++] = &mask_size_map_rgn;
-  if (use_emap)
-    regions[n_regions++] = &exponent_map_rgn;
+      ctx.src_inten_buf = src_inten_buf;
+    }
 
-  for (pr = gimp_pixel_rgns_register2 (n_regions, regions);
-       pr != NULL;
-       pr = gimp_pixel_rgns_process (pr))
+  if (preview)
     {
-      gint    y;
-      guchar *dest_row;
-      guchar *src_msmap_row = NULL;
-      guchar *src_emap_row = NULL;
-
-      for (y = dest_rgn.y,
-           dest_row = dest_rgn.data,
-           src_msmap_row = mask_size_map_rgn.data,  /* valid iff use_msmap */
-           src_emap_row = exponent_map_rgn.data     /* valid iff use_emap */
-           ;
-           y < (gint) (dest_rgn.y + dest_rgn.h)
-           ;
-           y++,
-           dest_row += dest_rgn.rowstride,
-           src_msmap_row += mask_size_map_rgn.rowstride,  /* valid iff use_msmap */
-           src_emap_row += exponent_map_rgn.rowstride)    /* valid iff use_emap */
-        {
-          gint    x;
-          guchar *dest;
-          guchar *src_msmap = NULL;
-          guchar *src_emap = NULL;
-
-          for (x = dest_rgn.x,
-               dest = dest_row,
-               src_msmap = src_msmap_row,  /* valid iff use_msmap */
-               src_emap = src_emap_row     /* valid iff use_emap */
-               ;
-               x < (gint) (dest_rgn.x + dest_rgn.w)
-               ;
-               x++,
-               dest += bpp,
-               src_msmap += msmap_bpp,  /* valid iff use_msmap */
-               src_emap += emap_bpp)    /* valid iff use_emap */
-            {
-              gint    radius, radius_squared;
-              gfloat  exponent;
-              gint    mask_x1, mask_y1;
-              gint    mask_x2, mask_y2;
-              gint    mask_y;
-              gint    src_offset;
-              guchar *src_row;
-              guchar *src_inten_row = NULL;
-
-              if (use_msmap)
-                {
-                  gfloat factor = get_map_value (src_msmap, msmap_bpp);
-
-                  radius = ROUND (factor * (0.5 * ovals.mask_size));
-                }
-              else
-                {
-                  radius = (gint) ovals.mask_size / 2;
-                }
-
-              radius_squared = SQR (radius);
-
-              exponent = ovals.exponent;
-              if (use_emap)
-                exponent *= get_map_value (src_emap, emap_bpp);
-
-              if (use_inten)
-                memset (Hist, 0, sizeof (Hist));
+      guchar *dest_buf = g_new (guchar, width * height * ctx.bpp);
 
-              memset (Hist_rgb, 0, sizeof (Hist_rgb));
+      gimp_parallel_process_buffer (dest_buf, width * ctx.bpp, ctx.bpp,
+                                    x1, y1, width, height, 0, 0,
+                                    (GimpParallelAreaFunc) oilify_area,
+                                    &ctx);
 
-              mask_x1 = CLAMP ((x - radius), x1, x2);
-              mask_y1 = CLAMP ((y - radius), y1, y2);
-              mask_x2 = CLAMP ((x + radius + 1), x1, x2);
-              mask_y2 = CLAMP ((y + radius + 1), y1, y2);
+      gimp_preview_draw_buffer (preview, dest_buf, width * ctx.bpp);
 
-              src_offset = (mask_y1 - y1) * width + (mask_x1 - x1);
+      g_free (dest_buf);
+    }
+  else
+    {
+      GimpPixelRgn dest_rgn;
 
-              for (mask_y = mask_y1,
-                   src_row = src_buf + src_offset * bpp,
-                   src_inten_row = src_inten_buf + src_offset  /* valid iff use_inten */
-                   ;
-                   mask_y < mask_y2
-                   ;
-                   mask_y++,
-                   src_row += width * bpp,
-                   src_inten_row += width)  /* valid iff use_inten */
-                {
-                  guchar *src;
-                  guchar *src_inten = NULL;
-                  gint    dy_squared = sqr_lut[ABS (mask_y - y)];
-                  gint    mask_x;
-
-                  for (mask_x = mask_x1,
-                       src = src_row,
-                       src_inten = src_inten_row  /* valid iff use_inten */
-                       ;
-                       mask_x < mask_x2
-                       ;
-                       mask_x++,
-                       src += bpp,
-                       src_inten++)  /* valid iff use_inten */
-                    {
-                      gint dx_squared = sqr_lut[ABS (mask_x - x)];
-                      gint b;
-
-                      /*  Stay inside a circular mask area  */
-                      if ((dx_squared + dy_squared) > radius_squared)
-                        continue;
-
-                      if (use_inten)
-                        {
-                          gint inten = *src_inten;
-                          ++Hist[inten];
-                          for (b = 0; b < bpp; b++)
-                            Hist_rgb[b][inten] += src[b];
-                        }
-                      else
-                        {
-                          for (b = 0; b < bpp; b++)
-                            ++Hist_rgb[b][src[b]];
-                        }
-
-                    } /* for mask_x */
-                } /* for mask_y */
-
-              if (use_inten)
-                {
-                  weighted_average_color (Hist, Hist_rgb, exponent, dest, bpp);
-                }
-              else
-                {
-                  gint b;
+      gimp_pixel_rgn_init (&dest_rgn, drawable,
+                           x1, y1, width, height, TRUE, TRUE);
 
-                  for (b = 0; b < bpp; b++)
-                    dest[b] = weighted_average_value (Hist_rgb[b], exponent);
-                }
+      gimp_parallel_process_rgn (&dest_rgn, 0, 0,
+                                 (GimpParallelAreaFunc) oilify_area,
+                                 &ctx);
+    }
 
-            } /* for x */
-        } /* for y */
+  /*  Detach from the map drawables  */
+  if (ctx.msmap_drawable)
+    gimp_drawable_detach (ctx.msmap_drawable);
 
-      if (preview)
-        {
-          gimp_drawable_preview_draw_region (GIMP_DRAWABLE_PREVIEW (preview),
-                                             &dest_rgn);
-        }
-      else
-        {
-          progress += dest_rgn.w * dest_rgn.h;
-          gimp_progress_update ((gdouble) progress / (gdouble) max_progress);
-        }
-    } /* for pr */
+  if (ctx.emap_drawable)
+    gimp_drawable_detach (ctx.emap_drawable);
 
-  /*  Detach from the map drawables  */
-  if (mask_size_map_drawable)
-    gimp_drawable_detach (mask_size_map_drawable);
+  for (r = 0; r <= ctx.max_radius; r++)
+    g_free (ctx.spans[r]);
 
-  if (exponent_map_drawable)
-    gimp_drawable_detach (exponent_map_drawable);
+  g_free (ctx.spans);
 
   if (src_inten_buf)
     g_free (src_inten_buf);
 
   g_free (src_buf);
-  g_free (sqr_lut);
 
   if (!preview)
     {
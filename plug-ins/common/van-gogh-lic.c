@@ -37,6 +37,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
@@ -95,34 +97,49 @@ static gboolean source_drw_has_alpha = FALSE;
 static gint    effect_width, effect_height;
 static gint    border_x, border_y, border_w, border_h;
 
+static gdouble uchar_to_double[256];
+
 static GtkWidget *dialog;
 
 /************************/
 /* Convenience routines */
 /************************/
 
-static void
-peek (GimpPixelRgn *src_rgn,
-      gint          x,
-      gint          y,
-      GimpRGB      *color)
+/* The source area and the scalar field are read once, the rows of the */
+/* selection are then convolved on several threads, which only read    */
+/* these and the other globals.                                         */
+
+typedef struct
+{
+  const guchar *src;
+  gint          bpp;
+  const guchar *scalarfield;
+  gboolean      rotate;
+} LicContext;
+
+static inline void
+peek (const LicContext *ctx,
+      gint              x,
+      gint              y,
+      GimpRGB          *color)
 {
-  static guchar data[4] = { 0, };
+  const guchar *data = ctx->src + ((gsize) y * border_w + x) * ctx->bpp;
 
-  gimp_pixel_rgn_get_pixel (src_rgn, data, x, y);
-  gimp_rgba_set_uchar (color, data[0], data[1], data[2], data[3]);
+  color->r = uchar_to_double[data[0]];
+  color->g = uchar_to_double[data[1]];
+  color->b = uchar_to_double[data[2]];
+  color->a = ctx->bpp > 3 ? uchar_to_double[data[3]] : 0.0;
 }
 
-static void
-poke (GimpPixelRgn *dest_rgn,
-      gint          x,
-      gint          y,
-      GimpRGB      *color)
+static inline void
+poke (guchar        *dest,
+      gint           bpp,
+      const GimpRGB *color)
 {
-  static guchar data[4];
+  guchar data[4];
 
   gimp_rgba_get_uchar (color, &data[0], &data[1], &data[2], &data[3]);
-  gimp_pixel_rgn_set_pixel (dest_rgn, data, x, y);
+  memcpy (dest, data, bpp);
 }
 
 static gint
@@ -191,6 +208,54 @@ grady (const guchar *image,
   return val;
 }
 
+/****************************************************/
+/* Get the normalized (and maybe rotated) gradient  */
+/* at x,y.  Away from the edges of the effect image */
+/* the kernels are applied without wrapping around. */
+/****************************************************/
+
+static void
+getvector (const LicContext *ctx,
+           gint              x,
+           gint              y,
+           gdouble          *vx,
+           gdouble          *vy)
+{
+  gdouble tmp;
+
+  if (x > 0 && x < effect_width  - 1 &&
+      y > 0 && y < effect_height - 1)
+    {
+      const guchar *m = ctx->scalarfield + (gsize) y * effect_width + x;
+      const guchar *t = m - effect_width;
+      const guchar *b = m + effect_width;
+
+      *vx = t[-1] - t[1] + 2 * (m[-1] - m[1]) + b[-1] - b[1];
+      *vy = t[-1] + 2 * t[0] + t[1] - b[-1] - 2 * b[0] - b[1];
+    }
+  else
+    {
+      *vx = gradx (ctx->scalarfield, x, y);
+      *vy = grady (ctx->scalarfield, x, y);
+    }
+
+  /* Rotate if needed */
+  if (ctx->rotate)
+    {
+      tmp = *vy;
+      *vy = -*vx;
+      *vx = tmp;
+    }
+
+  tmp = sqrt (*vx * *vx + *vy * *vy);
+  if (tmp >= 0.000001)
+    {
+      tmp = 1.0 / tmp;
+      *vx *= tmp;
+      *vy *= tmp;
+    }
+}
+
 /************************************/
 /* A nice 2nd order cubic spline :) */
 /************************************/
@@ -203,24 +268,6 @@ cubic (gdouble t)
   return (at < 1.0) ? at * at * (2.0 * at - 3.0) + 1.0 : 0.0;
 }
 
-static gdouble
-omega (gdouble u,
-       gdouble v,
-       gint    i,
-       gint    j)
-{
-  while (i < 0)
-    i += numx;
-
-  while (j < 0)
-    j += numy;
-
-  i %= numx;
-  j %= numy;
-
-  return cubic (u) * cubic (v) * (G[i][j][0]*u + G[i][j][1]*v);
-}
-
 /*************************************************************/
 /* The noise function (2D variant of Perlins noise function) */
 /*************************************************************/
@@ -229,19 +276,37 @@ static gdouble
 noise (gdouble x,
        gdouble y)
 {
-  gint i, sti = (gint) floor (x / dx);
-  gint j, stj = (gint) floor (y / dy);
+  gint sti = (gint) floor (x / dx);
+  gint stj = (gint) floor (y / dy);
+
+  gdouble u[2], v[2], cu[2], cv[2];
+  gint    gi[2], gj[2];
+  gint    i, j;
 
   gdouble sum = 0.0;
 
+  /* The weights of the four surrounding grid points only depend */
+  /* on their row and column, compute them once.                 */
+  /* ============================================================ */
+
+  for (i = 0; i < 2; i++)
+    {
+      u[i]  = (x - (gdouble) (sti + i) * dx) / dx;
+      cu[i] = cubic (u[i]);
+      gi[i] = ((sti + i) % numx + numx) % numx;
+
+      v[i]  = (y - (gdouble) (stj + i) * dy) / dy;
+      cv[i] = cubic (v[i]);
+      gj[i] = ((stj + i) % numy + numy) % numy;
+    }
+
   /* Calculate the gdouble sum */
   /* ======================== */
 
-  for (i = sti; i <= sti + 1; i++)
-    for (j = stj; j <= stj + 1; j++)
-      sum += omega ((x - (gdouble) i * dx) / dx,
-                    (y - (gdouble) j * dy) / dy,
-                    i, j);
+  for (i = 0; i < 2; i++)
+    for (j = 0; j < 2; j++)
+      sum += cu[i] * cv[j] * (G[gi[i]][gj[j]][0] * u[i] +
+                              G[gi[i]][gj[j]][1] * v[j]);
 
   return sum;
 }
@@ -327,38 +392,38 @@ lic_noise (gint    x,
 }
 
 static void
-getpixel (GimpPixelRgn *src_rgn,
-          GimpRGB      *p,
-          gdouble       u,
-          gdouble       v)
+getpixel (const LicContext *ctx,
+          GimpRGB          *p,
+          gdouble           u,
+          gdouble           v)
 {
   register gint x1, y1, x2, y2;
   gint width, height;
-  static GimpRGB pp[4];
+  GimpRGB pp[4];
 
-  width = src_rgn->w;
-  height = src_rgn->h;
+  width = border_w;
+  height = border_h;
 
   x1 = (gint)u;
   y1 = (gint)v;
 
   if (x1 < 0)
-    x1 = width - (-x1 % width);
+    x1 = (width - (-x1 % width)) % width;
   else
     x1 = x1 % width;
 
   if (y1 < 0)
-    y1 = height - (-y1 % height);
+    y1 = (height - (-y1 % height)) % height;
   else
     y1 = y1 % height;
 
   x2 = (x1 + 1) % width;
   y2 = (y1 + 1) % height;
 
-  peek (src_rgn, x1, y1, &pp[0]);
-  peek (src_rgn, x2, y1, &pp[1]);
-  peek (src_rgn, x1, y2, &pp[2]);
-  peek (src_rgn, x2, y2, &pp[3]);
+  peek (ctx, x1, y1, &pp[0]);
+  peek (ctx, x2, y1, &pp[1]);
+  peek (ctx, x1, y2, &pp[2]);
+  peek (ctx, x2, y2, &pp[3]);
 
   if (source_drw_has_alpha)
     *p = gimp_bilinear_rgba (u, v, pp);
@@ -367,12 +432,12 @@ getpixel (GimpPixelRgn *src_rgn,
 }
 
 static void
-lic_image (GimpPixelRgn *src_rgn,
-           gint          x,
-           gint          y,
-           gdouble       vx,
-           gdouble       vy,
-           GimpRGB      *color)
+lic_image (const LicContext *ctx,
+           gint              x,
+           gint              y,
+           gdouble           vx,
+           gdouble           vy,
+           GimpRGB          *color)
 {
   gdouble u, step = 2.0 * l / isteps;
   gdouble xx = (gdouble) x, yy = (gdouble) y;
@@ -389,7 +454,7 @@ lic_image (GimpPixelRgn *src_rgn,
   /* Calculate integral numerically */
   /* ============================== */
 
-  getpixel (src_rgn, &col1, xx + l * c, yy + l * s);
+  getpixel (ctx, &col1, xx + l * c, yy + l * s);
   if (source_drw_has_alpha)
     gimp_rgba_multiply (&col1, filter (-l));
   else
@@ -397,7 +462,7 @@ lic_image (GimpPixelRgn *src_rgn,
 
   for (u = -l + step; u <= l; u += step)
     {
-      getpixel (src_rgn, &col2, xx - u * c, yy - u * s);
+      getpixel (ctx, &col2, xx - u * c, yy - u * s);
       if (source_drw_has_alpha)
         {
           gimp_rgba_multiply (&col2, filter (u));
@@ -431,32 +496,42 @@ static guchar*
 rgb_to_hsl (GimpDrawable     *drawable,
             LICEffectChannel  effect_channel)
 {
-  guchar       *themap, data[4];
+  guchar       *themap, *row;
   gint          x, y;
   GimpRGB       color;
   GimpHSL       color_hsl;
   gdouble       val = 0.0;
   glong         maxc, index = 0;
   GimpPixelRgn  region;
+  gboolean      is_rgb;
   GRand        *gr;
 
   gr = g_rand_new ();
 
   maxc = drawable->width * drawable->height;
 
-  gimp_pixel_rgn_init (&region, drawable, border_x, border_y,
-                       border_w, border_h, FALSE, FALSE);
+  /* the effect image may be grayscale when called non-interactively */
+  is_rgb = gimp_drawable_is_rgb (drawable->drawable_id);
+
+  gimp_pixel_rgn_init (&region, drawable, 0, 0,
+                       drawable->width, drawable->height, FALSE, FALSE);
 
   themap = g_new (guchar, maxc);
+  row = g_new (guchar, drawable->width * drawable->bpp);
 
   for (y = 0; y < region.h; y++)
     {
-      for (x = 0; x < region.w; x++)
+      const guchar *data = row;
+
+      gimp_pixel_rgn_get_row (&region, row, 0, y, region.w);
+
+      for (x = 0; x < region.w; x++, data += drawable->bpp)
         {
-          data[3] = 255;
+          if (is_rgb)
+            gimp_rgb_set_uchar (&color, data[0], data[1], data[2]);
+          else
+            gimp_rgb_set_uchar (&color, data[0], data[0], data[0]);
 
-          gimp_pixel_rgn_get_pixel (&region, data, x, y);
-          gimp_rgba_set_uchar (&color, data[0], data[1], data[2], data[3]);
           gimp_rgb_to_hsl (&color, &color_hsl);
 
           switch (effect_channel)
@@ -479,62 +554,43 @@ rgb_to_hsl (GimpDrawable     *drawable,
         }
     }
 
+  g_free (row);
   g_rand_free (gr);
 
   return themap;
 }
 
-
 static void
-compute_lic (GimpDrawable *drawable,
-             const guchar *scalarfield,
-             gboolean      rotate)
+lic_area (gint      x,
+          gint      y,
+          gint      width,
+          gint      height,
+          guchar   *dest,
+          gint      rowstride,
+          gpointer  data)
 {
-  gint xcount, ycount;
-  GimpRGB color;
-  gdouble vx, vy, tmp;
-  GimpPixelRgn src_rgn, dest_rgn;
-
-  gimp_pixel_rgn_init (&src_rgn, drawable,
-                       border_x, border_y,
-                       border_w, border_h, FALSE, FALSE);
-
-  gimp_pixel_rgn_init (&dest_rgn, drawable,
-                       border_x, border_y,
-                       border_w, border_h, TRUE, TRUE);
+  const LicContext *ctx = data;
+  gint              xcount, ycount;
+  GimpRGB           color;
+  gdouble           vx, vy, tmp;
 
-  for (ycount = 0; ycount < src_rgn.h; ycount++)
+  for (ycount = y - border_y; ycount < y - border_y + height; ycount++)
     {
-      for (xcount = 0; xcount < src_rgn.w; xcount++)
+      guchar *d = dest;
+
+      for (xcount = x - border_x; xcount < x - border_x + width; xcount++)
         {
           /* Get derivative at (x,y) and normalize it */
           /* ============================================================== */
 
-          vx = gradx (scalarfield, xcount, ycount);
-          vy = grady (scalarfield, xcount, ycount);
-
-          /* Rotate if needed */
-          if (rotate)
-            {
-              tmp = vy;
-              vy = -vx;
-              vx = tmp;
-            }
-
-          tmp = sqrt (vx * vx + vy * vy);
-          if (tmp >= 0.000001)
-            {
-              tmp = 1.0 / tmp;
-              vx *= tmp;
-              vy *= tmp;
-            }
+          getvector (ctx, xcount + border_x, ycount + border_y, &vx, &vy);
 
           /* Convolve with the LIC at (x,y) */
           /* ============================== */
 
           if (licvals.effect_convolve == 0)
             {
-              peek (&src_rgn, xcount, ycount, &color);
+              peek (ctx, xcount, ycount, &color);
               tmp = lic_noise (xcount, ycount, vx, vy);
               if (source_drw_has_alpha)
                 gimp_rgba_multiply (&color, tmp);
@@ -543,13 +599,51 @@ compute_lic (GimpDrawable *drawable,
             }
           else
             {
-              lic_image (&src_rgn, xcount, ycount, vx, vy, &color);
+              lic_image (ctx, xcount, ycount, vx, vy, &color);
             }
-          poke (&dest_rgn, xcount, ycount, &color);
+
+          poke (d, ctx->bpp, &color);
+          d += ctx->bpp;
         }
 
-      gimp_progress_update ((gfloat) ycount / (gfloat) src_rgn.h);
+      dest += rowstride;
     }
+}
+
+static void
+compute_lic (GimpDrawable *drawable,
+             const guchar *scalarfield,
+             gboolean      rotate)
+{
+  LicContext   ctx;
+  guchar      *src;
+  gint         i;
+  GimpPixelRgn src_rgn, dest_rgn;
+
+  for (i = 0; i < 256; i++)
+    uchar_to_double[i] = (gdouble) i / 255.0;
+
+  gimp_pixel_rgn_init (&src_rgn, drawable,
+                       border_x, border_y,
+                       border_w, border_h, FALSE, FALSE);
+
+  src = g_new (guchar, (gsize) border_w * border_h * drawable->bpp);
+  gimp_pixel_rgn_get_rect (&src_rgn, src,
+                           border_x, border_y, border_w, border_h);
+
+  ctx.src         = src;
+  ctx.bpp         = drawable->bpp;
+  ctx.scalarfield = scalarfield;
+  ctx.rotate      = rotate;
+
+  gimp_pixel_rgn_init (&dest_rgn, drawable,
+                       border_x, border_y,
+                       border_w, border_h, TRUE, TRUE);
+
+  gimp_parallel_process_rgn (&dest_rgn, 0, 0, lic_area, &ctx);
+
+  g_free (src);
+
   gimp_progress_update (1.0);
 }
 
@@ -264,9 +264,9 @@ get_image_resource_header (PSDimageres  *res_a,
       return -1;
     }
   res_a->data_len = GUINT32_FROM_BE (res_a->data_len);
-  res_a->data_start = ftell (f);
+  res_a->data_start = psd_ftell (f);
 
-  IFDBG(2) g_debug ("Type: %.4s, id: %d, start: %d, len: %d",
+  IFDBG(2) g_debug ("Type: %.4s, id: %d, start: %" G_GOFFSET_FORMAT ", len: %d",
                     res_a->type, res_a->id, res_a->data_start, res_a->data_len);
 
   return 0;
@@ -283,7 +283,7 @@ load_image_resource (PSDimageres  *res_a,
   gint  pad;
 
   /* Set file position to start of image resource data block */
-  if (fseek (f, res_a->data_start, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -404,7 +404,7 @@ load_image_resource (PSDimageres  *res_a,
     pad = 1;
 
   /* Set file position to end of image resource block */
-  if (fseek (f, res_a->data_start + res_a->data_len + pad, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start + res_a->data_len + pad, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -423,7 +423,7 @@ load_thumbnail_resource (PSDimageres  *res_a,
   gint  pad;
 
   /* Set file position to start of image resource data block */
-  if (fseek (f, res_a->data_start, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -445,7 +445,7 @@ load_thumbnail_resource (PSDimageres  *res_a,
     pad = 1;
 
   /* Set file position to end of image resource block */
-  if (fseek (f, res_a->data_start + res_a->data_len + pad, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start + res_a->data_len + pad, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -1300,7 +1300,7 @@ load_resource_1077 (const PSDimageres  *res_a,
 
   /* For now, skip first 4 bytes since intention is unclear. Seems to be
      a version number that is always one, but who knows. */
-  fseek (f, 4, SEEK_CUR);
+  psd_fseek (f, 4, SEEK_CUR);
 
   tot_rec = res_a->data_len / 13;
   if (tot_rec == 0)
@@ -1430,7 +1430,7 @@ load_resource_2000 (const PSDimageres  *res_a,
       return -1;
     }
 
-  if (fseek (f, 24, SEEK_CUR) < 0)
+  if (psd_fseek (f, 24, SEEK_CUR) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -1469,7 +1469,7 @@ load_resource_2000 (const PSDimageres  *res_a,
 
       if (type == PSD_PATH_FILL_RULE)
         {
-          if (fseek (f, 24, SEEK_CUR) < 0)
+          if (psd_fseek (f, 24, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               return -1;
@@ -1484,7 +1484,7 @@ load_resource_2000 (const PSDimageres  *res_a,
               return -1;
             }
 
-          if (fseek (f, 22, SEEK_CUR) < 0)
+          if (psd_fseek (f, 22, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               return -1;
@@ -1513,7 +1513,7 @@ load_resource_2000 (const PSDimageres  *res_a,
             closed = FALSE;
           cntr = 0;
           controlpoints = g_malloc (sizeof (gdouble) * num_rec * 6);
-          if (fseek (f, 22, SEEK_CUR) < 0)
+          if (psd_fseek (f, 22, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               g_free (controlpoints);
@@ -1560,7 +1560,7 @@ load_resource_2000 (const PSDimageres  *res_a,
               else
                 {
                   IFDBG(1) g_debug ("Unexpected path type record %d", type);
-                  if (fseek (f, 24, SEEK_CUR) < 0)
+                  if (psd_fseek (f, 24, SEEK_CUR) < 0)
                     {
                       psd_set_error (feof (f), errno, error);
                       return -1;
@@ -1578,7 +1578,7 @@ load_resource_2000 (const PSDimageres  *res_a,
 
       else
         {
-          if (fseek (f, 24, SEEK_CUR) < 0)
+          if (psd_fseek (f, 24, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               return -1;
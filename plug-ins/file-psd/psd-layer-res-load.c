@@ -198,20 +198,46 @@ static gint     load_resource_lnsr    (const PSDlayerres     *res_a,
 /* Public Functions */
 gint
 get_layer_resource_header (PSDlayerres  *res_a,
+                           guint16       psd_version,
                            FILE         *f,
                            GError      **error)
 {
+  /* PSB files store the length of some resource blocks as 8 bytes */
+  static const gchar * const psb_long_keys[] =
+  {
+    "LMsk", "Lr16", "Lr32", "Layr", "Mt16", "Mt32", "Mtrn",
+    "Alph", "FMsk", "lnk2", "FEid", "FXid", "PxSD"
+  };
+
+  guint16 len_version = 1;
+  gint    i;
+
   if (fread (res_a->sig, 4, 1, f) < 1
-      || fread (res_a->key, 4, 1, f) < 1
-      || fread (&res_a->data_len, 4, 1, f) < 1)
+      || fread (res_a->key, 4, 1, f) < 1)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
     }
-  res_a->data_len = GUINT32_FROM_BE (res_a->data_len);
-  res_a->data_start = ftell (f);
 
-  IFDBG(2) g_debug ("Sig: %.4s, key: %.4s, start: %d, len: %d",
+  if (psd_version == 2)
+    {
+      for (i = 0; i < G_N_ELEMENTS (psb_long_keys); i++)
+        {
+          if (memcmp (res_a->key, psb_long_keys[i], 4) == 0)
+            {
+              len_version = 2;
+              break;
+            }
+        }
+    }
+
+  if (psd_read_len (f, &res_a->data_len, len_version, error) < 0)
+    return -1;
+
+  res_a->data_start = psd_ftell (f);
+
+  IFDBG(2) g_debug ("Sig: %.4s, key: %.4s, start: %" G_GOFFSET_FORMAT
+                    ", len: %" G_GUINT64_FORMAT,
                      res_a->sig, res_a->key, res_a->data_start, res_a->data_len);
 
   return 0;
@@ -224,7 +250,7 @@ load_layer_resource (PSDlayerres  *res_a,
                      GError      **error)
 {
   /* Set file position to start of layer resource data block */
-  if (fseek (f, res_a->data_start, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -294,7 +320,7 @@ load_layer_resource (PSDlayerres  *res_a,
     }
 
   /* Set file position to end of layer resource block */
-  if (fseek (f, res_a->data_start + res_a->data_len, SEEK_SET) < 0)
+  if (psd_fseek (f, res_a->data_start + res_a->data_len, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
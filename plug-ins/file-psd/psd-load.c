@@ -38,8 +38,82 @@
 
 #define COMP_MODE_SIZE sizeof(guint16)
 
+/* Maximum number of decoded bands a layer decoding job queues before
+ * waiting for the main thread to write them to the layer buffer.
+ */
+#define PSD_MAX_QUEUED_BANDS 4
+
+#define PSD_ZIP_CHUNK_SIZE   (64 * 1024)
+
+
+/* Incremental decoder of the pixel data of one channel */
+typedef struct
+{
+  FILE         *f;
+  guint16       bps;                    /* Bits per sample */
+  guint16       compression;            /* Compression mode */
+  gboolean      empty;                  /* Channel has no data */
+  guint32       rows;                   /* Channel rows */
+  guint32       columns;                /* Channel columns */
+  guint32       readline_len;           /* Length of an uncompressed row */
+  guint32       row;                    /* Next row to decode */
+  goffset       next_in;                /* File offset of next data to read */
+  guint64       avail_in;               /* Compressed data left (ZIP) */
+  guint32      *rle_pack_len;           /* Compressed row lengths (RLE) */
+  gchar        *src;                    /* Compressed data buffer */
+  gsize         src_size;
+  gchar        *raw;                    /* Uncompressed rows buffer */
+  gsize         raw_size;
+  z_stream      zs;
+  gboolean      zs_init;
+} PSDchannelreader;
+
+/* Decoded rows of a layer (interleaved channels) or of its mask */
+typedef struct
+{
+  gboolean      mask;                   /* Band of layer mask rows */
+  gint32        y;                      /* First row */
+  gint32        height;                 /* Number of rows */
+  guchar       *pixels;
+} PSDband;
+
+/* Decoding job for the pixel data of one layer, run on a worker thread */
+typedef struct
+{
+  PSDimage     *img_a;
+  PSDlayer     *lyr;
+  goffset       chn_start[MAX_CHANNELS];   /* Channel data start addresses */
+  guint16       channel_idx[MAX_CHANNELS]; /* Layer channels in pixel order */
+  guint16       layer_channels;         /* Number of layer channels */
+  gint          mask_chn;               /* User mask channel index or -1 */
+  gboolean      alpha;                  /* Layer has an alpha channel */
+  gboolean      empty;                  /* Layer has no pixel data */
+  gboolean      empty_mask;             /* Layer mask has no pixel data */
+  gint32        l_x;                    /* Layer x */
+  gint32        l_y;                    /* Layer y */
+  gint32        l_w;                    /* Layer width */
+  gint32        l_h;                    /* Layer height */
+  gint32        lm_x;                   /* Layer mask x */
+  gint32        lm_y;                   /* Layer mask y */
+  gint32        lm_w;                   /* Layer mask width */
+  gint32        lm_h;                   /* Layer mask height */
+  GeglRectangle mask_crop;              /* Mask area within the layer */
+  gint32        band_rows;              /* Rows per band */
+
+  GMutex        mutex;
+  GCond         cond;
+  GQueue        bands;                  /* Decoded bands not written yet */
+  gboolean      done;
+  gboolean      cancel;
+  GError       *error;
+} PSDlayerjob;
+
 
 /*  Local function prototypes  */
+static gboolean         psd_check_size             (PSDimage     *img_a,
+                                                    gint          width,
+                                                    gint          height);
+
 static gint             read_header_block          (PSDimage     *img_a,
                                                     FILE         *f,
                                                     GError      **error);
@@ -72,10 +146,29 @@ static gint             add_image_resources        (gint32        image_id,
                                                     gboolean     *resolution_loaded,
                                                     GError      **error);
 
+static PSDlayerjob    * psd_layer_job_new          (PSDimage     *img_a,
+                                                    PSDlayer     *lyr,
+                                                    goffset       data_start);
+static void             psd_layer_job_free         (PSDlayerjob  *job);
+static gboolean         psd_layer_job_has_mask     (PSDlayerjob  *job);
+static void             psd_layer_job_cancel       (PSDlayerjob  *job);
+static gboolean         psd_layer_job_push_band    (PSDlayerjob  *job,
+                                                    PSDband      *band);
+static PSDband        * psd_layer_job_pop_band     (PSDlayerjob  *job,
+                                                    GError      **error);
+static gint             psd_layer_job_decode_layer (PSDlayerjob  *job,
+                                                    FILE         *f,
+                                                    GError      **error);
+static gint             psd_layer_job_decode_mask  (PSDlayerjob  *job,
+                                                    FILE         *f,
+                                                    GError      **error);
+static void             psd_layer_job_run          (PSDlayerjob  *job,
+                                                    const gchar  *filename);
+
 static gint             add_layers                 (gint32        image_id,
                                                     PSDimage     *img_a,
                                                     PSDlayer    **lyr_a,
-                                                    FILE         *f,
+                                                    const gchar  *filename,
                                                     GError      **error);
 
 static gint             add_merged_image           (gint32        image_id,
@@ -91,13 +184,37 @@ static void             psd_to_gimp_color_map      (guchar       *map256);
 static GimpImageType    get_gimp_image_type        (GimpImageBaseType image_base_type,
                                                     gboolean          alpha);
 
-static gint             read_channel_data          (PSDchannel     *channel,
-                                                    guint16         bps,
-                                                    guint16         compression,
-                                                    const guint16  *rle_pack_len,
-                                                    FILE           *f,
-                                                    guint32         comp_len,
-                                                    GError        **error);
+static void             psd_channel_reader_init    (PSDchannelreader  *reader,
+                                                    PSDimage          *img_a,
+                                                    FILE              *f,
+                                                    guint32            rows,
+                                                    guint32            columns);
+static void             psd_channel_reader_clear   (PSDchannelreader  *reader);
+static gint    psd_channel_reader_read_rle_lengths (PSDchannelreader  *reader,
+                                                    guint16            psd_version,
+                                                    GError           **error);
+static gint        psd_channel_reader_open_layer   (PSDchannelreader  *reader,
+                                                    guint16            psd_version,
+                                                    goffset            data_start,
+                                                    guint64            data_len,
+                                                    GError           **error);
+static gint             psd_channel_reader_inflate (PSDchannelreader  *reader,
+                                                    gchar             *dst,
+                                                    gsize              len,
+                                                    GError           **error);
+static gint        psd_channel_reader_read_rows    (PSDchannelreader  *reader,
+                                                    guint32            n_rows,
+                                                    gchar             *dst,
+                                                    GError           **error);
+
+static void             interleave_channel         (guchar       *dst,
+                                                    const gchar  *src,
+                                                    gsize         n_pixels,
+                                                    gint          n_channels,
+                                                    gint          channel,
+                                                    gint          bpp);
+
+static void             psd_band_free              (PSDband      *band);
 
 static void             convert_1_bit              (const gchar *src,
                                                     gchar       *dst,
@@ -192,7 +309,7 @@ load_image (const gchar  *filename,
 
   /* ----- Add layers -----*/
   IFDBG(2) g_debug ("Add layers");
-  if (add_layers (image_id, &img_a, lyr_a, f, &error) < 0)
+  if (add_layers (image_id, &img_a, lyr_a, filename, &error) < 0)
     goto load_error;
   gimp_progress_update (0.9);
 
@@ -234,6 +351,22 @@ load_image (const gchar  *filename,
 
 /* Local functions */
 
+/* PSD channel data is addressed with 32 bit offsets, so a whole
+ * channel has to fit in G_MAXINT32 bytes.  PSB channels are decoded
+ * in bands of tile rows instead, so only such a band of the widest
+ * sample has to be addressable.
+ */
+static gboolean
+psd_check_size (PSDimage *img_a,
+                gint      width,
+                gint      height)
+{
+  if (img_a->version == 1)
+    return width <= G_MAXINT32 / MAX (height, 1);
+
+  return width <= G_MAXINT32 / (gimp_tile_height () * 4);
+}
+
 static gint
 read_header_block (PSDimage  *img_a,
                    FILE      *f,
@@ -275,13 +408,18 @@ read_header_block (PSDimage  *img_a,
       return -1;
     }
 
-  if (version != 1)
+  /* Version 1 is a PSD file, version 2 a PSB (large document format)
+   * file, which uses 8 byte lengths for the large data blocks.
+   */
+  if (version != 1 && version != 2)
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                   _("Unsupported file format version: %d"), version);
       return -1;
     }
 
+  img_a->version = version;
+
   if (img_a->channels > MAX_CHANNELS)
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
@@ -289,8 +427,8 @@ read_header_block (PSDimage  *img_a,
       return -1;
     }
 
-    /* Photoshop CS (version 8) supports 300000 x 300000, but this
-       is currently larger than GIMP_MAX_IMAGE_SIZE */
+    /* PSB files support up to 300000 x 300000 pixels, which is within
+       GIMP_MAX_IMAGE_SIZE */
 
   if (img_a->rows < 1 || img_a->rows > GIMP_MAX_IMAGE_SIZE)
     {
@@ -309,7 +447,7 @@ read_header_block (PSDimage  *img_a,
     }
 
   /* img_a->rows is sanitized above, so a division by zero is avoided here */
-  if (img_a->columns > G_MAXINT32 / img_a->rows)
+  if (! psd_check_size (img_a, img_a->columns, img_a->rows))
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                    _("Unsupported or invalid image size: %dx%d"),
@@ -443,7 +581,7 @@ read_image_resource_block (PSDimage  *img_a,
                            GError   **error)
 {
   guint32 block_len;
-  guint32 block_end;
+  goffset block_end;
 
   if (fread (&block_len, 4, 1, f) < 1)
     {
@@ -454,10 +592,10 @@ read_image_resource_block (PSDimage  *img_a,
 
   IFDBG(1) g_debug ("Image resource block size = %d", (int)img_a->image_res_len);
 
-  img_a->image_res_start = ftell (f);
+  img_a->image_res_start = psd_ftell (f);
   block_end = img_a->image_res_start + img_a->image_res_len;
 
-  if (fseek (f, block_end, SEEK_SET) < 0)
+  if (psd_fseek (f, block_end, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -554,8 +692,9 @@ read_layer_info (PSDimage  *img_a,
               return NULL;
             }
 
-          if ((lyr_a[lidx]->right - lyr_a[lidx]->left) >
-              G_MAXINT32 / MAX (lyr_a[lidx]->bottom - lyr_a[lidx]->top, 1))
+          if (! psd_check_size (img_a,
+                                lyr_a[lidx]->right - lyr_a[lidx]->left,
+                                lyr_a[lidx]->bottom - lyr_a[lidx]->top))
             {
               g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                            _("Unsupported or invalid layer size: %dx%d"),
@@ -573,18 +712,19 @@ read_layer_info (PSDimage  *img_a,
 
           for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
             {
-              if (fread (&lyr_a[lidx]->chn_info[cidx].channel_id, 2, 1, f) < 1
-                  || fread (&lyr_a[lidx]->chn_info[cidx].data_len, 4, 1, f) < 1)
+              if (fread (&lyr_a[lidx]->chn_info[cidx].channel_id, 2, 1, f) < 1)
                 {
                   psd_set_error (feof (f), errno, error);
                   return NULL;
                 }
+              if (psd_read_len (f, &lyr_a[lidx]->chn_info[cidx].data_len,
+                                img_a->version, error) < 0)
+                return NULL;
+
               lyr_a[lidx]->chn_info[cidx].channel_id =
                 GINT16_FROM_BE (lyr_a[lidx]->chn_info[cidx].channel_id);
-              lyr_a[lidx]->chn_info[cidx].data_len =
-                GUINT32_FROM_BE (lyr_a[lidx]->chn_info[cidx].data_len);
               img_a->layer_data_len += lyr_a[lidx]->chn_info[cidx].data_len;
-              IFDBG(3) g_debug ("Channel ID %d, data len %d",
+              IFDBG(3) g_debug ("Channel ID %d, data len %" G_GUINT64_FORMAT,
                                 lyr_a[lidx]->chn_info[cidx].channel_id,
                                 lyr_a[lidx]->chn_info[cidx].data_len);
             }
@@ -732,7 +872,7 @@ read_layer_info (PSDimage  *img_a,
 
             default:
               IFDBG(1) g_debug ("Unknown layer mask record size ... skipping");
-              if (fseek (f, block_len, SEEK_CUR) < 0)
+              if (psd_fseek (f, block_len, SEEK_CUR) < 0)
                 {
                   psd_set_error (feof (f), errno, error);
                   return NULL;
@@ -757,8 +897,9 @@ read_layer_info (PSDimage  *img_a,
               return NULL;
             }
 
-          if ((lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left) >
-              G_MAXINT32 / MAX (lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top, 1))
+          if (! psd_check_size (img_a,
+                                lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left,
+                                lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top))
             {
               g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                            _("Unsupported or invalid layer mask size: %dx%d"),
@@ -790,7 +931,7 @@ read_layer_info (PSDimage  *img_a,
 
           if (block_len > 0)
             {
-              if (fseek (f, block_len, SEEK_CUR) < 0)
+              if (psd_fseek (f, block_len, SEEK_CUR) < 0)
                 {
                   psd_set_error (feof (f), errno, error);
                   return NULL;
@@ -809,10 +950,14 @@ read_layer_info (PSDimage  *img_a,
 
           while (block_rem > 7)
             {
-              if (get_layer_resource_header (&res_a, f, error) < 0)
+              goffset res_start = psd_ftell (f);
+
+              if (get_layer_resource_header (&res_a, img_a->version,
+                                             f, error) < 0)
                 return NULL;
 
-              block_rem -= 12;
+              /* 12 bytes, or 16 for PSB resources with 8 byte lengths */
+              block_rem -= res_a.data_start - res_start;
 
               if (res_a.data_len % 2 != 0)
                 {
@@ -820,7 +965,8 @@ read_layer_info (PSDimage  *img_a,
                    *  try to recover graciously. See bug #771558.
                    */
                   g_printerr ("psd-load: Layer extra data length should "
-                              "be even, but it is %d.", res_a.data_len);
+                              "be even, but it is %" G_GUINT64_FORMAT ".",
+                              res_a.data_len);
                 }
 
               if (res_a.data_len > block_rem)
@@ -837,7 +983,7 @@ read_layer_info (PSDimage  *img_a,
             }
           if (block_rem > 0)
             {
-              if (fseek (f, block_rem, SEEK_CUR) < 0)
+              if (psd_fseek (f, block_rem, SEEK_CUR) < 0)
                 {
                   psd_set_error (feof (f), errno, error);
                   return NULL;
@@ -845,14 +991,14 @@ read_layer_info (PSDimage  *img_a,
             }
         }
 
-      img_a->layer_data_start = ftell(f);
-      if (fseek (f, img_a->layer_data_len, SEEK_CUR) < 0)
+      img_a->layer_data_start = psd_ftell (f);
+      if (psd_fseek (f, img_a->layer_data_len, SEEK_CUR) < 0)
         {
           psd_set_error (feof (f), errno, error);
           return NULL;
         }
 
-      IFDBG(1) g_debug ("Layer image data block size %d",
+      IFDBG(1) g_debug ("Layer image data block size %" G_GUINT64_FORMAT,
                         img_a->layer_data_len);
     }
 
@@ -866,19 +1012,17 @@ read_layer_block (PSDimage  *img_a,
                   GError   **error)
 {
   PSDlayer **lyr_a = NULL;
-  guint32    block_len;
-  guint32    block_end;
+  guint64    block_len;
+  goffset    block_end;
 
-  if (fread (&block_len, 4, 1, f) < 1)
+  if (psd_read_len (f, &img_a->mask_layer_len, img_a->version, error) < 0)
     {
-      psd_set_error (feof (f), errno, error);
       img_a->num_layers = -1;
       return NULL;
     }
 
-  img_a->mask_layer_len = GUINT32_FROM_BE (block_len);
-
-  IFDBG(1) g_debug ("Layer and mask block size = %d", img_a->mask_layer_len);
+  IFDBG(1) g_debug ("Layer and mask block size = %" G_GUINT64_FORMAT,
+                    img_a->mask_layer_len);
 
   img_a->transparency = FALSE;
   img_a->layer_data_len = 0;
@@ -890,16 +1034,16 @@ read_layer_block (PSDimage  *img_a,
     }
   else
     {
-      guint32 total_len = img_a->mask_layer_len;
+      guint64 total_len = img_a->mask_layer_len;
+      guint32 mask_info_len;
 
-      img_a->mask_layer_start = ftell (f);
+      img_a->mask_layer_start = psd_ftell (f);
       block_end = img_a->mask_layer_start + img_a->mask_layer_len;
 
       /* Layer info */
-      if (fread (&block_len, 4, 1, f) == 1 && block_len)
+      if (psd_read_len (f, &block_len, img_a->version, NULL) == 0 && block_len)
         {
-          block_len = GUINT32_FROM_BE (block_len);
-          IFDBG(1) g_debug ("Layer info size = %d", block_len);
+          IFDBG(1) g_debug ("Layer info size = %" G_GUINT64_FORMAT, block_len);
 
           lyr_a = read_layer_info (img_a, f, error);
 
@@ -912,15 +1056,15 @@ read_layer_block (PSDimage  *img_a,
         }
 
       /* Global layer mask info */
-      if (fread (&block_len, 4, 1, f) == 1 && block_len)
+      if (fread (&mask_info_len, 4, 1, f) == 1 && mask_info_len)
         {
-          block_len = GUINT32_FROM_BE (block_len);
-          IFDBG(1) g_debug ("Global layer mask info size = %d", block_len);
+          mask_info_len = GUINT32_FROM_BE (mask_info_len);
+          IFDBG(1) g_debug ("Global layer mask info size = %d", mask_info_len);
 
           /* read_global_layer_mask_info (img_a, f, error); */
-          fseek (f, block_len, SEEK_CUR);
+          psd_fseek (f, mask_info_len, SEEK_CUR);
 
-          total_len -= block_len;
+          total_len -= mask_info_len;
         }
 
       /* Additional Layer Information */
@@ -931,12 +1075,13 @@ read_layer_block (PSDimage  *img_a,
           if (fread (&signature_key, 4, 2, f) == 2 &&
               (memcmp (signature_key, "8BIMLr16", 8) == 0 ||
                memcmp (signature_key, "8BIMLr32", 8) == 0) &&
-              fread (&block_len, 4, 1, f) == 1 && block_len)
+              psd_read_len (f, &block_len, img_a->version, NULL) == 0 &&
+              block_len)
             lyr_a = read_layer_info (img_a, f, error);
         }
 
       /* Skip to end of block */
-      if (fseek (f, block_end, SEEK_SET) < 0)
+      if (psd_fseek (f, block_end, SEEK_SET) < 0)
         {
           psd_set_error (feof (f), errno, error);
           return NULL;
@@ -951,16 +1096,17 @@ read_merged_image_block (PSDimage  *img_a,
                          FILE      *f,
                          GError   **error)
 {
-  img_a->merged_image_start = ftell(f);
-  if (fseek (f, 0, SEEK_END) < 0)
+  img_a->merged_image_start = psd_ftell (f);
+  if (psd_fseek (f, 0, SEEK_END) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
     }
 
-  img_a->merged_image_len = ftell(f) - img_a->merged_image_start;
+  img_a->merged_image_len = psd_ftell (f) - img_a->merged_image_start;
 
-  IFDBG(1) g_debug ("Merged image data block: Start: %d, len: %d",
+  IFDBG(1) g_debug ("Merged image data block: Start: %" G_GOFFSET_FORMAT
+                    ", len: %" G_GUINT64_FORMAT,
                      img_a->merged_image_start, img_a->merged_image_len);
 
   return 0;
@@ -1065,7 +1211,7 @@ add_image_resources (gint32     image_id,
 {
   PSDimageres  res_a;
 
-  if (fseek (f, img_a->image_res_start, SEEK_SET) < 0)
+  if (psd_fseek (f, img_a->image_res_start, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -1081,7 +1227,7 @@ add_image_resources (gint32     image_id,
   img_a->alpha_id_count = 0;
   img_a->quick_mask_id = 0;
 
-  while (ftell (f) < img_a->image_res_start + img_a->image_res_len)
+  while (psd_ftell (f) < img_a->image_res_start + img_a->image_res_len)
     {
       if (get_image_resource_header (&res_a, f, error) < 0)
         return -1;
@@ -1101,45 +1247,434 @@ add_image_resources (gint32     image_id,
   return 0;
 }
 
+static PSDlayerjob *
+psd_layer_job_new (PSDimage *img_a,
+                   PSDlayer *lyr,
+                   goffset   data_start)
+{
+  PSDlayerjob *job;
+  gint         alpha_chn = -1;
+  gint         cidx;
+
+  job = g_new0 (PSDlayerjob, 1);
+
+  job->img_a     = img_a;
+  job->lyr       = lyr;
+  job->mask_chn  = -1;
+  job->band_rows = gimp_tile_height ();
+
+  g_mutex_init (&job->mutex);
+  g_cond_init (&job->cond);
+  g_queue_init (&job->bands);
+
+  /* Empty layer */
+  job->empty = (lyr->bottom - lyr->top == 0 ||
+                lyr->right - lyr->left == 0);
+
+  /* Empty mask */
+  job->empty_mask = (lyr->layer_mask.bottom - lyr->layer_mask.top == 0 ||
+                     lyr->layer_mask.right - lyr->layer_mask.left == 0);
+
+  IFDBG(3) g_debug ("Empty mask %d, size %d %d", job->empty_mask,
+                    lyr->layer_mask.bottom - lyr->layer_mask.top,
+                    lyr->layer_mask.right - lyr->layer_mask.left);
+
+  IFDBG(2) g_debug ("Number of channels: %d", lyr->num_channels);
+
+  for (cidx = 0; cidx < lyr->num_channels; ++cidx)
+    {
+      job->chn_start[cidx] = data_start;
+      data_start += lyr->chn_info[cidx].data_len;
+
+      IFDBG(3) g_debug ("Channel id %d, start %" G_GOFFSET_FORMAT
+                        ", length %" G_GUINT64_FORMAT,
+                        lyr->chn_info[cidx].channel_id,
+                        job->chn_start[cidx],
+                        lyr->chn_info[cidx].data_len);
+
+      switch (lyr->chn_info[cidx].channel_id)
+        {
+        case PSD_CHANNEL_EXTRA_MASK:
+          break;
+
+        case PSD_CHANNEL_MASK:
+          /* Works around a bug in panotools psd files where the layer mask
+             size is given as 0 but data exists. Set mask size to layer size.
+          */
+          if (job->empty_mask &&
+              lyr->chn_info[cidx].data_len > COMP_MODE_SIZE)
+            {
+              job->empty_mask = FALSE;
+              if (lyr->layer_mask.top == lyr->layer_mask.bottom)
+                {
+                  lyr->layer_mask.top = lyr->top;
+                  lyr->layer_mask.bottom = lyr->bottom;
+                }
+              if (lyr->layer_mask.right == lyr->layer_mask.left)
+                {
+                  lyr->layer_mask.right = lyr->right;
+                  lyr->layer_mask.left = lyr->left;
+                }
+            }
+          job->mask_chn = cidx;
+          break;
+
+        case PSD_CHANNEL_ALPHA:
+          alpha_chn = cidx;
+          break;
+
+        default:
+          if (lyr->chn_info[cidx].data_len > COMP_MODE_SIZE)
+            {
+              job->channel_idx[job->layer_channels] = cidx; /* Assumes in sane order */
+              job->layer_channels++;                        /* RGB, Lab, CMYK etc.   */
+            }
+          break;
+        }
+    }
+
+  if (alpha_chn != -1)
+    {
+      job->alpha = TRUE;
+      job->channel_idx[job->layer_channels] = alpha_chn;
+      job->layer_channels++;
+    }
+
+  if (job->empty || job->layer_channels == 0)
+    {
+      job->empty = TRUE;
+      job->l_x = 0;
+      job->l_y = 0;
+      job->l_w = img_a->columns;
+      job->l_h = img_a->rows;
+    }
+  else
+    {
+      job->l_x = lyr->left;
+      job->l_y = lyr->top;
+      job->l_w = lyr->right - lyr->left;
+      job->l_h = lyr->bottom - lyr->top;
+    }
+
+  if (job->mask_chn != -1 && ! job->empty_mask)
+    {
+      job->lm_x = lyr->layer_mask.left - job->l_x;
+      job->lm_y = lyr->layer_mask.top - job->l_y;
+      job->lm_w = lyr->layer_mask.right - lyr->layer_mask.left;
+      job->lm_h = lyr->layer_mask.bottom - lyr->layer_mask.top;
+
+      /* Part of the mask that lies within the layer boundary */
+      job->mask_crop.x      = MAX (0, -job->lm_x);
+      job->mask_crop.y      = MAX (0, -job->lm_y);
+      job->mask_crop.width  = MIN (job->lm_w, job->l_w - job->lm_x) -
+                              job->mask_crop.x;
+      job->mask_crop.height = MIN (job->lm_h, job->l_h - job->lm_y) -
+                              job->mask_crop.y;
+
+      IFDBG(3) g_debug ("Original Mask %d %d %d %d",
+                        job->lm_x, job->lm_y, job->lm_w, job->lm_h);
+    }
+
+  return job;
+}
+
+static void
+psd_layer_job_free (PSDlayerjob *job)
+{
+  PSDband *band;
+
+  while ((band = g_queue_pop_head (&job->bands)))
+    psd_band_free (band);
+
+  if (job->error)
+    g_error_free (job->error);
+
+  g_mutex_clear (&job->mutex);
+  g_cond_clear (&job->cond);
+
+  g_free (job);
+}
+
+static gboolean
+psd_layer_job_has_mask (PSDlayerjob *job)
+{
+  return (job->mask_chn != -1       &&
+          ! job->empty_mask         &&
+          job->mask_crop.width  > 0 &&
+          job->mask_crop.height > 0);
+}
+
+static void
+psd_layer_job_cancel (PSDlayerjob *job)
+{
+  g_mutex_lock (&job->mutex);
+
+  job->cancel = TRUE;
+  g_cond_broadcast (&job->cond);
+
+  g_mutex_unlock (&job->mutex);
+}
+
+/* Queues a decoded band for the main thread, waiting while too many
+ * bands are queued already.  Returns FALSE if the job was cancelled.
+ */
+static gboolean
+psd_layer_job_push_band (PSDlayerjob *job,
+                         PSDband     *band)
+{
+  gboolean cancel;
+
+  g_mutex_lock (&job->mutex);
+
+  while (g_queue_get_length (&job->bands) >= PSD_MAX_QUEUED_BANDS &&
+         ! job->cancel)
+    {
+      g_cond_wait (&job->cond, &job->mutex);
+    }
+
+  cancel = job->cancel;
+
+  if (! cancel)
+    {
+      g_queue_push_tail (&job->bands, band);
+      g_cond_broadcast (&job->cond);
+    }
+
+  g_mutex_unlock (&job->mutex);
+
+  if (cancel)
+    psd_band_free (band);
+
+  return ! cancel;
+}
+
+/* Returns the next decoded band of the layer, or NULL when all bands
+ * have been returned or decoding failed.
+ */
+static PSDband *
+psd_layer_job_pop_band (PSDlayerjob  *job,
+                        GError      **error)
+{
+  PSDband *band;
+
+  g_mutex_lock (&job->mutex);
+
+  while (g_queue_is_empty (&job->bands) && ! job->done)
+    g_cond_wait (&job->cond, &job->mutex);
+
+  band = g_queue_pop_head (&job->bands);
+
+  if (! band && job->error)
+    {
+      g_propagate_error (error, job->error);
+      job->error = NULL;
+    }
+
+  g_cond_broadcast (&job->cond);
+
+  g_mutex_unlock (&job->mutex);
+
+  return band;
+}
+
+static gint
+psd_layer_job_decode_layer (PSDlayerjob  *job,
+                            FILE         *f,
+                            GError      **error)
+{
+  PSDimage         *img_a = job->img_a;
+  PSDchannelreader  readers[MAX_CHANNELS];
+  gchar            *plane;
+  gint              bpp;
+  gint32            y;
+  gint              cidx;
+  gint              n_readers = 0;
+  gint              ret = -1;
+
+  bpp = MAX (img_a->bps / 8, 1);
+
+  for (cidx = 0; cidx < job->layer_channels; ++cidx)
+    {
+      gint chn = job->channel_idx[cidx];
+
+      psd_channel_reader_init (&readers[cidx], img_a, f, job->l_h, job->l_w);
+      n_readers++;
+
+      if (psd_channel_reader_open_layer (&readers[cidx],
+                                         img_a->version,
+                                         job->chn_start[chn],
+                                         job->lyr->chn_info[chn].data_len,
+                                         error) < 0)
+        goto out;
+    }
+
+  plane = g_malloc ((gsize) job->band_rows * job->l_w * bpp);
+
+  for (y = 0; y < job->l_h; y += job->band_rows)
+    {
+      PSDband *band;
+
+      band = g_new (PSDband, 1);
+
+      band->mask   = FALSE;
+      band->y      = y;
+      band->height = MIN (job->band_rows, job->l_h - y);
+      band->pixels = g_malloc ((gsize) band->height * job->l_w *
+                               job->layer_channels * bpp);
+
+      for (cidx = 0; cidx < job->layer_channels; ++cidx)
+        {
+          if (psd_channel_reader_read_rows (&readers[cidx], band->height,
+                                            plane, error) < 0)
+            {
+              psd_band_free (band);
+              g_free (plane);
+              goto out;
+            }
+
+          interleave_channel (band->pixels, plane,
+                              (gsize) band->height * job->l_w,
+                              job->layer_channels, cidx, bpp);
+        }
+
+      if (! psd_layer_job_push_band (job, band))
+        break;
+    }
+
+  g_free (plane);
+  ret = 0;
+
+ out:
+  for (cidx = 0; cidx < n_readers; ++cidx)
+    psd_channel_reader_clear (&readers[cidx]);
+
+  return ret;
+}
+
+static gint
+psd_layer_job_decode_mask (PSDlayerjob  *job,
+                           FILE         *f,
+                           GError      **error)
+{
+  PSDimage         *img_a = job->img_a;
+  PSDchannelreader  reader;
+  gint              bpp;
+  gint32            y;
+  gint32            end;
+  gint              ret = -1;
+
+  bpp = MAX (img_a->bps / 8, 1);
+
+  psd_channel_reader_init (&reader, img_a, f, job->lm_h, job->lm_w);
+
+  if (psd_channel_reader_open_layer (&reader,
+                                     img_a->version,
+                                     job->chn_start[job->mask_chn],
+                                     job->lyr->chn_info[job->mask_chn].data_len,
+                                     error) < 0)
+    goto out;
+
+  /* Rows below the layer boundary are cropped, no need to decode them */
+  end = job->mask_crop.y + job->mask_crop.height;
+
+  for (y = 0; y < end; y += job->band_rows)
+    {
+      PSDband *band;
+
+      band = g_new (PSDband, 1);
+
+      band->mask   = TRUE;
+      band->y      = y;
+      band->height = MIN (job->band_rows, end - y);
+      band->pixels = g_malloc ((gsize) band->height * job->lm_w * bpp);
+
+      if (psd_channel_reader_read_rows (&reader, band->height,
+                                        (gchar *) band->pixels, error) < 0)
+        {
+          psd_band_free (band);
+          goto out;
+        }
+
+      if (! psd_layer_job_push_band (job, band))
+        break;
+    }
+
+  ret = 0;
+
+ out:
+  psd_channel_reader_clear (&reader);
+
+  return ret;
+}
+
+/* Worker thread function, decodes the pixel data of one layer */
+static void
+psd_layer_job_run (PSDlayerjob *job,
+                   const gchar *filename)
+{
+  FILE     *f;
+  GError   *error = NULL;
+  gboolean  cancel;
+
+  g_mutex_lock (&job->mutex);
+  cancel = job->cancel;
+  g_mutex_unlock (&job->mutex);
+
+  if (! cancel)
+    {
+      /* Each job uses its own file handle */
+      f = g_fopen (filename, "rb");
+
+      if (f == NULL)
+        {
+          g_set_error (&error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                       _("Could not open '%s' for reading: %s"),
+                       gimp_filename_to_utf8 (filename), g_strerror (errno));
+        }
+      else
+        {
+          if (! job->empty)
+            psd_layer_job_decode_layer (job, f, &error);
+
+          if (! error && psd_layer_job_has_mask (job))
+            psd_layer_job_decode_mask (job, f, &error);
+
+          fclose (f);
+        }
+    }
+
+  g_mutex_lock (&job->mutex);
+
+  job->error = error;
+  job->done  = TRUE;
+  g_cond_broadcast (&job->cond);
+
+  g_mutex_unlock (&job->mutex);
+}
+
 static gint
-add_layers (gint32     image_id,
-            PSDimage  *img_a,
-            PSDlayer **lyr_a,
-            FILE      *f,
-            GError   **error)
+add_layers (gint32        image_id,
+            PSDimage     *img_a,
+            PSDlayer    **lyr_a,
+            const gchar  *filename,
+            GError      **error)
 {
-  PSDchannel          **lyr_chn;
+  PSDlayerjob         **jobs;
+  PSDlayerjob          *job;
+  PSDband              *band;
+  GThreadPool          *pool;
   GArray               *parent_group_stack;
   gint32                parent_group_id = -1;
-  guchar               *pixels;
-  guint16               alpha_chn;
-  guint16               user_mask_chn;
-  guint16               layer_channels;
-  guint16               channel_idx[MAX_CHANNELS];
-  guint16              *rle_pack_len;
-  guint16               bps;
-  gint32                l_x;                   /* Layer x */
-  gint32                l_y;                   /* Layer y */
-  gint32                l_w;                   /* Layer width */
-  gint32                l_h;                   /* Layer height */
-  gint32                lm_x;                  /* Layer mask x */
-  gint32                lm_y;                  /* Layer mask y */
-  gint32                lm_w;                  /* Layer mask width */
-  gint32                lm_h;                  /* Layer mask height */
-  gint32                layer_size;
   gint32                layer_id = -1;
   gint32                mask_id = -1;
   gint32                active_layer_id = -1;
+  goffset               data_start;
   gint                  lidx;                  /* Layer index */
   gint                  cidx;                  /* Channel index */
-  gint                  rowi;                  /* Row index */
-  gint                  coli;                  /* Column index */
-  gint                  i;
-  gboolean              alpha;
-  gboolean              user_mask;
-  gboolean              empty;
-  gboolean              empty_mask;
+  gint                  bpp;
+  gint                  ret = -1;
   GeglBuffer           *buffer;
+  GeglBuffer           *mask_buffer;
   GimpImageType         image_type;
   LayerModeInfo         mode_info;
 
@@ -1152,11 +1687,34 @@ add_layers (gint32     image_id,
       return 0;
     }
 
-  /* Layered image - Photoshop 3 style */
-  if (fseek (f, img_a->layer_data_start, SEEK_SET) < 0)
+  bpp = MAX (img_a->bps / 8, 1);
+
+  /* Layered image - Photoshop 3 style.  The pixel data of the layers is
+   * decoded in bands of tile rows on worker threads, several layers at
+   * a time, and written to the layer buffers on this thread as the
+   * bands arrive.
+   */
+  jobs = g_new0 (PSDlayerjob *, img_a->num_layers);
+  pool = g_thread_pool_new ((GFunc) psd_layer_job_run, (gpointer) filename,
+                            MAX (g_get_num_processors (), 1), FALSE, NULL);
+
+  data_start = img_a->layer_data_start;
+
+  for (lidx = 0; lidx < img_a->num_layers; ++lidx)
     {
-      psd_set_error (feof (f), errno, error);
-      return -1;
+      if (! lyr_a[lidx]->drop && lyr_a[lidx]->group_type == 0)
+        {
+          jobs[lidx] = psd_layer_job_new (img_a, lyr_a[lidx], data_start);
+
+          g_thread_pool_push (pool, jobs[lidx], NULL);
+        }
+      else
+        {
+          IFDBG(2) g_debug ("Skip pixel data of layer %d", lidx);
+        }
+
+      for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
+        data_start += lyr_a[lidx]->chn_info[cidx].data_len;
     }
 
   /* set the root of the group hierarchy */
@@ -1167,216 +1725,24 @@ add_layers (gint32     image_id,
     {
       IFDBG(2) g_debug ("Process Layer No %d.", lidx);
 
+      job = jobs[lidx];
+
       if (lyr_a[lidx]->drop)
         {
           IFDBG(2) g_debug ("Drop layer %d", lidx);
-
-          /* Step past layer data */
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            {
-              if (fseek (f, lyr_a[lidx]->chn_info[cidx].data_len, SEEK_CUR) < 0)
-                {
-                  psd_set_error (feof (f), errno, error);
-                  return -1;
-                }
-            }
         }
       else
         {
-          /* Empty layer */
-          if (lyr_a[lidx]->bottom - lyr_a[lidx]->top == 0
-              || lyr_a[lidx]->right - lyr_a[lidx]->left == 0)
-              empty = TRUE;
-          else
-              empty = FALSE;
-
-          /* Empty mask */
-          if (lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top == 0
-              || lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left == 0)
-              empty_mask = TRUE;
-          else
-              empty_mask = FALSE;
-
-          IFDBG(3) g_debug ("Empty mask %d, size %d %d", empty_mask,
-                            lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top,
-                            lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left);
-
-          /* Load layer channel data */
-          IFDBG(2) g_debug ("Number of channels: %d", lyr_a[lidx]->num_channels);
-          /* Create pointer array for the channel records */
-          lyr_chn = g_new (PSDchannel *, lyr_a[lidx]->num_channels);
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            {
-              guint16 comp_mode = PSD_COMP_RAW;
-
-              /* Allocate channel record */
-              lyr_chn[cidx] = g_malloc (sizeof (PSDchannel) );
-
-              lyr_chn[cidx]->id = lyr_a[lidx]->chn_info[cidx].channel_id;
-              lyr_chn[cidx]->rows = lyr_a[lidx]->bottom - lyr_a[lidx]->top;
-              lyr_chn[cidx]->columns = lyr_a[lidx]->right - lyr_a[lidx]->left;
-              lyr_chn[cidx]->data = NULL;
-
-              if (lyr_chn[cidx]->id == PSD_CHANNEL_EXTRA_MASK)
-                {
-                  if (fseek (f, lyr_a[lidx]->chn_info[cidx].data_len, SEEK_CUR) != 0)
-                    {
-                      psd_set_error (feof (f), errno, error);
-                      return -1;
-                    }
-
-                  continue;
-                }
-              else if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
-                {
-                  /* Works around a bug in panotools psd files where the layer mask
-                     size is given as 0 but data exists. Set mask size to layer size.
-                  */
-                  if (empty_mask && lyr_a[lidx]->chn_info[cidx].data_len - 2 > 0)
-                    {
-                      empty_mask = FALSE;
-                      if (lyr_a[lidx]->layer_mask.top == lyr_a[lidx]->layer_mask.bottom)
-                        {
-                          lyr_a[lidx]->layer_mask.top = lyr_a[lidx]->top;
-                          lyr_a[lidx]->layer_mask.bottom = lyr_a[lidx]->bottom;
-                        }
-                      if (lyr_a[lidx]->layer_mask.right == lyr_a[lidx]->layer_mask.left)
-                        {
-                          lyr_a[lidx]->layer_mask.right = lyr_a[lidx]->right;
-                          lyr_a[lidx]->layer_mask.left = lyr_a[lidx]->left;
-                        }
-                    }
-                  lyr_chn[cidx]->rows = (lyr_a[lidx]->layer_mask.bottom -
-                                        lyr_a[lidx]->layer_mask.top);
-                  lyr_chn[cidx]->columns = (lyr_a[lidx]->layer_mask.right -
-                                           lyr_a[lidx]->layer_mask.left);
-                }
-
-              IFDBG(3) g_debug ("Channel id %d, %dx%d",
-                                lyr_chn[cidx]->id,
-                                lyr_chn[cidx]->columns,
-                                lyr_chn[cidx]->rows);
-
-              /* Only read channel data if there is any channel
-               * data. Note that the channel data can contain a
-               * compression method but no actual data.
-               */
-              if (lyr_a[lidx]->chn_info[cidx].data_len >= COMP_MODE_SIZE)
-                {
-                  if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
-                    {
-                      psd_set_error (feof (f), errno, error);
-                      return -1;
-                    }
-                  comp_mode = GUINT16_FROM_BE (comp_mode);
-                  IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
-                }
-              if (lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE)
-                {
-                  switch (comp_mode)
-                    {
-                      case PSD_COMP_RAW:        /* Planar raw data */
-                        IFDBG(3) g_debug ("Raw data length: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2);
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               PSD_COMP_RAW, NULL, f, 0,
-                                               error) < 1)
-                          return -1;
-                        break;
-
-                      case PSD_COMP_RLE:        /* Packbits */
-                        IFDBG(3) g_debug ("RLE channel length %d, RLE length data: %d, "
-                                          "RLE data block: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                          lyr_chn[cidx]->rows * 2,
-                                          (lyr_a[lidx]->chn_info[cidx].data_len - 2 -
-                                           lyr_chn[cidx]->rows * 2));
-                        rle_pack_len = g_malloc (lyr_chn[cidx]->rows * 2);
-                        for (rowi = 0; rowi < lyr_chn[cidx]->rows; ++rowi)
-                          {
-                            if (fread (&rle_pack_len[rowi], 2, 1, f) < 1)
-                              {
-                                psd_set_error (feof (f), errno, error);
-                                g_free (rle_pack_len);
-                                return -1;
-                              }
-                            rle_pack_len[rowi] = GUINT16_FROM_BE (rle_pack_len[rowi]);
-                          }
-
-                        IFDBG(3) g_debug ("RLE decode - data");
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               PSD_COMP_RLE, rle_pack_len, f, 0,
-                                               error) < 1)
-                          return -1;
-
-                        g_free (rle_pack_len);
-                        break;
-
-                      case PSD_COMP_ZIP:                 /* ? */
-                      case PSD_COMP_ZIP_PRED:
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               comp_mode, NULL, f,
-                                               lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                               error) < 1)
-                          return -1;
-                        break;
-
-                      default:
-                        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                                    _("Unsupported compression mode: %d"), comp_mode);
-                        return -1;
-                        break;
-                    }
-                }
-            }
-
-          /* Draw layer */
-
-          alpha = FALSE;
-          alpha_chn = -1;
-          user_mask = FALSE;
-          user_mask_chn = -1;
-          layer_channels = 0;
-          l_x = 0;
-          l_y = 0;
-          l_w = img_a->columns;
-          l_h = img_a->rows;
           if (parent_group_stack->len > 0)
             parent_group_id = g_array_index (parent_group_stack, gint32,
                                              parent_group_stack->len - 1);
           else
             parent_group_id = -1; /* root */
 
-          IFDBG(3) g_debug ("Re-hash channel indices");
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
+          /* Create the layer */
+          if (lyr_a[lidx]->group_type != 0)
             {
-              if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
-                {
-                  user_mask = TRUE;
-                  user_mask_chn = cidx;
-                }
-              else if (lyr_chn[cidx]->id == PSD_CHANNEL_ALPHA)
-                {
-                  alpha = TRUE;
-                  alpha_chn = cidx;
-                }
-              else if (lyr_chn[cidx]->data)
-                {
-                  channel_idx[layer_channels] = cidx;   /* Assumes in sane order */
-                  layer_channels++;                     /* RGB, Lab, CMYK etc.   */
-                }
-            }
-
-          if (alpha)
-            {
-              channel_idx[layer_channels] = alpha_chn;
-              layer_channels++;
-            }
-
-          /* Create the layer */
-          if (lyr_a[lidx]->group_type != 0)
-            {
-              if (lyr_a[lidx]->group_type == 3)
+              if (lyr_a[lidx]->group_type == 3)
                 {
                   /* the </Layer group> marker layers are used to
                    * assemble the layer structure in a single pass
@@ -1409,24 +1775,20 @@ add_layers (gint32     image_id,
             }
           else
             {
-              if (empty)
+              if (job->empty)
                 {
                   IFDBG(2) g_debug ("Create blank layer");
                 }
               else
                 {
                   IFDBG(2) g_debug ("Create normal layer");
-                  l_x = lyr_a[lidx]->left;
-                  l_y = lyr_a[lidx]->top;
-                  l_w = lyr_a[lidx]->right - lyr_a[lidx]->left;
-                  l_h = lyr_a[lidx]->bottom - lyr_a[lidx]->top;
                 }
 
               image_type = get_gimp_image_type (img_a->base_type, TRUE);
               IFDBG(3) g_debug ("Layer type %d", image_type);
 
               layer_id = gimp_layer_new (image_id, lyr_a[lidx]->name,
-                                         l_w, l_h, image_type,
+                                         job->l_w, job->l_h, image_type,
                                          100, GIMP_LAYER_MODE_NORMAL);
             }
 
@@ -1466,8 +1828,8 @@ add_layers (gint32     image_id,
                     }
 
                   /* Position */
-                  if (l_x != 0 || l_y != 0)
-                    gimp_layer_set_offsets (layer_id, l_x, l_y);
+                  if (job && (job->l_x != 0 || job->l_y != 0))
+                    gimp_layer_set_offsets (layer_id, job->l_x, job->l_y);
 
                   /* Color tag */
                   gimp_item_set_color_tag (layer_id,
@@ -1494,141 +1856,88 @@ add_layers (gint32     image_id,
               /* Set the layer data */
               if (lyr_a[lidx]->group_type == 0)
                 {
+                  GError *job_error = NULL;
+
                   IFDBG(3) g_debug ("Draw layer");
 
-                  if (empty)
-                    {
-                      gimp_drawable_fill (layer_id, GIMP_FILL_TRANSPARENT);
-                    }
-                  else
-                    {
-                      layer_size = l_w * l_h;
-                      bps = img_a->bps / 8;
-                      if (bps == 0)
-                        bps++;
-                      pixels = g_malloc (layer_size * layer_channels * bps);
-                      for (cidx = 0; cidx < layer_channels; ++cidx)
-                        {
-                          IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
-                          for (i = 0; i < layer_size; ++i)
-                            memcpy (&pixels[((i * layer_channels) + cidx) * bps],
-                                    &lyr_chn[channel_idx[cidx]]->data[i * bps], bps);
-                          g_free (lyr_chn[channel_idx[cidx]]->data);
-                        }
+                  if (job->empty)
+                    gimp_drawable_fill (layer_id, GIMP_FILL_TRANSPARENT);
 
-                      buffer = gimp_drawable_get_buffer (layer_id);
-                      gegl_buffer_set (buffer,
-                                       GEGL_RECTANGLE (0, 0,
-                                                       gegl_buffer_get_width (buffer),
-                                                       gegl_buffer_get_height (buffer)),
-                                       0, get_layer_format (img_a, alpha),
-                                       pixels, GEGL_AUTO_ROWSTRIDE);
-                      g_object_unref (buffer);
-                      g_free (pixels);
-                    }
-                }
+                  /* Layer mask */
+                  mask_buffer = NULL;
 
-              /* Layer mask */
-              if (user_mask && lyr_a[lidx]->group_type == 0)
-                {
-                  if (empty_mask)
+                  if (job->mask_chn != -1 &&
+                      (job->empty_mask || psd_layer_job_has_mask (job)))
                     {
-                      IFDBG(3) g_debug ("Create empty mask");
                       if (lyr_a[lidx]->layer_mask.def_color == 255)
                         mask_id = gimp_layer_create_mask (layer_id,
                                                           GIMP_ADD_MASK_WHITE);
                       else
                         mask_id = gimp_layer_create_mask (layer_id,
                                                           GIMP_ADD_MASK_BLACK);
+
+                      IFDBG(3) g_debug ("New layer mask %d", mask_id);
                       gimp_layer_add_mask (layer_id, mask_id);
                       gimp_layer_set_apply_mask (layer_id,
                         ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
+
+                      if (! job->empty_mask)
+                        mask_buffer = gimp_drawable_get_buffer (mask_id);
+
+                      if (CONVERSION_WARNINGS &&
+                          (job->mask_crop.width  < job->lm_w ||
+                           job->mask_crop.height < job->lm_h))
+                        g_message ("Warning\n"
+                                   "The layer mask is partly outside the "
+                                   "layer boundary. The mask will be "
+                                   "cropped which may result in data loss.");
                     }
-                  else
+
+                  buffer = gimp_drawable_get_buffer (layer_id);
+
+                  while ((band = psd_layer_job_pop_band (job, &job_error)))
                     {
-                      /* Load layer mask data */
-                      lm_x = lyr_a[lidx]->layer_mask.left - l_x;
-                      lm_y = lyr_a[lidx]->layer_mask.top - l_y;
-                      lm_w = lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left;
-                      lm_h = lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top;
-                      IFDBG(3) g_debug ("Mask channel index %d", user_mask_chn);
-                      bps = (img_a->bps + 1) / 8;
-                      layer_size = lm_w * lm_h * bps;
-                      pixels = g_malloc (layer_size);
-                      IFDBG(3) g_debug ("Allocate Pixels %d", layer_size);
-                      /* Crop mask at layer boundary */
-                      IFDBG(3) g_debug ("Original Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
-                      if (lm_x < 0
-                          || lm_y < 0
-                          || lm_w + lm_x > l_w
-                          || lm_h + lm_y > l_h)
-                        {
-                          if (CONVERSION_WARNINGS)
-                            g_message ("Warning\n"
-                                       "The layer mask is partly outside the "
-                                       "layer boundary. The mask will be "
-                                       "cropped which may result in data loss.");
-                          i = 0;
-                          for (rowi = 0; rowi < lm_h; ++rowi)
-                            {
-                              if (rowi + lm_y >= 0 && rowi + lm_y < l_h)
-                                {
-                                  for (coli = 0; coli < lm_w; ++coli)
-                                    {
-                                      if (coli + lm_x >= 0 && coli + lm_x < l_w)
-                                        {
-                                          memcpy (&pixels[i * bps], &lyr_chn[user_mask_chn]->data[(rowi * lm_w + coli) * bps], bps);
-                                          i++;
-                                        }
-                                    }
-                                }
-                            }
-                          if (lm_x < 0)
-                            {
-                              lm_w += lm_x;
-                              lm_x = 0;
-                            }
-                          if (lm_y < 0)
-                            {
-                              lm_h += lm_y;
-                              lm_y = 0;
-                            }
-                          if (lm_w + lm_x > l_w)
-                            lm_w = l_w - lm_x;
-                          if (lm_h + lm_y > l_h)
-                            lm_h = l_h - lm_y;
-                        }
-                      else
+                      if (! band->mask)
                         {
-                          memcpy (pixels, lyr_chn[user_mask_chn]->data, layer_size);
-                          i = layer_size;
+                          gegl_buffer_set (buffer,
+                                           GEGL_RECTANGLE (0, band->y,
+                                                           job->l_w,
+                                                           band->height),
+                                           0, get_layer_format (img_a,
+                                                                job->alpha),
+                                           band->pixels, GEGL_AUTO_ROWSTRIDE);
                         }
-                      g_free (lyr_chn[user_mask_chn]->data);
-                      /* Draw layer mask data, if any */
-                      if (i > 0)
+                      else if (band->y + band->height > job->mask_crop.y)
                         {
-                          IFDBG(3) g_debug ("Layer %d %d %d %d", l_x, l_y, l_w, l_h);
-                          IFDBG(3) g_debug ("Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
-
-                          if (lyr_a[lidx]->layer_mask.def_color == 255)
-                            mask_id = gimp_layer_create_mask (layer_id,
-                                                              GIMP_ADD_MASK_WHITE);
-                          else
-                            mask_id = gimp_layer_create_mask (layer_id,
-                                                              GIMP_ADD_MASK_BLACK);
-
-                          IFDBG(3) g_debug ("New layer mask %d", mask_id);
-                          gimp_layer_add_mask (layer_id, mask_id);
-                          buffer = gimp_drawable_get_buffer (mask_id);
-                          gegl_buffer_set (buffer,
-                                           GEGL_RECTANGLE (lm_x, lm_y, lm_w, lm_h),
+                          /* Crop mask at layer boundary */
+                          gint32 y0 = MAX (band->y, job->mask_crop.y);
+
+                          gegl_buffer_set (mask_buffer,
+                                           GEGL_RECTANGLE (job->lm_x + job->mask_crop.x,
+                                                           job->lm_y + y0,
+                                                           job->mask_crop.width,
+                                                           band->y + band->height - y0),
                                            0, get_mask_format (img_a),
-                                           pixels, GEGL_AUTO_ROWSTRIDE);
-                          g_object_unref (buffer);
-                          gimp_layer_set_apply_mask (layer_id,
-                                                     ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
+                                           band->pixels +
+                                           ((gsize) (y0 - band->y) * job->lm_w +
+                                            job->mask_crop.x) * bpp,
+                                           job->lm_w * bpp);
                         }
-                      g_free (pixels);
+
+                      psd_band_free (band);
+                    }
+
+                  g_object_unref (buffer);
+                  if (mask_buffer)
+                    g_object_unref (mask_buffer);
+
+                  if (job_error)
+                    {
+                      /* The layer is not inserted yet, drop it */
+                      gimp_item_delete (layer_id);
+
+                      g_propagate_error (error, job_error);
+                      goto out;
                     }
                 }
 
@@ -1639,24 +1948,39 @@ add_layers (gint32     image_id,
                     gimp_image_insert_layer (image_id, layer_id, parent_group_id, 0);
                   }
             }
-
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            if (lyr_chn[cidx])
-              g_free (lyr_chn[cidx]);
-          g_free (lyr_chn);
         }
+
+      gimp_progress_update (0.8 + 0.1 * (lidx + 1) / img_a->num_layers);
+    }
+
+  /* Set the active layer */
+  if (active_layer_id >= 0)
+    gimp_image_set_active_layer (image_id, active_layer_id);
+
+  ret = 0;
+
+ out:
+  /* Stop the jobs of remaining layers if loading failed */
+  for (lidx = 0; lidx < img_a->num_layers; ++lidx)
+    if (jobs[lidx])
+      psd_layer_job_cancel (jobs[lidx]);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (lidx = 0; lidx < img_a->num_layers; ++lidx)
+    {
+      if (jobs[lidx])
+        psd_layer_job_free (jobs[lidx]);
+
       g_free (lyr_a[lidx]->chn_info);
       g_free (lyr_a[lidx]->name);
       g_free (lyr_a[lidx]);
     }
+  g_free (jobs);
   g_free (lyr_a);
   g_array_free (parent_group_stack, FALSE);
 
-  /* Set the active layer */
-  if (active_layer_id >= 0)
-    gimp_image_set_active_layer (image_id, active_layer_id);
-
-  return 0;
+  return ret;
 }
 
 static gint
@@ -1665,24 +1989,26 @@ add_merged_image (gint32     image_id,
                   FILE      *f,
                   GError   **error)
 {
-  PSDchannel            chn_a[MAX_CHANNELS];
+  PSDchannelreader      readers[MAX_CHANNELS];
   gchar                *alpha_name;
-  guchar               *pixels;
+  gchar                *plane   = NULL;
+  guchar               *pixels  = NULL;
   guint16               comp_mode;
   guint16               base_channels;
   guint16               extra_channels;
   guint16               total_channels;
   guint16               bps;
-  guint16              *rle_pack_len[MAX_CHANNELS];
   guint32               alpha_id;
-  gint32                layer_size;
   gint32                layer_id = -1;
   gint32                channel_id = -1;
+  gint32                band_rows;
+  gint32                y;
   gint16                alpha_opacity;
   gint                  cidx;                  /* Channel index */
-  gint                  rowi;                  /* Row index */
   gint                  offset;
   gint                  i;
+  gint                  n_readers = 0;
+  gint                  ret = -1;
   gboolean              alpha_visible;
   GeglBuffer           *buffer;
   GimpImageType         image_type;
@@ -1693,6 +2019,7 @@ add_merged_image (gint32     image_id,
   bps = img_a->bps / 8;
   if (bps == 0)
     bps++;
+  band_rows = gimp_tile_height ();
 
   if ((img_a->color_mode == PSD_BITMAP ||
        img_a->color_mode == PSD_GRAYSCALE ||
@@ -1717,70 +2044,72 @@ add_merged_image (gint32     image_id,
     extra_channels--;
   base_channels = total_channels - extra_channels;
 
-  /* ----- Read merged image & extra channel pixel data ----- */
+  /* ----- Prepare reading merged image & extra channel pixel data ----- */
   if (img_a->num_layers == 0
       || extra_channels > 0)
     {
-      guint32 block_len;
-      guint32 block_start;
+      goffset  block_start;
+      guint64  block_len;
+      goffset  data_start;
+      guint32  readline_len;
 
       block_start = img_a->merged_image_start;
       block_len = img_a->merged_image_len;
 
-      fseek (f, block_start, SEEK_SET);
-
-      if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
+      if (psd_fseek (f, block_start, SEEK_SET) < 0
+          || fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
         {
           psd_set_error (feof (f), errno, error);
           return -1;
         }
       comp_mode = GUINT16_FROM_BE (comp_mode);
 
+      for (cidx = 0; cidx < total_channels; ++cidx)
+        {
+          psd_channel_reader_init (&readers[cidx], img_a, f,
+                                   img_a->rows, img_a->columns);
+          readers[cidx].empty = FALSE;
+          readers[cidx].compression = comp_mode;
+          n_readers++;
+        }
+
+      readline_len = readers[0].readline_len;
+
       switch (comp_mode)
         {
           case PSD_COMP_RAW:        /* Planar raw data */
-            IFDBG(3) g_debug ("Raw data length: %d", block_len);
+            IFDBG(3) g_debug ("Raw data length: %" G_GUINT64_FORMAT, block_len);
+            data_start = block_start + COMP_MODE_SIZE;
             for (cidx = 0; cidx < total_channels; ++cidx)
               {
-                chn_a[cidx].columns = img_a->columns;
-                chn_a[cidx].rows = img_a->rows;
-                if (read_channel_data (&chn_a[cidx], img_a->bps,
-                                       PSD_COMP_RAW, NULL, f, 0,
-                                       error) < 1)
-                  return -1;
+                readers[cidx].next_in = data_start;
+                data_start += (goffset) readline_len * img_a->rows;
               }
             break;
 
           case PSD_COMP_RLE:        /* Packbits */
             /* Image data is stored as packed scanlines in planar order
                with all compressed length counters stored first */
-            IFDBG(3) g_debug ("RLE length data: %d, RLE data block: %d",
-                               total_channels * img_a->rows * 2,
-                               block_len - (total_channels * img_a->rows * 2));
+            IFDBG(3) g_debug ("RLE length data: %d, RLE data block: %"
+                              G_GUINT64_FORMAT,
+                              total_channels * img_a->rows * 2,
+                              block_len - (total_channels * img_a->rows * 2));
             for (cidx = 0; cidx < total_channels; ++cidx)
               {
-                chn_a[cidx].columns = img_a->columns;
-                chn_a[cidx].rows = img_a->rows;
-                rle_pack_len[cidx] = g_malloc (img_a->rows * 2);
-                for (rowi = 0; rowi < img_a->rows; ++rowi)
-                  {
-                    if (fread (&rle_pack_len[cidx][rowi], 2, 1, f) < 1)
-                      {
-                        psd_set_error (feof (f), errno, error);
-                        return -1;
-                      }
-                    rle_pack_len[cidx][rowi] = GUINT16_FROM_BE (rle_pack_len[cidx][rowi]);
-                  }
+                if (psd_channel_reader_read_rle_lengths (&readers[cidx],
+                                                         img_a->version,
+                                                         error) < 0)
+                  goto out;
               }
 
-            IFDBG(3) g_debug ("RLE decode - data");
+            data_start = psd_ftell (f);
             for (cidx = 0; cidx < total_channels; ++cidx)
               {
-                if (read_channel_data (&chn_a[cidx], img_a->bps,
-                                       PSD_COMP_RLE, rle_pack_len[cidx], f, 0,
-                                       error) < 1)
-                  return -1;
-                g_free (rle_pack_len[cidx]);
+                guint32 rowi;
+
+                readers[cidx].next_in = data_start;
+                for (rowi = 0; rowi < img_a->rows; ++rowi)
+                  data_start += readers[cidx].rle_pack_len[rowi];
               }
             break;
 
@@ -1789,9 +2118,11 @@ add_merged_image (gint32     image_id,
           default:
             g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                         _("Unsupported compression mode: %d"), comp_mode);
-            return -1;
+            goto out;
             break;
         }
+
+      plane = g_malloc ((gsize) band_rows * img_a->columns * bps);
     }
 
   /* ----- Draw merged image ----- */
@@ -1799,18 +2130,6 @@ add_merged_image (gint32     image_id,
     {
       image_type = get_gimp_image_type (img_a->base_type, img_a->transparency);
 
-      layer_size = img_a->columns * img_a->rows;
-      pixels = g_malloc (layer_size * base_channels * bps);
-      for (cidx = 0; cidx < base_channels; ++cidx)
-        {
-          for (i = 0; i < layer_size; ++i)
-            {
-              memcpy (&pixels[((i * base_channels) + cidx) * bps],
-                      &chn_a[cidx].data[i * bps], bps);
-            }
-          g_free (chn_a[cidx].data);
-        }
-
       /* Add background layer */
       IFDBG(2) g_debug ("Draw merged image");
       layer_id = gimp_layer_new (image_id, _("Background"),
@@ -1820,21 +2139,35 @@ add_merged_image (gint32     image_id,
                                  gimp_image_get_default_new_layer_mode (image_id));
       gimp_image_insert_layer (image_id, layer_id, -1, 0);
       buffer = gimp_drawable_get_buffer (layer_id);
-      gegl_buffer_set (buffer,
-                       GEGL_RECTANGLE (0, 0,
-                                       gegl_buffer_get_width (buffer),
-                                       gegl_buffer_get_height (buffer)),
-                       0, get_layer_format (img_a, img_a->transparency),
-                       pixels, GEGL_AUTO_ROWSTRIDE);
+
+      pixels = g_malloc ((gsize) band_rows * img_a->columns *
+                         base_channels * bps);
+
+      for (y = 0; y < img_a->rows; y += band_rows)
+        {
+          gint32 height = MIN (band_rows, img_a->rows - y);
+
+          for (cidx = 0; cidx < base_channels; ++cidx)
+            {
+              if (psd_channel_reader_read_rows (&readers[cidx], height,
+                                                plane, error) < 0)
+                {
+                  g_object_unref (buffer);
+                  goto out;
+                }
+
+              interleave_channel (pixels, plane,
+                                  (gsize) height * img_a->columns,
+                                  base_channels, cidx, bps);
+            }
+
+          gegl_buffer_set (buffer,
+                           GEGL_RECTANGLE (0, y, img_a->columns, height),
+                           0, get_layer_format (img_a, img_a->transparency),
+                           pixels, GEGL_AUTO_ROWSTRIDE);
+        }
+
       g_object_unref (buffer);
-      g_free (pixels);
-    }
-  else
-    {
-      /* Free merged image data for layered image */
-      if (extra_channels)
-        for (cidx = 0; cidx < base_channels; ++cidx)
-          g_free (chn_a[cidx].data);
     }
 
   /* ----- Draw extra alpha channels ----- */
@@ -1843,7 +2176,6 @@ add_merged_image (gint32     image_id,
       && image_id > -1)
     {
       IFDBG(2) g_debug ("Add extra channels");
-      pixels = g_malloc(0);
 
       /* Get channel resource data */
       if (img_a->transparency)
@@ -1904,10 +2236,8 @@ add_merged_image (gint32     image_id,
             }
 
           cidx = base_channels + i;
-          pixels = g_realloc (pixels, chn_a[cidx].columns * chn_a[cidx].rows * bps);
-          memcpy (pixels, chn_a[cidx].data, chn_a[cidx].columns * chn_a[cidx].rows * bps);
           channel_id = gimp_channel_new (image_id, alpha_name,
-                                         chn_a[cidx].columns, chn_a[cidx].rows,
+                                         img_a->columns, img_a->rows,
                                          alpha_opacity, &alpha_rgb);
           gimp_image_insert_channel (image_id, channel_id, -1, 0);
           g_free (alpha_name);
@@ -1915,17 +2245,27 @@ add_merged_image (gint32     image_id,
           if (alpha_id)
             gimp_item_set_tattoo (channel_id, alpha_id);
           gimp_item_set_visible (channel_id, alpha_visible);
-          gegl_buffer_set (buffer,
-                           GEGL_RECTANGLE (0, 0,
-                                           gegl_buffer_get_width (buffer),
-                                           gegl_buffer_get_height (buffer)),
-                           0, get_channel_format (img_a),
-                           pixels, GEGL_AUTO_ROWSTRIDE);
+
+          for (y = 0; y < img_a->rows; y += band_rows)
+            {
+              gint32 height = MIN (band_rows, img_a->rows - y);
+
+              if (psd_channel_reader_read_rows (&readers[cidx], height,
+                                                plane, error) < 0)
+                {
+                  g_object_unref (buffer);
+                  goto out;
+                }
+
+              gegl_buffer_set (buffer,
+                               GEGL_RECTANGLE (0, y, img_a->columns, height),
+                               0, get_channel_format (img_a),
+                               plane, GEGL_AUTO_ROWSTRIDE);
+            }
+
           g_object_unref (buffer);
-          g_free (chn_a[cidx].data);
         }
 
-      g_free (pixels);
       if (img_a->alpha_names)
         g_ptr_array_free (img_a->alpha_names, TRUE);
 
@@ -1942,9 +2282,17 @@ add_merged_image (gint32     image_id,
 
   /* FIXME gimp image tattoo state */
 
-  return 0;
-}
+  ret = 0;
+
+ out:
+  for (cidx = 0; cidx < n_readers; ++cidx)
+    psd_channel_reader_clear (&readers[cidx]);
 
+  g_free (plane);
+  g_free (pixels);
+
+  return ret;
+}
 
 /* Local utility functions */
 static gchar *
@@ -2035,169 +2383,350 @@ zzfree (voidpf opaque, voidpf address)
   g_free (address);
 }
 
+static void
+psd_channel_reader_init (PSDchannelreader *reader,
+                         PSDimage         *img_a,
+                         FILE             *f,
+                         guint32           rows,
+                         guint32           columns)
+{
+  memset (reader, 0, sizeof (PSDchannelreader));
+
+  reader->f           = f;
+  reader->bps         = img_a->bps;
+  reader->compression = PSD_COMP_RAW;
+  reader->empty       = TRUE;
+  reader->rows        = rows;
+  reader->columns     = columns;
+
+  if (reader->bps == 1)
+    reader->readline_len = ((columns + 7) / 8);
+  else
+    reader->readline_len = (columns * reader->bps / 8);
+}
+
+static void
+psd_channel_reader_clear (PSDchannelreader *reader)
+{
+  if (reader->zs_init)
+    inflateEnd (&reader->zs);
+
+  g_free (reader->rle_pack_len);
+  g_free (reader->src);
+  g_free (reader->raw);
+
+  memset (reader, 0, sizeof (PSDchannelreader));
+}
+
 static gint
-read_channel_data (PSDchannel     *channel,
-                   guint16         bps,
-                   guint16         compression,
-                   const guint16  *rle_pack_len,
-                   FILE           *f,
-                   guint32         comp_len,
-                   GError        **error)
+psd_channel_reader_read_rle_lengths (PSDchannelreader  *reader,
+                                     guint16            psd_version,
+                                     GError           **error)
 {
-  gchar    *raw_data;
-  gchar    *src;
-  gchar    *dst;
-  guint32   readline_len;
-  gint      i, j;
-
-  if (bps == 1)
-    readline_len = ((channel->columns + 7) / 8);
+  guint32 rowi;
+
+  /* RLE row lengths are stored as 2 bytes in PSD and 4 bytes in PSB files */
+  reader->rle_pack_len = g_new (guint32, reader->rows);
+
+  if (psd_version == 1)
+    {
+      guint16 *len16 = g_new (guint16, reader->rows);
+
+      if (fread (len16, 2, reader->rows, reader->f) < reader->rows)
+        {
+          psd_set_error (feof (reader->f), errno, error);
+          g_free (len16);
+          return -1;
+        }
+
+      for (rowi = 0; rowi < reader->rows; ++rowi)
+        reader->rle_pack_len[rowi] = GUINT16_FROM_BE (len16[rowi]);
+
+      g_free (len16);
+    }
   else
-    readline_len = (channel->columns * bps / 8);
+    {
+      if (fread (reader->rle_pack_len, 4, reader->rows, reader->f) < reader->rows)
+        {
+          psd_set_error (feof (reader->f), errno, error);
+          return -1;
+        }
+
+      for (rowi = 0; rowi < reader->rows; ++rowi)
+        reader->rle_pack_len[rowi] = GUINT32_FROM_BE (reader->rle_pack_len[rowi]);
+    }
+
+  return 0;
+}
+
+/* Prepares decoding of a layer channel, whose data starts with the
+ * compression mode followed, for RLE data, by the row lengths.
+ * Channels without data decode to zeros.
+ */
+static gint
+psd_channel_reader_open_layer (PSDchannelreader  *reader,
+                               guint16            psd_version,
+                               goffset            data_start,
+                               guint64            data_len,
+                               GError           **error)
+{
+  guint16 comp_mode;
+
+  if (data_len <= COMP_MODE_SIZE || reader->rows == 0 || reader->columns == 0)
+    return 0;
+
+  if (psd_fseek (reader->f, data_start, SEEK_SET) < 0
+      || fread (&comp_mode, COMP_MODE_SIZE, 1, reader->f) < 1)
+    {
+      psd_set_error (feof (reader->f), errno, error);
+      return -1;
+    }
+  comp_mode = GUINT16_FROM_BE (comp_mode);
+  IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
+
+  reader->next_in  = data_start + COMP_MODE_SIZE;
+  reader->avail_in = data_len - COMP_MODE_SIZE;
+
+  switch (comp_mode)
+    {
+      case PSD_COMP_RAW:        /* Planar raw data */
+        break;
+
+      case PSD_COMP_RLE:        /* Packbits */
+        if (psd_channel_reader_read_rle_lengths (reader, psd_version,
+                                                 error) < 0)
+          return -1;
+        reader->next_in = psd_ftell (reader->f);
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        break;
+
+      default:
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                    _("Unsupported compression mode: %d"), comp_mode);
+        return -1;
+        break;
+    }
 
-  IFDBG(3) g_debug ("raw data size %d x %d = %d", readline_len,
-                    channel->rows, readline_len * channel->rows);
+  reader->compression = comp_mode;
+  reader->empty       = FALSE;
 
-  /* sanity check, int overflow check (avoid divisions by zero) */
-  if ((channel->rows == 0) || (channel->columns == 0) ||
-      (channel->rows > G_MAXINT32 / channel->columns / MAX (bps / 8, 1)))
+  return 0;
+}
+
+static gint
+psd_channel_reader_inflate (PSDchannelreader  *reader,
+                            gchar             *dst,
+                            gsize              len,
+                            GError           **error)
+{
+  if (! reader->zs_init)
+    {
+      reader->zs.next_in  = NULL;
+      reader->zs.avail_in = 0;
+      reader->zs.zalloc   = zzalloc;
+      reader->zs.zfree    = zzfree;
+      reader->zs.opaque   = NULL;
+
+      if (inflateInit (&reader->zs) != Z_OK)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Failed to decompress data"));
+          return -1;
+        }
+
+      reader->zs_init  = TRUE;
+      reader->src_size = PSD_ZIP_CHUNK_SIZE;
+      reader->src      = g_malloc (reader->src_size);
+    }
+
+  reader->zs.next_out  = (guchar *) dst;
+  reader->zs.avail_out = len;
+
+  while (reader->zs.avail_out > 0)
+    {
+      gint z_ret;
+
+      if (reader->zs.avail_in == 0)
+        {
+          gsize chunk = MIN (reader->avail_in, reader->src_size);
+
+          if (chunk == 0)
+            {
+              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Failed to decompress data"));
+              return -1;
+            }
+
+          if (psd_fseek (reader->f, reader->next_in, SEEK_SET) < 0
+              || fread (reader->src, chunk, 1, reader->f) < 1)
+            {
+              psd_set_error (feof (reader->f), errno, error);
+              return -1;
+            }
+
+          reader->next_in  += chunk;
+          reader->avail_in -= chunk;
+
+          reader->zs.next_in  = (guchar *) reader->src;
+          reader->zs.avail_in = chunk;
+        }
+
+      z_ret = inflate (&reader->zs, Z_NO_FLUSH);
+
+      if ((z_ret != Z_OK && z_ret != Z_STREAM_END) ||
+          (z_ret == Z_STREAM_END && reader->zs.avail_out > 0))
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Failed to decompress data"));
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/* Decodes the next n_rows rows of the channel into dst, converted to
+ * GIMP format: native byte order, prediction undone and 1 bit data
+ * expanded to one byte per pixel.
+ */
+static gint
+psd_channel_reader_read_rows (PSDchannelreader  *reader,
+                              guint32            n_rows,
+                              gchar             *dst,
+                              GError           **error)
+{
+  gsize   n_pixels = (gsize) n_rows * reader->columns;
+  gsize   raw_len  = (gsize) n_rows * reader->readline_len;
+  guint32 i, j;
+
+  if (reader->empty)
+    {
+      memset (dst, 0, n_pixels * MAX (reader->bps / 8, 1));
+      reader->row += n_rows;
+      return 0;
+    }
+
+  if (reader->row + n_rows > reader->rows)
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                    _("Unsupported or invalid channel size"));
       return -1;
     }
 
-  raw_data = g_malloc (readline_len * channel->rows);
-  switch (compression)
+  if (raw_len > reader->raw_size)
+    {
+      g_free (reader->raw);
+      reader->raw      = g_malloc (raw_len);
+      reader->raw_size = raw_len;
+    }
+
+  switch (reader->compression)
     {
       case PSD_COMP_RAW:
-        if (fread (raw_data, readline_len, channel->rows, f) < 1)
+        if (psd_fseek (reader->f, reader->next_in, SEEK_SET) < 0
+            || fread (reader->raw, raw_len, 1, reader->f) < 1)
           {
-            psd_set_error (feof (f), errno, error);
+            psd_set_error (feof (reader->f), errno, error);
             return -1;
           }
+        reader->next_in += raw_len;
         break;
 
       case PSD_COMP_RLE:
-        for (i = 0; i < channel->rows; ++i)
+        if (psd_fseek (reader->f, reader->next_in, SEEK_SET) < 0)
           {
-            src = g_malloc (rle_pack_len[i]);
-            dst = g_malloc (readline_len);
-/*      FIXME check for over-run
-            if (ftell (f) + rle_pack_len[i] > block_end)
+            psd_set_error (feof (reader->f), errno, error);
+            return -1;
+          }
+
+        for (i = 0; i < n_rows; ++i)
+          {
+            guint32 pack_len = reader->rle_pack_len[reader->row + i];
+
+            if (pack_len > reader->src_size)
               {
-                psd_set_error (TRUE, errno, error);
-                return -1;
+                g_free (reader->src);
+                reader->src      = g_malloc (pack_len);
+                reader->src_size = pack_len;
               }
-*/
-            if (fread (src, rle_pack_len[i], 1, f) < 1)
+
+            if (pack_len > 0 &&
+                fread (reader->src, pack_len, 1, reader->f) < 1)
               {
-                psd_set_error (feof (f), errno, error);
-                g_free (src);
-                g_free (dst);
+                psd_set_error (feof (reader->f), errno, error);
                 return -1;
               }
+
             /* FIXME check for errors returned from decode packbits */
-            decode_packbits (src, dst, rle_pack_len[i], readline_len);
-            g_free (src);
-            memcpy (raw_data + i * readline_len, dst, readline_len);
-            g_free (dst);
+            decode_packbits (reader->src,
+                             reader->raw + i * reader->readline_len,
+                             pack_len, reader->readline_len);
+
+            reader->next_in += pack_len;
           }
         break;
+
       case PSD_COMP_ZIP:
       case PSD_COMP_ZIP_PRED:
-        {
-          z_stream zs;
-
-          src = g_malloc (comp_len);
-          if (fread (src, comp_len, 1, f) < 1)
-            {
-              psd_set_error (feof (f), errno, error);
-              g_free (src);
-              return -1;
-            }
-
-          zs.next_in = (guchar*) src;
-          zs.avail_in = comp_len;
-          zs.next_out = (guchar*) raw_data;
-          zs.avail_out = readline_len * channel->rows;
-          zs.zalloc = zzalloc;
-          zs.zfree = zzfree;
-
-          if (inflateInit (&zs) == Z_OK &&
-              inflate (&zs, Z_FINISH) == Z_STREAM_END)
-            {
-              inflateEnd (&zs);
-            }
-          else
-            {
-              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                           _("Failed to decompress data"));
-              g_free (src);
-              return -1;
-            }
-
-          g_free (src);
-          break;
-        }
+        if (psd_channel_reader_inflate (reader, reader->raw, raw_len,
+                                        error) < 0)
+          return -1;
+        break;
     }
 
   /* Convert channel data to GIMP format */
-  switch (bps)
+  switch (reader->bps)
     {
     case 32:
       {
-        guint32 *src = (guint32*) raw_data;
-        guint32 *dst = g_malloc (channel->rows * channel->columns * 4);
-
-        channel->data = (gchar*) dst;
+        const guint32 *src = (const guint32 *) reader->raw;
+        guint32       *dst32 = (guint32 *) dst;
 
-        for (i = 0; i < channel->rows * channel->columns; ++i)
-          dst[i] = GUINT32_FROM_BE (src[i]);
+        for (i = 0; i < n_pixels; ++i)
+          dst32[i] = GUINT32_FROM_BE (src[i]);
 
-        if (compression == PSD_COMP_ZIP_PRED)
+        if (reader->compression == PSD_COMP_ZIP_PRED)
           {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+            for (i = 0; i < n_rows; ++i)
+              for (j = 1; j < reader->columns; ++j)
+                dst32[i * reader->columns + j] += dst32[i * reader->columns + j - 1];
           }
         break;
       }
 
     case 16:
       {
-        guint16 *src = (guint16*) raw_data;
-        guint16 *dst = g_malloc (channel->rows * channel->columns * 2);
+        const guint16 *src = (const guint16 *) reader->raw;
+        guint16       *dst16 = (guint16 *) dst;
 
-        channel->data = (gchar*) dst;
+        for (i = 0; i < n_pixels; ++i)
+          dst16[i] = GUINT16_FROM_BE (src[i]);
 
-        for (i = 0; i < channel->rows * channel->columns; ++i)
-          dst[i] = GUINT16_FROM_BE (src[i]);
-
-        if (compression == PSD_COMP_ZIP_PRED)
+        if (reader->compression == PSD_COMP_ZIP_PRED)
           {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+            for (i = 0; i < n_rows; ++i)
+              for (j = 1; j < reader->columns; ++j)
+                dst16[i * reader->columns + j] += dst16[i * reader->columns + j - 1];
           }
         break;
       }
 
       case 8:
-        channel->data = g_malloc (channel->rows * channel->columns * bps / 8 );
-        memcpy (channel->data, raw_data, (channel->rows * channel->columns * bps / 8));
+        memcpy (dst, reader->raw, n_pixels);
 
-        if (compression == PSD_COMP_ZIP_PRED)
+        if (reader->compression == PSD_COMP_ZIP_PRED)
           {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                channel->data[i * channel->columns + j] += channel->data[i * channel->columns + j - 1];
+            for (i = 0; i < n_rows; ++i)
+              for (j = 1; j < reader->columns; ++j)
+                dst[i * reader->columns + j] += dst[i * reader->columns + j - 1];
           }
         break;
 
       case 1:
-        channel->data = (gchar *) g_malloc (channel->rows * channel->columns);
-        convert_1_bit (raw_data, channel->data, channel->rows, channel->columns);
+        convert_1_bit (reader->raw, dst, n_rows, reader->columns);
         break;
 
       default:
@@ -2205,9 +2734,59 @@ read_channel_data (PSDchannel     *channel,
         break;
     }
 
-  g_free (raw_data);
+  reader->row += n_rows;
+
+  return 0;
+}
+
+static void
+interleave_channel (guchar       *dst,
+                    const gchar  *src,
+                    gsize         n_pixels,
+                    gint          n_channels,
+                    gint          channel,
+                    gint          bpp)
+{
+  gsize i;
+
+  switch (bpp)
+    {
+    case 1:
+      {
+        guchar *d = dst + channel;
 
-  return 1;
+        for (i = 0; i < n_pixels; ++i, d += n_channels)
+          *d = src[i];
+        break;
+      }
+
+    case 2:
+      {
+        guint16       *d = (guint16 *) dst + channel;
+        const guint16 *s = (const guint16 *) src;
+
+        for (i = 0; i < n_pixels; ++i, d += n_channels)
+          *d = s[i];
+        break;
+      }
+
+    case 4:
+      {
+        guint32       *d = (guint32 *) dst + channel;
+        const guint32 *s = (const guint32 *) src;
+
+        for (i = 0; i < n_pixels; ++i, d += n_channels)
+          *d = s[i];
+        break;
+      }
+    }
+}
+
+static void
+psd_band_free (PSDband *band)
+{
+  g_free (band->pixels);
+  g_free (band);
 }
 
 static void
@@ -182,9 +182,11 @@ read_header_block (PSDimage  *img_a,
   if (memcmp (sig, "8BPS", 4) != 0)
     return -1;
 
-  if (version != 1)
+  if (version != 1 && version != 2)
     return -1;
 
+  img_a->version = version;
+
   if (img_a->channels > MAX_CHANNELS)
     return -1;
 
@@ -203,8 +205,8 @@ read_color_mode_block (PSDimage  *img_a,
                        GError   **error)
 {
   guint32 block_len;
-  guint32 block_start;
-  guint32 block_end;
+  goffset block_start;
+  goffset block_end;
 
   if (fread (&block_len, 4, 1, f) < 1)
     {
@@ -213,10 +215,10 @@ read_color_mode_block (PSDimage  *img_a,
     }
   block_len = GUINT32_FROM_BE (block_len);
 
-  block_start = ftell (f);
+  block_start = psd_ftell (f);
   block_end = block_start + block_len;
 
-  if (fseek (f, block_end, SEEK_SET) < 0)
+  if (psd_fseek (f, block_end, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -231,7 +233,7 @@ read_image_resource_block (PSDimage  *img_a,
                            GError   **error)
 {
   guint32 block_len;
-  guint32 block_end;
+  goffset block_end;
 
   if (fread (&block_len, 4, 1, f) < 1)
     {
@@ -242,10 +244,10 @@ read_image_resource_block (PSDimage  *img_a,
 
   IFDBG(1) g_debug ("Image resource block size = %d", (int)img_a->image_res_len);
 
-  img_a->image_res_start = ftell (f);
+  img_a->image_res_start = psd_ftell (f);
   block_end = img_a->image_res_start + img_a->image_res_len;
 
-  if (fseek (f, block_end, SEEK_SET) < 0)
+  if (psd_fseek (f, block_end, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
@@ -281,13 +283,13 @@ add_image_resources (gint32     image_id,
   PSDimageres   res_a;
   gint          status;
 
-  if (fseek (f, img_a->image_res_start, SEEK_SET) < 0)
+  if (psd_fseek (f, img_a->image_res_start, SEEK_SET) < 0)
     {
       psd_set_error (feof (f), errno, error);
       return -1;
     }
 
-  while (ftell (f) < img_a->image_res_start + img_a->image_res_len)
+  while (psd_ftell (f) < img_a->image_res_start + img_a->image_res_len)
     {
       if (get_image_resource_header (&res_a, f, error) < 0)
         return -1;
@@ -187,6 +187,70 @@ psd_set_error (gboolean   file_eof,
   return;
 }
 
+gint
+psd_read_len (FILE     *f,
+              guint64  *data_len,
+              guint16   psd_version,
+              GError  **error)
+{
+  /*
+   * Reads a block length, which is stored as 4 bytes in PSD files
+   * and, for some blocks, as 8 bytes in PSB files.
+   */
+
+  if (psd_version == 1)
+    {
+      guint32 len32;
+
+      if (fread (&len32, 4, 1, f) < 1)
+        {
+          psd_set_error (feof (f), errno, error);
+          return -1;
+        }
+      *data_len = GUINT32_FROM_BE (len32);
+    }
+  else
+    {
+      guint64 len64;
+
+      if (fread (&len64, 8, 1, f) < 1)
+        {
+          psd_set_error (feof (f), errno, error);
+          return -1;
+        }
+      *data_len = GUINT64_FROM_BE (len64);
+    }
+
+  return 0;
+}
+
+gint
+psd_fseek (FILE    *f,
+           goffset  offset,
+           gint     whence)
+{
+  /*
+   * fseek() and ftell() use a long, which is only 32 bits wide on
+   * Windows and 32 bit systems.  AC_SYS_LARGEFILE makes the off_t of
+   * fseeko() 64 bits wide.
+   */
+#ifdef G_OS_WIN32
+  return _fseeki64 (f, offset, whence);
+#else
+  return fseeko (f, offset, whence);
+#endif
+}
+
+goffset
+psd_ftell (FILE *f)
+{
+#ifdef G_OS_WIN32
+  return _ftelli64 (f);
+#else
+  return ftello (f);
+#endif
+}
+
 gchar *
 fread_pascal_string (gint32   *bytes_read,
                      gint32   *bytes_written,
@@ -217,7 +281,7 @@ fread_pascal_string (gint32   *bytes_read,
 
   if (len == 0)
     {
-      if (fseek (f, mod_len - 1, SEEK_CUR) < 0)
+      if (psd_fseek (f, mod_len - 1, SEEK_CUR) < 0)
         {
           psd_set_error (feof (f), errno, error);
           return NULL;
@@ -241,7 +305,7 @@ fread_pascal_string (gint32   *bytes_read,
       padded_len = len + 1;
       while (padded_len % mod_len != 0)
         {
-          if (fseek (f, 1, SEEK_CUR) < 0)
+          if (psd_fseek (f, 1, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               g_free (str);
@@ -364,7 +428,7 @@ fread_unicode_string (gint32   *bytes_read,
 
   if (len == 0)
     {
-      if (fseek (f, mod_len - 1, SEEK_CUR) < 0)
+      if (psd_fseek (f, mod_len - 1, SEEK_CUR) < 0)
         {
           psd_set_error (feof (f), errno, error);
           return NULL;
@@ -392,7 +456,7 @@ fread_unicode_string (gint32   *bytes_read,
       padded_len = len + 1;
       while (padded_len % mod_len != 0)
         {
-          if (fseek (f, 1, SEEK_CUR) < 0)
+          if (psd_fseek (f, 1, SEEK_CUR) < 0)
             {
               psd_set_error (feof (f), errno, error);
               g_free (utf16_str);
@@ -481,7 +545,7 @@ fwrite_unicode_string (const gchar  *src,
 gint
 decode_packbits (const gchar *src,
                  gchar       *dst,
-                 guint16      packed_len,
+                 guint32      packed_len,
                  guint32      unpacked_len)
 {
   /*
@@ -28,6 +28,24 @@ void                    psd_set_error          (gboolean             file_eof,
                                                 gint                 err_no,
                                                 GError             **error);
 
+/*
+ *  Reads a 4 byte (PSD) or 8 byte (PSB) block length
+ */
+gint                    psd_read_len           (FILE                *f,
+                                                guint64             *data_len,
+                                                guint16              psd_version,
+                                                GError             **error);
+
+/*
+ *  Seek and tell with 64 bit file offsets, PSB files can be larger
+ *  than 2 GB
+ */
+gint                    psd_fseek              (FILE                *f,
+                                                goffset              offset,
+                                                gint                 whence);
+
+goffset                 psd_ftell              (FILE                *f);
+
 /*
  * Reads a pascal string from the file padded to a multiple of mod_len
  * and returns a utf-8 string.
@@ -68,7 +86,7 @@ gint32                  fwrite_unicode_string  (const gchar         *src,
 
 gint                    decode_packbits        (const gchar         *src,
                                                 gchar               *dst,
-                                                guint16              packed_len,
+                                                guint32              packed_len,
                                                 guint32              unpacked_len);
 
 gchar                 * encode_packbits        (const gchar         *src,
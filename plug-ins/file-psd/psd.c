@@ -102,7 +102,8 @@ query (void)
   gimp_install_procedure (LOAD_PROC,
                           "Loads images from the Photoshop PSD file format",
                           "This plug-in loads images in Adobe "
-                          "Photoshop (TM) native PSD format.",
+                          "Photoshop (TM) native PSD and PSB (large "
+                          "document) format.",
                           "John Marshall",
                           "John Marshall",
                           "2007",
@@ -115,7 +116,7 @@ query (void)
 
   gimp_register_file_handler_mime (LOAD_PROC, "image/x-psd");
   gimp_register_magic_load_handler (LOAD_PROC,
-                                    "psd",
+                                    "psd,psb",
                                     "",
                                     "0,string,8BPS");
 
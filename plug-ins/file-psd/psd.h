@@ -488,7 +488,7 @@ typedef struct {
 typedef struct
 {
   gint16        channel_id;             /* Channel ID */
-  guint32       data_len;               /* Layer left */
+  guint64       data_len;               /* Channel data length */
 } ChannelLengthInfo;
 
 /* PSD Layer flags */
@@ -626,7 +626,7 @@ typedef struct
   gchar         type[4];                /* Image resource type */
   gint16        id;                     /* Image resource ID */
   gchar         name[256];              /* Image resource name (pascal string) */
-  gint32        data_start;             /* Image resource data start */
+  goffset       data_start;             /* Image resource data start */
   gint32        data_len;               /* Image resource data length */
 } PSDimageres;
 
@@ -635,17 +635,18 @@ typedef struct
 {
   gchar         sig[4];                 /* Layer resource signature */
   gchar         key[4];                 /* Layer resource key */
-  gint32        data_start;             /* Layer resource data start */
-  gint32        data_len;               /* Layer resource data length */
+  goffset       data_start;             /* Layer resource data start */
+  guint64       data_len;               /* Layer resource data length */
 } PSDlayerres;
 
 /* PSD File data structures */
 typedef struct
 {
+  guint16               version;                /* File format version: 1 = PSD, 2 = PSB */
   guint16               channels;               /* Number of channels: 1- 56 */
   gboolean              transparency;           /* Image has merged transparency alpha channel */
-  guint32               rows;                   /* Number of rows: 1 - 30000 */
-  guint32               columns;                /* Number of columns: 1 - 30000 */
+  guint32               rows;                   /* Number of rows: 1 - 30000 (PSB: 300000) */
+  guint32               columns;                /* Number of columns: 1 - 30000 (PSB: 300000) */
   guint16               bps;                    /* Bits per sample: 1, 8, 16, or 32 */
   guint16               color_mode;             /* Image color mode: {PSDColorMode} */
   GimpImageBaseType     base_type;              /* Image base color mode: (GIMP) */
@@ -653,15 +654,15 @@ typedef struct
   guchar               *color_map;              /* Color map data */
   guint32               color_map_len;          /* Color map data length */
   guint32               color_map_entries;      /* Color map number of entries */
-  guint32               image_res_start;        /* Image resource block start address */
+  goffset               image_res_start;        /* Image resource block start address */
   guint32               image_res_len;          /* Image resource block length */
-  guint32               mask_layer_start;       /* Mask & layer block start address */
-  guint32               mask_layer_len;         /* Mask & layer block length */
+  goffset               mask_layer_start;       /* Mask & layer block start address */
+  guint64               mask_layer_len;         /* Mask & layer block length */
   gint16                num_layers;             /* Number of layers */
-  guint32               layer_data_start;       /* Layer pixel data start */
-  guint32               layer_data_len;         /* Layer pixel data length */
-  guint32               merged_image_start;     /* Merged image pixel data block start address */
-  guint32               merged_image_len;       /* Merged image pixel data block length */
+  goffset               layer_data_start;       /* Layer pixel data start */
+  guint64               layer_data_len;         /* Layer pixel data length */
+  goffset               merged_image_start;     /* Merged image pixel data block start address */
+  guint64               merged_image_len;       /* Merged image pixel data block length */
   gboolean              no_icc;                 /* Do not use ICC profile */
   guint16               layer_state;            /* Active layer number counting from bottom up */
   GPtrArray            *alpha_names;            /* Alpha channel names */
@@ -536,31 +536,52 @@ init_mutants (void)
     }
 }
 
+typedef struct
+{
+  control_point cps[NMUTANTS];
+  guchar       *buffers[NMUTANTS];
+} EditPreviews;
+
+static void
+render_edit_previews (gint     i,
+                      gint     n,
+                      gpointer data)
+{
+  EditPreviews *previews = data;
+  gint          mut;
+
+  for (mut = NMUTANTS * i / n; mut < NMUTANTS * (i + 1) / n; mut++)
+    {
+      frame_spec pf = { 0.0, 0, 1, 0.0 };
+
+      pf.cps = &previews->cps[mut];
+
+      render_rectangle (&pf, previews->buffers[mut],
+                        EDIT_PREVIEW_SIZE, field_both, 3, NULL);
+    }
+}
+
 static void
 set_edit_preview (void)
 {
   gint           i, j;
-  guchar        *b;
-  control_point  pcp;
+  EditPreviews   previews;
   gint           nbytes = EDIT_PREVIEW_SIZE * EDIT_PREVIEW_SIZE * 3;
 
-  static frame_spec pf = { 0.0, 0, 1, 0.0 };
-
   if (NULL == edit_previews[0])
     return;
 
-  b = g_new (guchar, nbytes);
   maybe_init_cp ();
   drawable_to_cmap (&edit_cp);
   for (i = 0; i < 3; i++)
     for (j = 0; j < 3; j++)
       {
-        gint mut = i*3 + j;
+        gint           mut = i*3 + j;
+        control_point *pcp = &previews.cps[mut];
 
-        pf.cps = &pcp;
         if (1 == i && 1 == j)
           {
-            pcp = edit_cp;
+            *pcp = edit_cp;
           }
         else
           {
@@ -569,28 +590,34 @@ set_edit_preview (void)
             ends[1] = mutants[mut];
             ends[0].time = 0.0;
             ends[1].time = 1.0;
-            interpolate (ends, 2, pick_speed, &pcp);
+            interpolate (ends, 2, pick_speed, pcp);
           }
-        pcp.pixels_per_unit =
-          (pcp.pixels_per_unit * EDIT_PREVIEW_SIZE) / pcp.width;
-        pcp.width = EDIT_PREVIEW_SIZE;
-        pcp.height = EDIT_PREVIEW_SIZE;
-
-        pcp.sample_density = 1;
-        pcp.spatial_oversample = 1;
-        pcp.spatial_filter_radius = 0.5;
+        pcp->pixels_per_unit =
+          (pcp->pixels_per_unit * EDIT_PREVIEW_SIZE) / pcp->width;
+        pcp->width = EDIT_PREVIEW_SIZE;
+        pcp->height = EDIT_PREVIEW_SIZE;
 
-        drawable_to_cmap (&pcp);
+        pcp->sample_density = 1;
+        pcp->spatial_oversample = 1;
+        pcp->spatial_filter_radius = 0.5;
 
-        render_rectangle (&pf, b, EDIT_PREVIEW_SIZE, field_both, 3, NULL);
+        drawable_to_cmap (pcp);
 
-        gimp_preview_area_draw (GIMP_PREVIEW_AREA (edit_previews[mut]),
-                                0, 0, EDIT_PREVIEW_SIZE, EDIT_PREVIEW_SIZE,
-                                GIMP_RGB_IMAGE,
-                                b,
-                                EDIT_PREVIEW_SIZE * 3);
+        previews.buffers[mut] = g_new (guchar, nbytes);
       }
-  g_free (b);
+
+  /* the mutants are independent, render them concurrently */
+  gimp_parallel_distribute (NMUTANTS, render_edit_previews, &previews);
+
+  for (i = 0; i < NMUTANTS; i++)
+    {
+      gimp_preview_area_draw (GIMP_PREVIEW_AREA (edit_previews[i]),
+                              0, 0, EDIT_PREVIEW_SIZE, EDIT_PREVIEW_SIZE,
+                              GIMP_RGB_IMAGE,
+                              previews.buffers[i],
+                              EDIT_PREVIEW_SIZE * 3);
+      g_free (previews.buffers[i]);
+    }
 }
 
 static void
@@ -27,20 +27,22 @@
 
 #define CHOOSE_XFORM_GRAIN 100
 
-static int    flam3_random_bit (void);
-static double flam3_random01   (void);
+static int    flam3_random_bit (GRand *gr);
+static double flam3_random01   (GRand *gr);
 
 /*
  * run the function system described by CP forward N generations.
  * store the n resulting 3 vectors in POINTS.  the initial point is passed
- * in POINTS[0].  ignore the first FUSE iterations.
+ * in POINTS[0].  ignore the first FUSE iterations.  all random numbers
+ * are drawn from GR, so that several streams can run at once.
  */
 
 void
 iterate (control_point *cp,
          int            n,
          int            fuse,
-         point         *points)
+         point         *points,
+         GRand         *gr)
 {
   int    i, j, count_large = 0, count_nan = 0;
   int    xform_distrib[CHOOSE_XFORM_GRAIN];
@@ -76,7 +78,7 @@ iterate (control_point *cp,
   for (i = -fuse; i < n; i++)
     {
       /* FIXME: the following is supported only by gcc and c99 */
-      int fn = xform_distrib[g_random_int_range (0, CHOOSE_XFORM_GRAIN)];
+      int fn = xform_distrib[g_rand_int_range (gr, 0, CHOOSE_XFORM_GRAIN)];
       double tx, ty, v;
 
       if (p[0] > 100.0 || p[0] < -100.0 ||
@@ -317,7 +319,7 @@ iterate (control_point *cp,
             theta = atan2 (tx, ty);
           else
             theta = 0.0;
-          if (flam3_random_bit ())
+          if (flam3_random_bit (gr))
             theta += G_PI;
           r2 = pow (tx * tx + ty * ty, 0.25);
           nx = r2 * cos (theta);
@@ -491,10 +493,10 @@ iterate (control_point *cp,
         {
           /* noise */
           double rx, sinr, cosr, nois;
-          rx = flam3_random01 () * 2 * G_PI;
+          rx = flam3_random01 (gr) * 2 * G_PI;
           sinr = sin (rx);
           cosr = cos (rx);
-          nois = flam3_random01 ();
+          nois = flam3_random01 (gr);
           p[0] += v * nois * tx * cosr;
           p[1] += v * nois * ty * sinr;
         }
@@ -504,10 +506,10 @@ iterate (control_point *cp,
         {
           /* blur */
           double rx, sinr, cosr, nois;
-          rx = flam3_random01 () * 2 * G_PI;
+          rx = flam3_random01 (gr) * 2 * G_PI;
           sinr = sin (rx);
           cosr = cos (rx);
-          nois = flam3_random01 ();
+          nois = flam3_random01 (gr);
           p[0] += v * nois * cosr;
           p[1] += v * nois * sinr;
         }
@@ -517,11 +519,11 @@ iterate (control_point *cp,
         {
           /* gaussian */
           double ang, sina, cosa, r2;
-          ang = flam3_random01 () * 2 * G_PI;
+          ang = flam3_random01 (gr) * 2 * G_PI;
           sina = sin (ang);
           cosa = cos (ang);
-          r2 = v * (flam3_random01 () + flam3_random01 () + flam3_random01 () +
-                    flam3_random01 () - 2.0);
+          r2 = v * (flam3_random01 (gr) + flam3_random01 (gr) +
+                    flam3_random01 (gr) + flam3_random01 (gr) - 2.0);
           p[0] += r2 * cosa;
           p[1] += r2 * sina;
         }
@@ -1210,7 +1212,9 @@ estimate_bounding_box (control_point *cp,
   int    high_target = batch - low_target;
   point  min, max, delta;
   point *points = malloc (sizeof (point) * batch);
-  iterate (cp, batch, 20, points);
+  GRand *gr = g_rand_new_with_seed (g_random_int ());
+  iterate (cp, batch, 20, points, gr);
+  g_rand_free (gr);
 
   min[0] = min[1] =  1e10;
   max[0] = max[1] = -1e10;
@@ -1290,25 +1294,13 @@ standard_metric (control_point *cp1,
 }
 
 static int
-flam3_random_bit (void)
+flam3_random_bit (GRand *gr)
 {
-  static int n = 0;
-  static int l;
-  if (n == 0)
-    {
-      l = g_random_int ();
-      n = 20;
-    }
-  else
-    {
-      l = l >> 1;
-      n--;
-    }
-  return l & 1;
+  return g_rand_boolean (gr);
 }
 
 static double
-flam3_random01 (void)
+flam3_random01 (GRand *gr)
 {
-  return (g_random_int () & 0xfffffff) / (double) 0xfffffff;
+  return (g_rand_int (gr) & 0xfffffff) / (double) 0xfffffff;
 }
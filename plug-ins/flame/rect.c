@@ -16,18 +16,21 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "rect.h"
-
 #include <string.h>
 
+#include "libgimp/gimp.h"
+
+#include "rect.h"
+
 
 /* for batch
  *   interpolate
  *   compute colormap
- *   for subbatch
- *     compute samples
- *     buckets += cmap[samples]
- *   accum += time_filter[batch] * log(buckets)
+ *   for stream (concurrently)
+ *     for subbatch
+ *       compute samples
+ *       buckets[stream] += cmap[samples]
+ *   accum += time_filter[batch] * log(sum of buckets)
  * image = filter(accum)
  */
 
@@ -60,12 +63,34 @@ typedef accum_t abucket[4];
 /* should be MAXBUCKET / (OVERSAMPLE^2) */
 #define PREFILTER_WHITE (MAXBUCKET>>4)
 
+/* the histograms of the streams besides the first one may use
+   up to this much memory together */
+#define MAX_STREAM_MEMORY (256 << 20)
+
 
 #define bump_no_overflow(dest, delta, type) { \
    type tt_ = dest + delta;            \
    if (tt_ > dest) dest = tt_;                 \
 }
 
+/* what the streams of one batch share.  every stream iterates
+   its own share of the sub batches, with its own random numbers,
+   into its own histogram. */
+typedef struct {
+   control_point *cp;
+   bucket        *cmap;
+   bucket       **buckets;    /* one histogram per stream */
+   guint32       *seeds;      /* one seed per stream */
+   int            n_streams;  /* number of streams actually run */
+   abucket       *accumulate;
+   double         bounds[4], size[2];
+   int            width, height;
+   int            batch_size;
+   double         k1, k2;
+   int          (*progress)(double);
+} render_batch;
+
+
 /* sum of entries of vector to 1 */
 static void
 normalize_vector(double *v,
@@ -80,6 +105,126 @@ normalize_vector(double *v,
     v[i] *= t;
 }
 
+static void
+iterate_stream (int      i,
+                int      n,
+                gpointer data)
+{
+  render_batch *rb = data;
+  bucket       *buckets = rb->buckets[i];
+  bucket       *cmap = rb->cmap;
+  double       *bounds = rb->bounds;
+  double       *size = rb->size;
+  int           width = rb->width;
+  int           height = rb->height;
+  int           n_sub_batches, sub_batch, first, last, j;
+  point        *points;
+  GRand        *gr;
+
+  if (i == 0)
+    rb->n_streams = n;
+
+  memset ((char *) buckets, 0, sizeof (bucket) * width * height);
+
+  points = malloc (sizeof (point) * SUB_BATCH_SIZE);
+  gr = g_rand_new_with_seed (rb->seeds[i]);
+
+  n_sub_batches = (rb->batch_size + SUB_BATCH_SIZE - 1) / SUB_BATCH_SIZE;
+  first = n_sub_batches * i / n;
+  last  = n_sub_batches * (i + 1) / n;
+
+  for (sub_batch = first; sub_batch < last; sub_batch++)
+    {
+      /* the first stream runs on the calling thread */
+      if (i == 0 && rb->progress && ((sub_batch - first) % 32) == 0)
+        (*rb->progress)(0.5 * (sub_batch - first) / (double) (last - first));
+      /* generate a sub_batch_size worth of samples */
+      points[0][0] = g_rand_double_range (gr, -1, 1);
+      points[0][1] = g_rand_double_range (gr, -1, 1);
+      points[0][2] = g_rand_double (gr);
+      iterate (rb->cp, SUB_BATCH_SIZE, FUSE, points, gr);
+
+      /* merge them into buckets, looking up colors */
+      for (j = 0; j < SUB_BATCH_SIZE; j++)
+        {
+          int k, color_index;
+          double *p = points[j];
+          bucket *b;
+
+          /* Note that we must test if p[0] and p[1] is "within"
+           * the valid bounds rather than "not outside", because
+           * p[0] and p[1] might be NaN.
+           */
+          if (p[0] >= bounds[0] &&
+              p[1] >= bounds[1] &&
+              p[0] <= bounds[2] &&
+              p[1] <= bounds[3])
+            {
+              color_index = (int) (p[2] * CMAP_SIZE);
+
+              if (color_index < 0)
+                color_index = 0;
+              else if (color_index > CMAP_SIZE - 1)
+                color_index = CMAP_SIZE - 1;
+
+              b = buckets +
+                  (int) (width * (p[0] - bounds[0]) * size[0]) +
+                  width * (int) (height * (p[1] - bounds[1]) * size[1]);
+
+              for (k = 0; k < 4; k++)
+                bump_no_overflow(b[0][k], cmap[color_index][k], short);
+            }
+        }
+    }
+
+  g_rand_free (gr);
+  free (points);
+}
+
+/* log intensity in hsv space, of the sum of the streams' histograms */
+static void
+accumulate_rows (int      i,
+                 int      n,
+                 gpointer data)
+{
+  render_batch *rb = data;
+  int           width = rb->width;
+  int           row, col, s, k;
+
+  for (row = rb->height * i / n; row < rb->height * (i + 1) / n; row++)
+    for (col = 0; col < width; col++)
+      {
+        abucket *a = rb->accumulate + col + row * width;
+        double c[4], ls;
+        c[0] = c[1] = c[2] = c[3] = 0.0;
+        for (s = 0; s < rb->n_streams; s++)
+          {
+            bucket *b = rb->buckets[s] + col + row * width;
+            c[0] += (double) b[0][0];
+            c[1] += (double) b[0][1];
+            c[2] += (double) b[0][2];
+            c[3] += (double) b[0][3];
+          }
+        if (0.0 == c[3])
+          continue;
+
+        /* saturate like a single histogram would */
+        for (k = 0; k < 4; k++)
+          c[k] = MIN (c[k], G_MAXSHORT);
+
+        ls = (rb->k1 * log(1.0 + c[3] * rb->k2))/c[3];
+        c[0] *= ls;
+        c[1] *= ls;
+        c[2] *= ls;
+        c[3] *= ls;
+
+        bump_no_overflow(a[0][0], c[0] + 0.5, accum_t);
+        bump_no_overflow(a[0][1], c[1] + 0.5, accum_t);
+        bump_no_overflow(a[0][2], c[2] + 0.5, accum_t);
+        bump_no_overflow(a[0][3], c[3] + 0.5, accum_t);
+      }
+}
+
 void
 render_rectangle (frame_spec    *spec,
                   unsigned char *out,
@@ -88,10 +233,9 @@ render_rectangle (frame_spec    *spec,
                   int            nchan,
                   int progress(double))
 {
-  int      i, j, k, nsamples, nbuckets, batch_size, batch_num, sub_batch;
-  bucket  *buckets;
+  int      i, j, k, nsamples, nbuckets, batch_num;
+  int      n_streams;
   abucket *accumulate;
-  point   *points;
   double  *filter, *temporal_filter, *temporal_deltas;
   double   bounds[4], size[2], ppux, ppuy;
   int      image_width, image_height;    /* size of the image to produce */
@@ -101,7 +245,7 @@ render_rectangle (frame_spec    *spec,
   int      nbatches = spec->cps[0].nbatches;
   bucket   cmap[CMAP_SIZE];
   int      gutter_width;
-  int      sbc;
+  render_batch rb;
 
   image_width = spec->cps[0].width;
   if (field)
@@ -162,38 +306,45 @@ render_rectangle (frame_spec    *spec,
   width  = oversample * image_width  + 2 * gutter_width;
 
   nbuckets = width * height;
-  if (1)
+
+  /* every stream needs a histogram of its own, don't run more of
+     them than the memory allows */
+  n_streams = MIN (gimp_parallel_get_n_threads (),
+                   1 + (int) (MAX_STREAM_MEMORY / (sizeof (bucket) * nbuckets)));
+
+  rb.buckets = malloc (sizeof (bucket *) * n_streams);
+  rb.seeds = malloc (sizeof (guint32) * n_streams);
+  accumulate = malloc (sizeof (abucket) * nbuckets);
+  for (i = 0; i < n_streams; i++)
+    rb.buckets[i] = malloc (sizeof (bucket) * nbuckets);
+  for (i = 0; i < n_streams; i++)
+    if (rb.buckets[i] == NULL)
+      {
+        /* give up on the additional streams, rather than the render */
+        for (j = MAX (i, 1); j < n_streams; j++)
+          free (rb.buckets[j]);
+        n_streams = MAX (i, 1);
+        break;
+      }
+  if (accumulate == NULL || rb.buckets[0] == NULL)
     {
-      static char *last_block = NULL;
-      static int   last_block_size = 0;
-      int memory_rqd = (sizeof (bucket) * nbuckets +
-                        sizeof (abucket) * nbuckets +
-                        sizeof (point) * SUB_BATCH_SIZE);
-      if (memory_rqd > last_block_size)
-        {
-          if (last_block != NULL)
-            free (last_block);
-          last_block = malloc (memory_rqd);
-          if (last_block == NULL)
-            {
-              fprintf (stderr, "render_rectangle: cannot malloc %d bytes.\n",
-                       memory_rqd);
-              exit (1);
-            }
-          last_block_size = memory_rqd;
-        }
-      buckets = (bucket *) last_block;
-      accumulate = (abucket *) (last_block + sizeof (bucket) * nbuckets);
-      points = (point *)  (last_block + (sizeof (bucket) + sizeof (abucket)) * nbuckets);
+      fprintf (stderr, "render_rectangle: cannot malloc %d bytes.\n",
+               (int) ((sizeof (bucket) + sizeof (abucket)) * nbuckets));
+      exit (1);
     }
 
+  rb.cmap = &cmap[0];
+  rb.accumulate = accumulate;
+  rb.width = width;
+  rb.height = height;
+  rb.progress = progress;
+
   memset ((char *) accumulate, 0, sizeof (abucket) * nbuckets);
   for (batch_num = 0; batch_num < nbatches; batch_num++)
     {
       double        batch_time;
       double        sample_density;
       control_point cp;
-      memset ((char *) buckets, 0, sizeof (bucket) * nbuckets);
       batch_time = spec->time + temporal_deltas[batch_num];
 
       /* interpolate and get a control point */
@@ -252,88 +403,28 @@ render_rectangle (frame_spec    *spec,
         }
       nsamples = (int) (sample_density * nbuckets /
                         (oversample * oversample));
-      batch_size = nsamples / cp.nbatches;
+      rb.cp = &cp;
+      rb.batch_size = nsamples / cp.nbatches;
+      memcpy (rb.bounds, bounds, sizeof (bounds));
+      memcpy (rb.size, size, sizeof (size));
 
-      sbc = 0;
-      for (sub_batch = 0;
-           sub_batch < batch_size;
-           sub_batch += SUB_BATCH_SIZE)
-        {
-          if (progress && (sbc++ % 32) == 0)
-              (*progress)(0.5 * sub_batch / (double) batch_size);
-          /* generate a sub_batch_size worth of samples */
-          points[0][0] = random_uniform11 ();
-          points[0][1] = random_uniform11 ();
-          points[0][2] = random_uniform01 ();
-          iterate (&cp, SUB_BATCH_SIZE, FUSE, points);
-
-          /* merge them into buckets, looking up colors */
-          for (j = 0; j < SUB_BATCH_SIZE; j++)
-            {
-              int k, color_index;
-              double *p = points[j];
-              bucket *b;
-
-              /* Note that we must test if p[0] and p[1] is "within"
-               * the valid bounds rather than "not outside", because
-               * p[0] and p[1] might be NaN.
-               */
-              if (p[0] >= bounds[0] &&
-                  p[1] >= bounds[1] &&
-                  p[0] <= bounds[2] &&
-                  p[1] <= bounds[3])
-                {
-                  color_index = (int) (p[2] * CMAP_SIZE);
-
-                  if (color_index < 0)
-                    color_index = 0;
-                  else if (color_index > CMAP_SIZE - 1)
-                    color_index = CMAP_SIZE - 1;
+      /* the seeds come from the global generator, so that a render
+         only depends on its seed and the number of streams */
+      for (i = 0; i < n_streams; i++)
+        rb.seeds[i] = g_random_int ();
 
-                  b = buckets +
-                      (int) (width * (p[0] - bounds[0]) * size[0]) +
-                      width * (int) (height * (p[1] - bounds[1]) * size[1]);
-
-                  for (k = 0; k < 4; k++)
-                    bump_no_overflow(b[0][k], cmap[color_index][k], short);
-                }
-            }
-        }
+      gimp_parallel_distribute (n_streams, iterate_stream, &rb);
 
       if (1)
         {
-          double k1 = (cp.contrast * cp.brightness *
-                       PREFILTER_WHITE * 268.0 *
-                       temporal_filter[batch_num]) / 256;
           double area = image_width * image_height / (ppux * ppuy);
-          double k2 = (oversample * oversample * nbatches) /
-                       (cp.contrast * area * cp.white_level * sample_density);
-
-          /* log intensity in hsv space */
-          for (j = 0; j < height; j++)
-            for (i = 0; i < width; i++)
-              {
-                abucket *a = accumulate + i + j * width;
-                bucket *b = buckets + i + j * width;
-                double c[4], ls;
-                c[0] = (double) b[0][0];
-                c[1] = (double) b[0][1];
-                c[2] = (double) b[0][2];
-                c[3] = (double) b[0][3];
-                if (0.0 == c[3])
-                  continue;
-
-                ls = (k1 * log(1.0 + c[3] * k2))/c[3];
-                c[0] *= ls;
-                c[1] *= ls;
-                c[2] *= ls;
-                c[3] *= ls;
-
-                bump_no_overflow(a[0][0], c[0] + 0.5, accum_t);
-                bump_no_overflow(a[0][1], c[1] + 0.5, accum_t);
-                bump_no_overflow(a[0][2], c[2] + 0.5, accum_t);
-                bump_no_overflow(a[0][3], c[3] + 0.5, accum_t);
-              }
+          rb.k1 = (cp.contrast * cp.brightness *
+                   PREFILTER_WHITE * 268.0 *
+                   temporal_filter[batch_num]) / 256;
+          rb.k2 = (oversample * oversample * nbatches) /
+                  (cp.contrast * area * cp.white_level * sample_density);
+
+          gimp_parallel_distribute (height, accumulate_rows, &rb);
         }
     }
   /*
@@ -391,6 +482,11 @@ render_rectangle (frame_spec    *spec,
         }
     }
 
+  for (i = 0; i < n_streams; i++)
+    free (rb.buckets[i]);
+  free (rb.buckets);
+  free (rb.seeds);
+  free (accumulate);
   free (filter);
   free (temporal_filter);
   free (temporal_deltas);
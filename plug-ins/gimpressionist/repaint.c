@@ -36,6 +36,57 @@
 
 #include <libgimp/stdplugins-intl.h>
 
+
+/* strokes are evaluated in chunks of this many strokes, and painted
+ * in bands of this many rows of the canvas
+ */
+#define STROKE_CHUNK_SIZE 64
+#define BAND_HEIGHT       32
+
+
+/* the nonzero pixels of a brush, row by row, with their offsets
+ * in bytes from the start of the row and their weights
+ */
+typedef struct
+{
+  int     height;
+  int    *row_end;
+  int    *offset;
+  double *weight;
+} BrushTable;
+
+typedef struct
+{
+  int     tx, ty;    /* the center, and after evaluation, the upper left */
+  int     on, sn;    /* orientation and size, unless adaptive */
+  int     brush;
+  int     r, g, b;
+  guint32 pick;      /* chooses among equally well matching brushes */
+  double  noise[3];
+} Stroke;
+
+typedef struct
+{
+  ppm_t      *p;
+  ppm_t      *a;
+  ppm_t      *canvas;
+  ppm_t      *acanvas;
+  ppm_t      *brushes;
+  ppm_t      *shadows;
+  double     *brushes_sum;
+  BrushTable *tables;
+  int         num_brushes;
+  int         maxbrushwidth;
+  int         maxbrushheight;
+  Stroke     *strokes;
+  int         n_strokes;
+  int         n_chunks;
+  int         next_chunk;
+  double      progress_start;
+  double      progress_span;
+} RepaintInfo;
+
+
 static gimpressionist_vals_t runningvals;
 
 static double
@@ -93,6 +144,45 @@ sum_brush (ppm_t *p)
   return sum;
 }
 
+static void
+brush_table_init (BrushTable *table, ppm_t *p)
+{
+  int x, y, n = 0;
+
+  for (x = 0; x < p->width * 3 * p->height; x += 3)
+    if (p->col[x])
+      n++;
+
+  table->height  = p->height;
+  table->row_end = g_new (int, p->height);
+  table->offset  = g_new (int, n);
+  table->weight  = g_new (double, n);
+
+  for (y = 0, n = 0; y < p->height; y++)
+    {
+      guchar *row = &p->col[y * p->width * 3];
+
+      for (x = 0; x < p->width; x++)
+        {
+          if (row[x * 3])
+            {
+              table->offset[n] = x * 3;
+              table->weight[n] = row[x * 3] / 255.0;
+              n++;
+            }
+        }
+      table->row_end[y] = n;
+    }
+}
+
+static void
+brush_table_clear (BrushTable *table)
+{
+  g_free (table->row_end);
+  g_free (table->offset);
+  g_free (table->weight);
+}
+
 /* TODO : Use r = rgb[0]; g = rgb[1] ; b = rgb[2]; instead of
  * the direct references here.
  * */
@@ -125,110 +215,110 @@ get_hue (guchar *rgb)
 
 static int
 choose_best_brush (ppm_t *p, ppm_t *a, int tx, int ty,
-                   ppm_t *brushes, int num_brushes,
-                   double *brushes_sum, int start, int step)
+                   BrushTable *tables, int num_brushes,
+                   double *brushes_sum, int start, int step,
+                   guint32 pick, int *ties)
 {
   double dev, thissum;
   double bestdev = 0.0;
   double r, g, b;
   int    best = -1;
-  int    x, y, h;
-  long   i;
-  GList *brlist = NULL;
+  int    n_ties = 0;
+  int    i, j, y;
 
   for (i = start; i < num_brushes; i += step)
     {
-      ppm_t *brush = &brushes[i];
-#if 0
-      thissum = 0.0;
-#endif
+      BrushTable *table = &tables[i];
+      gboolean    pruned = FALSE;
+
       thissum = brushes_sum[i];
 
-/* TODO: Pointer-arithmeticize this code */
       r = g = b = 0.0;
-      for (y = 0; y < brush->height; y++)
+      for (y = 0, j = 0; y < table->height; y++)
         {
-          guchar *row = p->col + (ty + y) * p->width * 3;
+          guchar *row = p->col + (ty + y) * p->width * 3 + tx * 3;
 
-          for (x = 0; x < brush->width; x++)
+          for (; j < table->row_end[y]; j++)
             {
-              int    k = (tx + x) * 3;
-              double v;
+              int    k = table->offset[j];
+              double v = table->weight[j];
 
-              if ((h = brush->col[(y * brush->width * 3) + x * 3]))
-                {
-#if 0
-                  thissum += h;
-#endif
-                  v = h / 255.0;
-                  r += row[k+0] * v;
-                  g += row[k+1] * v;
-                  b += row[k+2] * v;
-                }
+              r += row[k+0] * v;
+              g += row[k+1] * v;
+              b += row[k+2] * v;
             }
         }
       r = r * 255.0 / thissum;
       g = g * 255.0 / thissum;
       b = b * 255.0 / thissum;
 
+      /* The deviation only grows while it is summed up, so a brush can
+       * be dropped as soon as it does worse than the best one so far.
+       */
       dev = 0.0;
-      for (y = 0; y < brush->height; y++)
+      for (y = 0, j = 0; y < table->height && ! pruned; y++)
         {
-          guchar *row = p->col + (ty + y) * p->width * 3;
+          guchar *row  = p->col + (ty + y) * p->width * 3 + tx * 3;
+          guchar *arow = NULL;
+
+          if (img_has_alpha)
+            arow = a->col + (ty + y) * a->width * 3 + tx * 3;
 
-          for (x = 0; x < brush->width; x++)
+          for (; j < table->row_end[y]; j++)
             {
-              int    k = (tx + x) * 3;
-              double v;
+              int    k = table->offset[j];
+              double v = table->weight[j];
 
-              if ((h = brush->col[(y * brush->width * 3) + x * 3]))
-                {
-                  v = h / 255.0;
-                  dev += abs (row[k+0] - r) * v;
-                  dev += abs (row[k+1] - g) * v;
-                  dev += abs (row[k+2] - b) * v;
-                  if (img_has_alpha)
-                    dev += a->col[(ty + y) * a->width * 3 + (tx + x) * 3] * v;
-                }
+              dev += abs (row[k+0] - r) * v;
+              dev += abs (row[k+1] - g) * v;
+              dev += abs (row[k+2] - b) * v;
+              if (img_has_alpha)
+                dev += arow[k] * v;
             }
+
+          if (best >= 0 && dev / thissum > bestdev)
+            pruned = TRUE;
         }
+      if (pruned)
+        continue;
+
       dev /= thissum;
 
       if ((best == -1) || (dev < bestdev))
-        {
-          if (brlist)
-            g_list_free (brlist);
-          brlist = NULL;
-        }
+        n_ties = 0;
 
       if (dev <= bestdev || best < 0)
         {
           best = i;
           bestdev = dev;
-          brlist = g_list_append (brlist, (void *)i);
+          ties[n_ties++] = i;
         }
       if (dev < runningvals.devthresh)
         break;
     }
 
-  if (!brlist)
+  if (! n_ties)
     {
       g_printerr("What!? No brushes?!\n");
       return 0;
     }
 
-  i = g_rand_int_range (random_generator, 0, g_list_length (brlist));
-  best = (long)((g_list_nth (brlist,i))->data);
-  g_list_free (brlist);
-
-  return best;
+  /* The same reduction g_rand_int_range (rand, 0, n_ties) applies to
+   * the g_rand_int () it draws, so renders with a fixed seed stay the
+   * same as when the brush was picked right here.  Only when that
+   * draw falls into the last, incomplete multiple of n_ties (less than
+   * n_ties in 2^32) would g_rand_int_range () have drawn again.
+   */
+  return ties[pick % n_ties];
 }
 
+/* Paints a brush, only touching the rows from y0 up to y1 */
 static void
 apply_brush (ppm_t *brush,
              ppm_t *shadow,
              ppm_t *p, ppm_t *a,
-             int tx, int ty, int r, int g, int b)
+             int tx, int ty, int r, int g, int b,
+             int y0, int y1)
 {
   ppm_t  tmp;
   ppm_t  atmp;
@@ -246,19 +336,18 @@ apply_brush (ppm_t *brush,
   if (img_has_alpha)
     atmp = *a;
 
+  y0 = MAX (y0, 0);
+  y1 = MIN (y1, tmp.height);
+
   if (shadow)
     {
       int sx = tx + shadowdepth - shadowblur * 2;
       int sy = ty + shadowdepth - shadowblur * 2;
 
-      for (y = 0; y < shadow->height; y++)
+      for (y = MAX (0, y0 - sy); y < MIN (shadow->height, y1 - sy); y++)
         {
           guchar *row, *arow = NULL;
 
-          if ((sy + y) < 0)
-            continue;
-          if ((sy + y) >= tmp.height)
-            break;
           row = tmp.col + (sy + y) * tmp.width * 3;
 
           if (img_has_alpha)
@@ -288,7 +377,7 @@ apply_brush (ppm_t *brush,
         }
     }
 
-  for (y = 0; y < brush->height; y++)
+  for (y = MAX (0, y0 - ty); y < MIN (brush->height, y1 - ty); y++)
     {
       guchar *row = tmp.col + (ty + y) * tmp.width * 3;
       guchar *arow = NULL;
@@ -327,7 +416,7 @@ apply_brush (ppm_t *brush,
 
   if (relief > 0.001)
     {
-      for (y = 1; y < brush->height; y++)
+      for (y = MAX (1, y0 - ty); y < MIN (brush->height, y1 - ty); y++)
         {
           guchar *row = tmp.col + (ty + y) * tmp.width * 3;
 
@@ -346,6 +435,274 @@ apply_brush (ppm_t *brush,
     }
 }
 
+/* Reports progress from the calling thread, fraction is the part of
+ * the current phase which is done.
+ */
+static void
+repaint_progress (RepaintInfo *info, double fraction)
+{
+  fraction = info->progress_start + info->progress_span * fraction;
+
+  if (runningvals.run)
+    {
+      gimp_progress_update (0.8 * fraction);
+    }
+  else
+    {
+      char tmps[40];
+
+      g_snprintf (tmps, sizeof (tmps), "%.1f %%", 100 * fraction);
+      preview_set_button_label (tmps);
+
+      while (gtk_events_pending ())
+        gtk_main_iteration ();
+    }
+}
+
+/* Hands out the chunks of the current phase, in order */
+static int
+repaint_next_chunk (RepaintInfo *info,
+                    int          i,
+                    double      *last_progress)
+{
+  int chunk = g_atomic_int_add (&info->next_chunk, 1);
+
+  if (i == 0 && chunk < info->n_chunks)
+    {
+      double fraction = (double) chunk / info->n_chunks;
+
+      if (fraction - *last_progress >= 1.0 / 30.0)
+        {
+          repaint_progress (info, fraction);
+          *last_progress = fraction;
+        }
+    }
+
+  return chunk;
+}
+
+/* Chooses the brush and color of a stroke, only reading the source */
+static void
+evaluate_stroke (RepaintInfo *info, Stroke *stroke, int *ties)
+{
+  ppm_t  *p = info->p;
+  ppm_t  *brush;
+  int     maxbrushwidth = info->maxbrushwidth;
+  int     maxbrushheight = info->maxbrushheight;
+  int     tx = stroke->tx, ty = stroke->ty;
+  int     on = stroke->on, sn = stroke->sn;
+  int     r, g, b, n;
+
+  /* Handle Adaptive selections */
+  if (runningvals.orient_type == ORIENTATION_ADAPTIVE)
+    {
+      if (runningvals.size_type == SIZE_TYPE_ADAPTIVE)
+        n = choose_best_brush (p, info->a, tx-maxbrushwidth/2,
+                               ty-maxbrushheight/2, info->tables,
+                               info->num_brushes, info->brushes_sum, 0, 1,
+                               stroke->pick, ties);
+      else
+        {
+          int st = sn * runningvals.orient_num;
+          n = choose_best_brush (p, info->a, tx-maxbrushwidth/2,
+                                 ty-maxbrushheight/2, info->tables,
+                                 st+runningvals.orient_num, info->brushes_sum,
+                                 st, 1, stroke->pick, ties);
+        }
+    }
+  else
+    {
+      if (runningvals.size_type == SIZE_TYPE_ADAPTIVE)
+        n = choose_best_brush (p, info->a, tx-maxbrushwidth/2,
+                               ty-maxbrushheight/2, info->tables,
+                               info->num_brushes, info->brushes_sum,
+                               on, runningvals.orient_num,
+                               stroke->pick, ties);
+      else
+        n = sn * runningvals.orient_num + on;
+    }
+  /* Should never happen, but hey... */
+  if (n < 0)
+    n = 0;
+  else if (n >= info->num_brushes)
+    n = info->num_brushes - 1;
+
+  tx -= maxbrushwidth/2;
+  ty -= maxbrushheight/2;
+
+  brush = &info->brushes[n];
+
+  /* Calculate color - avg. of in-brush pixels */
+  if (runningvals.color_type == 0)
+    {
+      BrushTable *table = &info->tables[n];
+      double      thissum = info->brushes_sum[n];
+      int         y, j;
+
+      r = g = b = 0;
+      for (y = 0, j = 0; y < table->height; y++)
+        {
+          guchar *row = &p->col[(ty + y) * p->width * 3 + tx * 3];
+
+          for (; j < table->row_end[y]; j++)
+            {
+              int    k = table->offset[j];
+              double v = table->weight[j];
+
+              r += row[k+0] * v;
+              g += row[k+1] * v;
+              b += row[k+2] * v;
+            }
+        }
+      r = r * 255.0 / thissum;
+      g = g * 255.0 / thissum;
+      b = b * 255.0 / thissum;
+    }
+  else if (runningvals.color_type == 1)
+    {
+      guchar *pixel;
+      int     x, y;
+
+      y = ty + (brush->height / 2);
+      x = tx + (brush->width / 2);
+      pixel = &p->col[y*p->width * 3 + x * 3];
+      r = pixel[0];
+      g = pixel[1];
+      b = pixel[2];
+    }
+  else
+    {
+      /* No such color_type! */
+      r = g = b = 0;
+    }
+  if (runningvals.color_noise > 0.0)
+    {
+#define BOUNDS(a) (((a) < 0) ? (a) : ((a) > 255) ? 255 : (a))
+#define MYASSIGN(a, i) \
+    { \
+        a = a + stroke->noise[i]; \
+        a = BOUNDS(a) ;       \
+    }
+      MYASSIGN (r, 0);
+      MYASSIGN (g, 1);
+      MYASSIGN (b, 2);
+#undef BOUNDS
+#undef MYASSIGN
+    }
+
+  stroke->tx = tx;
+  stroke->ty = ty;
+  stroke->brush = n;
+  stroke->r = r;
+  stroke->g = g;
+  stroke->b = b;
+}
+
+static void
+evaluate_strokes (int i, int n, RepaintInfo *info)
+{
+  int    *ties = g_new (int, info->num_brushes);
+  double  last_progress = 0.0;
+  int     chunk;
+
+  while ((chunk = repaint_next_chunk (info, i, &last_progress)) <
+         info->n_chunks)
+    {
+      int first = chunk * STROKE_CHUNK_SIZE;
+      int last  = MIN (first + STROKE_CHUNK_SIZE, info->n_strokes);
+      int j;
+
+      for (j = first; j < last; j++)
+        evaluate_stroke (info, &info->strokes[j], ties);
+    }
+
+  g_free (ties);
+}
+
+/* Paints a stroke, and its copies on the opposite edges when the
+ * result is to be tileable, only touching the rows from y0 up to y1
+ */
+static void
+apply_stroke (RepaintInfo *info, const Stroke *stroke, int y0, int y1)
+{
+  ppm_t *brush = &info->brushes[stroke->brush];
+  ppm_t *shadow = NULL;
+  ppm_t *tmp = info->canvas, *atmp = info->acanvas;
+  int    tx = stroke->tx, ty = stroke->ty;
+  int    r = stroke->r, g = stroke->g, b = stroke->b;
+  int    maxbrushwidth = info->maxbrushwidth;
+  int    maxbrushheight = info->maxbrushheight;
+
+  if (info->shadows)
+    shadow = &info->shadows[stroke->brush];
+
+  apply_brush (brush, shadow, tmp, atmp, tx,ty, r,g,b, y0,y1);
+
+  if (runningvals.general_tileable && runningvals.general_paint_edges)
+    {
+      int orig_width = tmp->width - 2 * maxbrushwidth;
+      int orig_height = tmp->height - 2 * maxbrushheight;
+      int dox = 0, doy = 0;
+
+      if (tx < maxbrushwidth)
+        {
+          apply_brush (brush, shadow, tmp, atmp, tx+orig_width,ty, r,g,b,
+                       y0,y1);
+          dox = -1;
+        }
+      else if (tx > orig_width)
+        {
+          apply_brush (brush, shadow, tmp, atmp, tx-orig_width,ty, r,g,b,
+                       y0,y1);
+          dox = 1;
+        }
+      if (ty < maxbrushheight)
+        {
+          apply_brush (brush, shadow, tmp, atmp, tx,ty+orig_height, r,g,b,
+                       y0,y1);
+          doy = 1;
+        }
+      else if (ty > orig_height)
+        {
+          apply_brush (brush, shadow, tmp, atmp, tx,ty-orig_height, r,g,b,
+                       y0,y1);
+          doy = -1;
+        }
+      if (doy)
+        {
+          if (dox < 0)
+            apply_brush (brush, shadow, tmp, atmp,
+                         tx+orig_width, ty + doy * orig_height, r, g, b,
+                         y0, y1);
+          if (dox > 0)
+            apply_brush (brush, shadow, tmp, atmp,
+                         tx-orig_width, ty + doy * orig_height, r, g, b,
+                         y0, y1);
+        }
+    }
+}
+
+/* Every band of the canvas gets all strokes in their original order,
+ * so the result does not depend on the number of threads.
+ */
+static void
+apply_strokes (int i, int n, RepaintInfo *info)
+{
+  double last_progress = 0.0;
+  int    band;
+
+  while ((band = repaint_next_chunk (info, i, &last_progress)) <
+         info->n_chunks)
+    {
+      int y0 = band * BAND_HEIGHT;
+      int y1 = y0 + BAND_HEIGHT;
+      int j;
+
+      for (j = 0; j < info->n_strokes; j++)
+        apply_stroke (info, &info->strokes[j], y0, y1);
+    }
+}
+
 void
 repaint (ppm_t *p, ppm_t *a)
 {
@@ -353,12 +710,15 @@ repaint (ppm_t *p, ppm_t *a)
   int         tx = 0, ty = 0;
   ppm_t       tmp = {0, 0, NULL};
   ppm_t       atmp = {0, 0, NULL};
-  int         r, g, b, h, i, j, on, sn;
+  int         h, i, j, on, sn;
   int         num_brushes, maxbrushwidth, maxbrushheight;
   guchar      back[3] = {0, 0, 0};
   ppm_t      *brushes, *shadows;
-  ppm_t      *brush, *shadow = NULL;
   double     *brushes_sum;
+  BrushTable *tables;
+  Stroke     *strokes;
+  int         n_strokes;
+  RepaintInfo info;
   int         cx, cy, maxdist;
   double      scale, relief, startangle, anglespan, density, bgamma;
   int         max_progress;
@@ -366,7 +726,6 @@ repaint (ppm_t *p, ppm_t *a)
   ppm_t       dirmap = {0, 0, NULL};
   ppm_t       sizmap = {0, 0, NULL};
   int        *xpos = NULL, *ypos = NULL;
-  int         progstep;
   static int  running = 0;
 
   int dropshadow = pcvals.general_drop_shadow;
@@ -463,8 +822,6 @@ repaint (ppm_t *p, ppm_t *a)
       brushes_sum[i] = sum_brush (&brushes[i]);
     }
 
-  brush = &brushes[0];
-
   maxbrushwidth = maxbrushheight = 0;
   for (i = 0; i < num_brushes; i++)
     {
@@ -810,9 +1167,6 @@ repaint (ppm_t *p, ppm_t *a)
     i = 1;
 
   max_progress = i;
-  progstep = max_progress / 30;
-  if (progstep < 10)
-    progstep = 10;
 
   if (runningvals.place_type == PLACEMENT_TYPE_EVEN_DIST)
     {
@@ -839,29 +1193,15 @@ repaint (ppm_t *p, ppm_t *a)
         }
     }
 
+  /* All random numbers are drawn here, in stroke order, so the strokes
+   * can be evaluated and painted on several threads below.
+   */
+  strokes = g_new (Stroke, max_progress);
+  n_strokes = 0;
+
   for (; i; i--)
     {
-      int n;
-      double thissum;
-
-      if (i % progstep == 0)
-        {
-          if(runningvals.run)
-            {
-              gimp_progress_update (0.8 - 0.8 * ((double)i / max_progress));
-            }
-          else
-            {
-              char tmps[40];
-
-              g_snprintf (tmps, sizeof (tmps),
-                          "%.1f %%", 100 * (1.0 - ((double)i / max_progress)));
-              preview_set_button_label (tmps);
-
-              while(gtk_events_pending())
-                gtk_main_iteration();
-            }
-        }
+      Stroke *stroke;
 
       if (runningvals.place_type == PLACEMENT_TYPE_RANDOM)
         {
@@ -950,143 +1290,72 @@ repaint (ppm_t *p, ppm_t *a)
           break;
       }
 
-      /* Handle Adaptive selections */
-      if (runningvals.orient_type == ORIENTATION_ADAPTIVE)
-        {
-          if (runningvals.size_type == SIZE_TYPE_ADAPTIVE)
-            n = choose_best_brush (p, a, tx-maxbrushwidth/2,
-                                  ty-maxbrushheight/2, brushes,
-                                  num_brushes, brushes_sum, 0, 1);
-          else
-            {
-              int st = sn * runningvals.orient_num;
-              n = choose_best_brush (p, a, tx-maxbrushwidth/2,
-                                    ty-maxbrushheight/2, brushes,
-                                    st+runningvals.orient_num, brushes_sum,
-                                    st, 1);
-            }
-        }
-      else
-        {
-          if (runningvals.size_type == SIZE_TYPE_ADAPTIVE)
-            n = choose_best_brush (p, a, tx-maxbrushwidth/2,
-                                    ty-maxbrushheight/2, brushes,
-                                    num_brushes, brushes_sum,
-                                    on, runningvals.orient_num);
-          else
-            n = sn * runningvals.orient_num + on;
-        }
-      /* Should never happen, but hey... */
-      if (n < 0)
-        n = 0;
-      else if (n >= num_brushes)
-        n = num_brushes - 1;
-
-      tx -= maxbrushwidth/2;
-      ty -= maxbrushheight/2;
-
-      brush = &brushes[n];
-      if (dropshadow)
-        shadow = &shadows[n];
-      thissum = brushes_sum[n];
-
-      /* Calculate color - avg. of in-brush pixels */
-      if (runningvals.color_type == 0)
-        {
-          r = g = b = 0;
-          for (y = 0; y < brush->height; y++)
-            {
-              guchar *row = &p->col[(ty + y) * p->width * 3];
+      stroke = &strokes[n_strokes++];
+
+      stroke->tx = tx;
+      stroke->ty = ty;
+      stroke->on = on;
+      stroke->sn = sn;
+      stroke->pick = 0;
+
+      if (runningvals.orient_type == ORIENTATION_ADAPTIVE ||
+          runningvals.size_type == SIZE_TYPE_ADAPTIVE)
+        stroke->pick = g_rand_int (random_generator);
 
-              for (x = 0; x < brush->width; x++)
-                {
-                  int k = (tx + x) * 3;
-                  double v;
-
-                  if ((h = brush->col[y * brush->width * 3 + x * 3]))
-                    {
-                      v = h / 255.0;
-                      r += row[k+0] * v;
-                      g += row[k+1] * v;
-                      b += row[k+2] * v;
-                    }
-                }
-            }
-          r = r * 255.0 / thissum;
-          g = g * 255.0 / thissum;
-          b = b * 255.0 / thissum;
-        }
-      else if (runningvals.color_type == 1)
-        {
-          guchar *pixel;
-
-          y = ty + (brush->height / 2);
-          x = tx + (brush->width / 2);
-          pixel = &p->col[y*p->width * 3 + x * 3];
-          r = pixel[0];
-          g = pixel[1];
-          b = pixel[2];
-        }
-      else
-        {
-          /* No such color_type! */
-          r = g = b = 0;
-        }
       if (runningvals.color_noise > 0.0)
         {
           double v = runningvals.color_noise;
-#define BOUNDS(a) (((a) < 0) ? (a) : ((a) > 255) ? 255 : (a))
-#define MYASSIGN(a) \
-    { \
-        a = a + g_rand_double_range (random_generator, -v/2.0, v/2.0); \
-        a = BOUNDS(a) ;       \
-    }
-          MYASSIGN (r);
-          MYASSIGN (g);
-          MYASSIGN (b);
-#undef BOUNDS
-#undef MYASSIGN
+
+          for (j = 0; j < 3; j++)
+            stroke->noise[j] = g_rand_double_range (random_generator,
+                                                    -v/2.0, v/2.0);
         }
+    }
 
-      apply_brush (brush, shadow, &tmp, &atmp, tx,ty, r,g,b);
+  tables = g_new (BrushTable, num_brushes);
+  for (i = 0; i < num_brushes; i++)
+    brush_table_init (&tables[i], &brushes[i]);
+
+  info.p              = p;
+  info.a              = a;
+  info.canvas         = &tmp;
+  info.acanvas        = &atmp;
+  info.brushes        = brushes;
+  info.shadows        = shadows;
+  info.brushes_sum    = brushes_sum;
+  info.tables         = tables;
+  info.num_brushes    = num_brushes;
+  info.maxbrushwidth  = maxbrushwidth;
+  info.maxbrushheight = maxbrushheight;
+  info.strokes        = strokes;
+  info.n_strokes      = n_strokes;
+
+  /* Choosing the brushes only reads the source, so the strokes are
+   * independent of each other.
+   */
+  info.n_chunks       = (n_strokes + STROKE_CHUNK_SIZE - 1) / STROKE_CHUNK_SIZE;
+  info.next_chunk     = 0;
+  info.progress_start = 0.0;
+  info.progress_span  = 0.5;
+
+  gimp_parallel_distribute (info.n_chunks,
+                            (GimpParallelDistributeFunc) evaluate_strokes,
+                            &info);
+
+  info.n_chunks       = (tmp.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+  info.next_chunk     = 0;
+  info.progress_start = 0.5;
+  info.progress_span  = 0.5;
+
+  gimp_parallel_distribute (info.n_chunks,
+                            (GimpParallelDistributeFunc) apply_strokes,
+                            &info);
 
-      if (runningvals.general_tileable && runningvals.general_paint_edges)
-        {
-          int orig_width = tmp.width - 2 * maxbrushwidth;
-          int orig_height = tmp.height - 2 * maxbrushheight;
-          int dox = 0, doy = 0;
+  for (i = 0; i < num_brushes; i++)
+    brush_table_clear (&tables[i]);
+  g_free (tables);
+  g_free (strokes);
 
-          if (tx < maxbrushwidth)
-            {
-              apply_brush (brush, shadow, &tmp, &atmp, tx+orig_width,ty, r,g,b);
-              dox = -1;
-            }
-          else if (tx > orig_width)
-            {
-              apply_brush (brush, shadow, &tmp, &atmp, tx-orig_width,ty, r,g,b);
-              dox = 1;
-            }
-          if (ty < maxbrushheight)
-            {
-              apply_brush (brush, shadow, &tmp, &atmp, tx,ty+orig_height, r,g,b);
-              doy = 1;
-            }
-          else if (ty > orig_height)
-            {
-              apply_brush (brush, shadow, &tmp, &atmp, tx,ty-orig_height, r,g,b);
-              doy = -1;
-            }
-          if (doy)
-            {
-              if (dox < 0)
-                apply_brush (brush, shadow, &tmp, &atmp,
-                             tx+orig_width, ty + doy * orig_height, r, g, b);
-              if (dox > 0)
-                apply_brush (brush, shadow, &tmp, &atmp,
-                             tx-orig_width, ty + doy * orig_height, r, g, b);
-            }
-        }
-    }
   for (i = 0; i < num_brushes; i++)
     {
       ppm_kill (&brushes[i]);
@@ -16,6 +16,68 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+typedef struct
+{
+  get_ray_func ray_func;
+  gboolean     has_alpha;
+} ComputeInfo;
+
+
+/*********************************************/
+/* Render the rows of an area, called on the */
+/* worker threads with their own bump rows.  */
+/*********************************************/
+
+static void
+compute_area (gint      x,
+              gint      y,
+              gint      w,
+              gint      h,
+              guchar   *dest,
+              gint      rowstride,
+              gpointer  data)
+{
+  ComputeInfo *info = data;
+  BumpRows    *rows;
+  gint         xcount, ycount;
+  GimpRGB      color;
+  GimpVector3  p;
+  gint32       index;
+  gboolean     bump_mapped;
+
+  bump_mapped = mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1;
+
+  rows = bump_rows_new ();
+
+  if (bump_mapped)
+    precompute_start (rows, y);
+
+  for (ycount = y; ycount < y + h; ycount++)
+    {
+      if (bump_mapped)
+        precompute_normals (rows, 0, width, ycount);
+
+      index = 0;
+
+      for (xcount = x; xcount < x + w; xcount++)
+        {
+          p = int_to_pos (xcount, ycount);
+          color = (* info->ray_func) (rows, &p);
+
+          dest[index++] = (guchar) (color.r * 255.0);
+          dest[index++] = (guchar) (color.g * 255.0);
+          dest[index++] = (guchar) (color.b * 255.0);
+
+          if (info->has_alpha)
+            dest[index++] = (guchar) (color.a * 255.0);
+        }
+
+      dest += rowstride;
+    }
+
+  bump_rows_free (rows);
+}
+
 /*************/
 /* Main loop */
 /*************/
@@ -23,20 +85,11 @@
 void
 compute_image (void)
 {
-  gint         xcount, ycount;
-  GimpRGB       color;
-  glong        progress_counter = 0;
-  GimpVector3  p;
+  ComputeInfo  info;
   gint32       new_image_id = -1;
   gint32       new_layer_id = -1;
-  gint32       index;
-  guchar      *row = NULL;
-  guchar       obpp;
-  gboolean     has_alpha;
   get_ray_func ray_func;
 
-
-
   if (mapvals.create_new_image == TRUE ||
       (mapvals.transparent_background == TRUE &&
        ! gimp_drawable_has_alpha (input_drawable->drawable_id)))
@@ -73,11 +126,18 @@ compute_image (void)
       output_drawable = gimp_drawable_get (new_layer_id);
     }
 
+  /* The workers only read pixels from memory, the drawables */
+  /* may have changed since the preview read them.           */
+  /* ======================================================= */
+
+  image_pixels_clear (&source_pixels);
+  image_pixels_clear (&bump_pixels);
+  image_pixels_clear (&env_pixels);
+
+  image_pixels_read (&source_pixels, input_drawable->drawable_id);
+
   if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-    {
-      gimp_pixel_rgn_init (&bump_region, gimp_drawable_get (mapvals.bumpmap_id),
-			   0, 0, width, height, FALSE, FALSE);
-    }
+    image_pixels_read (&bump_pixels, mapvals.bumpmap_id);
 
   precompute_init (width, height);
 
@@ -87,57 +147,28 @@ compute_image (void)
     }
   else
     {
-      env_width = gimp_drawable_width (mapvals.envmap_id);
-      env_height = gimp_drawable_height (mapvals.envmap_id);
-      gimp_pixel_rgn_init (&env_region, gimp_drawable_get (mapvals.envmap_id),
-			   0, 0, env_width, env_height, FALSE, FALSE);
+      image_pixels_read (&env_pixels, mapvals.envmap_id);
+
+      env_width  = env_pixels.width;
+      env_height = env_pixels.height;
       ray_func = get_ray_color_ref;
     }
 
   gimp_pixel_rgn_init (&dest_region, output_drawable,
 		       0, 0, width, height, TRUE, TRUE);
 
-  obpp = gimp_drawable_bpp (output_drawable->drawable_id);
-  has_alpha = gimp_drawable_has_alpha (output_drawable->drawable_id);
-
-  row = g_new (guchar, obpp * width);
+  info.ray_func  = ray_func;
+  info.has_alpha = gimp_drawable_has_alpha (output_drawable->drawable_id);
 
   gimp_progress_init (_("Lighting Effects"));
 
-  /* Init the first row */
-  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1 && height >= 2)
-    interpol_row (0, width, 0);
-
-  for (ycount = 0; ycount < height; ycount++)
-    {
-      if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-	precompute_normals (0, width, ycount);
-
-      index = 0;
-
-      for (xcount = 0; xcount < width; xcount++)
-	{
-	  p = int_to_pos (xcount, ycount);
-	  color = (* ray_func) (&p);
-
-	  row[index++] = (guchar) (color.r * 255.0);
-	  row[index++] = (guchar) (color.g * 255.0);
-	  row[index++] = (guchar) (color.b * 255.0);
-
-	  if (has_alpha)
-	    row[index++] = (guchar) (color.a * 255.0);
-
-	  if ((progress_counter++ % width) == 0)
-	    gimp_progress_update ((gdouble) progress_counter /
-				  (gdouble) maxcounter);
-	}
-
-      gimp_pixel_rgn_set_row (&dest_region, row, 0, ycount, width);
-    }
+  gimp_parallel_process_rgn (&dest_region, 0, 0, compute_area, &info);
 
   gimp_progress_update (1.0);
 
-  g_free (row);
+  image_pixels_clear (&source_pixels);
+  image_pixels_clear (&bump_pixels);
+  image_pixels_clear (&env_pixels);
 
   /* Update image */
   /* ============ */
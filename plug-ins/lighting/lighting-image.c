@@ -15,13 +15,11 @@
 
 
 GimpDrawable *input_drawable,*output_drawable;
-GimpPixelRgn  source_region, dest_region;
+GimpPixelRgn  dest_region;
 
-GimpDrawable *bump_drawable = NULL;
-GimpPixelRgn  bump_region;
-
-GimpDrawable *env_drawable = NULL;
-GimpPixelRgn  env_region;
+ImagePixels   source_pixels = { -1, };
+ImagePixels   bump_pixels   = { -1, };
+ImagePixels   env_pixels    = { -1, };
 
 guchar          *preview_rgb_data = NULL;
 gint             preview_rgb_stride;
@@ -39,18 +37,79 @@ guchar sinemap[256], spheremap[256], logmap[256];
 /* Implementation */
 /******************/
 
-guchar
-peek_map (GimpPixelRgn *region,
-	  gint       x,
-	  gint       y)
+/* Read the pixels of a drawable, unless they are already there. */
+/* Must be called on the main thread, before rendering starts.   */
+
+void
+image_pixels_read (ImagePixels *pixels,
+                   gint32       drawable_id)
+{
+  GimpDrawable *drawable;
+  GimpPixelRgn  region;
+
+  if (pixels->drawable_id == drawable_id)
+    return;
+
+  image_pixels_clear (pixels);
+
+  if (drawable_id == -1)
+    return;
+
+  pixels->drawable_id = drawable_id;
+
+  drawable = gimp_drawable_get (drawable_id);
+
+  if (! drawable)
+    return;
+
+  pixels->width       = drawable->width;
+  pixels->height      = drawable->height;
+  pixels->bpp         = drawable->bpp;
+  pixels->has_alpha   = gimp_drawable_has_alpha (drawable_id);
+  pixels->data        = g_new (guchar, ((gsize) pixels->width *
+                                        pixels->height * pixels->bpp));
+
+  gimp_pixel_rgn_init (&region, drawable,
+                       0, 0, pixels->width, pixels->height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&region, pixels->data,
+                           0, 0, pixels->width, pixels->height);
+
+  gimp_drawable_detach (drawable);
+}
+
+void
+image_pixels_clear (ImagePixels *pixels)
+{
+  g_free (pixels->data);
+
+  pixels->drawable_id = -1;
+  pixels->width       = 0;
+  pixels->height      = 0;
+  pixels->data        = NULL;
+}
+
+static inline const guchar *
+image_pixels_get (const ImagePixels *pixels,
+                  gint               x,
+                  gint               y)
 {
-  guchar data[4];
-  guchar ret_val;
+  x = CLAMP (x, 0, pixels->width  - 1);
+  y = CLAMP (y, 0, pixels->height - 1);
 
+  return pixels->data + ((gsize) y * pixels->width + x) * pixels->bpp;
+}
+
+guchar
+peek_map (ImagePixels *pixels,
+	  gint         x,
+	  gint         y)
+{
+  const guchar *data;
+  guchar        ret_val;
 
-  gimp_pixel_rgn_get_pixel (region, data, x, y);
+  data = image_pixels_get (pixels, x, y);
 
-  if (region->bpp == 1)
+  if (pixels->bpp == 1)
   {
     ret_val = data[0];
   } else
@@ -65,26 +124,19 @@ GimpRGB
 peek (gint x,
       gint y)
 {
-  guchar data[4];
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
-  gimp_pixel_rgn_get_pixel (&source_region,data, x, y);
+  data = image_pixels_get (&source_pixels, x, y);
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
   color.b = (gdouble) (data[2]) / 255.0;
 
-  if (input_drawable->bpp == 4)
-    {
-      if (in_channels == 4)
-        color.a = (gdouble) (data[3]) / 255.0;
-      else
-        color.a = 1.0;
-    }
+  if (source_pixels.bpp == 4 && source_pixels.has_alpha)
+    color.a = (gdouble) (data[3]) / 255.0;
   else
-    {
-      color.a = 1.0;
-    }
+    color.a = 1.0;
 
   return color;
 }
@@ -93,23 +145,22 @@ GimpRGB
 peek_env_map (gint x,
 	      gint y)
 {
-  guchar data[4];
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
-  if (x < 0)
-    x = 0;
-  else if (x >= env_width)
-    x = env_width - 1;
-  if (y < 0)
-    y = 0;
-  else if (y >= env_height)
-    y = env_height - 1;
+  data = image_pixels_get (&env_pixels, x, y);
 
-  gimp_pixel_rgn_get_pixel (&env_region, data, x, y);
+  if (env_pixels.bpp >= 3)
+    {
+      color.r = (gdouble) (data[0]) / 255.0;
+      color.g = (gdouble) (data[1]) / 255.0;
+      color.b = (gdouble) (data[2]) / 255.0;
+    }
+  else
+    {
+      color.r = color.g = color.b = (gdouble) (data[0]) / 255.0;
+    }
 
-  color.r = (gdouble) (data[0]) / 255.0;
-  color.g = (gdouble) (data[1]) / 255.0;
-  color.b = (gdouble) (data[2]) / 255.0;
   color.a = 1.0;
 
   return color;
@@ -283,7 +334,7 @@ get_image_color (gdouble  u,
 }
 
 gdouble
-get_map_value (GimpPixelRgn *region,
+get_map_value (ImagePixels *pixels,
 	       gdouble    u,
 	       gdouble    v,
 	       gint      *inside)
@@ -300,14 +351,14 @@ get_map_value (GimpPixelRgn *region,
   if (check_bounds (x2, y2) == FALSE)
     {
       *inside = TRUE;
-      return (gdouble) peek_map (region, x1, y1);
+      return (gdouble) peek_map (pixels, x1, y1);
     }
 
   *inside = TRUE;
-  p[0] = (gdouble) peek_map (region, x1, y1);
-  p[1] = (gdouble) peek_map (region, x2, y1);
-  p[2] = (gdouble) peek_map (region, x1, y2);
-  p[3] = (gdouble) peek_map (region, x2, y2);
+  p[0] = (gdouble) peek_map (pixels, x1, y1);
+  p[1] = (gdouble) peek_map (pixels, x2, y1);
+  p[2] = (gdouble) peek_map (pixels, x1, y2);
+  p[3] = (gdouble) peek_map (pixels, x2, y2);
 
   return gimp_bilinear (u, v, p);
 }
@@ -370,9 +421,6 @@ image_setup (GimpDrawable *drawable,
   width  = input_drawable->width;
   height = input_drawable->height;
 
-  gimp_pixel_rgn_init (&source_region, input_drawable,
-		       0, 0, width, height, FALSE, FALSE);
-
   maxcounter = (glong) width * (glong) height;
 
   /* Assume at least RGB */
@@ -4,14 +4,25 @@
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
-extern GimpDrawable *input_drawable,*output_drawable;
-extern GimpPixelRgn  source_region, dest_region;
+/* A drawable read into memory on the main thread. The threads */
+/* rendering the image only read these, never the drawables.   */
+
+typedef struct
+{
+  gint32    drawable_id;
+  gint      width;
+  gint      height;
+  gint      bpp;
+  gboolean  has_alpha;
+  guchar   *data;
+} ImagePixels;
 
-extern GimpDrawable *bump_drawable;
-extern GimpPixelRgn  bump_region;
+extern GimpDrawable *input_drawable,*output_drawable;
+extern GimpPixelRgn  dest_region;
 
-extern GimpDrawable *env_drawable;
-extern GimpPixelRgn  env_region;
+extern ImagePixels   source_pixels;
+extern ImagePixels   bump_pixels;
+extern ImagePixels   env_pixels;
 
 extern guchar          *preview_rgb_data;
 extern gint             preview_rgb_stride;
@@ -25,7 +36,11 @@ extern gint   border_x1,border_y1,border_x2,border_y2;
 
 extern guchar sinemap[256], spheremap[256], logmap[256];
 
-guchar         peek_map        (GimpPixelRgn *region,
+void           image_pixels_read  (ImagePixels *pixels,
+                                   gint32       drawable_id);
+void           image_pixels_clear (ImagePixels *pixels);
+
+guchar         peek_map        (ImagePixels  *pixels,
 				gint          x,
 				gint          y);
 GimpRGB         peek            (gint          x,
@@ -52,7 +67,7 @@ void           pos_to_float    (gdouble       x,
 GimpRGB         get_image_color (gdouble       u,
 				gdouble       v,
 				gint         *inside);
-gdouble        get_map_value   (GimpPixelRgn *region,
+gdouble        get_map_value   (ImagePixels  *pixels,
 				gdouble       u,
 				gdouble       v,
 				gint         *inside);
@@ -4,6 +4,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 
 #include <libgimp/gimp.h>
@@ -20,6 +22,9 @@
 
 #define LIGHT_SYMBOL_SIZE 8
 
+/* block size of the first, coarse preview pass */
+#define PREVIEW_COARSE_STEP 4
+
 static gint handle_xpos = 0, handle_ypos = 0;
 
 /* g_free()'ed on exit */
@@ -32,24 +37,139 @@ static gint ypostab_size = -1;
 static gboolean    light_hit           = FALSE;
 static gboolean    left_button_pressed = FALSE;
 static guint preview_update_timer = 0;
+static guint preview_refine_idle  = 0;
 
 
 /* Protos */
 /* ====== */
 static gboolean
 interactive_preview_timer_callback ( gpointer data );
+static gboolean
+preview_refine_callback ( gpointer data );
+
+typedef struct
+{
+  gint         startx, starty;
+  gint         w, h;
+  gint         step;
+  get_ray_func ray_func;
+  GimpRGB      lightcheck, darkcheck;
+} PreviewInfo;
+
+
+/* Render one block row of the preview, starting at row ycnt. Every */
+/* block is filled with the color of its upper left pixel.          */
 
 static void
-compute_preview (gint startx, gint starty, gint w, gint h)
+compute_preview_row (PreviewInfo *info,
+                     BumpRows    *rows,
+                     gint         ycnt)
 {
-  gint xcnt, ycnt, f1, f2;
+  gint xcnt, x, y, f1, f2;
   guchar r, g, b;
   gdouble imagex, imagey;
-  gint32 index = 0;
+  gint32 index;
   GimpRGB color;
-  GimpRGB lightcheck, darkcheck;
   GimpVector3 pos;
-  get_ray_func ray_func;
+  gint bh;
+
+  bh = MIN (info->step, PREVIEW_HEIGHT - ycnt);
+
+  if (ycnt < info->starty || ycnt >= info->starty + info->h)
+    {
+      for (y = ycnt; y < ycnt + bh; y++)
+        memset (preview_rgb_data + y * preview_rgb_stride, 200,
+                PREVIEW_WIDTH * 4);
+      return;
+    }
+
+  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
+    {
+      pos = int_to_posf (0.0, ypostab[ycnt - info->starty]);
+      pos_to_float (pos.x, pos.y, &imagex, &imagey);
+
+      precompute_start (rows, RINT (imagey));
+      precompute_normals (rows, 0, width, RINT (imagey));
+    }
+
+  for (xcnt = 0; xcnt < PREVIEW_WIDTH; xcnt += info->step)
+    {
+      gint bw = MIN (info->step, PREVIEW_WIDTH - xcnt);
+
+      if (xcnt >= info->startx && xcnt < info->startx + info->w)
+        {
+          imagex = xpostab[xcnt - info->startx];
+          imagey = ypostab[ycnt - info->starty];
+          pos = int_to_posf (imagex, imagey);
+
+          color = (* info->ray_func) (rows, &pos);
+
+          if (color.a < 1.0)
+            {
+              f1 = ((xcnt % 32) < 16);
+              f2 = ((ycnt % 32) < 16);
+              f1 = f1 ^ f2;
+
+              if (f1)
+                {
+                  if (color.a == 0.0)
+                    color = info->lightcheck;
+                  else
+                    gimp_rgb_composite (&color,
+                                        &info->lightcheck,
+                                        GIMP_RGB_COMPOSITE_BEHIND);
+                }
+              else
+                {
+                  if (color.a == 0.0)
+                    color = info->darkcheck;
+                  else
+                    gimp_rgb_composite (&color,
+                                        &info->darkcheck,
+                                        GIMP_RGB_COMPOSITE_BEHIND);
+                }
+            }
+
+          gimp_rgb_get_uchar (&color, &r, &g, &b);
+        }
+      else
+        {
+          r = g = b = 200;
+        }
+
+      for (y = ycnt; y < ycnt + bh; y++)
+        {
+          index = y * preview_rgb_stride + xcnt * 4;
+
+          for (x = 0; x < bw; x++, index += 4)
+            GIMP_CAIRO_RGB24_SET_PIXEL ((preview_rgb_data + index), r, g, b);
+        }
+    }
+}
+
+static void
+compute_preview_part (gint     i,
+                      gint     n,
+                      gpointer data)
+{
+  PreviewInfo *info     = data;
+  gint         n_blocks = (PREVIEW_HEIGHT + info->step - 1) / info->step;
+  BumpRows    *rows;
+  gint         block;
+
+  rows = bump_rows_new ();
+
+  for (block = n_blocks * i / n; block < n_blocks * (i + 1) / n; block++)
+    compute_preview_row (info, rows, block * info->step);
+
+  bump_rows_free (rows);
+}
+
+static void
+compute_preview (gint startx, gint starty, gint w, gint h, gint step)
+{
+  PreviewInfo info;
+  gint xcnt, ycnt;
 
   if (xpostab_size != w)
     {
@@ -88,105 +208,47 @@ compute_preview (gint startx, gint starty, gint w, gint h)
 
   precompute_init (width, height);
 
-  gimp_rgba_set (&lightcheck,
+  info.startx = startx;
+  info.starty = starty;
+  info.w      = w;
+  info.h      = h;
+  info.step   = step;
+
+  gimp_rgba_set (&info.lightcheck,
                  GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT,
                  1.0);
-  gimp_rgba_set (&darkcheck, GIMP_CHECK_DARK, GIMP_CHECK_DARK,
+  gimp_rgba_set (&info.darkcheck, GIMP_CHECK_DARK, GIMP_CHECK_DARK,
                  GIMP_CHECK_DARK, 1.0);
 
-  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-    {
-      gimp_pixel_rgn_init (&bump_region,
-                           gimp_drawable_get (mapvals.bumpmap_id),
-                           0, 0, width, height, FALSE, FALSE);
-    }
+  /* Read once and kept while the dialog is open */
+  image_pixels_read (&source_pixels, input_drawable->drawable_id);
 
-  imagey = 0;
+  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
+    image_pixels_read (&bump_pixels, mapvals.bumpmap_id);
 
   if (mapvals.previewquality)
-    ray_func = get_ray_color;
+    info.ray_func = get_ray_color;
   else
-    ray_func = get_ray_color_no_bilinear;
+    info.ray_func = get_ray_color_no_bilinear;
 
   if (mapvals.env_mapped == TRUE && mapvals.envmap_id != -1)
     {
-      env_width = gimp_drawable_width (mapvals.envmap_id);
-      env_height = gimp_drawable_height (mapvals.envmap_id);
+      image_pixels_read (&env_pixels, mapvals.envmap_id);
 
-      gimp_pixel_rgn_init (&env_region,
-                           gimp_drawable_get (mapvals.envmap_id), 0,
-                           0, env_width, env_height, FALSE, FALSE);
+      env_width  = env_pixels.width;
+      env_height = env_pixels.height;
 
       if (mapvals.previewquality)
-        ray_func = get_ray_color_ref;
+        info.ray_func = get_ray_color_ref;
       else
-        ray_func = get_ray_color_no_bilinear_ref;
+        info.ray_func = get_ray_color_no_bilinear_ref;
     }
 
   cairo_surface_flush (preview_surface);
 
-  for (ycnt = 0; ycnt < PREVIEW_HEIGHT; ycnt++)
-    {
-      index = ycnt * preview_rgb_stride;
-      for (xcnt = 0; xcnt < PREVIEW_WIDTH; xcnt++)
-        {
-          if ((ycnt >= starty && ycnt < (starty + h)) &&
-              (xcnt >= startx && xcnt < (startx + w)))
-            {
-              imagex = xpostab[xcnt - startx];
-              imagey = ypostab[ycnt - starty];
-              pos = int_to_posf (imagex, imagey);
-
-              if (mapvals.bump_mapped == TRUE &&
-                  mapvals.bumpmap_id != -1 &&
-                  xcnt == startx)
-                {
-                  pos_to_float (pos.x, pos.y, &imagex, &imagey);
-                  precompute_normals (0, width, RINT (imagey));
-                }
+  gimp_parallel_distribute ((PREVIEW_HEIGHT + step - 1) / step,
+                            compute_preview_part, &info);
 
-              color = (*ray_func) (&pos);
-
-              if (color.a < 1.0)
-                {
-                  f1 = ((xcnt % 32) < 16);
-                  f2 = ((ycnt % 32) < 16);
-                  f1 = f1 ^ f2;
-
-                  if (f1)
-                    {
-                      if (color.a == 0.0)
-                        color = lightcheck;
-                      else
-                        gimp_rgb_composite (&color,
-                                            &lightcheck,
-                                            GIMP_RGB_COMPOSITE_BEHIND);
-                    }
-                  else
-                    {
-                      if (color.a == 0.0)
-                        color = darkcheck;
-                      else
-                        gimp_rgb_composite (&color,
-                                            &darkcheck,
-                                            GIMP_RGB_COMPOSITE_BEHIND);
-                    }
-                }
-
-              gimp_rgb_get_uchar (&color, &r, &g, &b);
-              GIMP_CAIRO_RGB24_SET_PIXEL((preview_rgb_data + index), r, g, b);
-              index += 4;
-              imagex++;
-            }
-          else
-            {
-              preview_rgb_data[index++] = 200;
-              preview_rgb_data[index++] = 200;
-              preview_rgb_data[index++] = 200;
-              index++;
-            }
-        }
-    }
   cairo_surface_mark_dirty (preview_surface);
 }
 
@@ -391,13 +453,44 @@ preview_compute (void)
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 
-  compute_preview (startx, starty, pw, ph);
+  /* Show a coarse preview right away, the full resolution one */
+  /* is rendered once the main loop is idle again.             */
+  preview_compute_cancel ();
+
+  compute_preview (startx, starty, pw, ph, PREVIEW_COARSE_STEP);
+  preview_refine_idle = g_idle_add (preview_refine_callback, NULL);
+
   cursor = gdk_cursor_new_for_display (display, GDK_HAND2);
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
   gdk_flush ();
 }
 
+void
+preview_compute_cancel (void)
+{
+  if (preview_refine_idle != 0)
+    {
+      g_source_remove (preview_refine_idle);
+      preview_refine_idle = 0;
+    }
+}
+
+static gboolean
+preview_refine_callback (gpointer data)
+{
+  gint startx, starty, pw, ph;
+
+  compute_preview_rectangle (&startx, &starty, &pw, &ph);
+  compute_preview (startx, starty, pw, ph, 1);
+
+  gtk_widget_queue_draw (previewarea);
+
+  preview_refine_idle = 0;
+
+  return FALSE;
+}
+
 
 /******************************/
 /* Preview area event handler */
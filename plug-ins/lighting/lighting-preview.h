@@ -27,6 +27,7 @@ extern gdouble    *xpostab, *ypostab;
 /* Externally visible functions */
 
 void     preview_compute              (void);
+void     preview_compute_cancel       (void);
 void     interactive_preview_callback (GtkWidget *widget);
 gboolean preview_events               (GtkWidget *area,
                                        GdkEvent  *event);
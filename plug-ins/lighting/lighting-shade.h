@@ -1,19 +1,40 @@
 #ifndef __LIGHTING_SHADE_H__
 #define __LIGHTING_SHADE_H__
 
-typedef GimpRGB (* get_ray_func) (GimpVector3 *vector);
+/* The heights and normals of the bump map around the current row. */
+/* Each thread rendering rows of the image uses its own.           */
 
-GimpRGB get_ray_color                 (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear     (GimpVector3 *position);
-GimpRGB get_ray_color_ref             (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear_ref (GimpVector3 *position);
+typedef struct
+{
+  GimpVector3 *triangle_normals[2];
+  GimpVector3 *vertex_normals[3];
+  gdouble     *heights[3];
+} BumpRows;
 
-void    precompute_init               (gint         w,
-				       gint         h);
-void    precompute_normals            (gint         x1,
-				       gint         x2,
-				       gint         y);
-void    interpol_row                  (gint         x1,
+typedef GimpRGB (* get_ray_func) (BumpRows    *rows,
+                                  GimpVector3 *vector);
+
+GimpRGB get_ray_color                 (BumpRows    *rows,
+                                       GimpVector3 *position);
+GimpRGB get_ray_color_no_bilinear     (BumpRows    *rows,
+                                       GimpVector3 *position);
+GimpRGB get_ray_color_ref             (BumpRows    *rows,
+                                       GimpVector3 *position);
+GimpRGB get_ray_color_no_bilinear_ref (BumpRows    *rows,
+                                       GimpVector3 *position);
+
+void      precompute_init             (gint         w,
+                                       gint         h);
+BumpRows *bump_rows_new               (void);
+void      bump_rows_free              (BumpRows    *rows);
+void      precompute_start            (BumpRows    *rows,
+                                       gint         y);
+void      precompute_normals          (BumpRows    *rows,
+                                       gint         x1,
+                                       gint         x2,
+                                       gint         y);
+void      interpol_row                (BumpRows    *rows,
+                                       gint         x1,
                                        gint         x2,
                                        gint         y);
 
@@ -128,19 +128,11 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the box face images */
-        /* ============================================ */
+        /* Read the box face images */
+        /* ======================== */
 
         for (i = 0; i < 6; i++)
-          {
-            box_drawables[i] = gimp_drawable_get (mapvals.boxmap_id[i]);
-
-            gimp_pixel_rgn_init (&box_regions[i], box_drawables[i],
-                                 0, 0,
-                                 box_drawables[i]->width,
-                                 box_drawables[i]->height,
-                                 FALSE, FALSE);
-          }
+          image_pixels_read (&box_pixels[i], mapvals.boxmap_id[i]);
 
         break;
 
@@ -169,27 +161,38 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the cylinder cap images */
-        /* ================================================ */
+        /* Read the cylinder cap images */
+        /* ============================ */
 
         for (i = 0; i < 2; i++)
-          {
-            cylinder_drawables[i] =
-              gimp_drawable_get (mapvals.cylindermap_id[i]);
-
-            gimp_pixel_rgn_init (&cylinder_regions[i], cylinder_drawables[i],
-                                 0, 0,
-                                 cylinder_drawables[i]->width,
-                                 cylinder_drawables[i]->height,
-                                 FALSE, FALSE);
-          }
+          image_pixels_read (&cylinder_pixels[i], mapvals.cylindermap_id[i]);
 
         break;
     }
 
+  /* The rendering threads only read the pixels from memory, */
+  /* these stay around until compute_image() is done.        */
+  /* ======================================================= */
+
+  image_pixels_read (&source_pixels, input_drawable->drawable_id);
+
   max_depth = (gint) mapvals.maxdepth;
 }
 
+static void
+clear_pixels (void)
+{
+  gint i;
+
+  image_pixels_clear (&source_pixels);
+
+  for (i = 0; i < 6; i++)
+    image_pixels_clear (&box_pixels[i]);
+
+  for (i = 0; i < 2; i++)
+    image_pixels_clear (&cylinder_pixels[i]);
+}
+
 static void
 render (gdouble   x,
         gdouble   y,
@@ -205,13 +208,79 @@ render (gdouble   x,
   *col = get_ray_color (&pos);
 }
 
+typedef struct
+{
+  gint     x, y;
+  guchar  *dest;
+  gint     rowstride;
+  gint     bpp;
+} ComputeArea;
+
 static void
-show_progress (gint     min,
-               gint     max,
-               gint     curr,
-               gpointer data)
+put_pixel (gint      x,
+           gint      y,
+           GimpRGB  *color,
+           gpointer  data)
 {
-  gimp_progress_update ((gdouble) curr / (gdouble) max);
+  ComputeArea *area = data;
+  guchar       col[4];
+
+  gimp_rgba_get_uchar (color, &col[0], &col[1], &col[2], &col[3]);
+
+  memcpy (area->dest + (y - area->y) * area->rowstride +
+                       (x - area->x) * area->bpp,
+          col, area->bpp);
+}
+
+/* Render an area of the output on one of the worker threads. */
+/* Supersampling only uses point samples, so every area gives */
+/* the same pixels as rendering the whole image at once.      */
+
+static void
+compute_area (gint      x,
+              gint      y,
+              gint      w,
+              gint      h,
+              guchar   *dest,
+              gint      rowstride,
+              gpointer  data)
+{
+  ComputeArea  area;
+  gint         xcount, ycount;
+  GimpRGB      color;
+  GimpVector3  p;
+
+  area.x         = x;
+  area.y         = y;
+  area.dest      = dest;
+  area.rowstride = rowstride;
+  area.bpp       = GPOINTER_TO_INT (data);
+
+  if (mapvals.antialiasing == FALSE)
+    {
+      for (ycount = y; ycount < y + h; ycount++)
+        {
+          for (xcount = x; xcount < x + w; xcount++)
+            {
+              p = int_to_pos (xcount, ycount);
+              color = (* get_ray_color) (&p);
+              put_pixel (xcount, ycount, &color, &area);
+            }
+        }
+    }
+  else
+    {
+      gimp_adaptive_supersample_area (x, y,
+                                      x + w - 1, y + h - 1,
+                                      max_depth,
+                                      mapvals.pixeltreshold,
+                                      render,
+                                      NULL,
+                                      put_pixel,
+                                      &area,
+                                      NULL,
+                                      NULL);
+    }
 }
 
 /**************************************************/
@@ -222,14 +291,13 @@ show_progress (gint     min,
 void
 compute_image (void)
 {
-  gint         xcount, ycount;
-  GimpRGB      color;
-  glong        progress_counter = 0;
-  GimpVector3  p;
   gint32       new_image_id = -1;
   gint32       new_layer_id = -1;
   gboolean     insert_layer = FALSE;
 
+  /* the drawables may have changed since the preview read them */
+  clear_pixels ();
+
   init_compute ();
 
   if (mapvals.create_new_image)
@@ -284,37 +352,13 @@ compute_image (void)
         break;
     }
 
-  if (mapvals.antialiasing == FALSE)
-    {
-      for (ycount = 0; ycount < height; ycount++)
-        {
-          for (xcount = 0; xcount < width; xcount++)
-            {
-              p = int_to_pos (xcount, ycount);
-              color = (* get_ray_color) (&p);
-              poke (xcount, ycount, &color, NULL);
+  gimp_parallel_process_rgn (&dest_region, 0, 0, compute_area,
+                             GINT_TO_POINTER (dest_region.bpp));
 
-              if ((progress_counter++ % width) == 0)
-                gimp_progress_update ((gdouble) progress_counter /
-                                      (gdouble) maxcounter);
-            }
-        }
-    }
-  else
-    {
-      gimp_adaptive_supersample_area (0, 0,
-                                      width - 1, height - 1,
-                                      max_depth,
-                                      mapvals.pixeltreshold,
-                                      render,
-                                      NULL,
-                                      poke,
-                                      NULL,
-                                      show_progress,
-                                      NULL);
-    }
   gimp_progress_update (1.0);
 
+  clear_pixels ();
+
   /* Update the region */
   /* ================= */
 
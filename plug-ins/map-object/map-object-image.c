@@ -24,13 +24,12 @@
 
 
 GimpDrawable *input_drawable, *output_drawable;
-GimpPixelRgn source_region,dest_region;
+GimpPixelRgn dest_region;
 
-GimpDrawable *box_drawables[6];
-GimpPixelRgn box_regions[6];
-
-GimpDrawable *cylinder_drawables[2];
-GimpPixelRgn cylinder_regions[2];
+ImagePixels  source_pixels = { -1, };
+ImagePixels  box_pixels[6] = { { -1, }, { -1, }, { -1, },
+                               { -1, }, { -1, }, { -1, } };
+ImagePixels  cylinder_pixels[2] = { { -1, }, { -1, } };
 
 guchar          *preview_rgb_data = NULL;
 gint             preview_rgb_stride;
@@ -47,106 +46,110 @@ gint border_x, border_y, border_w, border_h;
 /* Implementation */
 /******************/
 
-GimpRGB
-peek (gint x,
-      gint y)
+/* Read the pixels of a drawable, unless they are already there. */
+/* Must be called on the main thread, before rendering starts.   */
+
+void
+image_pixels_read (ImagePixels *pixels,
+                   gint32       drawable_id)
 {
-  static guchar data[4];
+  GimpDrawable *drawable;
+  GimpPixelRgn  region;
 
-  GimpRGB color;
+  if (pixels->drawable_id == drawable_id)
+    return;
 
-  gimp_pixel_rgn_get_pixel (&source_region, data, x, y);
+  image_pixels_clear (pixels);
 
-  color.r = (gdouble) (data[0]) / 255.0;
-  color.g = (gdouble) (data[1]) / 255.0;
-  color.b = (gdouble) (data[2]) / 255.0;
+  if (drawable_id == -1)
+    return;
 
-  if (input_drawable->bpp == 4)
-    {
-      if (in_channels == 4)
-        color.a = (gdouble) (data[3]) / 255.0;
-      else
-        color.a = 1.0;
-    }
-  else
-    {
-      color.a = 1.0;
-    }
+  pixels->drawable_id = drawable_id;
 
-  return color;
-}
+  drawable = gimp_drawable_get (drawable_id);
 
-static GimpRGB
-peek_box_image (gint image,
-                gint x,
-                gint y)
-{
-  static guchar data[4];
+  if (! drawable)
+    return;
 
-  GimpRGB color;
+  pixels->width       = drawable->width;
+  pixels->height      = drawable->height;
+  pixels->bpp         = drawable->bpp;
+  pixels->has_alpha   = gimp_drawable_has_alpha (drawable_id);
+  pixels->data        = g_new (guchar, ((gsize) pixels->width *
+                                        pixels->height * pixels->bpp));
 
-  gimp_pixel_rgn_get_pixel (&box_regions[image], data, x, y);
+  gimp_pixel_rgn_init (&region, drawable,
+                       0, 0, pixels->width, pixels->height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&region, pixels->data,
+                           0, 0, pixels->width, pixels->height);
 
-  color.r = (gdouble) (data[0]) / 255.0;
-  color.g = (gdouble) (data[1]) / 255.0;
-  color.b = (gdouble) (data[2]) / 255.0;
+  gimp_drawable_detach (drawable);
+}
 
-  if (box_drawables[image]->bpp == 4)
-    {
-      if (gimp_drawable_has_alpha (box_drawables[image]->drawable_id))
-        color.a = (gdouble) (data[3]) / 255.0;
-      else
-        color.a = 1.0;
-    }
-  else
-    {
-      color.a = 1.0;
-    }
+void
+image_pixels_clear (ImagePixels *pixels)
+{
+  g_free (pixels->data);
 
-  return color;
+  pixels->drawable_id = -1;
+  pixels->width       = 0;
+  pixels->height      = 0;
+  pixels->data        = NULL;
 }
 
 static GimpRGB
-peek_cylinder_image (gint image,
-                     gint x,
-                     gint y)
+peek_pixels (const ImagePixels *pixels,
+             gint               x,
+             gint               y)
 {
-  static guchar data[4];
-
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
-  gimp_pixel_rgn_get_pixel (&cylinder_regions[image],data, x, y);
+  x = CLAMP (x, 0, pixels->width  - 1);
+  y = CLAMP (y, 0, pixels->height - 1);
 
-  color.r = (gdouble) (data[0]) / 255.0;
-  color.g = (gdouble) (data[1]) / 255.0;
-  color.b = (gdouble) (data[2]) / 255.0;
+  data = pixels->data + ((gsize) y * pixels->width + x) * pixels->bpp;
 
-  if (cylinder_drawables[image]->bpp == 4)
+  if (pixels->bpp >= 3)
     {
-      if (gimp_drawable_has_alpha (cylinder_drawables[image]->drawable_id))
-        color.a = (gdouble) (data[3]) / 255.0;
-      else
-        color.a = 1.0;
+      color.r = (gdouble) (data[0]) / 255.0;
+      color.g = (gdouble) (data[1]) / 255.0;
+      color.b = (gdouble) (data[2]) / 255.0;
     }
   else
     {
-      color.a = 1.0;
+      color.r = color.g = color.b = (gdouble) (data[0]) / 255.0;
     }
 
+  if (pixels->has_alpha)
+    color.a = (gdouble) (data[pixels->bpp - 1]) / 255.0;
+  else
+    color.a = 1.0;
+
   return color;
 }
 
-void
-poke (gint      x,
-      gint      y,
-      GimpRGB  *color,
-      gpointer  data)
+GimpRGB
+peek (gint x,
+      gint y)
 {
-  static guchar col[4];
+  return peek_pixels (&source_pixels, x, y);
+}
 
-  gimp_rgba_get_uchar (color, &col[0], &col[1], &col[2], &col[3]);
+static GimpRGB
+peek_box_image (gint image,
+                gint x,
+                gint y)
+{
+  return peek_pixels (&box_pixels[image], x, y);
+}
 
-  gimp_pixel_rgn_set_pixel (&dest_region, col, x, y);
+static GimpRGB
+peek_cylinder_image (gint image,
+                     gint x,
+                     gint y)
+{
+  return peek_pixels (&cylinder_pixels[image], x, y);
 }
 
 gint
@@ -166,8 +169,8 @@ checkbounds_box_image (gint image,
 {
   gint w, h;
 
-  w = box_drawables[image]->width;
-  h = box_drawables[image]->height;
+  w = box_pixels[image].width;
+  h = box_pixels[image].height;
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE ;
@@ -182,8 +185,8 @@ checkbounds_cylinder_image (gint image,
 {
   gint w, h;
 
-  w = cylinder_drawables[image]->width;
-  h = cylinder_drawables[image]->height;
+  w = cylinder_pixels[image].width;
+  h = cylinder_pixels[image].height;
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE;
@@ -286,8 +289,8 @@ get_box_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = box_drawables[image]->width;
-  h = box_drawables[image]->height;
+  w = box_pixels[image].width;
+  h = box_pixels[image].height;
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -318,8 +321,8 @@ get_cylinder_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = cylinder_drawables[image]->width;
-  h = cylinder_drawables[image]->height;
+  w = cylinder_pixels[image].width;
+  h = cylinder_pixels[image].height;
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -368,9 +371,6 @@ image_setup (GimpDrawable *drawable,
   width  = input_drawable->width;
   height = input_drawable->height;
 
-  gimp_pixel_rgn_init (&source_region, input_drawable,
-                       0, 0, width, height, FALSE, FALSE);
-
   maxcounter = (glong) width * (glong) height;
 
   if (mapvals.transparent_background == TRUE)
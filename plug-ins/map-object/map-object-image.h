@@ -1,17 +1,28 @@
 #ifndef __MAPOBJECT_IMAGE_H__
 #define __MAPOBJECT_IMAGE_H__
 
+/* A drawable read into memory on the main thread. The threads */
+/* rendering the image only read these, never the drawables.   */
+
+typedef struct
+{
+  gint32    drawable_id;
+  gint      width;
+  gint      height;
+  gint      bpp;
+  gboolean  has_alpha;
+  guchar   *data;
+} ImagePixels;
+
 /* Externally visible variables */
 /* ============================ */
 
 extern GimpDrawable *input_drawable, *output_drawable;
-extern GimpPixelRgn  source_region,dest_region;
-
-extern GimpDrawable *box_drawables[6];
-extern GimpPixelRgn  box_regions[6];
+extern GimpPixelRgn  dest_region;
 
-extern GimpDrawable *cylinder_drawables[2];
-extern GimpPixelRgn  cylinder_regions[2];
+extern ImagePixels   source_pixels;
+extern ImagePixels   box_pixels[6];
+extern ImagePixels   cylinder_pixels[2];
 
 extern guchar          *preview_rgb_data;
 extern gint             preview_rgb_stride;
@@ -31,6 +42,9 @@ extern GimpTile *current_in_tile, *current_out_tile;
 
 extern gint        image_setup              (GimpDrawable *drawable,
                                              gint          interactive);
+extern void        image_pixels_read        (ImagePixels  *pixels,
+                                             gint32        drawable_id);
+extern void        image_pixels_clear       (ImagePixels  *pixels);
 extern glong       in_xy_to_index           (gint          x,
                                              gint          y);
 extern glong       out_xy_to_index          (gint          x,
@@ -39,10 +53,6 @@ extern gint        checkbounds              (gint          x,
                                              gint          y);
 extern GimpRGB      peek                     (gint          x,
                                              gint          y);
-extern void        poke                     (gint          x,
-                                             gint          y,
-                                             GimpRGB      *color,
-                                             gpointer      data);
 extern GimpVector3 int_to_pos               (gint          x,
                                              gint          y);
 extern void        pos_to_int               (gdouble       x,
@@ -17,9 +17,14 @@
 #include "map-object-preview.h"
 
 
+/* block size of the first, coarse preview pass */
+#define PREVIEW_COARSE_STEP 4
+
 gdouble mat[3][4];
 gint    lightx, lighty;
 
+static guint refine_idle_id = 0;
+
 /* Protos */
 /* ====== */
 
@@ -28,7 +33,9 @@ static void compute_preview         (gint x,
                                      gint w,
                                      gint h,
                                      gint pw,
-                                     gint ph);
+                                     gint ph,
+                                     gint step);
+static gboolean refine_preview_image (gpointer data);
 static void draw_light_marker       (cairo_t *cr,
                                      gint xpos,
                                      gint ypos);
@@ -70,9 +77,91 @@ static void draw_wireframe_cylinder (cairo_t *cr,
                                      gint        pw,
                                      gint        ph);
 
+typedef struct
+{
+  gdouble *xpostab;
+  gdouble *ypostab;
+  gint     pw, ph;
+  gint     step;
+  GimpRGB  lightcheck, darkcheck;
+} PreviewInfo;
+
+/* Render the block rows of one part of the preview. Every */
+/* block is filled with the color of its upper left pixel. */
+
+static void
+compute_preview_part (gint     i,
+                      gint     n,
+                      gpointer data)
+{
+  PreviewInfo *info     = data;
+  gint         step     = info->step;
+  gint         n_blocks = (info->ph + step - 1) / step;
+  GimpVector3  p1;
+  GimpRGB      color;
+  gint         block, xcnt, ycnt, x, y, f1, f2;
+  guchar       r, g, b;
+  glong        index;
+
+  for (block = n_blocks * i / n; block < n_blocks * (i + 1) / n; block++)
+    {
+      gint bh;
+
+      ycnt = block * step;
+      bh   = MIN (step, info->ph - ycnt);
+
+      for (xcnt = 0; xcnt < info->pw; xcnt += step)
+        {
+          gint bw = MIN (step, info->pw - xcnt);
+
+          p1.x = info->xpostab[xcnt];
+          p1.y = info->ypostab[ycnt];
+          p1.z = 0.0;
+
+          color = (* get_ray_color) (&p1);
+
+          if (color.a < 1.0)
+            {
+              f1 = ((xcnt % 32) < 16);
+              f2 = ((ycnt % 32) < 16);
+              f1 = f1 ^ f2;
+
+              if (f1)
+                {
+                  if (color.a == 0.0)
+                    color = info->lightcheck;
+                  else
+                    gimp_rgb_composite (&color, &info->lightcheck,
+                                        GIMP_RGB_COMPOSITE_BEHIND);
+                 }
+              else
+                {
+                  if (color.a == 0.0)
+                    color = info->darkcheck;
+                  else
+                    gimp_rgb_composite (&color, &info->darkcheck,
+                                        GIMP_RGB_COMPOSITE_BEHIND);
+                }
+            }
+
+          gimp_rgb_get_uchar (&color, &r, &g, &b);
+
+          for (y = ycnt; y < ycnt + bh; y++)
+            {
+              index = y * preview_rgb_stride + xcnt * 4;
+
+              for (x = 0; x < bw; x++, index += 4)
+                GIMP_CAIRO_RGB24_SET_PIXEL((preview_rgb_data + index), r, g, b);
+            }
+        }
+    }
+}
+
 /**************************************************************/
 /* Computes a preview of the rectangle starting at (x,y) with */
 /* dimensions (w,h), placing the result in preview_RGB_data.  */
+/* The rows are rendered concurrently, in blocks of step by   */
+/* step pixels.                                               */
 /**************************************************************/
 
 static void
@@ -81,18 +170,16 @@ compute_preview (gint x,
                  gint w,
                  gint h,
                  gint pw,
-                 gint ph)
+                 gint ph,
+                 gint step)
 {
   gdouble      xpostab[PREVIEW_WIDTH];
   gdouble      ypostab[PREVIEW_HEIGHT];
   gdouble      realw;
   gdouble      realh;
   GimpVector3  p1, p2;
-  GimpRGB      color;
-  GimpRGB      lightcheck, darkcheck;
-  gint         xcnt, ycnt, f1, f2;
-  guchar       r, g, b;
-  glong        index = 0;
+  PreviewInfo  info;
+  gint         xcnt, ycnt;
 
   init_compute ();
 
@@ -127,54 +214,22 @@ compute_preview (gint x,
       gimp_rgb_set_alpha (&background, 1.0);
     }
 
-  gimp_rgba_set (&lightcheck,
+  info.xpostab = xpostab;
+  info.ypostab = ypostab;
+  info.pw      = pw;
+  info.ph      = ph;
+  info.step    = step;
+
+  gimp_rgba_set (&info.lightcheck,
                  GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, 1.0);
-  gimp_rgba_set (&darkcheck,
+  gimp_rgba_set (&info.darkcheck,
                  GIMP_CHECK_DARK, GIMP_CHECK_DARK, GIMP_CHECK_DARK, 1.0);
-  gimp_vector3_set (&p2, -1.0, -1.0, 0.0);
 
   cairo_surface_flush (preview_surface);
 
-  for (ycnt = 0; ycnt < ph; ycnt++)
-    {
-      index = ycnt * preview_rgb_stride;
-      for (xcnt = 0; xcnt < pw; xcnt++)
-        {
-          p1.x = xpostab[xcnt];
-          p1.y = ypostab[ycnt];
-
-          p2 = p1;
-          color = (* get_ray_color) (&p1);
-
-          if (color.a < 1.0)
-            {
-              f1 = ((xcnt % 32) < 16);
-              f2 = ((ycnt % 32) < 16);
-              f1 = f1 ^ f2;
+  gimp_parallel_distribute ((ph + step - 1) / step,
+                            compute_preview_part, &info);
 
-              if (f1)
-                {
-                  if (color.a == 0.0)
-                    color = lightcheck;
-                  else
-                    gimp_rgb_composite (&color, &lightcheck,
-                                        GIMP_RGB_COMPOSITE_BEHIND);
-                 }
-              else
-                {
-                  if (color.a == 0.0)
-                    color = darkcheck;
-                  else
-                    gimp_rgb_composite (&color, &darkcheck,
-                                        GIMP_RGB_COMPOSITE_BEHIND);
-                }
-            }
-
-          gimp_rgb_get_uchar (&color, &r, &g, &b);
-          GIMP_CAIRO_RGB24_SET_PIXEL((preview_rgb_data + index), r, g, b);
-          index += 4;
-        }
-    }
   cairo_surface_mark_dirty (preview_surface);
 }
 
@@ -294,13 +349,45 @@ compute_preview_image (void)
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 
-  compute_preview (0, 0, width - 1, height - 1, pw, ph);
+  /* Show a coarse preview right away, the full resolution one */
+  /* is rendered once the main loop is idle again.             */
+  cancel_preview_image ();
+
+  compute_preview (0, 0, width - 1, height - 1, pw, ph, PREVIEW_COARSE_STEP);
+  refine_idle_id = g_idle_add (refine_preview_image, NULL);
 
   cursor = gdk_cursor_new_for_display (display, GDK_HAND2);
   gdk_window_set_cursor(gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 }
 
+void
+cancel_preview_image (void)
+{
+  if (refine_idle_id)
+    {
+      g_source_remove (refine_idle_id);
+      refine_idle_id = 0;
+    }
+}
+
+static gboolean
+refine_preview_image (gpointer data)
+{
+  gint pw, ph;
+
+  pw = PREVIEW_WIDTH * mapvals.zoom;
+  ph = PREVIEW_HEIGHT * mapvals.zoom;
+
+  compute_preview (0, 0, width - 1, height - 1, pw, ph, 1);
+
+  gtk_widget_queue_draw (previewarea);
+
+  refine_idle_id = 0;
+
+  return FALSE;
+}
+
 gboolean
 preview_expose (GtkWidget      *widget,
                 GdkEventExpose *eevent)
@@ -111,21 +111,27 @@ plane_intersect (GimpVector3 *dir,
                  gdouble     *u,
                  gdouble     *v)
 {
-  static gdouble det, det1, det2, det3, t;
+  gdouble det, det1, det2, det3, t;
+  gdouble m[4][4];
 
-  imat[0][0] = dir->x;
-  imat[1][0] = dir->y;
-  imat[2][0] = dir->z;
+  /* Work on a copy, this is called from several threads at once */
+  /* =========================================================== */
+
+  memcpy (m, imat, sizeof (m));
+
+  m[0][0] = dir->x;
+  m[1][0] = dir->y;
+  m[2][0] = dir->z;
 
   /* Compute determinant of the first 3x3 sub matrix (denominator) */
   /* ============================================================= */
 
-  det = (imat[0][0] * imat[1][1] * imat[2][2] +
-         imat[0][1] * imat[1][2] * imat[2][0] +
-         imat[0][2] * imat[1][0] * imat[2][1] -
-         imat[0][2] * imat[1][1] * imat[2][0] -
-         imat[0][0] * imat[1][2] * imat[2][1] -
-         imat[2][2] * imat[0][1] * imat[1][0]);
+  det = (m[0][0] * m[1][1] * m[2][2] +
+         m[0][1] * m[1][2] * m[2][0] +
+         m[0][2] * m[1][0] * m[2][1] -
+         m[0][2] * m[1][1] * m[2][0] -
+         m[0][0] * m[1][2] * m[2][1] -
+         m[2][2] * m[0][1] * m[1][0]);
 
   /* If the determinant is non-zero, a intersection point exists */
   /* =========================================================== */
@@ -135,26 +141,26 @@ plane_intersect (GimpVector3 *dir,
       /* Now, lets compute the numerator determinants (wow ;) */
       /* ==================================================== */
 
-      det1 = (imat[0][3] * imat[1][1] * imat[2][2] +
-              imat[0][1] * imat[1][2] * imat[2][3] +
-              imat[0][2] * imat[1][3] * imat[2][1] -
-              imat[0][2] * imat[1][1] * imat[2][3] -
-              imat[1][2] * imat[2][1] * imat[0][3] -
-              imat[2][2] * imat[0][1] * imat[1][3]);
-
-      det2 = (imat[0][0] * imat[1][3] * imat[2][2] +
-              imat[0][3] * imat[1][2] * imat[2][0] +
-              imat[0][2] * imat[1][0] * imat[2][3] -
-              imat[0][2] * imat[1][3] * imat[2][0] -
-              imat[1][2] * imat[2][3] * imat[0][0] -
-              imat[2][2] * imat[0][3] * imat[1][0]);
-
-      det3 = (imat[0][0] * imat[1][1] * imat[2][3] +
-              imat[0][1] * imat[1][3] * imat[2][0] +
-              imat[0][3] * imat[1][0] * imat[2][1] -
-              imat[0][3] * imat[1][1] * imat[2][0] -
-              imat[1][3] * imat[2][1] * imat[0][0] -
-              imat[2][3] * imat[0][1] * imat[1][0]);
+      det1 = (m[0][3] * m[1][1] * m[2][2] +
+              m[0][1] * m[1][2] * m[2][3] +
+              m[0][2] * m[1][3] * m[2][1] -
+              m[0][2] * m[1][1] * m[2][3] -
+              m[1][2] * m[2][1] * m[0][3] -
+              m[2][2] * m[0][1] * m[1][3]);
+
+      det2 = (m[0][0] * m[1][3] * m[2][2] +
+              m[0][3] * m[1][2] * m[2][0] +
+              m[0][2] * m[1][0] * m[2][3] -
+              m[0][2] * m[1][3] * m[2][0] -
+              m[1][2] * m[2][3] * m[0][0] -
+              m[2][2] * m[0][3] * m[1][0]);
+
+      det3 = (m[0][0] * m[1][1] * m[2][3] +
+              m[0][1] * m[1][3] * m[2][0] +
+              m[0][3] * m[1][0] * m[2][1] -
+              m[0][3] * m[1][1] * m[2][0] -
+              m[1][3] * m[2][1] * m[0][0] -
+              m[2][3] * m[0][1] * m[1][0]);
 
       /* Now we have the simultaneous solutions. Lets compute the unknowns */
       /* (skip u&v if t is <0, this means the intersection is behind us)  */
@@ -167,7 +173,7 @@ plane_intersect (GimpVector3 *dir,
           *u = 1.0 + ((det2 / det) - 0.5);
           *v = 1.0 + ((det3 / det) - 0.5);
 
-                ipos->x = viewp->x + t * dir->x;
+          ipos->x = viewp->x + t * dir->x;
           ipos->y = viewp->y + t * dir->y;
           ipos->z = viewp->z + t * dir->z;
 
@@ -188,9 +194,9 @@ get_ray_color_plane (GimpVector3 *pos)
 {
   GimpRGB color = background;
 
-  static gint         inside = FALSE;
-  static GimpVector3  ray, spos;
-  static gdouble      vx, vy;
+  gint         inside = FALSE;
+  GimpVector3  ray, spos;
+  gdouble      vx, vy;
 
   /* Construct a line from our VP to the point */
   /* ========================================= */
@@ -241,8 +247,8 @@ sphere_to_image (GimpVector3 *normal,
                  gdouble     *u,
                  gdouble     *v)
 {
-  static gdouble      alpha, fac;
-  static GimpVector3  cross_prod;
+  gdouble      alpha, fac;
+  GimpVector3  cross_prod;
 
   alpha = acos (-gimp_vector3_inner_product (&mapvals.secondaxis, normal));
 
@@ -282,8 +288,8 @@ sphere_intersect (GimpVector3 *dir,
                   GimpVector3 *spos1,
                   GimpVector3 *spos2)
 {
-  static gdouble      alpha, beta, tau, s1, s2, tmp;
-  static GimpVector3  t;
+  gdouble      alpha, beta, tau, s1, s2, tmp;
+  GimpVector3  t;
 
   gimp_vector3_sub (&t, &mapvals.position, viewp);
 
@@ -328,10 +334,10 @@ get_ray_color_sphere (GimpVector3 *pos)
 {
   GimpRGB color = background;
 
-  static GimpRGB      color2;
-  static gint         inside = FALSE;
-  static GimpVector3  normal, ray, spos1, spos2;
-  static gdouble      vx, vy;
+  GimpRGB      color2;
+  gint         inside = FALSE;
+  GimpVector3  normal, ray, spos1, spos2;
+  gdouble      vx, vy;
 
   /* Check if ray is within the bounding box */
   /* ======================================= */
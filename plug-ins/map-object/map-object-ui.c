@@ -1448,6 +1448,8 @@ main_dialog (GimpDrawable *drawable)
   if (gimp_dialog_run (GIMP_DIALOG (appwin)) == GTK_RESPONSE_OK)
     run = TRUE;
 
+  cancel_preview_image ();
+
   gtk_widget_destroy (appwin);
   if (preview_rgb_data)
     g_free (preview_rgb_data);
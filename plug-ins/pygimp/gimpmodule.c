@@ -1905,6 +1905,11 @@ initgimp(void)
     if (PyType_Ready(&PyGimpPDBFunction_Type) < 0)
         return;
 
+    PyGimpPDBBatch_Type.ob_type = &PyType_Type;
+    PyGimpPDBBatch_Type.tp_alloc = PyType_GenericAlloc;
+    if (PyType_Ready(&PyGimpPDBBatch_Type) < 0)
+        return;
+
     PyGimpImage_Type.ob_type = &PyType_Type;
     PyGimpImage_Type.tp_alloc = PyType_GenericAlloc;
     PyGimpImage_Type.tp_new = PyType_GenericNew;
@@ -196,6 +196,164 @@ drw_get_pixel_rgn(PyGimpDrawable *self, PyObject *args, PyObject *kwargs)
     return pygimp_pixel_rgn_new(self, x, y, width, height, dirty, shadow);
 }
 
+/* get_rect() and set_rect() move pixels directly between the tiles and
+ * the memory of any object supporting the buffer interface, such as a
+ * numpy array, without going through intermediate strings.
+ */
+typedef struct {
+    void *data;
+    Py_ssize_t len;
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    Py_buffer view;
+    gboolean have_view;
+#endif
+} DrwBuffer;
+
+static gboolean
+drw_buffer_open(DrwBuffer *buffer, PyObject *obj, gboolean writable)
+{
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    buffer->have_view = PyObject_CheckBuffer(obj);
+
+    if (buffer->have_view) {
+	if (PyObject_GetBuffer(obj, &buffer->view,
+			       writable ? PyBUF_WRITABLE : PyBUF_SIMPLE) < 0)
+	    return FALSE;
+
+	buffer->data = buffer->view.buf;
+	buffer->len = buffer->view.len;
+
+	return TRUE;
+    }
+#endif
+
+    if (writable)
+	return PyObject_AsWriteBuffer(obj, &buffer->data, &buffer->len) == 0;
+    else
+	return PyObject_AsReadBuffer(obj, (const void **)&buffer->data,
+				     &buffer->len) == 0;
+}
+
+static void
+drw_buffer_close(DrwBuffer *buffer)
+{
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    if (buffer->have_view)
+	PyBuffer_Release(&buffer->view);
+#endif
+}
+
+static gboolean
+drw_check_rect(PyGimpDrawable *self, int x, int y, int width, int height)
+{
+    if (x < 0 || y < 0 || width < 0 || height < 0 ||
+	x + width > self->drawable->width ||
+	y + height > self->drawable->height) {
+	PyErr_Format(PyExc_ValueError,
+		     "rectangle (%d, %d) %dx%d is outside of drawable (ID %d)",
+		     x, y, width, height, self->ID);
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+static PyObject *
+drw_get_rect(PyGimpDrawable *self, PyObject *args, PyObject *kwargs)
+{
+    int x, y, width, height, shadow = 0;
+    PyObject *ret = Py_None;
+    GimpPixelRgn pr;
+    DrwBuffer buffer;
+
+    static char *kwlist[] = { "x", "y", "width", "height", "buffer", "shadow",
+			      NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+				     "iiii|Oi:get_rect", kwlist,
+				     &x, &y, &width, &height, &ret, &shadow))
+	return NULL;
+
+    ensure_drawable(self);
+
+    if (!drw_check_rect(self, x, y, width, height))
+	return NULL;
+
+    if (ret == Py_None) {
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+	ret = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)width * height *
+					    self->drawable->bpp);
+#else
+	PyErr_SetString(PyExc_TypeError, "get_rect needs a buffer to fill");
+	return NULL;
+#endif
+    } else
+	Py_INCREF(ret);
+
+    if (ret == NULL)
+	return NULL;
+
+    if (!drw_buffer_open(&buffer, ret, TRUE)) {
+	Py_DECREF(ret);
+	return NULL;
+    }
+
+    if (buffer.len != (Py_ssize_t)width * height * self->drawable->bpp) {
+	PyErr_SetString(PyExc_TypeError, "buffer is wrong length");
+	drw_buffer_close(&buffer);
+	Py_DECREF(ret);
+	return NULL;
+    }
+
+    gimp_pixel_rgn_init(&pr, self->drawable, x, y, width, height,
+			FALSE, shadow);
+    gimp_pixel_rgn_get_rect(&pr, buffer.data, x, y, width, height);
+
+    drw_buffer_close(&buffer);
+
+    return ret;
+}
+
+static PyObject *
+drw_set_rect(PyGimpDrawable *self, PyObject *args, PyObject *kwargs)
+{
+    int x, y, width, height, shadow = 0;
+    PyObject *data;
+    GimpPixelRgn pr;
+    DrwBuffer buffer;
+
+    static char *kwlist[] = { "x", "y", "width", "height", "data", "shadow",
+			      NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+				     "iiiiO|i:set_rect", kwlist,
+				     &x, &y, &width, &height, &data, &shadow))
+	return NULL;
+
+    ensure_drawable(self);
+
+    if (!drw_check_rect(self, x, y, width, height))
+	return NULL;
+
+    if (!drw_buffer_open(&buffer, data, FALSE))
+	return NULL;
+
+    if (buffer.len != (Py_ssize_t)width * height * self->drawable->bpp) {
+	PyErr_SetString(PyExc_TypeError, "buffer is wrong length");
+	drw_buffer_close(&buffer);
+	return NULL;
+    }
+
+    gimp_pixel_rgn_init(&pr, self->drawable, x, y, width, height,
+			TRUE, shadow);
+    gimp_pixel_rgn_set_rect(&pr, buffer.data, x, y, width, height);
+
+    drw_buffer_close(&buffer);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyObject *
 drw_offset(PyGimpDrawable *self, PyObject *args, PyObject *kwargs)
 {
@@ -1066,6 +1224,8 @@ static PyMethodDef drw_methods[] = {
     {"get_tile",	(PyCFunction)drw_get_tile,	METH_VARARGS | METH_KEYWORDS},
     {"get_tile2",	(PyCFunction)drw_get_tile2,	METH_VARARGS | METH_KEYWORDS},
     {"get_pixel_rgn", (PyCFunction)drw_get_pixel_rgn, METH_VARARGS | METH_KEYWORDS},
+    {"get_rect", (PyCFunction)drw_get_rect, METH_VARARGS | METH_KEYWORDS},
+    {"set_rect", (PyCFunction)drw_set_rect, METH_VARARGS | METH_KEYWORDS},
     {"get_data", (PyCFunction)drw_get_data, METH_VARARGS | METH_KEYWORDS,
      "Takes a BABL format string, returns a Python array.array object"},
     {"offset", (PyCFunction)drw_offset, METH_VARARGS | METH_KEYWORDS},
@@ -642,8 +642,15 @@ pdb_query(PyGimpPDB *self, PyObject *args)
     return ret;
 }
 
+static PyObject *
+pdb_batch(PyGimpPDB *self)
+{
+    return pygimp_pdb_batch_new();
+}
+
 static PyMethodDef pdb_methods[] = {
     {"query", (PyCFunction)pdb_query, METH_VARARGS},
+    {"batch", (PyCFunction)pdb_batch, METH_NOARGS},
     {NULL,		NULL}		/* sentinel */
 };
 
@@ -873,18 +880,16 @@ pf_repr(PyGimpPDBFunction *self)
 			       PyString_AsString(self->proc_name));
 }
 
-static PyObject *
-pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
+/* Marshals the arguments of a call of self.  The returned array is to be
+ * freed with gimp_destroy_params(), *call_params points to the parameters
+ * to pass to the procedure. */
+static GimpParam *
+pf_params_from_args(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs,
+                    GimpParam **call_params)
 {
-    GimpParam *params, *ret;
-    int nret;
-    PyObject *t = NULL, *r;
+    GimpParam *params;
     GimpRunMode run_mode = GIMP_RUN_NONINTERACTIVE;
 
-#if PG_DEBUG > 0
-    g_printerr("--- %s --- ", PyString_AsString(self->proc_name));
-#endif
-
     if (kwargs) {
         Py_ssize_t len, pos;
         PyObject *key, *val;
@@ -930,7 +935,7 @@ pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
 	pygimp_param_print(self->nparams, params);
 #endif
 
-	ret = gimp_run_procedure2(self->name, &nret, self->nparams, params);
+	*call_params = params;
     } else {
 	params = pygimp_param_from_tuple(args, self->params, self->nparams);
 
@@ -941,18 +946,18 @@ pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
 	pygimp_param_print(self->nparams, params+1);
 #endif
 
-	ret = gimp_run_procedure2(self->name, &nret, self->nparams, params + 1);
+	*call_params = params + 1;
     }
 
-    gimp_destroy_params(params, self->nparams);
+    return params;
+}
 
-    if (!ret) {
-	PyErr_SetString(pygimp_error, "no status returned");
-#if PG_DEBUG >= 1
-	g_printerr("ret == NULL\n");
-#endif
-	return NULL;
-    }
+/* Converts the return values of a procedure to a Python object, or raises
+ * an exception with the given message if the procedure failed. */
+static PyObject *
+pf_return_vals_to_object(const GimpParam *ret, int nret, const char *error)
+{
+    PyObject *t = NULL, *r;
 
     switch(ret[0].data.d_status) {
     case GIMP_PDB_SUCCESS:
@@ -960,7 +965,6 @@ pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
 	g_printerr("success\n");
 #endif
 	t = pygimp_param_to_tuple(nret-1, ret+1);
-	gimp_destroy_params(ret, nret);
 
 	if (t == NULL) {
 	    PyErr_SetString(pygimp_error, "could not make return value");
@@ -972,24 +976,21 @@ pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
 #if PG_DEBUG > 0
 	g_printerr("execution error\n");
 #endif
-        PyErr_SetString(PyExc_RuntimeError, gimp_get_pdb_error());
-	gimp_destroy_params(ret, nret);
+        PyErr_SetString(PyExc_RuntimeError, error);
 	return NULL;
 
     case GIMP_PDB_CALLING_ERROR:
 #if PG_DEBUG > 0
 	g_printerr("calling error\n");
 #endif
-        PyErr_SetString(PyExc_RuntimeError, gimp_get_pdb_error());
-	gimp_destroy_params(ret, nret);
+        PyErr_SetString(PyExc_RuntimeError, error);
 	return NULL;
 
     case GIMP_PDB_CANCEL:
 #if PG_DEBUG > 0
 	g_printerr("cancel\n");
 #endif
-        PyErr_SetString(PyExc_RuntimeError, gimp_get_pdb_error());
-	gimp_destroy_params(ret, nret);
+        PyErr_SetString(PyExc_RuntimeError, error);
 	return NULL;
 
     default:
@@ -1018,6 +1019,40 @@ pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
     return t;
 }
 
+static PyObject *
+pf_call(PyGimpPDBFunction *self, PyObject *args, PyObject *kwargs)
+{
+    GimpParam *params, *call_params, *ret;
+    int nret;
+    PyObject *r;
+
+#if PG_DEBUG > 0
+    g_printerr("--- %s --- ", PyString_AsString(self->proc_name));
+#endif
+
+    params = pf_params_from_args(self, args, kwargs, &call_params);
+
+    if (params == NULL)
+	return NULL;
+
+    ret = gimp_run_procedure2(self->name, &nret, self->nparams, call_params);
+
+    gimp_destroy_params(params, self->nparams);
+
+    if (!ret) {
+	PyErr_SetString(pygimp_error, "no status returned");
+#if PG_DEBUG >= 1
+	g_printerr("ret == NULL\n");
+#endif
+	return NULL;
+    }
+
+    r = pf_return_vals_to_object(ret, nret, gimp_get_pdb_error());
+    gimp_destroy_params(ret, nret);
+
+    return r;
+}
+
 
 PyTypeObject PyGimpPDBFunction_Type = {
     PyObject_HEAD_INIT(NULL)
@@ -1108,3 +1143,214 @@ pygimp_pdb_function_new(const char *name, const char *blurb, const char *help,
 
     return (PyObject *)self;
 }
+
+/* End of code for pdbFunc objects */
+/* -------------------------------------------------------- */
+
+/* Declarations for objects of type pdbBatch */
+
+typedef struct {
+    PyObject_HEAD
+    GimpPDBBatch *batch;
+} PyGimpPDBBatch;
+
+static PyObject *
+pb_add(PyGimpPDBBatch *self, PyObject *args, PyObject *kwargs)
+{
+    PyGimpPDBFunction *func;
+    PyObject *func_args;
+    GimpParam *params, *call_params;
+    int index;
+
+    if (PyTuple_Size(args) < 1 ||
+        !pygimp_pdb_function_check(PyTuple_GetItem(args, 0))) {
+	PyErr_SetString(PyExc_TypeError,
+			"first argument must be a PDB function");
+	return NULL;
+    }
+
+    func = (PyGimpPDBFunction *)PyTuple_GetItem(args, 0);
+
+    func_args = PyTuple_GetSlice(args, 1, PyTuple_Size(args));
+    if (func_args == NULL)
+	return NULL;
+
+    params = pf_params_from_args(func, func_args, kwargs, &call_params);
+    Py_DECREF(func_args);
+
+    if (params == NULL)
+	return NULL;
+
+    index = gimp_pdb_batch_add(self->batch, func->name, func->nparams,
+			       call_params);
+
+    gimp_destroy_params(params, func->nparams);
+
+    return PyInt_FromLong(index);
+}
+
+static PyObject *
+pb_send(PyGimpPDBBatch *self)
+{
+    gimp_pdb_batch_send(self->batch);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+pb_get_result(PyGimpPDBBatch *self, int index)
+{
+    const GimpParam *ret;
+    int nret;
+
+    ret = gimp_pdb_batch_get_return_vals(self->batch, index, &nret);
+
+    if (nret < 1) {
+	PyErr_SetString(pygimp_error, "no status returned");
+	return NULL;
+    }
+
+    return pf_return_vals_to_object(ret, nret,
+				    nret > 1 && ret[1].type == GIMP_PDB_STRING ?
+				    ret[1].data.d_string : "procedure failed");
+}
+
+static PyObject *
+pb_result(PyGimpPDBBatch *self, PyObject *args)
+{
+    int index;
+
+    if (!PyArg_ParseTuple(args, "i:result", &index))
+	return NULL;
+
+    if (index < 0 || index >= gimp_pdb_batch_get_n_calls(self->batch)) {
+	PyErr_SetString(PyExc_IndexError, "call index out of range");
+	return NULL;
+    }
+
+    return pb_get_result(self, index);
+}
+
+static PyObject *
+pb_run(PyGimpPDBBatch *self)
+{
+    PyObject *ret;
+    int n_calls, i;
+
+    gimp_pdb_batch_run(self->batch);
+
+    n_calls = gimp_pdb_batch_get_n_calls(self->batch);
+
+    ret = PyList_New(n_calls);
+
+    for (i = 0; i < n_calls; i++) {
+	PyObject *r = pb_get_result(self, i);
+
+	if (r == NULL) {
+	    Py_DECREF(ret);
+	    return NULL;
+	}
+
+	PyList_SetItem(ret, i, r);
+    }
+
+    return ret;
+}
+
+static PyMethodDef pb_methods[] = {
+    {"add",	(PyCFunction)pb_add,	METH_VARARGS | METH_KEYWORDS},
+    {"send",	(PyCFunction)pb_send,	METH_NOARGS},
+    {"run",	(PyCFunction)pb_run,	METH_NOARGS},
+    {"result",	(PyCFunction)pb_result,	METH_VARARGS},
+    {NULL,		NULL}		/* sentinel */
+};
+
+PyObject *
+pygimp_pdb_batch_new(void)
+{
+    PyGimpPDBBatch *self = PyObject_NEW(PyGimpPDBBatch, &PyGimpPDBBatch_Type);
+
+    if (self == NULL)
+	return NULL;
+
+    self->batch = gimp_pdb_batch_new();
+
+    return (PyObject *)self;
+}
+
+static void
+pb_dealloc(PyGimpPDBBatch *self)
+{
+    /* calls added since the last send() or run() still get to run */
+    gimp_pdb_batch_send(self->batch);
+    gimp_pdb_batch_free(self->batch);
+
+    PyObject_DEL(self);
+}
+
+static PyObject *
+pb_repr(PyGimpPDBBatch *self)
+{
+    return PyString_FromFormat("<pdb batch of %d calls>",
+			       gimp_pdb_batch_get_n_calls(self->batch));
+}
+
+static Py_ssize_t
+pb_length(PyGimpPDBBatch *self)
+{
+    return gimp_pdb_batch_get_n_calls(self->batch);
+}
+
+static PySequenceMethods pb_as_sequence = {
+    (lenfunc)pb_length,			/* sq_length */
+    (binaryfunc)0,			/* sq_concat */
+    (ssizeargfunc)0,			/* sq_repeat */
+    (ssizeargfunc)0,			/* sq_item */
+    (ssizessizeargfunc)0,		/* sq_slice */
+    (ssizeobjargproc)0,			/* sq_ass_item */
+    (ssizessizeobjargproc)0,		/* sq_ass_slice */
+};
+
+PyTypeObject PyGimpPDBBatch_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "gimp.PDBBatch",                    /* tp_name */
+    sizeof(PyGimpPDBBatch),             /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    /* methods */
+    (destructor)pb_dealloc,             /* tp_dealloc */
+    (printfunc)0,                       /* tp_print */
+    (getattrfunc)0,                     /* tp_getattr */
+    (setattrfunc)0,                     /* tp_setattr */
+    (cmpfunc)0,                         /* tp_compare */
+    (reprfunc)pb_repr,                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    &pb_as_sequence,                    /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    (hashfunc)0,                        /* tp_hash */
+    (ternaryfunc)0,                     /* tp_call */
+    (reprfunc)0,                        /* tp_str */
+    (getattrofunc)0,                    /* tp_getattro */
+    (setattrofunc)0,                    /* tp_setattro */
+    0,					/* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,	                /* tp_flags */
+    NULL, /* Documentation string */
+    (traverseproc)0,			/* tp_traverse */
+    (inquiry)0,				/* tp_clear */
+    (richcmpfunc)0,			/* tp_richcompare */
+    0,					/* tp_weaklistoffset */
+    (getiterfunc)0,			/* tp_iter */
+    (iternextfunc)0,			/* tp_iternext */
+    pb_methods,				/* tp_methods */
+    0,					/* tp_members */
+    0,					/* tp_getset */
+    (PyTypeObject *)0,			/* tp_base */
+    (PyObject *)0,			/* tp_dict */
+    0,					/* tp_descr_get */
+    0,					/* tp_descr_set */
+    0,					/* tp_dictoffset */
+    (initproc)0,	                /* tp_init */
+    (allocfunc)0,			/* tp_alloc */
+    (newfunc)0,				/* tp_new */
+};
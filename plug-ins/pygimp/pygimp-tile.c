@@ -29,6 +29,12 @@
 
 #include <structmember.h>
 
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+#define PYGIMP_TPFLAGS_BUFFER Py_TPFLAGS_HAVE_NEWBUFFER
+#else
+#define PYGIMP_TPFLAGS_BUFFER 0
+#endif
+
 static PyObject *
 tile_flush(PyGimpTile *self, PyObject *args)
 {
@@ -67,6 +73,8 @@ pygimp_tile_new(GimpTile *t, PyGimpDrawable *drw)
     Py_INCREF(drw);
     self->drawable = drw;
 
+    self->mapped = FALSE;
+
     return (PyObject *)self;
 }
 
@@ -74,7 +82,8 @@ pygimp_tile_new(GimpTile *t, PyGimpDrawable *drw)
 static void
 tile_dealloc(PyGimpTile *self)
 {
-    gimp_tile_unref(self->tile, FALSE);
+    /* changes made through a buffer may not have been flushed yet */
+    gimp_tile_unref(self->tile, self->mapped);
 
     Py_DECREF(self->drawable);
     PyObject_DEL(self);
@@ -254,6 +263,80 @@ static PyMappingMethods tile_as_mapping = {
     (objobjargproc)tile_ass_sub, /*ass_sub*/
 };
 
+/* Code to access tile objects as buffers */
+
+static Py_ssize_t
+tile_getreadbuffer(PyGimpTile *self, Py_ssize_t segment, void **ptr)
+{
+    GimpTile *tile = self->tile;
+
+    if (segment != 0) {
+	PyErr_SetString(PyExc_SystemError,
+			"accessing non-existent tile segment");
+	return -1;
+    }
+
+    *ptr = tile->data;
+
+    return (Py_ssize_t)tile->ewidth * tile->eheight * tile->bpp;
+}
+
+static Py_ssize_t
+tile_getwritebuffer(PyGimpTile *self, Py_ssize_t segment, void **ptr)
+{
+    Py_ssize_t len = tile_getreadbuffer(self, segment, ptr);
+
+    if (len >= 0) {
+	self->tile->dirty = TRUE;
+	self->mapped = TRUE;
+    }
+
+    return len;
+}
+
+static Py_ssize_t
+tile_getsegcount(PyGimpTile *self, Py_ssize_t *lenp)
+{
+    GimpTile *tile = self->tile;
+
+    if (lenp)
+	*lenp = (Py_ssize_t)tile->ewidth * tile->eheight * tile->bpp;
+
+    return 1;
+}
+
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+static int
+tile_getbuffer(PyGimpTile *self, Py_buffer *view, int flags)
+{
+    GimpTile *tile = self->tile;
+    gboolean writable = (flags & PyBUF_WRITABLE) == PyBUF_WRITABLE;
+
+    if (PyBuffer_FillInfo(view, (PyObject *)self, tile->data,
+			  (Py_ssize_t)tile->ewidth * tile->eheight * tile->bpp,
+			  !writable, flags) < 0)
+	return -1;
+
+    if (writable) {
+	tile->dirty = TRUE;
+	self->mapped = TRUE;
+    }
+
+    return 0;
+}
+#endif
+
+static PyBufferProcs tile_as_buffer = {
+    (readbufferproc)tile_getreadbuffer,		/* bf_getreadbuffer */
+    (writebufferproc)tile_getwritebuffer,	/* bf_getwritebuffer */
+    (segcountproc)tile_getsegcount,		/* bf_getsegcount */
+    (charbufferproc)tile_getreadbuffer,		/* bf_getcharbuffer */
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    (getbufferproc)tile_getbuffer,		/* bf_getbuffer */
+    (releasebufferproc)0,			/* bf_releasebuffer */
+#endif
+};
+
 PyTypeObject PyGimpTile_Type = {
     PyObject_HEAD_INIT(NULL)
     0,                                  /* ob_size */
@@ -275,8 +358,8 @@ PyTypeObject PyGimpTile_Type = {
     (reprfunc)0,                        /* tp_str */
     (getattrofunc)0,                    /* tp_getattro */
     (setattrofunc)0,                    /* tp_setattro */
-    0,					/* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,	                /* tp_flags */
+    &tile_as_buffer,			/* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | PYGIMP_TPFLAGS_BUFFER, /* tp_flags */
     NULL, /* Documentation string */
     (traverseproc)0,			/* tp_traverse */
     (inquiry)0,				/* tp_clear */
@@ -300,6 +383,83 @@ PyTypeObject PyGimpTile_Type = {
 /* End of code for Tile objects */
 /* -------------------------------------------------------- */
 
+/* A pixel region spans several tiles, so its buffer is a single copy
+ * of the whole region.  It is read on first use and written back when
+ * the last writable view is released, on flush() or when the region is
+ * deleted.  The old buffer interface has no release, so views handed
+ * out through it count as alive for as long as the region.
+ */
+static guchar *
+pr_data_get(PyGimpPixelRgn *self)
+{
+    GimpPixelRgn *pr = &(self->pr);
+
+    if (self->data == NULL) {
+	self->data = g_try_malloc(MAX((gsize)pr->w * pr->h * pr->bpp, 1));
+
+	if (self->data == NULL) {
+	    PyErr_NoMemory();
+	    return NULL;
+	}
+
+	gimp_pixel_rgn_get_rect(pr, self->data, pr->x, pr->y, pr->w, pr->h);
+    }
+
+    return self->data;
+}
+
+static void
+pr_data_flush(PyGimpPixelRgn *self)
+{
+    GimpPixelRgn *pr = &(self->pr);
+
+    if (self->data && self->data_dirty) {
+	gimp_pixel_rgn_set_rect(pr, self->data, pr->x, pr->y, pr->w, pr->h);
+
+	self->data_dirty = self->writers > 0;
+    }
+}
+
+/* Subscripts go through the buffer while it exists, so both stay in
+ * sync.
+ */
+static gboolean
+pr_data_fetch(PyGimpPixelRgn *self, guchar *dest, int x, int y, int w, int h)
+{
+    GimpPixelRgn *pr = &(self->pr);
+    gsize rowstride = (gsize)pr->w * pr->bpp;
+    gsize len = (gsize)w * pr->bpp;
+    const guchar *src;
+
+    if (self->data == NULL)
+	return FALSE;
+
+    src = self->data + (y - pr->y) * rowstride + (x - pr->x) * pr->bpp;
+
+    for (; h > 0; h--, src += rowstride, dest += len)
+	memcpy(dest, src, len);
+
+    return TRUE;
+}
+
+static void
+pr_data_store(PyGimpPixelRgn *self, const guchar *src,
+	      int x, int y, int w, int h)
+{
+    GimpPixelRgn *pr = &(self->pr);
+    gsize rowstride = (gsize)pr->w * pr->bpp;
+    gsize len = (gsize)w * pr->bpp;
+    guchar *dest;
+
+    if (self->data == NULL)
+	return;
+
+    dest = self->data + (y - pr->y) * rowstride + (x - pr->x) * pr->bpp;
+
+    for (; h > 0; h--, src += len, dest += rowstride)
+	memcpy(dest, src, len);
+}
+
 
 static PyObject *
 pr_resize(PyGimpPixelRgn *self, PyObject *args)
@@ -309,6 +469,16 @@ pr_resize(PyGimpPixelRgn *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "iiii:resize", &x, &y, &w, &h))
 	return NULL;
 
+    if (self->exports > 0) {
+	PyErr_SetString(pygimp_error,
+			"can't resize a pixel region used as a buffer");
+	return NULL;
+    }
+
+    pr_data_flush(self);
+    g_free(self->data);
+    self->data = NULL;
+
     gimp_pixel_rgn_resize(&(self->pr), x, y, w, h);
 
     Py_INCREF(Py_None);
@@ -317,8 +487,19 @@ pr_resize(PyGimpPixelRgn *self, PyObject *args)
 
 
 
+static PyObject *
+pr_flush(PyGimpPixelRgn *self)
+{
+    pr_data_flush(self);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+
 static PyMethodDef pr_methods[] = {
     {"resize",	(PyCFunction)pr_resize,	METH_VARARGS},
+    {"flush",	(PyCFunction)pr_flush,	METH_NOARGS},
 
     {NULL,		NULL}		/* sentinel */
 };
@@ -357,6 +538,11 @@ pygimp_pixel_rgn_new(PyGimpDrawable *drawable, int x, int y,
     self->drawable = drawable;
     Py_INCREF(drawable);
 
+    self->data = NULL;
+    self->data_dirty = FALSE;
+    self->writers = 0;
+    self->exports = 0;
+
     return (PyObject *)self;
 }
 
@@ -364,6 +550,9 @@ pygimp_pixel_rgn_new(PyGimpDrawable *drawable, int x, int y,
 static void
 pr_dealloc(PyGimpPixelRgn *self)
 {
+    pr_data_flush(self);
+    g_free(self->data);
+
     Py_DECREF(self->drawable);
     PyObject_DEL(self);
 }
@@ -410,8 +599,10 @@ pr_subscript(PyGimpPixelRgn *self, PyObject *key)
             }
 
             ret = PyString_FromStringAndSize(NULL, pr->bpp);
-            gimp_pixel_rgn_get_pixel(pr, (guchar*)PyString_AS_STRING(ret),
-                                     x1, y1);
+            if (!pr_data_fetch(self, (guchar*)PyString_AS_STRING(ret),
+                               x1, y1, 1, 1))
+                gimp_pixel_rgn_get_pixel(pr, (guchar*)PyString_AS_STRING(ret),
+                                         x1, y1);
 
         } else if (PySlice_Check(y)) {
             if (PySlice_GetIndices((PySliceObject*)y, pr->y + pr->h,
@@ -430,8 +621,10 @@ pr_subscript(PyGimpPixelRgn *self, PyObject *key)
             }
 
             ret = PyString_FromStringAndSize(NULL, pr->bpp * (y2 - y1));
-            gimp_pixel_rgn_get_col(pr, (guchar*)PyString_AS_STRING(ret),
-                                   x1, y1, y2-y1);
+            if (!pr_data_fetch(self, (guchar*)PyString_AS_STRING(ret),
+                               x1, y1, 1, y2 - y1))
+                gimp_pixel_rgn_get_col(pr, (guchar*)PyString_AS_STRING(ret),
+                                       x1, y1, y2-y1);
 	    }
         else {
             PyErr_SetString(PyExc_TypeError, "invalid y subscript");
@@ -458,8 +651,10 @@ pr_subscript(PyGimpPixelRgn *self, PyObject *key)
                 return NULL;
             }
             ret = PyString_FromStringAndSize(NULL, pr->bpp * (x2 - x1));
-            gimp_pixel_rgn_get_row(pr, (guchar*)PyString_AS_STRING(ret),
-                                   x1, y1, x2 - x1);
+            if (!pr_data_fetch(self, (guchar*)PyString_AS_STRING(ret),
+                               x1, y1, x2 - x1, 1))
+                gimp_pixel_rgn_get_row(pr, (guchar*)PyString_AS_STRING(ret),
+                                       x1, y1, x2 - x1);
 
         } else if (PySlice_Check(y)) {
             if (PySlice_GetIndices((PySliceObject*)y, pr->y + pr->h,
@@ -478,8 +673,10 @@ pr_subscript(PyGimpPixelRgn *self, PyObject *key)
 
             ret = PyString_FromStringAndSize(NULL,
                                              pr->bpp * (x2 - x1) * (y2 - y1));
-            gimp_pixel_rgn_get_rect(pr, (guchar*)PyString_AS_STRING(ret),
-                                    x1, y1, x2 - x1, y2 - y1);
+            if (!pr_data_fetch(self, (guchar*)PyString_AS_STRING(ret),
+                               x1, y1, x2 - x1, y2 - y1))
+                gimp_pixel_rgn_get_rect(pr, (guchar*)PyString_AS_STRING(ret),
+                                        x1, y1, x2 - x1, y2 - y1);
 	    }
         else {
             PyErr_SetString(PyExc_TypeError, "invalid y subscript");
@@ -545,6 +742,7 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
                 return -1;
             }
             gimp_pixel_rgn_set_pixel(pr, buf, x1, y1);
+            pr_data_store(self, buf, x1, y1, 1, 1);
 
         } else if (PySlice_Check(y)) {
             if (PySlice_GetIndices((PySliceObject *)y, pr->y + pr->h,
@@ -565,6 +763,7 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
                 return -1;
             }
             gimp_pixel_rgn_set_col(pr, buf, x1, y1, y2 - y1);
+            pr_data_store(self, buf, x1, y1, 1, y2 - y1);
 
         } else {
             PyErr_SetString(PyExc_IndexError,"invalid y subscript");
@@ -598,6 +797,7 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
                 return -1;
             }
             gimp_pixel_rgn_set_row(pr, buf, x1, y1, x2 - x1);
+            pr_data_store(self, buf, x1, y1, x2 - x1, 1);
 
         } else if (PySlice_Check(y)) {
             if (PySlice_GetIndices((PySliceObject *)y, pr->y + pr->h,
@@ -618,6 +818,7 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
                 return -1;
             }
             gimp_pixel_rgn_set_rect(pr, buf, x1, y1, x2 - x1, y2 - y1);
+            pr_data_store(self, buf, x1, y1, x2 - x1, y2 - y1);
 
         } else {
             PyErr_SetString(PyExc_IndexError,"invalid y subscript");
@@ -636,6 +837,106 @@ static PyMappingMethods pr_as_mapping = {
     (objobjargproc)pr_ass_sub,	/*mp_ass_subscript*/
 };
 
+/* Code to access pr objects as buffers */
+
+static Py_ssize_t
+pr_getreadbuffer(PyGimpPixelRgn *self, Py_ssize_t segment, void **ptr)
+{
+    GimpPixelRgn *pr = &(self->pr);
+
+    if (segment != 0) {
+	PyErr_SetString(PyExc_SystemError,
+			"accessing non-existent pixel region segment");
+	return -1;
+    }
+
+    if ((*ptr = pr_data_get(self)) == NULL)
+	return -1;
+
+    self->exports = MAX(self->exports, 1);
+
+    return (Py_ssize_t)pr->w * pr->h * pr->bpp;
+}
+
+static Py_ssize_t
+pr_getwritebuffer(PyGimpPixelRgn *self, Py_ssize_t segment, void **ptr)
+{
+    Py_ssize_t len;
+
+    if (!self->pr.dirty) {
+	PyErr_SetString(PyExc_TypeError, "pixel region is read-only");
+	return -1;
+    }
+
+    len = pr_getreadbuffer(self, segment, ptr);
+
+    if (len >= 0) {
+	self->writers = MAX(self->writers, 1);
+	self->data_dirty = TRUE;
+    }
+
+    return len;
+}
+
+static Py_ssize_t
+pr_getsegcount(PyGimpPixelRgn *self, Py_ssize_t *lenp)
+{
+    GimpPixelRgn *pr = &(self->pr);
+
+    if (lenp)
+	*lenp = (Py_ssize_t)pr->w * pr->h * pr->bpp;
+
+    return 1;
+}
+
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+static int
+pr_getbuffer(PyGimpPixelRgn *self, Py_buffer *view, int flags)
+{
+    GimpPixelRgn *pr = &(self->pr);
+    guchar *data;
+
+    if ((data = pr_data_get(self)) == NULL) {
+	view->obj = NULL;
+	return -1;
+    }
+
+    if (PyBuffer_FillInfo(view, (PyObject *)self, data,
+			  (Py_ssize_t)pr->w * pr->h * pr->bpp,
+			  !pr->dirty, flags) < 0)
+	return -1;
+
+    self->exports++;
+
+    if (!view->readonly) {
+	self->writers++;
+	self->data_dirty = TRUE;
+    }
+
+    return 0;
+}
+
+static void
+pr_releasebuffer(PyGimpPixelRgn *self, Py_buffer *view)
+{
+    self->exports--;
+
+    if (!view->readonly && --self->writers == 0)
+	pr_data_flush(self);
+}
+#endif
+
+static PyBufferProcs pr_as_buffer = {
+    (readbufferproc)pr_getreadbuffer,		/* bf_getreadbuffer */
+    (writebufferproc)pr_getwritebuffer,		/* bf_getwritebuffer */
+    (segcountproc)pr_getsegcount,		/* bf_getsegcount */
+    (charbufferproc)pr_getreadbuffer,		/* bf_getcharbuffer */
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    (getbufferproc)pr_getbuffer,		/* bf_getbuffer */
+    (releasebufferproc)pr_releasebuffer,	/* bf_releasebuffer */
+#endif
+};
+
 /* -------------------------------------------------------- */
 
 static PyObject *
@@ -719,8 +1020,8 @@ PyTypeObject PyGimpPixelRgn_Type = {
     (reprfunc)0,                        /* tp_str */
     (getattrofunc)0,                    /* tp_getattro */
     (setattrofunc)0,                    /* tp_setattro */
-    0,					/* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,	                /* tp_flags */
+    &pr_as_buffer,			/* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | PYGIMP_TPFLAGS_BUFFER, /* tp_flags */
     NULL, /* Documentation string */
     (traverseproc)0,			/* tp_traverse */
     (inquiry)0,				/* tp_clear */
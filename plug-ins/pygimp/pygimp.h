@@ -56,6 +56,10 @@ PyObject *pygimp_pdb_function_new(const char *name, const char *blurb,
                                   GimpParamDef *params,
                                   GimpParamDef *return_vals);
 
+extern PyTypeObject PyGimpPDBBatch_Type;
+#define pygimp_pdb_batch_check(v) (PyObject_TypeCheck(v, &PyGimpPDBBatch_Type))
+PyObject *pygimp_pdb_batch_new(void);
+
 extern PyTypeObject PyGimpImage_Type;
 #define pygimp_image_check(v) (PyObject_TypeCheck(v, &PyGimpImage_Type))
 PyObject *pygimp_image_new(gint32 ID);
@@ -88,6 +92,7 @@ typedef struct {
     PyObject_HEAD
     GimpTile *tile;
     PyGimpDrawable *drawable; /* we keep a reference to the drawable */
+    gboolean mapped; /* handed out as a writable buffer */
 } PyGimpTile;
 
 extern PyTypeObject PyGimpTile_Type;
@@ -98,6 +103,10 @@ typedef struct {
     PyObject_HEAD
     GimpPixelRgn pr;
     PyGimpDrawable *drawable; /* keep the drawable around */
+    guchar *data;       /* copy of the region exported as a buffer */
+    gboolean data_dirty;
+    int writers;        /* writable buffer views still alive */
+    int exports;        /* buffer views still alive */
 } PyGimpPixelRgn;
 
 extern PyTypeObject PyGimpPixelRgn_Type;
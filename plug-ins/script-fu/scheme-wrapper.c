@@ -49,6 +49,24 @@
 
 #undef cons
 
+typedef struct
+{
+  GimpPDBProcType  proc_type;
+  gint             nparams;
+  gint             nreturn_vals;
+  GimpParamDef    *params;
+  GimpParamDef    *return_vals;
+} ProcInfo;
+
+typedef struct
+{
+  GimpPDBBatch *batch;
+  gint          depth;
+  GPtrArray    *names;
+  GHashTable   *procs;
+} BatchState;
+
+
 static void     ts_init_constants                (scheme    *sc);
 static void     ts_init_enum                     (scheme    *sc,
                                                   GType      enum_type);
@@ -66,6 +84,17 @@ static pointer  script_fu_menu_register_call     (scheme    *sc,
                                                   pointer    a);
 static pointer  script_fu_quit_call              (scheme    *sc,
                                                   pointer    a);
+static void     script_fu_proc_info_free         (ProcInfo  *proc_info);
+static pointer  script_fu_batch_begin_call       (scheme    *sc,
+                                                  pointer    a);
+static pointer  script_fu_batch_end_call         (scheme    *sc,
+                                                  pointer    a);
+static gboolean script_fu_batch_flush            (gchar     *error_str,
+                                                  gsize      error_len);
+static gboolean script_fu_batch_end              (gchar     *error_str,
+                                                  gsize      error_len);
+static void     script_fu_batch_suspend          (BatchState *state);
+static void     script_fu_batch_resume           (BatchState *state);
 static pointer  script_fu_nil_call               (scheme    *sc,
                                                   pointer    a);
 
@@ -130,6 +159,17 @@ static const NamedConstant script_constants[] =
 
 static scheme sc;
 
+/*  Between gimp-batch-begin and gimp-batch-end, calls of procedures
+ *  without return values are queued in ts_batch and sent to GIMP in
+ *  chunks instead of waiting for each of them, except for temporary
+ *  procedures, which run the queue first.  Procedure information is
+ *  looked up only once per batch.
+ */
+static GimpPDBBatch *ts_batch       = NULL;
+static gint          ts_batch_depth = 0;
+static GPtrArray    *ts_batch_names = NULL;
+static GHashTable   *ts_batch_procs = NULL;
+
 
 void
 tinyscheme_init (GList    *path,
@@ -232,6 +272,12 @@ ts_interpret_string (const gchar *expr)
 
   sc.vptr->load_string (&sc, (char *) expr);
 
+  /*  don't lose the queued calls of a script that stopped before
+   *  gimp-batch-end
+   */
+  if (ts_batch)
+    script_fu_batch_end (NULL, 0);
+
   return sc.retcode;
 }
 
@@ -429,6 +475,16 @@ ts_init_procedures (scheme   *sc,
                            sc->vptr->mk_foreign_func (sc, script_fu_quit_call));
   sc->vptr->setimmutable (symbol);
 
+  symbol = sc->vptr->mk_symbol (sc, "gimp-batch-begin");
+  sc->vptr->scheme_define (sc, sc->global_env, symbol,
+                           sc->vptr->mk_foreign_func (sc, script_fu_batch_begin_call));
+  sc->vptr->setimmutable (symbol);
+
+  symbol = sc->vptr->mk_symbol (sc, "gimp-batch-end");
+  sc->vptr->scheme_define (sc, sc->global_env, symbol,
+                           sc->vptr->mk_foreign_func (sc, script_fu_batch_end_call));
+  sc->vptr->setimmutable (symbol);
+
   /*  register the database execution procedure  */
   symbol = sc->vptr->mk_symbol (sc, "gimp-proc-db-call");
   sc->vptr->scheme_define (sc, sc->global_env, symbol,
@@ -555,6 +611,7 @@ script_fu_marshal_procedure_call (scheme  *sc,
   gint             nreturn_vals;
   GimpParamDef    *params;
   GimpParamDef    *return_vals;
+  ProcInfo        *proc_info = NULL;
   gchar            error_str[1024];
   gint             i;
   gint             success = TRUE;
@@ -599,16 +656,36 @@ script_fu_marshal_procedure_call (scheme  *sc,
   /*  report the current command  */
   script_fu_interface_report_cc (proc_name);
 
-  /*  Attempt to fetch the procedure from the database  */
-  if (! gimp_procedural_db_proc_info (proc_name,
-                                      &proc_blurb,
-                                      &proc_help,
-                                      &proc_author,
-                                      &proc_copyright,
-                                      &proc_date,
-                                      &proc_type,
-                                      &nparams, &nreturn_vals,
-                                      &params, &return_vals))
+  /*  Attempt to fetch the procedure from the ones already looked up
+   *  in the current batch, or else from the database
+   */
+  if (ts_batch)
+    proc_info = g_hash_table_lookup (ts_batch_procs, proc_name);
+
+  if (proc_info)
+    {
+      proc_blurb     = NULL;
+      proc_help      = NULL;
+      proc_author    = NULL;
+      proc_copyright = NULL;
+      proc_date      = NULL;
+      proc_type      = proc_info->proc_type;
+      nparams        = proc_info->nparams;
+      nreturn_vals   = proc_info->nreturn_vals;
+      params         = g_memdup (proc_info->params,
+                                 nparams * sizeof (GimpParamDef));
+      return_vals    = g_memdup (proc_info->return_vals,
+                                 nreturn_vals * sizeof (GimpParamDef));
+    }
+  else if (! gimp_procedural_db_proc_info (proc_name,
+                                           &proc_blurb,
+                                           &proc_help,
+                                           &proc_author,
+                                           &proc_copyright,
+                                           &proc_date,
+                                           &proc_type,
+                                           &nparams, &nreturn_vals,
+                                           &params, &return_vals))
     {
 #ifdef DEBUG_MARSHALL
       g_printerr ("  Invalid procedure name\n");
@@ -630,6 +707,32 @@ script_fu_marshal_procedure_call (scheme  *sc,
       g_free (return_vals[i].description);
     }
 
+  if (ts_batch && ! proc_info)
+    {
+      proc_info = g_slice_new (ProcInfo);
+
+      proc_info->proc_type    = proc_type;
+      proc_info->nparams      = nparams;
+      proc_info->nreturn_vals = nreturn_vals;
+      proc_info->params       = g_memdup (params,
+                                          nparams * sizeof (GimpParamDef));
+      proc_info->return_vals  = g_memdup (return_vals,
+                                          nreturn_vals * sizeof (GimpParamDef));
+
+      for (i = 0; i < nparams; i++)
+        {
+          proc_info->params[i].name        = NULL;
+          proc_info->params[i].description = NULL;
+        }
+      for (i = 0; i < nreturn_vals; i++)
+        {
+          proc_info->return_vals[i].name        = NULL;
+          proc_info->return_vals[i].description = NULL;
+        }
+
+      g_hash_table_insert (ts_batch_procs, g_strdup (proc_name), proc_info);
+    }
+
   /*  Check the supplied number of arguments  */
   if ((sc->vptr->list_length (sc, a) - 1) != nparams)
     {
@@ -1210,13 +1313,47 @@ script_fu_marshal_procedure_call (scheme  *sc,
        */
       if (strcmp (proc_name, "script-fu-refresh-scripts"))
         {
+          if (ts_batch && nreturn_vals == 0 &&
+              proc_type != GIMP_TEMPORARY)
+            {
+              /*  nothing waits for the call, so queue it; its status
+               *  is checked when the batch is run.  temporary
+               *  procedures, like other scripts, are never queued:
+               *  they run in this very interpreter and would make
+               *  their own calls while GIMP is still busy with the
+               *  queue.
+               */
+              gimp_pdb_batch_add (ts_batch, proc_name, nparams, args);
+              g_ptr_array_add (ts_batch_names, g_strdup (proc_name));
+
+              nvalues = 1;
+              values  = g_new (GimpParam, 1);
+
+              values[0].type          = GIMP_PDB_STATUS;
+              values[0].data.d_status = GIMP_PDB_SUCCESS;
+            }
+          else
+            {
+              BatchState batch;
+
+              /*  the queued calls must run first  */
+              if (ts_batch &&
+                  ! script_fu_batch_flush (error_str, sizeof (error_str)))
+                return foreign_error (sc, error_str, 0);
+
+              /*  a script called from here runs in this interpreter  */
+              script_fu_batch_suspend (&batch);
+
 #if DEBUG_MARSHALL
-          g_printerr ("    calling %s...", proc_name);
+              g_printerr ("    calling %s...", proc_name);
 #endif
-          values = gimp_run_procedure2 (proc_name, &nvalues, nparams, args);
+              values = gimp_run_procedure2 (proc_name, &nvalues, nparams, args);
 #if DEBUG_MARSHALL
-          g_printerr ("  done.\n");
+              g_printerr ("  done.\n");
 #endif
+
+              script_fu_batch_resume (&batch);
+            }
         }
     }
   else
@@ -1678,3 +1815,169 @@ script_fu_nil_call (scheme  *sc,
 {
   return sc->NIL;
 }
+
+static void
+script_fu_proc_info_free (ProcInfo *proc_info)
+{
+  g_free (proc_info->params);
+  g_free (proc_info->return_vals);
+
+  g_slice_free (ProcInfo, proc_info);
+}
+
+static pointer
+script_fu_batch_begin_call (scheme  *sc,
+                            pointer  a)
+{
+  if (ts_batch_depth++ == 0)
+    {
+      ts_batch       = gimp_pdb_batch_new ();
+      ts_batch_names = g_ptr_array_new_with_free_func (g_free);
+      ts_batch_procs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify) script_fu_proc_info_free);
+    }
+
+  return sc->T;
+}
+
+static pointer
+script_fu_batch_end_call (scheme  *sc,
+                          pointer  a)
+{
+  gchar error_str[1024];
+
+  if (ts_batch_depth == 0)
+    return foreign_error (sc, "gimp-batch-end called without gimp-batch-begin", 0);
+
+  if (--ts_batch_depth == 0 &&
+      ! script_fu_batch_end (error_str, sizeof (error_str)))
+    return foreign_error (sc, error_str, 0);
+
+  return sc->T;
+}
+
+/*  Runs the queued calls and waits for them, then reports the first
+ *  one that failed in @error_str.
+ */
+static gboolean
+script_fu_batch_flush (gchar *error_str,
+                       gsize  error_len)
+{
+  gint       n_calls = gimp_pdb_batch_get_n_calls (ts_batch);
+  gboolean   success = TRUE;
+  gint       i;
+  BatchState batch;
+
+  if (n_calls == 0)
+    return TRUE;
+
+  /*  a queued call may run a script, which runs in this interpreter  */
+  script_fu_batch_suspend (&batch);
+
+  gimp_pdb_batch_run (batch.batch);
+
+  script_fu_batch_resume (&batch);
+
+  for (i = 0; i < n_calls && success; i++)
+    {
+      const gchar     *proc_name = g_ptr_array_index (ts_batch_names, i);
+      const GimpParam *values;
+      gint             nvalues;
+
+      values = gimp_pdb_batch_get_return_vals (ts_batch, i, &nvalues);
+
+      if (nvalues < 1)
+        {
+          g_snprintf (error_str, error_len,
+                      "Procedure execution of %s did not return a status",
+                      proc_name);
+          success = FALSE;
+        }
+      else if (values[0].data.d_status == GIMP_PDB_EXECUTION_ERROR)
+        {
+          if (nvalues > 1 && values[1].type == GIMP_PDB_STRING)
+            g_snprintf (error_str, error_len,
+                        "Procedure execution of %s failed: %s",
+                        proc_name, values[1].data.d_string);
+          else
+            g_snprintf (error_str, error_len,
+                        "Procedure execution of %s failed",
+                        proc_name);
+          success = FALSE;
+        }
+      else if (values[0].data.d_status == GIMP_PDB_CALLING_ERROR)
+        {
+          if (nvalues > 1 && values[1].type == GIMP_PDB_STRING)
+            g_snprintf (error_str, error_len,
+                        "Procedure execution of %s failed on invalid input arguments: %s",
+                        proc_name, values[1].data.d_string);
+          else
+            g_snprintf (error_str, error_len,
+                        "Procedure execution of %s failed on invalid input arguments",
+                        proc_name);
+          success = FALSE;
+        }
+    }
+
+  gimp_pdb_batch_free (ts_batch);
+  ts_batch = gimp_pdb_batch_new ();
+
+  g_ptr_array_set_size (ts_batch_names, 0);
+
+  return success;
+}
+
+/*  Hides the current batch from the scripts GIMP runs in this
+ *  interpreter while we wait for a call, they would otherwise queue
+ *  their calls in it, and end it when they are done.
+ */
+static void
+script_fu_batch_suspend (BatchState *state)
+{
+  state->batch = ts_batch;
+  state->depth = ts_batch_depth;
+  state->names = ts_batch_names;
+  state->procs = ts_batch_procs;
+
+  ts_batch       = NULL;
+  ts_batch_depth = 0;
+  ts_batch_names = NULL;
+  ts_batch_procs = NULL;
+}
+
+static void
+script_fu_batch_resume (BatchState *state)
+{
+  ts_batch       = state->batch;
+  ts_batch_depth = state->depth;
+  ts_batch_names = state->names;
+  ts_batch_procs = state->procs;
+}
+
+static gboolean
+script_fu_batch_end (gchar *error_str,
+                     gsize  error_len)
+{
+  gchar    buf[1024];
+  gboolean success;
+
+  if (! error_str)
+    {
+      error_str = buf;
+      error_len = sizeof (buf);
+    }
+
+  success = script_fu_batch_flush (error_str, error_len);
+
+  gimp_pdb_batch_free (ts_batch);
+  g_ptr_array_free (ts_batch_names, TRUE);
+  g_hash_table_destroy (ts_batch_procs);
+
+  ts_batch       = NULL;
+  ts_batch_depth = 0;
+  ts_batch_names = NULL;
+  ts_batch_procs = NULL;
+
+  return success;
+}
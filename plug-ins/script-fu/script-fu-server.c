@@ -127,9 +127,10 @@ typedef short sa_family_t;	/* Not defined by winsock */
 
 typedef struct
 {
-  gchar *command;
-  gint   filedes;
-  gint   request_no;
+  gchar  *command;
+  gint    filedes;
+  gint    request_no;
+  gint64  received_time;
 } SFCommand;
 
 typedef struct
@@ -303,7 +304,7 @@ script_fu_server_read_fd (gpointer key,
               from the disconnected client.  */
           for (list = command_queue; list; list = list->next)
             {
-              SFCommand *cmd = (SFCommand *) command_queue->data;
+              SFCommand *cmd = (SFCommand *) list->data;
 
               if (cmd->filedes == fd)
                 cmd->filedes = -1;
@@ -555,7 +556,10 @@ execute_command (SFCommand *cmd)
   gdouble     total_time;
   GTimer     *timer;
 
-  server_log ("Processing request #%d\n", cmd->request_no);
+  server_log ("Processing request #%d after %.3f seconds in the queue\n",
+              cmd->request_no,
+              (gdouble) (g_get_monotonic_time () - cmd->received_time) /
+              G_TIME_SPAN_SECOND);
   timer = g_timer_new ();
 
   response = g_string_new (NULL);
@@ -672,9 +676,10 @@ read_from_client (gint filedes)
   command[command_len] = '\0';
   cmd = g_new (SFCommand, 1);
 
-  cmd->filedes    = filedes;
-  cmd->command    = command;
-  cmd->request_no = request_no ++;
+  cmd->filedes       = filedes;
+  cmd->command       = command;
+  cmd->request_no    = request_no ++;
+  cmd->received_time = g_get_monotonic_time ();
 
   /*  Add the command to the queue  */
   command_queue = g_list_append (command_queue, cmd);
@@ -0,0 +1,117 @@
+; GIMP - The GNU Image Manipulation Program
+; Copyright (C) 1995 Spencer Kimball and Peter Mattis
+;
+; This program is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation; either version 3 of the License, or
+; (at your option) any later version.
+;
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License
+; along with this program.  If not, see <http://www.gnu.org/licenses/>.
+;
+; Tests calling another script between gimp-batch-begin and
+; gimp-batch-end.  Scripts are temporary procedures of Script-Fu
+; itself, so GIMP has to call back into this interpreter while calls
+; of the batch are queued or in flight.
+
+(define (script-fu-test-batch-fill image drawable color)
+  (gimp-context-push)
+  (gimp-context-set-foreground color)
+  (gimp-drawable-fill drawable FILL-FOREGROUND)
+  (gimp-context-pop)
+)
+
+(script-fu-register "script-fu-test-batch-fill"
+  "Batch Test Fill"
+  "Fills a drawable with a color, called from inside a batch by the batch test."
+  "GIMP Team"
+  "GIMP Team"
+  "2018"
+  "RGB*"
+  SF-IMAGE    "Image"    0
+  SF-DRAWABLE "Drawable" 0
+  SF-COLOR    "Color"    "red"
+)
+
+(define (script-fu-test-batch)
+  (let* (
+        (width 64)
+        (height 64)
+        (n-layers 16)
+        (img (car (gimp-image-new width height RGB)))
+        (layers)
+        (i 0)
+        )
+
+    (gimp-image-undo-disable img)
+
+    (gimp-batch-begin)
+
+    (while (< i n-layers)
+      (let* (
+            (value (* i 16))
+            (layer (car (gimp-layer-new img width height RGB-IMAGE
+                                        "Layer" 100 LAYER-MODE-NORMAL)))
+            )
+
+        ; queued, the procedure has no return values
+        (gimp-image-insert-layer img layer 0 -1)
+
+        ; runs the queue, then GIMP calls back into Script-Fu
+        (gimp-proc-db-call "script-fu-test-batch-fill"
+                           RUN-NONINTERACTIVE img layer
+                           (list value value value))
+
+        ; queued again once the other script returned
+        (gimp-item-set-name layer
+                            (string-append "Layer " (number->string i)))
+
+        (set! i (+ i 1))
+      )
+    )
+
+    (gimp-batch-end)
+
+    ; the last layer inserted is on top
+    (set! layers (cadr (gimp-image-get-layers img)))
+    (set! i 0)
+
+    (while (< i n-layers)
+      (let* (
+            (layer (vector-ref layers (- n-layers i 1)))
+            (name (car (gimp-item-get-name layer)))
+            (pixel (cadr (gimp-drawable-get-pixel layer 0 0)))
+            )
+
+        (if (not (string=? name (string-append "Layer " (number->string i))))
+            (error "Layer has the wrong name:" name))
+
+        (if (not (= (vector-ref pixel 0) (* i 16)))
+            (error "Layer was not filled by the called script:" name))
+
+        (set! i (+ i 1))
+      )
+    )
+
+    (gimp-image-delete img)
+
+    (gimp-message "Calling scripts from a batch works.")
+  )
+)
+
+(script-fu-register "script-fu-test-batch"
+  "_Batch..."
+  "Tests calling another script between gimp-batch-begin and gimp-batch-end."
+  "GIMP Team"
+  "GIMP Team"
+  "2018"
+  ""
+)
+
+(script-fu-menu-register "script-fu-test-batch"
+                         "<Image>/Filters/Languages/Script-Fu/Test")